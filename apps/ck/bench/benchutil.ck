@@ -0,0 +1,124 @@
+/*++
+
+Copyright (c) 2026 Minoca Corp.
+
+    This file is licensed under the terms of the GNU General Public License
+    version 3. Alternative licensing terms are available. Contact
+    info@minocacorp.com for details. See the LICENSE file at the root of this
+    project for complete licensing information.
+
+Module Name:
+
+    benchutil.ck
+
+Abstract:
+
+    This module implements common support for the Chalk benchmark scripts.
+    Run a benchmark from this directory with something like
+    "chalk methods.ck". Each one prints the number of calls per second it
+    achieved.
+
+Author:
+
+    Minoca Corp. 17-Oct-2026
+
+Environment:
+
+    Chalk
+
+--*/
+
+//
+// ------------------------------------------------------------------- Includes
+//
+
+import _time;
+
+//
+// ---------------------------------------------------------------- Definitions
+//
+
+//
+// ----------------------------------------------- Internal Function Prototypes
+//
+
+//
+// -------------------------------------------------------------------- Globals
+//
+
+//
+// ------------------------------------------------------------------ Functions
+//
+
+function
+now (
+    )
+
+/*++
+
+Routine Description:
+
+    This routine returns the current monotonic time.
+
+Arguments:
+
+    None.
+
+Return Value:
+
+    Returns the monotonic time in microseconds.
+
+--*/
+
+{
+
+    var value = (_time.clock_gettime)(_time.CLOCK_MONOTONIC);
+
+    return (value[0] * 1000000) + (value[1] / 1000);
+}
+
+function
+report (
+    name,
+    calls,
+    start
+    )
+
+/*++
+
+Routine Description:
+
+    This routine prints the result of a benchmark.
+
+Arguments:
+
+    name - Supplies the name of the benchmark.
+
+    calls - Supplies the number of method calls the benchmark made.
+
+    start - Supplies the time the benchmark started, as returned by now().
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    var elapsed = now() - start;
+
+    if (elapsed <= 0) {
+        elapsed = 1;
+    }
+
+    Core.print("%-24s %10d calls %8d us %12d calls/s" %
+               [name, calls, elapsed, (calls * 1000000) / elapsed]);
+
+    return;
+}
+
+//
+// --------------------------------------------------------- Internal Functions
+//
+
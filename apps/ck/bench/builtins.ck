@@ -0,0 +1,109 @@
+/*++
+
+Copyright (c) 2026 Minoca Corp.
+
+    This file is licensed under the terms of the GNU General Public License
+    version 3. Alternative licensing terms are available. Contact
+    info@minocacorp.com for details. See the LICENSE file at the root of this
+    project for complete licensing information.
+
+Module Name:
+
+    builtins.ck
+
+Abstract:
+
+    This module measures method call throughput on the builtin list, dict,
+    and string classes, in a pattern similar to what the build scripts do
+    when walking large project trees.
+
+Author:
+
+    Minoca Corp. 17-Oct-2026
+
+Environment:
+
+    Chalk
+
+--*/
+
+//
+// ------------------------------------------------------------------- Includes
+//
+
+from benchutil import now, report;
+
+//
+// ---------------------------------------------------------------- Definitions
+//
+
+var ITERATIONS = 200000;
+
+//
+// ------------------------------------------------------ Data Type Definitions
+//
+
+//
+// ----------------------------------------------- Internal Function Prototypes
+//
+
+//
+// -------------------------------------------------------------------- Globals
+//
+
+//
+// ------------------------------------------------------------------ Functions
+//
+
+function
+runBuiltinCalls (
+    )
+
+/*++
+
+Routine Description:
+
+    This routine makes a mix of calls on builtin objects. Each iteration makes
+    six method calls.
+
+Arguments:
+
+    None.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    var entry;
+    var index;
+    var names = {};
+    var sources = [];
+    var start = now();
+
+    for (index = 0; index < ITERATIONS; index += 1) {
+        entry = "source%d.c" % (index % 64);
+        if (!names.containsKey(entry)) {
+            names[entry] = sources.length();
+        }
+
+        if (entry.endsWith(".c")) {
+            sources.append(entry.replace(".c", ".o", 1));
+        }
+
+        names.get(entry);
+    }
+
+    report("builtins", ITERATIONS * 6, start);
+    return;
+}
+
+runBuiltinCalls();
+
+//
+// --------------------------------------------------------- Internal Functions
+//
+
@@ -0,0 +1,239 @@
+/*++
+
+Copyright (c) 2026 Minoca Corp.
+
+    This file is licensed under the terms of the GNU General Public License
+    version 3. Alternative licensing terms are available. Contact
+    info@minocacorp.com for details. See the LICENSE file at the root of this
+    project for complete licensing information.
+
+Module Name:
+
+    heap.ck
+
+Abstract:
+
+    This module stresses the garbage collector by churning through short
+    lived objects while a large set of long lived objects stays reachable.
+    It reports allocation throughput along with the collector statistics,
+    including the largest number of objects traversed by a single
+    collection, which approximates the worst pause.
+
+Author:
+
+    Minoca Corp. 17-Oct-2026
+
+Environment:
+
+    Chalk
+
+--*/
+
+//
+// ------------------------------------------------------------------- Includes
+//
+
+from benchutil import now, report;
+
+//
+// ---------------------------------------------------------------- Definitions
+//
+
+var RETAINED_COUNT = 200000;
+var CHURN_ITERATIONS = 1000000;
+
+//
+// ------------------------------------------------------ Data Type Definitions
+//
+
+class Node {
+    var _value;
+    var _next;
+
+    function
+    __init (
+        value,
+        next
+        )
+
+    {
+
+        _value = value;
+        _next = next;
+        return this;
+    }
+
+    function
+    value (
+        )
+
+    {
+
+        return _value;
+    }
+
+    function
+    next (
+        )
+
+    {
+
+        return _next;
+    }
+}
+
+//
+// ----------------------------------------------- Internal Function Prototypes
+//
+
+//
+// -------------------------------------------------------------------- Globals
+//
+
+//
+// ------------------------------------------------------------------ Functions
+//
+
+function
+buildRetained (
+    )
+
+/*++
+
+Routine Description:
+
+    This routine builds the long lived portion of the heap: a linked list of
+    nodes and a dictionary of small lists.
+
+Arguments:
+
+    None.
+
+Return Value:
+
+    Returns a list containing the retained structures.
+
+--*/
+
+{
+
+    var head = null;
+    var index;
+    var start = now();
+    var table = {};
+
+    for (index = 0; index < RETAINED_COUNT; index += 1) {
+        head = Node(index, head);
+        table[index] = [index, head];
+    }
+
+    report("build retained", RETAINED_COUNT * 2, start);
+    return [head, table];
+}
+
+function
+churn (
+    retained
+    )
+
+/*++
+
+Routine Description:
+
+    This routine allocates objects that die almost immediately, occasionally
+    storing one into the long lived structures so that old objects point at
+    young ones.
+
+Arguments:
+
+    retained - Supplies the long lived structures returned by
+        buildRetained.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    var index;
+    var item;
+    var node;
+    var start = now();
+    var table = retained[1];
+
+    for (index = 0; index < CHURN_ITERATIONS; index += 1) {
+        node = Node(index, null);
+        item = [node, index];
+        if ((index % 64) == 0) {
+            table[index % RETAINED_COUNT][0] = item;
+        }
+    }
+
+    report("churn", CHURN_ITERATIONS * 2, start);
+    return;
+}
+
+function
+verify (
+    retained
+    )
+
+/*++
+
+Routine Description:
+
+    This routine walks the retained structures to make sure nothing reachable
+    was collected.
+
+Arguments:
+
+    retained - Supplies the long lived structures returned by
+        buildRetained.
+
+Return Value:
+
+    None. An exception is raised if the heap is damaged.
+
+--*/
+
+{
+
+    var count = 0;
+    var item;
+    var node = retained[0];
+    var table = retained[1];
+
+    while (node != null) {
+        count += 1;
+        node = node.next();
+    }
+
+    if (count != RETAINED_COUNT) {
+        Core.raise(ValueError("Lost retained nodes"));
+    }
+
+    item = table[64][0];
+    if (item[0].value() != item[1]) {
+        Core.raise(ValueError("Lost young object stored in old list"));
+    }
+
+    return;
+}
+
+var retained = buildRetained();
+var stats;
+
+churn(retained);
+verify(retained);
+stats = Core.gcStats();
+Core.print("full collections         %10d" % stats["fullCollections"]);
+Core.print("young collections        %10d" % stats["youngCollections"]);
+Core.print("objects freed            %10d" % stats["totalFreed"]);
+Core.print("largest traversal        %10d objects" % stats["maxKissed"]);
+
+//
+// --------------------------------------------------------- Internal Functions
+//
+
@@ -0,0 +1,221 @@
+/*++
+
+Copyright (c) 2026 Minoca Corp.
+
+    This file is licensed under the terms of the GNU General Public License
+    version 3. Alternative licensing terms are available. Contact
+    info@minocacorp.com for details. See the LICENSE file at the root of this
+    project for complete licensing information.
+
+Module Name:
+
+    methods.ck
+
+Abstract:
+
+    This module measures method call throughput at call sites that see one
+    class (monomorphic), a few classes (polymorphic), and many classes
+    (megamorphic).
+
+Author:
+
+    Minoca Corp. 17-Oct-2026
+
+Environment:
+
+    Chalk
+
+--*/
+
+//
+// ------------------------------------------------------------------- Includes
+//
+
+from benchutil import now, report;
+
+//
+// ---------------------------------------------------------------- Definitions
+//
+
+var ITERATIONS = 1000000;
+
+//
+// ------------------------------------------------------ Data Type Definitions
+//
+
+class Shape {
+    var _size;
+
+    function
+    __init (
+        size
+        )
+
+    {
+
+        _size = size;
+        return this;
+    }
+
+    function
+    area (
+        )
+
+    {
+
+        return _size;
+    }
+
+    function
+    scale (
+        a,
+        b,
+        c,
+        d,
+        e,
+        f,
+        g,
+        h,
+        i
+        )
+
+    {
+
+        return _size + a + b + c + d + e + f + g + h + i;
+    }
+}
+
+class Square is Shape {
+    function area() { return 4; }
+}
+
+class Rectangle is Shape {
+    function area() { return 6; }
+}
+
+class Triangle is Shape {
+    function area() { return 3; }
+}
+
+class Circle is Shape {
+    function area() { return 12; }
+}
+
+class Pentagon is Shape {
+    function area() { return 5; }
+}
+
+class Hexagon is Shape {
+    function area() { return 6; }
+}
+
+class Octagon is Shape {
+    function area() { return 8; }
+}
+
+//
+// ----------------------------------------------- Internal Function Prototypes
+//
+
+//
+// -------------------------------------------------------------------- Globals
+//
+
+//
+// ------------------------------------------------------------------ Functions
+//
+
+function
+runCalls (
+    name,
+    shapes
+    )
+
+/*++
+
+Routine Description:
+
+    This routine calls the area method on a rotating set of objects from a
+    single call site.
+
+Arguments:
+
+    name - Supplies the name of the benchmark.
+
+    shapes - Supplies the list of objects to rotate through.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    var count = shapes.length();
+    var index;
+    var start = now();
+    var total = 0;
+
+    for (index = 0; index < ITERATIONS; index += 1) {
+        total += shapes[index % count].area();
+    }
+
+    report(name, ITERATIONS, start);
+    return;
+}
+
+function
+runWideCalls (
+    )
+
+/*++
+
+Routine Description:
+
+    This routine measures calls with more than eight arguments, which use the
+    long form of the call instruction.
+
+Arguments:
+
+    None.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    var index;
+    var shape = Square(3);
+    var start = now();
+    var total = 0;
+
+    for (index = 0; index < ITERATIONS; index += 1) {
+        total += shape.scale(1, 2, 3, 4, 5, 6, 7, 8, 9);
+    }
+
+    report("nine arguments", ITERATIONS, start);
+    return;
+}
+
+runCalls("monomorphic", [Square(3)]);
+runCalls("polymorphic (3)", [Square(3), Rectangle(3), Triangle(3)]);
+runCalls("megamorphic (8)",
+         [Shape(3),
+          Square(3),
+          Rectangle(3),
+          Triangle(3),
+          Circle(3),
+          Pentagon(3),
+          Hexagon(3),
+          Octagon(3)]);
+
+runWideCalls();
+
+//
+// --------------------------------------------------------- Internal Functions
+//
+
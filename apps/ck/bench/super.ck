@@ -0,0 +1,179 @@
+/*++
+
+Copyright (c) 2026 Minoca Corp.
+
+    This file is licensed under the terms of the GNU General Public License
+    version 3. Alternative licensing terms are available. Contact
+    info@minocacorp.com for details. See the LICENSE file at the root of this
+    project for complete licensing information.
+
+Module Name:
+
+    super.ck
+
+Abstract:
+
+    This module measures method call throughput for super calls and for
+    methods inherited from a superclass.
+
+Author:
+
+    Minoca Corp. 17-Oct-2026
+
+Environment:
+
+    Chalk
+
+--*/
+
+//
+// ------------------------------------------------------------------- Includes
+//
+
+from benchutil import now, report;
+
+//
+// ---------------------------------------------------------------- Definitions
+//
+
+var ITERATIONS = 1000000;
+
+//
+// ------------------------------------------------------ Data Type Definitions
+//
+
+class Base {
+    var _value;
+
+    function
+    __init (
+        value
+        )
+
+    {
+
+        _value = value;
+        return this;
+    }
+
+    function
+    get (
+        )
+
+    {
+
+        return _value;
+    }
+
+    function
+    inherited (
+        )
+
+    {
+
+        return _value + 1;
+    }
+}
+
+class Derived is Base {
+    function
+    get (
+        )
+
+    {
+
+        return super.get() + 1;
+    }
+}
+
+//
+// ----------------------------------------------- Internal Function Prototypes
+//
+
+//
+// -------------------------------------------------------------------- Globals
+//
+
+//
+// ------------------------------------------------------------------ Functions
+//
+
+function
+runSuperCalls (
+    )
+
+/*++
+
+Routine Description:
+
+    This routine measures calls that go through super. Each iteration makes
+    two calls: one to the derived method and one to the base method.
+
+Arguments:
+
+    None.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    var index;
+    var object = Derived(1);
+    var start = now();
+    var total = 0;
+
+    for (index = 0; index < ITERATIONS; index += 1) {
+        total += object.get();
+    }
+
+    report("super", ITERATIONS * 2, start);
+    return;
+}
+
+function
+runInheritedCalls (
+    )
+
+/*++
+
+Routine Description:
+
+    This routine measures calls to a method the receiver's class inherited
+    from its superclass.
+
+Arguments:
+
+    None.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    var index;
+    var object = Derived(1);
+    var start = now();
+    var total = 0;
+
+    for (index = 0; index < ITERATIONS; index += 1) {
+        total += object.inherited();
+    }
+
+    report("inherited", ITERATIONS, start);
+    return;
+}
+
+runSuperCalls();
+runInheritedCalls();
+
+//
+// --------------------------------------------------------- Internal Functions
+//
+
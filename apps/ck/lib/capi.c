@@ -1710,6 +1710,7 @@ Return Value:
     Value = *(Fiber->StackTop - 1);
     if (ListIndex == List->Elements.Count) {
         CkpArrayAppend(Vm, &(List->Elements), Value);
+        CK_WRITE_BARRIER(Vm, &(List->Header));
 
     } else if ((ListIndex < List->Elements.Count) ||
                (-ListIndex <= (INTN)List->Elements.Count)) {
@@ -1720,6 +1721,7 @@ Return Value:
         CK_ASSERT(Index < List->Elements.Count);
 
         List->Elements.Data[Index] = Value;
+        CK_WRITE_BARRIER(Vm, &(List->Header));
     }
 
     Fiber->StackTop -= 1;
@@ -2169,6 +2171,7 @@ Return Value:
 {
 
     PCK_FIBER Fiber;
+    CK_VALUE Receiver;
     PCK_VALUE Value;
 
     Fiber = Vm->Fiber;
@@ -2182,6 +2185,8 @@ Return Value:
     }
 
     *Value = CK_POP(Fiber);
+    Receiver = Fiber->Frames[Fiber->FrameCount - 1].StackStart[0];
+    CK_WRITE_BARRIER(Vm, CK_AS_OBJECT(Receiver));
     return;
 }
 
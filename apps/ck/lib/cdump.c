@@ -49,7 +49,7 @@ Module Name:
 // Define the current freeze file format version.
 //
 
-#define CK_FREEZE_VERSION 1
+#define CK_FREEZE_VERSION 2
 
 //
 // ------------------------------------------------------ Data Type Definitions
@@ -511,6 +511,73 @@ Return Value:
     return Result;
 }
 
+BOOL
+CkpModuleIsFrozenCurrent (
+    PCSTR Contents,
+    UINTN Size
+    )
+
+/*++
+
+Routine Description:
+
+    This routine determines whether the given frozen module was written in the
+    freeze format this VM understands. Only the header needs to be supplied.
+
+Arguments:
+
+    Contents - Supplies the beginning of the frozen module contents.
+
+    Size - Supplies the number of bytes of contents available.
+
+Return Value:
+
+    TRUE if the contents are a frozen module of the current format version.
+
+    FALSE if the contents are not a frozen module or are from a different
+    version.
+
+--*/
+
+{
+
+    CK_INTEGER Integer;
+    PCSTR Name;
+    UINTN NameSize;
+
+    if ((Size < sizeof(CkModuleFreezeSignature) + 1) ||
+        (CkCompareMemory(Contents,
+                         CkModuleFreezeSignature,
+                         sizeof(CkModuleFreezeSignature)) != 0)) {
+
+        return FALSE;
+    }
+
+    Contents += sizeof(CkModuleFreezeSignature);
+    Size -= sizeof(CkModuleFreezeSignature);
+    if (*Contents != '{') {
+        return FALSE;
+    }
+
+    Contents += 1;
+    Size -= 1;
+    Name = CkpThawElement(&Contents, &Size, &NameSize);
+    if ((Name == NULL) ||
+        (NameSize != 7) ||
+        (CkCompareMemory(Name, "Version", 7) != 0)) {
+
+        return FALSE;
+    }
+
+    if ((!CkpThawInteger(&Contents, &Size, &Integer)) ||
+        (Integer != CK_FREEZE_VERSION)) {
+
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
 //
 // --------------------------------------------------------- Internal Functions
 //
@@ -847,6 +914,8 @@ Return Value:
     CkpFreezeInteger(Vm, String, Function->UpvalueCount);
     CkpFreezeAdd(Vm, String, "\nArity: ", 8);
     CkpFreezeInteger(Vm, String, Function->Arity);
+    CkpFreezeAdd(Vm, String, "\nCallSiteCount: ", 16);
+    CkpFreezeInteger(Vm, String, Function->CallSiteCount);
     CkpFreezeAdd(Vm, String, "\nName: ", 7);
     CkpFreezeString(Vm, String, Function->Debug.Name);
     CkpFreezeAdd(Vm, String, "\nFirstLine: ", 12);
@@ -1224,6 +1293,12 @@ Return Value:
             Result = CkpThawInteger(Contents, Size, &Integer);
             Function->Arity = Integer;
 
+        } else if ((NameSize == 13) &&
+                   (CkCompareMemory(Name, "CallSiteCount", 13) == 0)) {
+
+            Result = CkpThawInteger(Contents, Size, &Integer);
+            Function->CallSiteCount = Integer;
+
         } else if ((NameSize == 4) &&
                    (CkCompareMemory(Name, "Name", 4) == 0)) {
 
@@ -1262,6 +1337,14 @@ Return Value:
         return FALSE;
     }
 
+    if ((Function->CallSiteCount < 0) ||
+        (Function->CallSiteCount > CK_MAX_CALL_SITES) ||
+        (!CkpFunctionAllocateMethodCaches(Vm, Function))) {
+
+        Result = FALSE;
+        goto ThawFunctionEnd;
+    }
+
     *Size -= 1;
     *Contents += 1;
     *NewFunction = Function;
@@ -135,6 +135,14 @@ Module Name:
 
 #define CK_MAX_FIELDS 255
 
+//
+// Define the maximum number of method call sites in a single function. This
+// limitation exists in the bytecode since the call site index operand of the
+// call ops is a 2 byte value.
+//
+
+#define CK_MAX_CALL_SITES 0x10000
+
 //
 // Define the maximum number of nested functions.
 //
@@ -670,6 +670,17 @@ Return Value:
         goto FinalizeCompilerEnd;
     }
 
+    //
+    // Now that the number of call sites is known, create their method caches.
+    //
+
+    if (!CkpFunctionAllocateMethodCaches(Compiler->Parser->Vm,
+                                         Compiler->Function)) {
+
+        Compiler->Function = NULL;
+        goto FinalizeCompilerEnd;
+    }
+
     //
     // If this is a child compiler, emit the definition for the function just
     // compiled.
@@ -38,6 +38,12 @@ Module Name:
 // ---------------------------------------------------------------- Definitions
 //
 
+//
+// Define the number of garbage collection statistics returned to scripts.
+//
+
+#define CK_GC_STATISTIC_COUNT 10
+
 //
 // ------------------------------------------------------ Data Type Definitions
 //
@@ -183,6 +189,12 @@ CkpCoreGarbageCollect (
     PCK_VALUE Arguments
     );
 
+BOOL
+CkpCoreGarbageStatistics (
+    PCK_VM Vm,
+    PCK_VALUE Arguments
+    );
+
 BOOL
 CkpCoreImportModule (
     PCK_VM Vm,
@@ -232,6 +244,23 @@ CkpCoreImportAllSymbols (
 extern PVOID _binary_ckcore_ck_start;
 extern PVOID _binary_ckcore_ck_end;
 
+//
+// Define the keys of the dictionary returned by Core.gcStats().
+//
+
+PCSTR CkGarbageStatisticNames[CK_GC_STATISTIC_COUNT] = {
+    "fullCollections",
+    "youngCollections",
+    "lastFreed",
+    "totalFreed",
+    "lastKissed",
+    "maxKissed",
+    "bytesAllocated",
+    "oldBytes",
+    "nextCollection",
+    "remembered"
+};
+
 CK_PRIMITIVE_DESCRIPTION CkObjectPrimitives[] = {
     {"__init@0", 0, CkpObjectInit},
     {"__lnot@0", 0, CkpObjectLogicalNot},
@@ -275,6 +304,7 @@ CK_PRIMITIVE_DESCRIPTION CkFunctionPrimitives[] = {
 
 CK_PRIMITIVE_DESCRIPTION CkCorePrimitives[] = {
     {"gc@0", 0, CkpCoreGarbageCollect},
+    {"gcStats@0", 0, CkpCoreGarbageStatistics},
     {"importModule@1", 1, CkpCoreImportModule},
     {"_write@1", 1, CkpCoreWrite},
     {"modules@0", 0, CkpCoreGetModules},
@@ -318,6 +348,7 @@ Return Value:
     CK_ERROR_TYPE Error;
     PCK_OBJECT Object;
     PCK_CLASS ObjectMeta;
+    PCK_OBJECT OldObject;
     UINTN Size;
     CK_VALUE Value;
 
@@ -440,10 +471,12 @@ Return Value:
 
     //
     // Patch up any of the core objects that may have been created before their
-    // associated classes existed.
+    // associated classes existed. Walk the young list and then the old list,
+    // since a collection may have already occurred.
     //
 
     Object = Vm->FirstObject;
+    OldObject = Vm->FirstOldObject;
     while (Object != NULL) {
         if (Object->Type == CkObjectString) {
             Object->Class = Classes->String;
@@ -459,6 +492,10 @@ Return Value:
         }
 
         Object = Object->Next;
+        if (Object == NULL) {
+            Object = OldObject;
+            OldObject = NULL;
+        }
     }
 
     CoreModule->Header.Class = Classes->Module;
@@ -1177,6 +1214,7 @@ Return Value:
         }
 
         CK_OBJECT_VALUE(Instance->Fields[0], Dict);
+        CK_WRITE_BARRIER(Vm, &(Instance->Header));
 
     } else {
         Dict = CK_AS_DICT(Instance->Fields[0]);
@@ -1646,6 +1684,80 @@ Return Value:
     return TRUE;
 }
 
+BOOL
+CkpCoreGarbageStatistics (
+    PCK_VM Vm,
+    PCK_VALUE Arguments
+    )
+
+/*++
+
+Routine Description:
+
+    This routine implements the primitive that returns a dictionary of
+    garbage collector statistics.
+
+Arguments:
+
+    Vm - Supplies a pointer to the virtual machine.
+
+    Arguments - Supplies the function arguments.
+
+Return Value:
+
+    TRUE on success.
+
+    FALSE if execution caused a runtime error.
+
+--*/
+
+{
+
+    PCK_DICT Dict;
+    UINTN Index;
+    CK_VALUE Key;
+    PCSTR Name;
+    CK_INTEGER Statistics[CK_GC_STATISTIC_COUNT];
+    CK_VALUE Value;
+
+    //
+    // Snapshot the statistics first, since creating the dictionary may itself
+    // kick off a collection.
+    //
+
+    Statistics[0] = Vm->GarbageRuns;
+    Statistics[1] = Vm->YoungGarbageRuns;
+    Statistics[2] = Vm->GarbageFreed;
+    Statistics[3] = Vm->TotalGarbageFreed;
+    Statistics[4] = Vm->GarbageKissed;
+    Statistics[5] = Vm->MaxGarbageKissed;
+    Statistics[6] = Vm->BytesAllocated;
+    Statistics[7] = Vm->OldBytes;
+    Statistics[8] = Vm->NextGarbageCollection;
+    Statistics[9] = Vm->RememberedCount;
+    Dict = CkpDictCreate(Vm);
+    if (Dict == NULL) {
+        return FALSE;
+    }
+
+    CkpPushRoot(Vm, &(Dict->Header));
+    for (Index = 0; Index < CK_GC_STATISTIC_COUNT; Index += 1) {
+        Name = CkGarbageStatisticNames[Index];
+        Key = CkpStringCreate(Vm, Name, strlen(Name));
+        if (CK_IS_NULL(Key)) {
+            CkpPopRoot(Vm);
+            return FALSE;
+        }
+
+        CK_INT_VALUE(Value, Statistics[Index]);
+        CkpDictSet(Vm, Dict, Key, Value);
+    }
+
+    CkpPopRoot(Vm);
+    CK_OBJECT_VALUE(Arguments[0], Dict);
+    return TRUE;
+}
+
 BOOL
 CkpCoreImportModule (
     PCK_VM Vm,
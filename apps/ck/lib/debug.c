@@ -507,6 +507,22 @@ Return Value:
     case CkOpSuperCall6:
     case CkOpSuperCall7:
     case CkOpSuperCall8:
+        Symbol = CK_READ16(ByteCode + Offset);
+        Offset += 2;
+
+        CK_ASSERT(Symbol < Function->Module->Strings.List.Count);
+
+        StringObject =
+                     CK_AS_STRING(Function->Module->Strings.List.Data[Symbol]);
+
+        Symbol = CK_READ16(ByteCode + Offset);
+        Offset += 2;
+
+        CK_ASSERT(Symbol < Function->CallSiteCount);
+
+        CkpDebugPrint(Vm, "%s (site %d)", StringObject->Value, Symbol);
+        break;
+
     case CkOpMethod:
     case CkOpStaticMethod:
         Symbol = CK_READ16(ByteCode + Offset);
@@ -338,6 +338,7 @@ Return Value:
         Dict->Count += 1;
     }
 
+    CK_WRITE_BARRIER(Vm, &(Dict->Header));
     return;
 }
 
@@ -1043,6 +1044,7 @@ Return Value:
                sizeof(CK_DICT_ENTRY) * NewDict->Capacity);
 
         NewDict->Count = Dict->Count;
+        CK_WRITE_BARRIER(Vm, &(NewDict->Header));
     }
 
     CkpPopRoot(Vm);
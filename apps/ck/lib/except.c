@@ -480,6 +480,7 @@ Return Value:
         ArgumentsList->Elements.Data[0] =
                                       CkpStringCreate(Vm, Description, Length);
 
+        CK_WRITE_BARRIER(Vm, &(ArgumentsList->Header));
     }
 
     //
@@ -653,6 +654,7 @@ Return Value:
         }
 
         CK_OBJECT_VALUE(Instance->Fields[0], Dict);
+        CK_WRITE_BARRIER(Vm, &(Instance->Header));
     }
 
     Dict = CK_AS_DICT(Instance->Fields[0]);
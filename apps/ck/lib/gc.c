@@ -42,6 +42,38 @@ Module Name:
 // ---------------------------------------------------------------- Definitions
 //
 
+//
+// Define the initial number of entries in the remembered set.
+//
+
+#define CK_REMEMBERED_SET_INITIAL_CAPACITY 64
+
+//
+// When garbage collection stress is enabled, perform a full collection once
+// every this many collections, and young collections otherwise.
+//
+
+#define CK_GC_STRESS_FULL_INTERVAL 8
+
+//
+// Define the fraction of the old generation size, as a shift, that the
+// nursery grows to. Scaling the nursery with the heap keeps the cost of
+// rescanning large remembered objects proportional to the work done.
+//
+
+#define CK_NURSERY_OLD_SHIFT 2
+
+//
+// This macro evaluates to non-zero if objects of the given type are stored to
+// without going through the write barrier. Once old, these objects stay in
+// the remembered set until they die.
+//
+
+#define CK_GC_ALWAYS_REMEMBERED(_Type)                                      \
+    (((_Type) != CkObjectInstance) && ((_Type) != CkObjectList) &&          \
+     ((_Type) != CkObjectDict) && ((_Type) != CkObjectString) &&            \
+     ((_Type) != CkObjectRange) && ((_Type) != CkObjectForeign))
+
 //
 // ------------------------------------------------------ Data Type Definitions
 //
@@ -50,6 +82,12 @@ Module Name:
 // ----------------------------------------------- Internal Function Prototypes
 //
 
+VOID
+CkpCollectGarbage (
+    PCK_VM Vm,
+    BOOL Full
+    );
+
 VOID
 CkpKissCompiler (
     PCK_VM Vm,
@@ -68,6 +106,12 @@ CkpKissObject (
     PCK_OBJECT Object
     );
 
+VOID
+CkpKissRoot (
+    PCK_VM Vm,
+    PCK_OBJECT Object
+    );
+
 VOID
 CkpDeeplyKiss (
     PCK_VM Vm,
@@ -76,6 +120,12 @@ CkpDeeplyKiss (
 
 VOID
 CkpCollectUnkissedObjects (
+    PCK_VM Vm,
+    PCK_OBJECT Head
+    );
+
+VOID
+CkpTrimRememberedSet (
     PCK_VM Vm
     );
 
@@ -184,85 +234,13 @@ Routine Description:
 
 Return Value:
 
-    Returns a pointer to the newly allocated or reallocated memory on success.
-
-    NULL on allocation failure or for free operations.
+    None.
 
 --*/
 
 {
 
-    UINTN Hysteresis;
-    UINTN Index;
-    CK_OBJECT KissHead;
-    UINTN Minimum;
-    UINTN NextThreshold;
-
-    //
-    // Reset the number of bytes allocated, and have the kiss functions count
-    // their allocations. This avoids the extra work of having to determine
-    // the size of objects being freed. The tradeoff is that the bytes
-    // allocated won't count non-object allocations, so it will be a bit low.
-    //
-
-    Vm->BytesAllocated = 0;
-    Vm->GarbageRuns += 1;
-    Vm->GarbageFreed = 0;
-
-    //
-    // Set up the head of the kiss list. Make it a circle so that the last
-    // object added does not have a non-null pointer.
-    //
-
-    KissHead.Type = CkObjectInvalid;
-    KissHead.Next = NULL;
-    KissHead.NextKiss = &KissHead;
-    Vm->KissList = &KissHead;
-    CkpKissObject(Vm, &(Vm->Modules->Header));
-    CkpKissObject(Vm, &(Vm->ModulePath->Header));
-    for (Index = 0; Index < Vm->WorkingObjectCount; Index += 1) {
-        CkpKissObject(Vm, Vm->WorkingObjects[Index]);
-    }
-
-    CkpKissObject(Vm, &(Vm->Fiber->Header));
-    if (Vm->Compiler != NULL) {
-        CkpKissCompiler(Vm, Vm->Compiler);
-    }
-
-    CkpKissObject(Vm, &(Vm->UnhandledException->Header));
-    CkpDeeplyKiss(Vm, &KissHead);
-    CkpCollectUnkissedObjects(Vm);
-
-    //
-    // Determine the next garbage collection time, expressed as an additional
-    // percentage growth. Except rather than using percent 100 exactly, use
-    // 1024 to avoid the divide. It looks nearly the same as percent times 10.
-    //
-
-    Hysteresis = Vm->BytesAllocated * Vm->Configuration.HeapGrowthPercent /
-                 1024;
-
-    NextThreshold = Vm->BytesAllocated + Hysteresis;
-
-    //
-    // Avoid ratcheting down the threshold little by little. Go down by the
-    // same chunk as going up.
-    //
-
-    if (NextThreshold < Vm->NextGarbageCollection) {
-        if (Vm->BytesAllocated > Hysteresis) {
-            Minimum = Vm->BytesAllocated - Hysteresis;
-            if (NextThreshold > Minimum) {
-                NextThreshold = Vm->NextGarbageCollection;
-            }
-        }
-    }
-
-    if (NextThreshold < Vm->Configuration.MinimumHeapSize) {
-        NextThreshold = Vm->Configuration.MinimumHeapSize;
-    }
-
-    Vm->NextGarbageCollection = NextThreshold;
+    CkpCollectGarbage(Vm, TRUE);
     return;
 }
 
@@ -367,6 +345,8 @@ Return Value:
 {
 
     PVOID Allocation;
+    BOOL Full;
+    ULONG Runs;
 
     //
     // Add the new bytes to the total count. Ignore frees, since those get
@@ -379,11 +359,29 @@ Return Value:
     // Potentially perform garbage collection.
     //
 
-    if ((NewSize > 0) &&
-        ((Vm->BytesAllocated >= Vm->NextGarbageCollection) ||
-         (CK_VM_FLAG_SET(Vm, CK_CONFIGURATION_GC_STRESS)))) {
+    if (NewSize > 0) {
+        if (CK_VM_FLAG_SET(Vm, CK_CONFIGURATION_GC_STRESS)) {
+            Runs = Vm->GarbageRuns + Vm->YoungGarbageRuns;
+            Full = FALSE;
+            if ((Runs % CK_GC_STRESS_FULL_INTERVAL) == 0) {
+                Full = TRUE;
+            }
+
+            CkpCollectGarbage(Vm, Full);
 
-        CkCollectGarbage(Vm);
+        } else if (Vm->BytesAllocated >= Vm->NextGarbageCollection) {
+            CkpCollectGarbage(Vm, TRUE);
+
+        //
+        // Collect just the young objects if enough has been allocated since
+        // the last collection.
+        //
+
+        } else if ((Vm->Configuration.NurserySize != 0) &&
+                   (Vm->BytesAllocated >= Vm->NextYoungCollection)) {
+
+            CkpCollectGarbage(Vm, FALSE);
+        }
     }
 
     Allocation = CkRawReallocate(Vm, Memory, NewSize);
@@ -407,10 +405,240 @@ Return Value:
     return Allocation;
 }
 
+VOID
+CkpRememberObject (
+    PCK_VM Vm,
+    PCK_OBJECT Object
+    )
+
+/*++
+
+Routine Description:
+
+    This routine adds an old object to the remembered set, causing it to be
+    traversed during the next young collection. Callers usually use the
+    write barrier macro rather than calling this directly.
+
+Arguments:
+
+    Vm - Supplies a pointer to the virtual machine.
+
+    Object - Supplies a pointer to the old object that was modified.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    UINTN NewCapacity;
+    PCK_OBJECT *NewSet;
+
+    CK_ASSERT((Object->Flags & CK_OBJECT_OLD) != 0);
+
+    if ((Object->Flags & CK_OBJECT_REMEMBERED) != 0) {
+        return;
+    }
+
+    //
+    // Grow the set directly with the system allocator, since this gets called
+    // from places where a garbage collection cannot be tolerated. If the set
+    // cannot grow, force the next collection to be a full one, which doesn't
+    // need the remembered set.
+    //
+
+    if (Vm->RememberedCount >= Vm->RememberedCapacity) {
+        NewCapacity = Vm->RememberedCapacity * 2;
+        if (NewCapacity == 0) {
+            NewCapacity = CK_REMEMBERED_SET_INITIAL_CAPACITY;
+        }
+
+        NewSet = CkRawReallocate(Vm,
+                                 Vm->Remembered,
+                                 NewCapacity * sizeof(PCK_OBJECT));
+
+        if (NewSet == NULL) {
+            Vm->GcFlags |= CK_GC_FULL_REQUIRED;
+            return;
+        }
+
+        Vm->Remembered = NewSet;
+        Vm->RememberedCapacity = NewCapacity;
+    }
+
+    Vm->Remembered[Vm->RememberedCount] = Object;
+    Vm->RememberedCount += 1;
+    Object->Flags |= CK_OBJECT_REMEMBERED;
+    return;
+}
+
 //
 // --------------------------------------------------------- Internal Functions
 //
 
+VOID
+CkpCollectGarbage (
+    PCK_VM Vm,
+    BOOL Full
+    )
+
+/*++
+
+Routine Description:
+
+    This routine performs garbage collection on the given Chalk instance.
+
+Arguments:
+
+    Vm - Supplies a pointer to the virtual machine.
+
+    Full - Supplies a boolean indicating whether to perform a full collection
+        (TRUE) or to only collect objects allocated since the last collection
+        (FALSE). A full collection may be performed anyway if young
+        collections are disabled or the remembered set is incomplete.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    UINTN Hysteresis;
+    UINTN Index;
+    CK_OBJECT KissHead;
+    UINTN Minimum;
+    UINTN NextThreshold;
+    UINTN Nursery;
+
+    if ((Vm->Configuration.NurserySize == 0) ||
+        ((Vm->GcFlags & CK_GC_FULL_REQUIRED) != 0)) {
+
+        Full = TRUE;
+    }
+
+    //
+    // Reset the number of bytes allocated, and have the kiss functions count
+    // their allocations. This avoids the extra work of having to determine
+    // the size of objects being freed. The tradeoff is that the bytes
+    // allocated won't count non-object allocations, so it will be a bit low.
+    // Young collections only count the objects being promoted.
+    //
+
+    Vm->BytesAllocated = 0;
+    Vm->GarbageFreed = 0;
+    Vm->GarbageKissed = 0;
+    if (Full != FALSE) {
+        Vm->GarbageRuns += 1;
+        Vm->GcFlags &= ~CK_GC_FULL_REQUIRED;
+
+    } else {
+        Vm->YoungGarbageRuns += 1;
+        Vm->GcFlags |= CK_GC_YOUNG_COLLECTION;
+    }
+
+    //
+    // Set up the head of the kiss list. Make it a circle so that the last
+    // object added does not have a non-null pointer.
+    //
+
+    KissHead.Type = CkObjectInvalid;
+    KissHead.Flags = 0;
+    KissHead.Next = NULL;
+    KissHead.NextKiss = &KissHead;
+    Vm->KissList = &KissHead;
+    CkpKissRoot(Vm, &(Vm->Modules->Header));
+    CkpKissRoot(Vm, &(Vm->ModulePath->Header));
+    for (Index = 0; Index < Vm->WorkingObjectCount; Index += 1) {
+        CkpKissRoot(Vm, Vm->WorkingObjects[Index]);
+    }
+
+    CkpKissRoot(Vm, &(Vm->Fiber->Header));
+    if (Vm->Compiler != NULL) {
+        CkpKissCompiler(Vm, Vm->Compiler);
+    }
+
+    CkpKissRoot(Vm, &(Vm->UnhandledException->Header));
+
+    //
+    // Old objects that may point at young objects are roots for a young
+    // collection.
+    //
+
+    if (Full == FALSE) {
+        for (Index = 0; Index < Vm->RememberedCount; Index += 1) {
+            CkpKissRoot(Vm, Vm->Remembered[Index]);
+        }
+    }
+
+    CkpDeeplyKiss(Vm, &KissHead);
+    CkpCollectUnkissedObjects(Vm, &KissHead);
+    Vm->TotalGarbageFreed += Vm->GarbageFreed;
+    if (Vm->GarbageKissed > Vm->MaxGarbageKissed) {
+        Vm->MaxGarbageKissed = Vm->GarbageKissed;
+    }
+
+    //
+    // The survivors of a young collection are now old. The full collection
+    // threshold stays where it was, so that the growing old generation
+    // eventually triggers a full collection.
+    //
+
+    if (Full == FALSE) {
+        Vm->GcFlags &= ~CK_GC_YOUNG_COLLECTION;
+        Vm->OldBytes += Vm->BytesAllocated;
+        Vm->BytesAllocated = Vm->OldBytes;
+
+    } else {
+        Vm->OldBytes = Vm->BytesAllocated;
+    }
+
+    Nursery = Vm->OldBytes >> CK_NURSERY_OLD_SHIFT;
+    if (Nursery < Vm->Configuration.NurserySize) {
+        Nursery = Vm->Configuration.NurserySize;
+    }
+
+    Vm->NextYoungCollection = Vm->OldBytes + Nursery;
+    if (Full == FALSE) {
+        return;
+    }
+
+    //
+    // Determine the next garbage collection time, expressed as an additional
+    // percentage growth. Except rather than using percent 100 exactly, use
+    // 1024 to avoid the divide. It looks nearly the same as percent times 10.
+    //
+
+    Hysteresis = Vm->BytesAllocated * Vm->Configuration.HeapGrowthPercent /
+                 1024;
+
+    NextThreshold = Vm->BytesAllocated + Hysteresis;
+
+    //
+    // Avoid ratcheting down the threshold little by little. Go down by the
+    // same chunk as going up.
+    //
+
+    if (NextThreshold < Vm->NextGarbageCollection) {
+        if (Vm->BytesAllocated > Hysteresis) {
+            Minimum = Vm->BytesAllocated - Hysteresis;
+            if (NextThreshold > Minimum) {
+                NextThreshold = Vm->NextGarbageCollection;
+            }
+        }
+    }
+
+    if (NextThreshold < Vm->Configuration.MinimumHeapSize) {
+        NextThreshold = Vm->Configuration.MinimumHeapSize;
+    }
+
+    Vm->NextGarbageCollection = NextThreshold;
+    return;
+}
+
 VOID
 CkpKissCompiler (
     PCK_VM Vm,
@@ -532,6 +760,49 @@ Return Value:
 
 --*/
 
+{
+
+    //
+    // Young collections don't traverse old objects, as they're assumed to be
+    // alive. The ones that might point at young objects are in the remembered
+    // set.
+    //
+
+    if ((Object != NULL) &&
+        (((Object->Flags & CK_OBJECT_OLD) == 0) ||
+         ((Vm->GcFlags & CK_GC_YOUNG_COLLECTION) == 0))) {
+
+        CkpKissRoot(Vm, Object);
+    }
+
+    return;
+}
+
+VOID
+CkpKissRoot (
+    PCK_VM Vm,
+    PCK_OBJECT Object
+    )
+
+/*++
+
+Routine Description:
+
+    This routine kisses an object regardless of its generation, causing it to
+    be traversed during the garbage collection pass currently in progress.
+
+Arguments:
+
+    Vm - Supplies a pointer to the virtual machine.
+
+    Object - Supplies a pointer to the object to kiss.
+
+Return Value:
+
+    None.
+
+--*/
+
 {
 
     PCK_OBJECT End;
@@ -580,7 +851,14 @@ Return Value:
 
 {
 
+    UINTN BytesAllocated;
     PCK_OBJECT Object;
+    BOOL Young;
+
+    Young = FALSE;
+    if ((Vm->GcFlags & CK_GC_YOUNG_COLLECTION) != 0) {
+        Young = TRUE;
+    }
 
     //
     // Loop through all the objects on the kiss list. Kissing these objects
@@ -589,6 +867,8 @@ Return Value:
 
     Object = Head->NextKiss;
     while (Object != Head) {
+        Vm->GarbageKissed += 1;
+        BytesAllocated = Vm->BytesAllocated;
         switch (Object->Type) {
         case CkObjectClass:
             CkpKissClass(Vm, (PCK_CLASS)Object);
@@ -645,6 +925,15 @@ Return Value:
             break;
         }
 
+        //
+        // Old objects traversed during a young collection are already
+        // accounted for in the old bytes.
+        //
+
+        if ((Young != FALSE) && ((Object->Flags & CK_OBJECT_OLD) != 0)) {
+            Vm->BytesAllocated = BytesAllocated;
+        }
+
         Object = Object->NextKiss;
     }
 
@@ -653,19 +942,24 @@ Return Value:
 
 VOID
 CkpCollectUnkissedObjects (
-    PCK_VM Vm
+    PCK_VM Vm,
+    PCK_OBJECT Head
     )
 
 /*++
 
 Routine Description:
 
-    This routine garbage collects any objects that have not been kissed.
+    This routine garbage collects any objects that have not been kissed, and
+    promotes the young objects that survived to the old generation.
 
 Arguments:
 
     Vm - Supplies a pointer to the virtual machine.
 
+    Head - Supplies a pointer to a dummy object representing the head of the
+        kiss list.
+
 Return Value:
 
     None.
@@ -674,13 +968,67 @@ Return Value:
 
 {
 
+    PCK_OBJECT Current;
     PCK_OBJECT DeadAndAlone;
     ULONG DestroyCount;
+    UINTN Index;
+    PCK_OBJECT Next;
     PCK_OBJECT *Object;
 
     DestroyCount = 0;
-    Object = &(Vm->FirstObject);
-    while (*Object != NULL) {
+
+    //
+    // For young collections, old objects were only kissed so their contents
+    // would be traversed. Reset them, leaving only young objects marked.
+    //
+
+    if ((Vm->GcFlags & CK_GC_YOUNG_COLLECTION) != 0) {
+        Current = Head->NextKiss;
+        while (Current != Head) {
+            Next = Current->NextKiss;
+            if ((Current->Flags & CK_OBJECT_OLD) != 0) {
+                Current->NextKiss = NULL;
+            }
+
+            Current = Next;
+        }
+
+        CkpTrimRememberedSet(Vm);
+
+    //
+    // For full collections, sweep the old generation too, and rebuild the
+    // remembered set from scratch.
+    //
+
+    } else {
+        Vm->RememberedCount = 0;
+        Object = &(Vm->FirstOldObject);
+        while (*Object != NULL) {
+            if ((*Object)->NextKiss != NULL) {
+                (*Object)->NextKiss = NULL;
+                (*Object)->Flags &= ~CK_OBJECT_REMEMBERED;
+                if (CK_GC_ALWAYS_REMEMBERED((*Object)->Type)) {
+                    CkpRememberObject(Vm, *Object);
+                }
+
+                Object = &((*Object)->Next);
+
+            } else {
+                DeadAndAlone = *Object;
+                *Object = DeadAndAlone->Next;
+                CkpDestroyObject(Vm, DeadAndAlone);
+                DestroyCount += 1;
+            }
+        }
+    }
+
+    //
+    // Sweep the young generation, moving survivors over to the old list.
+    //
+
+    Current = Vm->FirstObject;
+    Vm->FirstObject = NULL;
+    while (Current != NULL) {
 
         //
         // Take this opportunity to ensure that all objects have classes.
@@ -688,19 +1036,27 @@ Return Value:
         // early init.
         //
 
-        CK_ASSERT(((*Object)->Class != NULL) ||
-                  ((*Object)->Type == CkObjectFunction) ||
-                  ((*Object)->Type == CkObjectUpvalue) ||
+        CK_ASSERT((Current->Class != NULL) ||
+                  (Current->Type == CkObjectFunction) ||
+                  (Current->Type == CkObjectUpvalue) ||
                   (Vm->Class.Class == NULL) ||
                   (Vm->Class.Class->Flags == 0));
 
+        Next = Current->Next;
+
         //
-        // If the object has been kissed, then reset it for next time.
+        // If the object has been kissed, then reset it for next time and
+        // promote it.
         //
 
-        if ((*Object)->NextKiss != NULL) {
-            (*Object)->NextKiss = NULL;
-            Object = &((*Object)->Next);
+        if (Current->NextKiss != NULL) {
+            Current->NextKiss = NULL;
+            Current->Flags |= CK_OBJECT_OLD;
+            Current->Next = Vm->FirstOldObject;
+            Vm->FirstOldObject = Current;
+            if (CK_GC_ALWAYS_REMEMBERED(Current->Type)) {
+                CkpRememberObject(Vm, Current);
+            }
 
         //
         // The object was never kissed. No one loves it, and it serves no
@@ -708,11 +1064,20 @@ Return Value:
         //
 
         } else {
-            DeadAndAlone = *Object;
-            *Object = DeadAndAlone->Next;
-            CkpDestroyObject(Vm, DeadAndAlone);
+            CkpDestroyObject(Vm, Current);
             DestroyCount += 1;
         }
+
+        Current = Next;
+    }
+
+    //
+    // Working objects may be in the middle of being initialized, and aren't
+    // necessarily going through the write barrier yet.
+    //
+
+    for (Index = 0; Index < Vm->WorkingObjectCount; Index += 1) {
+        CK_WRITE_BARRIER(Vm, Vm->WorkingObjects[Index]);
     }
 
     Vm->GarbageFreed = DestroyCount;
@@ -725,6 +1090,51 @@ Return Value:
     return;
 }
 
+VOID
+CkpTrimRememberedSet (
+    PCK_VM Vm
+    )
+
+/*++
+
+Routine Description:
+
+    This routine removes objects from the remembered set after a young
+    collection. Everything those objects pointed to is now old, so only the
+    objects that are stored to without a write barrier need to stay.
+
+Arguments:
+
+    Vm - Supplies a pointer to the virtual machine.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    UINTN Count;
+    UINTN Index;
+    PCK_OBJECT Object;
+
+    Count = 0;
+    for (Index = 0; Index < Vm->RememberedCount; Index += 1) {
+        Object = Vm->Remembered[Index];
+        if (CK_GC_ALWAYS_REMEMBERED(Object->Type)) {
+            Vm->Remembered[Count] = Object;
+            Count += 1;
+
+        } else {
+            Object->Flags &= ~CK_OBJECT_REMEMBERED;
+        }
+    }
+
+    Vm->RememberedCount = Count;
+    return;
+}
+
 VOID
 CkpKissClass (
     PCK_VM Vm,
@@ -1002,7 +1412,8 @@ Return Value:
     Vm->BytesAllocated += sizeof(CK_FUNCTION) +
                           (sizeof(UCHAR) * Function->Code.Capacity) +
                           (sizeof(UCHAR) *
-                           Function->Debug.LineProgram.Capacity);
+                           Function->Debug.LineProgram.Capacity) +
+                          (sizeof(CK_METHOD_CACHE) * Function->CallSiteCount);
 
     return;
 }
@@ -1114,7 +1525,7 @@ Return Value:
     CkpKissObject(Vm, &(Module->Name->Header));
     CkpKissObject(Vm, &(Module->Path->Header));
     CkpKissObject(Vm, &(Module->Closure->Header));
-    Vm->BytesAllocated = sizeof(CK_MODULE);
+    Vm->BytesAllocated += sizeof(CK_MODULE);
     return;
 }
 
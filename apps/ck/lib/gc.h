@@ -30,6 +30,21 @@ Module Name:
 // ---------------------------------------------------------------- Definitions
 //
 
+//
+// This macro must be invoked after a reference is stored into an instance,
+// list, or dictionary object. If the object is old, it is added to the
+// remembered set so that the next young collection finds the new reference.
+// Other object types are always treated as remembered once they're old, and
+// don't need this.
+//
+
+#define CK_WRITE_BARRIER(_Vm, _Object)                                      \
+    if (((_Object)->Flags & (CK_OBJECT_OLD | CK_OBJECT_REMEMBERED)) ==      \
+        CK_OBJECT_OLD) {                                                    \
+                                                                            \
+        CkpRememberObject((_Vm), (_Object));                                \
+    }
+
 //
 // ------------------------------------------------------ Data Type Definitions
 //
@@ -89,6 +104,32 @@ Return Value:
 
 --*/
 
+VOID
+CkpRememberObject (
+    PCK_VM Vm,
+    PCK_OBJECT Object
+    );
+
+/*++
+
+Routine Description:
+
+    This routine adds an old object to the remembered set, causing it to be
+    traversed during the next young collection. Callers usually use the
+    write barrier macro rather than calling this directly.
+
+Arguments:
+
+    Vm - Supplies a pointer to the virtual machine.
+
+    Object - Supplies a pointer to the old object that was modified.
+
+Return Value:
+
+    None.
+
+--*/
+
 PVOID
 CkpReallocate (
     PCK_VM Vm,
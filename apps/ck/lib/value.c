@@ -280,6 +280,54 @@ Return Value:
     return Function;
 }
 
+BOOL
+CkpFunctionAllocateMethodCaches (
+    PCK_VM Vm,
+    PCK_FUNCTION Function
+    )
+
+/*++
+
+Routine Description:
+
+    This routine allocates the inline method caches for a function whose
+    bytecode is complete.
+
+Arguments:
+
+    Vm - Supplies a pointer to the virtual machine.
+
+    Function - Supplies a pointer to the function. The call site count must
+        already be filled in.
+
+Return Value:
+
+    TRUE on success.
+
+    FALSE on allocation failure.
+
+--*/
+
+{
+
+    UINTN Size;
+
+    CK_ASSERT(Function->MethodCaches == NULL);
+
+    if (Function->CallSiteCount == 0) {
+        return TRUE;
+    }
+
+    Size = Function->CallSiteCount * sizeof(CK_METHOD_CACHE);
+    Function->MethodCaches = CkAllocate(Vm, Size);
+    if (Function->MethodCaches == NULL) {
+        return FALSE;
+    }
+
+    CkZero(Function->MethodCaches, Size);
+    return TRUE;
+}
+
 VOID
 CkpDestroyObject (
     PCK_VM Vm,
@@ -319,6 +367,11 @@ Return Value:
         CkpClearArray(Vm, &(Function->Constants));
         CkpClearArray(Vm, &(Function->Code));
         CkpClearArray(Vm, &(Function->Debug.LineProgram));
+        if (Function->MethodCaches != NULL) {
+            CkFree(Vm, Function->MethodCaches);
+            Function->MethodCaches = NULL;
+        }
+
         break;
 
     case CkObjectForeign:
@@ -398,6 +451,7 @@ Return Value:
 {
 
     Object->Type = Type;
+    Object->Flags = 0;
     Object->NextKiss = NULL;
     Object->Class = Class;
     Object->Next = Vm->FirstObject;
@@ -675,6 +729,8 @@ Return Value:
     Class->FieldCount = FieldCount;
     Class->Name = Name;
     Class->Module = Module;
+    Vm->MethodVersion += 1;
+    Class->MethodVersion = Vm->MethodVersion;
     CkpPushRoot(Vm, &(Class->Header));
     Class->Methods = CkpDictCreate(Vm);
     CkpPopRoot(Vm);
@@ -723,6 +779,14 @@ Return Value:
     CK_OBJECT_VALUE(Value, Closure);
     CkpDictSet(Vm, Class->Methods, Signature, Value);
 
+    //
+    // Give the class a new method version, which invalidates any inline
+    // method caches that have seen it.
+    //
+
+    Vm->MethodVersion += 1;
+    Class->MethodVersion = Vm->MethodVersion;
+
     //
     // Bind the closure to the class, so that when it's run it knows 1) where
     // its fields start and 2) what its superclass is.
@@ -769,6 +833,8 @@ Return Value:
     //
 
     CkpDictCombine(Vm, Class->Methods, Super->Methods);
+    Vm->MethodVersion += 1;
+    Class->MethodVersion = Vm->MethodVersion;
     return;
 }
 
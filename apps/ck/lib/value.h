@@ -113,11 +113,29 @@ Module Name:
 #define CK_CLASS_SPECIAL_CREATION 0x00000002
 #define CK_CLASS_FOREIGN 0x00000004
 
+//
+// Define the number of classes each call site remembers in its inline method
+// cache before it starts evicting entries.
+//
+
+#define CK_METHOD_CACHE_SIZE 4
+
+//
+// Define the object header flags used by the garbage collector. Old objects
+// have survived at least one collection and are only freed by full
+// collections. Remembered objects are old objects that may point at young
+// objects, and are traversed during every young collection.
+//
+
+#define CK_OBJECT_OLD 0x00000001
+#define CK_OBJECT_REMEMBERED 0x00000002
+
 //
 // ------------------------------------------------------ Data Type Definitions
 //
 
 typedef struct _CK_CLASS CK_CLASS, *PCK_CLASS;
+typedef struct _CK_CLOSURE CK_CLOSURE, *PCK_CLOSURE;
 typedef struct _CK_FIBER CK_FIBER, *PCK_FIBER;
 typedef struct _CK_OBJECT CK_OBJECT, *PCK_OBJECT;
 typedef struct _CK_UPVALUE CK_UPVALUE, *PCK_UPVALUE;
@@ -273,6 +291,9 @@ Structure Description:
     Type - Stores the type of the object, which defines the parent type this
         structure is embedded in.
 
+    Flags - Stores a bitfield of garbage collection flags. See CK_OBJECT_*
+        definitions.
+
     NextKiss - Stores a pointer to the next object in the list of kissed
         objects (objects that will not get garbage collected this time).
 
@@ -285,6 +306,7 @@ Structure Description:
 
 struct _CK_OBJECT {
     CK_OBJECT_TYPE Type;
+    ULONG Flags;
     PCK_OBJECT NextKiss;
     PCK_OBJECT Next;
     PCK_CLASS Class;
@@ -462,6 +484,53 @@ typedef struct _CK_FUNCTION_DEBUG {
 
 /*++
 
+Structure Description:
+
+    This structure defines a single entry in a call site's method cache.
+
+Members:
+
+    Version - Stores the method version of the class the entry was filled
+        from. Method versions are unique across all classes in the VM, and
+        change whenever a method is bound to the class, so a match means both
+        that the receiver class is the same and that its methods are unchanged.
+        Zero indicates an empty entry.
+
+    Method - Stores a pointer to the method closure that the class resolved
+        to. This is not a reference: the class's method dictionary keeps the
+        closure alive for as long as the version matches.
+
+--*/
+
+typedef struct _CK_METHOD_CACHE_ENTRY {
+    UINTN Version;
+    PCK_CLOSURE Method;
+} CK_METHOD_CACHE_ENTRY, *PCK_METHOD_CACHE_ENTRY;
+
+/*++
+
+Structure Description:
+
+    This structure defines the inline method cache for a single call site.
+    A call site that only ever sees one class uses only the first entry
+    (monomorphic). Sites that see a few classes fill the remaining entries
+    (polymorphic), and beyond that entries are replaced round robin.
+
+Members:
+
+    Entries - Stores the cached class to method mappings.
+
+    Next - Stores the index of the entry to fill on the next miss.
+
+--*/
+
+typedef struct _CK_METHOD_CACHE {
+    CK_METHOD_CACHE_ENTRY Entries[CK_METHOD_CACHE_SIZE];
+    ULONG Next;
+} CK_METHOD_CACHE, *PCK_METHOD_CACHE;
+
+/*++
+
 Structure Description:
 
     This structure defines a function object.
@@ -485,6 +554,12 @@ Structure Description:
     Debug - Stores a pointer to the debug information, which translates
         bytecode back to line numbers.
 
+    CallSiteCount - Stores the number of method call sites in the bytecode.
+        Each call instruction carries the index of its call site.
+
+    MethodCaches - Stores a pointer to the array of inline method caches, one
+        for each call site.
+
 --*/
 
 typedef struct _CK_FUNCTION {
@@ -496,6 +571,8 @@ typedef struct _CK_FUNCTION {
     CK_SYMBOL_INDEX UpvalueCount;
     CK_ARITY Arity;
     CK_FUNCTION_DEBUG Debug;
+    CK_SYMBOL_INDEX CallSiteCount;
+    PCK_METHOD_CACHE MethodCaches;
 } CK_FUNCTION, *PCK_FUNCTION;
 
 /*++
@@ -604,13 +681,13 @@ Structure Description:
 
 --*/
 
-typedef struct _CK_CLOSURE {
+struct _CK_CLOSURE {
     CK_OBJECT Header;
     CK_CLOSURE_TYPE Type;
     CK_CLOSURE_UNION U;
     PCK_CLASS Class;
     PCK_UPVALUE *Upvalues;
-} CK_CLOSURE, *PCK_CLOSURE;
+};
 
 /*++
 
@@ -691,6 +768,10 @@ Structure Description:
     Flags - Stores flags describing special behaviors of this class. See
         CK_CLASS_* definitions.
 
+    MethodVersion - Stores a VM-wide unique number that changes whenever the
+        method dictionary changes. Inline method caches compare against this
+        to determine whether their entries are still valid.
+
 --*/
 
 struct _CK_CLASS {
@@ -702,6 +783,7 @@ struct _CK_CLASS {
     PCK_STRING Name;
     PCK_MODULE Module;
     ULONG Flags;
+    UINTN MethodVersion;
 };
 
 /*++
@@ -1059,6 +1141,34 @@ Return Value:
 
 --*/
 
+BOOL
+CkpFunctionAllocateMethodCaches (
+    PCK_VM Vm,
+    PCK_FUNCTION Function
+    );
+
+/*++
+
+Routine Description:
+
+    This routine allocates the inline method caches for a function whose
+    bytecode is complete.
+
+Arguments:
+
+    Vm - Supplies a pointer to the virtual machine.
+
+    Function - Supplies a pointer to the function. The call site count must
+        already be filled in.
+
+Return Value:
+
+    TRUE on success.
+
+    FALSE on allocation failure.
+
+--*/
+
 VOID
 CkpDestroyObject (
     PCK_VM Vm,
@@ -66,6 +66,7 @@ Module Name:
 #define CKI_READ_ARITY(_Value) CKI_READ_BYTE(_Value)
 #define CKI_READ_SYMBOL(_Value) CKI_READ_SHORT(_Value)
 #define CKI_READ_OFFSET(_Value) CKI_READ_SHORT(_Value)
+#define CKI_READ_CALL_SITE(_Value) CKI_READ_SHORT(_Value)
 
 //
 // These macros sync up the pieces of the VM state that are kept in local
@@ -307,6 +308,15 @@ CkpValidateSuperclass (
     CK_SYMBOL_INDEX FieldCount
     );
 
+BOOL
+CkpCallCachedMethod (
+    PCK_VM Vm,
+    PCK_CLASS Class,
+    CK_VALUE MethodName,
+    CK_ARITY Arity,
+    PCK_METHOD_CACHE Cache
+    );
+
 //
 // -------------------------------------------------------------------- Globals
 //
@@ -400,6 +410,7 @@ Return Value:
     }
 
     Vm->NextGarbageCollection = Vm->Configuration.InitialHeapSize;
+    Vm->NextYoungCollection = Vm->Configuration.NurserySize;
     Vm->Modules = CkpDictCreate(Vm);
     if (Vm->Modules == NULL) {
         Status = CkErrorNoMemory;
@@ -466,6 +477,18 @@ Return Value:
     }
 
     Vm->FirstObject = NULL;
+    Object = Vm->FirstOldObject;
+    while (Object != NULL) {
+        Next = Object->Next;
+        CkpDestroyObject(Vm, Object);
+        Object = Next;
+    }
+
+    Vm->FirstOldObject = NULL;
+    if (Vm->Remembered != NULL) {
+        CkRawFree(Vm, Vm->Remembered);
+        Vm->Remembered = NULL;
+    }
 
     //
     // Null out the reallocate function to catch double frees.
@@ -1039,6 +1062,7 @@ Return Value:
         CK_ASSERT(Symbol < Instance->Header.Class->FieldCount);
 
         Instance->Fields[Symbol] = CKI_STACK_TOP();
+        CK_WRITE_BARRIER(Vm, &(Instance->Header));
         CKI_DISPATCH();
 
     CKI_CASE(CkOpLoadField):
@@ -1067,6 +1091,7 @@ Return Value:
         CK_ASSERT(Symbol < Instance->Header.Class->FieldCount);
 
         Instance->Fields[Symbol] = CKI_STACK_TOP();
+        CK_WRITE_BARRIER(Vm, &(Instance->Header));
         CKI_DISPATCH();
 
     CKI_CASE(CkOpPop):
@@ -1084,11 +1109,20 @@ Return Value:
     CKI_CASE(CkOpCall8):
         Arity = Instruction - CkOpCall0 + 1;
         CKI_READ_SYMBOL(Symbol);
+        CKI_READ_CALL_SITE(Index);
+
+        CK_ASSERT(Index < Function->CallSiteCount);
+
         Arguments = Fiber->StackTop - Arity;
         Class = CkpGetClass(Vm, Arguments[0]);
         MethodName = Function->Module->Strings.List.Data[Symbol];
         CKI_STORE_FRAME();
-        CkpCallMethod(Vm, Class, MethodName, Arity);
+        CkpCallCachedMethod(Vm,
+                            Class,
+                            MethodName,
+                            Arity,
+                            &(Function->MethodCaches[Index]));
+
         CKI_LOAD_FIBER();
         CKI_DISPATCH();
 
@@ -1096,11 +1130,20 @@ Return Value:
         CKI_READ_ARITY(Arity);
         Arity += 1;
         CKI_READ_SYMBOL(Symbol);
+        CKI_READ_CALL_SITE(Index);
+
+        CK_ASSERT(Index < Function->CallSiteCount);
+
         Arguments = Fiber->StackTop - Arity;
         Class = CkpGetClass(Vm, Arguments[0]);
         MethodName = Function->Module->Strings.List.Data[Symbol];
         CKI_STORE_FRAME();
-        CkpCallMethod(Vm, Class, MethodName, Arity);
+        CkpCallCachedMethod(Vm,
+                            Class,
+                            MethodName,
+                            Arity,
+                            &(Function->MethodCaches[Index]));
+
         CKI_LOAD_FIBER();
         CKI_DISPATCH();
 
@@ -1115,11 +1158,20 @@ Return Value:
     CKI_CASE(CkOpSuperCall8):
         Arity = Instruction - CkOpSuperCall0 + 1;
         CKI_READ_SYMBOL(Symbol);
+        CKI_READ_CALL_SITE(Index);
+
+        CK_ASSERT(Index < Function->CallSiteCount);
+
         Arguments = Fiber->StackTop - Arity;
         Class = Frame->Closure->Class->Super;
         MethodName = Function->Module->Strings.List.Data[Symbol];
         CKI_STORE_FRAME();
-        CkpCallMethod(Vm, Class, MethodName, Arity);
+        CkpCallCachedMethod(Vm,
+                            Class,
+                            MethodName,
+                            Arity,
+                            &(Function->MethodCaches[Index]));
+
         CKI_LOAD_FIBER();
         CKI_DISPATCH();
 
@@ -1127,11 +1179,20 @@ Return Value:
         CKI_READ_ARITY(Arity);
         Arity += 1;
         CKI_READ_SYMBOL(Symbol);
+        CKI_READ_CALL_SITE(Index);
+
+        CK_ASSERT(Index < Function->CallSiteCount);
+
         Arguments = Fiber->StackTop - Arity;
         Class = Frame->Closure->Class->Super;
         MethodName = Function->Module->Strings.List.Data[Symbol];
         CKI_STORE_FRAME();
-        CkpCallMethod(Vm, Class, MethodName, Arity);
+        CkpCallCachedMethod(Vm,
+                            Class,
+                            MethodName,
+                            Arity,
+                            &(Function->MethodCaches[Index]));
+
         CKI_LOAD_FIBER();
         CKI_DISPATCH();
 
@@ -1984,3 +2045,85 @@ Return Value:
     return TRUE;
 }
 
+BOOL
+CkpCallCachedMethod (
+    PCK_VM Vm,
+    PCK_CLASS Class,
+    CK_VALUE MethodName,
+    CK_ARITY Arity,
+    PCK_METHOD_CACHE Cache
+    )
+
+/*++
+
+Routine Description:
+
+    This routine invokes a class instance method from a call site, using the
+    call site's inline method cache to avoid looking the method up by name in
+    the common case.
+
+Arguments:
+
+    Vm - Supplies a pointer to the virtual machine.
+
+    Class - Supplies a pointer to the class that owns the method.
+
+    MethodName - Supplies the name of the method to look up on the class.
+
+    Arity - Supplies the number of arguments the method was called with in
+        code (plus one for the receiver).
+
+    Cache - Supplies a pointer to the inline method cache of the call site.
+
+Return Value:
+
+    TRUE if a new frame was pushed onto the stack and needs to be run by the
+    interpreter.
+
+    FALSE if the call completed already (primitive and foreign functions fit
+    this category).
+
+--*/
+
+{
+
+    PCK_CLOSURE Closure;
+    PCK_METHOD_CACHE_ENTRY Entry;
+    ULONG Index;
+    CK_VALUE Method;
+
+    for (Index = 0; Index < CK_METHOD_CACHE_SIZE; Index += 1) {
+        Entry = &(Cache->Entries[Index]);
+        if (Entry->Version == Class->MethodVersion) {
+            return CkpCallFunction(Vm, Entry->Method, Arity);
+        }
+    }
+
+    //
+    // Miss. Do the full lookup, and let the regular path report the error if
+    // the method doesn't exist.
+    //
+
+    Method = CkpDictGet(Class->Methods, MethodName);
+    if (CK_IS_UNDEFINED(Method)) {
+        return CkpCallMethod(Vm, Class, MethodName, Arity);
+    }
+
+    //
+    // Fill the next entry. The first miss makes the site monomorphic, the
+    // next few make it polymorphic, and after that the oldest entries get
+    // replaced.
+    //
+
+    Closure = CK_AS_CLOSURE(Method);
+    Entry = &(Cache->Entries[Cache->Next]);
+    Entry->Version = Class->MethodVersion;
+    Entry->Method = Closure;
+    Cache->Next += 1;
+    if (Cache->Next == CK_METHOD_CACHE_SIZE) {
+        Cache->Next = 0;
+    }
+
+    return CkpCallFunction(Vm, Closure, Arity);
+}
+
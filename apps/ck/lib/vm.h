@@ -54,6 +54,23 @@ Module Name:
 
 #define CK_MAX_WORKING_OBJECTS 6
 
+//
+// Define garbage collector state flags.
+//
+
+//
+// This flag is set while a young collection is in progress.
+//
+
+#define CK_GC_YOUNG_COLLECTION 0x00000001
+
+//
+// This flag is set if an old object could not be added to the remembered set,
+// meaning the next collection must be a full one.
+//
+
+#define CK_GC_FULL_REQUIRED 0x00000002
+
 //
 // Define a reasonable size for error messages.
 //
@@ -148,31 +165,37 @@ Enumeration Description:
     CkOpPop - Pops and discards the top of the stack.
 
     CkOpCall0 - Invokes the method with the symbol specified by the next
-        instruction word. The opcode number describes the number of arguments
-        that have already been pushed (not including the receiver). Subsequent
-        opcodes code for 1-7 arguments, respectively.
+        instruction word. The word after that is the index of the call site,
+        which selects the inline method cache used to speed up the lookup.
+        The opcode number describes the number of arguments that have already
+        been pushed (not including the receiver). Subsequent opcodes code for
+        1-7 arguments, respectively.
 
     CkOpCall8 - Invokes the method with the symbol specified by the next
-        instruction word, with 8 arguments.
+        instruction word and the call site specified by the subsequent word,
+        with 8 arguments.
 
     CkOpCall - Invokes the method with the number of arguments specified by the
         next instruction byte. The symbol is specified by the subsequent
-        instruction word.
+        instruction word, and the call site by the word after that.
 
     CkOpIndirectCall - Invokes the method with the number of arguments
         specified by the next instruction byte. The method to call is pushed
         in the receiver slot on the stack.
 
     CkOpSuperCall0 - Invokes a method on the superclass with the symbol
-        given by the next instruction word. The opcode specifies the number of
-        arguments (the next 8 opcodes code for 1-8 arguments).
+        given by the next instruction word and the call site given by the
+        subsequent word. The opcode specifies the number of arguments (the
+        next 8 opcodes code for 1-8 arguments).
 
     CkOpSuperCall8 - Invokes a method on the superclass with the symbol given
-        by the next instruction word, specifying 8 arguments.
+        by the next instruction word and the call site given by the word after
+        that, specifying 8 arguments.
 
     CkOpSuperCall - Invokes a method on the superclass with the number of
         arguments in the next instruction byte. The subsequent instruction word
-        specifies the symbol to invoke.
+        specifies the symbol to invoke, and the word after that specifies the
+        call site.
 
     CkOpJump - Moves the instruction pointer forward by the number of bytes
         specified in the following instruction word.
@@ -383,14 +406,15 @@ Structure Description:
     NextGarbageCollection - Stores the size that the allocated bytes have to
         get to in order to trigger the next garbage collection.
 
-    GarbageRuns - Stores the number of times the garbage collector has run.
+    GarbageRuns - Stores the number of times the full garbage collector has
+        run.
 
     GarbageFreed - Stores the number of objects freed during the most recent
         garbage collection run.
 
-    FirstObject - Stores a pointer to the first object in the massive singly
-        linked list of all living objects. This is the list that the garbage
-        collector traverses.
+    FirstObject - Stores a pointer to the first object in the singly linked
+        list of young objects, those allocated since the last garbage
+        collection. This is the list that a young collection traverses.
 
     KissList - Stores the tail of the list of objects that have been kissed.
         The list is circular to ensure that the last object has a non-null
@@ -422,6 +446,45 @@ Structure Description:
     Context - Stores an opaque user context pointer that can be used by whoever
         is integrating the Chalk library.
 
+    MethodVersion - Stores the most recently handed out class method version.
+        Each class gets a new version from this counter whenever its methods
+        change, which is what invalidates inline method caches.
+
+    FirstOldObject - Stores a pointer to the first object in the singly linked
+        list of objects that have survived a garbage collection. These are
+        only freed by full collections.
+
+    OldBytes - Stores the number of bytes belonging to old objects as of the
+        most recent collection.
+
+    NextYoungCollection - Stores the size that the allocated bytes have to get
+        to in order to trigger the next young collection. This is the old
+        bytes plus a nursery that grows with the old generation.
+
+    Remembered - Stores an array of old objects that may point at young
+        objects. These are treated as roots during young collections.
+
+    RememberedCount - Stores the number of valid elements in the remembered
+        array.
+
+    RememberedCapacity - Stores the number of elements the remembered array
+        can hold before it must be reallocated.
+
+    GcFlags - Stores a bitfield of garbage collector state. See CK_GC_*
+        definitions.
+
+    YoungGarbageRuns - Stores the number of times a young collection has run.
+
+    TotalGarbageFreed - Stores the total number of objects freed by all
+        garbage collection runs.
+
+    GarbageKissed - Stores the number of objects traversed during the most
+        recent garbage collection, which is roughly proportional to its pause
+        time.
+
+    MaxGarbageKissed - Stores the largest number of objects traversed during
+        any single garbage collection.
+
 --*/
 
 struct _CK_VM {
@@ -443,6 +506,18 @@ struct _CK_VM {
     INT MemoryException;
     PCK_CLOSURE UnhandledException;
     PVOID Context;
+    UINTN MethodVersion;
+    PCK_OBJECT FirstOldObject;
+    UINTN OldBytes;
+    UINTN NextYoungCollection;
+    PCK_OBJECT *Remembered;
+    UINTN RememberedCount;
+    UINTN RememberedCapacity;
+    ULONG GcFlags;
+    ULONG YoungGarbageRuns;
+    ULONGLONG TotalGarbageFreed;
+    UINTN GarbageKissed;
+    UINTN MaxGarbageKissed;
 };
 
 //
@@ -1047,3 +1122,31 @@ Return Value:
 
 --*/
 
+BOOL
+CkpModuleIsFrozenCurrent (
+    PCSTR Contents,
+    UINTN Size
+    );
+
+/*++
+
+Routine Description:
+
+    This routine determines whether the given frozen module was written in the
+    freeze format this VM understands. Only the header needs to be supplied.
+
+Arguments:
+
+    Contents - Supplies the beginning of the frozen module contents.
+
+    Size - Supplies the number of bytes of contents available.
+
+Return Value:
+
+    TRUE if the contents are a frozen module of the current format version.
+
+    FALSE if the contents are not a frozen module or are from a different
+    version.
+
+--*/
+
@@ -52,6 +52,14 @@ Module Name:
 #define CK_INITIAL_HEAP_DEFAULT (1024 * 1024 * 10)
 #define CK_MINIMUM_HEAP_DEFAULT (1024 * 1024)
 #define CK_HEAP_GROWTH_DEFAULT 512
+#define CK_NURSERY_SIZE_DEFAULT (1024 * 1024)
+
+//
+// Define the number of bytes read from the front of an object file to check
+// its format version.
+//
+
+#define CK_FROZEN_HEADER_SIZE 64
 
 //
 // ------------------------------------------------------ Data Type Definitions
@@ -146,7 +154,8 @@ CK_CONFIGURATION CkDefaultConfiguration = {
     CK_INITIAL_HEAP_DEFAULT,
     CK_MINIMUM_HEAP_DEFAULT,
     CK_HEAP_GROWTH_DEFAULT,
-    0
+    0,
+    CK_NURSERY_SIZE_DEFAULT
 };
 
 //
@@ -583,6 +592,8 @@ Return Value:
 
     FILE *File;
     off_t FileSize;
+    CHAR Header[CK_FROZEN_HEADER_SIZE];
+    size_t HeaderSize;
     CK_LOAD_MODULE_RESULT LoadStatus;
     CHAR ObjectPath[PATH_MAX];
     INT ObjectPathLength;
@@ -693,6 +704,24 @@ Return Value:
         ((SourceStatus != 0) || (ObjectStat.st_mtime >= Stat.st_mtime))) {
 
         File = fopen(ObjectPath, "rb");
+
+        //
+        // Object files written by a different version of Chalk can't be
+        // loaded. Skip those in favor of the source, which will get compiled
+        // and saved back out in the current format.
+        //
+
+        if ((File != NULL) && (SourceStatus == 0)) {
+            HeaderSize = fread(Header, 1, sizeof(Header) - 1, File);
+            Header[HeaderSize] = '\0';
+            if ((!CkpModuleIsFrozenCurrent(Header, HeaderSize)) ||
+                (fseek(File, 0, SEEK_SET) != 0)) {
+
+                fclose(File);
+                File = NULL;
+            }
+        }
+
         if (File != NULL) {
             FileSize = ObjectStat.st_size;
             PathLength = ObjectPathLength;
@@ -108,6 +108,7 @@ function build() {
         "dirio.c",
         "dynlib.c",
         "env.c",
+        "epoll.c",
         "err.c",
         "errno.c",
         "exec.c",
@@ -121,6 +122,7 @@ function build() {
         "if.c",
         "inet.c",
         "init.c",
+        "ioring.c",
         "kerror.c",
         "langinfo.c",
         "line.c",
@@ -165,6 +167,7 @@ function build() {
         "stream.c",
         "streamex.c",
         "string.c",
+        "strvec.c",
         "sysconf.c",
         "syslog.c",
         "system.c",
@@ -189,7 +192,8 @@ function build() {
         "getopt.c",
         "qsort.c",
         "regexcmp.c",
-        "regexexe.c"
+        "regexexe.c",
+        "strvec.c"
     ];
 
     wincsupSources = [
@@ -0,0 +1,394 @@
+/*++
+
+Copyright (c) 2026 Minoca Corp.
+
+    This file is licensed under the terms of the GNU General Public License
+    version 3. Alternative licensing terms are available. Contact
+    info@minocacorp.com for details. See the LICENSE file at the root of this
+    project for complete licensing information.
+
+Module Name:
+
+    epoll.c
+
+Abstract:
+
+    This module implements the event polling interface on top of kernel event
+    queues.
+
+Author:
+
+    Minoca Corp. 18-Oct-2026
+
+Environment:
+
+    User Mode C Library
+
+--*/
+
+//
+// ------------------------------------------------------------------- Includes
+//
+
+#include "libcp.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stddef.h>
+#include <sys/epoll.h>
+
+//
+// --------------------------------------------------------------------- Macros
+//
+
+//
+// This macro asserts that the epoll flags and operations line up with the
+// kernel's event queue definitions.
+//
+
+#define ASSERT_EPOLL_FLAGS_EQUIVALENT()                                 \
+    ASSERT((EPOLLIN == POLL_EVENT_IN) &&                                \
+           (EPOLLPRI == POLL_EVENT_IN_HIGH_PRIORITY) &&                 \
+           (EPOLLOUT == POLL_EVENT_OUT) &&                              \
+           (EPOLLWRBAND == POLL_EVENT_OUT_HIGH_PRIORITY) &&             \
+           (EPOLLERR == POLL_EVENT_ERROR) &&                            \
+           (EPOLLHUP == POLL_EVENT_DISCONNECTED) &&                     \
+           (EPOLLET == EVENT_QUEUE_FLAG_EDGE_TRIGGERED) &&              \
+           (EPOLLONESHOT == EVENT_QUEUE_FLAG_ONE_SHOT) &&               \
+           (EPOLL_CTL_ADD == EventQueueOperationAdd) &&                 \
+           (EPOLL_CTL_MOD == EventQueueOperationModify) &&              \
+           (EPOLL_CTL_DEL == EventQueueOperationDelete) &&              \
+           (EPOLL_CLOEXEC == O_CLOEXEC))
+
+//
+// This macro asserts that the epoll event structure can be handed directly to
+// the kernel.
+//
+
+#define ASSERT_EPOLL_STRUCTURE_EQUIVALENT()                             \
+    ASSERT((sizeof(struct epoll_event) == sizeof(EVENT_QUEUE_EVENT)) && \
+           (offsetof(struct epoll_event, events) ==                     \
+            FIELD_OFFSET(EVENT_QUEUE_EVENT, Events)) &&                 \
+           (offsetof(struct epoll_event, data) ==                       \
+            FIELD_OFFSET(EVENT_QUEUE_EVENT, Data)))
+
+//
+// ---------------------------------------------------------------- Definitions
+//
+
+//
+// ------------------------------------------------------ Data Type Definitions
+//
+
+//
+// ----------------------------------------------- Internal Function Prototypes
+//
+
+//
+// -------------------------------------------------------------------- Globals
+//
+
+//
+// ------------------------------------------------------------------ Functions
+//
+
+LIBC_API
+int
+epoll_create (
+    int Size
+    )
+
+/*++
+
+Routine Description:
+
+    This routine creates a new event polling descriptor.
+
+Arguments:
+
+    Size - Supplies a hint of the number of descriptors to be watched. This is
+        ignored, but must be greater than zero.
+
+Return Value:
+
+    Returns the new descriptor on success.
+
+    -1 on failure, and errno will be set to contain more information.
+
+--*/
+
+{
+
+    if (Size <= 0) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    return epoll_create1(0);
+}
+
+LIBC_API
+int
+epoll_create1 (
+    int Flags
+    )
+
+/*++
+
+Routine Description:
+
+    This routine creates a new event polling descriptor.
+
+Arguments:
+
+    Flags - Supplies a bitfield of flags. Only EPOLL_CLOEXEC is permitted.
+
+Return Value:
+
+    Returns the new descriptor on success.
+
+    -1 on failure, and errno will be set to contain more information.
+
+--*/
+
+{
+
+    HANDLE Handle;
+    ULONG OpenFlags;
+    KSTATUS Status;
+
+    if ((Flags & ~EPOLL_CLOEXEC) != 0) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    OpenFlags = 0;
+    if ((Flags & EPOLL_CLOEXEC) != 0) {
+        OpenFlags |= SYS_OPEN_FLAG_CLOSE_ON_EXECUTE;
+    }
+
+    Status = OsCreateEventQueue(OpenFlags, &Handle);
+    if (!KSUCCESS(Status)) {
+        errno = ClConvertKstatusToErrorNumber(Status);
+        return -1;
+    }
+
+    return (int)(UINTN)Handle;
+}
+
+LIBC_API
+int
+epoll_ctl (
+    int PollDescriptor,
+    int Operation,
+    int FileDescriptor,
+    struct epoll_event *Event
+    )
+
+/*++
+
+Routine Description:
+
+    This routine adds, changes, or removes a file descriptor's registration
+    with an event polling descriptor.
+
+Arguments:
+
+    PollDescriptor - Supplies the event polling descriptor.
+
+    Operation - Supplies the operation to perform. See EPOLL_CTL_*
+        definitions.
+
+    FileDescriptor - Supplies the descriptor to register, change, or remove.
+
+    Event - Supplies a pointer to the events to watch and the data to return.
+        This is ignored for EPOLL_CTL_DEL.
+
+Return Value:
+
+    0 on success.
+
+    -1 on failure, and errno will be set to contain more information.
+
+--*/
+
+{
+
+    KSTATUS Status;
+
+    ASSERT_EPOLL_FLAGS_EQUIVALENT();
+    ASSERT_EPOLL_STRUCTURE_EQUIVALENT();
+
+    if ((Operation != EPOLL_CTL_ADD) &&
+        (Operation != EPOLL_CTL_MOD) &&
+        (Operation != EPOLL_CTL_DEL)) {
+
+        errno = EINVAL;
+        return -1;
+    }
+
+    if ((Operation != EPOLL_CTL_DEL) && (Event == NULL)) {
+        errno = EFAULT;
+        return -1;
+    }
+
+    if (PollDescriptor == FileDescriptor) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    Status = OsControlEventQueue((HANDLE)(UINTN)PollDescriptor,
+                                 Operation,
+                                 (HANDLE)(UINTN)FileDescriptor,
+                                 (PEVENT_QUEUE_EVENT)Event);
+
+    if (!KSUCCESS(Status)) {
+
+        //
+        // Descriptors that can never block, like regular files, cannot be
+        // watched.
+        //
+
+        if (Status == STATUS_NOT_SUPPORTED) {
+            errno = EPERM;
+
+        } else {
+            errno = ClConvertKstatusToErrorNumber(Status);
+        }
+
+        return -1;
+    }
+
+    return 0;
+}
+
+LIBC_API
+int
+epoll_wait (
+    int PollDescriptor,
+    struct epoll_event *Events,
+    int MaxEvents,
+    int Timeout
+    )
+
+/*++
+
+Routine Description:
+
+    This routine waits for registered file descriptors to become ready.
+
+Arguments:
+
+    PollDescriptor - Supplies the event polling descriptor.
+
+    Events - Supplies a pointer to an array where the ready events will be
+        returned.
+
+    MaxEvents - Supplies the number of elements in the events array. This
+        must be greater than zero.
+
+    Timeout - Supplies the amount of time in milliseconds to block before
+        giving up and returning anyway. Supply 0 to not block at all, and
+        supply -1 to wait for an indefinite amount of time.
+
+Return Value:
+
+    Returns the number of events returned on success.
+
+    Returns 0 to indicate a timeout.
+
+    -1 on failure, and errno will be set to contain more information.
+
+--*/
+
+{
+
+    return epoll_pwait(PollDescriptor, Events, MaxEvents, Timeout, NULL);
+}
+
+LIBC_API
+int
+epoll_pwait (
+    int PollDescriptor,
+    struct epoll_event *Events,
+    int MaxEvents,
+    int Timeout,
+    const sigset_t *SignalMask
+    )
+
+/*++
+
+Routine Description:
+
+    This routine waits for registered file descriptors to become ready,
+    atomically setting the signal mask for the duration of the wait.
+
+Arguments:
+
+    PollDescriptor - Supplies the event polling descriptor.
+
+    Events - Supplies a pointer to an array where the ready events will be
+        returned.
+
+    MaxEvents - Supplies the number of elements in the events array. This
+        must be greater than zero.
+
+    Timeout - Supplies the amount of time in milliseconds to block before
+        giving up and returning anyway. Supply 0 to not block at all, and
+        supply -1 to wait for an indefinite amount of time.
+
+    SignalMask - Supplies an optional pointer to a signal mask to set
+        atomically for the duration of the wait.
+
+Return Value:
+
+    Returns the number of events returned on success.
+
+    Returns 0 to indicate a timeout.
+
+    -1 on failure, and errno will be set to contain more information.
+
+--*/
+
+{
+
+    ULONG EventsReturned;
+    KSTATUS Status;
+    ULONG TimeoutInMilliseconds;
+
+    ASSERT_EPOLL_STRUCTURE_EQUIVALENT();
+
+    if (MaxEvents <= 0) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (Timeout < 0) {
+        TimeoutInMilliseconds = SYS_WAIT_TIME_INDEFINITE;
+
+    } else {
+        TimeoutInMilliseconds = Timeout;
+    }
+
+    Status = OsWaitForEventQueue((HANDLE)(UINTN)PollDescriptor,
+                                 (PSIGNAL_SET)SignalMask,
+                                 (PEVENT_QUEUE_EVENT)Events,
+                                 MaxEvents,
+                                 TimeoutInMilliseconds,
+                                 &EventsReturned);
+
+    if (!KSUCCESS(Status)) {
+        if (Status == STATUS_TIMEOUT) {
+            return 0;
+        }
+
+        errno = ClConvertKstatusToErrorNumber(Status);
+        return -1;
+    }
+
+    return (int)EventsReturned;
+}
+
+//
+// --------------------------------------------------------- Internal Functions
+//
+
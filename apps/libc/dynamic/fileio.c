@@ -39,6 +39,7 @@ Module Name:
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/sendfile.h>
 #include <sys/stat.h>
 #include <sys/time.h>
 #include <unistd.h>
@@ -65,6 +66,17 @@ Module Name:
 #define ASSERT_POLL_STRUCTURE_EQUIVALENT() \
     ASSERT(sizeof(struct pollfd) == sizeof(POLL_DESCRIPTOR))
 
+//
+// This macro asserts that the file advice values line up with the kernel's.
+//
+
+#define ASSERT_FILE_ADVICE_EQUIVALENT() \
+    ASSERT((POSIX_FADV_NORMAL == IoAdviceNormal) && \
+           (POSIX_FADV_RANDOM == IoAdviceRandom) && \
+           (POSIX_FADV_SEQUENTIAL == IoAdviceSequential) && \
+           (POSIX_FADV_WILLNEED == IoAdviceWillNeed) && \
+           (POSIX_FADV_DONTNEED == IoAdviceDontNeed))
+
 //
 // ---------------------------------------------------------------- Definitions
 //
@@ -635,6 +647,258 @@ Return Value:
     return ReturnValue;
 }
 
+LIBC_API
+int
+posix_fadvise (
+    int FileDescriptor,
+    off_t Offset,
+    off_t Length,
+    int Advice
+    )
+
+/*++
+
+Routine Description:
+
+    This routine passes a hint about the expected access pattern of a region
+    of a file, which the system may use to tune how the file is cached.
+
+Arguments:
+
+    FileDescriptor - Supplies the file descriptor to advise on.
+
+    Offset - Supplies the offset of the start of the region.
+
+    Length - Supplies the length of the region in bytes. Supply 0 to cover
+        everything from the offset to the end of the file.
+
+    Advice - Supplies the hint. See POSIX_FADV_* definitions.
+
+Return Value:
+
+    0 on success.
+
+    Returns an error number on failure. The errno variable is not set.
+
+--*/
+
+{
+
+    FILE_CONTROL_PARAMETERS_UNION Parameters;
+    KSTATUS Status;
+
+    ASSERT_FILE_ADVICE_EQUIVALENT();
+
+    if ((Offset < 0) || (Length < 0)) {
+        return EINVAL;
+    }
+
+    switch (Advice) {
+    case POSIX_FADV_NORMAL:
+    case POSIX_FADV_RANDOM:
+    case POSIX_FADV_SEQUENTIAL:
+    case POSIX_FADV_WILLNEED:
+    case POSIX_FADV_DONTNEED:
+        break;
+
+    case POSIX_FADV_NOREUSE:
+        Advice = POSIX_FADV_NORMAL;
+        break;
+
+    default:
+        return EINVAL;
+    }
+
+    Parameters.Advice.Advice = Advice;
+    Parameters.Advice.Offset = Offset;
+    Parameters.Advice.Size = Length;
+    Status = OsFileControl((HANDLE)(UINTN)FileDescriptor,
+                           FileControlCommandAdvise,
+                           &Parameters);
+
+    if (!KSUCCESS(Status)) {
+
+        //
+        // Pipes, sockets, and other objects that cannot be advised report
+        // the same error as they would for a seek.
+        //
+
+        if (Status == STATUS_NOT_SUPPORTED) {
+            return ESPIPE;
+        }
+
+        return ClConvertKstatusToErrorNumber(Status);
+    }
+
+    return 0;
+}
+
+LIBC_API
+ssize_t
+sendfile (
+    int OutputDescriptor,
+    int InputDescriptor,
+    off_t *Offset,
+    size_t ByteCount
+    )
+
+/*++
+
+Routine Description:
+
+    This routine copies data from one file descriptor to another without
+    passing it through user mode. Data read from a regular file is taken
+    straight from the file's cached pages.
+
+Arguments:
+
+    OutputDescriptor - Supplies the file descriptor to write to.
+
+    InputDescriptor - Supplies the file descriptor to read from.
+
+    Offset - Supplies an optional pointer to the offset in the input file to
+        start reading from. On return, this is updated to the offset after the
+        last byte read, and the input's file position is not changed. If this
+        is NULL, the input's file position is used and advanced.
+
+    ByteCount - Supplies the number of bytes to copy.
+
+Return Value:
+
+    Returns the number of bytes written to the output descriptor.
+
+    -1 on failure, and errno will contain more information.
+
+--*/
+
+{
+
+    return splice(InputDescriptor,
+                  Offset,
+                  OutputDescriptor,
+                  NULL,
+                  ByteCount,
+                  0);
+}
+
+LIBC_API
+ssize_t
+splice (
+    int InputDescriptor,
+    off_t *InputOffset,
+    int OutputDescriptor,
+    off_t *OutputOffset,
+    size_t ByteCount,
+    unsigned int Flags
+    )
+
+/*++
+
+Routine Description:
+
+    This routine moves data from one file descriptor to another without
+    passing it through user mode. Data read from a regular file is taken
+    straight from the file's cached pages. Unlike some systems, neither
+    descriptor needs to be a pipe.
+
+Arguments:
+
+    InputDescriptor - Supplies the file descriptor to read from.
+
+    InputOffset - Supplies an optional pointer to the offset in the input to
+        read from. On return, this is advanced by the number of bytes moved,
+        and the input's file position is not changed. If this is NULL, the
+        input's file position is used and advanced.
+
+    OutputDescriptor - Supplies the file descriptor to write to.
+
+    OutputOffset - Supplies an optional pointer to the offset in the output to
+        write to. On return, this is advanced by the number of bytes moved,
+        and the output's file position is not changed. If this is NULL, the
+        output's file position is used and advanced.
+
+    ByteCount - Supplies the number of bytes to move.
+
+    Flags - Supplies a bitfield of flags. See SPLICE_F_* definitions.
+
+Return Value:
+
+    Returns the number of bytes moved. Zero indicates the end of the input.
+
+    -1 on failure, and errno will contain more information.
+
+--*/
+
+{
+
+    UINTN BytesCompleted;
+    IO_OFFSET DestinationOffset;
+    IO_OFFSET SourceOffset;
+    KSTATUS Status;
+    ULONG Timeout;
+
+    //
+    // Truncate the byte count, so that it does not exceed the maximum number
+    // of bytes that can be returned.
+    //
+
+    if (ByteCount > (size_t)SSIZE_MAX) {
+        ByteCount = (size_t)SSIZE_MAX;
+    }
+
+    SourceOffset = IO_OFFSET_NONE;
+    if (InputOffset != NULL) {
+        if (*InputOffset < 0) {
+            errno = EINVAL;
+            return -1;
+        }
+
+        SourceOffset = *InputOffset;
+    }
+
+    DestinationOffset = IO_OFFSET_NONE;
+    if (OutputOffset != NULL) {
+        if (*OutputOffset < 0) {
+            errno = EINVAL;
+            return -1;
+        }
+
+        DestinationOffset = *OutputOffset;
+    }
+
+    Timeout = SYS_WAIT_TIME_INDEFINITE;
+    if ((Flags & SPLICE_F_NONBLOCK) != 0) {
+        Timeout = 0;
+    }
+
+    Status = OsSplice((HANDLE)(UINTN)InputDescriptor,
+                      SourceOffset,
+                      (HANDLE)(UINTN)OutputDescriptor,
+                      DestinationOffset,
+                      ByteCount,
+                      Timeout,
+                      &BytesCompleted);
+
+    if (Status == STATUS_TIMEOUT) {
+        errno = EAGAIN;
+        return -1;
+
+    } else if (!KSUCCESS(Status)) {
+        errno = ClConvertKstatusToErrorNumber(Status);
+        return -1;
+    }
+
+    if (InputOffset != NULL) {
+        *InputOffset += BytesCompleted;
+    }
+
+    if (OutputOffset != NULL) {
+        *OutputOffset += BytesCompleted;
+    }
+
+    return (ssize_t)BytesCompleted;
+}
+
 LIBC_API
 int
 close (
@@ -55,7 +55,7 @@ Module Name:
 // ---------------------------------------------------------------- Definitions
 //
 
-#define CL_NETWORK_NAME_FORMAT_COUNT 3
+#define CL_NETWORK_NAME_FORMAT_COUNT 4
 #define CL_NETWORK_NAME_LINK_LAYER_INDEX 0
 #define CL_NETWORK_NAME_DOMAIN_OFFSET 1
 
@@ -119,7 +119,8 @@ ClpDestroyNetworkInterfaceAddress (
 PCSTR ClNetworkNameFormats[CL_NETWORK_NAME_FORMAT_COUNT] = {
     "il%d",
     "eth%d",
-    "wlan%d"
+    "wlan%d",
+    "lo%d"
 };
 
 //
@@ -979,7 +980,8 @@ Return Value:
     //
 
     if ((Information.Address.Domain == NetDomainIp4) &&
-        (Information.Subnet.Domain == NetDomainIp4)) {
+        (Information.Subnet.Domain == NetDomainIp4) &&
+        (Domain != NetDomainLoopback)) {
 
         Broadcast = malloc(sizeof(struct sockaddr_in));
         if (Broadcast == NULL) {
@@ -1031,6 +1033,11 @@ Return Value:
         NewLinkInterface->ifa_flags |= IFF_RUNNING;
     }
 
+    if (Domain == NetDomainLoopback) {
+        NewInterface->ifa_flags |= IFF_LOOPBACK;
+        NewLinkInterface->ifa_flags |= IFF_LOOPBACK;
+    }
+
     if (Information.PhysicalAddress.Domain != NetDomainInvalid) {
         AllocationSize = sizeof(struct sockaddr_dl);
         MaxDataLength = AllocationSize -
@@ -1064,6 +1071,9 @@ Return Value:
         LinkAddress->sdl_type = IFT_ETHER;
         if (Information.PhysicalAddress.Domain == NetDomain80211) {
             LinkAddress->sdl_type = IFT_IEEE80211;
+
+        } else if (Information.PhysicalAddress.Domain == NetDomainLoopback) {
+            LinkAddress->sdl_type = IFT_LOOP;
         }
 
         LinkAddress->sdl_nlen = NameLength;
@@ -77,6 +77,7 @@ Return Value:
 
 {
 
+    ClpInitializeStringRoutines();
     ClpInitializeEnvironment();
     ClpInitializeTimeZoneSupport();
     ClpInitializeFileIo();
@@ -0,0 +1,1233 @@
+/*++
+
+Copyright (c) 2026 Minoca Corp.
+
+    This file is licensed under the terms of the GNU General Public License
+    version 3. Alternative licensing terms are available. Contact
+    info@minocacorp.com for details. See the LICENSE file at the root of this
+    project for complete licensing information.
+
+Module Name:
+
+    ioring.c
+
+Abstract:
+
+    This module implements the I/O ring interface on top of kernel I/O ring
+    objects.
+
+Author:
+
+    Minoca Corp. 18-Oct-2026
+
+Environment:
+
+    User Mode C Library
+
+--*/
+
+//
+// ------------------------------------------------------------------- Includes
+//
+
+#include "libcp.h"
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioring.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+//
+// --------------------------------------------------------------------- Macros
+//
+
+//
+// This macro asserts that the I/O ring definitions line up with the kernel's.
+//
+
+#define ASSERT_IORING_DEFINITIONS_EQUIVALENT()                              \
+    ASSERT((IORING_OP_NOP == IoRingOperationNop) &&                         \
+           (IORING_OP_READ == IoRingOperationRead) &&                       \
+           (IORING_OP_WRITE == IoRingOperationWrite) &&                     \
+           (IORING_OP_FSYNC == IoRingOperationFlush) &&                     \
+           (IORING_OP_ACCEPT == IoRingOperationAccept) &&                   \
+           (IORING_OP_CONNECT == IoRingOperationConnect) &&                 \
+           (IORING_OP_SEND == IoRingOperationSend) &&                       \
+           (IORING_OP_RECV == IoRingOperationReceive) &&                    \
+           (IORING_SQE_FIXED_FILE == IO_RING_SUBMIT_REGISTERED_HANDLE) &&   \
+           (IORING_SQE_FIXED_BUFFER == IO_RING_SUBMIT_REGISTERED_BUFFER) && \
+           (IORING_MAX_ENTRIES == IO_RING_MAX_ENTRIES) &&                   \
+           (IORING_CLOEXEC == O_CLOEXEC))
+
+//
+// This macro asserts that the submission and completion structures can be
+// shared directly with the kernel.
+//
+
+#define ASSERT_IORING_STRUCTURES_EQUIVALENT()                           \
+    ASSERT((sizeof(struct ioring_sqe) == sizeof(IO_RING_SUBMISSION)) && \
+           (offsetof(struct ioring_sqe, user_data) ==                   \
+            FIELD_OFFSET(IO_RING_SUBMISSION, UserData)) &&              \
+           (offsetof(struct ioring_sqe, offset) ==                      \
+            FIELD_OFFSET(IO_RING_SUBMISSION, Offset)) &&                \
+           (offsetof(struct ioring_sqe, buffer) ==                      \
+            FIELD_OFFSET(IO_RING_SUBMISSION, Buffer)) &&                \
+           (offsetof(struct ioring_sqe, size) ==                        \
+            FIELD_OFFSET(IO_RING_SUBMISSION, Size)) &&                  \
+           (offsetof(struct ioring_sqe, descriptor) ==                  \
+            FIELD_OFFSET(IO_RING_SUBMISSION, Handle)) &&                \
+           (offsetof(struct ioring_sqe, opcode) ==                      \
+            FIELD_OFFSET(IO_RING_SUBMISSION, Operation)) &&             \
+           (offsetof(struct ioring_sqe, flags) ==                       \
+            FIELD_OFFSET(IO_RING_SUBMISSION, Flags)) &&                 \
+           (offsetof(struct ioring_sqe, buffer_index) ==                \
+            FIELD_OFFSET(IO_RING_SUBMISSION, BufferIndex)) &&           \
+           (offsetof(struct ioring_sqe, op_flags) ==                    \
+            FIELD_OFFSET(IO_RING_SUBMISSION, OperationFlags)) &&        \
+           (sizeof(struct ioring_cqe) == sizeof(IO_RING_COMPLETION)) && \
+           (offsetof(struct ioring_cqe, user_data) ==                   \
+            FIELD_OFFSET(IO_RING_COMPLETION, UserData)) &&              \
+           (offsetof(struct ioring_cqe, result) ==                      \
+            FIELD_OFFSET(IO_RING_COMPLETION, Result)))
+
+//
+// This macro returns the header of the memory shared with the kernel.
+//
+
+#define IORING_HEADER(_Ring) ((volatile IO_RING_HEADER *)((_Ring)->memory))
+
+//
+// ---------------------------------------------------------------- Definitions
+//
+
+//
+// Define the ratio of completion entries to submission entries. Extra
+// completion entries let requests stay in flight while new ones are queued.
+//
+
+#define IORING_COMPLETION_RATIO 2
+
+//
+// ------------------------------------------------------ Data Type Definitions
+//
+
+//
+// ----------------------------------------------- Internal Function Prototypes
+//
+
+int
+ClpEnterIoRing (
+    struct ioring *Ring,
+    unsigned int WaitCount,
+    ULONG TimeoutInMilliseconds
+    );
+
+int
+ClpRegisterIoRing (
+    struct ioring *Ring,
+    IO_RING_REGISTER_OPERATION Operation,
+    PVOID Array,
+    ULONG Count
+    );
+
+//
+// -------------------------------------------------------------------- Globals
+//
+
+//
+// ------------------------------------------------------------------ Functions
+//
+
+LIBC_API
+int
+ioring_init (
+    unsigned int Entries,
+    struct ioring *Ring,
+    int Flags
+    )
+
+/*++
+
+Routine Description:
+
+    This routine creates a new I/O ring.
+
+Arguments:
+
+    Entries - Supplies the number of submission entries. This is rounded up
+        to a power of two. The completion ring gets twice as many entries.
+
+    Ring - Supplies a pointer where the ring will be initialized.
+
+    Flags - Supplies a bitfield of flags. Only IORING_CLOEXEC is permitted.
+
+Return Value:
+
+    0 on success.
+
+    -1 on failure, and errno will be set to contain more information.
+
+--*/
+
+{
+
+    ULONG CompletionCount;
+    HANDLE Handle;
+    void *Memory;
+    ULONG OpenFlags;
+    size_t RingSize;
+    size_t Size;
+    KSTATUS Status;
+    ULONG SubmissionCount;
+
+    ASSERT_IORING_DEFINITIONS_EQUIVALENT();
+    ASSERT_IORING_STRUCTURES_EQUIVALENT();
+
+    if (((Flags & ~IORING_CLOEXEC) != 0) ||
+        (Entries == 0) ||
+        (Entries > IORING_MAX_ENTRIES)) {
+
+        errno = EINVAL;
+        return -1;
+    }
+
+    SubmissionCount = 1;
+    while (SubmissionCount < Entries) {
+        SubmissionCount <<= 1;
+    }
+
+    CompletionCount = SubmissionCount * IORING_COMPLETION_RATIO;
+    if (CompletionCount > IO_RING_MAX_ENTRIES) {
+        CompletionCount = IO_RING_MAX_ENTRIES;
+    }
+
+    //
+    // The connect addresses live just beyond the memory shared with the
+    // kernel, one per submission slot.
+    //
+
+    RingSize = ALIGN_RANGE_UP(IO_RING_SIZE(SubmissionCount, CompletionCount),
+                              sizeof(ULONGLONG));
+
+    Size = RingSize + (SubmissionCount * sizeof(NETWORK_ADDRESS));
+    Memory = mmap(NULL,
+                  Size,
+                  PROT_READ | PROT_WRITE,
+                  MAP_PRIVATE | MAP_ANONYMOUS,
+                  -1,
+                  0);
+
+    if (Memory == MAP_FAILED) {
+        return -1;
+    }
+
+    OpenFlags = 0;
+    if ((Flags & IORING_CLOEXEC) != 0) {
+        OpenFlags |= SYS_OPEN_FLAG_CLOSE_ON_EXECUTE;
+    }
+
+    Status = OsCreateIoRing(Memory,
+                            SubmissionCount,
+                            CompletionCount,
+                            OpenFlags,
+                            &Handle);
+
+    if (!KSUCCESS(Status)) {
+        munmap(Memory, Size);
+        errno = ClConvertKstatusToErrorNumber(Status);
+        return -1;
+    }
+
+    Ring->descriptor = (int)(UINTN)Handle;
+    Ring->memory = Memory;
+    Ring->size = Size;
+    Ring->sq_entries = SubmissionCount;
+    Ring->cq_entries = CompletionCount;
+    Ring->sq_tail = 0;
+    Ring->cq_checked = 0;
+    Ring->sqes = (struct ioring_sqe *)((PIO_RING_HEADER)Memory + 1);
+    Ring->cqes = (struct ioring_cqe *)(Ring->sqes + SubmissionCount);
+    Ring->addresses = (PUCHAR)Memory + RingSize;
+    return 0;
+}
+
+LIBC_API
+void
+ioring_destroy (
+    struct ioring *Ring
+    )
+
+/*++
+
+Routine Description:
+
+    This routine closes an I/O ring and frees its memory. Requests still in
+    flight are abandoned.
+
+Arguments:
+
+    Ring - Supplies a pointer to the ring.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    //
+    // Close the ring before unmapping so that the kernel is done posting
+    // completions to the memory.
+    //
+
+    close(Ring->descriptor);
+    munmap(Ring->memory, Ring->size);
+    Ring->descriptor = -1;
+    Ring->memory = NULL;
+    Ring->size = 0;
+    return;
+}
+
+LIBC_API
+struct ioring_sqe *
+ioring_get_sqe (
+    struct ioring *Ring
+    )
+
+/*++
+
+Routine Description:
+
+    This routine returns the next free submission entry. The entry is zeroed.
+    It is handed to the kernel by the next call to submit.
+
+Arguments:
+
+    Ring - Supplies a pointer to the ring.
+
+Return Value:
+
+    Returns a pointer to the submission entry.
+
+    NULL if the submission ring is full.
+
+--*/
+
+{
+
+    ULONG Head;
+    struct ioring_sqe *Submission;
+
+    Head = IORING_HEADER(Ring)->SubmissionHead;
+    if (Ring->sq_tail - Head >= Ring->sq_entries) {
+        return NULL;
+    }
+
+    Submission = &(Ring->sqes[Ring->sq_tail & (Ring->sq_entries - 1)]);
+    memset(Submission, 0, sizeof(struct ioring_sqe));
+    Ring->sq_tail += 1;
+    return Submission;
+}
+
+LIBC_API
+int
+ioring_submit (
+    struct ioring *Ring
+    )
+
+/*++
+
+Routine Description:
+
+    This routine hands all prepared submissions to the kernel.
+
+Arguments:
+
+    Ring - Supplies a pointer to the ring.
+
+Return Value:
+
+    Returns the number of submissions the kernel consumed.
+
+    -1 on failure, and errno will be set to contain more information.
+
+--*/
+
+{
+
+    return ClpEnterIoRing(Ring, 0, 0);
+}
+
+LIBC_API
+int
+ioring_submit_and_wait (
+    struct ioring *Ring,
+    unsigned int WaitCount
+    )
+
+/*++
+
+Routine Description:
+
+    This routine hands all prepared submissions to the kernel and waits until
+    at least the given number of completions are ready.
+
+Arguments:
+
+    Ring - Supplies a pointer to the ring.
+
+    WaitCount - Supplies the number of completions to wait for.
+
+Return Value:
+
+    Returns the number of submissions the kernel consumed.
+
+    -1 on failure, and errno will be set to contain more information.
+
+--*/
+
+{
+
+    return ClpEnterIoRing(Ring, WaitCount, SYS_WAIT_TIME_INDEFINITE);
+}
+
+LIBC_API
+int
+ioring_peek_cqe (
+    struct ioring *Ring,
+    struct ioring_cqe **Completion
+    )
+
+/*++
+
+Routine Description:
+
+    This routine returns the next completion without waiting.
+
+Arguments:
+
+    Ring - Supplies a pointer to the ring.
+
+    Completion - Supplies a pointer where a pointer to the completion entry
+        will be returned. Mark it consumed with ioring_cqe_seen.
+
+Return Value:
+
+    0 on success.
+
+    -1 on failure, and errno will be set to contain more information. The
+    error is EAGAIN if no completion is ready.
+
+--*/
+
+{
+
+    struct ioring_cqe *Entry;
+    ULONG Head;
+
+    Head = IORING_HEADER(Ring)->CompletionHead;
+    if (Head == IORING_HEADER(Ring)->CompletionTail) {
+        errno = EAGAIN;
+        return -1;
+    }
+
+    //
+    // Pair with the barrier the kernel issues before publishing the tail, so
+    // the entry contents are not read early.
+    //
+
+    RtlMemoryBarrier();
+    Entry = &(Ring->cqes[Head & (Ring->cq_entries - 1)]);
+
+    //
+    // The kernel reports failures as negative status codes. Convert each one
+    // to a negative error number, but only once, since the caller may peek
+    // at the same entry repeatedly.
+    //
+
+    if (Ring->cq_checked == Head) {
+        if (Entry->result < 0) {
+            Entry->result =
+                       -ClConvertKstatusToErrorNumber((KSTATUS)Entry->result);
+        }
+
+        Ring->cq_checked = Head + 1;
+    }
+
+    *Completion = Entry;
+    return 0;
+}
+
+LIBC_API
+int
+ioring_wait_cqe (
+    struct ioring *Ring,
+    struct ioring_cqe **Completion
+    )
+
+/*++
+
+Routine Description:
+
+    This routine returns the next completion, waiting for one if necessary.
+
+Arguments:
+
+    Ring - Supplies a pointer to the ring.
+
+    Completion - Supplies a pointer where a pointer to the completion entry
+        will be returned. Mark it consumed with ioring_cqe_seen.
+
+Return Value:
+
+    0 on success.
+
+    -1 on failure, and errno will be set to contain more information.
+
+--*/
+
+{
+
+    int Result;
+
+    while (TRUE) {
+        Result = ioring_peek_cqe(Ring, Completion);
+        if ((Result == 0) || (errno != EAGAIN)) {
+            break;
+        }
+
+        Result = ClpEnterIoRing(Ring, 1, SYS_WAIT_TIME_INDEFINITE);
+        if (Result < 0) {
+            break;
+        }
+    }
+
+    return Result;
+}
+
+LIBC_API
+void
+ioring_cqe_seen (
+    struct ioring *Ring,
+    struct ioring_cqe *Completion
+    )
+
+/*++
+
+Routine Description:
+
+    This routine marks the oldest completion as consumed, returning its slot
+    to the kernel.
+
+Arguments:
+
+    Ring - Supplies a pointer to the ring.
+
+    Completion - Supplies a pointer to the completion returned by peek or
+        wait.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    ULONG Head;
+
+    Head = IORING_HEADER(Ring)->CompletionHead;
+
+    assert(Completion == &(Ring->cqes[Head & (Ring->cq_entries - 1)]));
+
+    //
+    // Finish reading the entry before handing the slot back.
+    //
+
+    RtlMemoryBarrier();
+    IORING_HEADER(Ring)->CompletionHead = Head + 1;
+    if (Ring->cq_checked == Head) {
+        Ring->cq_checked = Head + 1;
+    }
+
+    return;
+}
+
+LIBC_API
+int
+ioring_register_files (
+    struct ioring *Ring,
+    const int *Descriptors,
+    unsigned int Count
+    )
+
+/*++
+
+Routine Description:
+
+    This routine registers a set of file descriptors with the ring, so that
+    submissions can name them by index and skip the descriptor lookup.
+
+Arguments:
+
+    Ring - Supplies a pointer to the ring.
+
+    Descriptors - Supplies a pointer to the array of descriptors. Supply -1
+        to leave a slot empty.
+
+    Count - Supplies the number of descriptors.
+
+Return Value:
+
+    0 on success.
+
+    -1 on failure, and errno will be set to contain more information.
+
+--*/
+
+{
+
+    PHANDLE Handles;
+    ULONG Index;
+    int Result;
+
+    if ((Count == 0) || (Count > IO_RING_MAX_REGISTERED)) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    //
+    // Descriptors are narrower than handles on 64-bit systems, so widen
+    // them into a temporary array.
+    //
+
+    Handles = malloc(Count * sizeof(HANDLE));
+    if (Handles == NULL) {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    for (Index = 0; Index < Count; Index += 1) {
+        if (Descriptors[Index] < 0) {
+            Handles[Index] = INVALID_HANDLE;
+
+        } else {
+            Handles[Index] = (HANDLE)(UINTN)(Descriptors[Index]);
+        }
+    }
+
+    Result = ClpRegisterIoRing(Ring,
+                               IoRingRegisterHandles,
+                               Handles,
+                               Count);
+
+    free(Handles);
+    return Result;
+}
+
+LIBC_API
+int
+ioring_unregister_files (
+    struct ioring *Ring
+    )
+
+/*++
+
+Routine Description:
+
+    This routine drops the file descriptors registered with the ring.
+
+Arguments:
+
+    Ring - Supplies a pointer to the ring.
+
+Return Value:
+
+    0 on success.
+
+    -1 on failure, and errno will be set to contain more information.
+
+--*/
+
+{
+
+    return ClpRegisterIoRing(Ring, IoRingUnregisterHandles, NULL, 0);
+}
+
+LIBC_API
+int
+ioring_register_buffers (
+    struct ioring *Ring,
+    const struct iovec *Buffers,
+    unsigned int Count
+    )
+
+/*++
+
+Routine Description:
+
+    This routine registers a set of buffers with the ring, so that they are
+    validated once rather than on every request.
+
+Arguments:
+
+    Ring - Supplies a pointer to the ring.
+
+    Buffers - Supplies a pointer to the array of buffers.
+
+    Count - Supplies the number of buffers.
+
+Return Value:
+
+    0 on success.
+
+    -1 on failure, and errno will be set to contain more information.
+
+--*/
+
+{
+
+    assert((sizeof(struct iovec) == sizeof(IO_VECTOR)) &&
+           (offsetof(struct iovec, iov_base) ==
+            FIELD_OFFSET(IO_VECTOR, Data)) &&
+           (offsetof(struct iovec, iov_len) ==
+            FIELD_OFFSET(IO_VECTOR, Length)));
+
+    return ClpRegisterIoRing(Ring,
+                             IoRingRegisterBuffers,
+                             (PVOID)Buffers,
+                             Count);
+}
+
+LIBC_API
+int
+ioring_unregister_buffers (
+    struct ioring *Ring
+    )
+
+/*++
+
+Routine Description:
+
+    This routine drops the buffers registered with the ring.
+
+Arguments:
+
+    Ring - Supplies a pointer to the ring.
+
+Return Value:
+
+    0 on success.
+
+    -1 on failure, and errno will be set to contain more information.
+
+--*/
+
+{
+
+    return ClpRegisterIoRing(Ring, IoRingUnregisterBuffers, NULL, 0);
+}
+
+LIBC_API
+void
+ioring_prep_nop (
+    struct ioring_sqe *Submission
+    )
+
+/*++
+
+Routine Description:
+
+    This routine prepares a request that does nothing.
+
+Arguments:
+
+    Submission - Supplies a pointer to the submission entry.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    Submission->opcode = IORING_OP_NOP;
+    Submission->descriptor = -1;
+    return;
+}
+
+LIBC_API
+void
+ioring_prep_read (
+    struct ioring_sqe *Submission,
+    int FileDescriptor,
+    void *Buffer,
+    size_t Size,
+    off_t Offset
+    )
+
+/*++
+
+Routine Description:
+
+    This routine prepares a read request.
+
+Arguments:
+
+    Submission - Supplies a pointer to the submission entry.
+
+    FileDescriptor - Supplies the descriptor to read from.
+
+    Buffer - Supplies a pointer where the data will be returned.
+
+    Size - Supplies the number of bytes to read.
+
+    Offset - Supplies the file offset to read from, or -1 to use and advance
+        the current file position.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    Submission->opcode = IORING_OP_READ;
+    Submission->descriptor = FileDescriptor;
+    Submission->buffer = Buffer;
+    Submission->size = Size;
+    Submission->offset = Offset;
+    return;
+}
+
+LIBC_API
+void
+ioring_prep_write (
+    struct ioring_sqe *Submission,
+    int FileDescriptor,
+    const void *Buffer,
+    size_t Size,
+    off_t Offset
+    )
+
+/*++
+
+Routine Description:
+
+    This routine prepares a write request.
+
+Arguments:
+
+    Submission - Supplies a pointer to the submission entry.
+
+    FileDescriptor - Supplies the descriptor to write to.
+
+    Buffer - Supplies a pointer to the data to write.
+
+    Size - Supplies the number of bytes to write.
+
+    Offset - Supplies the file offset to write to, or -1 to use and advance
+        the current file position.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    Submission->opcode = IORING_OP_WRITE;
+    Submission->descriptor = FileDescriptor;
+    Submission->buffer = (void *)Buffer;
+    Submission->size = Size;
+    Submission->offset = Offset;
+    return;
+}
+
+LIBC_API
+void
+ioring_prep_fsync (
+    struct ioring_sqe *Submission,
+    int FileDescriptor
+    )
+
+/*++
+
+Routine Description:
+
+    This routine prepares a request that flushes a file to its backing device.
+
+Arguments:
+
+    Submission - Supplies a pointer to the submission entry.
+
+    FileDescriptor - Supplies the descriptor to flush.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    Submission->opcode = IORING_OP_FSYNC;
+    Submission->descriptor = FileDescriptor;
+    return;
+}
+
+LIBC_API
+void
+ioring_prep_accept (
+    struct ioring_sqe *Submission,
+    int Socket,
+    int Flags
+    )
+
+/*++
+
+Routine Description:
+
+    This routine prepares a request that accepts a connection on a listening
+    socket. The completion result is the new descriptor. Use getpeername to
+    find the remote address.
+
+Arguments:
+
+    Submission - Supplies a pointer to the submission entry.
+
+    Socket - Supplies the listening socket.
+
+    Flags - Supplies SOCK_NONBLOCK and SOCK_CLOEXEC flags for the new
+        descriptor.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    ULONG OpenFlags;
+
+    OpenFlags = 0;
+    if ((Flags & SOCK_CLOEXEC) != 0) {
+        OpenFlags |= SYS_OPEN_FLAG_CLOSE_ON_EXECUTE;
+    }
+
+    if ((Flags & SOCK_NONBLOCK) != 0) {
+        OpenFlags |= SYS_OPEN_FLAG_NON_BLOCKING;
+    }
+
+    Submission->opcode = IORING_OP_ACCEPT;
+    Submission->descriptor = Socket;
+    Submission->op_flags = OpenFlags;
+    return;
+}
+
+LIBC_API
+int
+ioring_prep_connect (
+    struct ioring *Ring,
+    struct ioring_sqe *Submission,
+    int Socket,
+    const struct sockaddr *Address,
+    socklen_t AddressLength
+    )
+
+/*++
+
+Routine Description:
+
+    This routine prepares a request that connects a socket to a remote
+    address. The address is converted and stored in the ring, so it need not
+    outlive this call.
+
+Arguments:
+
+    Ring - Supplies a pointer to the ring the submission came from.
+
+    Submission - Supplies a pointer to the submission entry.
+
+    Socket - Supplies the socket to connect.
+
+    Address - Supplies a pointer to the address to connect to.
+
+    AddressLength - Supplies the size of the address in bytes.
+
+Return Value:
+
+    0 on success.
+
+    -1 on failure, and errno will be set to contain more information.
+
+--*/
+
+{
+
+    PNETWORK_ADDRESS NetworkAddress;
+    PSTR Path;
+    UINTN PathSize;
+    KSTATUS Status;
+
+    NetworkAddress = Ring->addresses;
+    NetworkAddress += Submission - Ring->sqes;
+    Path = NULL;
+    PathSize = 0;
+    Status = ClConvertToNetworkAddress(Address,
+                                       AddressLength,
+                                       NetworkAddress,
+                                       &Path,
+                                       &PathSize);
+
+    if (!KSUCCESS(Status)) {
+        errno = ClConvertKstatusToErrorNumber(Status);
+        return -1;
+    }
+
+    //
+    // Local sockets are named by path, which the ring cannot carry.
+    //
+
+    if (Path != NULL) {
+        errno = EAFNOSUPPORT;
+        return -1;
+    }
+
+    Submission->opcode = IORING_OP_CONNECT;
+    Submission->descriptor = Socket;
+    Submission->buffer = NetworkAddress;
+    Submission->size = sizeof(NETWORK_ADDRESS);
+    return 0;
+}
+
+LIBC_API
+void
+ioring_prep_send (
+    struct ioring_sqe *Submission,
+    int Socket,
+    const void *Buffer,
+    size_t Size,
+    int Flags
+    )
+
+/*++
+
+Routine Description:
+
+    This routine prepares a request that sends data on a connected socket.
+
+Arguments:
+
+    Submission - Supplies a pointer to the submission entry.
+
+    Socket - Supplies the socket to send on.
+
+    Buffer - Supplies a pointer to the data to send.
+
+    Size - Supplies the number of bytes to send.
+
+    Flags - Supplies MSG_* flags. MSG_DONTWAIT fails the request with EAGAIN
+        rather than holding it until the socket is ready.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    //
+    // The MSG_* flags are equivalent to the kernel's socket I/O flags.
+    //
+
+    Submission->opcode = IORING_OP_SEND;
+    Submission->descriptor = Socket;
+    Submission->buffer = (void *)Buffer;
+    Submission->size = Size;
+    Submission->op_flags = Flags;
+    return;
+}
+
+LIBC_API
+void
+ioring_prep_recv (
+    struct ioring_sqe *Submission,
+    int Socket,
+    void *Buffer,
+    size_t Size,
+    int Flags
+    )
+
+/*++
+
+Routine Description:
+
+    This routine prepares a request that receives data from a connected
+    socket.
+
+Arguments:
+
+    Submission - Supplies a pointer to the submission entry.
+
+    Socket - Supplies the socket to receive from.
+
+    Buffer - Supplies a pointer where the data will be returned.
+
+    Size - Supplies the size of the buffer in bytes.
+
+    Flags - Supplies MSG_* flags. MSG_DONTWAIT fails the request with EAGAIN
+        rather than holding it until data arrives.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    Submission->opcode = IORING_OP_RECV;
+    Submission->descriptor = Socket;
+    Submission->buffer = Buffer;
+    Submission->size = Size;
+    Submission->op_flags = Flags;
+    return;
+}
+
+//
+// --------------------------------------------------------- Internal Functions
+//
+
+int
+ClpEnterIoRing (
+    struct ioring *Ring,
+    unsigned int WaitCount,
+    ULONG TimeoutInMilliseconds
+    )
+
+/*++
+
+Routine Description:
+
+    This routine publishes the prepared submissions and enters the kernel to
+    start them, optionally waiting for completions.
+
+Arguments:
+
+    Ring - Supplies a pointer to the ring.
+
+    WaitCount - Supplies the number of completions to wait for.
+
+    TimeoutInMilliseconds - Supplies the number of milliseconds to wait.
+
+Return Value:
+
+    Returns the number of submissions the kernel consumed.
+
+    -1 on failure, and errno will be set to contain more information.
+
+--*/
+
+{
+
+    ULONG SubmitCount;
+    ULONG Submitted;
+    KSTATUS Status;
+
+    //
+    // Make the entries visible before the tail that covers them.
+    //
+
+    RtlMemoryBarrier();
+    IORING_HEADER(Ring)->SubmissionTail = Ring->sq_tail;
+    SubmitCount = Ring->sq_tail - IORING_HEADER(Ring)->SubmissionHead;
+    if ((SubmitCount == 0) && (WaitCount == 0)) {
+        return 0;
+    }
+
+    Submitted = 0;
+    Status = OsEnterIoRing((HANDLE)(UINTN)(Ring->descriptor),
+                           SubmitCount,
+                           WaitCount,
+                           TimeoutInMilliseconds,
+                           &Submitted);
+
+    if (!KSUCCESS(Status)) {
+
+        //
+        // The completion ring is full of unconsumed and in-flight requests.
+        //
+
+        if (Status == STATUS_BUFFER_FULL) {
+            errno = EBUSY;
+
+        } else {
+            errno = ClConvertKstatusToErrorNumber(Status);
+        }
+
+        return -1;
+    }
+
+    return Submitted;
+}
+
+int
+ClpRegisterIoRing (
+    struct ioring *Ring,
+    IO_RING_REGISTER_OPERATION Operation,
+    PVOID Array,
+    ULONG Count
+    )
+
+/*++
+
+Routine Description:
+
+    This routine registers or unregisters handles or buffers with a ring.
+
+Arguments:
+
+    Ring - Supplies a pointer to the ring.
+
+    Operation - Supplies the registration operation.
+
+    Array - Supplies a pointer to the array of handles or I/O vectors.
+
+    Count - Supplies the number of elements in the array.
+
+Return Value:
+
+    0 on success.
+
+    -1 on failure, and errno will be set to contain more information.
+
+--*/
+
+{
+
+    KSTATUS Status;
+
+    Status = OsRegisterIoRing((HANDLE)(UINTN)(Ring->descriptor),
+                              Operation,
+                              Array,
+                              Count);
+
+    if (!KSUCCESS(Status)) {
+        errno = ClConvertKstatusToErrorNumber(Status);
+        return -1;
+    }
+
+    return 0;
+}
+
@@ -207,6 +207,208 @@ typedef struct _CL_TYPE_CONVERSION_INTERFACE {
 
 } CL_TYPE_CONVERSION_INTERFACE, *PCL_TYPE_CONVERSION_INTERFACE;
 
+typedef enum _CL_STRING_IMPLEMENTATION {
+    ClStringImplementationWord,
+    ClStringImplementationSse2,
+    ClStringImplementationAvx2,
+    ClStringImplementationCount
+} CL_STRING_IMPLEMENTATION, *PCL_STRING_IMPLEMENTATION;
+
+typedef
+void *
+(*PCL_FIND_BYTE) (
+    const void *Buffer,
+    int Character,
+    size_t Size
+    );
+
+/*++
+
+Routine Description:
+
+    This routine implements memchr, finding the first occurrence of the given
+    byte in a buffer.
+
+Arguments:
+
+    Buffer - Supplies a pointer to the buffer to search.
+
+    Character - Supplies the character (converted to an unsigned char) to
+        locate.
+
+    Size - Supplies the size of the buffer in bytes.
+
+Return Value:
+
+    Returns a pointer to the first occurrence of the character, or NULL if it
+    was not found.
+
+--*/
+
+typedef
+size_t
+(*PCL_STRING_LENGTH) (
+    const char *String
+    );
+
+/*++
+
+Routine Description:
+
+    This routine implements strlen, computing the length of a string.
+
+Arguments:
+
+    String - Supplies a pointer to the string.
+
+Return Value:
+
+    Returns the length of the string, not including the null terminator.
+
+--*/
+
+typedef
+char *
+(*PCL_FIND_CHARACTER) (
+    const char *String,
+    int Character
+    );
+
+/*++
+
+Routine Description:
+
+    This routine implements strchr or strrchr, finding the first or last
+    occurrence of a character (converted to a char) in a string.
+
+Arguments:
+
+    String - Supplies a pointer to the string to search.
+
+    Character - Supplies the character to search for. This may be the null
+        terminator.
+
+Return Value:
+
+    Returns a pointer to the occurrence of the character, or NULL if it does
+    not exist in the string.
+
+--*/
+
+typedef
+int
+(*PCL_COMPARE_STRINGS) (
+    const char *String1,
+    const char *String2
+    );
+
+/*++
+
+Routine Description:
+
+    This routine implements strcmp, comparing two strings.
+
+Arguments:
+
+    String1 - Supplies the first string to compare.
+
+    String2 - Supplies the second string to compare.
+
+Return Value:
+
+    Returns the difference between the first pair of bytes (as unsigned
+    chars) that differ, or 0 if the strings are equal.
+
+--*/
+
+typedef
+size_t
+(*PCL_STRING_LENGTH_WIDE) (
+    const wchar_t *String
+    );
+
+/*++
+
+Routine Description:
+
+    This routine implements wcslen, computing the length of a wide string.
+
+Arguments:
+
+    String - Supplies a pointer to the wide string.
+
+Return Value:
+
+    Returns the length of the string in characters, not including the null
+    terminator.
+
+--*/
+
+typedef
+wchar_t *
+(*PCL_FIND_WIDE) (
+    const wchar_t *Buffer,
+    wchar_t Character,
+    size_t Size
+    );
+
+/*++
+
+Routine Description:
+
+    This routine implements wmemchr, finding the first occurrence of the given
+    wide character in a buffer.
+
+Arguments:
+
+    Buffer - Supplies a pointer to the buffer to search.
+
+    Character - Supplies the wide character to locate.
+
+    Size - Supplies the size of the buffer in characters.
+
+Return Value:
+
+    Returns a pointer to the first occurrence of the character, or NULL if it
+    was not found.
+
+--*/
+
+/*++
+
+Structure Description:
+
+    This structure stores the set of string routines selected for the current
+    processor. The public string functions call through this table.
+
+Members:
+
+    FindByte - Stores the memchr implementation.
+
+    StringLength - Stores the strlen implementation.
+
+    FindCharacter - Stores the strchr implementation.
+
+    FindLastCharacter - Stores the strrchr implementation.
+
+    CompareStrings - Stores the strcmp implementation.
+
+    StringLengthWide - Stores the wcslen implementation.
+
+    FindWide - Stores the wmemchr implementation.
+
+--*/
+
+typedef struct _CL_STRING_ROUTINES {
+    PCL_FIND_BYTE FindByte;
+    PCL_STRING_LENGTH StringLength;
+    PCL_FIND_CHARACTER FindCharacter;
+    PCL_FIND_CHARACTER FindLastCharacter;
+    PCL_COMPARE_STRINGS CompareStrings;
+    PCL_STRING_LENGTH_WIDE StringLengthWide;
+    PCL_FIND_WIDE FindWide;
+} CL_STRING_ROUTINES, *PCL_STRING_ROUTINES;
+
 //
 // -------------------------------------------------------------------- Globals
 //
@@ -219,6 +421,12 @@ typedef struct _CL_TYPE_CONVERSION_INTERFACE {
 LIST_ENTRY ClTypeConversionInterfaceList;
 pthread_mutex_t ClTypeConversionInterfaceLock;
 
+//
+// Store the string routines selected for this processor.
+//
+
+extern CL_STRING_ROUTINES ClStringRoutines;
+
 //
 // -------------------------------------------------------- Function Prototypes
 //
@@ -899,3 +1107,91 @@ Return Value:
     -1 on error, and the errno variable will contain more information.
 
 --*/
+
+int
+ClpSetThreadAffinity (
+    PROCESS_ID_TYPE Type,
+    PROCESS_ID Id,
+    size_t SetSize,
+    const cpu_set_t *NewSet,
+    cpu_set_t *OldSet
+    );
+
+/*++
+
+Routine Description:
+
+    This routine gets or sets the processor affinity of a thread or process,
+    converting between C library processor sets and kernel affinity masks.
+
+Arguments:
+
+    Type - Supplies the type of identifier given. Valid values are
+        ProcessIdProcess and ProcessIdThread.
+
+    Id - Supplies the process or thread ID. Supply zero to use the current
+        process or thread.
+
+    SetSize - Supplies the size of the given processor set buffers, in bytes.
+        Processors beyond what fits in the buffer are treated as not being in
+        the new set.
+
+    NewSet - Supplies an optional pointer to the new processor set.
+
+    OldSet - Supplies an optional pointer where the previous processor set
+        will be returned.
+
+Return Value:
+
+    0 on success.
+
+    Returns an error number on failure.
+
+--*/
+
+VOID
+ClpInitializeStringRoutines (
+    VOID
+    );
+
+/*++
+
+Routine Description:
+
+    This routine selects the fastest string routine implementations the
+    processor supports.
+
+Arguments:
+
+    None.
+
+Return Value:
+
+    None.
+
+--*/
+
+BOOL
+ClpSelectStringRoutines (
+    CL_STRING_IMPLEMENTATION Implementation
+    );
+
+/*++
+
+Routine Description:
+
+    This routine switches the string routines over to the given
+    implementation, if the processor supports it.
+
+Arguments:
+
+    Implementation - Supplies the implementation to use.
+
+Return Value:
+
+    TRUE if the implementation was selected.
+
+    FALSE if the processor or compiler does not support the implementation.
+    The current selection is left unchanged.
+
+--*/
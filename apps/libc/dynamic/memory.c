@@ -39,6 +39,23 @@ Module Name:
 #include <sys/shm.h>
 #include <sys/stat.h>
 
+//
+// --------------------------------------------------------------------- Macros
+//
+
+//
+// This macro asserts that the memory advice values line up with the kernel's.
+//
+
+#define ASSERT_MEMORY_ADVICE_EQUIVALENT()                   \
+    ASSERT((POSIX_MADV_NORMAL == IoAdviceNormal) &&         \
+           (POSIX_MADV_RANDOM == IoAdviceRandom) &&         \
+           (POSIX_MADV_SEQUENTIAL == IoAdviceSequential) && \
+           (POSIX_MADV_WILLNEED == IoAdviceWillNeed) &&     \
+           (POSIX_MADV_DONTNEED == IoAdviceDontNeed) &&     \
+           (MADV_HUGEPAGE == IoAdviceLargePages) &&         \
+           (MADV_NOHUGEPAGE == IoAdviceNoLargePages))
+
 //
 // ---------------------------------------------------------------- Definitions
 //
@@ -61,6 +78,13 @@ ClpOpenSharedMemoryObject (
     PHANDLE Handle
     );
 
+int
+ClpAdviseMemory (
+    void *Address,
+    size_t Length,
+    int Advice
+    );
+
 //
 // -------------------------------------------------------------------- Globals
 //
@@ -359,6 +383,99 @@ Return Value:
     return 0;
 }
 
+LIBC_API
+int
+madvise (
+    void *Address,
+    size_t Length,
+    int Advice
+    )
+
+/*++
+
+Routine Description:
+
+    This routine passes a hint about the expected access pattern of a region
+    of the current process' memory. Hints for regions mapped from a file are
+    applied to the file's cached pages.
+
+Arguments:
+
+    Address - Supplies the start of the region. This must be aligned to a page
+        boundary.
+
+    Length - Supplies the size, in bytes, of the region.
+
+    Advice - Supplies the hint. See MADV_* definitions.
+
+Return Value:
+
+    Returns 0 on success.
+
+    -1 on failure. The errno variable will be set to indicate the error.
+
+--*/
+
+{
+
+    int Status;
+
+    if ((Advice < MADV_NORMAL) || (Advice > MADV_NOHUGEPAGE)) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    Status = ClpAdviseMemory(Address, Length, Advice);
+    if (Status != 0) {
+        errno = Status;
+        return -1;
+    }
+
+    return 0;
+}
+
+LIBC_API
+int
+posix_madvise (
+    void *Address,
+    size_t Length,
+    int Advice
+    )
+
+/*++
+
+Routine Description:
+
+    This routine passes a hint about the expected access pattern of a region
+    of the current process' memory. Hints for regions mapped from a file are
+    applied to the file's cached pages.
+
+Arguments:
+
+    Address - Supplies the start of the region. This must be aligned to a page
+        boundary.
+
+    Length - Supplies the size, in bytes, of the region.
+
+    Advice - Supplies the hint. See POSIX_MADV_* definitions.
+
+Return Value:
+
+    Returns 0 on success.
+
+    Returns an error number on failure. The errno variable is not set.
+
+--*/
+
+{
+
+    if ((Advice < POSIX_MADV_NORMAL) || (Advice > POSIX_MADV_DONTNEED)) {
+        return EINVAL;
+    }
+
+    return ClpAdviseMemory(Address, Length, Advice);
+}
+
 LIBC_API
 int
 shm_open (
@@ -945,3 +1062,57 @@ Return Value:
     return Status;
 }
 
+int
+ClpAdviseMemory (
+    void *Address,
+    size_t Length,
+    int Advice
+    )
+
+/*++
+
+Routine Description:
+
+    This routine passes a memory hint along to the kernel.
+
+Arguments:
+
+    Address - Supplies the start of the region. This must be aligned to a page
+        boundary.
+
+    Length - Supplies the size, in bytes, of the region.
+
+    Advice - Supplies the hint, which has already been validated. See MADV_*
+        definitions.
+
+Return Value:
+
+    Returns 0 on success.
+
+    Returns an error number on failure. The errno variable is not set.
+
+--*/
+
+{
+
+    KSTATUS Status;
+
+    ASSERT_MEMORY_ADVICE_EQUIVALENT();
+
+    Status = OsAdviseMemory(Address, Length, Advice);
+    if (!KSUCCESS(Status)) {
+
+        //
+        // Unmapped memory in the range is reported as out of memory.
+        //
+
+        if (Status == STATUS_INVALID_ADDRESS_RANGE) {
+            return ENOMEM;
+        }
+
+        return ClConvertKstatusToErrorNumber(Status);
+    }
+
+    return 0;
+}
+
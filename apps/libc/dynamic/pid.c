@@ -34,6 +34,7 @@ Module Name:
 #include <stdio.h>
 #include <unistd.h>
 #include <errno.h>
+#include <limits.h>
 
 //
 // ---------------------------------------------------------------- Definitions
@@ -1225,11 +1226,32 @@ Return Value:
 
 {
 
-    //
-    // TODO: Implement nice.
-    //
+    LONG NiceValue;
+    SCHEDULER_PARAMETERS Parameters;
+    KSTATUS Status;
 
-    return 0;
+    Status = OsSetSchedulingParameters(ProcessIdProcess, 0, NULL, &Parameters);
+    if (!KSUCCESS(Status)) {
+        errno = ClConvertKstatusToErrorNumber(Status);
+        return -1;
+    }
+
+    NiceValue = Parameters.NiceValue + Increment;
+    if (NiceValue < -NZERO) {
+        NiceValue = -NZERO;
+
+    } else if (NiceValue > NZERO - 1) {
+        NiceValue = NZERO - 1;
+    }
+
+    Parameters.NiceValue = NiceValue;
+    Status = OsSetSchedulingParameters(ProcessIdProcess, 0, &Parameters, NULL);
+    if (!KSUCCESS(Status)) {
+        errno = ClConvertKstatusToErrorNumber(Status);
+        return -1;
+    }
+
+    return NiceValue;
 }
 
 //
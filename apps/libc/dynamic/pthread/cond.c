@@ -103,7 +103,11 @@ Return Value:
     PPTHREAD_CONDITION_ATTRIBUTE AttributeInternal;
     PPTHREAD_CONDITION ConditionInternal;
 
+    ASSERT(sizeof(pthread_cond_t) >= sizeof(PTHREAD_CONDITION));
+
     ConditionInternal = (PPTHREAD_CONDITION)Condition;
+    ConditionInternal->Waiters = 0;
+    ConditionInternal->Mutex = NULL;
     if (Attribute == NULL) {
         ConditionInternal->State = 0;
         return 0;
@@ -562,7 +566,9 @@ ClpPulseCondition (
 Routine Description:
 
     This routine wakes the given number of threads blocked on the condition
-    variable.
+    variable. When waking everyone, only one thread is actually woken and the
+    rest are moved to wait on the mutex if possible, since they would only
+    immediately block on it anyway.
 
 Arguments:
 
@@ -578,7 +584,12 @@ Return Value:
 
 {
 
-    ULONG Operation;
+    ULONG Flags;
+    KSTATUS KernelStatus;
+    PPTHREAD_MUTEX Mutex;
+    PULONG MutexAddress;
+    ULONG NewState;
+    ULONG RequeueCount;
     ULONG ThreadCount;
 
     //
@@ -586,14 +597,56 @@ Return Value:
     // get into the kernel.
     //
 
-    RtlAtomicAdd32(&(Condition->State), 1 << PTHREAD_CONDITION_COUNTER_SHIFT);
-    ThreadCount = Count;
-    Operation = UserLockWake;
-    if ((Condition->State & PTHREAD_CONDITION_SHARED) == 0) {
-        Operation |= USER_LOCK_PRIVATE;
+    NewState = RtlAtomicAdd32(&(Condition->State),
+                              1 << PTHREAD_CONDITION_COUNTER_SHIFT);
+
+    NewState += 1 << PTHREAD_CONDITION_COUNTER_SHIFT;
+
+    //
+    // If nobody is waiting, there's no need to call the kernel at all. Any
+    // thread about to wait will see the counter change.
+    //
+
+    if (Condition->Waiters == 0) {
+        return 0;
+    }
+
+    Flags = 0;
+    if ((NewState & PTHREAD_CONDITION_SHARED) == 0) {
+        Flags |= USER_LOCK_PRIVATE;
+    }
+
+    //
+    // For a broadcast, try to wake one thread and move the rest onto the
+    // mutex. This fails if the state changed again in the meantime, in which
+    // case just fall back to waking everybody. The recorded mutex address is
+    // only meaningful in this process, so shared condition variables always
+    // wake everybody.
+    //
+
+    if ((Count != 1) && (Flags != 0)) {
+        Mutex = Condition->Mutex;
+        if (Mutex != NULL) {
+            MutexAddress = ClpGetMutexWaitAddress(Mutex);
+            if (MutexAddress != NULL) {
+                ThreadCount = 1;
+                RequeueCount = MAX_ULONG;
+                KernelStatus = OsUserLockRequeue(&(Condition->State),
+                                                 Flags,
+                                                 NewState,
+                                                 &ThreadCount,
+                                                 MutexAddress,
+                                                 &RequeueCount);
+
+                if (KSUCCESS(KernelStatus)) {
+                    return 0;
+                }
+            }
+        }
     }
 
-    OsUserLock(&(Condition->State), Operation, &ThreadCount, 0);
+    ThreadCount = Count;
+    OsUserLock(&(Condition->State), UserLockWake | Flags, &ThreadCount, 0);
     return 0;
 }
 
@@ -650,6 +703,19 @@ Return Value:
 
     OldState = Condition->State;
 
+    //
+    // Record the mutex so that a broadcast can move waiters directly onto it,
+    // and note that there is a waiter so pulses know to call the kernel. A
+    // shared condition variable may be pulsed from another process, where
+    // this address means nothing, so it never records one.
+    //
+
+    if ((OldState & PTHREAD_CONDITION_SHARED) == 0) {
+        Condition->Mutex = (PPTHREAD_MUTEX)Mutex;
+    }
+
+    RtlAtomicAdd32(&(Condition->Waiters), 1);
+
     //
     // Unlock the mutex and perform the wait.
     //
@@ -690,7 +756,8 @@ Return Value:
 
     } while (KernelStatus == STATUS_INTERRUPTED);
 
-    pthread_mutex_lock(Mutex);
+    RtlAtomicAdd32(&(Condition->Waiters), (ULONG)-1);
+    ClpAcquireMutexForCondition((PPTHREAD_MUTEX)Mutex);
     if (KernelStatus == STATUS_TIMEOUT) {
         return ETIMEDOUT;
     }
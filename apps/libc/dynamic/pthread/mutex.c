@@ -782,6 +782,110 @@ Return Value:
     return Result;
 }
 
+int
+ClpAcquireMutexForCondition (
+    PPTHREAD_MUTEX Mutex
+    )
+
+/*++
+
+Routine Description:
+
+    This routine reacquires a mutex on behalf of a thread returning from a
+    condition variable wait. Since the thread may have been moved directly
+    onto the mutex by a broadcast, normal mutexes are always acquired in the
+    locked with waiters state so that any other moved threads get woken.
+
+Arguments:
+
+    Mutex - Supplies a pointer to the mutex to acquire.
+
+Return Value:
+
+    0 on success.
+
+    Returns an error number on failure.
+
+--*/
+
+{
+
+    ULONG LockedWithWaiters;
+    ULONG OldState;
+    ULONG Operation;
+    ULONG Shared;
+    ULONG Unlocked;
+
+    if ((Mutex->State & PTHREAD_MUTEX_STATE_TYPE_MASK) != 0) {
+        return pthread_mutex_lock((pthread_mutex_t *)Mutex);
+    }
+
+    Shared = Mutex->State & PTHREAD_MUTEX_STATE_SHARED;
+    LockedWithWaiters = Shared | PTHREAD_MUTEX_STATE_LOCKED_WITH_WAITERS;
+    Unlocked = Shared | PTHREAD_MUTEX_STATE_UNLOCKED;
+    Operation = UserLockWait;
+    if (Shared == 0) {
+        Operation |= USER_LOCK_PRIVATE;
+    }
+
+    while (TRUE) {
+        OldState = RtlAtomicExchange32(&(Mutex->State), LockedWithWaiters);
+        if (OldState == Unlocked) {
+            break;
+        }
+
+        OldState = LockedWithWaiters;
+        OsUserLock(&(Mutex->State),
+                   Operation,
+                   &OldState,
+                   SYS_WAIT_TIME_INDEFINITE);
+    }
+
+    return 0;
+}
+
+PULONG
+ClpGetMutexWaitAddress (
+    PPTHREAD_MUTEX Mutex
+    )
+
+/*++
+
+Routine Description:
+
+    This routine returns the address process private condition variable
+    waiters can be moved to in order to wait on the given mutex.
+
+Arguments:
+
+    Mutex - Supplies a pointer to the mutex.
+
+Return Value:
+
+    Returns a pointer to the mutex state waiters can block on.
+
+    NULL if waiters cannot be moved directly to the mutex, either because it
+    is recursive or error checking, or because it is shared between
+    processes.
+
+--*/
+
+{
+
+    ULONG State;
+
+    State = Mutex->State;
+    if ((State & PTHREAD_MUTEX_STATE_TYPE_MASK) != 0) {
+        return NULL;
+    }
+
+    if ((State & PTHREAD_MUTEX_STATE_SHARED) != 0) {
+        return NULL;
+    }
+
+    return &(Mutex->State);
+}
+
 //
 // --------------------------------------------------------- Internal Functions
 //
@@ -1042,6 +1042,93 @@ Return Value:
     return 0;
 }
 
+PTHREAD_API
+int
+pthread_getaffinity_np (
+    pthread_t ThreadId,
+    size_t SetSize,
+    cpu_set_t *Set
+    )
+
+/*++
+
+Routine Description:
+
+    This routine gets the set of processors the given thread is allowed to
+    run on.
+
+Arguments:
+
+    ThreadId - Supplies the thread to operate on.
+
+    SetSize - Supplies the size of the processor set buffer, in bytes.
+
+    Set - Supplies a pointer where the processor set will be returned.
+
+Return Value:
+
+    0 on success.
+
+    Returns an error number on failure.
+
+--*/
+
+{
+
+    PPTHREAD Thread;
+
+    Thread = (PPTHREAD)ThreadId;
+    return ClpSetThreadAffinity(ProcessIdThread,
+                                Thread->ThreadId,
+                                SetSize,
+                                NULL,
+                                Set);
+}
+
+PTHREAD_API
+int
+pthread_setaffinity_np (
+    pthread_t ThreadId,
+    size_t SetSize,
+    const cpu_set_t *Set
+    )
+
+/*++
+
+Routine Description:
+
+    This routine sets the set of processors the given thread is allowed to
+    run on. If the thread is running on a processor that is no longer in the
+    set, it moves the next time it is scheduled out.
+
+Arguments:
+
+    ThreadId - Supplies the thread to operate on.
+
+    SetSize - Supplies the size of the processor set buffer, in bytes.
+
+    Set - Supplies a pointer to the new processor set.
+
+Return Value:
+
+    0 on success.
+
+    Returns an error number on failure.
+
+--*/
+
+{
+
+    PPTHREAD Thread;
+
+    Thread = (PPTHREAD)ThreadId;
+    return ClpSetThreadAffinity(ProcessIdThread,
+                                Thread->ThreadId,
+                                SetSize,
+                                Set,
+                                NULL);
+}
+
 PTHREAD_API
 void
 __pthread_cleanup_push (
@@ -144,10 +144,19 @@ Structure Description:
 
     State - Stores the state of the condition variable.
 
+    Waiters - Stores the number of threads currently blocked on the condition
+        variable.
+
+    Mutex - Stores a pointer to the mutex most recently used to wait on the
+        condition variable. This is only valid while there are waiters, and is
+        used by broadcast to move waiters directly onto the mutex.
+
 --*/
 
 typedef struct _PTHREAD_CONDITION {
     ULONG State;
+    ULONG Waiters;
+    PPTHREAD_MUTEX Mutex;
 } PTHREAD_CONDITION, *PPTHREAD_CONDITION;
 
 /*++
@@ -474,3 +483,55 @@ Return Value:
 
 --*/
 
+
+int
+ClpAcquireMutexForCondition (
+    PPTHREAD_MUTEX Mutex
+    );
+
+/*++
+
+Routine Description:
+
+    This routine reacquires a mutex on behalf of a thread returning from a
+    condition variable wait. Since the thread may have been moved directly
+    onto the mutex by a broadcast, normal mutexes are always acquired in the
+    locked with waiters state so that any other moved threads get woken.
+
+Arguments:
+
+    Mutex - Supplies a pointer to the mutex to acquire.
+
+Return Value:
+
+    0 on success.
+
+    Returns an error number on failure.
+
+--*/
+
+PULONG
+ClpGetMutexWaitAddress (
+    PPTHREAD_MUTEX Mutex
+    );
+
+/*++
+
+Routine Description:
+
+    This routine returns the address process private condition variable
+    waiters can be moved to in order to wait on the given mutex.
+
+Arguments:
+
+    Mutex - Supplies a pointer to the mutex.
+
+Return Value:
+
+    Returns a pointer to the mutex state waiters can block on.
+
+    NULL if waiters cannot be moved directly to the mutex, either because it
+    is recursive or error checking, or because it is shared between
+    processes.
+
+--*/
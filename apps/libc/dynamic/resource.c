@@ -110,11 +110,36 @@ Return Value:
 
 {
 
+    SCHEDULER_PARAMETERS Parameters;
+    KSTATUS Status;
+
     //
-    // TODO: Implement getpriority.
+    // Nice values are only tracked per process and thread, so there is no
+    // way to express the process group or user variants.
     //
 
-    return 0;
+    if (Which != PRIO_PROCESS) {
+        if ((Which == PRIO_PGRP) || (Which == PRIO_USER)) {
+            errno = ENOTSUP;
+
+        } else {
+            errno = EINVAL;
+        }
+
+        return -1;
+    }
+
+    Status = OsSetSchedulingParameters(ProcessIdProcess,
+                                       (PROCESS_ID)Who,
+                                       NULL,
+                                       &Parameters);
+
+    if (!KSUCCESS(Status)) {
+        errno = ClConvertKstatusToErrorNumber(Status);
+        return -1;
+    }
+
+    return Parameters.NiceValue;
 }
 
 LIBC_API
@@ -154,12 +179,55 @@ Return Value:
 
 {
 
+    SCHEDULER_PARAMETERS Parameters;
+    KSTATUS Status;
+
+    if (Which != PRIO_PROCESS) {
+        if ((Which == PRIO_PGRP) || (Which == PRIO_USER)) {
+            errno = ENOTSUP;
+
+        } else {
+            errno = EINVAL;
+        }
+
+        return -1;
+    }
+
     //
-    // TODO: Implement setpriority.
+    // Out of range values are silently clamped to the valid range.
     //
 
-    errno = ENOSYS;
-    return -1;
+    if (Value < -NZERO) {
+        Value = -NZERO;
+
+    } else if (Value > NZERO - 1) {
+        Value = NZERO - 1;
+    }
+
+    //
+    // Get the current parameters so that the policy and real-time priority
+    // are preserved.
+    //
+
+    Status = OsSetSchedulingParameters(ProcessIdProcess,
+                                       (PROCESS_ID)Who,
+                                       NULL,
+                                       &Parameters);
+
+    if (KSUCCESS(Status)) {
+        Parameters.NiceValue = Value;
+        Status = OsSetSchedulingParameters(ProcessIdProcess,
+                                           (PROCESS_ID)Who,
+                                           &Parameters,
+                                           NULL);
+    }
+
+    if (!KSUCCESS(Status)) {
+        errno = ClConvertKstatusToErrorNumber(Status);
+        return -1;
+    }
+
+    return 0;
 }
 
 LIBC_API
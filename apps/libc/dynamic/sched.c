@@ -32,6 +32,7 @@ Module Name:
 #include "libcp.h"
 #include <sched.h>
 #include <errno.h>
+#include <string.h>
 
 //
 // ---------------------------------------------------------------- Definitions
@@ -45,6 +46,16 @@ Module Name:
 // ----------------------------------------------- Internal Function Prototypes
 //
 
+SCHEDULER_POLICY
+ClpConvertSchedulingPolicyToKernel (
+    int Policy
+    );
+
+int
+ClpConvertSchedulingPolicyFromKernel (
+    SCHEDULER_POLICY Policy
+    );
+
 //
 // -------------------------------------------------------------------- Globals
 //
@@ -94,7 +105,608 @@ Return Value:
     return 0;
 }
 
+LIBC_API
+int
+sched_get_priority_max (
+    int Policy
+    )
+
+/*++
+
+Routine Description:
+
+    This routine returns the maximum priority value for the given scheduling
+    policy.
+
+Arguments:
+
+    Policy - Supplies the scheduling policy. See SCHED_* definitions.
+
+Return Value:
+
+    Returns the maximum priority value on success.
+
+    -1 on error, and the errno variable will contain more information.
+
+--*/
+
+{
+
+    switch (Policy) {
+    case SCHED_OTHER:
+        return 0;
+
+    case SCHED_FIFO:
+    case SCHED_RR:
+        return SCHEDULER_REAL_TIME_PRIORITY_MAX;
+
+    default:
+        break;
+    }
+
+    errno = EINVAL;
+    return -1;
+}
+
+LIBC_API
+int
+sched_get_priority_min (
+    int Policy
+    )
+
+/*++
+
+Routine Description:
+
+    This routine returns the minimum priority value for the given scheduling
+    policy.
+
+Arguments:
+
+    Policy - Supplies the scheduling policy. See SCHED_* definitions.
+
+Return Value:
+
+    Returns the minimum priority value on success.
+
+    -1 on error, and the errno variable will contain more information.
+
+--*/
+
+{
+
+    switch (Policy) {
+    case SCHED_OTHER:
+        return 0;
+
+    case SCHED_FIFO:
+    case SCHED_RR:
+        return SCHEDULER_REAL_TIME_PRIORITY_MIN;
+
+    default:
+        break;
+    }
+
+    errno = EINVAL;
+    return -1;
+}
+
+LIBC_API
+int
+sched_getscheduler (
+    pid_t ProcessId
+    )
+
+/*++
+
+Routine Description:
+
+    This routine returns the scheduling policy of the given process.
+
+Arguments:
+
+    ProcessId - Supplies the ID of the process to query. Supply zero to use
+        the calling process.
+
+Return Value:
+
+    Returns the scheduling policy on success. See SCHED_* definitions.
+
+    -1 on error, and the errno variable will contain more information.
+
+--*/
+
+{
+
+    SCHEDULER_PARAMETERS Parameters;
+    KSTATUS Status;
+
+    Status = OsSetSchedulingParameters(ProcessIdProcess,
+                                       ProcessId,
+                                       NULL,
+                                       &Parameters);
+
+    if (!KSUCCESS(Status)) {
+        errno = ClConvertKstatusToErrorNumber(Status);
+        return -1;
+    }
+
+    return ClpConvertSchedulingPolicyFromKernel(Parameters.Policy);
+}
+
+LIBC_API
+int
+sched_setscheduler (
+    pid_t ProcessId,
+    int Policy,
+    const struct sched_param *Parameter
+    )
+
+/*++
+
+Routine Description:
+
+    This routine sets the scheduling policy and priority of the given process.
+    The process' nice value is preserved.
+
+Arguments:
+
+    ProcessId - Supplies the ID of the process to set. Supply zero to use the
+        calling process.
+
+    Policy - Supplies the new scheduling policy. See SCHED_* definitions.
+
+    Parameter - Supplies a pointer to the new scheduling priority.
+
+Return Value:
+
+    Returns the previous scheduling policy on success.
+
+    -1 on error, and the errno variable will contain more information.
+
+--*/
+
+{
+
+    SCHEDULER_POLICY KernelPolicy;
+    SCHEDULER_PARAMETERS Parameters;
+    int PreviousPolicy;
+    KSTATUS Status;
+
+    PreviousPolicy = -1;
+    if (Parameter == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    KernelPolicy = ClpConvertSchedulingPolicyToKernel(Policy);
+    if (KernelPolicy == SchedulerPolicyInvalid) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (KernelPolicy == SchedulerPolicyFair) {
+        if (Parameter->sched_priority != 0) {
+            errno = EINVAL;
+            return -1;
+        }
+
+    } else if ((Parameter->sched_priority <
+                SCHEDULER_REAL_TIME_PRIORITY_MIN) ||
+               (Parameter->sched_priority >
+                SCHEDULER_REAL_TIME_PRIORITY_MAX)) {
+
+        errno = EINVAL;
+        return -1;
+    }
+
+    //
+    // Get the current parameters first to preserve the nice value.
+    //
+
+    Status = OsSetSchedulingParameters(ProcessIdProcess,
+                                       ProcessId,
+                                       NULL,
+                                       &Parameters);
+
+    if (!KSUCCESS(Status)) {
+        goto sched_setschedulerEnd;
+    }
+
+    PreviousPolicy = ClpConvertSchedulingPolicyFromKernel(Parameters.Policy);
+    Parameters.Policy = KernelPolicy;
+    Parameters.RealTimePriority = Parameter->sched_priority;
+    Status = OsSetSchedulingParameters(ProcessIdProcess,
+                                       ProcessId,
+                                       &Parameters,
+                                       NULL);
+
+sched_setschedulerEnd:
+    if (!KSUCCESS(Status)) {
+        errno = ClConvertKstatusToErrorNumber(Status);
+        return -1;
+    }
+
+    return PreviousPolicy;
+}
+
+LIBC_API
+int
+sched_getparam (
+    pid_t ProcessId,
+    struct sched_param *Parameter
+    )
+
+/*++
+
+Routine Description:
+
+    This routine returns the scheduling priority of the given process.
+
+Arguments:
+
+    ProcessId - Supplies the ID of the process to query. Supply zero to use
+        the calling process.
+
+    Parameter - Supplies a pointer where the scheduling priority will be
+        returned.
+
+Return Value:
+
+    0 on success.
+
+    -1 on error, and the errno variable will contain more information.
+
+--*/
+
+{
+
+    SCHEDULER_PARAMETERS Parameters;
+    KSTATUS Status;
+
+    if (Parameter == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    Status = OsSetSchedulingParameters(ProcessIdProcess,
+                                       ProcessId,
+                                       NULL,
+                                       &Parameters);
+
+    if (!KSUCCESS(Status)) {
+        errno = ClConvertKstatusToErrorNumber(Status);
+        return -1;
+    }
+
+    Parameter->sched_priority = 0;
+    if (Parameters.Policy != SchedulerPolicyFair) {
+        Parameter->sched_priority = Parameters.RealTimePriority;
+    }
+
+    return 0;
+}
+
+LIBC_API
+int
+sched_setparam (
+    pid_t ProcessId,
+    const struct sched_param *Parameter
+    )
+
+/*++
+
+Routine Description:
+
+    This routine sets the scheduling priority of the given process without
+    changing its scheduling policy.
+
+Arguments:
+
+    ProcessId - Supplies the ID of the process to set. Supply zero to use the
+        calling process.
+
+    Parameter - Supplies a pointer to the new scheduling priority.
+
+Return Value:
+
+    0 on success.
+
+    -1 on error, and the errno variable will contain more information.
+
+--*/
+
+{
+
+    int Policy;
+    int Result;
+
+    Policy = sched_getscheduler(ProcessId);
+    if (Policy < 0) {
+        return -1;
+    }
+
+    Result = sched_setscheduler(ProcessId, Policy, Parameter);
+    if (Result < 0) {
+        return -1;
+    }
+
+    return 0;
+}
+
+LIBC_API
+int
+sched_getaffinity (
+    pid_t ProcessId,
+    size_t SetSize,
+    cpu_set_t *Set
+    )
+
+/*++
+
+Routine Description:
+
+    This routine gets the set of processors the given process is allowed to
+    run on.
+
+Arguments:
+
+    ProcessId - Supplies the ID of the process to query. Supply zero to use
+        the calling process. The affinity of the calling thread is returned
+        for the calling process.
+
+    SetSize - Supplies the size of the processor set buffer, in bytes.
+
+    Set - Supplies a pointer where the processor set will be returned.
+
+Return Value:
+
+    0 on success.
+
+    -1 on error, and the errno variable will contain more information.
+
+--*/
+
+{
+
+    int Error;
+
+    Error = ClpSetThreadAffinity(ProcessIdProcess,
+                                 ProcessId,
+                                 SetSize,
+                                 NULL,
+                                 Set);
+
+    if (Error != 0) {
+        errno = Error;
+        return -1;
+    }
+
+    return 0;
+}
+
+LIBC_API
+int
+sched_setaffinity (
+    pid_t ProcessId,
+    size_t SetSize,
+    const cpu_set_t *Set
+    )
+
+/*++
+
+Routine Description:
+
+    This routine sets the set of processors every thread in the given process
+    is allowed to run on. Threads created afterwards inherit the set of the
+    thread that creates them.
+
+Arguments:
+
+    ProcessId - Supplies the ID of the process to set. Supply zero to use the
+        calling process.
+
+    SetSize - Supplies the size of the processor set buffer, in bytes.
+
+    Set - Supplies a pointer to the new processor set.
+
+Return Value:
+
+    0 on success.
+
+    -1 on error, and the errno variable will contain more information.
+
+--*/
+
+{
+
+    int Error;
+
+    Error = ClpSetThreadAffinity(ProcessIdProcess,
+                                 ProcessId,
+                                 SetSize,
+                                 Set,
+                                 NULL);
+
+    if (Error != 0) {
+        errno = Error;
+        return -1;
+    }
+
+    return 0;
+}
+
+int
+ClpSetThreadAffinity (
+    PROCESS_ID_TYPE Type,
+    PROCESS_ID Id,
+    size_t SetSize,
+    const cpu_set_t *NewSet,
+    cpu_set_t *OldSet
+    )
+
+/*++
+
+Routine Description:
+
+    This routine gets or sets the processor affinity of a thread or process,
+    converting between C library processor sets and kernel affinity masks.
+
+Arguments:
+
+    Type - Supplies the type of identifier given. Valid values are
+        ProcessIdProcess and ProcessIdThread.
+
+    Id - Supplies the process or thread ID. Supply zero to use the current
+        process or thread.
+
+    SetSize - Supplies the size of the given processor set buffers, in bytes.
+        Processors beyond what fits in the buffer are treated as not being in
+        the new set.
+
+    NewSet - Supplies an optional pointer to the new processor set.
+
+    OldSet - Supplies an optional pointer where the previous processor set
+        will be returned.
+
+Return Value:
+
+    0 on success.
+
+    Returns an error number on failure.
+
+--*/
+
+{
+
+    PROCESSOR_AFFINITY Affinity;
+    PPROCESSOR_AFFINITY NewAffinity;
+    PROCESSOR_AFFINITY OldAffinity;
+    ULONG Processor;
+    ULONG ProcessorCount;
+    KSTATUS Status;
+
+    ProcessorCount = (SetSize / sizeof(unsigned long)) * _NCPUBITS;
+    if (ProcessorCount == 0) {
+        return EINVAL;
+    }
+
+    if (ProcessorCount > PROCESSOR_AFFINITY_MAX_PROCESSORS) {
+        ProcessorCount = PROCESSOR_AFFINITY_MAX_PROCESSORS;
+    }
+
+    NewAffinity = NULL;
+    if (NewSet != NULL) {
+        RtlZeroMemory(&Affinity, sizeof(PROCESSOR_AFFINITY));
+        for (Processor = 0; Processor < ProcessorCount; Processor += 1) {
+            if (CPU_ISSET(Processor, NewSet)) {
+                PROCESSOR_AFFINITY_ADD(&Affinity, Processor);
+            }
+        }
+
+        NewAffinity = &Affinity;
+    }
+
+    Status = OsSetThreadAffinity(Type, Id, NewAffinity, &OldAffinity);
+    if (!KSUCCESS(Status)) {
+        return ClConvertKstatusToErrorNumber(Status);
+    }
+
+    if (OldSet != NULL) {
+        memset(OldSet, 0, SetSize);
+        for (Processor = 0; Processor < ProcessorCount; Processor += 1) {
+            if (PROCESSOR_AFFINITY_CHECK(&OldAffinity, Processor)) {
+                CPU_SET(Processor, OldSet);
+            }
+        }
+    }
+
+    return 0;
+}
+
 //
 // --------------------------------------------------------- Internal Functions
 //
 
+SCHEDULER_POLICY
+ClpConvertSchedulingPolicyToKernel (
+    int Policy
+    )
+
+/*++
+
+Routine Description:
+
+    This routine converts a C library scheduling policy into a kernel
+    scheduling policy.
+
+Arguments:
+
+    Policy - Supplies the C library scheduling policy. See SCHED_*.
+
+Return Value:
+
+    Returns the kernel scheduling policy, or SchedulerPolicyInvalid if the
+    given policy is not recognized.
+
+--*/
+
+{
+
+    switch (Policy) {
+    case SCHED_OTHER:
+        return SchedulerPolicyFair;
+
+    case SCHED_FIFO:
+        return SchedulerPolicyFifo;
+
+    case SCHED_RR:
+        return SchedulerPolicyRoundRobin;
+
+    default:
+        break;
+    }
+
+    return SchedulerPolicyInvalid;
+}
+
+int
+ClpConvertSchedulingPolicyFromKernel (
+    SCHEDULER_POLICY Policy
+    )
+
+/*++
+
+Routine Description:
+
+    This routine converts a kernel scheduling policy into a C library
+    scheduling policy.
+
+Arguments:
+
+    Policy - Supplies the kernel scheduling policy.
+
+Return Value:
+
+    Returns the C library scheduling policy. See SCHED_*.
+
+--*/
+
+{
+
+    switch (Policy) {
+    case SchedulerPolicyFifo:
+        return SCHED_FIFO;
+
+    case SchedulerPolicyRoundRobin:
+        return SCHED_RR;
+
+    case SchedulerPolicyFair:
+    default:
+        break;
+    }
+
+    return SCHED_OTHER;
+}
+
+
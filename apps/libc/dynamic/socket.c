@@ -36,6 +36,7 @@ Module Name:
 #include <fcntl.h>
 #include <netinet/in.h>
 #include <netinet/tcp.h>
+#include <stdlib.h>
 #include <string.h>
 #include <sys/socket.h>
 #include <sys/time.h>
@@ -60,7 +61,8 @@ Module Name:
            (MSG_CTRUNC == SOCKET_IO_CONTROL_TRUNCATED) && \
            (MSG_NOSIGNAL == SOCKET_IO_NO_SIGNAL) &&       \
            (MSG_DONTWAIT == SOCKET_IO_NON_BLOCKING) &&    \
-           (MSG_DONTROUTE == SOCKET_IO_DONT_ROUTE))
+           (MSG_DONTROUTE == SOCKET_IO_DONT_ROUTE) &&     \
+           (MSG_WAITFORONE == SOCKET_IO_WAIT_FOR_ONE))
 
 #define ASSERT_SOCKET_TYPES_EQUIVALENT()                   \
     ASSERT((SOCK_DGRAM == NetSocketDatagram) &&            \
@@ -120,11 +122,15 @@ Module Name:
            (IPV6_UNICAST_HOPS == SocketIp6OptionUnicastHops) &&       \
            (IPV6_V6ONLY == SocketIp6OptionIpv6Only))
 
-#define ASSERT_SOCKET_TCP_OPTIONS_EQUIVALENT()                  \
-    ASSERT((TCP_NODELAY == SocketTcpOptionNoDelay) &&           \
-           (TCP_KEEPIDLE == SocketTcpOptionKeepAliveTimeout) && \
-           (TCP_KEEPINTVL == SocketTcpOptionKeepAlivePeriod) && \
-           (TCP_KEEPCNT == SocketTcpOptionKeepAliveProbeLimit))
+#define ASSERT_SOCKET_TCP_OPTIONS_EQUIVALENT()                        \
+    ASSERT((TCP_NODELAY == SocketTcpOptionNoDelay) &&                 \
+           (TCP_KEEPIDLE == SocketTcpOptionKeepAliveTimeout) &&       \
+           (TCP_KEEPINTVL == SocketTcpOptionKeepAlivePeriod) &&       \
+           (TCP_KEEPCNT == SocketTcpOptionKeepAliveProbeLimit) &&     \
+           (TCP_CONGESTION == SocketTcpOptionCongestionControl) &&    \
+           (TCP_PACING == SocketTcpOptionPacing) &&                   \
+           (TCP_CONGESTION_NEW_RENO == SocketTcpCongestionNewReno) && \
+           (TCP_CONGESTION_CUBIC == SocketTcpCongestionCubic))
 
 //
 // ---------------------------------------------------------------- Definitions
@@ -154,6 +160,16 @@ ClpGetPathFromSocketAddress (
     PUINTN PathSize
     );
 
+int
+ClpPerformMessageIo (
+    int Socket,
+    struct mmsghdr *Messages,
+    unsigned int MessageCount,
+    int Flags,
+    ULONG TimeoutInMilliseconds,
+    BOOL Write
+    );
+
 //
 // -------------------------------------------------------------------- Globals
 //
@@ -921,6 +937,55 @@ Return Value:
     return (ssize_t)(Parameters.BytesCompleted);
 }
 
+LIBC_API
+int
+sendmmsg (
+    int Socket,
+    struct mmsghdr *Messages,
+    unsigned int MessageCount,
+    int Flags
+    )
+
+/*++
+
+Routine Description:
+
+    This routine sends several messages out of a socket with a single call
+    into the kernel. Datagram sockets send consecutive messages bound for the
+    same destination down the network stack together.
+
+Arguments:
+
+    Socket - Supplies the file descriptor of the socket to send data out of.
+
+    Messages - Supplies an array of messages to send. On return, the msg_len
+        member of each sent message is set to the number of bytes sent.
+
+    MessageCount - Supplies the number of elements in the message array.
+
+    Flags - Supplies a bitfield of flags governing the transmission of the data.
+        See MSG_* definitions.
+
+Return Value:
+
+    Returns the number of messages sent on success. This may be less than the
+    count supplied if an error stopped the batch part way through.
+
+    -1 on error if no messages could be sent, and the errno variable will be
+    set to contain more information.
+
+--*/
+
+{
+
+    return ClpPerformMessageIo(Socket,
+                               Messages,
+                               MessageCount,
+                               Flags,
+                               SYS_WAIT_TIME_INDEFINITE,
+                               TRUE);
+}
+
 LIBC_API
 ssize_t
 recv (
@@ -1198,6 +1263,69 @@ Return Value:
     return (ssize_t)(Parameters.BytesCompleted);
 }
 
+LIBC_API
+int
+recvmmsg (
+    int Socket,
+    struct mmsghdr *Messages,
+    unsigned int MessageCount,
+    int Flags,
+    struct timespec *Timeout
+    )
+
+/*++
+
+Routine Description:
+
+    This routine receives several messages from a socket with a single call
+    into the kernel.
+
+Arguments:
+
+    Socket - Supplies the file descriptor of the socket to receive data from.
+
+    Messages - Supplies an array of initialized message structures where the
+        received messages will be returned. On return, the msg_len member of
+        each received message is set to the number of bytes received.
+
+    MessageCount - Supplies the number of elements in the message array.
+
+    Flags - Supplies a bitfield of flags governing the reception of the data.
+        See MSG_* definitions. MSG_WAITFORONE is also accepted here.
+
+    Timeout - Supplies an optional pointer to the amount of time to wait for
+        each message. Supply NULL to wait indefinitely.
+
+Return Value:
+
+    Returns the number of messages received on success.
+
+    -1 on error if no messages were received, and the errno variable will be
+    set to contain more information.
+
+--*/
+
+{
+
+    INT Result;
+    ULONG TimeoutInMilliseconds;
+
+    Result = ClpConvertSpecificTimeoutToSystemTimeout(Timeout,
+                                                      &TimeoutInMilliseconds);
+
+    if (Result != 0) {
+        errno = Result;
+        return -1;
+    }
+
+    return ClpPerformMessageIo(Socket,
+                               Messages,
+                               MessageCount,
+                               Flags,
+                               TimeoutInMilliseconds,
+                               FALSE);
+}
+
 LIBC_API
 int
 shutdown (
@@ -2035,3 +2163,244 @@ Return Value:
     return;
 }
 
+int
+ClpPerformMessageIo (
+    int Socket,
+    struct mmsghdr *Messages,
+    unsigned int MessageCount,
+    int Flags,
+    ULONG TimeoutInMilliseconds,
+    BOOL Write
+    )
+
+/*++
+
+Routine Description:
+
+    This routine sends or receives an array of messages on a socket, handing
+    them to the kernel in batches of up to SYS_SOCKET_MESSAGE_MAX.
+
+Arguments:
+
+    Socket - Supplies the file descriptor of the socket.
+
+    Messages - Supplies the array of messages.
+
+    MessageCount - Supplies the number of elements in the message array.
+
+    Flags - Supplies a bitfield of MSG_* flags governing the operation.
+
+    TimeoutInMilliseconds - Supplies the time to wait for each message.
+
+    Write - Supplies a boolean indicating whether to send the messages (TRUE)
+        or receive them (FALSE).
+
+Return Value:
+
+    Returns the number of messages sent or received on success.
+
+    -1 on error if no messages completed, and the errno variable will be set
+    to contain more information.
+
+--*/
+
+{
+
+    PNETWORK_ADDRESS Addresses;
+    ULONG BatchCompleted;
+    ULONG BatchCount;
+    ULONG BatchIndex;
+    unsigned int Completed;
+    int Error;
+    ULONG IoFlags;
+    struct msghdr *Message;
+    PSOCKET_IO_PARAMETERS Parameters;
+    PSOCKET_MESSAGE SocketMessages;
+    KSTATUS Status;
+    UINTN VectorIndex;
+
+    if (MessageCount == 0) {
+        return 0;
+    }
+
+    if (Messages == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (MessageCount > INT_MAX) {
+        MessageCount = INT_MAX;
+    }
+
+    BatchCount = MessageCount;
+    if (BatchCount > SYS_SOCKET_MESSAGE_MAX) {
+        BatchCount = SYS_SOCKET_MESSAGE_MAX;
+    }
+
+    SocketMessages = malloc(BatchCount *
+                            (sizeof(SOCKET_MESSAGE) + sizeof(NETWORK_ADDRESS)));
+
+    if (SocketMessages == NULL) {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    ASSERT_SOCKET_IO_FLAGS_ARE_EQUIVALENT();
+
+    Addresses = (PNETWORK_ADDRESS)(SocketMessages + BatchCount);
+    Completed = 0;
+    Error = 0;
+    IoFlags = 0;
+    if (Write != FALSE) {
+        IoFlags = SYS_IO_FLAG_WRITE;
+    }
+
+    while (Completed < MessageCount) {
+        BatchCount = MessageCount - Completed;
+        if (BatchCount > SYS_SOCKET_MESSAGE_MAX) {
+            BatchCount = SYS_SOCKET_MESSAGE_MAX;
+        }
+
+        for (BatchIndex = 0; BatchIndex < BatchCount; BatchIndex += 1) {
+            Message = &(Messages[Completed + BatchIndex].msg_hdr);
+            Parameters = &(SocketMessages[BatchIndex].Parameters);
+            Parameters->Size = 0;
+            for (VectorIndex = 0;
+                 VectorIndex < Message->msg_iovlen;
+                 VectorIndex += 1) {
+
+                Parameters->Size += Message->msg_iov[VectorIndex].iov_len;
+            }
+
+            //
+            // Truncate the byte count, so that it does not exceed the maximum
+            // number of bytes that can be returned.
+            //
+
+            if (Parameters->Size > (UINTN)SSIZE_MAX) {
+                Parameters->Size = (UINTN)SSIZE_MAX;
+            }
+
+            Parameters->BytesCompleted = 0;
+            Parameters->IoFlags = IoFlags;
+            Parameters->SocketIoFlags = Flags;
+            Parameters->TimeoutInMilliseconds = TimeoutInMilliseconds;
+            Parameters->NetworkAddress = NULL;
+            Parameters->RemotePath = NULL;
+            Parameters->RemotePathSize = 0;
+            if ((Message->msg_name != NULL) && (Message->msg_namelen != 0)) {
+                if (Write != FALSE) {
+                    Status = ClConvertToNetworkAddress(
+                                               Message->msg_name,
+                                               Message->msg_namelen,
+                                               &(Addresses[BatchIndex]),
+                                               &(Parameters->RemotePath),
+                                               &(Parameters->RemotePathSize));
+
+                    if (!KSUCCESS(Status)) {
+                        Error = EINVAL;
+                        break;
+                    }
+
+                } else {
+                    Addresses[BatchIndex].Domain = NetDomainInvalid;
+                    ClpGetPathFromSocketAddress(
+                                               Message->msg_name,
+                                               &(Message->msg_namelen),
+                                               &(Parameters->RemotePath),
+                                               &(Parameters->RemotePathSize));
+                }
+
+                Parameters->NetworkAddress = &(Addresses[BatchIndex]);
+            }
+
+            Parameters->ControlData = Message->msg_control;
+            Parameters->ControlDataSize = Message->msg_controllen;
+            SocketMessages[BatchIndex].VectorArray =
+                                              (PIO_VECTOR)(Message->msg_iov);
+
+            SocketMessages[BatchIndex].VectorCount = Message->msg_iovlen;
+        }
+
+        //
+        // Send whatever was converted before a bad address. The bad message
+        // gets reported once everything before it has gone out.
+        //
+
+        BatchCount = BatchIndex;
+        if (BatchCount == 0) {
+            break;
+        }
+
+        Status = OsSocketPerformMessageIo((HANDLE)(UINTN)Socket,
+                                          SocketMessages,
+                                          BatchCount,
+                                          IoFlags,
+                                          &BatchCompleted);
+
+        if (!KSUCCESS(Status)) {
+            if (Status == STATUS_NOT_SUPPORTED) {
+                Error = EOPNOTSUPP;
+
+            } else {
+                Error = ClConvertKstatusToErrorNumber(Status);
+            }
+
+            break;
+        }
+
+        for (BatchIndex = 0; BatchIndex < BatchCompleted; BatchIndex += 1) {
+            Message = &(Messages[Completed + BatchIndex].msg_hdr);
+            Parameters = &(SocketMessages[BatchIndex].Parameters);
+            Messages[Completed + BatchIndex].msg_len =
+                                                   Parameters->BytesCompleted;
+
+            if (Write != FALSE) {
+                continue;
+            }
+
+            Message->msg_flags = Parameters->SocketIoFlags;
+            Message->msg_controllen = Parameters->ControlDataSize;
+
+            //
+            // If requested, attempt to translate the network address provided
+            // by the kernel to a C library socket address.
+            //
+
+            if ((Message->msg_name != NULL) && (Message->msg_namelen != 0)) {
+                Status = ClConvertFromNetworkAddress(
+                                                &(Addresses[BatchIndex]),
+                                                Message->msg_name,
+                                                &(Message->msg_namelen),
+                                                Parameters->RemotePath,
+                                                Parameters->RemotePathSize);
+
+                if (!KSUCCESS(Status)) {
+                    Message->msg_namelen = 0;
+                }
+            }
+        }
+
+        Completed += BatchCompleted;
+        if ((BatchCompleted < BatchCount) || (Error != 0)) {
+            break;
+        }
+
+        //
+        // Once something has been received, later batches only collect what
+        // is already queued.
+        //
+
+        if ((Flags & MSG_WAITFORONE) != 0) {
+            Flags |= MSG_DONTWAIT;
+        }
+    }
+
+    free(SocketMessages);
+    if ((Completed == 0) && (Error != 0)) {
+        errno = Error;
+        return -1;
+    }
+
+    return Completed;
+}
@@ -98,19 +98,7 @@ Return Value:
 
 {
 
-    PSTR CharacterBuffer;
-
-    CharacterBuffer = (PSTR)Buffer;
-    while (Size != 0) {
-        if ((unsigned char)*CharacterBuffer == (unsigned char)Character) {
-            return CharacterBuffer;
-        }
-
-        CharacterBuffer += 1;
-        Size -= 1;
-    }
-
-    return NULL;
+    return ClStringRoutines.FindByte(Buffer, Character, Size);
 }
 
 LIBC_API
@@ -484,19 +472,7 @@ Return Value:
 
 {
 
-    while (TRUE) {
-        if (*String == (char)Character) {
-            return (char *)String;
-        }
-
-        if (*String == '\0') {
-            break;
-        }
-
-        String += 1;
-    }
-
-    return NULL;
+    return ClStringRoutines.FindCharacter(String, Character);
 }
 
 LIBC_API
@@ -528,22 +504,7 @@ Return Value:
 
 {
 
-    char *LastOccurrence;
-
-    LastOccurrence = NULL;
-    while (TRUE) {
-        if (*String == (char)Character) {
-            LastOccurrence = (char *)String;
-        }
-
-        if (*String == '\0') {
-            break;
-        }
-
-        String += 1;
-    }
-
-    return LastOccurrence;
+    return ClStringRoutines.FindLastCharacter(String, Character);
 }
 
 LIBC_API
@@ -571,7 +532,7 @@ Return Value:
 
 {
 
-    return RtlStringLength((PSTR)String);
+    return ClStringRoutines.StringLength(String);
 }
 
 LIBC_API
@@ -604,14 +565,14 @@ Return Value:
 
 {
 
-    size_t Size;
+    const char *Terminator;
 
-    Size = 0;
-    while ((Size < MaxLength) && (String[Size] != '\0')) {
-        Size += 1;
+    Terminator = ClStringRoutines.FindByte(String, '\0', MaxLength);
+    if (Terminator == NULL) {
+        return MaxLength;
     }
 
-    return Size;
+    return Terminator - String;
 }
 
 LIBC_API
@@ -951,7 +912,7 @@ Return Value:
 
 {
 
-    return strncmp(String1, String2, (size_t)-1);
+    return ClStringRoutines.CompareStrings(String1, String2);
 }
 
 LIBC_API
@@ -0,0 +1,1570 @@
+/*++
+
+Copyright (c) 2026 Minoca Corp.
+
+    This file is licensed under the terms of the GNU Lesser General Public
+    License version 3. Alternative licensing terms are available. Contact
+    info@minocacorp.com for details. See the LICENSE file at the root of this
+    project for complete licensing information.
+
+Module Name:
+
+    strvec.c
+
+Abstract:
+
+    This module implements the hot string scanning routines (strlen, memchr,
+    strchr, strrchr, strcmp, wcslen and wmemchr) a word or a vector at a time.
+    The fastest implementation the processor supports is selected once when
+    the C library initializes.
+
+Author:
+
+    Minoca Corp. 17-Oct-2026
+
+Environment:
+
+    User Mode C Library
+
+--*/
+
+//
+// ------------------------------------------------------------------- Includes
+//
+
+#include "libcp.h"
+#include <string.h>
+#include <wchar.h>
+
+#if defined(__i386__) || defined(__x86_64__)
+
+#define CL_STRING_X86 1
+
+#include <cpuid.h>
+#include <immintrin.h>
+
+#endif
+
+//
+// --------------------------------------------------------------------- Macros
+//
+
+//
+// This macro evaluates to non-zero if any byte of the given word is zero. It
+// may report false positives in bytes above a true zero byte, but never
+// reports a zero byte when there is none.
+//
+
+#define CL_WORD_HAS_ZERO(_Word) \
+    (((_Word) - CL_WORD_ONES) & ~(_Word) & CL_WORD_HIGHS)
+
+//
+// This macro determines whether the given pointer is aligned to a word.
+//
+
+#define CL_WORD_ALIGNED(_Pointer) \
+    (((UINTN)(_Pointer) & (sizeof(UINTN) - 1)) == 0)
+
+//
+// This macro determines whether an unaligned 16 byte load from the given
+// pointer might run into the next page.
+//
+
+#define CL_STRING_NEAR_PAGE_END(_Pointer) \
+    (((UINTN)(_Pointer) & (CL_STRING_PAGE_SIZE - 1)) > CL_STRING_PAGE_SIZE - 16)
+
+//
+// This macro compiles a function for a particular instruction set extension,
+// regardless of the baseline the rest of the library is compiled for.
+//
+
+#define CL_STRING_TARGET(_Target) __attribute__((__target__(_Target)))
+
+//
+// ---------------------------------------------------------------- Definitions
+//
+
+#define CL_WORD_ONES ((UINTN)-1 / 0xFF)
+#define CL_WORD_HIGHS (CL_WORD_ONES * 0x80)
+
+//
+// Vector loads that straddle this boundary might fault, since the next page
+// may not be mapped. Aligned loads never straddle it.
+//
+
+#define CL_STRING_PAGE_SIZE 4096
+
+//
+// Define the CPUID bits consulted when selecting an implementation.
+//
+
+#define CL_CPUID_1_EDX_SSE2 0x04000000
+#define CL_CPUID_1_ECX_OSXSAVE_AVX 0x18000000
+#define CL_CPUID_7_EBX_AVX2 0x00000020
+#define CL_XCR0_SSE_AVX 0x00000006
+
+//
+// ------------------------------------------------------ Data Type Definitions
+//
+
+//
+// Define a word type that the compiler knows may alias any other type, since
+// strings are read a word at a time.
+//
+
+typedef UINTN __attribute__((__may_alias__)) CL_WORD, *PCL_WORD;
+
+//
+// ----------------------------------------------- Internal Function Prototypes
+//
+
+void *
+ClpFindByteWord (
+    const void *Buffer,
+    int Character,
+    size_t Size
+    );
+
+size_t
+ClpStringLengthWord (
+    const char *String
+    );
+
+char *
+ClpFindCharacterWord (
+    const char *String,
+    int Character
+    );
+
+char *
+ClpFindLastCharacterWord (
+    const char *String,
+    int Character
+    );
+
+int
+ClpCompareStringsWord (
+    const char *String1,
+    const char *String2
+    );
+
+size_t
+ClpStringLengthWideWord (
+    const wchar_t *String
+    );
+
+wchar_t *
+ClpFindWideWord (
+    const wchar_t *Buffer,
+    wchar_t Character,
+    size_t Size
+    );
+
+#if defined(CL_STRING_X86)
+
+ULONG
+ClpGetStringImplementationLimit (
+    VOID
+    );
+
+void *
+ClpFindByteSse2 (
+    const void *Buffer,
+    int Character,
+    size_t Size
+    );
+
+size_t
+ClpStringLengthSse2 (
+    const char *String
+    );
+
+char *
+ClpFindCharacterSse2 (
+    const char *String,
+    int Character
+    );
+
+char *
+ClpFindLastCharacterSse2 (
+    const char *String,
+    int Character
+    );
+
+int
+ClpCompareStringsSse2 (
+    const char *String1,
+    const char *String2
+    );
+
+size_t
+ClpStringLengthWideSse2 (
+    const wchar_t *String
+    );
+
+wchar_t *
+ClpFindWideSse2 (
+    const wchar_t *Buffer,
+    wchar_t Character,
+    size_t Size
+    );
+
+void *
+ClpFindByteAvx2 (
+    const void *Buffer,
+    int Character,
+    size_t Size
+    );
+
+size_t
+ClpStringLengthAvx2 (
+    const char *String
+    );
+
+char *
+ClpFindCharacterAvx2 (
+    const char *String,
+    int Character
+    );
+
+#endif
+
+//
+// -------------------------------------------------------------------- Globals
+//
+
+//
+// Start out with the word at a time routines, which work everywhere. These
+// are in use until the C library initializes.
+//
+
+CL_STRING_ROUTINES ClStringRoutines = {
+    ClpFindByteWord,
+    ClpStringLengthWord,
+    ClpFindCharacterWord,
+    ClpFindLastCharacterWord,
+    ClpCompareStringsWord,
+    ClpStringLengthWideWord,
+    ClpFindWideWord
+};
+
+//
+// Store the routines for each implementation. Implementations not compiled
+// for this architecture are left empty.
+//
+
+const CL_STRING_ROUTINES ClStringRoutineTable[ClStringImplementationCount] = {
+    {
+        ClpFindByteWord,
+        ClpStringLengthWord,
+        ClpFindCharacterWord,
+        ClpFindLastCharacterWord,
+        ClpCompareStringsWord,
+        ClpStringLengthWideWord,
+        ClpFindWideWord
+    },
+
+#if defined(CL_STRING_X86)
+
+    {
+        ClpFindByteSse2,
+        ClpStringLengthSse2,
+        ClpFindCharacterSse2,
+        ClpFindLastCharacterSse2,
+        ClpCompareStringsSse2,
+        ClpStringLengthWideSse2,
+        ClpFindWideSse2
+    },
+
+    //
+    // The AVX2 set only replaces the routines that spend their time streaming
+    // through long runs of memory.
+    //
+
+    {
+        ClpFindByteAvx2,
+        ClpStringLengthAvx2,
+        ClpFindCharacterAvx2,
+        ClpFindLastCharacterSse2,
+        ClpCompareStringsSse2,
+        ClpStringLengthWideSse2,
+        ClpFindWideSse2
+    },
+
+#endif
+
+};
+
+//
+// ------------------------------------------------------------------ Functions
+//
+
+VOID
+ClpInitializeStringRoutines (
+    VOID
+    )
+
+/*++
+
+Routine Description:
+
+    This routine selects the fastest string routine implementations the
+    processor supports.
+
+Arguments:
+
+    None.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    CL_STRING_IMPLEMENTATION Implementation;
+
+    Implementation = ClStringImplementationCount;
+    while (Implementation > ClStringImplementationWord) {
+        Implementation -= 1;
+        if (ClpSelectStringRoutines(Implementation) != FALSE) {
+            break;
+        }
+    }
+
+    return;
+}
+
+BOOL
+ClpSelectStringRoutines (
+    CL_STRING_IMPLEMENTATION Implementation
+    )
+
+/*++
+
+Routine Description:
+
+    This routine switches the string routines over to the given
+    implementation, if the processor supports it.
+
+Arguments:
+
+    Implementation - Supplies the implementation to use.
+
+Return Value:
+
+    TRUE if the implementation was selected.
+
+    FALSE if the processor or compiler does not support the implementation.
+    The current selection is left unchanged.
+
+--*/
+
+{
+
+    if ((Implementation >= ClStringImplementationCount) ||
+        (ClStringRoutineTable[Implementation].FindByte == NULL)) {
+
+        return FALSE;
+    }
+
+#if defined(CL_STRING_X86)
+
+    if (Implementation > ClpGetStringImplementationLimit()) {
+        return FALSE;
+    }
+
+#endif
+
+    ClStringRoutines = ClStringRoutineTable[Implementation];
+    return TRUE;
+}
+
+//
+// --------------------------------------------------------- Internal Functions
+//
+
+void *
+ClpFindByteWord (
+    const void *Buffer,
+    int Character,
+    size_t Size
+    )
+
+/*++
+
+Routine Description:
+
+    This routine implements memchr a word at a time.
+
+Arguments:
+
+    Buffer - Supplies a pointer to the buffer to search.
+
+    Character - Supplies the character (converted to an unsigned char) to
+        locate.
+
+    Size - Supplies the size of the buffer in bytes.
+
+Return Value:
+
+    Returns a pointer to the first occurrence of the character, or NULL if it
+    was not found.
+
+--*/
+
+{
+
+    UCHAR Byte;
+    const UCHAR *Bytes;
+    UINTN Pattern;
+    UINTN Word;
+
+    Byte = (UCHAR)Character;
+    Bytes = Buffer;
+    while ((Size != 0) && (!CL_WORD_ALIGNED(Bytes))) {
+        if (*Bytes == Byte) {
+            return (void *)Bytes;
+        }
+
+        Bytes += 1;
+        Size -= 1;
+    }
+
+    Pattern = CL_WORD_ONES * Byte;
+    while (Size >= sizeof(UINTN)) {
+        Word = *(const CL_WORD *)Bytes ^ Pattern;
+        if (CL_WORD_HAS_ZERO(Word) != 0) {
+            break;
+        }
+
+        Bytes += sizeof(UINTN);
+        Size -= sizeof(UINTN);
+    }
+
+    while (Size != 0) {
+        if (*Bytes == Byte) {
+            return (void *)Bytes;
+        }
+
+        Bytes += 1;
+        Size -= 1;
+    }
+
+    return NULL;
+}
+
+size_t
+ClpStringLengthWord (
+    const char *String
+    )
+
+/*++
+
+Routine Description:
+
+    This routine implements strlen a word at a time.
+
+Arguments:
+
+    String - Supplies a pointer to the string.
+
+Return Value:
+
+    Returns the length of the string, not including the null terminator.
+
+--*/
+
+{
+
+    const char *Current;
+
+    Current = String;
+    while (!CL_WORD_ALIGNED(Current)) {
+        if (*Current == '\0') {
+            return Current - String;
+        }
+
+        Current += 1;
+    }
+
+    //
+    // Aligned word reads never cross into the next page, so reading past the
+    // terminator within the final word is safe.
+    //
+
+    while (CL_WORD_HAS_ZERO(*(const CL_WORD *)Current) == 0) {
+        Current += sizeof(UINTN);
+    }
+
+    while (*Current != '\0') {
+        Current += 1;
+    }
+
+    return Current - String;
+}
+
+char *
+ClpFindCharacterWord (
+    const char *String,
+    int Character
+    )
+
+/*++
+
+Routine Description:
+
+    This routine implements strchr a word at a time.
+
+Arguments:
+
+    String - Supplies a pointer to the string to search.
+
+    Character - Supplies the character to search for.
+
+Return Value:
+
+    Returns a pointer to the first occurrence of the character, or NULL if it
+    does not exist in the string.
+
+--*/
+
+{
+
+    char Byte;
+    UINTN Pattern;
+    UINTN Word;
+
+    Byte = (char)Character;
+    while (!CL_WORD_ALIGNED(String)) {
+        if (*String == Byte) {
+            return (char *)String;
+        }
+
+        if (*String == '\0') {
+            return NULL;
+        }
+
+        String += 1;
+    }
+
+    Pattern = CL_WORD_ONES * (UCHAR)Byte;
+    while (TRUE) {
+        Word = *(const CL_WORD *)String;
+        if ((CL_WORD_HAS_ZERO(Word) | CL_WORD_HAS_ZERO(Word ^ Pattern)) != 0) {
+            break;
+        }
+
+        String += sizeof(UINTN);
+    }
+
+    while (TRUE) {
+        if (*String == Byte) {
+            return (char *)String;
+        }
+
+        if (*String == '\0') {
+            break;
+        }
+
+        String += 1;
+    }
+
+    return NULL;
+}
+
+char *
+ClpFindLastCharacterWord (
+    const char *String,
+    int Character
+    )
+
+/*++
+
+Routine Description:
+
+    This routine implements strrchr a word at a time.
+
+Arguments:
+
+    String - Supplies a pointer to the string to search.
+
+    Character - Supplies the character to search for.
+
+Return Value:
+
+    Returns a pointer to the last occurrence of the character, or NULL if it
+    does not exist in the string.
+
+--*/
+
+{
+
+    char *Found;
+    char *Last;
+
+    if ((char)Character == '\0') {
+        return (char *)String + ClpStringLengthWord(String);
+    }
+
+    Last = NULL;
+    while (TRUE) {
+        Found = ClpFindCharacterWord(String, Character);
+        if (Found == NULL) {
+            break;
+        }
+
+        Last = Found;
+        String = Found + 1;
+    }
+
+    return Last;
+}
+
+int
+ClpCompareStringsWord (
+    const char *String1,
+    const char *String2
+    )
+
+/*++
+
+Routine Description:
+
+    This routine implements strcmp a word at a time when both strings share
+    the same word alignment, and a byte at a time otherwise.
+
+Arguments:
+
+    String1 - Supplies the first string to compare.
+
+    String2 - Supplies the second string to compare.
+
+Return Value:
+
+    Returns the difference between the first pair of bytes (as unsigned
+    chars) that differ, or 0 if the strings are equal.
+
+--*/
+
+{
+
+    const UCHAR *Left;
+    const UCHAR *Right;
+    UINTN Word;
+
+    Left = (const UCHAR *)String1;
+    Right = (const UCHAR *)String2;
+    while (!CL_WORD_ALIGNED(Left)) {
+        if ((*Left != *Right) || (*Left == '\0')) {
+            return *Left - *Right;
+        }
+
+        Left += 1;
+        Right += 1;
+    }
+
+    if (CL_WORD_ALIGNED(Right)) {
+        while (TRUE) {
+            Word = *(const CL_WORD *)Left;
+            if ((Word != *(const CL_WORD *)Right) ||
+                (CL_WORD_HAS_ZERO(Word) != 0)) {
+
+                break;
+            }
+
+            Left += sizeof(UINTN);
+            Right += sizeof(UINTN);
+        }
+    }
+
+    while ((*Left == *Right) && (*Left != '\0')) {
+        Left += 1;
+        Right += 1;
+    }
+
+    return *Left - *Right;
+}
+
+size_t
+ClpStringLengthWideWord (
+    const wchar_t *String
+    )
+
+/*++
+
+Routine Description:
+
+    This routine implements wcslen without any vector instructions.
+
+Arguments:
+
+    String - Supplies a pointer to the wide string.
+
+Return Value:
+
+    Returns the length of the string in characters, not including the null
+    terminator.
+
+--*/
+
+{
+
+    const wchar_t *Current;
+
+    Current = String;
+    while (*Current != L'\0') {
+        Current += 1;
+    }
+
+    return Current - String;
+}
+
+wchar_t *
+ClpFindWideWord (
+    const wchar_t *Buffer,
+    wchar_t Character,
+    size_t Size
+    )
+
+/*++
+
+Routine Description:
+
+    This routine implements wmemchr without any vector instructions.
+
+Arguments:
+
+    Buffer - Supplies a pointer to the buffer to search.
+
+    Character - Supplies the wide character to locate.
+
+    Size - Supplies the size of the buffer in characters.
+
+Return Value:
+
+    Returns a pointer to the first occurrence of the character, or NULL if it
+    was not found.
+
+--*/
+
+{
+
+    while (Size != 0) {
+        if (*Buffer == Character) {
+            return (wchar_t *)Buffer;
+        }
+
+        Buffer += 1;
+        Size -= 1;
+    }
+
+    return NULL;
+}
+
+#if defined(CL_STRING_X86)
+
+ULONG
+ClpGetStringImplementationLimit (
+    VOID
+    )
+
+/*++
+
+Routine Description:
+
+    This routine determines the most capable string implementation the
+    processor and operating system support.
+
+Arguments:
+
+    None.
+
+Return Value:
+
+    Returns the highest usable CL_STRING_IMPLEMENTATION value.
+
+--*/
+
+{
+
+    ULONG Eax;
+    ULONG Ebx;
+    ULONG Ecx;
+    ULONG Edx;
+    ULONG Features;
+    ULONG MaxLeaf;
+    ULONG XcrHigh;
+    ULONG XcrLow;
+
+    MaxLeaf = __get_cpuid_max(0, NULL);
+    if (MaxLeaf < 1) {
+        return ClStringImplementationWord;
+    }
+
+    __cpuid(1, Eax, Ebx, Ecx, Edx);
+    if ((Edx & CL_CPUID_1_EDX_SSE2) == 0) {
+        return ClStringImplementationWord;
+    }
+
+    //
+    // AVX2 registers are only usable if the OS has enabled saving them on
+    // context switches.
+    //
+
+    Features = Ecx;
+    if ((MaxLeaf < 7) ||
+        ((Features & CL_CPUID_1_ECX_OSXSAVE_AVX) !=
+         CL_CPUID_1_ECX_OSXSAVE_AVX)) {
+
+        return ClStringImplementationSse2;
+    }
+
+    __cpuid_count(7, 0, Eax, Ebx, Ecx, Edx);
+    if ((Ebx & CL_CPUID_7_EBX_AVX2) == 0) {
+        return ClStringImplementationSse2;
+    }
+
+    __asm__ __volatile__ ("xgetbv" : "=a" (XcrLow), "=d" (XcrHigh) : "c" (0));
+    if ((XcrLow & CL_XCR0_SSE_AVX) != CL_XCR0_SSE_AVX) {
+        return ClStringImplementationSse2;
+    }
+
+    return ClStringImplementationAvx2;
+}
+
+CL_STRING_TARGET("sse2")
+void *
+ClpFindByteSse2 (
+    const void *Buffer,
+    int Character,
+    size_t Size
+    )
+
+/*++
+
+Routine Description:
+
+    This routine implements memchr 16 bytes at a time.
+
+Arguments:
+
+    Buffer - Supplies a pointer to the buffer to search.
+
+    Character - Supplies the character (converted to an unsigned char) to
+        locate.
+
+    Size - Supplies the size of the buffer in bytes.
+
+Return Value:
+
+    Returns a pointer to the first occurrence of the character, or NULL if it
+    was not found.
+
+--*/
+
+{
+
+    UINTN Available;
+    const __m128i *Block;
+    const UCHAR *Bytes;
+    UINTN Index;
+    ULONG Mask;
+    UINTN Offset;
+    __m128i Pattern;
+
+    if (Size == 0) {
+        return NULL;
+    }
+
+    //
+    // Start with the aligned block containing the buffer, and throw away the
+    // results for the bytes before it.
+    //
+
+    Bytes = Buffer;
+    Offset = (UINTN)Bytes & 15;
+    Pattern = _mm_set1_epi8((char)Character);
+    Block = (const __m128i *)(Bytes - Offset);
+    Mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_load_si128(Block), Pattern));
+
+    Mask >>= Offset;
+    Available = 16 - Offset;
+    while (TRUE) {
+        if (Mask != 0) {
+            Index = __builtin_ctz(Mask);
+            if (Index >= Size) {
+                return NULL;
+            }
+
+            return (void *)(Bytes + Index);
+        }
+
+        if (Size <= Available) {
+            return NULL;
+        }
+
+        Bytes += Available;
+        Size -= Available;
+        Available = 16;
+        Mask = _mm_movemask_epi8(
+                        _mm_cmpeq_epi8(_mm_load_si128((const __m128i *)Bytes),
+                                       Pattern));
+    }
+
+    return NULL;
+}
+
+CL_STRING_TARGET("sse2")
+size_t
+ClpStringLengthSse2 (
+    const char *String
+    )
+
+/*++
+
+Routine Description:
+
+    This routine implements strlen 16 bytes at a time.
+
+Arguments:
+
+    String - Supplies a pointer to the string.
+
+Return Value:
+
+    Returns the length of the string, not including the null terminator.
+
+--*/
+
+{
+
+    const __m128i *Block;
+    ULONG Mask;
+    UINTN Offset;
+    __m128i Zero;
+
+    Offset = (UINTN)String & 15;
+    Block = (const __m128i *)(String - Offset);
+    Zero = _mm_setzero_si128();
+    Mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_load_si128(Block), Zero));
+    Mask >>= Offset;
+    if (Mask != 0) {
+        return __builtin_ctz(Mask);
+    }
+
+    while (TRUE) {
+        Block += 1;
+        Mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_load_si128(Block), Zero));
+        if (Mask != 0) {
+            break;
+        }
+    }
+
+    return (const char *)Block + __builtin_ctz(Mask) - String;
+}
+
+CL_STRING_TARGET("sse2")
+char *
+ClpFindCharacterSse2 (
+    const char *String,
+    int Character
+    )
+
+/*++
+
+Routine Description:
+
+    This routine implements strchr 16 bytes at a time.
+
+Arguments:
+
+    String - Supplies a pointer to the string to search.
+
+    Character - Supplies the character to search for.
+
+Return Value:
+
+    Returns a pointer to the first occurrence of the character, or NULL if it
+    does not exist in the string.
+
+--*/
+
+{
+
+    const __m128i *Block;
+    __m128i Data;
+    const char *Found;
+    ULONG Mask;
+    UINTN Offset;
+    __m128i Pattern;
+    __m128i Zero;
+
+    Offset = (UINTN)String & 15;
+    Block = (const __m128i *)(String - Offset);
+    Pattern = _mm_set1_epi8((char)Character);
+    Zero = _mm_setzero_si128();
+    Data = _mm_load_si128(Block);
+    Mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(Data, Pattern),
+                                          _mm_cmpeq_epi8(Data, Zero)));
+
+    Mask >>= Offset;
+    if (Mask != 0) {
+        Found = String + __builtin_ctz(Mask);
+
+    } else {
+        while (TRUE) {
+            Block += 1;
+            Data = _mm_load_si128(Block);
+            Mask = _mm_movemask_epi8(
+                                 _mm_or_si128(_mm_cmpeq_epi8(Data, Pattern),
+                                              _mm_cmpeq_epi8(Data, Zero)));
+
+            if (Mask != 0) {
+                break;
+            }
+        }
+
+        Found = (const char *)Block + __builtin_ctz(Mask);
+    }
+
+    if (*Found == (char)Character) {
+        return (char *)Found;
+    }
+
+    return NULL;
+}
+
+CL_STRING_TARGET("sse2")
+char *
+ClpFindLastCharacterSse2 (
+    const char *String,
+    int Character
+    )
+
+/*++
+
+Routine Description:
+
+    This routine implements strrchr 16 bytes at a time.
+
+Arguments:
+
+    String - Supplies a pointer to the string to search.
+
+    Character - Supplies the character to search for.
+
+Return Value:
+
+    Returns a pointer to the last occurrence of the character, or NULL if it
+    does not exist in the string.
+
+--*/
+
+{
+
+    const char *Base;
+    ULONG CharacterMask;
+    __m128i Data;
+    const char *Last;
+    UINTN Offset;
+    __m128i Pattern;
+    __m128i Zero;
+    ULONG ZeroMask;
+
+    Offset = (UINTN)String & 15;
+    Base = String - Offset;
+    Pattern = _mm_set1_epi8((char)Character);
+    Zero = _mm_setzero_si128();
+    Last = NULL;
+    Data = _mm_load_si128((const __m128i *)Base);
+    CharacterMask = _mm_movemask_epi8(_mm_cmpeq_epi8(Data, Pattern));
+    ZeroMask = _mm_movemask_epi8(_mm_cmpeq_epi8(Data, Zero));
+    CharacterMask = (CharacterMask >> Offset) << Offset;
+    ZeroMask = (ZeroMask >> Offset) << Offset;
+    while (TRUE) {
+
+        //
+        // Ignore matches after the terminator. The terminator itself counts
+        // as a match if that's what's being searched for.
+        //
+
+        if (ZeroMask != 0) {
+            CharacterMask &= ((ZeroMask & -ZeroMask) << 1) - 1;
+            if (CharacterMask != 0) {
+                Last = Base + 31 - __builtin_clz(CharacterMask);
+            }
+
+            break;
+        }
+
+        if (CharacterMask != 0) {
+            Last = Base + 31 - __builtin_clz(CharacterMask);
+        }
+
+        Base += 16;
+        Data = _mm_load_si128((const __m128i *)Base);
+        CharacterMask = _mm_movemask_epi8(_mm_cmpeq_epi8(Data, Pattern));
+        ZeroMask = _mm_movemask_epi8(_mm_cmpeq_epi8(Data, Zero));
+    }
+
+    return (char *)Last;
+}
+
+CL_STRING_TARGET("sse2")
+int
+ClpCompareStringsSse2 (
+    const char *String1,
+    const char *String2
+    )
+
+/*++
+
+Routine Description:
+
+    This routine implements strcmp 16 bytes at a time. The first string is
+    read with aligned loads, so only the second string's unaligned loads need
+    to watch for the end of a page, which only happens once every 256 blocks.
+
+Arguments:
+
+    String1 - Supplies the first string to compare.
+
+    String2 - Supplies the second string to compare.
+
+Return Value:
+
+    Returns the difference between the first pair of bytes (as unsigned
+    chars) that differ, or 0 if the strings are equal.
+
+--*/
+
+{
+
+    UINTN Index;
+    const UCHAR *Left;
+    __m128i LeftData;
+    ULONG Mask;
+    const UCHAR *Right;
+    __m128i Zero;
+
+    Left = (const UCHAR *)String1;
+    Right = (const UCHAR *)String2;
+    Zero = _mm_setzero_si128();
+
+    //
+    // Compare the first block unaligned if neither load can leave the page,
+    // then step the first string up to its alignment. The minimum of the
+    // equality mask and the left bytes is zero wherever the bytes differ or
+    // the left string ends, so one compare against zero catches both.
+    //
+
+    if ((CL_STRING_NEAR_PAGE_END(Left)) || (CL_STRING_NEAR_PAGE_END(Right))) {
+        while (((UINTN)Left & 15) != 0) {
+            if ((*Left != *Right) || (*Left == '\0')) {
+                return *Left - *Right;
+            }
+
+            Left += 1;
+            Right += 1;
+        }
+
+    } else {
+        LeftData = _mm_loadu_si128((const __m128i *)Left);
+        Mask = _mm_movemask_epi8(
+                   _mm_cmpeq_epi8(
+                       _mm_min_epu8(
+                           _mm_cmpeq_epi8(
+                               LeftData,
+                               _mm_loadu_si128((const __m128i *)Right)),
+                           LeftData),
+                       Zero));
+
+        if (Mask != 0) {
+            Index = __builtin_ctz(Mask);
+            return Left[Index] - Right[Index];
+        }
+
+        Index = 16 - ((UINTN)Left & 15);
+        Left += Index;
+        Right += Index;
+    }
+
+    while (TRUE) {
+        if (CL_STRING_NEAR_PAGE_END(Right)) {
+            for (Index = 0; Index < 16; Index += 1) {
+                if ((Left[Index] != Right[Index]) || (Left[Index] == '\0')) {
+                    return Left[Index] - Right[Index];
+                }
+            }
+
+        } else {
+            LeftData = _mm_load_si128((const __m128i *)Left);
+            Mask = _mm_movemask_epi8(
+                       _mm_cmpeq_epi8(
+                           _mm_min_epu8(
+                               _mm_cmpeq_epi8(
+                                   LeftData,
+                                   _mm_loadu_si128((const __m128i *)Right)),
+                               LeftData),
+                           Zero));
+
+            if (Mask != 0) {
+                Index = __builtin_ctz(Mask);
+                return Left[Index] - Right[Index];
+            }
+        }
+
+        Left += 16;
+        Right += 16;
+    }
+
+    return 0;
+}
+
+CL_STRING_TARGET("sse2")
+size_t
+ClpStringLengthWideSse2 (
+    const wchar_t *String
+    )
+
+/*++
+
+Routine Description:
+
+    This routine implements wcslen 16 bytes at a time.
+
+Arguments:
+
+    String - Supplies a pointer to the wide string.
+
+Return Value:
+
+    Returns the length of the string in characters, not including the null
+    terminator.
+
+--*/
+
+{
+
+    const __m128i *Block;
+    ULONG Mask;
+    UINTN Offset;
+    __m128i Zero;
+
+    //
+    // Vector lanes only line up with characters if the string is naturally
+    // aligned and characters are four bytes.
+    //
+
+    if ((sizeof(wchar_t) != 4) || (((UINTN)String & 3) != 0)) {
+        return ClpStringLengthWideWord(String);
+    }
+
+    Offset = (UINTN)String & 15;
+    Block = (const __m128i *)((const char *)String - Offset);
+    Zero = _mm_setzero_si128();
+    Mask = _mm_movemask_epi8(_mm_cmpeq_epi32(_mm_load_si128(Block), Zero));
+    Mask >>= Offset;
+    if (Mask != 0) {
+        return __builtin_ctz(Mask) / sizeof(wchar_t);
+    }
+
+    while (TRUE) {
+        Block += 1;
+        Mask = _mm_movemask_epi8(_mm_cmpeq_epi32(_mm_load_si128(Block), Zero));
+        if (Mask != 0) {
+            break;
+        }
+    }
+
+    return (const wchar_t *)((const char *)Block + __builtin_ctz(Mask)) -
+           String;
+}
+
+CL_STRING_TARGET("sse2")
+wchar_t *
+ClpFindWideSse2 (
+    const wchar_t *Buffer,
+    wchar_t Character,
+    size_t Size
+    )
+
+/*++
+
+Routine Description:
+
+    This routine implements wmemchr 16 bytes at a time.
+
+Arguments:
+
+    Buffer - Supplies a pointer to the buffer to search.
+
+    Character - Supplies the wide character to locate.
+
+    Size - Supplies the size of the buffer in characters.
+
+Return Value:
+
+    Returns a pointer to the first occurrence of the character, or NULL if it
+    was not found.
+
+--*/
+
+{
+
+    UINTN Available;
+    const __m128i *Block;
+    const char *Bytes;
+    UINTN Index;
+    ULONG Mask;
+    UINTN Offset;
+    __m128i Pattern;
+
+    if ((sizeof(wchar_t) != 4) || (((UINTN)Buffer & 3) != 0)) {
+        return ClpFindWideWord(Buffer, Character, Size);
+    }
+
+    if (Size == 0) {
+        return NULL;
+    }
+
+    Bytes = (const char *)Buffer;
+    Offset = (UINTN)Bytes & 15;
+    Pattern = _mm_set1_epi32(Character);
+    Block = (const __m128i *)(Bytes - Offset);
+    Mask = _mm_movemask_epi8(_mm_cmpeq_epi32(_mm_load_si128(Block), Pattern));
+
+    Mask >>= Offset;
+    Available = (16 - Offset) / sizeof(wchar_t);
+    while (TRUE) {
+        if (Mask != 0) {
+            Index = __builtin_ctz(Mask) / sizeof(wchar_t);
+            if (Index >= Size) {
+                return NULL;
+            }
+
+            return (wchar_t *)Bytes + Index;
+        }
+
+        if (Size <= Available) {
+            return NULL;
+        }
+
+        Bytes += Available * sizeof(wchar_t);
+        Size -= Available;
+        Available = 16 / sizeof(wchar_t);
+        Mask = _mm_movemask_epi8(
+                       _mm_cmpeq_epi32(_mm_load_si128((const __m128i *)Bytes),
+                                       Pattern));
+    }
+
+    return NULL;
+}
+
+CL_STRING_TARGET("avx2")
+void *
+ClpFindByteAvx2 (
+    const void *Buffer,
+    int Character,
+    size_t Size
+    )
+
+/*++
+
+Routine Description:
+
+    This routine implements memchr 32 bytes at a time.
+
+Arguments:
+
+    Buffer - Supplies a pointer to the buffer to search.
+
+    Character - Supplies the character (converted to an unsigned char) to
+        locate.
+
+    Size - Supplies the size of the buffer in bytes.
+
+Return Value:
+
+    Returns a pointer to the first occurrence of the character, or NULL if it
+    was not found.
+
+--*/
+
+{
+
+    UINTN Available;
+    const __m256i *Block;
+    const UCHAR *Bytes;
+    UINTN Index;
+    ULONG Mask;
+    UINTN Offset;
+    __m256i Pattern;
+
+    if (Size == 0) {
+        return NULL;
+    }
+
+    Bytes = Buffer;
+    Offset = (UINTN)Bytes & 31;
+    Pattern = _mm256_set1_epi8((char)Character);
+    Block = (const __m256i *)(Bytes - Offset);
+    Mask = _mm256_movemask_epi8(
+                        _mm256_cmpeq_epi8(_mm256_load_si256(Block), Pattern));
+
+    Mask >>= Offset;
+    Available = 32 - Offset;
+    while (TRUE) {
+        if (Mask != 0) {
+            Index = __builtin_ctz(Mask);
+            if (Index >= Size) {
+                return NULL;
+            }
+
+            return (void *)(Bytes + Index);
+        }
+
+        if (Size <= Available) {
+            return NULL;
+        }
+
+        Bytes += Available;
+        Size -= Available;
+        Available = 32;
+        Mask = _mm256_movemask_epi8(
+                   _mm256_cmpeq_epi8(_mm256_load_si256((const __m256i *)Bytes),
+                                     Pattern));
+    }
+
+    return NULL;
+}
+
+CL_STRING_TARGET("avx2")
+size_t
+ClpStringLengthAvx2 (
+    const char *String
+    )
+
+/*++
+
+Routine Description:
+
+    This routine implements strlen 32 bytes at a time.
+
+Arguments:
+
+    String - Supplies a pointer to the string.
+
+Return Value:
+
+    Returns the length of the string, not including the null terminator.
+
+--*/
+
+{
+
+    const __m256i *Block;
+    ULONG Mask;
+    UINTN Offset;
+    __m256i Zero;
+
+    Offset = (UINTN)String & 31;
+    Block = (const __m256i *)(String - Offset);
+    Zero = _mm256_setzero_si256();
+    Mask = _mm256_movemask_epi8(
+                           _mm256_cmpeq_epi8(_mm256_load_si256(Block), Zero));
+
+    Mask >>= Offset;
+    if (Mask != 0) {
+        return __builtin_ctz(Mask);
+    }
+
+    while (TRUE) {
+        Block += 1;
+        Mask = _mm256_movemask_epi8(
+                           _mm256_cmpeq_epi8(_mm256_load_si256(Block), Zero));
+
+        if (Mask != 0) {
+            break;
+        }
+    }
+
+    return (const char *)Block + __builtin_ctz(Mask) - String;
+}
+
+CL_STRING_TARGET("avx2")
+char *
+ClpFindCharacterAvx2 (
+    const char *String,
+    int Character
+    )
+
+/*++
+
+Routine Description:
+
+    This routine implements strchr 32 bytes at a time.
+
+Arguments:
+
+    String - Supplies a pointer to the string to search.
+
+    Character - Supplies the character to search for.
+
+Return Value:
+
+    Returns a pointer to the first occurrence of the character, or NULL if it
+    does not exist in the string.
+
+--*/
+
+{
+
+    const __m256i *Block;
+    __m256i Data;
+    const char *Found;
+    ULONG Mask;
+    UINTN Offset;
+    __m256i Pattern;
+    __m256i Zero;
+
+    Offset = (UINTN)String & 31;
+    Block = (const __m256i *)(String - Offset);
+    Pattern = _mm256_set1_epi8((char)Character);
+    Zero = _mm256_setzero_si256();
+    Data = _mm256_load_si256(Block);
+    Mask = _mm256_movemask_epi8(
+                         _mm256_or_si256(_mm256_cmpeq_epi8(Data, Pattern),
+                                         _mm256_cmpeq_epi8(Data, Zero)));
+
+    Mask >>= Offset;
+    if (Mask != 0) {
+        Found = String + __builtin_ctz(Mask);
+
+    } else {
+        while (TRUE) {
+            Block += 1;
+            Data = _mm256_load_si256(Block);
+            Mask = _mm256_movemask_epi8(
+                         _mm256_or_si256(_mm256_cmpeq_epi8(Data, Pattern),
+                                         _mm256_cmpeq_epi8(Data, Zero)));
+
+            if (Mask != 0) {
+                break;
+            }
+        }
+
+        Found = (const char *)Block + __builtin_ctz(Mask);
+    }
+
+    if (*Found == (char)Character) {
+        return (char *)Found;
+    }
+
+    return NULL;
+}
+
+#endif
+
@@ -42,6 +42,7 @@ function build() {
         "mathftst.c",
         "qsorttst.c",
         "regextst.c",
+        "strtst.c",
         "testc.c"
     ];
 
@@ -0,0 +1,719 @@
+/*++
+
+Copyright (c) 2026 Minoca Corp.
+
+    This file is licensed under the terms of the GNU General Public License
+    version 3. Alternative licensing terms are available. Contact
+    info@minocacorp.com for details. See the LICENSE file at the root of this
+    project for complete licensing information.
+
+Module Name:
+
+    strtst.c
+
+Abstract:
+
+    This module tests the word and vector implementations of the C library
+    string scanning routines, and measures their throughput.
+
+Author:
+
+    Minoca Corp. 17-Oct-2026
+
+Environment:
+
+    Test
+
+--*/
+
+//
+// ------------------------------------------------------------------- Includes
+//
+
+#include "testc.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+//
+// ---------------------------------------------------------------- Definitions
+//
+
+//
+// Every length up to this one is tested at every alignment up to the
+// alignment count.
+//
+
+#define TEST_STRING_MAX_LENGTH 300
+#define TEST_STRING_ALIGNMENTS 64
+
+//
+// Leave room on either side of the string, and align the whole buffer so that
+// strings can be placed right up against a page boundary.
+//
+
+#define TEST_STRING_PAGE_SIZE 4096
+#define TEST_STRING_BUFFER_SIZE (TEST_STRING_PAGE_SIZE * 4)
+
+#define TEST_STRING_BENCHMARK_BYTES (64 * 1024 * 1024)
+
+//
+// ------------------------------------------------------ Data Type Definitions
+//
+
+//
+// ----------------------------------------------- Internal Function Prototypes
+//
+
+ULONG
+TestStringImplementation (
+    PCL_STRING_ROUTINES Routines,
+    PSTR Name
+    );
+
+ULONG
+TestStringCase (
+    PCL_STRING_ROUTINES Routines,
+    PSTR Name,
+    PUCHAR Left,
+    PUCHAR Right,
+    size_t Length
+    );
+
+ULONG
+TestWideStringCase (
+    PCL_STRING_ROUTINES Routines,
+    PSTR Name,
+    wchar_t *String,
+    size_t Length
+    );
+
+VOID
+TestStringBenchmark (
+    PCL_STRING_ROUTINES Routines,
+    PSTR Name
+    );
+
+PUCHAR
+TestStringReferenceFind (
+    PUCHAR Buffer,
+    UCHAR Character,
+    size_t Size
+    );
+
+PUCHAR
+TestStringAlignBuffer (
+    PUCHAR Buffer
+    );
+
+//
+// -------------------------------------------------------------------- Globals
+//
+
+PSTR TestStringImplementationNames[ClStringImplementationCount] = {
+    "word",
+    "sse2",
+    "avx2"
+};
+
+size_t TestStringBenchmarkLengths[] = {
+    15,
+    64,
+    256,
+    4096,
+    65536
+};
+
+UCHAR TestStringLeftBuffer[TEST_STRING_BUFFER_SIZE + TEST_STRING_PAGE_SIZE];
+UCHAR TestStringRightBuffer[TEST_STRING_BUFFER_SIZE + TEST_STRING_PAGE_SIZE];
+wchar_t TestStringWideBuffer[TEST_STRING_MAX_LENGTH + 64];
+UCHAR TestStringBenchmarkBuffer[(65536 * 2) + 64];
+
+//
+// ------------------------------------------------------------------ Functions
+//
+
+ULONG
+TestStrings (
+    VOID
+    )
+
+/*++
+
+Routine Description:
+
+    This routine tests every string routine implementation the processor
+    supports, and then prints their throughput.
+
+Arguments:
+
+    None.
+
+Return Value:
+
+    Returns the count of test failures.
+
+--*/
+
+{
+
+    ULONG Failures;
+    CL_STRING_IMPLEMENTATION Implementation;
+    CL_STRING_ROUTINES Original;
+
+    Failures = 0;
+    Original = ClStringRoutines;
+    for (Implementation = 0;
+         Implementation < ClStringImplementationCount;
+         Implementation += 1) {
+
+        if (ClpSelectStringRoutines(Implementation) == FALSE) {
+            continue;
+        }
+
+        Failures += TestStringImplementation(
+                           &ClStringRoutines,
+                           TestStringImplementationNames[Implementation]);
+    }
+
+    if (Failures == 0) {
+        for (Implementation = 0;
+             Implementation < ClStringImplementationCount;
+             Implementation += 1) {
+
+            if (ClpSelectStringRoutines(Implementation) == FALSE) {
+                continue;
+            }
+
+            TestStringBenchmark(&ClStringRoutines,
+                                TestStringImplementationNames[Implementation]);
+        }
+    }
+
+    ClStringRoutines = Original;
+    return Failures;
+}
+
+//
+// --------------------------------------------------------- Internal Functions
+//
+
+ULONG
+TestStringImplementation (
+    PCL_STRING_ROUTINES Routines,
+    PSTR Name
+    )
+
+/*++
+
+Routine Description:
+
+    This routine tests one set of string routines across lengths and
+    alignments.
+
+Arguments:
+
+    Routines - Supplies the routines to test.
+
+    Name - Supplies the name of the implementation, for error messages.
+
+Return Value:
+
+    Returns the count of test failures.
+
+--*/
+
+{
+
+    ULONG Alignment;
+    ULONG Failures;
+    PUCHAR Left;
+    PUCHAR LeftPage;
+    size_t Length;
+    PUCHAR Right;
+    PUCHAR RightPage;
+
+    Failures = 0;
+    LeftPage = TestStringAlignBuffer(TestStringLeftBuffer);
+    RightPage = TestStringAlignBuffer(TestStringRightBuffer);
+    for (Length = 0; Length <= TEST_STRING_MAX_LENGTH; Length += 1) {
+        for (Alignment = 0;
+             Alignment < TEST_STRING_ALIGNMENTS;
+             Alignment += 1) {
+
+            Left = LeftPage + TEST_STRING_PAGE_SIZE + Alignment;
+            Right = RightPage + TEST_STRING_PAGE_SIZE +
+                    ((Alignment * 7) % TEST_STRING_ALIGNMENTS);
+
+            Failures += TestStringCase(Routines, Name, Left, Right, Length);
+        }
+
+        //
+        // Also try strings whose terminators sit right at the end of a page,
+        // which exercises the page boundary handling in strcmp.
+        //
+
+        Left = LeftPage + (2 * TEST_STRING_PAGE_SIZE) - Length - 1;
+        Right = RightPage + (3 * TEST_STRING_PAGE_SIZE) - Length - 1;
+        Failures += TestStringCase(Routines, Name, Left, Right, Length);
+        Failures += TestWideStringCase(Routines,
+                                       Name,
+                                       TestStringWideBuffer + (Length % 4),
+                                       Length);
+
+        if (Failures != 0) {
+            break;
+        }
+    }
+
+    return Failures;
+}
+
+ULONG
+TestStringCase (
+    PCL_STRING_ROUTINES Routines,
+    PSTR Name,
+    PUCHAR Left,
+    PUCHAR Right,
+    size_t Length
+    )
+
+/*++
+
+Routine Description:
+
+    This routine tests the string routines on one pair of strings.
+
+Arguments:
+
+    Routines - Supplies the routines to test.
+
+    Name - Supplies the name of the implementation, for error messages.
+
+    Left - Supplies a pointer where the first string should be built.
+
+    Right - Supplies a pointer where the second string should be built.
+
+    Length - Supplies the length of the strings to build.
+
+Return Value:
+
+    Returns the count of test failures.
+
+--*/
+
+{
+
+    PUCHAR Expected;
+    ULONG Failures;
+    size_t Index;
+    PUCHAR Result;
+    int Sign;
+
+    Failures = 0;
+
+    //
+    // Fill the strings with non-zero bytes that repeat rarely, so that each
+    // position can be searched for.
+    //
+
+    for (Index = 0; Index < Length; Index += 1) {
+        Left[Index] = (UCHAR)(((Index * 37) % 251) + 1);
+        Right[Index] = Left[Index];
+    }
+
+    Left[Length] = '\0';
+    Right[Length] = '\0';
+    if (Routines->StringLength((PSTR)Left) != Length) {
+        printf("%s strlen(%d) failed: got %d.\n",
+               Name,
+               (int)Length,
+               (int)Routines->StringLength((PSTR)Left));
+
+        Failures += 1;
+    }
+
+    if (Routines->CompareStrings((PSTR)Left, (PSTR)Right) != 0) {
+        printf("%s strcmp(%d) failed on equal strings.\n", Name, (int)Length);
+        Failures += 1;
+    }
+
+    //
+    // Search for a byte in each position, and a byte not present at all.
+    // The character search routines also find the terminator.
+    //
+
+    for (Index = 0; Index <= Length; Index += 1) {
+        Expected = TestStringReferenceFind(Left, Left[Index], Length + 1);
+        Result = Routines->FindByte(Left, Left[Index], Length + 1);
+        if (Result != Expected) {
+            printf("%s memchr(%d, %d) failed.\n",
+                   Name,
+                   (int)Length,
+                   (int)Index);
+
+            Failures += 1;
+        }
+
+        Result = Routines->FindByte(Left, Left[Index], Index);
+        Expected = TestStringReferenceFind(Left, Left[Index], Index);
+        if (Result != Expected) {
+            printf("%s memchr(%d, %d) read past the size.\n",
+                   Name,
+                   (int)Length,
+                   (int)Index);
+
+            Failures += 1;
+        }
+
+        Expected = TestStringReferenceFind(Left, Left[Index], Length + 1);
+        Result = (PUCHAR)Routines->FindCharacter((PSTR)Left, Left[Index]);
+        if (Result != Expected) {
+            printf("%s strchr(%d, %d) failed.\n",
+                   Name,
+                   (int)Length,
+                   (int)Index);
+
+            Failures += 1;
+        }
+
+        Result = (PUCHAR)Routines->FindLastCharacter((PSTR)Left, Left[Index]);
+        Expected = Left + Length;
+        while ((Expected >= Left) && (*Expected != Left[Index])) {
+            Expected -= 1;
+        }
+
+        if (Result != Expected) {
+            printf("%s strrchr(%d, %d) failed.\n",
+                   Name,
+                   (int)Length,
+                   (int)Index);
+
+            Failures += 1;
+        }
+
+        //
+        // Make the strings differ at this position, in both directions.
+        //
+
+        if (Index < Length) {
+            Right[Index] = (UCHAR)(Left[Index] + 0x80);
+            if (Right[Index] == '\0') {
+                Right[Index] = 1;
+            }
+
+            Sign = Routines->CompareStrings((PSTR)Left, (PSTR)Right);
+            if (((Sign > 0) != (Left[Index] > Right[Index])) || (Sign == 0)) {
+                printf("%s strcmp(%d) missed difference at %d.\n",
+                       Name,
+                       (int)Length,
+                       (int)Index);
+
+                Failures += 1;
+            }
+
+            Right[Index] = Left[Index];
+        }
+
+        if (Failures != 0) {
+            break;
+        }
+    }
+
+    if (Routines->FindByte(Left, 0xFF, Length) != NULL) {
+        printf("%s memchr(%d) found a missing byte.\n", Name, (int)Length);
+        Failures += 1;
+    }
+
+    if ((Routines->FindCharacter((PSTR)Left, 0xFF) != NULL) ||
+        (Routines->FindLastCharacter((PSTR)Left, 0xFF) != NULL)) {
+
+        printf("%s strchr(%d) found a missing character.\n",
+               Name,
+               (int)Length);
+
+        Failures += 1;
+    }
+
+    //
+    // Shorten one string, which should compare as less.
+    //
+
+    if (Length != 0) {
+        Right[Length - 1] = '\0';
+        if (Routines->CompareStrings((PSTR)Left, (PSTR)Right) <= 0) {
+            printf("%s strcmp(%d) failed on a shorter string.\n",
+                   Name,
+                   (int)Length);
+
+            Failures += 1;
+        }
+
+        Right[Length - 1] = Left[Length - 1];
+    }
+
+    return Failures;
+}
+
+ULONG
+TestWideStringCase (
+    PCL_STRING_ROUTINES Routines,
+    PSTR Name,
+    wchar_t *String,
+    size_t Length
+    )
+
+/*++
+
+Routine Description:
+
+    This routine tests the wide string routines on one string.
+
+Arguments:
+
+    Routines - Supplies the routines to test.
+
+    Name - Supplies the name of the implementation, for error messages.
+
+    String - Supplies a pointer where the string should be built.
+
+    Length - Supplies the length of the string to build.
+
+Return Value:
+
+    Returns the count of test failures.
+
+--*/
+
+{
+
+    ULONG Failures;
+    size_t Index;
+    wchar_t *Result;
+
+    Failures = 0;
+    for (Index = 0; Index < Length; Index += 1) {
+        String[Index] = (wchar_t)(Index + 0x100);
+    }
+
+    String[Length] = L'\0';
+    String[Length + 1] = L'\0';
+    if (Routines->StringLengthWide(String) != Length) {
+        printf("%s wcslen(%d) failed.\n", Name, (int)Length);
+        Failures += 1;
+    }
+
+    for (Index = 0; Index <= Length; Index += 1) {
+        Result = Routines->FindWide(String, String[Index], Length + 1);
+        if (Result != String + Index) {
+            printf("%s wmemchr(%d, %d) failed.\n",
+                   Name,
+                   (int)Length,
+                   (int)Index);
+
+            Failures += 1;
+            break;
+        }
+
+        if (Routines->FindWide(String, String[Index], Index) != NULL) {
+            printf("%s wmemchr(%d, %d) read past the size.\n",
+                   Name,
+                   (int)Length,
+                   (int)Index);
+
+            Failures += 1;
+            break;
+        }
+    }
+
+    return Failures;
+}
+
+VOID
+TestStringBenchmark (
+    PCL_STRING_ROUTINES Routines,
+    PSTR Name
+    )
+
+/*++
+
+Routine Description:
+
+    This routine prints the throughput of one set of string routines at
+    several string lengths.
+
+Arguments:
+
+    Routines - Supplies the routines to measure.
+
+    Name - Supplies the name of the implementation.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    clock_t End;
+    size_t Iteration;
+    size_t Iterations;
+    size_t Length;
+    ULONG LengthIndex;
+    PSTR Left;
+    PSTR Right;
+    double Seconds;
+    clock_t Start;
+    size_t Total;
+
+    printf("%s string throughput (MB/s):\n"
+           "%8s %10s %10s %10s %10s\n",
+           Name,
+           "Length",
+           "strlen",
+           "memchr",
+           "strchr",
+           "strcmp");
+
+    for (LengthIndex = 0;
+         LengthIndex < sizeof(TestStringBenchmarkLengths) /
+                       sizeof(TestStringBenchmarkLengths[0]);
+
+         LengthIndex += 1) {
+
+        Length = TestStringBenchmarkLengths[LengthIndex];
+        Iterations = TEST_STRING_BENCHMARK_BYTES / (Length + 1);
+
+        //
+        // Offset the strings so that neither is aligned and they don't share
+        // an alignment.
+        //
+
+        Left = (PSTR)TestStringBenchmarkBuffer + 1;
+        Right = Left + Length + 8;
+        memset(Left, 'a', Length);
+        Left[Length] = '\0';
+        memset(Right, 'a', Length);
+        Right[Length] = '\0';
+        printf("%8d", (int)Length);
+
+        Total = 0;
+        Start = clock();
+        for (Iteration = 0; Iteration < Iterations; Iteration += 1) {
+            Total += Routines->StringLength(Left);
+        }
+
+        End = clock();
+        Seconds = (double)(End - Start) / CLOCKS_PER_SEC;
+        printf(" %10.0f", (double)Total / (Seconds + 1e-9) / 1048576.0);
+        Total = 0;
+        Start = clock();
+        for (Iteration = 0; Iteration < Iterations; Iteration += 1) {
+            Total += (PSTR)Routines->FindByte(Left, '\0', Length + 1) - Left;
+        }
+
+        End = clock();
+        Seconds = (double)(End - Start) / CLOCKS_PER_SEC;
+        printf(" %10.0f", (double)Total / (Seconds + 1e-9) / 1048576.0);
+        Total = 0;
+        Start = clock();
+        for (Iteration = 0; Iteration < Iterations; Iteration += 1) {
+            if (Routines->FindCharacter(Left, 'z') == NULL) {
+                Total += Length;
+            }
+        }
+
+        End = clock();
+        Seconds = (double)(End - Start) / CLOCKS_PER_SEC;
+        printf(" %10.0f", (double)Total / (Seconds + 1e-9) / 1048576.0);
+        Total = 0;
+        Start = clock();
+        for (Iteration = 0; Iteration < Iterations; Iteration += 1) {
+            if (Routines->CompareStrings(Left, Right) == 0) {
+                Total += Length;
+            }
+        }
+
+        End = clock();
+        Seconds = (double)(End - Start) / CLOCKS_PER_SEC;
+        printf(" %10.0f\n", (double)Total / (Seconds + 1e-9) / 1048576.0);
+    }
+
+    return;
+}
+
+PUCHAR
+TestStringReferenceFind (
+    PUCHAR Buffer,
+    UCHAR Character,
+    size_t Size
+    )
+
+/*++
+
+Routine Description:
+
+    This routine is a simple reference implementation of memchr.
+
+Arguments:
+
+    Buffer - Supplies a pointer to the buffer to search.
+
+    Character - Supplies the character to find.
+
+    Size - Supplies the number of bytes to search.
+
+Return Value:
+
+    Returns a pointer to the first occurrence of the character, or NULL.
+
+--*/
+
+{
+
+    size_t Index;
+
+    for (Index = 0; Index < Size; Index += 1) {
+        if (Buffer[Index] == Character) {
+            return Buffer + Index;
+        }
+    }
+
+    return NULL;
+}
+
+PUCHAR
+TestStringAlignBuffer (
+    PUCHAR Buffer
+    )
+
+/*++
+
+Routine Description:
+
+    This routine returns the first page aligned address within the given
+    buffer.
+
+Arguments:
+
+    Buffer - Supplies a pointer to the buffer.
+
+Return Value:
+
+    Returns the page aligned pointer.
+
+--*/
+
+{
+
+    UINTN Address;
+
+    Address = (UINTN)Buffer;
+    Address = (Address + TEST_STRING_PAGE_SIZE - 1) &
+              ~(UINTN)(TEST_STRING_PAGE_SIZE - 1);
+
+    return (PUCHAR)Address;
+}
+
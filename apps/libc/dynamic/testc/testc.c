@@ -124,6 +124,12 @@ Return Value:
         TotalFailures += Failures;
     }
 
+    Failures = TestStrings();
+    if (Failures != 0) {
+        printf("%d string failures.\n", Failures);
+        TotalFailures += Failures;
+    }
+
     if (TotalFailures != 0) {
         printf("*** %d C library test failures ***\n", TotalFailures);
 
@@ -170,3 +170,25 @@ Return Value:
 
 --*/
 
+ULONG
+TestStrings (
+    VOID
+    );
+
+/*++
+
+Routine Description:
+
+    This routine tests the word and vector string routine implementations and
+    prints their throughput.
+
+Arguments:
+
+    None.
+
+Return Value:
+
+    Returns the count of test failures.
+
+--*/
+
@@ -92,16 +92,7 @@ Return Value:
 
 {
 
-    while (Size != 0) {
-        if (*Buffer == Character) {
-            return (wchar_t *)Buffer;
-        }
-
-        Buffer += 1;
-        Size -= 1;
-    }
-
-    return NULL;
+    return ClStringRoutines.FindWide(Buffer, Character, Size);
 }
 
 LIBC_API
@@ -411,7 +402,7 @@ Return Value:
 
 {
 
-    return RtlStringLengthWide((PWSTR)String);
+    return ClStringRoutines.StringLengthWide(String);
 }
 
 LIBC_API
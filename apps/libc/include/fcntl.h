@@ -332,6 +332,79 @@ extern "C" {
 
 #define AT_REMOVEDIR 0x00000008
 
+//
+// Define the access pattern hints for posix_fadvise.
+//
+
+//
+// This hint indicates there is no particular access pattern.
+//
+
+#define POSIX_FADV_NORMAL 0
+
+//
+// This hint indicates the data will be accessed in random order, so reading
+// ahead is not worthwhile.
+//
+
+#define POSIX_FADV_RANDOM 1
+
+//
+// This hint indicates the data will be accessed sequentially, so read ahead
+// aggressively.
+//
+
+#define POSIX_FADV_SEQUENTIAL 2
+
+//
+// This hint indicates the data will be needed soon, and should be read into
+// the cache in the background.
+//
+
+#define POSIX_FADV_WILLNEED 3
+
+//
+// This hint indicates the data will not be needed again soon, and its cached
+// pages can be reclaimed first.
+//
+
+#define POSIX_FADV_DONTNEED 4
+
+//
+// This hint indicates the data will only be accessed once. It has no effect.
+//
+
+#define POSIX_FADV_NOREUSE 5
+
+//
+// Define the flags for the splice function.
+//
+
+//
+// This flag is a hint to move pages rather than copy them. It has no effect.
+//
+
+#define SPLICE_F_MOVE 0x00000001
+
+//
+// This flag indicates the splice should not block waiting for the input to
+// produce data.
+//
+
+#define SPLICE_F_NONBLOCK 0x00000002
+
+//
+// This flag is a hint that more data will be spliced soon. It has no effect.
+//
+
+#define SPLICE_F_MORE 0x00000004
+
+//
+// This flag is only meaningful for vmsplice. It has no effect.
+//
+
+#define SPLICE_F_GIFT 0x00000008
+
 //
 // ------------------------------------------------------ Data Type Definitions
 //
@@ -478,6 +551,89 @@ Return Value:
 
 --*/
 
+LIBC_API
+int
+posix_fadvise (
+    int FileDescriptor,
+    off_t Offset,
+    off_t Length,
+    int Advice
+    );
+
+/*++
+
+Routine Description:
+
+    This routine passes a hint about the expected access pattern of a region
+    of a file, which the system may use to tune how the file is cached.
+
+Arguments:
+
+    FileDescriptor - Supplies the file descriptor to advise on.
+
+    Offset - Supplies the offset of the start of the region.
+
+    Length - Supplies the length of the region in bytes. Supply 0 to cover
+        everything from the offset to the end of the file.
+
+    Advice - Supplies the hint. See POSIX_FADV_* definitions.
+
+Return Value:
+
+    0 on success.
+
+    Returns an error number on failure. The errno variable is not set.
+
+--*/
+
+LIBC_API
+ssize_t
+splice (
+    int InputDescriptor,
+    off_t *InputOffset,
+    int OutputDescriptor,
+    off_t *OutputOffset,
+    size_t ByteCount,
+    unsigned int Flags
+    );
+
+/*++
+
+Routine Description:
+
+    This routine moves data from one file descriptor to another without
+    passing it through user mode. Data read from a regular file is taken
+    straight from the file's cached pages. Unlike some systems, neither
+    descriptor needs to be a pipe.
+
+Arguments:
+
+    InputDescriptor - Supplies the file descriptor to read from.
+
+    InputOffset - Supplies an optional pointer to the offset in the input to
+        read from. On return, this is advanced by the number of bytes moved,
+        and the input's file position is not changed. If this is NULL, the
+        input's file position is used and advanced.
+
+    OutputDescriptor - Supplies the file descriptor to write to.
+
+    OutputOffset - Supplies an optional pointer to the offset in the output to
+        write to. On return, this is advanced by the number of bytes moved,
+        and the output's file position is not changed. If this is NULL, the
+        output's file position is used and advanced.
+
+    ByteCount - Supplies the number of bytes to move.
+
+    Flags - Supplies a bitfield of flags. See SPLICE_F_* definitions.
+
+Return Value:
+
+    Returns the number of bytes moved. Zero indicates the end of the input.
+
+    -1 on failure, and errno will contain more information.
+
+--*/
+
 #ifdef __cplusplus
 
 }
@@ -46,6 +46,7 @@ extern "C" {
 
 #define IFT_ETHER 1
 #define IFT_IEEE80211 2
+#define IFT_LOOP 3
 
 //
 // ------------------------------------------------------ Data Type Definitions
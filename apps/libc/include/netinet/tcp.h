@@ -66,6 +66,28 @@ Module Name:
 
 #define TCP_KEEPCNT 4
 
+//
+// Set this option to select the congestion control algorithm used by the
+// socket. This option takes an integer, one of the TCP_CONGESTION_*
+// definitions.
+//
+
+#define TCP_CONGESTION 5
+
+//
+// Set this option to spread outgoing data out over the round trip time rather
+// than sending it in bursts. This option takes an integer.
+//
+
+#define TCP_PACING 6
+
+//
+// Define the congestion control algorithms.
+//
+
+#define TCP_CONGESTION_NEW_RENO 0
+#define TCP_CONGESTION_CUBIC 1
+
 //
 // ------------------------------------------------------ Data Type Definitions
 //
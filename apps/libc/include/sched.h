@@ -30,6 +30,57 @@ Module Name:
 #include <sys/types.h>
 #include <time.h>
 
+//
+// --------------------------------------------------------------------- Macros
+//
+
+//
+// This macro is used to get the word index of a processor within a set.
+//
+
+#define _CPU_INDEX(_Cpu) ((_Cpu) / _NCPUBITS)
+
+//
+// This macro is used to get the mask of a processor within a word.
+//
+
+#define _CPU_MASK(_Cpu) (1UL << ((_Cpu) % _NCPUBITS))
+
+//
+// This macro removes the given processor from the set.
+//
+
+#define CPU_CLR(_Cpu, _Set) \
+    ((_Set)->__bits[_CPU_INDEX(_Cpu)] &= ~_CPU_MASK(_Cpu))
+
+//
+// This macro returns a non-zero value if the given processor is in the set.
+//
+
+#define CPU_ISSET(_Cpu, _Set) \
+    (((_Set)->__bits[_CPU_INDEX(_Cpu)] & _CPU_MASK(_Cpu)) != 0)
+
+//
+// This macro adds the given processor to the set.
+//
+
+#define CPU_SET(_Cpu, _Set) \
+    ((_Set)->__bits[_CPU_INDEX(_Cpu)] |= _CPU_MASK(_Cpu))
+
+//
+// This macro initializes the processor set to be empty.
+//
+
+#define CPU_ZERO(_Set)                                                    \
+    do {                                                                  \
+        unsigned int _Index;                                              \
+                                                                          \
+        for (_Index = 0; _Index < CPU_SETSIZE / _NCPUBITS; _Index += 1) { \
+            (_Set)->__bits[_Index] = 0;                                   \
+        }                                                                 \
+                                                                          \
+    } while (0)
+
 //
 // ---------------------------------------------------------------- Definitions
 //
@@ -40,6 +91,43 @@ extern "C" {
 
 #endif
 
+//
+// Define the scheduling policies.
+//
+
+//
+// Time-shared threads have no static priority, and are instead weighted by
+// their nice value.
+//
+
+#define SCHED_OTHER 0
+
+//
+// First-in-first-out threads run until they block, yield, or are preempted by
+// a higher priority real-time thread.
+//
+
+#define SCHED_FIFO 1
+
+//
+// Round robin threads behave like FIFO threads, except they rotate with other
+// threads of the same priority when their time slice expires.
+//
+
+#define SCHED_RR 2
+
+//
+// Define the number of processors that can be described in a processor set.
+//
+
+#define CPU_SETSIZE 128
+
+//
+// Define the number of processors described by each word of a processor set.
+//
+
+#define _NCPUBITS (8 * sizeof(unsigned long))
+
 //
 // ------------------------------------------------------ Data Type Definitions
 //
@@ -52,15 +140,34 @@ Structure Description:
 
 Members:
 
-    __sched_priority - Stores the internal scheduling priority, whose meaning
-        depends on the scheduler in use.
+    sched_priority - Stores the static scheduling priority. This must be zero
+        for SCHED_OTHER, and between the minimum and maximum priority values
+        for the real-time policies. Higher values are more favorable.
 
 --*/
 
 struct sched_param {
-    int __sched_priority;
+    int sched_priority;
 };
 
+/*++
+
+Structure Description:
+
+    This structure stores a set of processors, used to describe which
+    processors a thread is allowed to run on. Use the CPU_* macros to
+    manipulate the set.
+
+Members:
+
+    __bits - Stores the bitmap of processors in the set.
+
+--*/
+
+typedef struct {
+    unsigned long __bits[CPU_SETSIZE / (8 * sizeof(unsigned long))];
+} cpu_set_t;
+
 //
 // -------------------------------------------------------------------- Globals
 //
@@ -93,6 +200,237 @@ Return Value:
 
 --*/
 
+LIBC_API
+int
+sched_get_priority_max (
+    int Policy
+    );
+
+/*++
+
+Routine Description:
+
+    This routine returns the maximum priority value for the given scheduling
+    policy.
+
+Arguments:
+
+    Policy - Supplies the scheduling policy. See SCHED_* definitions.
+
+Return Value:
+
+    Returns the maximum priority value on success.
+
+    -1 on error, and the errno variable will contain more information.
+
+--*/
+
+LIBC_API
+int
+sched_get_priority_min (
+    int Policy
+    );
+
+/*++
+
+Routine Description:
+
+    This routine returns the minimum priority value for the given scheduling
+    policy.
+
+Arguments:
+
+    Policy - Supplies the scheduling policy. See SCHED_* definitions.
+
+Return Value:
+
+    Returns the minimum priority value on success.
+
+    -1 on error, and the errno variable will contain more information.
+
+--*/
+
+LIBC_API
+int
+sched_getscheduler (
+    pid_t ProcessId
+    );
+
+/*++
+
+Routine Description:
+
+    This routine returns the scheduling policy of the given process.
+
+Arguments:
+
+    ProcessId - Supplies the ID of the process to query. Supply zero to use
+        the calling process.
+
+Return Value:
+
+    Returns the scheduling policy on success. See SCHED_* definitions.
+
+    -1 on error, and the errno variable will contain more information.
+
+--*/
+
+LIBC_API
+int
+sched_setscheduler (
+    pid_t ProcessId,
+    int Policy,
+    const struct sched_param *Parameter
+    );
+
+/*++
+
+Routine Description:
+
+    This routine sets the scheduling policy and priority of the given process.
+    The process' nice value is preserved.
+
+Arguments:
+
+    ProcessId - Supplies the ID of the process to set. Supply zero to use the
+        calling process.
+
+    Policy - Supplies the new scheduling policy. See SCHED_* definitions.
+
+    Parameter - Supplies a pointer to the new scheduling priority.
+
+Return Value:
+
+    Returns the previous scheduling policy on success.
+
+    -1 on error, and the errno variable will contain more information.
+
+--*/
+
+LIBC_API
+int
+sched_getparam (
+    pid_t ProcessId,
+    struct sched_param *Parameter
+    );
+
+/*++
+
+Routine Description:
+
+    This routine returns the scheduling priority of the given process.
+
+Arguments:
+
+    ProcessId - Supplies the ID of the process to query. Supply zero to use
+        the calling process.
+
+    Parameter - Supplies a pointer where the scheduling priority will be
+        returned.
+
+Return Value:
+
+    0 on success.
+
+    -1 on error, and the errno variable will contain more information.
+
+--*/
+
+LIBC_API
+int
+sched_setparam (
+    pid_t ProcessId,
+    const struct sched_param *Parameter
+    );
+
+/*++
+
+Routine Description:
+
+    This routine sets the scheduling priority of the given process without
+    changing its scheduling policy.
+
+Arguments:
+
+    ProcessId - Supplies the ID of the process to set. Supply zero to use the
+        calling process.
+
+    Parameter - Supplies a pointer to the new scheduling priority.
+
+Return Value:
+
+    0 on success.
+
+    -1 on error, and the errno variable will contain more information.
+
+--*/
+
+LIBC_API
+int
+sched_getaffinity (
+    pid_t ProcessId,
+    size_t SetSize,
+    cpu_set_t *Set
+    );
+
+/*++
+
+Routine Description:
+
+    This routine gets the set of processors the given process is allowed to
+    run on.
+
+Arguments:
+
+    ProcessId - Supplies the ID of the process to query. Supply zero to use
+        the calling process. The affinity of the calling thread is returned
+        for the calling process.
+
+    SetSize - Supplies the size of the processor set buffer, in bytes.
+
+    Set - Supplies a pointer where the processor set will be returned.
+
+Return Value:
+
+    0 on success.
+
+    -1 on error, and the errno variable will contain more information.
+
+--*/
+
+LIBC_API
+int
+sched_setaffinity (
+    pid_t ProcessId,
+    size_t SetSize,
+    const cpu_set_t *Set
+    );
+
+/*++
+
+Routine Description:
+
+    This routine sets the set of processors every thread in the given process
+    is allowed to run on. Threads created afterwards inherit the set of the
+    thread that creates them.
+
+Arguments:
+
+    ProcessId - Supplies the ID of the process to set. Supply zero to use the
+        calling process.
+
+    SetSize - Supplies the size of the processor set buffer, in bytes.
+
+    Set - Supplies a pointer to the new processor set.
+
+Return Value:
+
+    0 on success.
+
+    -1 on error, and the errno variable will contain more information.
+
+--*/
+
 #ifdef __cplusplus
 
 }
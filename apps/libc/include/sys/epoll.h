@@ -0,0 +1,342 @@
+/*++
+
+Copyright (c) 2026 Minoca Corp.
+
+    This file is licensed under the terms of the GNU Lesser General Public
+    License version 3. Alternative licensing terms are available. Contact
+    info@minocacorp.com for details.
+
+Module Name:
+
+    epoll.h
+
+Abstract:
+
+    This header contains definitions for event polling, which waits on a
+    persistent set of file descriptors in time proportional to the number
+    that are ready.
+
+Author:
+
+    Minoca Corp. 18-Oct-2026
+
+--*/
+
+#ifndef _SYS_EPOLL_H
+#define _SYS_EPOLL_H
+
+//
+// ------------------------------------------------------------------- Includes
+//
+
+#include <libcbase.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdint.h>
+
+//
+// ---------------------------------------------------------------- Definitions
+//
+
+#ifdef __cplusplus
+
+extern "C" {
+
+#endif
+
+//
+// Define the flags for epoll_create1. This shares its value with O_CLOEXEC.
+//
+
+#define EPOLL_CLOEXEC 0x00004000
+
+//
+// Define the operations for epoll_ctl.
+//
+
+//
+// This operation registers a new file descriptor.
+//
+
+#define EPOLL_CTL_ADD 1
+
+//
+// This operation removes a registered descriptor.
+//
+
+#define EPOLL_CTL_DEL 2
+
+//
+// This operation changes the events and data of a registered descriptor.
+//
+
+#define EPOLL_CTL_MOD 3
+
+//
+// Define the events that can be watched or returned. These share their values
+// with the poll events.
+//
+
+#define EPOLLIN POLLIN
+#define EPOLLRDNORM POLLRDNORM
+#define EPOLLPRI POLLPRI
+#define EPOLLRDBAND POLLRDBAND
+#define EPOLLOUT POLLOUT
+#define EPOLLWRNORM POLLWRNORM
+#define EPOLLWRBAND POLLWRBAND
+
+//
+// These events are always reported, and are ignored if set in the events to
+// watch.
+//
+
+#define EPOLLERR POLLERR
+#define EPOLLHUP POLLHUP
+
+//
+// Set this flag to report a descriptor only when new events arrive, rather
+// than for as long as events are set.
+//
+
+#define EPOLLET (1U << 31)
+
+//
+// Set this flag to report a descriptor once and then disable it until it is
+// re-armed with EPOLL_CTL_MOD.
+//
+
+#define EPOLLONESHOT (1U << 30)
+
+//
+// ------------------------------------------------------ Data Type Definitions
+//
+
+/*++
+
+Union Description:
+
+    This union defines the user data returned with an event.
+
+Members:
+
+    ptr - Stores a pointer.
+
+    fd - Stores a file descriptor.
+
+    u32 - Stores a 32-bit value.
+
+    u64 - Stores a 64-bit value.
+
+--*/
+
+typedef union epoll_data {
+    void *ptr;
+    int fd;
+    uint32_t u32;
+    uint64_t u64;
+} epoll_data_t;
+
+/*++
+
+Structure Description:
+
+    This structure defines an event to watch or an event that occurred.
+
+Members:
+
+    events - Stores the mask of EPOLL* events, plus EPOLLET and EPOLLONESHOT
+        when registering.
+
+    data - Stores the user data registered with the descriptor, which is
+        returned untouched with each event.
+
+--*/
+
+struct epoll_event {
+    uint32_t events;
+    epoll_data_t data;
+};
+
+//
+// -------------------------------------------------------------------- Globals
+//
+
+//
+// -------------------------------------------------------- Function Prototypes
+//
+
+LIBC_API
+int
+epoll_create (
+    int Size
+    );
+
+/*++
+
+Routine Description:
+
+    This routine creates a new event polling descriptor.
+
+Arguments:
+
+    Size - Supplies a hint of the number of descriptors to be watched. This is
+        ignored, but must be greater than zero.
+
+Return Value:
+
+    Returns the new descriptor on success.
+
+    -1 on failure, and errno will be set to contain more information.
+
+--*/
+
+LIBC_API
+int
+epoll_create1 (
+    int Flags
+    );
+
+/*++
+
+Routine Description:
+
+    This routine creates a new event polling descriptor.
+
+Arguments:
+
+    Flags - Supplies a bitfield of flags. Only EPOLL_CLOEXEC is permitted.
+
+Return Value:
+
+    Returns the new descriptor on success.
+
+    -1 on failure, and errno will be set to contain more information.
+
+--*/
+
+LIBC_API
+int
+epoll_ctl (
+    int PollDescriptor,
+    int Operation,
+    int FileDescriptor,
+    struct epoll_event *Event
+    );
+
+/*++
+
+Routine Description:
+
+    This routine adds, changes, or removes a file descriptor's registration
+    with an event polling descriptor.
+
+Arguments:
+
+    PollDescriptor - Supplies the event polling descriptor.
+
+    Operation - Supplies the operation to perform. See EPOLL_CTL_*
+        definitions.
+
+    FileDescriptor - Supplies the descriptor to register, change, or remove.
+
+    Event - Supplies a pointer to the events to watch and the data to return.
+        This is ignored for EPOLL_CTL_DEL.
+
+Return Value:
+
+    0 on success.
+
+    -1 on failure, and errno will be set to contain more information.
+
+--*/
+
+LIBC_API
+int
+epoll_wait (
+    int PollDescriptor,
+    struct epoll_event *Events,
+    int MaxEvents,
+    int Timeout
+    );
+
+/*++
+
+Routine Description:
+
+    This routine waits for registered file descriptors to become ready.
+
+Arguments:
+
+    PollDescriptor - Supplies the event polling descriptor.
+
+    Events - Supplies a pointer to an array where the ready events will be
+        returned.
+
+    MaxEvents - Supplies the number of elements in the events array. This
+        must be greater than zero.
+
+    Timeout - Supplies the amount of time in milliseconds to block before
+        giving up and returning anyway. Supply 0 to not block at all, and
+        supply -1 to wait for an indefinite amount of time.
+
+Return Value:
+
+    Returns the number of events returned on success.
+
+    Returns 0 to indicate a timeout.
+
+    -1 on failure, and errno will be set to contain more information.
+
+--*/
+
+LIBC_API
+int
+epoll_pwait (
+    int PollDescriptor,
+    struct epoll_event *Events,
+    int MaxEvents,
+    int Timeout,
+    const sigset_t *SignalMask
+    );
+
+/*++
+
+Routine Description:
+
+    This routine waits for registered file descriptors to become ready,
+    atomically setting the signal mask for the duration of the wait.
+
+Arguments:
+
+    PollDescriptor - Supplies the event polling descriptor.
+
+    Events - Supplies a pointer to an array where the ready events will be
+        returned.
+
+    MaxEvents - Supplies the number of elements in the events array. This
+        must be greater than zero.
+
+    Timeout - Supplies the amount of time in milliseconds to block before
+        giving up and returning anyway. Supply 0 to not block at all, and
+        supply -1 to wait for an indefinite amount of time.
+
+    SignalMask - Supplies an optional pointer to a signal mask to set
+        atomically for the duration of the wait.
+
+Return Value:
+
+    Returns the number of events returned on success.
+
+    Returns 0 to indicate a timeout.
+
+    -1 on failure, and errno will be set to contain more information.
+
+--*/
+
+#ifdef __cplusplus
+
+}
+
+#endif
+#endif
+
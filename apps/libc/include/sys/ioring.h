@@ -0,0 +1,804 @@
+/*++
+
+Copyright (c) 2026 Minoca Corp.
+
+    This file is licensed under the terms of the GNU Lesser General Public
+    License version 3. Alternative licensing terms are available. Contact
+    info@minocacorp.com for details.
+
+Module Name:
+
+    ioring.h
+
+Abstract:
+
+    This header contains definitions for I/O rings, which batch file and
+    socket requests through a submission and completion ring shared with the
+    kernel.
+
+Author:
+
+    Minoca Corp. 18-Oct-2026
+
+--*/
+
+#ifndef _SYS_IORING_H
+#define _SYS_IORING_H
+
+//
+// ------------------------------------------------------------------- Includes
+//
+
+#include <libcbase.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+//
+// ---------------------------------------------------------------- Definitions
+//
+
+#ifdef __cplusplus
+
+extern "C" {
+
+#endif
+
+//
+// Define the flags for ioring_init. This shares its value with O_CLOEXEC,
+// though the descriptor is always closed on exec.
+//
+
+#define IORING_CLOEXEC 0x00004000
+
+//
+// Define the maximum number of submission entries in a ring.
+//
+
+#define IORING_MAX_ENTRIES 4096
+
+//
+// Define the request operation codes.
+//
+
+#define IORING_OP_NOP 0
+#define IORING_OP_READ 1
+#define IORING_OP_WRITE 2
+#define IORING_OP_FSYNC 3
+#define IORING_OP_ACCEPT 4
+#define IORING_OP_CONNECT 5
+#define IORING_OP_SEND 6
+#define IORING_OP_RECV 7
+
+//
+// Set this submission flag to interpret the descriptor as an index into the
+// descriptors registered with ioring_register_files.
+//
+
+#define IORING_SQE_FIXED_FILE 0x0001
+
+//
+// Set this submission flag to use the buffer registered with
+// ioring_register_buffers at the submission's buffer index. The submission's
+// buffer must lie entirely within it.
+//
+
+#define IORING_SQE_FIXED_BUFFER 0x0002
+
+//
+// ------------------------------------------------------ Data Type Definitions
+//
+
+/*++
+
+Structure Description:
+
+    This structure defines a submission queue entry.
+
+Members:
+
+    user_data - Stores an opaque value returned untouched with the completion.
+
+    offset - Stores the file offset for reads and writes, or -1 to use and
+        advance the descriptor's current offset.
+
+    buffer - Stores a pointer to the data buffer.
+
+    size - Stores the size of the buffer in bytes.
+
+    descriptor - Stores the file descriptor, or the registered descriptor
+        index if IORING_SQE_FIXED_FILE is set.
+
+    opcode - Stores the IORING_OP_* operation.
+
+    flags - Stores the IORING_SQE_* flags.
+
+    buffer_index - Stores the registered buffer index if
+        IORING_SQE_FIXED_BUFFER is set.
+
+    op_flags - Stores operation specific flags, as converted by the prep
+        routines.
+
+    reserved - Stores a reserved value, which must be zero.
+
+--*/
+
+struct ioring_sqe {
+    uint64_t user_data;
+    int64_t offset;
+    void *buffer;
+    size_t size;
+    intptr_t descriptor;
+    uint16_t opcode;
+    uint16_t flags;
+    uint32_t buffer_index;
+    uint32_t op_flags;
+    uint32_t reserved;
+};
+
+/*++
+
+Structure Description:
+
+    This structure defines a completion queue entry.
+
+Members:
+
+    user_data - Stores the opaque value from the submission.
+
+    result - Stores the result of the request. This is the number of bytes
+        transferred, or the new descriptor for accept requests. On failure
+        this is a negative error number.
+
+--*/
+
+struct ioring_cqe {
+    uint64_t user_data;
+    int64_t result;
+};
+
+/*++
+
+Structure Description:
+
+    This structure defines an I/O ring. Its members are private to the C
+    library.
+
+Members:
+
+    descriptor - Stores the ring's file descriptor.
+
+    memory - Stores a pointer to the memory shared with the kernel.
+
+    size - Stores the size of the shared memory in bytes.
+
+    sq_entries - Stores the number of submission entries.
+
+    cq_entries - Stores the number of completion entries.
+
+    sq_tail - Stores the index one beyond the last submission handed out.
+
+    cq_checked - Stores the index one beyond the last completion whose
+        result has been converted to an error number.
+
+    sqes - Stores a pointer to the submission array.
+
+    cqes - Stores a pointer to the completion array.
+
+    addresses - Stores a pointer to per-submission storage for connect
+        addresses.
+
+--*/
+
+struct ioring {
+    int descriptor;
+    void *memory;
+    size_t size;
+    unsigned int sq_entries;
+    unsigned int cq_entries;
+    unsigned int sq_tail;
+    unsigned int cq_checked;
+    struct ioring_sqe *sqes;
+    struct ioring_cqe *cqes;
+    void *addresses;
+};
+
+//
+// -------------------------------------------------------------------- Globals
+//
+
+//
+// -------------------------------------------------------- Function Prototypes
+//
+
+LIBC_API
+int
+ioring_init (
+    unsigned int Entries,
+    struct ioring *Ring,
+    int Flags
+    );
+
+/*++
+
+Routine Description:
+
+    This routine creates a new I/O ring.
+
+Arguments:
+
+    Entries - Supplies the number of submission entries. This is rounded up
+        to a power of two. The completion ring gets twice as many entries.
+
+    Ring - Supplies a pointer where the ring will be initialized.
+
+    Flags - Supplies a bitfield of flags. Only IORING_CLOEXEC is permitted.
+
+Return Value:
+
+    0 on success.
+
+    -1 on failure, and errno will be set to contain more information.
+
+--*/
+
+LIBC_API
+void
+ioring_destroy (
+    struct ioring *Ring
+    );
+
+/*++
+
+Routine Description:
+
+    This routine closes an I/O ring and frees its memory. Requests still in
+    flight are abandoned.
+
+Arguments:
+
+    Ring - Supplies a pointer to the ring.
+
+Return Value:
+
+    None.
+
+--*/
+
+LIBC_API
+struct ioring_sqe *
+ioring_get_sqe (
+    struct ioring *Ring
+    );
+
+/*++
+
+Routine Description:
+
+    This routine returns the next free submission entry. The entry is zeroed.
+    It is handed to the kernel by the next call to submit.
+
+Arguments:
+
+    Ring - Supplies a pointer to the ring.
+
+Return Value:
+
+    Returns a pointer to the submission entry.
+
+    NULL if the submission ring is full.
+
+--*/
+
+LIBC_API
+int
+ioring_submit (
+    struct ioring *Ring
+    );
+
+/*++
+
+Routine Description:
+
+    This routine hands all prepared submissions to the kernel.
+
+Arguments:
+
+    Ring - Supplies a pointer to the ring.
+
+Return Value:
+
+    Returns the number of submissions the kernel consumed.
+
+    -1 on failure, and errno will be set to contain more information.
+
+--*/
+
+LIBC_API
+int
+ioring_submit_and_wait (
+    struct ioring *Ring,
+    unsigned int WaitCount
+    );
+
+/*++
+
+Routine Description:
+
+    This routine hands all prepared submissions to the kernel and waits until
+    at least the given number of completions are ready.
+
+Arguments:
+
+    Ring - Supplies a pointer to the ring.
+
+    WaitCount - Supplies the number of completions to wait for.
+
+Return Value:
+
+    Returns the number of submissions the kernel consumed.
+
+    -1 on failure, and errno will be set to contain more information.
+
+--*/
+
+LIBC_API
+int
+ioring_peek_cqe (
+    struct ioring *Ring,
+    struct ioring_cqe **Completion
+    );
+
+/*++
+
+Routine Description:
+
+    This routine returns the next completion without waiting.
+
+Arguments:
+
+    Ring - Supplies a pointer to the ring.
+
+    Completion - Supplies a pointer where a pointer to the completion entry
+        will be returned. Mark it consumed with ioring_cqe_seen.
+
+Return Value:
+
+    0 on success.
+
+    -1 on failure, and errno will be set to contain more information. The
+    error is EAGAIN if no completion is ready.
+
+--*/
+
+LIBC_API
+int
+ioring_wait_cqe (
+    struct ioring *Ring,
+    struct ioring_cqe **Completion
+    );
+
+/*++
+
+Routine Description:
+
+    This routine returns the next completion, waiting for one if necessary.
+
+Arguments:
+
+    Ring - Supplies a pointer to the ring.
+
+    Completion - Supplies a pointer where a pointer to the completion entry
+        will be returned. Mark it consumed with ioring_cqe_seen.
+
+Return Value:
+
+    0 on success.
+
+    -1 on failure, and errno will be set to contain more information.
+
+--*/
+
+LIBC_API
+void
+ioring_cqe_seen (
+    struct ioring *Ring,
+    struct ioring_cqe *Completion
+    );
+
+/*++
+
+Routine Description:
+
+    This routine marks the oldest completion as consumed, returning its slot
+    to the kernel.
+
+Arguments:
+
+    Ring - Supplies a pointer to the ring.
+
+    Completion - Supplies a pointer to the completion returned by peek or
+        wait.
+
+Return Value:
+
+    None.
+
+--*/
+
+LIBC_API
+int
+ioring_register_files (
+    struct ioring *Ring,
+    const int *Descriptors,
+    unsigned int Count
+    );
+
+/*++
+
+Routine Description:
+
+    This routine registers a set of file descriptors with the ring, so that
+    submissions can name them by index and skip the descriptor lookup.
+
+Arguments:
+
+    Ring - Supplies a pointer to the ring.
+
+    Descriptors - Supplies a pointer to the array of descriptors. Supply -1
+        to leave a slot empty.
+
+    Count - Supplies the number of descriptors.
+
+Return Value:
+
+    0 on success.
+
+    -1 on failure, and errno will be set to contain more information.
+
+--*/
+
+LIBC_API
+int
+ioring_unregister_files (
+    struct ioring *Ring
+    );
+
+/*++
+
+Routine Description:
+
+    This routine drops the file descriptors registered with the ring.
+
+Arguments:
+
+    Ring - Supplies a pointer to the ring.
+
+Return Value:
+
+    0 on success.
+
+    -1 on failure, and errno will be set to contain more information.
+
+--*/
+
+LIBC_API
+int
+ioring_register_buffers (
+    struct ioring *Ring,
+    const struct iovec *Buffers,
+    unsigned int Count
+    );
+
+/*++
+
+Routine Description:
+
+    This routine registers a set of buffers with the ring, so that they are
+    validated once rather than on every request.
+
+Arguments:
+
+    Ring - Supplies a pointer to the ring.
+
+    Buffers - Supplies a pointer to the array of buffers.
+
+    Count - Supplies the number of buffers.
+
+Return Value:
+
+    0 on success.
+
+    -1 on failure, and errno will be set to contain more information.
+
+--*/
+
+LIBC_API
+int
+ioring_unregister_buffers (
+    struct ioring *Ring
+    );
+
+/*++
+
+Routine Description:
+
+    This routine drops the buffers registered with the ring.
+
+Arguments:
+
+    Ring - Supplies a pointer to the ring.
+
+Return Value:
+
+    0 on success.
+
+    -1 on failure, and errno will be set to contain more information.
+
+--*/
+
+LIBC_API
+void
+ioring_prep_nop (
+    struct ioring_sqe *Submission
+    );
+
+/*++
+
+Routine Description:
+
+    This routine prepares a request that does nothing.
+
+Arguments:
+
+    Submission - Supplies a pointer to the submission entry.
+
+Return Value:
+
+    None.
+
+--*/
+
+LIBC_API
+void
+ioring_prep_read (
+    struct ioring_sqe *Submission,
+    int FileDescriptor,
+    void *Buffer,
+    size_t Size,
+    off_t Offset
+    );
+
+/*++
+
+Routine Description:
+
+    This routine prepares a read request.
+
+Arguments:
+
+    Submission - Supplies a pointer to the submission entry.
+
+    FileDescriptor - Supplies the descriptor to read from.
+
+    Buffer - Supplies a pointer where the data will be returned.
+
+    Size - Supplies the number of bytes to read.
+
+    Offset - Supplies the file offset to read from, or -1 to use and advance
+        the current file position.
+
+Return Value:
+
+    None.
+
+--*/
+
+LIBC_API
+void
+ioring_prep_write (
+    struct ioring_sqe *Submission,
+    int FileDescriptor,
+    const void *Buffer,
+    size_t Size,
+    off_t Offset
+    );
+
+/*++
+
+Routine Description:
+
+    This routine prepares a write request.
+
+Arguments:
+
+    Submission - Supplies a pointer to the submission entry.
+
+    FileDescriptor - Supplies the descriptor to write to.
+
+    Buffer - Supplies a pointer to the data to write.
+
+    Size - Supplies the number of bytes to write.
+
+    Offset - Supplies the file offset to write to, or -1 to use and advance
+        the current file position.
+
+Return Value:
+
+    None.
+
+--*/
+
+LIBC_API
+void
+ioring_prep_fsync (
+    struct ioring_sqe *Submission,
+    int FileDescriptor
+    );
+
+/*++
+
+Routine Description:
+
+    This routine prepares a request that flushes a file to its backing device.
+
+Arguments:
+
+    Submission - Supplies a pointer to the submission entry.
+
+    FileDescriptor - Supplies the descriptor to flush.
+
+Return Value:
+
+    None.
+
+--*/
+
+LIBC_API
+void
+ioring_prep_accept (
+    struct ioring_sqe *Submission,
+    int Socket,
+    int Flags
+    );
+
+/*++
+
+Routine Description:
+
+    This routine prepares a request that accepts a connection on a listening
+    socket. The completion result is the new descriptor. Use getpeername to
+    find the remote address.
+
+Arguments:
+
+    Submission - Supplies a pointer to the submission entry.
+
+    Socket - Supplies the listening socket.
+
+    Flags - Supplies SOCK_NONBLOCK and SOCK_CLOEXEC flags for the new
+        descriptor.
+
+Return Value:
+
+    None.
+
+--*/
+
+LIBC_API
+int
+ioring_prep_connect (
+    struct ioring *Ring,
+    struct ioring_sqe *Submission,
+    int Socket,
+    const struct sockaddr *Address,
+    socklen_t AddressLength
+    );
+
+/*++
+
+Routine Description:
+
+    This routine prepares a request that connects a socket to a remote
+    address. The address is converted and stored in the ring, so it need not
+    outlive this call.
+
+Arguments:
+
+    Ring - Supplies a pointer to the ring the submission came from.
+
+    Submission - Supplies a pointer to the submission entry.
+
+    Socket - Supplies the socket to connect.
+
+    Address - Supplies a pointer to the address to connect to.
+
+    AddressLength - Supplies the size of the address in bytes.
+
+Return Value:
+
+    0 on success.
+
+    -1 on failure, and errno will be set to contain more information.
+
+--*/
+
+LIBC_API
+void
+ioring_prep_send (
+    struct ioring_sqe *Submission,
+    int Socket,
+    const void *Buffer,
+    size_t Size,
+    int Flags
+    );
+
+/*++
+
+Routine Description:
+
+    This routine prepares a request that sends data on a connected socket.
+
+Arguments:
+
+    Submission - Supplies a pointer to the submission entry.
+
+    Socket - Supplies the socket to send on.
+
+    Buffer - Supplies a pointer to the data to send.
+
+    Size - Supplies the number of bytes to send.
+
+    Flags - Supplies MSG_* flags. MSG_DONTWAIT fails the request with EAGAIN
+        rather than holding it until the socket is ready.
+
+Return Value:
+
+    None.
+
+--*/
+
+LIBC_API
+void
+ioring_prep_recv (
+    struct ioring_sqe *Submission,
+    int Socket,
+    void *Buffer,
+    size_t Size,
+    int Flags
+    );
+
+/*++
+
+Routine Description:
+
+    This routine prepares a request that receives data from a connected
+    socket.
+
+Arguments:
+
+    Submission - Supplies a pointer to the submission entry.
+
+    Socket - Supplies the socket to receive from.
+
+    Buffer - Supplies a pointer where the data will be returned.
+
+    Size - Supplies the size of the buffer in bytes.
+
+    Flags - Supplies MSG_* flags. MSG_DONTWAIT fails the request with EAGAIN
+        rather than holding it until data arrives.
+
+Return Value:
+
+    None.
+
+--*/
+
+#ifdef __cplusplus
+
+}
+
+#endif
+#endif
+
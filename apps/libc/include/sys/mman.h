@@ -125,6 +125,67 @@ extern "C" {
 
 #define MS_INVALIDATE 0x0004
 
+//
+// Define the access pattern hints for madvise and posix_madvise.
+//
+
+//
+// This hint indicates there is no particular access pattern.
+//
+
+#define MADV_NORMAL 0
+
+//
+// This hint indicates the memory will be accessed in random order, so reading
+// ahead from the backing file is not worthwhile.
+//
+
+#define MADV_RANDOM 1
+
+//
+// This hint indicates the memory will be accessed sequentially, so read ahead
+// from the backing file aggressively.
+//
+
+#define MADV_SEQUENTIAL 2
+
+//
+// This hint indicates the memory will be needed soon, and its backing file
+// data should be read into the cache in the background.
+//
+
+#define MADV_WILLNEED 3
+
+//
+// This hint indicates the memory will not be needed again soon, and the
+// cached pages of its backing file can be reclaimed first. The contents of
+// the memory are not discarded.
+//
+
+#define MADV_DONTNEED 4
+
+//
+// This hint indicates the region of anonymous memory would benefit from being
+// mapped with large pages. This is the default, so this hint only undoes a
+// previous MADV_NOHUGEPAGE.
+//
+
+#define MADV_HUGEPAGE 5
+
+//
+// This hint indicates the region of anonymous memory should only be mapped
+// with normal sized pages. Any large pages already mapping the region are
+// broken up.
+//
+
+#define MADV_NOHUGEPAGE 6
+
+#define POSIX_MADV_NORMAL MADV_NORMAL
+#define POSIX_MADV_RANDOM MADV_RANDOM
+#define POSIX_MADV_SEQUENTIAL MADV_SEQUENTIAL
+#define POSIX_MADV_WILLNEED MADV_WILLNEED
+#define POSIX_MADV_DONTNEED MADV_DONTNEED
+
 //
 // Define the value used to indicate a failed mapping.
 //
@@ -282,6 +343,72 @@ Return Value:
 
 --*/
 
+LIBC_API
+int
+madvise (
+    void *Address,
+    size_t Length,
+    int Advice
+    );
+
+/*++
+
+Routine Description:
+
+    This routine passes a hint about the expected access pattern of a region
+    of the current process' memory. Hints for regions mapped from a file are
+    applied to the file's cached pages.
+
+Arguments:
+
+    Address - Supplies the start of the region. This must be aligned to a page
+        boundary.
+
+    Length - Supplies the size, in bytes, of the region.
+
+    Advice - Supplies the hint. See MADV_* definitions.
+
+Return Value:
+
+    Returns 0 on success.
+
+    -1 on failure. The errno variable will be set to indicate the error.
+
+--*/
+
+LIBC_API
+int
+posix_madvise (
+    void *Address,
+    size_t Length,
+    int Advice
+    );
+
+/*++
+
+Routine Description:
+
+    This routine passes a hint about the expected access pattern of a region
+    of the current process' memory. Hints for regions mapped from a file are
+    applied to the file's cached pages.
+
+Arguments:
+
+    Address - Supplies the start of the region. This must be aligned to a page
+        boundary.
+
+    Length - Supplies the size, in bytes, of the region.
+
+    Advice - Supplies the hint. See POSIX_MADV_* definitions.
+
+Return Value:
+
+    Returns 0 on success.
+
+    Returns an error number on failure. The errno variable is not set.
+
+--*/
+
 LIBC_API
 int
 shm_open (
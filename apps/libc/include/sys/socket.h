@@ -27,6 +27,7 @@ Module Name:
 // ------------------------------------------------------------------- Includes
 //
 
+#include <time.h>
 #include <sys/uio.h>
 #include <sys/ioctl.h>
 
@@ -240,6 +241,14 @@ extern "C" {
 
 #define MSG_DONTROUTE 0x00000100
 
+//
+// This flag is only valid for recvmmsg. It requests that the call block only
+// until the first message arrives, and then collect whatever else is already
+// queued without waiting further.
+//
+
+#define MSG_WAITFORONE 0x00000200
+
 //
 // Define the shutdown types. Read closes the socket for further reading, write
 // closes the socket for further writing, and rdwr closes the socket for both
@@ -583,6 +592,25 @@ struct msghdr {
 
 /*++
 
+Structure Description:
+
+    This structure defines one element of a multiple message send or receive.
+
+Members:
+
+    msg_hdr - Stores the message itself.
+
+    msg_len - Stores the number of bytes sent or received for this message.
+
+--*/
+
+struct mmsghdr {
+    struct msghdr msg_hdr;
+    unsigned int msg_len;
+};
+
+/*++
+
 Structure Description:
 
     This structure defines a socket control message, the header for the socket
@@ -1001,6 +1029,45 @@ Return Value:
 
 --*/
 
+LIBC_API
+int
+sendmmsg (
+    int Socket,
+    struct mmsghdr *Messages,
+    unsigned int MessageCount,
+    int Flags
+    );
+
+/*++
+
+Routine Description:
+
+    This routine sends several messages out of a socket with a single call
+    into the kernel. Datagram sockets send consecutive messages bound for the
+    same destination down the network stack together.
+
+Arguments:
+
+    Socket - Supplies the file descriptor of the socket to send data out of.
+
+    Messages - Supplies an array of messages to send. On return, the msg_len
+        member of each sent message is set to the number of bytes sent.
+
+    MessageCount - Supplies the number of elements in the message array.
+
+    Flags - Supplies a bitfield of flags governing the transmission of the data.
+        See MSG_* definitions.
+
+Return Value:
+
+    Returns the number of messages sent on success. This may be less than the
+    count supplied if an error stopped the batch part way through.
+
+    -1 on error if no messages could be sent, and the errno variable will be
+    set to contain more information.
+
+--*/
+
 LIBC_API
 ssize_t
 recv (
@@ -1116,6 +1183,48 @@ Return Value:
 
 --*/
 
+LIBC_API
+int
+recvmmsg (
+    int Socket,
+    struct mmsghdr *Messages,
+    unsigned int MessageCount,
+    int Flags,
+    struct timespec *Timeout
+    );
+
+/*++
+
+Routine Description:
+
+    This routine receives several messages from a socket with a single call
+    into the kernel.
+
+Arguments:
+
+    Socket - Supplies the file descriptor of the socket to receive data from.
+
+    Messages - Supplies an array of initialized message structures where the
+        received messages will be returned. On return, the msg_len member of
+        each received message is set to the number of bytes received.
+
+    MessageCount - Supplies the number of elements in the message array.
+
+    Flags - Supplies a bitfield of flags governing the reception of the data.
+        See MSG_* definitions. MSG_WAITFORONE is also accepted here.
+
+    Timeout - Supplies an optional pointer to the amount of time to wait for
+        each message. Supply NULL to wait indefinitely.
+
+Return Value:
+
+    Returns the number of messages received on success.
+
+    -1 on error if no messages were received, and the errno variable will be
+    set to contain more information.
+
+--*/
+
 LIBC_API
 int
 shutdown (
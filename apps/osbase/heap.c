@@ -47,14 +47,176 @@ Module Name:
 #define SYSTEM_HEAP_MAGIC 0x6C6F6F50 // 'looP'
 #define SYSTEM_HEAP_DIRECT_ALLOCATION_THRESHOLD (256 * _1MB)
 
+//
+// Define the tag under which the per-thread heap caches hold their objects in
+// the heap. Cached objects keep this tag for their whole lifetime, which is
+// how a free tells them apart from allocations that came straight from the
+// heap. The caches themselves are allocated under a different tag.
+//
+
+#define OS_HEAP_CACHE_ALLOCATION_TAG 0x6348734F // 'OsHc'
+#define OS_HEAP_CACHE_STRUCTURE_TAG 0x5448734F // 'OsHT'
+
+//
+// Define the parameters of the per-thread heap caches. Each thread keeps a
+// list of free objects for every small size class. Lists are refilled from
+// and trimmed back to the heap a batch at a time, so the heap lock is only
+// taken once per batch. Objects freed by a thread other than their owner are
+// gathered into a batch and handed back to the owner all at once.
+//
+
+#define OS_HEAP_CACHE_CLASS_COUNT 15
+#define OS_HEAP_CACHE_GRANULARITY 16
+#define OS_HEAP_CACHE_MAX_SIZE 1024
+#define OS_HEAP_CACHE_MAX_REQUEST \
+    (OS_HEAP_CACHE_MAX_SIZE - sizeof(OS_HEAP_CACHE_TRAILER))
+
+#define OS_HEAP_CACHE_LIST_MAX 64
+#define OS_HEAP_CACHE_REFILL_COUNT 16
+#define OS_HEAP_CACHE_TRIM_COUNT (OS_HEAP_CACHE_LIST_MAX / 2)
+#define OS_HEAP_CACHE_REMOTE_BATCH 32
+
+//
+// This bit is set in the trailer class while an object is free in a cache.
+//
+
+#define OS_HEAP_CACHE_CLASS_FREE ((UINTN)1 << ((sizeof(UINTN) * 8) - 1))
+
 //
 // ------------------------------------------------------ Data Type Definitions
 //
 
+/*++
+
+Structure Description:
+
+    This structure defines the bookkeeping stored at the end of every object
+    handed out by the per-thread heap caches.
+
+Members:
+
+    Owner - Stores a pointer to the thread cache the object belongs to.
+
+    Class - Stores the size class of the object, combined with the free flag
+        if the object is currently sitting in a cache.
+
+--*/
+
+typedef struct _OS_HEAP_CACHE_TRAILER {
+    struct _OS_HEAP_THREAD_CACHE *Owner;
+    UINTN Class;
+} OS_HEAP_CACHE_TRAILER, *POS_HEAP_CACHE_TRAILER;
+
+/*++
+
+Structure Description:
+
+    This structure defines a singly linked list of free objects of one size
+    class. The first pointer of each free object links to the next.
+
+Members:
+
+    Head - Stores a pointer to the first free object.
+
+    Count - Stores the number of objects on the list.
+
+--*/
+
+typedef struct _OS_HEAP_CACHE_LIST {
+    PVOID Head;
+    UINTN Count;
+} OS_HEAP_CACHE_LIST, *POS_HEAP_CACHE_LIST;
+
+/*++
+
+Structure Description:
+
+    This structure defines a thread's small allocation cache. Caches are never
+    freed: when a thread exits its cache is emptied and retired, and later
+    adopted by a new thread. This keeps it safe for another thread to hand
+    objects back to a cache whose thread has exited.
+
+Members:
+
+    Lists - Stores the free lists for each size class. These are only touched
+        by the owning thread.
+
+    RemoteFrees - Stores the head of a lock-free stack of objects owned by
+        this cache that were freed by other threads.
+
+    PendingOwner - Stores a pointer to the cache that owns the objects in the
+        pending batch of remote frees.
+
+    PendingHead - Stores the head of the pending batch of objects freed by
+        this thread but owned by another.
+
+    PendingTail - Stores the last object in the pending batch.
+
+    PendingCount - Stores the number of objects in the pending batch.
+
+    NextRetired - Stores a pointer to the next cache on the retired list.
+
+--*/
+
+typedef struct _OS_HEAP_THREAD_CACHE {
+    OS_HEAP_CACHE_LIST Lists[OS_HEAP_CACHE_CLASS_COUNT];
+    PVOID volatile RemoteFrees;
+    struct _OS_HEAP_THREAD_CACHE *PendingOwner;
+    PVOID PendingHead;
+    PVOID PendingTail;
+    UINTN PendingCount;
+    struct _OS_HEAP_THREAD_CACHE *NextRetired;
+} OS_HEAP_THREAD_CACHE, *POS_HEAP_THREAD_CACHE;
+
 //
 // ----------------------------------------------- Internal Function Prototypes
 //
 
+POS_HEAP_THREAD_CACHE
+OspGetHeapThreadCache (
+    BOOL Create
+    );
+
+PVOID
+OspHeapCacheAllocate (
+    POS_HEAP_THREAD_CACHE Cache,
+    UINTN Size
+    );
+
+VOID
+OspHeapCacheFree (
+    PVOID Memory,
+    UINTN UsableSize
+    );
+
+VOID
+OspHeapCacheRefill (
+    POS_HEAP_THREAD_CACHE Cache,
+    UINTN Class
+    );
+
+VOID
+OspHeapCacheTrim (
+    POS_HEAP_THREAD_CACHE Cache,
+    UINTN Class,
+    UINTN Count
+    );
+
+VOID
+OspHeapCacheCollectRemoteFrees (
+    POS_HEAP_THREAD_CACHE Cache
+    );
+
+VOID
+OspHeapCacheFlushPendingFrees (
+    POS_HEAP_THREAD_CACHE Cache
+    );
+
+POS_HEAP_CACHE_TRAILER
+OspHeapCacheGetTrailer (
+    PVOID Object
+    );
+
 PVOID
 OspHeapExpand (
     PMEMORY_HEAP Heap,
@@ -94,6 +256,33 @@ OS_LOCK OsHeapLock;
 UINTN OsPageShift;
 UINTN OsPageSize;
 
+//
+// Store whether or not the per-thread heap caches are in use. They are
+// enabled once the initial thread has a thread control block. Before that,
+// everything goes straight to the heap.
+//
+
+BOOL OsHeapThreadCachingEnabled = FALSE;
+
+//
+// Store the size of each cache size class, including the trailer, and a table
+// that rounds a size up to its class in units of the cache granularity.
+//
+
+const USHORT OsHeapCacheClassSizes[OS_HEAP_CACHE_CLASS_COUNT] = {
+    32, 48, 64, 80, 96, 128, 160, 192, 256, 320, 384, 512, 640, 768, 1024
+};
+
+UCHAR OsHeapCacheSizeToClass[
+                    (OS_HEAP_CACHE_MAX_SIZE / OS_HEAP_CACHE_GRANULARITY) + 1];
+
+//
+// Store the list of caches whose threads have exited, protected by the heap
+// lock.
+//
+
+POS_HEAP_THREAD_CACHE OsHeapRetiredCaches;
+
 //
 // ------------------------------------------------------------------ Functions
 //
@@ -128,6 +317,16 @@ Return Value:
 {
 
     PVOID Allocation;
+    POS_HEAP_THREAD_CACHE Cache;
+
+    if ((Size <= OS_HEAP_CACHE_MAX_REQUEST) &&
+        (OsHeapThreadCachingEnabled != FALSE)) {
+
+        Cache = OspGetHeapThreadCache(TRUE);
+        if (Cache != NULL) {
+            return OspHeapCacheAllocate(Cache, Size);
+        }
+    }
 
     OsAcquireLock(&OsHeapLock);
     Allocation = RtlHeapAllocate(&OsHeap, Size, Tag);
@@ -159,6 +358,21 @@ Return Value:
 
 {
 
+    UINTN Size;
+    UINTN Tag;
+
+    if (Memory == NULL) {
+        return;
+    }
+
+    if (OsHeapThreadCachingEnabled != FALSE) {
+        Size = RtlHeapGetAllocationSize(&OsHeap, Memory, &Tag);
+        if (Tag == OS_HEAP_CACHE_ALLOCATION_TAG) {
+            OspHeapCacheFree(Memory, Size);
+            return;
+        }
+    }
+
     OsAcquireLock(&OsHeapLock);
     RtlHeapFree(&OsHeap, Memory);
     OsReleaseLock(&OsHeapLock);
@@ -203,6 +417,36 @@ Return Value:
 {
 
     PVOID Allocation;
+    UINTN HeapTag;
+    UINTN Size;
+
+    //
+    // Objects from the thread caches cannot be resized in place by the heap.
+    // Keep them if they're big enough, or move them elsewhere if not.
+    //
+
+    if ((Memory != NULL) && (OsHeapThreadCachingEnabled != FALSE)) {
+        Size = RtlHeapGetAllocationSize(&OsHeap, Memory, &HeapTag);
+        if (HeapTag == OS_HEAP_CACHE_ALLOCATION_TAG) {
+            Size -= sizeof(OS_HEAP_CACHE_TRAILER);
+            if (NewSize == 0) {
+                OsHeapFree(Memory);
+                return NULL;
+            }
+
+            if (NewSize <= Size) {
+                return Memory;
+            }
+
+            Allocation = OsHeapAllocate(NewSize, Tag);
+            if (Allocation != NULL) {
+                RtlCopyMemory(Allocation, Memory, Size);
+                OsHeapFree(Memory);
+            }
+
+            return Allocation;
+        }
+    }
 
     OsAcquireLock(&OsHeapLock);
     Allocation = RtlHeapReallocate(&OsHeap, Memory, NewSize, Tag);
@@ -325,10 +569,599 @@ Return Value:
     return;
 }
 
+VOID
+OspEnableHeapThreadCaching (
+    VOID
+    )
+
+/*++
+
+Routine Description:
+
+    This routine enables the per-thread small allocation caches in front of
+    the heap. It must not be called until the current thread has a valid
+    thread control block.
+
+Arguments:
+
+    None.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    UINTN Class;
+    UINTN SizeIndex;
+
+    if (OsHeapThreadCachingEnabled != FALSE) {
+        return;
+    }
+
+    Class = 0;
+    for (SizeIndex = 0;
+         SizeIndex < sizeof(OsHeapCacheSizeToClass);
+         SizeIndex += 1) {
+
+        while ((SizeIndex * OS_HEAP_CACHE_GRANULARITY) >
+               OsHeapCacheClassSizes[Class]) {
+
+            Class += 1;
+        }
+
+        OsHeapCacheSizeToClass[SizeIndex] = Class;
+    }
+
+    OsHeapThreadCachingEnabled = TRUE;
+    return;
+}
+
+VOID
+OspDestroyHeapThreadCache (
+    PTHREAD_CONTROL_BLOCK ThreadControlBlock
+    )
+
+/*++
+
+Routine Description:
+
+    This routine returns everything in the given thread's heap cache to the
+    heap and retires the cache. The thread must not allocate or free memory
+    once this routine has been called.
+
+Arguments:
+
+    ThreadControlBlock - Supplies a pointer to the control block of the
+        thread whose cache should be destroyed.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    POS_HEAP_THREAD_CACHE Cache;
+    UINTN Class;
+    POS_HEAP_CACHE_LIST List;
+    PVOID Object;
+
+    Cache = ThreadControlBlock->HeapCache;
+    if (Cache == NULL) {
+        return;
+    }
+
+    ThreadControlBlock->HeapCache = NULL;
+    OspHeapCacheFlushPendingFrees(Cache);
+    OspHeapCacheCollectRemoteFrees(Cache);
+
+    //
+    // Release every cached object back to the heap and retire the cache. Any
+    // objects still out there will find their way back to the cache's remote
+    // list, and get picked up by whichever thread adopts it next.
+    //
+
+    OsAcquireLock(&OsHeapLock);
+    for (Class = 0; Class < OS_HEAP_CACHE_CLASS_COUNT; Class += 1) {
+        List = &(Cache->Lists[Class]);
+        while (List->Head != NULL) {
+            Object = List->Head;
+            List->Head = *((PVOID *)Object);
+            RtlHeapFree(&OsHeap, Object);
+        }
+
+        List->Count = 0;
+    }
+
+    Cache->NextRetired = OsHeapRetiredCaches;
+    OsHeapRetiredCaches = Cache;
+    OsReleaseLock(&OsHeapLock);
+    return;
+}
+
 //
 // --------------------------------------------------------- Internal Functions
 //
 
+POS_HEAP_THREAD_CACHE
+OspGetHeapThreadCache (
+    BOOL Create
+    )
+
+/*++
+
+Routine Description:
+
+    This routine returns the heap cache for the current thread.
+
+Arguments:
+
+    Create - Supplies a boolean indicating whether or not to set up a cache
+        for the thread if it does not have one yet.
+
+Return Value:
+
+    Returns a pointer to the current thread's cache.
+
+    NULL if the thread has no cache and one was not or could not be created.
+
+--*/
+
+{
+
+    POS_HEAP_THREAD_CACHE Cache;
+    PTHREAD_CONTROL_BLOCK ThreadControlBlock;
+
+    ThreadControlBlock = OspGetThreadControlBlock();
+    Cache = ThreadControlBlock->HeapCache;
+    if ((Cache != NULL) || (Create == FALSE)) {
+        return Cache;
+    }
+
+    //
+    // Adopt a retired cache if there is one, or allocate a new one.
+    //
+
+    OsAcquireLock(&OsHeapLock);
+    Cache = OsHeapRetiredCaches;
+    if (Cache != NULL) {
+        OsHeapRetiredCaches = Cache->NextRetired;
+        Cache->NextRetired = NULL;
+
+    } else {
+        Cache = RtlHeapAllocate(&OsHeap,
+                                sizeof(OS_HEAP_THREAD_CACHE),
+                                OS_HEAP_CACHE_STRUCTURE_TAG);
+
+        if (Cache != NULL) {
+            RtlZeroMemory(Cache, sizeof(OS_HEAP_THREAD_CACHE));
+        }
+    }
+
+    OsReleaseLock(&OsHeapLock);
+    ThreadControlBlock->HeapCache = Cache;
+    return Cache;
+}
+
+PVOID
+OspHeapCacheAllocate (
+    POS_HEAP_THREAD_CACHE Cache,
+    UINTN Size
+    )
+
+/*++
+
+Routine Description:
+
+    This routine allocates a small object from the given thread cache.
+
+Arguments:
+
+    Cache - Supplies a pointer to the current thread's cache.
+
+    Size - Supplies the size of the allocation request, in bytes.
+
+Return Value:
+
+    Returns a pointer to the allocation if successful, or NULL if the
+    allocation failed.
+
+--*/
+
+{
+
+    UINTN Class;
+    POS_HEAP_CACHE_LIST List;
+    PVOID Object;
+    POS_HEAP_CACHE_TRAILER Trailer;
+
+    Size += sizeof(OS_HEAP_CACHE_TRAILER);
+    Class = OsHeapCacheSizeToClass[
+          (Size + OS_HEAP_CACHE_GRANULARITY - 1) / OS_HEAP_CACHE_GRANULARITY];
+
+    ASSERT(Size <= OsHeapCacheClassSizes[Class]);
+
+    //
+    // If the list is empty, first take back anything other threads have
+    // freed, and then go to the heap for more.
+    //
+
+    List = &(Cache->Lists[Class]);
+    if (List->Head == NULL) {
+        if (Cache->RemoteFrees != NULL) {
+            OspHeapCacheCollectRemoteFrees(Cache);
+        }
+
+        if (List->Head == NULL) {
+            OspHeapCacheRefill(Cache, Class);
+            if (List->Head == NULL) {
+                return NULL;
+            }
+        }
+    }
+
+    Object = List->Head;
+    List->Head = *((PVOID *)Object);
+    List->Count -= 1;
+    Trailer = OspHeapCacheGetTrailer(Object);
+
+    ASSERT((Trailer->Owner == Cache) &&
+           (Trailer->Class == (Class | OS_HEAP_CACHE_CLASS_FREE)));
+
+    Trailer->Class = Class;
+    return Object;
+}
+
+VOID
+OspHeapCacheFree (
+    PVOID Memory,
+    UINTN UsableSize
+    )
+
+/*++
+
+Routine Description:
+
+    This routine frees an object that came from a thread cache. If the
+    current thread owns the object, it goes back on the thread's own list.
+    Otherwise it is added to a batch to hand back to the owner.
+
+Arguments:
+
+    Memory - Supplies a pointer to the object to free.
+
+    UsableSize - Supplies the usable size of the object's heap allocation.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    POS_HEAP_THREAD_CACHE Cache;
+    UINTN Class;
+    PVOID Head;
+    POS_HEAP_CACHE_LIST List;
+    POS_HEAP_THREAD_CACHE Owner;
+    POS_HEAP_CACHE_TRAILER Trailer;
+
+    Trailer = Memory + UsableSize - sizeof(OS_HEAP_CACHE_TRAILER);
+    Class = Trailer->Class;
+    if ((Class & OS_HEAP_CACHE_CLASS_FREE) != 0) {
+        OspHeapCorruption(&OsHeap, HeapCorruptionDoubleFree, Memory);
+        return;
+    }
+
+    ASSERT(Class < OS_HEAP_CACHE_CLASS_COUNT);
+
+    Trailer->Class = Class | OS_HEAP_CACHE_CLASS_FREE;
+    Owner = Trailer->Owner;
+    Cache = OspGetHeapThreadCache(FALSE);
+
+    //
+    // Put the object back on the list if this thread owns it, handing a batch
+    // back to the heap if the list has gotten too long.
+    //
+
+    if (Cache == Owner) {
+        List = &(Cache->Lists[Class]);
+        *((PVOID *)Memory) = List->Head;
+        List->Head = Memory;
+        List->Count += 1;
+        if (List->Count > OS_HEAP_CACHE_LIST_MAX) {
+            OspHeapCacheTrim(Cache, Class, OS_HEAP_CACHE_TRIM_COUNT);
+        }
+
+        return;
+    }
+
+    //
+    // This is a remote free. If this thread has no cache to batch with, hand
+    // the object straight back.
+    //
+
+    if (Cache == NULL) {
+        do {
+            Head = Owner->RemoteFrees;
+            *((PVOID *)Memory) = Head;
+
+        } while (RtlAtomicCompareExchange(&(Owner->RemoteFrees),
+                                          (UINTN)Memory,
+                                          (UINTN)Head) != (UINTN)Head);
+
+        return;
+    }
+
+    if (Cache->PendingOwner != Owner) {
+        OspHeapCacheFlushPendingFrees(Cache);
+        Cache->PendingOwner = Owner;
+    }
+
+    *((PVOID *)Memory) = Cache->PendingHead;
+    if (Cache->PendingHead == NULL) {
+        Cache->PendingTail = Memory;
+    }
+
+    Cache->PendingHead = Memory;
+    Cache->PendingCount += 1;
+    if (Cache->PendingCount >= OS_HEAP_CACHE_REMOTE_BATCH) {
+        OspHeapCacheFlushPendingFrees(Cache);
+    }
+
+    return;
+}
+
+VOID
+OspHeapCacheRefill (
+    POS_HEAP_THREAD_CACHE Cache,
+    UINTN Class
+    )
+
+/*++
+
+Routine Description:
+
+    This routine allocates a batch of objects for the given size class from
+    the heap, acquiring the heap lock only once.
+
+Arguments:
+
+    Cache - Supplies a pointer to the current thread's cache.
+
+    Class - Supplies the size class to refill.
+
+Return Value:
+
+    None. On allocation failure the list may be refilled partially or not at
+    all.
+
+--*/
+
+{
+
+    UINTN Count;
+    POS_HEAP_CACHE_LIST List;
+    PVOID Object;
+    UINTN Size;
+    POS_HEAP_CACHE_TRAILER Trailer;
+
+    List = &(Cache->Lists[Class]);
+    Size = OsHeapCacheClassSizes[Class];
+    OsAcquireLock(&OsHeapLock);
+    for (Count = 0; Count < OS_HEAP_CACHE_REFILL_COUNT; Count += 1) {
+        Object = RtlHeapAllocate(&OsHeap, Size, OS_HEAP_CACHE_ALLOCATION_TAG);
+        if (Object == NULL) {
+            break;
+        }
+
+        Trailer = OspHeapCacheGetTrailer(Object);
+        Trailer->Owner = Cache;
+        Trailer->Class = Class | OS_HEAP_CACHE_CLASS_FREE;
+        *((PVOID *)Object) = List->Head;
+        List->Head = Object;
+        List->Count += 1;
+    }
+
+    OsReleaseLock(&OsHeapLock);
+    return;
+}
+
+VOID
+OspHeapCacheTrim (
+    POS_HEAP_THREAD_CACHE Cache,
+    UINTN Class,
+    UINTN Count
+    )
+
+/*++
+
+Routine Description:
+
+    This routine releases objects from the given cache list back to the heap,
+    acquiring the heap lock only once.
+
+Arguments:
+
+    Cache - Supplies a pointer to the current thread's cache.
+
+    Class - Supplies the size class to trim.
+
+    Count - Supplies the number of objects to release.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    POS_HEAP_CACHE_LIST List;
+    PVOID Object;
+
+    List = &(Cache->Lists[Class]);
+    OsAcquireLock(&OsHeapLock);
+    while ((Count != 0) && (List->Head != NULL)) {
+        Object = List->Head;
+        List->Head = *((PVOID *)Object);
+        List->Count -= 1;
+        RtlHeapFree(&OsHeap, Object);
+        Count -= 1;
+    }
+
+    OsReleaseLock(&OsHeapLock);
+    return;
+}
+
+VOID
+OspHeapCacheCollectRemoteFrees (
+    POS_HEAP_THREAD_CACHE Cache
+    )
+
+/*++
+
+Routine Description:
+
+    This routine takes back all the objects other threads have freed to the
+    given cache, and puts them on the cache's lists.
+
+Arguments:
+
+    Cache - Supplies a pointer to the cache. This must either be the current
+        thread's cache or a cache whose thread has exited.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    UINTN Class;
+    POS_HEAP_CACHE_LIST List;
+    PVOID Next;
+    PVOID Object;
+    POS_HEAP_CACHE_TRAILER Trailer;
+
+    Object = (PVOID)RtlAtomicExchange(&(Cache->RemoteFrees), (UINTN)NULL);
+    while (Object != NULL) {
+        Next = *((PVOID *)Object);
+        Trailer = OspHeapCacheGetTrailer(Object);
+
+        ASSERT(Trailer->Owner == Cache);
+
+        Class = Trailer->Class & ~OS_HEAP_CACHE_CLASS_FREE;
+        List = &(Cache->Lists[Class]);
+        *((PVOID *)Object) = List->Head;
+        List->Head = Object;
+        List->Count += 1;
+        Object = Next;
+    }
+
+    //
+    // Don't let a thread that allocates what other threads free end up
+    // hoarding it all.
+    //
+
+    for (Class = 0; Class < OS_HEAP_CACHE_CLASS_COUNT; Class += 1) {
+        List = &(Cache->Lists[Class]);
+        if (List->Count > OS_HEAP_CACHE_LIST_MAX) {
+            OspHeapCacheTrim(Cache,
+                             Class,
+                             List->Count - OS_HEAP_CACHE_LIST_MAX);
+        }
+    }
+
+    return;
+}
+
+VOID
+OspHeapCacheFlushPendingFrees (
+    POS_HEAP_THREAD_CACHE Cache
+    )
+
+/*++
+
+Routine Description:
+
+    This routine hands the batch of objects the given cache's thread has freed
+    on behalf of another cache back to that cache.
+
+Arguments:
+
+    Cache - Supplies a pointer to the cache with the pending batch.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PVOID Head;
+    POS_HEAP_THREAD_CACHE Owner;
+
+    if (Cache->PendingHead == NULL) {
+        return;
+    }
+
+    //
+    // Push the whole chain onto the owner's remote list at once. The list is
+    // only ever emptied all at once, so there's no ABA problem here.
+    //
+
+    Owner = Cache->PendingOwner;
+    do {
+        Head = Owner->RemoteFrees;
+        *((PVOID *)(Cache->PendingTail)) = Head;
+
+    } while (RtlAtomicCompareExchange(&(Owner->RemoteFrees),
+                                      (UINTN)(Cache->PendingHead),
+                                      (UINTN)Head) != (UINTN)Head);
+
+    Cache->PendingHead = NULL;
+    Cache->PendingTail = NULL;
+    Cache->PendingCount = 0;
+    return;
+}
+
+POS_HEAP_CACHE_TRAILER
+OspHeapCacheGetTrailer (
+    PVOID Object
+    )
+
+/*++
+
+Routine Description:
+
+    This routine returns the trailer of a thread cache object.
+
+Arguments:
+
+    Object - Supplies a pointer to the object.
+
+Return Value:
+
+    Returns a pointer to the trailer at the end of the object's usable space.
+
+--*/
+
+{
+
+    UINTN Size;
+
+    Size = RtlHeapGetAllocationSize(&OsHeap, Object, NULL);
+    return Object + Size - sizeof(OS_HEAP_CACHE_TRAILER);
+}
+
 PVOID
 OspHeapExpand (
     PMEMORY_HEAP Heap,
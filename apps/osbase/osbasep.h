@@ -96,6 +96,9 @@ Structure Description:
     ListEntry - Stores pointers to the next and previous threads in the OS
         Library thread list.
 
+    HeapCache - Stores a pointer to the thread's small allocation heap cache,
+        or NULL if the thread has not yet needed one.
+
 --*/
 
 typedef struct _THREAD_CONTROL_BLOCK {
@@ -106,6 +109,7 @@ typedef struct _THREAD_CONTROL_BLOCK {
     UINTN StackGuard;
     UINTN BaseAllocationSize;
     LIST_ENTRY ListEntry;
+    PVOID HeapCache;
 } THREAD_CONTROL_BLOCK, *PTHREAD_CONTROL_BLOCK;
 
 //
@@ -283,6 +287,53 @@ Return Value:
 
 --*/
 
+VOID
+OspEnableHeapThreadCaching (
+    VOID
+    );
+
+/*++
+
+Routine Description:
+
+    This routine enables the per-thread small allocation caches in front of
+    the heap. It must not be called until the current thread has a valid
+    thread control block.
+
+Arguments:
+
+    None.
+
+Return Value:
+
+    None.
+
+--*/
+
+VOID
+OspDestroyHeapThreadCache (
+    PTHREAD_CONTROL_BLOCK ThreadControlBlock
+    );
+
+/*++
+
+Routine Description:
+
+    This routine returns everything in the given thread's heap cache to the
+    heap and retires the cache. The thread must not allocate or free memory
+    once this routine has been called.
+
+Arguments:
+
+    ThreadControlBlock - Supplies a pointer to the control block of the
+        thread whose cache should be destroyed.
+
+Return Value:
+
+    None.
+
+--*/
+
 VOID
 OspInitializeImageSupport (
     VOID
@@ -369,6 +420,29 @@ Return Value:
 
 --*/
 
+ULONGLONG
+OspReadHardwareTimeCounter (
+    VOID
+    );
+
+/*++
+
+Routine Description:
+
+    This routine reads the raw hardware counter backing the time counter. It
+    should only be called if the kernel has published that direct reads are
+    allowed.
+
+Arguments:
+
+    None.
+
+Return Value:
+
+    Returns the raw hardware counter value.
+
+--*/
+
 //
 // Thread-Local storage functions
 //
@@ -473,3 +547,25 @@ Return Value:
 
 --*/
 
+
+PTHREAD_CONTROL_BLOCK
+OspGetThreadControlBlock (
+    VOID
+    );
+
+/*++
+
+Routine Description:
+
+    This routine returns a pointer to the thread control block, a structure
+    unique to each thread.
+
+Arguments:
+
+    None.
+
+Return Value:
+
+    Returns a pointer to the current thread's control block.
+
+--*/
@@ -430,6 +430,7 @@ Return Value:
 
     OspTlsAllocate(&OsLoadedImagesHead, (PVOID *)&Thread, FALSE);
     OsSetThreadPointer(Thread);
+    OspEnableHeapThreadCaching();
 
     //
     // Now that TLS offsets are settled, relocate the images.
@@ -435,6 +435,65 @@ Return Value:
     return OsSystemCall(SystemCallSocketPerformVectoredIo, &Request);
 }
 
+OS_API
+KSTATUS
+OsSocketPerformMessageIo (
+    HANDLE Socket,
+    PSOCKET_MESSAGE Messages,
+    ULONG MessageCount,
+    ULONG IoFlags,
+    PULONG MessagesCompleted
+    )
+
+/*++
+
+Routine Description:
+
+    This routine sends or receives several messages on a socket with a single
+    system call.
+
+Arguments:
+
+    Socket - Supplies a pointer to the socket.
+
+    Messages - Supplies an array of messages. On return, the parameters of
+        each completed message are updated.
+
+    MessageCount - Supplies the number of elements in the message array. This
+        can be at most SYS_SOCKET_MESSAGE_MAX.
+
+    IoFlags - Supplies the I/O flags. Set SYS_IO_FLAG_WRITE to send the
+        messages, or leave it clear to receive them.
+
+    MessagesCompleted - Supplies a pointer where the number of messages
+        completed will be returned.
+
+Return Value:
+
+    Status code. If some messages completed before an error occurred, success
+    is returned along with the count.
+
+--*/
+
+{
+
+    SYSTEM_CALL_SOCKET_PERFORM_MESSAGE_IO Request;
+    INTN Result;
+
+    Request.Socket = Socket;
+    Request.MessageArray = Messages;
+    Request.MessageCount = MessageCount;
+    Request.IoFlags = IoFlags;
+    Result = OsSystemCall(SystemCallSocketPerformMessageIo, &Request);
+    if (Result < 0) {
+        *MessagesCompleted = 0;
+        return Result;
+    }
+
+    *MessagesCompleted = (ULONG)Result;
+    return STATUS_SUCCESS;
+}
+
 OS_API
 KSTATUS
 OsSocketGetSetInformation (
@@ -299,11 +299,83 @@ Return Value:
     Parameters.Value = *Value;
     Parameters.Operation = Operation;
     Parameters.TimeoutInMilliseconds = TimeoutInMilliseconds;
+    Parameters.RequeueAddress = NULL;
+    Parameters.RequeueCount = 0;
+    Parameters.CompareValue = 0;
     Status = OsSystemCall(SystemCallUserLock, &Parameters);
     *Value = Parameters.Value;
     return Status;
 }
 
+OS_API
+KSTATUS
+OsUserLockRequeue (
+    PVOID Address,
+    ULONG Flags,
+    ULONG CompareValue,
+    PULONG WakeCount,
+    PVOID RequeueAddress,
+    PULONG RequeueCount
+    )
+
+/*++
+
+Routine Description:
+
+    This routine wakes some threads blocked on a user mode lock, and moves
+    some of the remaining waiters to block on a second address without waking
+    them. This is useful for waking a single thread blocked on a condition
+    variable and transferring the rest to the associated mutex.
+
+Arguments:
+
+    Address - Supplies a pointer to a 32-bit value representing the lock
+        threads are currently blocked on.
+
+    Flags - Supplies a bitfield of USER_LOCK_* flags governing the operation.
+
+    CompareValue - Supplies the value the given address must still contain
+        for the operation to proceed.
+
+    WakeCount - Supplies a pointer that on input contains the number of
+        threads to wake. On output, contains the number of threads woken.
+
+    RequeueAddress - Supplies a pointer to the 32-bit value remaining waiters
+        should be moved to.
+
+    RequeueCount - Supplies a pointer that on input contains the maximum
+        number of threads to move to the requeue address. On output, contains
+        the number of threads actually moved.
+
+Return Value:
+
+    STATUS_SUCCESS if the operation succeeded.
+
+    STATUS_OPERATION_WOULD_BLOCK if the value at the given address was not
+    equal to the compare value. No threads are woken or moved in this case.
+
+--*/
+
+{
+
+    SYSTEM_CALL_USER_LOCK Parameters;
+    KSTATUS Status;
+
+    Parameters.Address = Address;
+    Parameters.Value = *WakeCount;
+    Parameters.Operation = UserLockRequeue |
+                           (Flags & ~USER_LOCK_OPERATION_MASK);
+
+    Parameters.TimeoutInMilliseconds = 0;
+    Parameters.RequeueAddress = RequeueAddress;
+    Parameters.RequeueCount = *RequeueCount;
+    Parameters.CompareValue = CompareValue;
+    Status = OsSystemCall(SystemCallUserLock, &Parameters);
+    *WakeCount = Parameters.Value;
+    *RequeueCount = Parameters.RequeueCount;
+    return Status;
+}
+
 //
 // --------------------------------------------------------- Internal Functions
 //
@@ -128,7 +128,8 @@ OsQueryTimeCounter (
 Routine Description:
 
     This routine returns the current (most up to date) value of the system's
-    time counter.
+    time counter. If the kernel allows it, the hardware counter is read
+    directly, otherwise this requires a system call.
 
 Arguments:
 
@@ -142,7 +143,32 @@ Return Value:
 
 {
 
+    ULONG Direct;
+    ULONGLONG Offset;
     SYSTEM_CALL_QUERY_TIME_COUNTER Parameters;
+    ULONG Sequence;
+    PUSER_SHARED_DATA UserSharedData;
+
+    UserSharedData = OspGetUserSharedData();
+
+    //
+    // Loop until a consistent snap of the direct read members is obtained.
+    // An odd sequence number means the kernel is in the middle of an update.
+    //
+
+    do {
+        Sequence = UserSharedData->TimeCounterSequence;
+        RtlMemoryBarrier();
+        Direct = UserSharedData->TimeCounterDirect;
+        Offset = UserSharedData->TimeCounterDirectOffset;
+        RtlMemoryBarrier();
+
+    } while (((Sequence & 0x1) != 0) ||
+             (Sequence != UserSharedData->TimeCounterSequence));
+
+    if (Direct != FALSE) {
+        return OspReadHardwareTimeCounter() + Offset;
+    }
 
     OsSystemCall(SystemCallQueryTimeCounter, &Parameters);
     return Parameters.Value;
@@ -50,11 +50,6 @@ Module Name:
 // ----------------------------------------------- Internal Function Prototypes
 //
 
-PTHREAD_CONTROL_BLOCK
-OspGetThreadControlBlock (
-    VOID
-    );
-
 //
 // -------------------------------------------------------------------- Globals
 //
@@ -624,6 +619,7 @@ Return Value:
         OsHeapFree(ThreadControlBlock->TlsVector);
     }
 
+    OspDestroyHeapThreadCache(ThreadControlBlock);
     OsAcquireLock(&OsThreadListLock);
     LIST_REMOVE(&(ThreadControlBlock->ListEntry));
     OsReleaseLock(&OsThreadListLock);
@@ -136,6 +136,9 @@ if ((arch == "x86") || (arch == "x64")) {
         "rtl81xx.drv",
         "uhci.drv",
         "pcnet32.drv",
+        "vioblk.drv",
+        "vionet.drv",
+        "virtio.drv",
     ];
 
 } else if ((arch == "armv7") || (arch == "armv6")) {
@@ -166,6 +169,8 @@ if ((arch == "x86") || (arch == "x64")) {
         "usbhub.drv",
         "usbmass.drv",
         "sd.drv",
+        "virtio.drv",
+        "vioblk.drv",
     ];
 }
 
@@ -766,6 +771,9 @@ if ((plat == "install-x86") || (plat == "install-x64")) {
         "usbmouse.drv",
         "usrinput.drv",
         "videocon.drv",
+        "vioblk.drv",
+        "vionet.drv",
+        "virtio.drv",
     ];
 
     Files += [
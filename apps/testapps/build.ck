@@ -41,6 +41,7 @@ function build() {
         "mnttest",
         "pathtest",
         "perftest",
+        "schedtest",
         "sigtest",
         "socktest",
         "utmrtest"
@@ -36,6 +36,7 @@ function build() {
     var sources;
 
     sources = [
+        "clock.c",
         "copy.c",
         "create.c",
         "dlopen.c",
@@ -43,6 +44,8 @@ function build() {
         "getppid.c",
         "exec.c",
         "fork.c",
+        "ioring.c",
+        "loopback.c",
         "malloc.c",
         "mmap.c",
         "mutex.c",
@@ -50,6 +53,7 @@ function build() {
         "perfsup.c",
         "perftest.c",
         "pipeio.c",
+        "pollwait.c",
         "pthread.c",
         "read.c",
         "rename.c",
@@ -0,0 +1,142 @@
+/*++
+
+Copyright (c) 2026 Minoca Corp.
+
+    This file is licensed under the terms of the GNU General Public License
+    version 3. Alternative licensing terms are available. Contact
+    info@minocacorp.com for details. See the LICENSE file at the root of this
+    project for complete licensing information.
+
+Module Name:
+
+    clock.c
+
+Abstract:
+
+    This module implements the performance benchmark tests for reading the
+    precise clocks with the clock_gettime() C library call.
+
+Author:
+
+    Minoca Corp. 18-Oct-2026
+
+Environment:
+
+    User
+
+--*/
+
+//
+// ------------------------------------------------------------------- Includes
+//
+
+#include <assert.h>
+#include <errno.h>
+#include <time.h>
+
+#include "perftest.h"
+
+//
+// ---------------------------------------------------------------- Definitions
+//
+
+//
+// ------------------------------------------------------ Data Type Definitions
+//
+
+//
+// ----------------------------------------------- Internal Function Prototypes
+//
+
+//
+// -------------------------------------------------------------------- Globals
+//
+
+//
+// ------------------------------------------------------------------ Functions
+//
+
+void
+ClockMain (
+    PPT_TEST_INFORMATION Test,
+    PPT_TEST_RESULT Result
+    )
+
+/*++
+
+Routine Description:
+
+    This routine performs the clock read performance benchmark tests.
+
+Arguments:
+
+    Test - Supplies a pointer to the performance test being executed.
+
+    Result - Supplies a pointer to a performance test result structure that
+        receives the tests results.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    clockid_t Clock;
+    unsigned long long Iterations;
+    int Status;
+    struct timespec Time;
+
+    assert((Test->TestType == PtTestClockMonotonic) ||
+           (Test->TestType == PtTestClockRealtime));
+
+    Clock = CLOCK_MONOTONIC;
+    if (Test->TestType == PtTestClockRealtime) {
+        Clock = CLOCK_REALTIME;
+    }
+
+    Iterations = 0;
+    Result->Type = PtResultIterations;
+    Result->Status = 0;
+
+    //
+    // Start the test. This snaps resource usage and starts the clock ticking.
+    //
+
+    Status = PtStartTimedTest(Test->Duration);
+    if (Status != 0) {
+        Result->Status = errno;
+        goto MainEnd;
+    }
+
+    //
+    // Measure how many times the clock can be read. When the kernel allows
+    // user mode to read the time counter directly, this should not enter the
+    // kernel at all, so compare the result against the getppid test.
+    //
+
+    while (PtIsTimedTestRunning() != 0) {
+        Status = clock_gettime(Clock, &Time);
+        if (Status != 0) {
+            Result->Status = errno;
+            break;
+        }
+
+        Iterations += 1;
+    }
+
+    Status = PtFinishTimedTest(Result);
+    if ((Status != 0) && (Result->Status == 0)) {
+        Result->Status = errno;
+    }
+
+MainEnd:
+    Result->Data.Iterations = Iterations;
+    return;
+}
+
+//
+// --------------------------------------------------------- Internal Functions
+//
+
@@ -0,0 +1,908 @@
+/*++
+
+Copyright (c) 2026 Minoca Corp.
+
+    This file is licensed under the terms of the GNU General Public License
+    version 3. Alternative licensing terms are available. Contact
+    info@minocacorp.com for details. See the LICENSE file at the root of this
+    project for complete licensing information.
+
+Module Name:
+
+    ioring.c
+
+Abstract:
+
+    This module implements the performance benchmark tests that compare
+    batches of file and socket I/O issued through an I/O ring against the same
+    batches issued with one blocking call per operation.
+
+Author:
+
+    Minoca Corp. 18-Oct-2026
+
+Environment:
+
+    User
+
+--*/
+
+//
+// ------------------------------------------------------------------- Includes
+//
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioring.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "perftest.h"
+
+//
+// ---------------------------------------------------------------- Definitions
+//
+
+#define PT_IORING_FILE_NAME_LENGTH 48
+#define PT_IORING_FILE_SIZE (2 * 1024 * 1024)
+#define PT_IORING_BLOCK_SIZE 4096
+#define PT_IORING_MESSAGE_SIZE 1024
+
+//
+// Define the number of operations issued per batch. The ring tests submit a
+// whole batch with one system call.
+//
+
+#define PT_IORING_BATCH_SIZE 32
+
+//
+// Define the registered descriptor and buffer indices for the socket tests.
+//
+
+#define PT_IORING_CLIENT_INDEX 0
+#define PT_IORING_SERVER_INDEX 1
+
+//
+// ------------------------------------------------------ Data Type Definitions
+//
+
+//
+// ----------------------------------------------- Internal Function Prototypes
+//
+
+void
+PtpIoRingFileTest (
+    PPT_TEST_INFORMATION Test,
+    PPT_TEST_RESULT Result
+    );
+
+void
+PtpIoRingSocketTest (
+    PPT_TEST_INFORMATION Test,
+    PPT_TEST_RESULT Result
+    );
+
+int
+PtpIoRingConnectSockets (
+    int *Client,
+    int *Server
+    );
+
+int
+PtpIoRingWaitForCompletion (
+    struct ioring *Ring,
+    struct ioring_cqe *Completion
+    );
+
+//
+// -------------------------------------------------------------------- Globals
+//
+
+//
+// ------------------------------------------------------------------ Functions
+//
+
+void
+IoRingMain (
+    PPT_TEST_INFORMATION Test,
+    PPT_TEST_RESULT Result
+    )
+
+/*++
+
+Routine Description:
+
+    This routine performs the I/O ring and blocking I/O performance benchmark
+    tests.
+
+Arguments:
+
+    Test - Supplies a pointer to the performance test being executed.
+
+    Result - Supplies a pointer to a performance test result structure that
+        receives the tests results.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    Result->Type = PtResultBytes;
+    Result->Status = 0;
+    Result->Data.Bytes = 0;
+    switch (Test->TestType) {
+    case PtTestBlockFile:
+    case PtTestRingFile:
+        PtpIoRingFileTest(Test, Result);
+        break;
+
+    case PtTestBlockSocket:
+    case PtTestRingSocket:
+        PtpIoRingSocketTest(Test, Result);
+        break;
+
+    default:
+        fprintf(stderr, "Unknown I/O ring test type %d\n", Test->TestType);
+        Result->Status = EINVAL;
+        break;
+    }
+
+    return;
+}
+
+//
+// --------------------------------------------------------- Internal Functions
+//
+
+void
+PtpIoRingFileTest (
+    PPT_TEST_INFORMATION Test,
+    PPT_TEST_RESULT Result
+    )
+
+/*++
+
+Routine Description:
+
+    This routine measures how many bytes can be read from a cached file in
+    batches of block sized reads at increasing offsets.
+
+Arguments:
+
+    Test - Supplies a pointer to the performance test being executed.
+
+    Result - Supplies a pointer to a performance test result structure that
+        receives the tests results.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    char *Buffer;
+    ssize_t BytesCompleted;
+    struct ioring_cqe Completion;
+    int FileCreated;
+    int FileDescriptor;
+    char FileName[PT_IORING_FILE_NAME_LENGTH];
+    int Index;
+    off_t Offset;
+    struct ioring Ring;
+    int RingCreated;
+    struct iovec RingBuffer;
+    int Status;
+    struct ioring_sqe *Submission;
+    unsigned long long TotalBytes;
+
+    FileCreated = 0;
+    FileDescriptor = -1;
+    RingCreated = 0;
+    TotalBytes = 0;
+    Buffer = malloc(PT_IORING_BLOCK_SIZE * PT_IORING_BATCH_SIZE);
+    if (Buffer == NULL) {
+        Result->Status = ENOMEM;
+        goto FileTestEnd;
+    }
+
+    memset(Buffer, 'r', PT_IORING_BLOCK_SIZE * PT_IORING_BATCH_SIZE);
+
+    //
+    // Create a process safe file and prime the cache with it, so that this
+    // measures the cost of issuing I/O rather than the disk.
+    //
+
+    Status = snprintf(FileName,
+                      PT_IORING_FILE_NAME_LENGTH,
+                      "ioring_%d.txt",
+                      getpid());
+
+    if (Status < 0) {
+        Result->Status = errno;
+        goto FileTestEnd;
+    }
+
+    FileDescriptor = open(FileName,
+                          O_RDWR | O_CREAT | O_TRUNC,
+                          S_IRUSR | S_IWUSR);
+
+    if (FileDescriptor < 0) {
+        Result->Status = errno;
+        goto FileTestEnd;
+    }
+
+    FileCreated = 1;
+    for (Index = 0;
+         Index < (PT_IORING_FILE_SIZE / PT_IORING_BLOCK_SIZE);
+         Index += 1) {
+
+        do {
+            BytesCompleted = write(FileDescriptor,
+                                   Buffer,
+                                   PT_IORING_BLOCK_SIZE);
+
+        } while ((BytesCompleted < 0) && (errno == EINTR));
+
+        if (BytesCompleted != PT_IORING_BLOCK_SIZE) {
+            if (BytesCompleted < 0) {
+                Result->Status = errno;
+
+            } else {
+                Result->Status = EIO;
+            }
+
+            goto FileTestEnd;
+        }
+    }
+
+    if (fsync(FileDescriptor) != 0) {
+        Result->Status = errno;
+        goto FileTestEnd;
+    }
+
+    //
+    // Register the file and the buffer with the ring up front so the
+    // requests skip the descriptor lookup and buffer validation.
+    //
+
+    if (Test->TestType == PtTestRingFile) {
+        if (ioring_init(PT_IORING_BATCH_SIZE, &Ring, IORING_CLOEXEC) != 0) {
+            Result->Status = errno;
+            goto FileTestEnd;
+        }
+
+        RingCreated = 1;
+        if (ioring_register_files(&Ring, &FileDescriptor, 1) != 0) {
+            Result->Status = errno;
+            goto FileTestEnd;
+        }
+
+        RingBuffer.iov_base = Buffer;
+        RingBuffer.iov_len = PT_IORING_BLOCK_SIZE * PT_IORING_BATCH_SIZE;
+        if (ioring_register_buffers(&Ring, &RingBuffer, 1) != 0) {
+            Result->Status = errno;
+            goto FileTestEnd;
+        }
+    }
+
+    //
+    // Start the test. This snaps resource usage and starts the clock ticking.
+    //
+
+    Status = PtStartTimedTest(Test->Duration);
+    if (Status != 0) {
+        Result->Status = errno;
+        goto FileTestEnd;
+    }
+
+    Offset = 0;
+    while (PtIsTimedTestRunning() != 0) {
+
+        //
+        // Either read the batch one blocking call at a time, or queue the
+        // whole batch and submit it at once.
+        //
+
+        for (Index = 0; Index < PT_IORING_BATCH_SIZE; Index += 1) {
+            if (Test->TestType == PtTestBlockFile) {
+                do {
+                    BytesCompleted = pread(
+                                    FileDescriptor,
+                                    Buffer + (Index * PT_IORING_BLOCK_SIZE),
+                                    PT_IORING_BLOCK_SIZE,
+                                    Offset);
+
+                } while ((BytesCompleted < 0) && (errno == EINTR));
+
+                if (BytesCompleted != PT_IORING_BLOCK_SIZE) {
+                    if (BytesCompleted < 0) {
+                        Result->Status = errno;
+
+                    } else {
+                        Result->Status = EIO;
+                    }
+
+                    break;
+                }
+
+                TotalBytes += BytesCompleted;
+
+            } else {
+                Submission = ioring_get_sqe(&Ring);
+                if (Submission == NULL) {
+                    Result->Status = EBUSY;
+                    break;
+                }
+
+                ioring_prep_read(Submission,
+                                 0,
+                                 Buffer + (Index * PT_IORING_BLOCK_SIZE),
+                                 PT_IORING_BLOCK_SIZE,
+                                 Offset);
+
+                Submission->flags = IORING_SQE_FIXED_FILE |
+                                    IORING_SQE_FIXED_BUFFER;
+            }
+
+            Offset += PT_IORING_BLOCK_SIZE;
+            if (Offset == PT_IORING_FILE_SIZE) {
+                Offset = 0;
+            }
+        }
+
+        if (Result->Status != 0) {
+            break;
+        }
+
+        if (Test->TestType == PtTestRingFile) {
+            Status = ioring_submit(&Ring);
+            if (Status != PT_IORING_BATCH_SIZE) {
+                if (Status < 0) {
+                    Result->Status = errno;
+
+                } else {
+                    Result->Status = EIO;
+                }
+
+                break;
+            }
+
+            for (Index = 0; Index < PT_IORING_BATCH_SIZE; Index += 1) {
+                Status = PtpIoRingWaitForCompletion(&Ring, &Completion);
+                if (Status != 0) {
+                    Result->Status = Status;
+                    break;
+                }
+
+                if (Completion.result != PT_IORING_BLOCK_SIZE) {
+                    if (Completion.result < 0) {
+                        Result->Status = -Completion.result;
+
+                    } else {
+                        Result->Status = EIO;
+                    }
+
+                    break;
+                }
+
+                TotalBytes += Completion.result;
+            }
+
+            if (Result->Status != 0) {
+                break;
+            }
+        }
+    }
+
+    Status = PtFinishTimedTest(Result);
+    if ((Status != 0) && (Result->Status == 0)) {
+        Result->Status = errno;
+    }
+
+FileTestEnd:
+    if (RingCreated != 0) {
+        ioring_destroy(&Ring);
+    }
+
+    if (FileCreated != 0) {
+        close(FileDescriptor);
+        remove(FileName);
+    }
+
+    if (Buffer != NULL) {
+        free(Buffer);
+    }
+
+    Result->Data.Bytes = TotalBytes;
+    return;
+}
+
+void
+PtpIoRingSocketTest (
+    PPT_TEST_INFORMATION Test,
+    PPT_TEST_RESULT Result
+    )
+
+/*++
+
+Routine Description:
+
+    This routine measures how many bytes can be pushed through a loopback TCP
+    connection in batches of small sends, each batch drained by small
+    receives on the other end.
+
+Arguments:
+
+    Test - Supplies a pointer to the performance test being executed.
+
+    Result - Supplies a pointer to a performance test result structure that
+        receives the tests results.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    ssize_t BytesCompleted;
+    size_t BatchBytes;
+    int Client;
+    struct ioring_cqe Completion;
+    int Descriptors[2];
+    int Index;
+    size_t Received;
+    char *ReceiveBuffer;
+    struct ioring Ring;
+    struct iovec RingBuffers[2];
+    int RingCreated;
+    char *SendBuffer;
+    int Server;
+    size_t Size;
+    int Status;
+    struct ioring_sqe *Submission;
+    unsigned long long TotalBytes;
+
+    BatchBytes = PT_IORING_MESSAGE_SIZE * PT_IORING_BATCH_SIZE;
+    Client = -1;
+    RingCreated = 0;
+    Server = -1;
+    TotalBytes = 0;
+    ReceiveBuffer = malloc(BatchBytes);
+    SendBuffer = malloc(BatchBytes);
+    if ((ReceiveBuffer == NULL) || (SendBuffer == NULL)) {
+        Result->Status = ENOMEM;
+        goto SocketTestEnd;
+    }
+
+    memset(SendBuffer, 's', BatchBytes);
+    Status = PtpIoRingConnectSockets(&Client, &Server);
+    if (Status != 0) {
+        Result->Status = Status;
+        goto SocketTestEnd;
+    }
+
+    //
+    // The ring holds a batch of sends and a batch of receives at once.
+    //
+
+    if (Test->TestType == PtTestRingSocket) {
+        if (ioring_init(PT_IORING_BATCH_SIZE * 2, &Ring, IORING_CLOEXEC) != 0) {
+            Result->Status = errno;
+            goto SocketTestEnd;
+        }
+
+        RingCreated = 1;
+        Descriptors[PT_IORING_CLIENT_INDEX] = Client;
+        Descriptors[PT_IORING_SERVER_INDEX] = Server;
+        if (ioring_register_files(&Ring, Descriptors, 2) != 0) {
+            Result->Status = errno;
+            goto SocketTestEnd;
+        }
+
+        RingBuffers[PT_IORING_CLIENT_INDEX].iov_base = SendBuffer;
+        RingBuffers[PT_IORING_CLIENT_INDEX].iov_len = BatchBytes;
+        RingBuffers[PT_IORING_SERVER_INDEX].iov_base = ReceiveBuffer;
+        RingBuffers[PT_IORING_SERVER_INDEX].iov_len = BatchBytes;
+        if (ioring_register_buffers(&Ring, RingBuffers, 2) != 0) {
+            Result->Status = errno;
+            goto SocketTestEnd;
+        }
+    }
+
+    //
+    // Start the test. This snaps resource usage and starts the clock ticking.
+    //
+
+    Status = PtStartTimedTest(Test->Duration);
+    if (Status != 0) {
+        Result->Status = errno;
+        goto SocketTestEnd;
+    }
+
+    while (PtIsTimedTestRunning() != 0) {
+        Received = 0;
+
+        //
+        // Send the batch and receive it back one blocking call at a time.
+        //
+
+        if (Test->TestType == PtTestBlockSocket) {
+            for (Index = 0; Index < PT_IORING_BATCH_SIZE; Index += 1) {
+                Size = Index * PT_IORING_MESSAGE_SIZE;
+                do {
+                    BytesCompleted = send(Client,
+                                          SendBuffer + Size,
+                                          PT_IORING_MESSAGE_SIZE,
+                                          0);
+
+                } while ((BytesCompleted < 0) && (errno == EINTR));
+
+                if (BytesCompleted != PT_IORING_MESSAGE_SIZE) {
+                    if (BytesCompleted < 0) {
+                        Result->Status = errno;
+
+                    } else {
+                        Result->Status = EIO;
+                    }
+
+                    break;
+                }
+            }
+
+        //
+        // Queue the batch of sends and an equal batch of receives, and submit
+        // them together. Receives that find no data yet are held by the ring
+        // until the sends arrive.
+        //
+
+        } else {
+            for (Index = 0; Index < PT_IORING_BATCH_SIZE * 2; Index += 1) {
+                Submission = ioring_get_sqe(&Ring);
+                if (Submission == NULL) {
+                    Result->Status = EBUSY;
+                    break;
+                }
+
+                Size = (Index % PT_IORING_BATCH_SIZE) * PT_IORING_MESSAGE_SIZE;
+                if (Index < PT_IORING_BATCH_SIZE) {
+                    ioring_prep_send(Submission,
+                                     PT_IORING_CLIENT_INDEX,
+                                     SendBuffer + Size,
+                                     PT_IORING_MESSAGE_SIZE,
+                                     0);
+
+                    Submission->buffer_index = PT_IORING_CLIENT_INDEX;
+
+                } else {
+                    ioring_prep_recv(Submission,
+                                     PT_IORING_SERVER_INDEX,
+                                     ReceiveBuffer + Size,
+                                     PT_IORING_MESSAGE_SIZE,
+                                     0);
+
+                    Submission->buffer_index = PT_IORING_SERVER_INDEX;
+                }
+
+                Submission->user_data = Submission->opcode;
+                Submission->flags = IORING_SQE_FIXED_FILE |
+                                    IORING_SQE_FIXED_BUFFER;
+            }
+
+            if (Result->Status != 0) {
+                break;
+            }
+
+            Status = ioring_submit(&Ring);
+            if (Status != PT_IORING_BATCH_SIZE * 2) {
+                if (Status < 0) {
+                    Result->Status = errno;
+
+                } else {
+                    Result->Status = EIO;
+                }
+
+                break;
+            }
+
+            for (Index = 0; Index < PT_IORING_BATCH_SIZE * 2; Index += 1) {
+                Status = PtpIoRingWaitForCompletion(&Ring, &Completion);
+                if (Status != 0) {
+                    Result->Status = Status;
+                    break;
+                }
+
+                if ((Completion.result <= 0) ||
+                    ((Completion.user_data == IORING_OP_SEND) &&
+                     (Completion.result != PT_IORING_MESSAGE_SIZE))) {
+
+                    if (Completion.result < 0) {
+                        Result->Status = -Completion.result;
+
+                    } else {
+                        Result->Status = EIO;
+                    }
+
+                    break;
+                }
+
+                if (Completion.user_data == IORING_OP_RECV) {
+                    Received += Completion.result;
+                }
+            }
+        }
+
+        if (Result->Status != 0) {
+            break;
+        }
+
+        //
+        // Drain whatever is left of the batch in message sized receives. For
+        // the ring this only happens when the stream delivered some messages
+        // short.
+        //
+
+        while (Received < BatchBytes) {
+            Size = BatchBytes - Received;
+            if (Size > PT_IORING_MESSAGE_SIZE) {
+                Size = PT_IORING_MESSAGE_SIZE;
+            }
+
+            if (Test->TestType == PtTestBlockSocket) {
+                do {
+                    BytesCompleted = recv(Server,
+                                          ReceiveBuffer + Received,
+                                          Size,
+                                          0);
+
+                } while ((BytesCompleted < 0) && (errno == EINTR));
+
+                if (BytesCompleted <= 0) {
+                    if (BytesCompleted < 0) {
+                        Result->Status = errno;
+
+                    } else {
+                        Result->Status = EIO;
+                    }
+
+                    break;
+                }
+
+            } else {
+                Submission = ioring_get_sqe(&Ring);
+                if (Submission == NULL) {
+                    Result->Status = EBUSY;
+                    break;
+                }
+
+                ioring_prep_recv(Submission,
+                                 PT_IORING_SERVER_INDEX,
+                                 ReceiveBuffer + Received,
+                                 Size,
+                                 0);
+
+                Submission->flags = IORING_SQE_FIXED_FILE;
+                if (ioring_submit(&Ring) != 1) {
+                    Result->Status = errno;
+                    break;
+                }
+
+                Status = PtpIoRingWaitForCompletion(&Ring, &Completion);
+                if (Status != 0) {
+                    Result->Status = Status;
+                    break;
+                }
+
+                if (Completion.result <= 0) {
+                    if (Completion.result < 0) {
+                        Result->Status = -Completion.result;
+
+                    } else {
+                        Result->Status = EIO;
+                    }
+
+                    break;
+                }
+
+                BytesCompleted = Completion.result;
+            }
+
+            Received += BytesCompleted;
+        }
+
+        if (Result->Status != 0) {
+            break;
+        }
+
+        TotalBytes += Received;
+    }
+
+    Status = PtFinishTimedTest(Result);
+    if ((Status != 0) && (Result->Status == 0)) {
+        Result->Status = errno;
+    }
+
+SocketTestEnd:
+    if (RingCreated != 0) {
+        ioring_destroy(&Ring);
+    }
+
+    if (Client >= 0) {
+        close(Client);
+    }
+
+    if (Server >= 0) {
+        close(Server);
+    }
+
+    if (ReceiveBuffer != NULL) {
+        free(ReceiveBuffer);
+    }
+
+    if (SendBuffer != NULL) {
+        free(SendBuffer);
+    }
+
+    Result->Data.Bytes = TotalBytes;
+    return;
+}
+
+int
+PtpIoRingConnectSockets (
+    int *Client,
+    int *Server
+    )
+
+/*++
+
+Routine Description:
+
+    This routine creates a connected pair of TCP sockets over the loopback
+    interface.
+
+Arguments:
+
+    Client - Supplies a pointer where the connecting socket will be returned.
+
+    Server - Supplies a pointer where the accepted socket will be returned.
+
+Return Value:
+
+    0 on success.
+
+    Returns an error number on failure.
+
+--*/
+
+{
+
+    struct sockaddr_in Address;
+    socklen_t AddressLength;
+    int Listener;
+    int Option;
+    int Status;
+
+    Listener = socket(AF_INET, SOCK_STREAM, 0);
+    if (Listener < 0) {
+        return errno;
+    }
+
+    //
+    // Bind to any free port on the loopback address and find out which one
+    // was picked.
+    //
+
+    memset(&Address, 0, sizeof(Address));
+    Address.sin_family = AF_INET;
+    Address.sin_port = 0;
+    Address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    Status = bind(Listener, (struct sockaddr *)&Address, sizeof(Address));
+    if (Status != 0) {
+        Status = errno;
+        goto ConnectSocketsEnd;
+    }
+
+    if (listen(Listener, 1) != 0) {
+        Status = errno;
+        goto ConnectSocketsEnd;
+    }
+
+    AddressLength = sizeof(Address);
+    Status = getsockname(Listener,
+                         (struct sockaddr *)&Address,
+                         &AddressLength);
+
+    if (Status != 0) {
+        Status = errno;
+        goto ConnectSocketsEnd;
+    }
+
+    *Client = socket(AF_INET, SOCK_STREAM, 0);
+    if (*Client < 0) {
+        Status = errno;
+        goto ConnectSocketsEnd;
+    }
+
+    //
+    // Small messages would otherwise sit waiting to be coalesced.
+    //
+
+    Option = 1;
+    setsockopt(*Client, IPPROTO_TCP, TCP_NODELAY, &Option, sizeof(Option));
+    Status = connect(*Client, (struct sockaddr *)&Address, sizeof(Address));
+    if (Status != 0) {
+        Status = errno;
+        goto ConnectSocketsEnd;
+    }
+
+    *Server = accept(Listener, NULL, NULL);
+    if (*Server < 0) {
+        Status = errno;
+        goto ConnectSocketsEnd;
+    }
+
+    Status = 0;
+
+ConnectSocketsEnd:
+    close(Listener);
+    return Status;
+}
+
+int
+PtpIoRingWaitForCompletion (
+    struct ioring *Ring,
+    struct ioring_cqe *Completion
+    )
+
+/*++
+
+Routine Description:
+
+    This routine waits for the next completion on the ring, copies it out,
+    and releases its slot.
+
+Arguments:
+
+    Ring - Supplies a pointer to the ring.
+
+    Completion - Supplies a pointer where the completion will be returned.
+
+Return Value:
+
+    0 on success.
+
+    Returns an error number on failure.
+
+--*/
+
+{
+
+    struct ioring_cqe *Entry;
+    int Status;
+
+    do {
+        Status = ioring_wait_cqe(Ring, &Entry);
+
+    } while ((Status < 0) && (errno == EINTR));
+
+    if (Status != 0) {
+        return errno;
+    }
+
+    *Completion = *Entry;
+    ioring_cqe_seen(Ring, Entry);
+    return 0;
+}
+
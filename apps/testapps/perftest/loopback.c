@@ -0,0 +1,612 @@
+/*++
+
+Copyright (c) 2026 Minoca Corp.
+
+    This file is licensed under the terms of the GNU General Public License
+    version 3. Alternative licensing terms are available. Contact
+    info@minocacorp.com for details. See the LICENSE file at the root of this
+    project for complete licensing information.
+
+Module Name:
+
+    loopback.c
+
+Abstract:
+
+    This module implements the performance benchmark tests for TCP and UDP
+    throughput and round trip latency over the loopback link.
+
+Author:
+
+    Minoca Corp. 18-Oct-2026
+
+Environment:
+
+    User
+
+--*/
+
+//
+// ------------------------------------------------------------------- Includes
+//
+
+#include <arpa/inet.h>
+#include <assert.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include "perftest.h"
+
+//
+// ---------------------------------------------------------------- Definitions
+//
+
+//
+// Define the number of bytes pushed through the TCP connection per stream
+// iteration. One thread both sends and receives, so this has to fit in the
+// socket buffers.
+//
+
+#define PT_LOOPBACK_STREAM_SIZE (32 * 1024)
+
+//
+// Define the size and number of datagrams sent per UDP stream iteration.
+//
+
+#define PT_LOOPBACK_DATAGRAM_SIZE 1024
+#define PT_LOOPBACK_DATAGRAM_BATCH 16
+
+//
+// Define how long to wait for a datagram before deciding it was dropped, in
+// seconds.
+//
+
+#define PT_LOOPBACK_RECEIVE_TIMEOUT 5
+
+//
+// ------------------------------------------------------ Data Type Definitions
+//
+
+//
+// ----------------------------------------------- Internal Function Prototypes
+//
+
+int
+PtpLoopbackConnectTcp (
+    int *Client,
+    int *Server
+    );
+
+int
+PtpLoopbackConnectUdp (
+    int *Client,
+    int *Server
+    );
+
+int
+PtpLoopbackSend (
+    int Socket,
+    const char *Buffer,
+    size_t Size
+    );
+
+int
+PtpLoopbackReceive (
+    int Socket,
+    char *Buffer,
+    size_t Size,
+    int Stream
+    );
+
+//
+// -------------------------------------------------------------------- Globals
+//
+
+//
+// ------------------------------------------------------------------ Functions
+//
+
+void
+LoopbackMain (
+    PPT_TEST_INFORMATION Test,
+    PPT_TEST_RESULT Result
+    )
+
+/*++
+
+Routine Description:
+
+    This routine performs the loopback network performance benchmark tests.
+    Each iteration sends data from one socket to its peer and receives it
+    there. The latency tests then send a reply back, so each iteration is one
+    round trip.
+
+Arguments:
+
+    Test - Supplies a pointer to the performance test being executed.
+
+    Result - Supplies a pointer to a performance test result structure that
+        receives the tests results.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    char *Buffer;
+    unsigned long long Bytes;
+    int Client;
+    int Count;
+    int Index;
+    unsigned long long Iterations;
+    int Reply;
+    int Server;
+    size_t Size;
+    int Status;
+    int Stream;
+
+    assert((Test->TestType == PtTestTcpStream) ||
+           (Test->TestType == PtTestTcpLatency) ||
+           (Test->TestType == PtTestUdpStream) ||
+           (Test->TestType == PtTestUdpLatency));
+
+    Bytes = 0;
+    Client = -1;
+    Iterations = 0;
+    Server = -1;
+    Result->Status = 0;
+    Count = 1;
+    Reply = 0;
+    Size = 1;
+    Stream = 1;
+    Result->Type = PtResultIterations;
+    switch (Test->TestType) {
+    case PtTestTcpStream:
+        Size = PT_LOOPBACK_STREAM_SIZE;
+        Result->Type = PtResultBytes;
+        break;
+
+    case PtTestTcpLatency:
+        Reply = 1;
+        break;
+
+    case PtTestUdpStream:
+        Count = PT_LOOPBACK_DATAGRAM_BATCH;
+        Size = PT_LOOPBACK_DATAGRAM_SIZE;
+        Stream = 0;
+        Result->Type = PtResultBytes;
+        break;
+
+    case PtTestUdpLatency:
+    default:
+        Reply = 1;
+        Stream = 0;
+        break;
+    }
+
+    Buffer = malloc(Size);
+    if (Buffer == NULL) {
+        Result->Status = ENOMEM;
+        goto MainEnd;
+    }
+
+    memset(Buffer, 'L', Size);
+    if (Stream != 0) {
+        Status = PtpLoopbackConnectTcp(&Client, &Server);
+
+    } else {
+        Status = PtpLoopbackConnectUdp(&Client, &Server);
+    }
+
+    if (Status != 0) {
+        Result->Status = Status;
+        goto MainEnd;
+    }
+
+    //
+    // Start the test. This snaps resource usage and starts the clock ticking.
+    //
+
+    Status = PtStartTimedTest(Test->Duration);
+    if (Status != 0) {
+        Result->Status = errno;
+        goto MainEnd;
+    }
+
+    while (PtIsTimedTestRunning() != 0) {
+        for (Index = 0; Index < Count; Index += 1) {
+            Status = PtpLoopbackSend(Client, Buffer, Size);
+            if (Status != 0) {
+                break;
+            }
+        }
+
+        for (Index = 0; (Status == 0) && (Index < Count); Index += 1) {
+            Status = PtpLoopbackReceive(Server, Buffer, Size, Stream);
+        }
+
+        if ((Status == 0) && (Reply != 0)) {
+            Status = PtpLoopbackSend(Server, Buffer, Size);
+            if (Status == 0) {
+                Status = PtpLoopbackReceive(Client, Buffer, Size, Stream);
+            }
+        }
+
+        if (Status != 0) {
+            Result->Status = Status;
+            break;
+        }
+
+        Bytes += Size * Count;
+        Iterations += 1;
+    }
+
+    Status = PtFinishTimedTest(Result);
+    if ((Status != 0) && (Result->Status == 0)) {
+        Result->Status = errno;
+    }
+
+MainEnd:
+    if (Client >= 0) {
+        close(Client);
+    }
+
+    if (Server >= 0) {
+        close(Server);
+    }
+
+    if (Buffer != NULL) {
+        free(Buffer);
+    }
+
+    if (Result->Type == PtResultBytes) {
+        Result->Data.Bytes = Bytes;
+
+    } else {
+        Result->Data.Iterations = Iterations;
+    }
+
+    return;
+}
+
+//
+// --------------------------------------------------------- Internal Functions
+//
+
+int
+PtpLoopbackConnectTcp (
+    int *Client,
+    int *Server
+    )
+
+/*++
+
+Routine Description:
+
+    This routine creates a connected pair of TCP sockets over the loopback
+    link.
+
+Arguments:
+
+    Client - Supplies a pointer where the connecting socket will be returned.
+
+    Server - Supplies a pointer where the accepted socket will be returned.
+
+Return Value:
+
+    0 on success.
+
+    Returns an error number on failure.
+
+--*/
+
+{
+
+    struct sockaddr_in Address;
+    socklen_t AddressLength;
+    int Listener;
+    int Option;
+    int Status;
+
+    Listener = socket(AF_INET, SOCK_STREAM, 0);
+    if (Listener < 0) {
+        return errno;
+    }
+
+    //
+    // Bind to any free port on the loopback address and find out which one
+    // was picked.
+    //
+
+    memset(&Address, 0, sizeof(Address));
+    Address.sin_family = AF_INET;
+    Address.sin_port = 0;
+    Address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    Status = bind(Listener, (struct sockaddr *)&Address, sizeof(Address));
+    if (Status != 0) {
+        Status = errno;
+        goto ConnectTcpEnd;
+    }
+
+    if (listen(Listener, 1) != 0) {
+        Status = errno;
+        goto ConnectTcpEnd;
+    }
+
+    AddressLength = sizeof(Address);
+    Status = getsockname(Listener,
+                         (struct sockaddr *)&Address,
+                         &AddressLength);
+
+    if (Status != 0) {
+        Status = errno;
+        goto ConnectTcpEnd;
+    }
+
+    *Client = socket(AF_INET, SOCK_STREAM, 0);
+    if (*Client < 0) {
+        Status = errno;
+        goto ConnectTcpEnd;
+    }
+
+    Status = connect(*Client, (struct sockaddr *)&Address, sizeof(Address));
+    if (Status != 0) {
+        Status = errno;
+        goto ConnectTcpEnd;
+    }
+
+    *Server = accept(Listener, NULL, NULL);
+    if (*Server < 0) {
+        Status = errno;
+        goto ConnectTcpEnd;
+    }
+
+    //
+    // The latency test sends single bytes, which would otherwise sit waiting
+    // to be coalesced.
+    //
+
+    Option = 1;
+    setsockopt(*Client, IPPROTO_TCP, TCP_NODELAY, &Option, sizeof(Option));
+    setsockopt(*Server, IPPROTO_TCP, TCP_NODELAY, &Option, sizeof(Option));
+    Status = 0;
+
+ConnectTcpEnd:
+    close(Listener);
+    return Status;
+}
+
+int
+PtpLoopbackConnectUdp (
+    int *Client,
+    int *Server
+    )
+
+/*++
+
+Routine Description:
+
+    This routine creates a pair of UDP sockets on the loopback link, each
+    connected to the other.
+
+Arguments:
+
+    Client - Supplies a pointer where the first socket will be returned.
+
+    Server - Supplies a pointer where the second socket will be returned.
+
+Return Value:
+
+    0 on success.
+
+    Returns an error number on failure.
+
+--*/
+
+{
+
+    struct sockaddr_in Addresses[2];
+    socklen_t AddressLength;
+    int Index;
+    int Sockets[2];
+    int Status;
+    struct timeval Timeout;
+
+    Sockets[0] = -1;
+    Sockets[1] = -1;
+    for (Index = 0; Index < 2; Index += 1) {
+        Sockets[Index] = socket(AF_INET, SOCK_DGRAM, 0);
+        if (Sockets[Index] < 0) {
+            Status = errno;
+            goto ConnectUdpEnd;
+        }
+
+        memset(&(Addresses[Index]), 0, sizeof(struct sockaddr_in));
+        Addresses[Index].sin_family = AF_INET;
+        Addresses[Index].sin_port = 0;
+        Addresses[Index].sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        Status = bind(Sockets[Index],
+                      (struct sockaddr *)&(Addresses[Index]),
+                      sizeof(struct sockaddr_in));
+
+        if (Status != 0) {
+            Status = errno;
+            goto ConnectUdpEnd;
+        }
+
+        AddressLength = sizeof(struct sockaddr_in);
+        Status = getsockname(Sockets[Index],
+                             (struct sockaddr *)&(Addresses[Index]),
+                             &AddressLength);
+
+        if (Status != 0) {
+            Status = errno;
+            goto ConnectUdpEnd;
+        }
+
+        //
+        // Fail rather than hang if a datagram goes missing.
+        //
+
+        Timeout.tv_sec = PT_LOOPBACK_RECEIVE_TIMEOUT;
+        Timeout.tv_usec = 0;
+        setsockopt(Sockets[Index],
+                   SOL_SOCKET,
+                   SO_RCVTIMEO,
+                   &Timeout,
+                   sizeof(Timeout));
+    }
+
+    for (Index = 0; Index < 2; Index += 1) {
+        Status = connect(Sockets[Index],
+                         (struct sockaddr *)&(Addresses[1 - Index]),
+                         sizeof(struct sockaddr_in));
+
+        if (Status != 0) {
+            Status = errno;
+            goto ConnectUdpEnd;
+        }
+    }
+
+    *Client = Sockets[0];
+    *Server = Sockets[1];
+    Sockets[0] = -1;
+    Sockets[1] = -1;
+    Status = 0;
+
+ConnectUdpEnd:
+    for (Index = 0; Index < 2; Index += 1) {
+        if (Sockets[Index] >= 0) {
+            close(Sockets[Index]);
+        }
+    }
+
+    return Status;
+}
+
+int
+PtpLoopbackSend (
+    int Socket,
+    const char *Buffer,
+    size_t Size
+    )
+
+/*++
+
+Routine Description:
+
+    This routine sends an entire buffer on a connected socket.
+
+Arguments:
+
+    Socket - Supplies the socket to send on.
+
+    Buffer - Supplies a pointer to the data to send.
+
+    Size - Supplies the number of bytes to send.
+
+Return Value:
+
+    0 on success.
+
+    Returns an error number on failure.
+
+--*/
+
+{
+
+    ssize_t BytesCompleted;
+
+    while (Size != 0) {
+        do {
+            BytesCompleted = send(Socket, Buffer, Size, MSG_NOSIGNAL);
+
+        } while ((BytesCompleted < 0) && (errno == EINTR));
+
+        if (BytesCompleted <= 0) {
+            if (BytesCompleted == 0) {
+                return EIO;
+            }
+
+            return errno;
+        }
+
+        Buffer += BytesCompleted;
+        Size -= BytesCompleted;
+    }
+
+    return 0;
+}
+
+int
+PtpLoopbackReceive (
+    int Socket,
+    char *Buffer,
+    size_t Size,
+    int Stream
+    )
+
+/*++
+
+Routine Description:
+
+    This routine receives data on a connected socket.
+
+Arguments:
+
+    Socket - Supplies the socket to receive on.
+
+    Buffer - Supplies a pointer where the data will be returned.
+
+    Size - Supplies the number of bytes to receive.
+
+    Stream - Supplies a non-zero value if this is a stream socket, in which
+        case receives continue until the given number of bytes arrive.
+        Otherwise a single datagram of exactly the given size is expected.
+
+Return Value:
+
+    0 on success.
+
+    Returns an error number on failure.
+
+--*/
+
+{
+
+    ssize_t BytesCompleted;
+
+    while (Size != 0) {
+        do {
+            BytesCompleted = recv(Socket, Buffer, Size, 0);
+
+        } while ((BytesCompleted < 0) && (errno == EINTR));
+
+        if (BytesCompleted <= 0) {
+            if (BytesCompleted == 0) {
+                return EIO;
+            }
+
+            return errno;
+        }
+
+        if ((Stream == 0) && ((size_t)BytesCompleted != Size)) {
+            return EIO;
+        }
+
+        Buffer += BytesCompleted;
+        Size -= BytesCompleted;
+    }
+
+    return 0;
+}
+
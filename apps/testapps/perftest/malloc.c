@@ -49,6 +49,14 @@ Module Name:
 #define PT_MALLOC_TEST_ALLOCATION_COUNT 32
 #define PT_MALLOC_TEST_THREAD_COUNT 8
 
+//
+// Define the largest random size used by the small allocation tests, and the
+// number of slots threads trade allocations through in the remote free test.
+//
+
+#define PT_MALLOC_TEST_SMALL_ALLOCATION_LIMIT 512
+#define PT_MALLOC_TEST_SHARED_SLOT_COUNT 256
+
 //
 // ------------------------------------------------------ Data Type Definitions
 //
@@ -62,12 +70,31 @@ MallocStartRoutine (
     void *Parameter
     );
 
+int
+MallocTradeAllocation (
+    size_t AllocationSize,
+    unsigned int *Seed
+    );
+
 //
 // -------------------------------------------------------------------- Globals
 //
 
 volatile int MallocReadyThreadCount;
 
+//
+// Store the test type and allocation size limit for the worker threads.
+//
+
+PT_TEST_TYPE MallocTestType;
+size_t MallocSizeLimit = PT_MALLOC_TEST_ALLOCATION_LIMIT;
+
+//
+// Store the slots threads trade allocations through in the remote free test.
+//
+
+void *MallocSharedSlots[PT_MALLOC_TEST_SHARED_SLOT_COUNT];
+
 //
 // ------------------------------------------------------------------ Functions
 //
@@ -145,7 +172,16 @@ Return Value:
         AllocationSize = PT_MALLOC_TEST_LARGE_ALLOCATION;
         break;
 
+    case PtTestMallocSmallContended:
+    case PtTestMallocRemoteFree:
+        MallocSizeLimit = PT_MALLOC_TEST_SMALL_ALLOCATION_LIMIT;
+
+        //
+        // Fall through.
+        //
+
     case PtTestMallocContended:
+        MallocTestType = Test->TestType;
         Threads = malloc(sizeof(pthread_t) * PT_MALLOC_TEST_THREAD_COUNT);
         if (Threads == NULL) {
             Result->Status = ENOMEM;
@@ -215,7 +251,18 @@ Return Value:
 
     while (PtIsTimedTestRunning() != 0) {
         if (RandomSize != 0) {
-            AllocationSize = rand_r(&Seed) % PT_MALLOC_TEST_ALLOCATION_LIMIT;
+            AllocationSize = rand_r(&Seed) % MallocSizeLimit;
+        }
+
+        if (Test->TestType == PtTestMallocRemoteFree) {
+            Status = MallocTradeAllocation(AllocationSize, &Seed);
+            if (Status != 0) {
+                Result->Status = Status;
+                break;
+            }
+
+            Iterations += 1;
+            continue;
         }
 
         //
@@ -247,6 +294,8 @@ Return Value:
 MainEnd:
     switch (Test->TestType) {
     case PtTestMallocContended:
+    case PtTestMallocSmallContended:
+    case PtTestMallocRemoteFree:
         if (Threads != NULL) {
             ThreadCount = ThreadIndex;
             for (ThreadIndex = 0; ThreadIndex < ThreadCount; ThreadIndex += 1) {
@@ -260,6 +309,13 @@ Return Value:
             free(Threads);
         }
 
+        for (Index = 0; Index < PT_MALLOC_TEST_SHARED_SLOT_COUNT; Index += 1) {
+            if (MallocSharedSlots[Index] != NULL) {
+                free(MallocSharedSlots[Index]);
+                MallocSharedSlots[Index] = NULL;
+            }
+        }
+
         break;
 
     case PtTestMallocSmall:
@@ -298,7 +354,9 @@ Routine Description:
 
     This routine implements the start routine for a new test thread. It will
     wait in a loop for the test to start and then loop allocating and freeing
-    memory regions of random size.
+    memory regions of random size. In the remote free test, allocations are
+    traded with other threads so that most frees are of memory some other
+    thread allocated.
 
 Arguments:
 
@@ -318,6 +376,7 @@ Return Value:
     int Index;
     pthread_mutex_t *Mutex;
     unsigned int Seed;
+    int Status;
 
     AllocationSize = sizeof(void *) * PT_MALLOC_TEST_ALLOCATION_COUNT;
     Allocations = malloc(AllocationSize);
@@ -350,7 +409,15 @@ Return Value:
     //
 
     while (PtIsTimedTestRunning() != 0) {
-        AllocationSize = rand_r(&Seed) % PT_MALLOC_TEST_ALLOCATION_LIMIT;
+        AllocationSize = rand_r(&Seed) % MallocSizeLimit;
+        if (MallocTestType == PtTestMallocRemoteFree) {
+            Status = MallocTradeAllocation(AllocationSize, &Seed);
+            if (Status != 0) {
+                break;
+            }
+
+            continue;
+        }
 
         //
         // Pick a random allocation slot and either make an allocation if it is
@@ -380,3 +447,53 @@ Return Value:
     return (void *)0;
 }
 
+int
+MallocTradeAllocation (
+    size_t AllocationSize,
+    unsigned int *Seed
+    )
+
+/*++
+
+Routine Description:
+
+    This routine allocates a block of memory, swaps it into a random shared
+    slot, and frees whatever allocation was in the slot before, which was most
+    likely made by a different thread.
+
+Arguments:
+
+    AllocationSize - Supplies the size of the allocation to make.
+
+    Seed - Supplies a pointer to the thread's random seed.
+
+Return Value:
+
+    0 on success.
+
+    ENOMEM if the allocation failed.
+
+--*/
+
+{
+
+    void *Allocation;
+    int Index;
+
+    Allocation = malloc(AllocationSize);
+    if (Allocation == NULL) {
+        return ENOMEM;
+    }
+
+    Index = rand_r(Seed) % PT_MALLOC_TEST_SHARED_SLOT_COUNT;
+    Allocation = __atomic_exchange_n(&(MallocSharedSlots[Index]),
+                                     Allocation,
+                                     __ATOMIC_ACQ_REL);
+
+    if (Allocation != NULL) {
+        free(Allocation);
+    }
+
+    return 0;
+}
+
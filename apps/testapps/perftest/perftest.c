@@ -351,6 +351,20 @@ PT_TEST_INFORMATION PerformanceTests[PtTestTypeCount] = {
      PtResultIterations,
      MALLOC_CONTENDED_TEST_DEFAULT_DURATION},
 
+    {MALLOC_SMALL_CONTENDED_TEST_NAME,
+     MALLOC_SMALL_CONTENDED_TEST_DESCRIPTION,
+     MallocMain,
+     PtTestMallocSmallContended,
+     PtResultIterations,
+     MALLOC_SMALL_CONTENDED_TEST_DEFAULT_DURATION},
+
+    {MALLOC_REMOTE_FREE_TEST_NAME,
+     MALLOC_REMOTE_FREE_TEST_DESCRIPTION,
+     MallocMain,
+     PtTestMallocRemoteFree,
+     PtResultIterations,
+     MALLOC_REMOTE_FREE_TEST_DEFAULT_DURATION},
+
     {PTHREAD_JOIN_TEST_NAME,
      PTHREAD_JOIN_TEST_DESCRIPTION,
      PthreadMain,
@@ -413,6 +427,90 @@ PT_TEST_INFORMATION PerformanceTests[PtTestTypeCount] = {
      PtTestSignalRestart,
      PtResultIterations,
      SIGNAL_RESTART_DEFAULT_DURATION},
+
+    {POLL_TEST_NAME,
+     POLL_TEST_DESCRIPTION,
+     PollMain,
+     PtTestPoll,
+     PtResultIterations,
+     POLL_TEST_DEFAULT_DURATION},
+
+    {EPOLL_TEST_NAME,
+     EPOLL_TEST_DESCRIPTION,
+     PollMain,
+     PtTestEpoll,
+     PtResultIterations,
+     EPOLL_TEST_DEFAULT_DURATION},
+
+    {BLOCK_FILE_TEST_NAME,
+     BLOCK_FILE_TEST_DESCRIPTION,
+     IoRingMain,
+     PtTestBlockFile,
+     PtResultBytes,
+     BLOCK_FILE_TEST_DEFAULT_DURATION},
+
+    {RING_FILE_TEST_NAME,
+     RING_FILE_TEST_DESCRIPTION,
+     IoRingMain,
+     PtTestRingFile,
+     PtResultBytes,
+     RING_FILE_TEST_DEFAULT_DURATION},
+
+    {BLOCK_SOCKET_TEST_NAME,
+     BLOCK_SOCKET_TEST_DESCRIPTION,
+     IoRingMain,
+     PtTestBlockSocket,
+     PtResultBytes,
+     BLOCK_SOCKET_TEST_DEFAULT_DURATION},
+
+    {RING_SOCKET_TEST_NAME,
+     RING_SOCKET_TEST_DESCRIPTION,
+     IoRingMain,
+     PtTestRingSocket,
+     PtResultBytes,
+     RING_SOCKET_TEST_DEFAULT_DURATION},
+
+    {CLOCK_MONOTONIC_TEST_NAME,
+     CLOCK_MONOTONIC_TEST_DESCRIPTION,
+     ClockMain,
+     PtTestClockMonotonic,
+     PtResultIterations,
+     CLOCK_MONOTONIC_TEST_DEFAULT_DURATION},
+
+    {CLOCK_REALTIME_TEST_NAME,
+     CLOCK_REALTIME_TEST_DESCRIPTION,
+     ClockMain,
+     PtTestClockRealtime,
+     PtResultIterations,
+     CLOCK_REALTIME_TEST_DEFAULT_DURATION},
+
+    {TCP_STREAM_TEST_NAME,
+     TCP_STREAM_TEST_DESCRIPTION,
+     LoopbackMain,
+     PtTestTcpStream,
+     PtResultBytes,
+     TCP_STREAM_TEST_DEFAULT_DURATION},
+
+    {TCP_LATENCY_TEST_NAME,
+     TCP_LATENCY_TEST_DESCRIPTION,
+     LoopbackMain,
+     PtTestTcpLatency,
+     PtResultIterations,
+     TCP_LATENCY_TEST_DEFAULT_DURATION},
+
+    {UDP_STREAM_TEST_NAME,
+     UDP_STREAM_TEST_DESCRIPTION,
+     LoopbackMain,
+     PtTestUdpStream,
+     PtResultBytes,
+     UDP_STREAM_TEST_DEFAULT_DURATION},
+
+    {UDP_LATENCY_TEST_NAME,
+     UDP_LATENCY_TEST_DESCRIPTION,
+     LoopbackMain,
+     PtTestUdpLatency,
+     PtResultIterations,
+     UDP_LATENCY_TEST_DEFAULT_DURATION},
 };
 
 //
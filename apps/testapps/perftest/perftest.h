@@ -109,6 +109,14 @@ Module Name:
 #define MALLOC_CONTENDED_TEST_DESCRIPTION \
     "Benchmarks malloc() and free() with multiple threads."
 
+#define MALLOC_SMALL_CONTENDED_TEST_NAME "malloc_small_contended"
+#define MALLOC_SMALL_CONTENDED_TEST_DESCRIPTION \
+    "Benchmarks small malloc() and free() calls with multiple threads."
+
+#define MALLOC_REMOTE_FREE_TEST_NAME "malloc_remote_free"
+#define MALLOC_REMOTE_FREE_TEST_DESCRIPTION \
+    "Benchmarks multiple threads freeing each other's small allocations."
+
 #define PTHREAD_JOIN_TEST_NAME "pthread_join"
 #define PTHREAD_JOIN_TEST_DESCRIPTION \
     "Benchmarks thread creation with pthread_join()."
@@ -145,6 +153,56 @@ Module Name:
 #define SIGNAL_RESTART_DESCRIPTION \
     "Benchmarks how many system call restarts can be made."
 
+#define POLL_TEST_NAME "poll"
+#define POLL_TEST_DESCRIPTION \
+    "Benchmarks finding one ready pipe among many with poll()."
+
+#define EPOLL_TEST_NAME "epoll"
+#define EPOLL_TEST_DESCRIPTION \
+    "Benchmarks finding one ready pipe among many with epoll_wait()."
+
+#define BLOCK_FILE_TEST_NAME "blkfile"
+#define BLOCK_FILE_TEST_DESCRIPTION \
+    "Benchmarks batches of cached file reads made with blocking pread()."
+
+#define RING_FILE_TEST_NAME "ringfile"
+#define RING_FILE_TEST_DESCRIPTION \
+    "Benchmarks batches of cached file reads submitted through an I/O ring."
+
+#define BLOCK_SOCKET_TEST_NAME "blksock"
+#define BLOCK_SOCKET_TEST_DESCRIPTION \
+    "Benchmarks batches of loopback TCP sends and receives made with " \
+    "blocking calls."
+
+#define RING_SOCKET_TEST_NAME "ringsock"
+#define RING_SOCKET_TEST_DESCRIPTION \
+    "Benchmarks batches of loopback TCP sends and receives submitted " \
+    "through an I/O ring."
+
+#define CLOCK_MONOTONIC_TEST_NAME "clockmono"
+#define CLOCK_MONOTONIC_TEST_DESCRIPTION \
+    "Benchmarks reading CLOCK_MONOTONIC with clock_gettime()."
+
+#define CLOCK_REALTIME_TEST_NAME "clockreal"
+#define CLOCK_REALTIME_TEST_DESCRIPTION \
+    "Benchmarks reading CLOCK_REALTIME with clock_gettime()."
+
+#define TCP_STREAM_TEST_NAME "tcpstream"
+#define TCP_STREAM_TEST_DESCRIPTION \
+    "Benchmarks TCP throughput over the loopback link."
+
+#define TCP_LATENCY_TEST_NAME "tcplatency"
+#define TCP_LATENCY_TEST_DESCRIPTION \
+    "Benchmarks TCP round trips over the loopback link."
+
+#define UDP_STREAM_TEST_NAME "udpstream"
+#define UDP_STREAM_TEST_DESCRIPTION \
+    "Benchmarks UDP throughput over the loopback link."
+
+#define UDP_LATENCY_TEST_NAME "udplatency"
+#define UDP_LATENCY_TEST_DESCRIPTION \
+    "Benchmarks UDP round trips over the loopback link."
+
 //
 // Default test durations, in seconds.
 //
@@ -171,6 +229,8 @@ Module Name:
 #define MALLOC_LARGE_TEST_DEFAULT_DURATION 30
 #define MALLOC_RANDOM_TEST_DEFAULT_DURATION 30
 #define MALLOC_CONTENDED_TEST_DEFAULT_DURATION 30
+#define MALLOC_SMALL_CONTENDED_TEST_DEFAULT_DURATION 30
+#define MALLOC_REMOTE_FREE_TEST_DEFAULT_DURATION 30
 #define PTHREAD_JOIN_TEST_DEFAULT_DURATION 30
 #define PTHREAD_DETACH_TEST_DEFAULT_DURATION 30
 #define MUTEX_TEST_DEFAULT_DURATION 30
@@ -180,6 +240,18 @@ Module Name:
 #define SIGNAL_IGNORED_DEFAULT_DURATION 30
 #define SIGNAL_HANDLED_DEFAULT_DURATION 30
 #define SIGNAL_RESTART_DEFAULT_DURATION 30
+#define POLL_TEST_DEFAULT_DURATION 30
+#define EPOLL_TEST_DEFAULT_DURATION 30
+#define BLOCK_FILE_TEST_DEFAULT_DURATION 30
+#define RING_FILE_TEST_DEFAULT_DURATION 30
+#define BLOCK_SOCKET_TEST_DEFAULT_DURATION 30
+#define RING_SOCKET_TEST_DEFAULT_DURATION 30
+#define CLOCK_MONOTONIC_TEST_DEFAULT_DURATION 10
+#define CLOCK_REALTIME_TEST_DEFAULT_DURATION 10
+#define TCP_STREAM_TEST_DEFAULT_DURATION 30
+#define TCP_LATENCY_TEST_DEFAULT_DURATION 30
+#define UDP_STREAM_TEST_DEFAULT_DURATION 30
+#define UDP_LATENCY_TEST_DEFAULT_DURATION 30
 
 //
 // Define the number of variables supplied to an iteration of the execute test
@@ -216,6 +288,8 @@ typedef enum _PT_TEST_TYPE {
     PtTestMallocLarge,
     PtTestMallocRandom,
     PtTestMallocContended,
+    PtTestMallocSmallContended,
+    PtTestMallocRemoteFree,
     PtTestPthreadJoin,
     PtTestPthreadDetach,
     PtTestMutex,
@@ -225,6 +299,18 @@ typedef enum _PT_TEST_TYPE {
     PtTestSignalIgnored,
     PtTestSignalHandled,
     PtTestSignalRestart,
+    PtTestPoll,
+    PtTestEpoll,
+    PtTestBlockFile,
+    PtTestRingFile,
+    PtTestBlockSocket,
+    PtTestRingSocket,
+    PtTestClockMonotonic,
+    PtTestClockRealtime,
+    PtTestTcpStream,
+    PtTestTcpLatency,
+    PtTestUdpStream,
+    PtTestUdpLatency,
     PtTestTypeCount
 } PT_TEST_TYPE, *PPT_TEST_TYPE;
 
@@ -1021,3 +1107,104 @@ Return Value:
 
 --*/
 
+void
+PollMain (
+    PPT_TEST_INFORMATION Test,
+    PPT_TEST_RESULT Result
+    );
+
+/*++
+
+Routine Description:
+
+    This routine performs the poll and epoll performance benchmark tests.
+
+Arguments:
+
+    Test - Supplies a pointer to the performance test being executed.
+
+    Result - Supplies a pointer to a performance test result structure that
+        receives the tests results.
+
+Return Value:
+
+    None.
+
+--*/
+
+void
+IoRingMain (
+    PPT_TEST_INFORMATION Test,
+    PPT_TEST_RESULT Result
+    );
+
+/*++
+
+Routine Description:
+
+    This routine performs the I/O ring and blocking I/O performance benchmark
+    tests.
+
+Arguments:
+
+    Test - Supplies a pointer to the performance test being executed.
+
+    Result - Supplies a pointer to a performance test result structure that
+        receives the tests results.
+
+Return Value:
+
+    None.
+
+--*/
+
+void
+ClockMain (
+    PPT_TEST_INFORMATION Test,
+    PPT_TEST_RESULT Result
+    );
+
+/*++
+
+Routine Description:
+
+    This routine performs the clock read performance benchmark tests.
+
+Arguments:
+
+    Test - Supplies a pointer to the performance test being executed.
+
+    Result - Supplies a pointer to a performance test result structure that
+        receives the tests results.
+
+Return Value:
+
+    None.
+
+--*/
+
+void
+LoopbackMain (
+    PPT_TEST_INFORMATION Test,
+    PPT_TEST_RESULT Result
+    );
+
+/*++
+
+Routine Description:
+
+    This routine performs the loopback network performance benchmark tests.
+
+Arguments:
+
+    Test - Supplies a pointer to the performance test being executed.
+
+    Result - Supplies a pointer to a performance test result structure that
+        receives the tests results.
+
+Return Value:
+
+    None.
+
+--*/
+
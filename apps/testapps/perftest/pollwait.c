@@ -0,0 +1,400 @@
+/*++
+
+Copyright (c) 2026 Minoca Corp.
+
+    This file is licensed under the terms of the GNU General Public License
+    version 3. Alternative licensing terms are available. Contact
+    info@minocacorp.com for details. See the LICENSE file at the root of this
+    project for complete licensing information.
+
+Module Name:
+
+    pollwait.c
+
+Abstract:
+
+    This module implements the performance benchmark tests that wait for one
+    ready descriptor among many, using either poll() or epoll_wait().
+
+Author:
+
+    Minoca Corp. 18-Oct-2026
+
+Environment:
+
+    User
+
+--*/
+
+//
+// ------------------------------------------------------------------- Includes
+//
+
+#include <errno.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/epoll.h>
+#include <unistd.h>
+
+#include "perftest.h"
+
+//
+// ---------------------------------------------------------------- Definitions
+//
+
+//
+// Define the number of pipes watched at once. Only one of them is ever ready,
+// so this is the ratio of idle descriptors to active ones.
+//
+
+#define PT_POLL_PIPE_COUNT 128
+
+//
+// ------------------------------------------------------ Data Type Definitions
+//
+
+//
+// ----------------------------------------------- Internal Function Prototypes
+//
+
+int
+PtpWaitForPoll (
+    struct pollfd *PollDescriptors,
+    int *ReadDescriptor
+    );
+
+int
+PtpWaitForEpoll (
+    int PollDescriptor,
+    int *ReadDescriptor
+    );
+
+//
+// -------------------------------------------------------------------- Globals
+//
+
+//
+// ------------------------------------------------------------------ Functions
+//
+
+void
+PollMain (
+    PPT_TEST_INFORMATION Test,
+    PPT_TEST_RESULT Result
+    )
+
+/*++
+
+Routine Description:
+
+    This routine performs the poll and epoll performance benchmark tests. It
+    writes a byte to each of many pipes in turn, and waits for the one ready
+    pipe among all of them before reading the byte back.
+
+Arguments:
+
+    Test - Supplies a pointer to the performance test being executed.
+
+    Result - Supplies a pointer to a performance test result structure that
+        receives the tests results.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    ssize_t BytesCompleted;
+    char Character;
+    struct epoll_event Event;
+    unsigned long long Iterations;
+    int PipeIndex;
+    int Pipes[PT_POLL_PIPE_COUNT][2];
+    int PollDescriptor;
+    struct pollfd *PollDescriptors;
+    int ReadDescriptor;
+    int Status;
+
+    Character = 'p';
+    Iterations = 0;
+    PollDescriptor = -1;
+    PollDescriptors = NULL;
+    Result->Type = PtResultIterations;
+    Result->Status = 0;
+    for (PipeIndex = 0; PipeIndex < PT_POLL_PIPE_COUNT; PipeIndex += 1) {
+        Pipes[PipeIndex][0] = -1;
+        Pipes[PipeIndex][1] = -1;
+    }
+
+    for (PipeIndex = 0; PipeIndex < PT_POLL_PIPE_COUNT; PipeIndex += 1) {
+        if (pipe(Pipes[PipeIndex]) != 0) {
+            Result->Status = errno;
+            goto MainEnd;
+        }
+    }
+
+    //
+    // Perform setup specific to each test.
+    //
+
+    switch (Test->TestType) {
+    case PtTestPoll:
+        PollDescriptors = malloc(sizeof(struct pollfd) * PT_POLL_PIPE_COUNT);
+        if (PollDescriptors == NULL) {
+            Result->Status = ENOMEM;
+            goto MainEnd;
+        }
+
+        for (PipeIndex = 0; PipeIndex < PT_POLL_PIPE_COUNT; PipeIndex += 1) {
+            PollDescriptors[PipeIndex].fd = Pipes[PipeIndex][0];
+            PollDescriptors[PipeIndex].events = POLLIN;
+            PollDescriptors[PipeIndex].revents = 0;
+        }
+
+        break;
+
+    case PtTestEpoll:
+        PollDescriptor = epoll_create1(EPOLL_CLOEXEC);
+        if (PollDescriptor < 0) {
+            Result->Status = errno;
+            goto MainEnd;
+        }
+
+        for (PipeIndex = 0; PipeIndex < PT_POLL_PIPE_COUNT; PipeIndex += 1) {
+            Event.events = EPOLLIN;
+            Event.data.fd = Pipes[PipeIndex][0];
+            Status = epoll_ctl(PollDescriptor,
+                               EPOLL_CTL_ADD,
+                               Pipes[PipeIndex][0],
+                               &Event);
+
+            if (Status != 0) {
+                Result->Status = errno;
+                goto MainEnd;
+            }
+        }
+
+        break;
+
+    default:
+        fprintf(stderr, "Unknown poll test type %d\n", Test->TestType);
+        Result->Status = EINVAL;
+        goto MainEnd;
+    }
+
+    //
+    // Start the test. This snaps resource usage and starts the clock ticking.
+    //
+
+    Status = PtStartTimedTest(Test->Duration);
+    if (Status != 0) {
+        Result->Status = errno;
+        goto MainEnd;
+    }
+
+    //
+    // Measure how quickly the single ready descriptor can be found by making
+    // one pipe at a time readable, waiting on all of them, and draining it.
+    //
+
+    PipeIndex = 0;
+    while (PtIsTimedTestRunning() != 0) {
+        do {
+            BytesCompleted = write(Pipes[PipeIndex][1], &Character, 1);
+
+        } while ((BytesCompleted < 0) && (errno == EINTR));
+
+        if (BytesCompleted != 1) {
+            if (errno == 0) {
+                errno = EIO;
+            }
+
+            Result->Status = errno;
+            break;
+        }
+
+        if (Test->TestType == PtTestPoll) {
+            Status = PtpWaitForPoll(PollDescriptors, &ReadDescriptor);
+
+        } else {
+            Status = PtpWaitForEpoll(PollDescriptor, &ReadDescriptor);
+        }
+
+        if (Status != 0) {
+            Result->Status = Status;
+            break;
+        }
+
+        if (ReadDescriptor != Pipes[PipeIndex][0]) {
+            Result->Status = EIO;
+            break;
+        }
+
+        do {
+            BytesCompleted = read(ReadDescriptor, &Character, 1);
+
+        } while ((BytesCompleted < 0) && (errno == EINTR));
+
+        if (BytesCompleted != 1) {
+            if (errno == 0) {
+                errno = EIO;
+            }
+
+            Result->Status = errno;
+            break;
+        }
+
+        PipeIndex += 1;
+        if (PipeIndex == PT_POLL_PIPE_COUNT) {
+            PipeIndex = 0;
+        }
+
+        Iterations += 1;
+    }
+
+    Status = PtFinishTimedTest(Result);
+    if ((Status != 0) && (Result->Status == 0)) {
+        Result->Status = errno;
+    }
+
+MainEnd:
+    if (PollDescriptor >= 0) {
+        close(PollDescriptor);
+    }
+
+    if (PollDescriptors != NULL) {
+        free(PollDescriptors);
+    }
+
+    for (PipeIndex = 0; PipeIndex < PT_POLL_PIPE_COUNT; PipeIndex += 1) {
+        if (Pipes[PipeIndex][0] >= 0) {
+            close(Pipes[PipeIndex][0]);
+            close(Pipes[PipeIndex][1]);
+        }
+    }
+
+    Result->Data.Iterations = Iterations;
+    return;
+}
+
+//
+// --------------------------------------------------------- Internal Functions
+//
+
+int
+PtpWaitForPoll (
+    struct pollfd *PollDescriptors,
+    int *ReadDescriptor
+    )
+
+/*++
+
+Routine Description:
+
+    This routine waits for one of the pipes to become readable using poll.
+
+Arguments:
+
+    PollDescriptors - Supplies a pointer to the array of poll descriptors for
+        the read end of every pipe.
+
+    ReadDescriptor - Supplies a pointer where the readable descriptor will be
+        returned.
+
+Return Value:
+
+    0 on success.
+
+    Returns an error number on failure.
+
+--*/
+
+{
+
+    int Index;
+    int Status;
+
+    do {
+        Status = poll(PollDescriptors, PT_POLL_PIPE_COUNT, -1);
+
+    } while ((Status < 0) && (errno == EINTR));
+
+    if (Status != 1) {
+        if (Status < 0) {
+            return errno;
+        }
+
+        return EIO;
+    }
+
+    //
+    // Like any poll loop, scan the whole array for the ready descriptor.
+    //
+
+    for (Index = 0; Index < PT_POLL_PIPE_COUNT; Index += 1) {
+        if ((PollDescriptors[Index].revents & POLLIN) != 0) {
+            *ReadDescriptor = PollDescriptors[Index].fd;
+            return 0;
+        }
+    }
+
+    return EIO;
+}
+
+int
+PtpWaitForEpoll (
+    int PollDescriptor,
+    int *ReadDescriptor
+    )
+
+/*++
+
+Routine Description:
+
+    This routine waits for one of the pipes to become readable using
+    epoll_wait.
+
+Arguments:
+
+    PollDescriptor - Supplies the epoll descriptor watching every pipe.
+
+    ReadDescriptor - Supplies a pointer where the readable descriptor will be
+        returned.
+
+Return Value:
+
+    0 on success.
+
+    Returns an error number on failure.
+
+--*/
+
+{
+
+    struct epoll_event Event;
+    int Status;
+
+    do {
+        Status = epoll_wait(PollDescriptor, &Event, 1, -1);
+
+    } while ((Status < 0) && (errno == EINTR));
+
+    if (Status != 1) {
+        if (Status < 0) {
+            return errno;
+        }
+
+        return EIO;
+    }
+
+    if ((Event.events & EPOLLIN) == 0) {
+        return EIO;
+    }
+
+    *ReadDescriptor = Event.data.fd;
+    return 0;
+}
+
@@ -0,0 +1,796 @@
+/*++
+
+Copyright (c) 2026 Minoca Corp.
+
+    This file is licensed under the terms of the GNU General Public License
+    version 3. Alternative licensing terms are available. Contact
+    info@minocacorp.com for details. See the LICENSE file at the root of this
+    project for complete licensing information.
+
+Module Name:
+
+    schedtest.c
+
+Abstract:
+
+    This module implements the scheduler latency test, which measures how long
+    it takes a woken thread to actually run while CPU-bound threads keep every
+    processor busy.
+
+Author:
+
+    Minoca Corp. 18-Oct-2026
+
+Environment:
+
+    User Mode
+
+--*/
+
+//
+// ------------------------------------------------------------------- Includes
+//
+
+#include <minoca/lib/minocaos.h>
+
+#include <assert.h>
+#include <errno.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+//
+// --------------------------------------------------------------------- Macros
+//
+
+#define DEBUG_PRINT(...)                                \
+    if (SchedTestVerbosity >= TestVerbosityDebug) {     \
+        printf(__VA_ARGS__);                            \
+    }
+
+#define PRINT(...)                                      \
+    if (SchedTestVerbosity >= TestVerbosityNormal) {    \
+        printf(__VA_ARGS__);                            \
+    }
+
+#define PRINT_ERROR(...) fprintf(stderr, "\nschedtest: " __VA_ARGS__)
+
+//
+// ---------------------------------------------------------------- Definitions
+//
+
+#define SCHED_TEST_VERSION_MAJOR 1
+#define SCHED_TEST_VERSION_MINOR 0
+
+#define SCHED_TEST_USAGE                                                       \
+    "Usage: schedtest [options] \n"                                            \
+    "This utility measures wakeup-to-run latency while CPU-bound threads \n"   \
+    "keep the processors busy. Options are:\n"                                 \
+    "  -l, --load <count> -- Set the number of CPU-bound background \n"        \
+    "      threads. The default is twice the number of processors.\n"          \
+    "  -i, --iterations <count> -- Set the number of wakeups to measure.\n"    \
+    "  -s, --sleep <us> -- Set the time between wakeups in microseconds.\n"    \
+    "  -n, --nice <value> -- Set the nice value of the measured thread.\n"     \
+    "  -b, --load-nice <value> -- Set the nice value of the load threads.\n"   \
+    "  -f, --fifo <priority> -- Run the measured thread in the FIFO \n"        \
+    "      real-time class at the given priority.\n"                           \
+    "  -r, --rr <priority> -- Run the measured thread in the round robin \n"   \
+    "      real-time class at the given priority.\n"                           \
+    "  --debug -- Print lots of information about what's happening.\n"         \
+    "  --quiet -- Print only errors.\n"                                        \
+    "  --help -- Print this help text and exit.\n"                             \
+    "  --version -- Print the test version and exit.\n"                        \
+
+#define SCHED_TEST_OPTIONS_STRING "l:i:s:n:b:f:r:dqhV"
+
+#define DEFAULT_ITERATION_COUNT 1000
+#define DEFAULT_SLEEP_MICROSECONDS 2000
+
+#define NANOSECONDS_PER_MICROSECOND 1000ULL
+#define NANOSECONDS_PER_SECOND 1000000000ULL
+
+//
+// ------------------------------------------------------ Data Type Definitions
+//
+
+typedef enum _TEST_VERBOSITY {
+    TestVerbosityQuiet,
+    TestVerbosityNormal,
+    TestVerbosityDebug
+} TEST_VERBOSITY, *PTEST_VERBOSITY;
+
+/*++
+
+Structure Description:
+
+    This structure stores the state shared between the waking thread and the
+    measured thread.
+
+Members:
+
+    Parameters - Stores the scheduling parameters the measured thread applies
+        to itself before starting.
+
+    Iterations - Stores the number of wakeups to measure.
+
+    WakePipe - Stores the pipe the waker writes to in order to wake the
+        measured thread.
+
+    AcknowledgePipe - Stores the pipe the measured thread writes to once it
+        has recorded a sample, so that wakeups do not overlap.
+
+    WakeTime - Stores the monotonic time in nanoseconds at which the most
+        recent wakeup was issued.
+
+    Samples - Stores the array of measured latencies in nanoseconds.
+
+    Status - Stores the result of the measured thread.
+
+--*/
+
+typedef struct _SCHED_TEST_CONTEXT {
+    SCHEDULER_PARAMETERS Parameters;
+    INT Iterations;
+    int WakePipe[2];
+    int AcknowledgePipe[2];
+    volatile ULONGLONG WakeTime;
+    PULONGLONG Samples;
+    INT Status;
+} SCHED_TEST_CONTEXT, *PSCHED_TEST_CONTEXT;
+
+//
+// ----------------------------------------------- Internal Function Prototypes
+//
+
+void *
+SchedTestLoadThread (
+    void *Parameter
+    );
+
+void *
+SchedTestLatencyThread (
+    void *Parameter
+    );
+
+INT
+SchedTestSetThreadParameters (
+    PSCHEDULER_PARAMETERS Parameters
+    );
+
+ULONGLONG
+SchedTestGetTime (
+    VOID
+    );
+
+int
+SchedTestCompareSamples (
+    const void *Left,
+    const void *Right
+    );
+
+//
+// -------------------------------------------------------------------- Globals
+//
+
+//
+// Higher levels here print out more stuff.
+//
+
+TEST_VERBOSITY SchedTestVerbosity = TestVerbosityNormal;
+
+//
+// Set this to stop the load threads.
+//
+
+volatile BOOL SchedTestStop = FALSE;
+
+//
+// Store the number of loops the load threads have completed, as a rough
+// measure of how much throughput the background load got.
+//
+
+volatile ULONGLONG SchedTestLoadLoops;
+
+struct option SchedTestLongOptions[] = {
+    {"load", required_argument, 0, 'l'},
+    {"iterations", required_argument, 0, 'i'},
+    {"sleep", required_argument, 0, 's'},
+    {"nice", required_argument, 0, 'n'},
+    {"load-nice", required_argument, 0, 'b'},
+    {"fifo", required_argument, 0, 'f'},
+    {"rr", required_argument, 0, 'r'},
+    {"debug", no_argument, 0, 'd'},
+    {"quiet", no_argument, 0, 'q'},
+    {"help", no_argument, 0, 'h'},
+    {"version", no_argument, 0, 'V'},
+    {NULL, 0, 0, 0},
+};
+
+//
+// ------------------------------------------------------------------ Functions
+//
+
+int
+main (
+    int ArgumentCount,
+    char **Arguments
+    )
+
+/*++
+
+Routine Description:
+
+    This routine implements the scheduler latency test program.
+
+Arguments:
+
+    ArgumentCount - Supplies the number of elements in the arguments array.
+
+    Arguments - Supplies an array of strings. The array count is bounded by the
+        previous parameter, and the strings are null-terminated.
+
+Return Value:
+
+    0 on success.
+
+    Non-zero on failure.
+
+--*/
+
+{
+
+    PSTR AfterScan;
+    char Buffer;
+    SCHED_TEST_CONTEXT Context;
+    INT Index;
+    pthread_t LatencyThread;
+    BOOL LatencyThreadCreated;
+    INT LoadCount;
+    SCHEDULER_PARAMETERS LoadParameters;
+    pthread_t *LoadThreads;
+    INT LoadThreadsCreated;
+    INT Option;
+    INT ProcessorCount;
+    ssize_t Size;
+    struct timespec Sleep;
+    INT SleepMicroseconds;
+    INT Status;
+    ULONGLONG Total;
+    INT Value;
+
+    memset(&Context, 0, sizeof(SCHED_TEST_CONTEXT));
+    Context.WakePipe[0] = -1;
+    Context.WakePipe[1] = -1;
+    Context.AcknowledgePipe[0] = -1;
+    Context.AcknowledgePipe[1] = -1;
+    Context.Iterations = DEFAULT_ITERATION_COUNT;
+    Context.Parameters.Policy = SchedulerPolicyFair;
+    LatencyThreadCreated = FALSE;
+    LoadThreads = NULL;
+    LoadThreadsCreated = 0;
+    LoadParameters.Policy = SchedulerPolicyFair;
+    LoadParameters.NiceValue = 0;
+    LoadParameters.RealTimePriority = 0;
+    ProcessorCount = sysconf(_SC_NPROCESSORS_ONLN);
+    if (ProcessorCount <= 0) {
+        ProcessorCount = 1;
+    }
+
+    LoadCount = ProcessorCount * 2;
+    SleepMicroseconds = DEFAULT_SLEEP_MICROSECONDS;
+    Status = 0;
+    setvbuf(stdout, NULL, _IONBF, 0);
+    setvbuf(stderr, NULL, _IONBF, 0);
+
+    //
+    // Process the control arguments.
+    //
+
+    while (TRUE) {
+        Option = getopt_long(ArgumentCount,
+                             Arguments,
+                             SCHED_TEST_OPTIONS_STRING,
+                             SchedTestLongOptions,
+                             NULL);
+
+        if (Option == -1) {
+            break;
+        }
+
+        if ((Option == '?') || (Option == ':')) {
+            Status = 1;
+            goto MainEnd;
+        }
+
+        switch (Option) {
+        case 'l':
+            LoadCount = strtol(optarg, &AfterScan, 0);
+            if ((LoadCount < 0) || (AfterScan == optarg)) {
+                PRINT_ERROR("Invalid load thread count %s.\n", optarg);
+                Status = 1;
+                goto MainEnd;
+            }
+
+            break;
+
+        case 'i':
+            Context.Iterations = strtol(optarg, &AfterScan, 0);
+            if ((Context.Iterations <= 0) || (AfterScan == optarg)) {
+                PRINT_ERROR("Invalid iteration count %s.\n", optarg);
+                Status = 1;
+                goto MainEnd;
+            }
+
+            break;
+
+        case 's':
+            SleepMicroseconds = strtol(optarg, &AfterScan, 0);
+            if ((SleepMicroseconds < 0) || (AfterScan == optarg)) {
+                PRINT_ERROR("Invalid sleep time %s.\n", optarg);
+                Status = 1;
+                goto MainEnd;
+            }
+
+            break;
+
+        case 'n':
+        case 'b':
+            Value = strtol(optarg, &AfterScan, 0);
+            if ((Value < SCHEDULER_NICE_MIN) ||
+                (Value > SCHEDULER_NICE_MAX) ||
+                (AfterScan == optarg)) {
+
+                PRINT_ERROR("Invalid nice value %s.\n", optarg);
+                Status = 1;
+                goto MainEnd;
+            }
+
+            if (Option == 'n') {
+                Context.Parameters.NiceValue = Value;
+
+            } else {
+                LoadParameters.NiceValue = Value;
+            }
+
+            break;
+
+        case 'f':
+        case 'r':
+            Value = strtol(optarg, &AfterScan, 0);
+            if ((Value < SCHEDULER_REAL_TIME_PRIORITY_MIN) ||
+                (Value > SCHEDULER_REAL_TIME_PRIORITY_MAX) ||
+                (AfterScan == optarg)) {
+
+                PRINT_ERROR("Invalid real-time priority %s.\n", optarg);
+                Status = 1;
+                goto MainEnd;
+            }
+
+            Context.Parameters.Policy = SchedulerPolicyFifo;
+            if (Option == 'r') {
+                Context.Parameters.Policy = SchedulerPolicyRoundRobin;
+            }
+
+            Context.Parameters.RealTimePriority = Value;
+            break;
+
+        case 'd':
+            SchedTestVerbosity = TestVerbosityDebug;
+            break;
+
+        case 'q':
+            SchedTestVerbosity = TestVerbosityQuiet;
+            break;
+
+        case 'V':
+            printf("Minoca schedtest version %d.%d\n",
+                   SCHED_TEST_VERSION_MAJOR,
+                   SCHED_TEST_VERSION_MINOR);
+
+            return 1;
+
+        case 'h':
+            printf(SCHED_TEST_USAGE);
+            return 1;
+
+        default:
+
+            assert(FALSE);
+
+            Status = 1;
+            goto MainEnd;
+        }
+    }
+
+    Context.Samples = malloc(sizeof(ULONGLONG) * Context.Iterations);
+    if (Context.Samples == NULL) {
+        Status = ENOMEM;
+        goto MainEnd;
+    }
+
+    if ((pipe(Context.WakePipe) != 0) ||
+        (pipe(Context.AcknowledgePipe) != 0)) {
+
+        Status = errno;
+        PRINT_ERROR("Failed to create pipes: %s.\n", strerror(Status));
+        goto MainEnd;
+    }
+
+    //
+    // Fire up the background load.
+    //
+
+    if (LoadCount != 0) {
+        LoadThreads = malloc(sizeof(pthread_t) * LoadCount);
+        if (LoadThreads == NULL) {
+            Status = ENOMEM;
+            goto MainEnd;
+        }
+    }
+
+    for (Index = 0; Index < LoadCount; Index += 1) {
+        Status = pthread_create(&(LoadThreads[Index]),
+                                NULL,
+                                SchedTestLoadThread,
+                                &LoadParameters);
+
+        if (Status != 0) {
+            PRINT_ERROR("Failed to create load thread: %s.\n",
+                        strerror(Status));
+
+            goto MainEnd;
+        }
+
+        LoadThreadsCreated += 1;
+    }
+
+    Status = pthread_create(&LatencyThread,
+                            NULL,
+                            SchedTestLatencyThread,
+                            &Context);
+
+    if (Status != 0) {
+        PRINT_ERROR("Failed to create latency thread: %s.\n",
+                    strerror(Status));
+
+        goto MainEnd;
+    }
+
+    LatencyThreadCreated = TRUE;
+    PRINT("Measuring %d wakeups with %d load threads on %d processors.\n",
+          Context.Iterations,
+          LoadCount,
+          ProcessorCount);
+
+    //
+    // Wake the measured thread periodically, waiting for it to record each
+    // sample before sleeping again.
+    //
+
+    Sleep.tv_sec = SleepMicroseconds / 1000000;
+    Sleep.tv_nsec = (SleepMicroseconds % 1000000) *
+                    NANOSECONDS_PER_MICROSECOND;
+
+    Buffer = 0;
+    for (Index = 0; Index < Context.Iterations; Index += 1) {
+        nanosleep(&Sleep, NULL);
+        Context.WakeTime = SchedTestGetTime();
+        do {
+            Size = write(Context.WakePipe[1], &Buffer, 1);
+
+        } while ((Size < 0) && (errno == EINTR));
+
+        if (Size != 1) {
+            Status = errno;
+            PRINT_ERROR("Failed to write: %s.\n", strerror(Status));
+            goto MainEnd;
+        }
+
+        do {
+            Size = read(Context.AcknowledgePipe[0], &Buffer, 1);
+
+        } while ((Size < 0) && (errno == EINTR));
+
+        if (Size != 1) {
+            Status = 1;
+            break;
+        }
+    }
+
+    close(Context.WakePipe[1]);
+    Context.WakePipe[1] = -1;
+    pthread_join(LatencyThread, NULL);
+    LatencyThreadCreated = FALSE;
+    if ((Status == 0) && (Context.Status != 0)) {
+        Status = Context.Status;
+    }
+
+    if (Status != 0) {
+        goto MainEnd;
+    }
+
+    //
+    // Report the distribution.
+    //
+
+    qsort(Context.Samples,
+          Context.Iterations,
+          sizeof(ULONGLONG),
+          SchedTestCompareSamples);
+
+    Total = 0;
+    for (Index = 0; Index < Context.Iterations; Index += 1) {
+        Total += Context.Samples[Index];
+    }
+
+    PRINT("Wakeup latency (us): min %llu avg %llu p50 %llu p99 %llu "
+          "max %llu\n",
+          Context.Samples[0] / NANOSECONDS_PER_MICROSECOND,
+          Total / Context.Iterations / NANOSECONDS_PER_MICROSECOND,
+          Context.Samples[Context.Iterations / 2] /
+          NANOSECONDS_PER_MICROSECOND,
+          Context.Samples[(Context.Iterations * 99) / 100] /
+          NANOSECONDS_PER_MICROSECOND,
+          Context.Samples[Context.Iterations - 1] /
+          NANOSECONDS_PER_MICROSECOND);
+
+    PRINT("Load threads completed %llu loops.\n", SchedTestLoadLoops);
+
+MainEnd:
+    SchedTestStop = TRUE;
+    if (LatencyThreadCreated != FALSE) {
+        close(Context.WakePipe[1]);
+        Context.WakePipe[1] = -1;
+        pthread_join(LatencyThread, NULL);
+    }
+
+    for (Index = 0; Index < LoadThreadsCreated; Index += 1) {
+        pthread_join(LoadThreads[Index], NULL);
+    }
+
+    for (Index = 0; Index < 2; Index += 1) {
+        if (Context.WakePipe[Index] >= 0) {
+            close(Context.WakePipe[Index]);
+        }
+
+        if (Context.AcknowledgePipe[Index] >= 0) {
+            close(Context.AcknowledgePipe[Index]);
+        }
+    }
+
+    if (LoadThreads != NULL) {
+        free(LoadThreads);
+    }
+
+    if (Context.Samples != NULL) {
+        free(Context.Samples);
+    }
+
+    if (Status != 0) {
+        PRINT_ERROR("Sched test failed: %d.\n", Status);
+        return 1;
+    }
+
+    return 0;
+}
+
+//
+// --------------------------------------------------------- Internal Functions
+//
+
+void *
+SchedTestLoadThread (
+    void *Parameter
+    )
+
+/*++
+
+Routine Description:
+
+    This routine implements a CPU-bound background load thread.
+
+Arguments:
+
+    Parameter - Supplies a pointer to the scheduling parameters to apply.
+
+Return Value:
+
+    NULL always.
+
+--*/
+
+{
+
+    ULONGLONG Loops;
+
+    SchedTestSetThreadParameters(Parameter);
+    Loops = 0;
+    while (SchedTestStop == FALSE) {
+        Loops += 1;
+    }
+
+    RtlAtomicAdd64((PULONGLONG)&SchedTestLoadLoops, Loops);
+    return NULL;
+}
+
+void *
+SchedTestLatencyThread (
+    void *Parameter
+    )
+
+/*++
+
+Routine Description:
+
+    This routine implements the measured thread, which blocks on the wake pipe
+    and records how long it took to run once woken.
+
+Arguments:
+
+    Parameter - Supplies a pointer to the test context.
+
+Return Value:
+
+    NULL always.
+
+--*/
+
+{
+
+    char Buffer;
+    PSCHED_TEST_CONTEXT Context;
+    ULONGLONG CurrentTime;
+    INT Index;
+    ssize_t Size;
+
+    Context = Parameter;
+    Context->Status = SchedTestSetThreadParameters(&(Context->Parameters));
+    Index = 0;
+    while (TRUE) {
+        do {
+            Size = read(Context->WakePipe[0], &Buffer, 1);
+
+        } while ((Size < 0) && (errno == EINTR));
+
+        if (Size <= 0) {
+            break;
+        }
+
+        CurrentTime = SchedTestGetTime();
+        if (Index < Context->Iterations) {
+            Context->Samples[Index] = CurrentTime - Context->WakeTime;
+            DEBUG_PRINT("%d: %lluns\n", Index, Context->Samples[Index]);
+            Index += 1;
+        }
+
+        do {
+            Size = write(Context->AcknowledgePipe[1], &Buffer, 1);
+
+        } while ((Size < 0) && (errno == EINTR));
+
+        if (Size != 1) {
+            break;
+        }
+    }
+
+    return NULL;
+}
+
+INT
+SchedTestSetThreadParameters (
+    PSCHEDULER_PARAMETERS Parameters
+    )
+
+/*++
+
+Routine Description:
+
+    This routine applies the given scheduling parameters to the current
+    thread.
+
+Arguments:
+
+    Parameters - Supplies a pointer to the parameters to set.
+
+Return Value:
+
+    0 on success.
+
+    Returns an error number on failure.
+
+--*/
+
+{
+
+    KSTATUS Status;
+
+    if ((Parameters->Policy == SchedulerPolicyFair) &&
+        (Parameters->NiceValue == 0)) {
+
+        return 0;
+    }
+
+    Status = OsSetSchedulingParameters(ProcessIdThread, 0, Parameters, NULL);
+    if (!KSUCCESS(Status)) {
+        PRINT_ERROR("Failed to set scheduling parameters: %d.\n", Status);
+        return EPERM;
+    }
+
+    return 0;
+}
+
+ULONGLONG
+SchedTestGetTime (
+    VOID
+    )
+
+/*++
+
+Routine Description:
+
+    This routine returns the current monotonic time in nanoseconds.
+
+Arguments:
+
+    None.
+
+Return Value:
+
+    Returns the current time in nanoseconds.
+
+--*/
+
+{
+
+    struct timespec Time;
+
+    clock_gettime(CLOCK_MONOTONIC, &Time);
+    return (Time.tv_sec * NANOSECONDS_PER_SECOND) + Time.tv_nsec;
+}
+
+int
+SchedTestCompareSamples (
+    const void *Left,
+    const void *Right
+    )
+
+/*++
+
+Routine Description:
+
+    This routine compares two latency samples for qsort.
+
+Arguments:
+
+    Left - Supplies a pointer to the left sample.
+
+    Right - Supplies a pointer to the right sample.
+
+Return Value:
+
+    Less than zero if the left sample is smaller, zero if they are equal, and
+    greater than zero if the left sample is larger.
+
+--*/
+
+{
+
+    ULONGLONG LeftValue;
+    ULONGLONG RightValue;
+
+    LeftValue = *((PULONGLONG)Left);
+    RightValue = *((PULONGLONG)Right);
+    if (LeftValue < RightValue) {
+        return -1;
+
+    } else if (LeftValue > RightValue) {
+        return 1;
+    }
+
+    return 0;
+}
+
@@ -14,7 +14,9 @@ Module Name:
 Abstract:
 
     This module implements an application that tests out the system's socket
-    functionality.
+    functionality. It also reports the goodput of the transfer, which can be
+    used along with the TCP debug transmit drop and reorder rates to measure
+    loss recovery.
 
 Author:
 
@@ -38,12 +40,24 @@ Module Name:
 #include <stdio.h>
 #include <stdlib.h>
 #include <sys/socket.h>
+#include <time.h>
 #include <unistd.h>
 
 //
 // ---------------------------------------------------------------- Definitions
 //
 
+#define SOCKTEST_DEFAULT_HOST "192.168.1.19"
+#define SOCKTEST_DEFAULT_PORT 7653
+#define SOCKTEST_CHUNK_SIZE (64 * 1024)
+#define SOCKTEST_DEFAULT_CHUNK_COUNT 16
+
+#define SOCKTEST_USAGE                                                        \
+    "usage: socktest [host [port [chunks]]]\n"                                \
+    "Sends the given number of 64kB chunks to a TCP sink at the given \n"     \
+    "address and reports the goodput. The defaults are %s, port %d, and \n"   \
+    "%d chunks.\n"
+
 //
 // ------------------------------------------------------ Data Type Definitions
 //
@@ -54,6 +68,8 @@ Module Name:
 
 ULONG
 TestTransmitThroughput (
+    PSTR Host,
+    USHORT Port,
     ULONG ChunkSize,
     ULONG ChunkCount
     );
@@ -95,7 +111,37 @@ Return Value:
 
 {
 
-    return TestTransmitThroughput(64 * 1024, 16);
+    ULONG ChunkCount;
+    PSTR Host;
+    USHORT Port;
+
+    Host = SOCKTEST_DEFAULT_HOST;
+    Port = SOCKTEST_DEFAULT_PORT;
+    ChunkCount = SOCKTEST_DEFAULT_CHUNK_COUNT;
+    if ((ArgumentCount > 4) ||
+        ((ArgumentCount > 1) && (Arguments[1][0] == '-'))) {
+
+        printf(SOCKTEST_USAGE,
+               SOCKTEST_DEFAULT_HOST,
+               SOCKTEST_DEFAULT_PORT,
+               SOCKTEST_DEFAULT_CHUNK_COUNT);
+
+        return 1;
+    }
+
+    if (ArgumentCount > 1) {
+        Host = Arguments[1];
+    }
+
+    if (ArgumentCount > 2) {
+        Port = strtoul(Arguments[2], NULL, 0);
+    }
+
+    if (ArgumentCount > 3) {
+        ChunkCount = strtoul(Arguments[3], NULL, 0);
+    }
+
+    return TestTransmitThroughput(Host, Port, SOCKTEST_CHUNK_SIZE, ChunkCount);
 }
 
 //
@@ -104,6 +150,8 @@ Return Value:
 
 ULONG
 TestTransmitThroughput (
+    PSTR Host,
+    USHORT Port,
     ULONG ChunkSize,
     ULONG ChunkCount
     )
@@ -112,10 +160,15 @@ TestTransmitThroughput (
 
 Routine Description:
 
-    This routine tests transmitting a large amount of data out of a socket.
+    This routine tests transmitting a large amount of data out of a socket,
+    and prints the goodput achieved.
 
 Arguments:
 
+    Host - Supplies the dotted IPv4 address of the host to send to.
+
+    Port - Supplies the port the remote sink is listening on.
+
     ChunkSize - Supplies the size of each buffer passed to the send() function.
 
     ChunkCount - Supplies the number of chunks that will be sent.
@@ -131,14 +184,19 @@ Return Value:
     ULONG ByteIndex;
     int BytesSent;
     struct sockaddr_in DestinationHost;
+    double Elapsed;
+    struct timespec EndTime;
     ULONG Errors;
     ULONG LoopIndex;
     int Result;
+    struct timespec StartTime;
     PCHAR TestSendBuffer;
     int TestSocket;
+    unsigned long long TotalSent;
 
     Errors = 0;
     TestSendBuffer = NULL;
+    TotalSent = 0;
     TestSocket = socket(AF_INET, SOCK_STREAM, 0);
     if (TestSocket == -1) {
         printf("socket() failed. Errno = %d.\n", errno);
@@ -146,21 +204,19 @@ Return Value:
         goto TestTransmitThroughputEnd;
     }
 
-    //
-    // TODO: Replace this with a real function (and not just a hard-coded
-    // network order IP address.
-    //
-
     DestinationHost.sin_family = AF_INET;
-    DestinationHost.sin_port = htons(7653);
-    DestinationHost.sin_addr.s_addr = (192 << 0) | (168 << 8) | (1 << 16) |
-                                      (19 << 24);
+    DestinationHost.sin_port = htons(Port);
+    if (inet_pton(AF_INET, Host, &(DestinationHost.sin_addr)) != 1) {
+        printf("Invalid address %s.\n", Host);
+        Errors += 1;
+        goto TestTransmitThroughputEnd;
+    }
 
     //
     // Connect to the remote host.
     //
 
-    printf("Connecting to host...");
+    printf("Connecting to %s:%d...", Host, Port);
     Result = connect(TestSocket,
                      (struct sockaddr *)&DestinationHost,
                      sizeof(struct sockaddr_in));
@@ -198,11 +254,15 @@ Return Value:
     // Loop sending data hardcore.
     //
 
+    clock_gettime(CLOCK_MONOTONIC, &StartTime);
     for (LoopIndex = 0; LoopIndex < ChunkCount; LoopIndex += 1) {
         BytesSent = send(TestSocket, TestSendBuffer, ChunkSize, 0);
         if (BytesSent == -1) {
             printf("Error: Failed to send chunk. errno = %d.\n", errno);
             Errors += 1;
+
+        } else {
+            TotalSent += BytesSent;
         }
 
         if (BytesSent != ChunkSize) {
@@ -223,12 +283,36 @@ Return Value:
         }
     }
 
+    //
+    // Shut down the sending side and wait for the remote to close, so that
+    // the time includes getting all the data acknowledged.
+    //
+
+    shutdown(TestSocket, SHUT_WR);
+    while (recv(TestSocket, TestSendBuffer, ChunkSize, 0) > 0) {
+        NOTHING;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &EndTime);
+    Elapsed = (double)(EndTime.tv_sec - StartTime.tv_sec) +
+              ((double)(EndTime.tv_nsec - StartTime.tv_nsec) / 1000000000.0);
+
+    if (Elapsed > 0) {
+        printf("Sent %llu bytes in %.3f seconds: %.0f bytes/second.\n",
+               TotalSent,
+               Elapsed,
+               (double)TotalSent / Elapsed);
+    }
+
 TestTransmitThroughputEnd:
     if (TestSendBuffer != NULL) {
         free(TestSendBuffer);
     }
 
-    close(TestSocket);
+    if (TestSocket != -1) {
+        close(TestSocket);
+    }
+
     printf("TestTransmitThroughput done. %d errors found.\n", Errors);
     return Errors;
 }
@@ -215,9 +215,11 @@ Return Value:
 
 {
 
+    ULONGLONG Average;
     IO_CACHE_STATISTICS IoCache;
     ULONGLONG Megabytes;
     MM_STATISTICS MmStatistics;
+    ULONG Order;
     INT ReturnValue;
     UINTN Size;
     KSTATUS Status;
@@ -252,6 +254,34 @@ Return Value:
                  MmStatistics.PageSize) / _1MB;
 
     printf("Non-Paged Physical Memory: %I64dMB\n", Megabytes);
+    printf("Physical Page Allocator:\n");
+    printf("    Cached Pages: %ld\n", MmStatistics.CachedPhysicalPages);
+    printf("    Page Allocations: %I64d (cache hits %I64d)\n",
+           MmStatistics.PageAllocations,
+           MmStatistics.PageCacheHits);
+
+    Average = 0;
+    if (MmStatistics.BlockAllocations != 0) {
+        Average = MmStatistics.BlockAllocationCycles /
+                  MmStatistics.BlockAllocations;
+    }
+
+    printf("    Block Allocations: %I64d (average %I64d cycles, "
+           "max %I64d)\n",
+           MmStatistics.BlockAllocations,
+           Average,
+           MmStatistics.MaxBlockAllocationCycles);
+
+    printf("    Free Blocks:");
+    for (Order = 0; Order < MM_PHYSICAL_BLOCK_ORDER_COUNT; Order += 1) {
+        printf(" %ld", MmStatistics.FreePhysicalBlocks[Order]);
+    }
+
+    printf("\n");
+    printf("Large Pages:\n");
+    printf("    Allocations: %I64d\n", MmStatistics.LargePageAllocations);
+    printf("    Promotions: %I64d\n", MmStatistics.LargePagePromotions);
+    printf("    Splits: %I64d\n", MmStatistics.LargePageSplits);
     printf("Non Paged Pool:\n");
     printf("    Size: %ld\n", MmStatistics.NonPagedPool.TotalHeapSize);
     printf("    Maximum Size: %ld\n", MmStatistics.NonPagedPool.MaxHeapSize);
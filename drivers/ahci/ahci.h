@@ -136,6 +136,14 @@ Module Name:
 
 #define AHCI_PRDT_MAX_SIZE 0x400000
 
+//
+// Define the amount of time to wait for the NCQ error log to be read during
+// error recovery, in milliseconds. If the drive doesn't answer by then, every
+// aborted command is failed.
+//
+
+#define AHCI_ERROR_RECOVERY_TIMEOUT_MS 1000
+
 //
 // Define software AHCI port flags.
 //
@@ -152,6 +160,13 @@ Module Name:
 
 #define AHCI_PORT_NATIVE_COMMAND_QUEUING 0x00000002
 
+//
+// This bit is set while the port is recovering from a queued command error.
+// New commands are deferred until it clears.
+//
+
+#define AHCI_PORT_ERROR_RECOVERY 0x00000004
+
 //
 // Host capabilities register bits.
 //
@@ -972,11 +987,15 @@ Structure Description:
 
     Irp - Supplies a pointer to the IRP.
 
+    Queued - Supplies a boolean indicating whether the command in this slot is
+        a native queued command (TRUE) or a regular one (FALSE).
+
 --*/
 
 typedef struct _AHCI_COMMAND_STATE {
     UINTN IoSize;
     PIRP Irp;
+    BOOL Queued;
 } AHCI_COMMAND_STATE, *PAHCI_COMMAND_STATE;
 
 /*++
@@ -1027,6 +1046,14 @@ Structure Description:
 
     PendingCommands - Stores the mask of commands that are in use.
 
+    QueuedCommands - Stores the mask of pending commands that were issued as
+        native queued commands. These finish when their bit in the SATA active
+        register clears, rather than the command issue register.
+
+    DeferredCommands - Stores the mask of commands that are filled out but
+        have not yet been issued, because queued and non-queued commands
+        cannot be outstanding at the same time.
+
     OsDevice - Stores a pointer to the OS device for this port, if present.
 
     Flags - Stores a bitfield of flags about the port. See AHCI_PORT_*
@@ -1044,6 +1071,27 @@ Structure Description:
 
     IrpQueue - Stores the queue of IRPs that have not yet been started.
 
+    LogIoBuffer - Stores a pointer to the sector-sized I/O buffer used to read
+        the NCQ error log during error recovery. This is only allocated if
+        native command queuing is enabled.
+
+    RecoveryWorkItem - Stores a pointer to the work item that restarts the
+        port and reads the NCQ error log at low level after a queued command
+        error. This is only allocated if native command queuing is enabled.
+
+    RecoveryEvent - Stores a pointer to the event signaled when error recovery
+        finishes.
+
+    RecoveryCommands - Stores the mask of commands the drive aborted that are
+        waiting for error recovery to fail or resubmit them.
+
+    RecoverySlot - Stores the command slot reading the NCQ error log, or -1 if
+        the read has not been issued.
+
+    RecoveryGeneration - Stores a counter incremented each time error recovery
+        begins, used by the work item to tell whether the recovery it started
+        is still the current one.
+
 --*/
 
 typedef struct _AHCI_PORT {
@@ -1061,11 +1109,19 @@ typedef struct _AHCI_PORT {
     ULONG CommandMask;
     volatile ULONG AllocatedCommands;
     ULONG PendingCommands;
+    ULONG QueuedCommands;
+    ULONG DeferredCommands;
     PDEVICE OsDevice;
     ULONG Flags;
     KSPIN_LOCK DpcLock;
     ULONGLONG TotalSectors;
     LIST_ENTRY IrpQueue;
+    PIO_BUFFER LogIoBuffer;
+    PWORK_ITEM RecoveryWorkItem;
+    PKEVENT RecoveryEvent;
+    ULONG RecoveryCommands;
+    LONG RecoverySlot;
+    ULONG RecoveryGeneration;
 } AHCI_PORT, *PAHCI_PORT;
 
 /*++
@@ -100,6 +100,39 @@ AhcipSubmitCommand (
     ULONG Mask
     );
 
+VOID
+AhcipIssueCommand (
+    PAHCI_PORT Port,
+    ULONG Mask
+    );
+
+VOID
+AhcipIssueDeferredCommands (
+    PAHCI_PORT Port
+    );
+
+VOID
+AhcipConfigureQueuing (
+    PAHCI_PORT Port,
+    PATA_IDENTIFY_PACKET Identify
+    );
+
+VOID
+AhcipBeginQueuedErrorRecovery (
+    PAHCI_PORT Port
+    );
+
+VOID
+AhcipRecoverQueuedErrorWorker (
+    PVOID Parameter
+    );
+
+VOID
+AhcipFinishQueuedErrorRecovery (
+    PAHCI_PORT Port,
+    KSTATUS Status
+    );
+
 //
 // -------------------------------------------------------------------- Globals
 //
@@ -704,6 +737,10 @@ Return Value:
 
     KeReleaseSpinLock(&(Port->DpcLock));
     KeLowerRunLevel(OldRunLevel);
+    if (KSUCCESS(Status)) {
+        AhcipConfigureQueuing(Port, Identify);
+    }
+
     MmFreeIoBuffer(IoBuffer);
     return Status;
 }
@@ -844,11 +881,28 @@ Return Value:
     }
 
     //
-    // Clear out all pending commands.
+    // Clear out all pending commands, including those waiting to be issued
+    // and those set aside by error recovery. A log read in flight has no IRP.
     //
 
-    Pending = Port->PendingCommands;
+    Pending = Port->PendingCommands | Port->DeferredCommands;
+    if ((Port->Flags & AHCI_PORT_ERROR_RECOVERY) != 0) {
+        Pending |= Port->RecoveryCommands;
+        if ((Port->RecoverySlot >= 0) &&
+            ((Port->RecoveryCommands & (1 << Port->RecoverySlot)) == 0)) {
+
+            Pending &= ~(1 << Port->RecoverySlot);
+        }
+
+        Port->Flags &= ~AHCI_PORT_ERROR_RECOVERY;
+        Port->RecoveryCommands = 0;
+        Port->RecoverySlot = -1;
+        KeSignalEvent(Port->RecoveryEvent, SignalOptionSignalAll);
+    }
+
     Port->PendingCommands = 0;
+    Port->QueuedCommands = 0;
+    Port->DeferredCommands = 0;
     for (Bit = 0; Bit < AHCI_COMMAND_COUNT; Bit += 1) {
         if ((Pending & (1 << Bit)) == 0) {
             continue;
@@ -911,11 +965,13 @@ Return Value:
     LONG Bit;
     BOOL CommandInUse;
     BOOL CompleteIrp;
+    ULONG ErrorInterrupt;
     ULONG Finished;
     ULONG Interrupt;
     UINTN IoSize;
     PIRP Irp;
     ULONG NewPending;
+    BOOL QueuedError;
     KSTATUS Status;
     ULONG TaskFile;
 
@@ -942,44 +998,72 @@ Return Value:
         Interrupt &= ~AHCI_INTERRUPT_CONNECTION_MASK;
     }
 
-    if ((Interrupt & AHCI_INTERRUPT_ERROR_MASK) != 0) {
+    ErrorInterrupt = Interrupt & AHCI_INTERRUPT_ERROR_MASK;
+    if (ErrorInterrupt != 0) {
         RtlDebugPrint("AHCI: Error %x\n", Interrupt);
         Interrupt &= ~AHCI_INTERRUPT_ERROR_MASK;
     }
 
     ASSERT((Interrupt &
             (AHCI_INTERRUPT_D2H_REGISTER_FIS |
-             AHCI_INTERRUPT_PIO_SETUP_FIS)) != 0);
+             AHCI_INTERRUPT_PIO_SETUP_FIS |
+             AHCI_INTERRUPT_SET_DEVICE_BITS)) != 0);
+
+    //
+    // Queued commands complete with a set device bits FIS, and may also
+    // generate DMA setup FISes along the way.
+    //
 
     Interrupt &= ~(AHCI_INTERRUPT_D2H_REGISTER_FIS |
-                   AHCI_INTERRUPT_PIO_SETUP_FIS);
+                   AHCI_INTERRUPT_PIO_SETUP_FIS |
+                   AHCI_INTERRUPT_SET_DEVICE_BITS |
+                   AHCI_INTERRUPT_DMA_SETUP_FIS);
 
     if (Interrupt != 0) {
         RtlDebugPrint("AHCI: Got unknown interrupt 0x%x\n", Interrupt);
     }
 
     //
-    // See which commands are no longer outstanding.
+    // See which commands are no longer outstanding. Regular commands are done
+    // when their command issue bit clears, but queued commands are only done
+    // once the drive clears their SATA active bit.
     //
 
     NewPending = AHCI_READ(Port, AhciPortCommandIssue);
-    Finished = (NewPending ^ Port->PendingCommands) & Port->PendingCommands;
+    if (Port->QueuedCommands != 0) {
+        NewPending |= AHCI_READ(Port, AhciPortSataActive) &
+                      Port->QueuedCommands;
+    }
+
+    NewPending &= Port->PendingCommands;
+    Finished = Port->PendingCommands & ~NewPending;
+    TaskFile = AHCI_READ(Port, AhciPortTaskFile);
+    Status = STATUS_SUCCESS;
+    QueuedError = FALSE;
 
     //
-    // Commands better not be magically starting.
+    // If queued commands are outstanding, an error aborts all of them. The
+    // ones that finished before the error succeeded. Otherwise, the error
+    // belongs to the commands that just finished.
     //
 
-    ASSERT(((NewPending ^ Port->PendingCommands) &
-            ~Port->PendingCommands) == 0);
+    if (Port->QueuedCommands != 0) {
+        if (((TaskFile & AHCI_PORT_TASK_ERROR) != 0) ||
+            ((ErrorInterrupt & AHCI_INTERRUPT_TASK_FILE_ERROR) != 0)) {
 
-    TaskFile = AHCI_READ(Port, AhciPortTaskFile);
-    Status = STATUS_SUCCESS;
-    if ((TaskFile & AHCI_PORT_TASK_ERROR_MASK) != 0) {
+            QueuedError = TRUE;
+        }
+
+    } else if ((TaskFile & AHCI_PORT_TASK_ERROR_MASK) != 0) {
         RtlDebugPrint("AHCI: I/O Error status: %x\n", TaskFile);
         Status = STATUS_DEVICE_IO_ERROR;
     }
 
     Port->PendingCommands = NewPending;
+    Port->QueuedCommands &= NewPending;
+    if (QueuedError != FALSE) {
+        AhcipBeginQueuedErrorRecovery(Port);
+    }
 
     //
     // Loop over all the commands that have finished.
@@ -990,6 +1074,23 @@ Return Value:
             continue;
         }
 
+        //
+        // The error log read issued during queued error recovery finishes
+        // the recovery rather than an IRP.
+        //
+
+        if (((Port->Flags & AHCI_PORT_ERROR_RECOVERY) != 0) &&
+            (Bit == Port->RecoverySlot)) {
+
+            AhcipFinishQueuedErrorRecovery(Port, Status);
+            Finished &= ~(1 << Bit);
+            if (Finished == 0) {
+                break;
+            }
+
+            continue;
+        }
+
         Irp = Port->CommandState[Bit].Irp;
         IoSize = Port->CommandState[Bit].IoSize;
         Port->CommandState[Bit].IoSize = 0;
@@ -1006,7 +1107,12 @@ Return Value:
 
         } else if (KSUCCESS(Status)) {
 
-            ASSERT(Port->Commands[Bit].Size == IoSize);
+            //
+            // The byte count is not kept up to date for queued commands.
+            //
+
+            ASSERT((Port->CommandState[Bit].Queued != FALSE) ||
+                   (Port->Commands[Bit].Size == IoSize));
 
             if (Irp->MajorCode == IrpMajorIo) {
                 Irp->U.ReadWrite.IoBytesCompleted += IoSize;
@@ -1061,6 +1167,13 @@ Return Value:
             } else {
                 CompleteIrp = TRUE;
             }
+
+        //
+        // Fail the IRP if the command did not succeed.
+        //
+
+        } else {
+            CompleteIrp = TRUE;
         }
 
         if (CompleteIrp != FALSE) {
@@ -1083,6 +1196,15 @@ Return Value:
         }
     }
 
+    //
+    // Now that commands have drained, issue any commands that were waiting
+    // for the other kind of command to finish.
+    //
+
+    if (Port->DeferredCommands != 0) {
+        AhcipIssueDeferredCommands(Port);
+    }
+
     KeReleaseSpinLock(&(Port->DpcLock));
     return;
 }
@@ -1335,6 +1457,7 @@ Return Value:
     PHYSICAL_ADDRESS PhysicalAddress;
     PAHCI_PRDT Prdt;
     ULONG PrdtIndex;
+    BOOL Queued;
     ULONG SectorCount;
     UINTN TransferSize;
     UINTN TransferSizeRemaining;
@@ -1455,13 +1578,24 @@ Return Value:
     Port->CommandState[HeaderIndex].IoSize = TransferSize;
 
     //
-    // Use LBA48 if the block address is too high or the sector size is too
-    // large.
+    // Use native queued commands if they're enabled, which always use 48-bit
+    // addressing. Otherwise use LBA48 if the block address is too high or the
+    // sector size is too large.
     //
 
     DeviceSelect = ATA_DRIVE_SELECT_LBA;
-    if ((BlockAddress > ATA_MAX_LBA28) ||
-        (SectorCount > ATA_MAX_LBA28_SECTOR_COUNT)) {
+    Queued = FALSE;
+    if ((Port->Flags & AHCI_PORT_NATIVE_COMMAND_QUEUING) != 0) {
+        Queued = TRUE;
+        if (Write != FALSE) {
+            Command = AtaCommandWriteFpdmaQueued;
+
+        } else {
+            Command = AtaCommandReadFpdmaQueued;
+        }
+
+    } else if ((BlockAddress > ATA_MAX_LBA28) ||
+               (SectorCount > ATA_MAX_LBA28_SECTOR_COUNT)) {
 
         if (Write != FALSE) {
             Command = AtaCommandWriteDma48;
@@ -1506,7 +1640,22 @@ Return Value:
     Fis->Command = Command;
     SATA_SET_FIS_LBA(Fis, BlockAddress);
     Fis->Device = DeviceSelect;
-    SATA_SET_FIS_COUNT(Fis, SectorCount);
+
+    //
+    // Queued commands carry the sector count in the features register, and
+    // the command tag in the count register.
+    //
+
+    if (Queued != FALSE) {
+        Fis->FeaturesLow = (UCHAR)SectorCount;
+        Fis->FeaturesHigh = (UCHAR)(SectorCount >> 8);
+        SATA_SET_FIS_COUNT(Fis, HeaderIndex << ATA_NCQ_TAG_SHIFT);
+
+    } else {
+        SATA_SET_FIS_COUNT(Fis, SectorCount);
+    }
+
+    Port->CommandState[HeaderIndex].Queued = Queued;
     Header = &(Port->Commands[HeaderIndex]);
     Header->Control = AHCI_COMMAND_FIS_SIZE(sizeof(SATA_FIS_REGISTER_H2D));
     if (Write != FALSE) {
@@ -1566,6 +1715,7 @@ Return Value:
     Fis->Device = ATA_DRIVE_SELECT_LBA;
     Header->Control = AHCI_COMMAND_FIS_SIZE(sizeof(SATA_FIS_REGISTER_H2D));
     Header->PrdtLength = 0;
+    Port->CommandState[Index].Queued = FALSE;
 
     //
     // Submit the command for execution.
@@ -1661,6 +1811,7 @@ Return Value:
     RtlZeroMemory(CommandHeader, sizeof(AHCI_COMMAND_HEADER));
     CommandHeader->CommandTableLow = (ULONG)PhysicalAddress;
     CommandHeader->CommandTableHigh = (ULONG)(PhysicalAddress >> 32);
+    Port->CommandState[Bit].Queued = FALSE;
     return Bit;
 }
 
@@ -1693,7 +1844,8 @@ Return Value:
 
     ASSERT((Index >= 0) &&
            ((Port->AllocatedCommands & (1 << Index)) != 0) &&
-           ((Port->PendingCommands & (1 << Index)) == 0));
+           ((Port->PendingCommands & (1 << Index)) == 0) &&
+           ((Port->DeferredCommands & (1 << Index)) == 0));
 
     RtlAtomicAnd32(&(Port->AllocatedCommands), ~(1 << Index));
     return;
@@ -1726,17 +1878,645 @@ Return Value:
 
 {
 
+    BOOL Queued;
+
+    ASSERT(KeIsSpinLockHeld(&(Port->DpcLock)) != FALSE);
+
+    //
+    // Nothing goes to the drive while it is recovering from a queued command
+    // error.
+    //
+
+    if ((Port->Flags & AHCI_PORT_ERROR_RECOVERY) != 0) {
+        Port->DeferredCommands |= Mask;
+        return;
+    }
+
+    //
+    // Queued and non-queued commands cannot be outstanding on the drive at
+    // the same time. Hold back a command if the other kind is running. Queued
+    // commands also wait behind anything already deferred to keep a stream of
+    // queued commands from starving a non-queued one.
+    //
+
+    if ((Port->Flags & AHCI_PORT_NATIVE_COMMAND_QUEUING) != 0) {
+
+        ASSERT(RtlCountSetBits32(Mask) == 1);
+
+        Queued = Port->CommandState[RtlCountTrailingZeros32(Mask)].Queued;
+        if (Queued != FALSE) {
+            if ((Port->DeferredCommands != 0) ||
+                ((Port->PendingCommands & ~Port->QueuedCommands) != 0)) {
+
+                Port->DeferredCommands |= Mask;
+                return;
+            }
+
+        } else if (Port->PendingCommands != 0) {
+            Port->DeferredCommands |= Mask;
+            return;
+        }
+    }
+
+    AhcipIssueCommand(Port, Mask);
+    return;
+}
+
+VOID
+AhcipIssueCommand (
+    PAHCI_PORT Port,
+    ULONG Mask
+    )
+
+/*++
+
+Routine Description:
+
+    This routine hands a command to the hardware. This routine must be executed
+    at dispatch level with the DPC lock held for the port.
+
+Arguments:
+
+    Port - Supplies a pointer to the port.
+
+    Mask - Supplies the mask of the command to issue.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    ULONG Index;
+
     ASSERT(KeIsSpinLockHeld(&(Port->DpcLock)) != FALSE);
 
     RtlMemoryBarrier();
 
     //
     // There is no safe order to do these in, which is why holding the lock
-    // is necessary.
+    // is necessary. Queued commands must be marked active before they are
+    // issued.
     //
 
+    Index = RtlCountTrailingZeros32(Mask);
+    if (Port->CommandState[Index].Queued != FALSE) {
+        AHCI_WRITE(Port, AhciPortSataActive, Mask);
+        Port->QueuedCommands |= Mask;
+    }
+
     AHCI_WRITE(Port, AhciPortCommandIssue, Mask);
     Port->PendingCommands |= Mask;
     return;
 }
 
+VOID
+AhcipIssueDeferredCommands (
+    PAHCI_PORT Port
+    )
+
+/*++
+
+Routine Description:
+
+    This routine issues any deferred commands that can now run. Queued commands
+    are issued as long as no non-queued command is running. A non-queued
+    command is issued only once the drive is idle. This routine must be
+    executed at dispatch level with the DPC lock held for the port.
+
+Arguments:
+
+    Port - Supplies a pointer to the port.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    ULONG Bit;
+    ULONG Deferred;
+    ULONG Mask;
+
+    ASSERT(KeIsSpinLockHeld(&(Port->DpcLock)) != FALSE);
+
+    if ((Port->Flags & AHCI_PORT_ERROR_RECOVERY) != 0) {
+        return;
+    }
+
+    Deferred = Port->DeferredCommands;
+    while (Deferred != 0) {
+        Bit = RtlCountTrailingZeros32(Deferred);
+        Mask = 1 << Bit;
+        Deferred &= ~Mask;
+        if (Port->CommandState[Bit].Queued != FALSE) {
+            if ((Port->PendingCommands & ~Port->QueuedCommands) != 0) {
+                break;
+            }
+
+        } else if (Port->PendingCommands != 0) {
+            break;
+        }
+
+        Port->DeferredCommands &= ~Mask;
+        AhcipIssueCommand(Port, Mask);
+    }
+
+    return;
+}
+
+VOID
+AhcipConfigureQueuing (
+    PAHCI_PORT Port,
+    PATA_IDENTIFY_PACKET Identify
+    )
+
+/*++
+
+Routine Description:
+
+    This routine enables native command queuing on a port if both the
+    controller and the drive support it. This routine must be called at low
+    level.
+
+Arguments:
+
+    Port - Supplies a pointer to the port.
+
+    Identify - Supplies a pointer to the drive's identify data.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PAHCI_CONTROLLER Controller;
+    ULONG QueueDepth;
+
+    ASSERT(KeGetRunLevel() == RunLevelLow);
+
+    Controller = Port->Controller;
+    Port->Flags &= ~AHCI_PORT_NATIVE_COMMAND_QUEUING;
+    if ((Controller->CommandCount <= 1) ||
+        ((Port->Flags & AHCI_PORT_LBA48) == 0) ||
+        ((Identify->SataCapabilities &
+          ATA_SATA_CAPABILITY_NATIVE_COMMAND_QUEUING) == 0)) {
+
+        return;
+    }
+
+    //
+    // The drive reports one less than the number of commands it can queue.
+    // Never hand out more tags than both sides can handle.
+    //
+
+    QueueDepth = (Identify->QueueDepth & ATA_QUEUE_DEPTH_MASK) + 1;
+    if (QueueDepth > Controller->CommandCount) {
+        QueueDepth = Controller->CommandCount;
+    }
+
+    if (QueueDepth < 2) {
+        return;
+    }
+
+    //
+    // Allocate what error recovery needs up front, since it starts from the
+    // DPC and can't fail for lack of memory.
+    //
+
+    if (Port->LogIoBuffer == NULL) {
+        Port->LogIoBuffer = MmAllocateNonPagedIoBuffer(
+                                        0,
+                                        Controller->MaxPhysical,
+                                        ATA_SECTOR_SIZE,
+                                        ATA_SECTOR_SIZE,
+                                        IO_BUFFER_FLAG_PHYSICALLY_CONTIGUOUS);
+
+        if (Port->LogIoBuffer == NULL) {
+            return;
+        }
+    }
+
+    if (Port->RecoveryEvent == NULL) {
+        Port->RecoveryEvent = KeCreateEvent(NULL);
+        if (Port->RecoveryEvent == NULL) {
+            return;
+        }
+    }
+
+    if (Port->RecoveryWorkItem == NULL) {
+        Port->RecoveryWorkItem = KeCreateWorkItem(
+                                    NULL,
+                                    WorkPriorityNormal,
+                                    AhcipRecoverQueuedErrorWorker,
+                                    Port,
+                                    AHCI_ALLOCATION_TAG);
+
+        if (Port->RecoveryWorkItem == NULL) {
+            return;
+        }
+    }
+
+    if (QueueDepth >= 32) {
+        Port->CommandMask = MAX_ULONG;
+
+    } else {
+        Port->CommandMask = (1 << QueueDepth) - 1;
+    }
+
+    Port->Flags |= AHCI_PORT_NATIVE_COMMAND_QUEUING;
+    return;
+}
+
+VOID
+AhcipBeginQueuedErrorRecovery (
+    PAHCI_PORT Port
+    )
+
+/*++
+
+Routine Description:
+
+    This routine starts recovery from an error while queued commands were
+    outstanding. The drive aborts every outstanding command when one of them
+    fails, and refuses new queued commands until its error log is read. This
+    routine sets the aborted commands aside, holds back new commands, and
+    queues the work item that restarts the port. This routine must be executed
+    at dispatch level with the DPC lock held for the port.
+
+Arguments:
+
+    Port - Supplies a pointer to the port.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    ASSERT(KeIsSpinLockHeld(&(Port->DpcLock)) != FALSE);
+    ASSERT((Port->Flags & AHCI_PORT_ERROR_RECOVERY) == 0);
+
+    RtlDebugPrint("AHCI: Queued command error %x, SERR %x, aborted %x\n",
+                  AHCI_READ(Port, AhciPortTaskFile),
+                  AHCI_READ(Port, AhciPortSataError),
+                  Port->PendingCommands);
+
+    Port->RecoveryCommands = Port->PendingCommands;
+    Port->RecoverySlot = -1;
+    Port->RecoveryGeneration += 1;
+    Port->PendingCommands = 0;
+    Port->QueuedCommands = 0;
+    Port->Flags |= AHCI_PORT_ERROR_RECOVERY;
+    KeQueueWorkItem(Port->RecoveryWorkItem);
+    return;
+}
+
+VOID
+AhcipRecoverQueuedErrorWorker (
+    PVOID Parameter
+    )
+
+/*++
+
+Routine Description:
+
+    This routine restarts a port after a queued command error and issues the
+    read of the queued command error log. The read completes through the
+    normal interrupt path, which finishes the recovery. If the read never
+    completes, this routine fails all the aborted commands.
+
+Arguments:
+
+    Parameter - Supplies a pointer to the port.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    ULONG Candidates;
+    ULONG Command;
+    PAHCI_COMMAND_TABLE CommandTable;
+    PSATA_FIS_REGISTER_H2D Fis;
+    ULONG Generation;
+    PAHCI_COMMAND_HEADER Header;
+    PUCHAR Log;
+    RUNLEVEL OldRunLevel;
+    PHYSICAL_ADDRESS PhysicalAddress;
+    PAHCI_PORT Port;
+    PAHCI_PRDT Prdt;
+    BOOL Recovering;
+    LONG Slot;
+    KSTATUS Status;
+    ULONG TaskFile;
+    ULONGLONG Time;
+    ULONGLONG Timeout;
+
+    Port = Parameter;
+
+    ASSERT(KeGetRunLevel() == RunLevelLow);
+
+    OldRunLevel = KeRaiseRunLevel(RunLevelDispatch);
+    KeAcquireSpinLock(&(Port->DpcLock));
+    Recovering = FALSE;
+    if (((Port->Flags & AHCI_PORT_ERROR_RECOVERY) != 0) &&
+        (Port->RecoverySlot < 0)) {
+
+        Recovering = TRUE;
+    }
+
+    Generation = Port->RecoveryGeneration;
+    KeReleaseSpinLock(&(Port->DpcLock));
+    KeLowerRunLevel(OldRunLevel);
+    if (Recovering == FALSE) {
+        return;
+    }
+
+    //
+    // Stopping the port clears the command issue and SATA active registers.
+    // Then clear out the error state. Nothing is issued while recovering, so
+    // the port can be poked without the lock.
+    //
+
+    Status = AhcipStopPort(Port);
+    if (!KSUCCESS(Status)) {
+        goto RecoverQueuedErrorWorkerEnd;
+    }
+
+    AHCI_WRITE(Port, AhciPortSataError, MAX_ULONG);
+    AHCI_WRITE(Port, AhciPortInterruptStatus, AHCI_INTERRUPT_ERROR_MASK);
+
+    //
+    // If the drive still looks busy, use command list override to clear the
+    // busy bits so the port can be restarted.
+    //
+
+    TaskFile = AHCI_READ(Port, AhciPortTaskFile);
+    if ((TaskFile &
+         (AHCI_PORT_TASK_BUSY | AHCI_PORT_TASK_DATA_REQUEST)) != 0) {
+
+        if ((AHCI_READ_GLOBAL(Port->Controller, AhciHostCapabilities) &
+             AHCI_HOST_CAPABILITY_COMMAND_LIST_OVERRIDE) == 0) {
+
+            Status = STATUS_DEVICE_IO_ERROR;
+            goto RecoverQueuedErrorWorkerEnd;
+        }
+
+        Command = AHCI_READ(Port, AhciPortCommand);
+        Command |= AHCI_PORT_COMMAND_COMMAND_LIST_OVERRIDE;
+        AHCI_WRITE(Port, AhciPortCommand, Command);
+        Time = HlQueryTimeCounter();
+        Timeout = Time + HlQueryTimeCounterFrequency();
+        Command = AHCI_READ(Port, AhciPortCommand);
+        while (((Command & AHCI_PORT_COMMAND_COMMAND_LIST_OVERRIDE) != 0) &&
+               (Time <= Timeout)) {
+
+            KeYield();
+            Command = AHCI_READ(Port, AhciPortCommand);
+            Time = HlQueryTimeCounter();
+        }
+
+        if ((Command & AHCI_PORT_COMMAND_COMMAND_LIST_OVERRIDE) != 0) {
+            Status = STATUS_TIMEOUT;
+            goto RecoverQueuedErrorWorkerEnd;
+        }
+    }
+
+    Command = AHCI_READ(Port, AhciPortCommand);
+    Command |= AHCI_PORT_COMMAND_START | AHCI_PORT_COMMAND_FIS_RX_ENABLE;
+    AHCI_WRITE(Port, AhciPortCommand, Command);
+
+    //
+    // Borrow a slot to read the error log. Aborted commands are rebuilt when
+    // they're resubmitted, so their slots are fair game. Otherwise use a free
+    // slot.
+    //
+
+    KeSignalEvent(Port->RecoveryEvent, SignalOptionUnsignal);
+    OldRunLevel = KeRaiseRunLevel(RunLevelDispatch);
+    KeAcquireSpinLock(&(Port->DpcLock));
+    if (((Port->Flags & AHCI_PORT_ERROR_RECOVERY) == 0) ||
+        (Port->RecoveryGeneration != Generation)) {
+
+        KeReleaseSpinLock(&(Port->DpcLock));
+        KeLowerRunLevel(OldRunLevel);
+        return;
+    }
+
+    Candidates = Port->RecoveryCommands |
+                 (Port->CommandMask & ~Port->AllocatedCommands);
+
+    if (Candidates == 0) {
+        AhcipFinishQueuedErrorRecovery(Port, STATUS_INSUFFICIENT_RESOURCES);
+        KeReleaseSpinLock(&(Port->DpcLock));
+        KeLowerRunLevel(OldRunLevel);
+        return;
+    }
+
+    Slot = RtlCountTrailingZeros32(Candidates);
+    if ((Port->RecoveryCommands & (1 << Slot)) == 0) {
+        RtlAtomicOr32(&(Port->AllocatedCommands), 1 << Slot);
+    }
+
+    Header = &(Port->Commands[Slot]);
+    CommandTable = &(Port->Tables[Slot]);
+    PhysicalAddress = Port->TablesPhysical +
+                      (sizeof(AHCI_COMMAND_TABLE) * Slot);
+
+    RtlZeroMemory(Header, sizeof(AHCI_COMMAND_HEADER));
+    Header->CommandTableLow = (ULONG)PhysicalAddress;
+    Header->CommandTableHigh = (ULONG)(PhysicalAddress >> 32);
+    Fis = (PSATA_FIS_REGISTER_H2D)CommandTable->CommandFis;
+    RtlZeroMemory(Fis, sizeof(CommandTable->CommandFis));
+    Fis->Type = SataFisRegisterH2d;
+    Fis->Flags = SATA_FIS_REGISTER_H2D_FLAG_COMMAND;
+    Fis->Command = AtaCommandReadLogExt;
+    Fis->Lba0 = ATA_LOG_NCQ_COMMAND_ERROR;
+    Fis->Device = ATA_DRIVE_SELECT_LBA;
+    SATA_SET_FIS_COUNT(Fis, 1);
+    Header->Control = AHCI_COMMAND_FIS_SIZE(sizeof(SATA_FIS_REGISTER_H2D));
+    Header->PrdtLength = 1;
+    Prdt = &(CommandTable->Prdt[0]);
+    PhysicalAddress = Port->LogIoBuffer->Fragment[0].PhysicalAddress;
+    Prdt->AddressLow = (ULONG)PhysicalAddress;
+    Prdt->AddressHigh = (ULONG)(PhysicalAddress >> 32);
+    Prdt->Reserved = 0;
+    Prdt->Count = ATA_SECTOR_SIZE - 1;
+    Log = Port->LogIoBuffer->Fragment[0].VirtualAddress;
+    RtlZeroMemory(Log, ATA_SECTOR_SIZE);
+    Port->CommandState[Slot].Queued = FALSE;
+    Port->RecoverySlot = Slot;
+    AhcipIssueCommand(Port, 1 << Slot);
+    KeReleaseSpinLock(&(Port->DpcLock));
+    KeLowerRunLevel(OldRunLevel);
+
+    //
+    // The interrupt path finishes recovery when the log read completes. Only
+    // step in if the drive never answers.
+    //
+
+    Status = KeWaitForEvent(Port->RecoveryEvent,
+                            FALSE,
+                            AHCI_ERROR_RECOVERY_TIMEOUT_MS);
+
+    if (KSUCCESS(Status)) {
+        return;
+    }
+
+    RtlDebugPrint("AHCI: Timed out reading NCQ error log.\n");
+    Status = AhcipStopPort(Port);
+    if (KSUCCESS(Status)) {
+        Command = AHCI_READ(Port, AhciPortCommand);
+        Command |= AHCI_PORT_COMMAND_START | AHCI_PORT_COMMAND_FIS_RX_ENABLE;
+        AHCI_WRITE(Port, AhciPortCommand, Command);
+    }
+
+    Status = STATUS_TIMEOUT;
+
+RecoverQueuedErrorWorkerEnd:
+
+    //
+    // Fail everything, unless recovery finished or was torn down meanwhile.
+    //
+
+    OldRunLevel = KeRaiseRunLevel(RunLevelDispatch);
+    KeAcquireSpinLock(&(Port->DpcLock));
+    if (((Port->Flags & AHCI_PORT_ERROR_RECOVERY) != 0) &&
+        (Port->RecoveryGeneration == Generation)) {
+
+        if (Port->RecoverySlot >= 0) {
+            Port->PendingCommands &= ~(1 << Port->RecoverySlot);
+        }
+
+        AhcipFinishQueuedErrorRecovery(Port, Status);
+    }
+
+    KeReleaseSpinLock(&(Port->DpcLock));
+    KeLowerRunLevel(OldRunLevel);
+    return;
+}
+
+VOID
+AhcipFinishQueuedErrorRecovery (
+    PAHCI_PORT Port,
+    KSTATUS Status
+    )
+
+/*++
+
+Routine Description:
+
+    This routine finishes queued command error recovery once the error log
+    has been read. It fails the command the log names, or all the aborted
+    commands if the log couldn't be read or names none, and resubmits the
+    rest. This routine must be executed at dispatch level with the DPC lock
+    held for the port.
+
+Arguments:
+
+    Port - Supplies a pointer to the port.
+
+    Status - Supplies the status of the error log read.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    ULONG Aborted;
+    ULONG Bit;
+    BOOL BorrowedSlot;
+    ULONG Failed;
+    PIRP Irp;
+    PUCHAR Log;
+    LONG Slot;
+
+    ASSERT(KeIsSpinLockHeld(&(Port->DpcLock)) != FALSE);
+    ASSERT((Port->Flags & AHCI_PORT_ERROR_RECOVERY) != 0);
+
+    Aborted = Port->RecoveryCommands;
+    Failed = Aborted;
+    Slot = Port->RecoverySlot;
+
+    ASSERT((Slot < 0) || ((Port->PendingCommands & (1 << Slot)) == 0));
+
+    BorrowedSlot = FALSE;
+    if ((Slot >= 0) && ((Aborted & (1 << Slot)) == 0)) {
+        BorrowedSlot = TRUE;
+    }
+
+    //
+    // If the log names a queued command, only that one failed. Otherwise the
+    // error can't be pinned on any one command, so fail them all.
+    //
+
+    if (KSUCCESS(Status)) {
+        Log = Port->LogIoBuffer->Fragment[0].VirtualAddress;
+        if ((Log[0] & ATA_NCQ_ERROR_LOG_NOT_QUEUED) == 0) {
+            Failed = Aborted & (1 << (Log[0] & ATA_NCQ_ERROR_LOG_TAG_MASK));
+        }
+
+    } else {
+        RtlDebugPrint("AHCI: Failed to read NCQ error log: %d\n", Status);
+    }
+
+    Port->Flags &= ~AHCI_PORT_ERROR_RECOVERY;
+    Port->RecoveryCommands = 0;
+    Port->RecoverySlot = -1;
+
+    //
+    // Fail the guilty commands and send the rest back to the drive.
+    //
+
+    while (Aborted != 0) {
+        Bit = RtlCountTrailingZeros32(Aborted);
+        Aborted &= ~(1 << Bit);
+        Irp = Port->CommandState[Bit].Irp;
+
+        ASSERT(Irp != NULL);
+
+        if ((Failed & (1 << Bit)) != 0) {
+            Port->CommandState[Bit].Irp = NULL;
+            Port->CommandState[Bit].IoSize = 0;
+            IoCompleteIrp(AhciDriver, Irp, STATUS_DEVICE_IO_ERROR);
+            AhcipBeginNextIrp(Port, Bit);
+
+        } else {
+            AhcipPerformDmaIo(Port, Irp, Bit);
+        }
+    }
+
+    //
+    // A free slot borrowed just for the log read goes back to work, or back
+    // to the pool.
+    //
+
+    if (BorrowedSlot != FALSE) {
+        Port->CommandState[Slot].Irp = NULL;
+        AhcipBeginNextIrp(Port, Slot);
+    }
+
+    KeSignalEvent(Port->RecoveryEvent, SignalOptionSignalAll);
+    if (Port->DeferredCommands != 0) {
+        AhcipIssueDeferredCommands(Port);
+    }
+
+    return;
+}
+
@@ -171,6 +171,12 @@ NetpDebugPrintNetworkAddress (
     PNETWORK_ADDRESS Address
     );
 
+BOOL
+NetpIsAddressInSubnet (
+    PNET_LINK_ADDRESS_ENTRY LinkAddress,
+    PNETWORK_ADDRESS Address
+    );
+
 USHORT
 NetpChecksumData (
     PVOID Data,
@@ -299,6 +305,19 @@ Return Value:
 
     INITIALIZE_LIST_HEAD(&(Link->MulticastGroupList));
 
+    //
+    // Bind the link to the packet buffer caches for its DMA constraints.
+    //
+
+    Link->BufferDomain = NetpGetBufferDomain(
+                                         Link->Properties.MaxPhysicalAddress,
+                                         Link->Properties.TransmitAlignment);
+
+    if (Link->BufferDomain == NULL) {
+        Status = STATUS_INSUFFICIENT_RESOURCES;
+        goto AddLinkEnd;
+    }
+
     //
     // Find the appropriate data link layer and initialize it for this link.
     //
@@ -1037,9 +1056,11 @@ Return Value:
     PLIST_ENTRY CurrentLinkEntry;
     NET_DOMAIN_TYPE Domain;
     PNET_LINK_ADDRESS_ENTRY FoundAddress;
+    PNET_LINK FoundLink;
     PNET_LINK Link;
     PNET_LINK_ADDRESS_ENTRY LinkAddress;
     PLIST_ENTRY LinkAddressList;
+    BOOL OnLink;
     KSTATUS Status;
 
     ASSERT(KeGetRunLevel() == RunLevelLow);
@@ -1054,6 +1075,8 @@ Return Value:
 
     Status = STATUS_NO_NETWORK_CONNECTION;
     FoundAddress = NULL;
+    FoundLink = NULL;
+    OnLink = FALSE;
     CurrentLinkEntry = NetLinkList.Next;
     while (CurrentLinkEntry != &NetLinkList) {
         Link = LIST_VALUE(CurrentLinkEntry, NET_LINK, ListEntry);
@@ -1076,6 +1099,10 @@ Return Value:
             continue;
         }
 
+        //
+        // A link address whose subnet contains the remote address wins
+        // outright. Otherwise settle for the first configured address on a
+        // link that can reach beyond itself, which rules out loopback.
         //
         // TODO: Properly determine the route for this destination, rather
         // than just connecting through the first working network link and
@@ -1084,53 +1111,58 @@ Return Value:
         //
 
         KeAcquireQueuedLock(Link->QueuedLock);
-        if (LIST_EMPTY(LinkAddressList) == FALSE) {
-            CurrentAddressEntry = LinkAddressList->Next;
-            while (CurrentAddressEntry != LinkAddressList) {
-                LinkAddress = LIST_VALUE(CurrentAddressEntry,
-                                         NET_LINK_ADDRESS_ENTRY,
-                                         ListEntry);
+        CurrentAddressEntry = LinkAddressList->Next;
+        while (CurrentAddressEntry != LinkAddressList) {
+            LinkAddress = LIST_VALUE(CurrentAddressEntry,
+                                     NET_LINK_ADDRESS_ENTRY,
+                                     ListEntry);
 
-                if (LinkAddress->State >= NetLinkAddressConfigured) {
-                    FoundAddress = LinkAddress;
-                    RtlCopyMemory(&(LinkResult->ReceiveAddress),
-                                  &(FoundAddress->Address),
-                                  sizeof(NETWORK_ADDRESS));
+            CurrentAddressEntry = CurrentAddressEntry->Next;
+            if (LinkAddress->State < NetLinkAddressConfigured) {
+                continue;
+            }
 
-                    RtlCopyMemory(&(LinkResult->SendAddress),
-                                  &(FoundAddress->Address),
-                                  sizeof(NETWORK_ADDRESS));
+            OnLink = NetpIsAddressInSubnet(LinkAddress, RemoteAddress);
+            if ((OnLink == FALSE) &&
+                ((FoundAddress != NULL) ||
+                 (NET_IS_LOOPBACK_LINK(Link) != FALSE))) {
 
-                    ASSERT(LinkResult->SendAddress.Port == 0);
+                continue;
+            }
 
-                    break;
-                }
+            FoundAddress = LinkAddress;
+            FoundLink = Link;
+            RtlCopyMemory(&(LinkResult->ReceiveAddress),
+                          &(FoundAddress->Address),
+                          sizeof(NETWORK_ADDRESS));
 
-                CurrentAddressEntry = CurrentAddressEntry->Next;
+            RtlCopyMemory(&(LinkResult->SendAddress),
+                          &(FoundAddress->Address),
+                          sizeof(NETWORK_ADDRESS));
+
+            ASSERT(LinkResult->SendAddress.Port == 0);
+
+            if (OnLink != FALSE) {
+                break;
             }
         }
 
         KeReleaseQueuedLock(Link->QueuedLock);
-
-        //
-        // If a suitable link address was not found, continue on to the next
-        // link.
-        //
-
-        if (FoundAddress == NULL) {
-            continue;
+        if (OnLink != FALSE) {
+            break;
         }
+    }
 
-        //
-        // Fill out the link information. The local address was copied above
-        // under the lock in order to prevent a torn read.
-        //
+    //
+    // Fill out the link information. The local address was copied above under
+    // the lock in order to prevent a torn read.
+    //
 
-        NetLinkAddReference(Link);
-        LinkResult->Link = Link;
+    if (FoundAddress != NULL) {
+        NetLinkAddReference(FoundLink);
+        LinkResult->Link = FoundLink;
         LinkResult->LinkAddress = FoundAddress;
         Status = STATUS_SUCCESS;
-        break;
     }
 
 FindLinkForDestinationAddressEnd:
@@ -4854,6 +4886,70 @@ Return Value:
     return;
 }
 
+BOOL
+NetpIsAddressInSubnet (
+    PNET_LINK_ADDRESS_ENTRY LinkAddress,
+    PNETWORK_ADDRESS Address
+    )
+
+/*++
+
+Routine Description:
+
+    This routine determines whether or not the given address falls within the
+    subnet of the given link address entry. The link's lock must be held.
+
+Arguments:
+
+    LinkAddress - Supplies a pointer to the configured link address entry.
+
+    Address - Supplies a pointer to the address to test.
+
+Return Value:
+
+    TRUE if the address is within the link address's subnet.
+
+    FALSE if the address is outside the subnet or the link address has no
+    subnet mask.
+
+--*/
+
+{
+
+    BOOL EmptySubnet;
+    ULONG Index;
+    UINTN Mask;
+
+    if ((LinkAddress->Subnet.Domain != Address->Domain) ||
+        (LinkAddress->Address.Domain != Address->Domain)) {
+
+        return FALSE;
+    }
+
+    EmptySubnet = TRUE;
+    for (Index = 0;
+         Index < (MAX_NETWORK_ADDRESS_SIZE / sizeof(UINTN));
+         Index += 1) {
+
+        Mask = LinkAddress->Subnet.Address[Index];
+        if (Mask != 0) {
+            EmptySubnet = FALSE;
+        }
+
+        if (((Address->Address[Index] ^ LinkAddress->Address.Address[Index]) &
+             Mask) != 0) {
+
+            return FALSE;
+        }
+    }
+
+    if (EmptySubnet != FALSE) {
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
 USHORT
 NetpChecksumData (
     PVOID Data,
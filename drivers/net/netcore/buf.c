@@ -37,24 +37,194 @@ Module Name:
 // ---------------------------------------------------------------- Definitions
 //
 
+//
+// Define the range of power of two buffer size classes that get cached.
+// Larger buffers are allocated exactly and destroyed when freed.
+//
+
+#define NET_BUFFER_MIN_CLASS_SHIFT 8
+#define NET_BUFFER_MAX_CLASS_SHIFT 16
+#define NET_BUFFER_CLASS_COUNT \
+    (NET_BUFFER_MAX_CLASS_SHIFT - NET_BUFFER_MIN_CLASS_SHIFT + 1)
+
+//
+// Define the number of buffers each processor can hold per size class, and
+// the number moved to or from the depot at once.
+//
+
+#define NET_BUFFER_MAGAZINE_SIZE 32
+#define NET_BUFFER_MAGAZINE_BATCH (NET_BUFFER_MAGAZINE_SIZE / 2)
+
+//
+// Define the number of bytes worth of buffers each size class depot holds on
+// to before freeing buffers back to the system, and the minimum count.
+//
+
+#define NET_BUFFER_DEPOT_BYTES (1024 * 1024)
+#define NET_BUFFER_DEPOT_MIN_COUNT NET_BUFFER_MAGAZINE_SIZE
+
 //
 // ------------------------------------------------------ Data Type Definitions
 //
 
+typedef struct _NET_BUFFER_DOMAIN NET_BUFFER_DOMAIN, *PNET_BUFFER_DOMAIN;
+
+/*++
+
+Structure Description:
+
+    This structure defines a processor's private stash of free buffers of a
+    single size class. It is only touched at dispatch level on its owning
+    processor.
+
+Members:
+
+    Count - Stores the number of valid entries in the buffers array.
+
+    Buffers - Stores the array of free buffers.
+
+--*/
+
+typedef struct _NET_BUFFER_MAGAZINE {
+    ULONG Count;
+    PNET_PACKET_BUFFER Buffers[NET_BUFFER_MAGAZINE_SIZE];
+} NET_BUFFER_MAGAZINE, *PNET_BUFFER_MAGAZINE;
+
+/*++
+
+Structure Description:
+
+    This structure defines the shared state for a single size class of a
+    buffer domain.
+
+Members:
+
+    Domain - Stores a pointer back to the owning domain.
+
+    Class - Stores the size class index.
+
+    Size - Stores the size of every buffer in this class, in bytes.
+
+    DepotLock - Stores a pointer to the lock protecting the depot list.
+
+    DepotList - Stores the list of free buffers shared by all processors.
+
+    DepotCount - Stores the number of buffers on the depot list.
+
+    DepotMax - Stores the maximum number of buffers the depot will hold.
+
+--*/
+
+typedef struct _NET_BUFFER_CACHE {
+    PNET_BUFFER_DOMAIN Domain;
+    ULONG Class;
+    ULONG Size;
+    PQUEUED_LOCK DepotLock;
+    LIST_ENTRY DepotList;
+    ULONG DepotCount;
+    ULONG DepotMax;
+} NET_BUFFER_CACHE, *PNET_BUFFER_CACHE;
+
+/*++
+
+Structure Description:
+
+    This structure defines a set of buffer caches whose buffers all satisfy
+    the same physical memory constraints.
+
+Members:
+
+    ListEntry - Stores pointers to the next and previous domains.
+
+    MaxPhysicalAddress - Stores the maximum physical address buffers may use.
+
+    Alignment - Stores the physical alignment of every buffer.
+
+    PhysicallyContiguous - Stores a boolean indicating whether buffers are
+        backed by physically contiguous non-paged memory (TRUE) or by paged
+        pool (FALSE).
+
+    Caches - Stores the array of size classes.
+
+    ProcessorCount - Stores the number of processors that have magazines.
+
+    Magazines - Stores a pointer to the array of magazines, indexed by
+        processor number times the class count plus the class index.
+
+--*/
+
+struct _NET_BUFFER_DOMAIN {
+    LIST_ENTRY ListEntry;
+    PHYSICAL_ADDRESS MaxPhysicalAddress;
+    ULONG Alignment;
+    BOOL PhysicallyContiguous;
+    NET_BUFFER_CACHE Caches[NET_BUFFER_CLASS_COUNT];
+    ULONG ProcessorCount;
+    PNET_BUFFER_MAGAZINE Magazines;
+};
+
 //
 // ----------------------------------------------- Internal Function Prototypes
 //
 
+PNET_BUFFER_DOMAIN
+NetpCreateBufferDomain (
+    PHYSICAL_ADDRESS MaxPhysicalAddress,
+    ULONG Alignment,
+    BOOL PhysicallyContiguous
+    );
+
+VOID
+NetpDestroyBufferDomain (
+    PNET_BUFFER_DOMAIN Domain
+    );
+
+PNET_PACKET_BUFFER
+NetpCacheAllocateBuffer (
+    PNET_BUFFER_CACHE Cache
+    );
+
+VOID
+NetpCacheFreeBuffer (
+    PNET_BUFFER_CACHE Cache,
+    PNET_PACKET_BUFFER Buffer
+    );
+
+PNET_BUFFER_MAGAZINE
+NetpGetBufferMagazine (
+    PNET_BUFFER_CACHE Cache
+    );
+
+VOID
+NetpSpillBuffers (
+    PNET_BUFFER_CACHE Cache,
+    PNET_PACKET_BUFFER *Buffers,
+    ULONG Count
+    );
+
+PNET_PACKET_BUFFER
+NetpCreatePacketBuffer (
+    PNET_BUFFER_DOMAIN Domain,
+    ULONG Size
+    );
+
+VOID
+NetpDestroyPacketBuffer (
+    PNET_PACKET_BUFFER Buffer
+    );
+
 //
 // -------------------------------------------------------------------- Globals
 //
 
 //
-// Store a pointer to the global list of network buffers.
+// Store the list of buffer domains, the lock protecting it, and the domain
+// used for buffers not bound to a link.
 //
 
-LIST_ENTRY NetFreeBufferList;
-PQUEUED_LOCK NetBufferListLock;
+LIST_ENTRY NetBufferDomainList;
+PQUEUED_LOCK NetBufferDomainLock;
+PNET_BUFFER_DOMAIN NetPagedBufferDomain;
 
 //
 // ------------------------------------------------------------------ Functions
@@ -111,15 +281,11 @@ Return Value:
 
     ULONG Alignment;
     PNET_PACKET_BUFFER Buffer;
-    PHYSICAL_ADDRESS BufferPhysical;
-    ULONGLONG BufferSize;
-    PLIST_ENTRY CurrentEntry;
+    ULONG Class;
     PNET_DATA_LINK_ENTRY DataLinkEntry;
     ULONG DataLinkMask;
     ULONG DataSize;
-    ULONG IoBufferFlags;
-    BOOL LockHeld;
-    PHYSICAL_ADDRESS MaximumPhysicalAddress;
+    PNET_BUFFER_DOMAIN Domain;
     ULONG MinPacketSize;
     ULONG PacketSizeFlags;
     ULONG Padding;
@@ -167,22 +333,17 @@ Return Value:
             }
         }
 
-        Alignment = Link->Properties.TransmitAlignment;
-        if (Alignment == 0) {
-            Alignment = 1;
-        }
-
-        ASSERT(POWER_OF_2(Alignment));
-
-        MaximumPhysicalAddress = Link->Properties.MaxPhysicalAddress;
+        Domain = Link->BufferDomain;
         MinPacketSize = Link->Properties.PacketSizeInformation.MinPacketSize;
 
     } else {
-        Alignment = 1;
-        MaximumPhysicalAddress = MAX_UINTN;
+        Domain = NetPagedBufferDomain;
         MinPacketSize = 0;
     }
 
+    ASSERT(Domain != NULL);
+
+    Alignment = Domain->Alignment;
     DataSize = HeaderSize + Size + FooterSize;
 
     //
@@ -199,122 +360,50 @@ Return Value:
     TotalSize = ALIGN_RANGE_UP(TotalSize, Alignment);
 
     //
-    // Loop through the list looking for the first buffer that fits.
+    // Pick the smallest size class that fits. Requests too big for any class
+    // get an exactly sized buffer that is not recycled.
     //
 
-    KeAcquireQueuedLock(NetBufferListLock);
-    LockHeld = TRUE;
-    CurrentEntry = NetFreeBufferList.Next;
-    while (CurrentEntry != &NetFreeBufferList) {
-        Buffer = LIST_VALUE(CurrentEntry, NET_PACKET_BUFFER, ListEntry);
-        CurrentEntry = CurrentEntry->Next;
-        BufferSize = Buffer->IoBuffer->Fragment[0].Size;
-        if (BufferSize < TotalSize) {
-            continue;
-        }
-
-        BufferPhysical = Buffer->IoBuffer->Fragment[0].PhysicalAddress;
-        if (Link == NULL) {
-            if (BufferPhysical != INVALID_PHYSICAL_ADDRESS) {
-                continue;
-            }
-
-        } else {
-            if ((BufferPhysical == INVALID_PHYSICAL_ADDRESS) ||
-                ((BufferPhysical + BufferSize) > MaximumPhysicalAddress) ||
-                (ALIGN_RANGE_DOWN(BufferPhysical, Alignment) !=
-                 BufferPhysical)) {
-
-                continue;
-            }
-        }
+    Class = 0;
+    while ((Class < NET_BUFFER_CLASS_COUNT) &&
+           (Domain->Caches[Class].Size < TotalSize)) {
 
-        LIST_REMOVE(&(Buffer->ListEntry));
-        Status = STATUS_SUCCESS;
-        goto AllocateBufferEnd;
+        Class += 1;
     }
 
-    KeReleaseQueuedLock(NetBufferListLock);
-    LockHeld = FALSE;
+    if (Class < NET_BUFFER_CLASS_COUNT) {
+        Buffer = NetpCacheAllocateBuffer(&(Domain->Caches[Class]));
 
-    //
-    // Allocate a network packet buffer, but do not bother to zero it. This
-    // routine takes care to initialize all the necessary fields before it is
-    // used.
-    //
-
-    Buffer = MmAllocatePagedPool(sizeof(NET_PACKET_BUFFER),
-                                 NET_CORE_ALLOCATION_TAG);
+    } else {
+        Buffer = NetpCreatePacketBuffer(Domain, TotalSize);
+    }
 
     if (Buffer == NULL) {
         Status = STATUS_INSUFFICIENT_RESOURCES;
         goto AllocateBufferEnd;
     }
 
-    //
-    // A buffer will need to be allocated.
-    //
-
-    if (Link != NULL) {
-        IoBufferFlags = IO_BUFFER_FLAG_PHYSICALLY_CONTIGUOUS;
-        Buffer->IoBuffer = MmAllocateNonPagedIoBuffer(0,
-                                                      MaximumPhysicalAddress,
-                                                      Alignment,
-                                                      TotalSize,
-                                                      IoBufferFlags);
-
-    } else {
-        Buffer->IoBuffer = MmAllocatePagedIoBuffer(TotalSize, 0);
+    Buffer->Flags = 0;
+    if ((Flags & NET_ALLOCATE_BUFFER_FLAG_UNENCRYPTED) != 0) {
+        Buffer->Flags |= NET_PACKET_FLAG_UNENCRYPTED;
     }
 
-    if (Buffer->IoBuffer == NULL) {
-        Status = STATUS_INSUFFICIENT_RESOURCES;
-        goto AllocateBufferEnd;
-    }
+    Buffer->BufferSize = TotalSize;
+    Buffer->DataSize = DataSize;
+    Buffer->DataOffset = HeaderSize;
+    Buffer->FooterOffset = Buffer->DataOffset + Size;
 
-    ASSERT(Buffer->IoBuffer->FragmentCount == 1);
+    //
+    // If padding was added to the packet, then zero it.
+    //
 
-    Buffer->BufferPhysicalAddress =
-                                 Buffer->IoBuffer->Fragment[0].PhysicalAddress;
+    if (Padding != 0) {
+        RtlZeroMemory(Buffer->Buffer + DataSize, Padding);
+    }
 
-    Buffer->Buffer = Buffer->IoBuffer->Fragment[0].VirtualAddress;
     Status = STATUS_SUCCESS;
 
 AllocateBufferEnd:
-    if (LockHeld != FALSE) {
-        KeReleaseQueuedLock(NetBufferListLock);
-    }
-
-    if (!KSUCCESS(Status)) {
-        if (Buffer != NULL) {
-            if (Buffer->IoBuffer != NULL) {
-                MmFreeIoBuffer(Buffer->IoBuffer);
-            }
-
-            MmFreePagedPool(Buffer);
-            Buffer = NULL;
-        }
-
-    } else {
-        Buffer->Flags = 0;
-        if ((Flags & NET_ALLOCATE_BUFFER_FLAG_UNENCRYPTED) != 0) {
-            Buffer->Flags |= NET_PACKET_FLAG_UNENCRYPTED;
-        }
-
-        Buffer->BufferSize = TotalSize;
-        Buffer->DataSize = DataSize;
-        Buffer->DataOffset = HeaderSize;
-        Buffer->FooterOffset = Buffer->DataOffset + Size;
-
-        //
-        // If padding was added to the packet, then zero it.
-        //
-
-        if (Padding != 0) {
-            RtlZeroMemory(Buffer->Buffer + DataSize, Padding);
-        }
-    }
-
     *NewBuffer = Buffer;
     return Status;
 }
@@ -344,9 +433,13 @@ Return Value:
 
 {
 
-    KeAcquireQueuedLock(NetBufferListLock);
-    INSERT_AFTER(&(Buffer->ListEntry), &NetFreeBufferList);
-    KeReleaseQueuedLock(NetBufferListLock);
+    if (Buffer->Cache == NULL) {
+        NetpDestroyPacketBuffer(Buffer);
+
+    } else {
+        NetpCacheFreeBuffer(Buffer->Cache, Buffer);
+    }
+
     return;
 }
 
@@ -412,15 +505,107 @@ Return Value:
 
 {
 
-    INITIALIZE_LIST_HEAD(&NetFreeBufferList);
-    NetBufferListLock = KeCreateQueuedLock();
-    if (NetBufferListLock == NULL) {
+    INITIALIZE_LIST_HEAD(&NetBufferDomainList);
+    NetBufferDomainLock = KeCreateQueuedLock();
+    if (NetBufferDomainLock == NULL) {
+        return STATUS_INSUFFICIENT_RESOURCES;
+    }
+
+    NetPagedBufferDomain = NetpCreateBufferDomain(MAX_ULONGLONG, 1, FALSE);
+    if (NetPagedBufferDomain == NULL) {
         return STATUS_INSUFFICIENT_RESOURCES;
     }
 
     return STATUS_SUCCESS;
 }
 
+PVOID
+NetpGetBufferDomain (
+    PHYSICAL_ADDRESS MaxPhysicalAddress,
+    ULONG Alignment
+    )
+
+/*++
+
+Routine Description:
+
+    This routine returns the set of packet buffer caches for physically
+    contiguous buffers with the given constraints, creating it if necessary.
+
+Arguments:
+
+    MaxPhysicalAddress - Supplies the maximum physical address buffers in the
+        domain may use.
+
+    Alignment - Supplies the required physical alignment of the buffers.
+
+Return Value:
+
+    Returns a pointer to the buffer domain on success.
+
+    NULL on allocation failure.
+
+--*/
+
+{
+
+    PLIST_ENTRY CurrentEntry;
+    PNET_BUFFER_DOMAIN Domain;
+    PNET_BUFFER_DOMAIN NewDomain;
+
+    ASSERT(KeGetRunLevel() == RunLevelLow);
+
+    if (Alignment == 0) {
+        Alignment = 1;
+    }
+
+    ASSERT(POWER_OF_2(Alignment));
+
+    //
+    // Create the domain optimistically outside the lock, as most links in a
+    // system share constraints and the search usually succeeds.
+    //
+
+    NewDomain = NULL;
+    KeAcquireQueuedLock(NetBufferDomainLock);
+    while (TRUE) {
+        CurrentEntry = NetBufferDomainList.Next;
+        while (CurrentEntry != &NetBufferDomainList) {
+            Domain = LIST_VALUE(CurrentEntry, NET_BUFFER_DOMAIN, ListEntry);
+            CurrentEntry = CurrentEntry->Next;
+            if ((Domain->PhysicallyContiguous != FALSE) &&
+                (Domain->MaxPhysicalAddress == MaxPhysicalAddress) &&
+                (Domain->Alignment == Alignment)) {
+
+                goto GetBufferDomainEnd;
+            }
+        }
+
+        if (NewDomain != NULL) {
+            Domain = NewDomain;
+            NewDomain = NULL;
+            INSERT_BEFORE(&(Domain->ListEntry), &NetBufferDomainList);
+            goto GetBufferDomainEnd;
+        }
+
+        KeReleaseQueuedLock(NetBufferDomainLock);
+        NewDomain = NetpCreateBufferDomain(MaxPhysicalAddress, Alignment, TRUE);
+        if (NewDomain == NULL) {
+            return NULL;
+        }
+
+        KeAcquireQueuedLock(NetBufferDomainLock);
+    }
+
+GetBufferDomainEnd:
+    KeReleaseQueuedLock(NetBufferDomainLock);
+    if (NewDomain != NULL) {
+        NetpDestroyBufferDomain(NewDomain);
+    }
+
+    return Domain;
+}
+
 VOID
 NetpDestroyBuffers (
     VOID
@@ -445,8 +630,25 @@ Return Value:
 
 {
 
-    if (NetBufferListLock != NULL) {
-        KeDestroyQueuedLock(NetBufferListLock);
+    PNET_BUFFER_DOMAIN Domain;
+
+    if (NetPagedBufferDomain != NULL) {
+        NetpDestroyBufferDomain(NetPagedBufferDomain);
+        NetPagedBufferDomain = NULL;
+    }
+
+    if (NetBufferDomainLock != NULL) {
+        while (LIST_EMPTY(&NetBufferDomainList) == FALSE) {
+            Domain = LIST_VALUE(NetBufferDomainList.Next,
+                                NET_BUFFER_DOMAIN,
+                                ListEntry);
+
+            LIST_REMOVE(&(Domain->ListEntry));
+            NetpDestroyBufferDomain(Domain);
+        }
+
+        KeDestroyQueuedLock(NetBufferDomainLock);
+        NetBufferDomainLock = NULL;
     }
 
     return;
@@ -456,3 +658,534 @@ Return Value:
 // --------------------------------------------------------- Internal Functions
 //
 
+PNET_BUFFER_DOMAIN
+NetpCreateBufferDomain (
+    PHYSICAL_ADDRESS MaxPhysicalAddress,
+    ULONG Alignment,
+    BOOL PhysicallyContiguous
+    )
+
+/*++
+
+Routine Description:
+
+    This routine creates a new buffer domain, including its per-processor
+    magazines.
+
+Arguments:
+
+    MaxPhysicalAddress - Supplies the maximum physical address buffers in the
+        domain may use.
+
+    Alignment - Supplies the required physical alignment of the buffers.
+
+    PhysicallyContiguous - Supplies a boolean indicating whether buffers should
+        be backed by physically contiguous non-paged memory (TRUE) or by
+        paged pool (FALSE).
+
+Return Value:
+
+    Returns a pointer to the new domain on success.
+
+    NULL on allocation failure.
+
+--*/
+
+{
+
+    UINTN AllocationSize;
+    PNET_BUFFER_CACHE Cache;
+    ULONG Class;
+    PNET_BUFFER_DOMAIN Domain;
+    ULONG ProcessorCount;
+    KSTATUS Status;
+
+    Status = STATUS_INSUFFICIENT_RESOURCES;
+    Domain = MmAllocateNonPagedPool(sizeof(NET_BUFFER_DOMAIN),
+                                    NET_CORE_ALLOCATION_TAG);
+
+    if (Domain == NULL) {
+        goto CreateBufferDomainEnd;
+    }
+
+    RtlZeroMemory(Domain, sizeof(NET_BUFFER_DOMAIN));
+    Domain->MaxPhysicalAddress = MaxPhysicalAddress;
+    Domain->Alignment = Alignment;
+    Domain->PhysicallyContiguous = PhysicallyContiguous;
+    for (Class = 0; Class < NET_BUFFER_CLASS_COUNT; Class += 1) {
+        Cache = &(Domain->Caches[Class]);
+        Cache->Domain = Domain;
+        Cache->Class = Class;
+        Cache->Size = 1 << (Class + NET_BUFFER_MIN_CLASS_SHIFT);
+        INITIALIZE_LIST_HEAD(&(Cache->DepotList));
+        Cache->DepotMax = NET_BUFFER_DEPOT_BYTES / Cache->Size;
+        if (Cache->DepotMax < NET_BUFFER_DEPOT_MIN_COUNT) {
+            Cache->DepotMax = NET_BUFFER_DEPOT_MIN_COUNT;
+        }
+
+        Cache->DepotLock = KeCreateQueuedLock();
+        if (Cache->DepotLock == NULL) {
+            goto CreateBufferDomainEnd;
+        }
+    }
+
+    //
+    // The magazines are touched at dispatch level, so they must be non-paged.
+    //
+
+    ProcessorCount = KeGetActiveProcessorCount();
+    AllocationSize = sizeof(NET_BUFFER_MAGAZINE) * ProcessorCount *
+                     NET_BUFFER_CLASS_COUNT;
+
+    Domain->Magazines = MmAllocateNonPagedPool(AllocationSize,
+                                               NET_CORE_ALLOCATION_TAG);
+
+    if (Domain->Magazines == NULL) {
+        goto CreateBufferDomainEnd;
+    }
+
+    RtlZeroMemory(Domain->Magazines, AllocationSize);
+    Domain->ProcessorCount = ProcessorCount;
+    Status = STATUS_SUCCESS;
+
+CreateBufferDomainEnd:
+    if (!KSUCCESS(Status)) {
+        if (Domain != NULL) {
+            NetpDestroyBufferDomain(Domain);
+            Domain = NULL;
+        }
+    }
+
+    return Domain;
+}
+
+VOID
+NetpDestroyBufferDomain (
+    PNET_BUFFER_DOMAIN Domain
+    )
+
+/*++
+
+Routine Description:
+
+    This routine destroys a buffer domain and every free buffer it holds. The
+    domain must not be in use.
+
+Arguments:
+
+    Domain - Supplies a pointer to the domain to destroy.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PNET_PACKET_BUFFER Buffer;
+    PNET_BUFFER_CACHE Cache;
+    ULONG Class;
+    ULONG Index;
+    PNET_BUFFER_MAGAZINE Magazine;
+    ULONG MagazineCount;
+
+    if (Domain->Magazines != NULL) {
+        MagazineCount = Domain->ProcessorCount * NET_BUFFER_CLASS_COUNT;
+        for (Index = 0; Index < MagazineCount; Index += 1) {
+            Magazine = &(Domain->Magazines[Index]);
+            while (Magazine->Count != 0) {
+                Magazine->Count -= 1;
+                NetpDestroyPacketBuffer(Magazine->Buffers[Magazine->Count]);
+            }
+        }
+
+        MmFreeNonPagedPool(Domain->Magazines);
+    }
+
+    for (Class = 0; Class < NET_BUFFER_CLASS_COUNT; Class += 1) {
+        Cache = &(Domain->Caches[Class]);
+        if (Cache->DepotLock == NULL) {
+            continue;
+        }
+
+        while (LIST_EMPTY(&(Cache->DepotList)) == FALSE) {
+            Buffer = LIST_VALUE(Cache->DepotList.Next,
+                                NET_PACKET_BUFFER,
+                                ListEntry);
+
+            LIST_REMOVE(&(Buffer->ListEntry));
+            NetpDestroyPacketBuffer(Buffer);
+        }
+
+        KeDestroyQueuedLock(Cache->DepotLock);
+    }
+
+    MmFreeNonPagedPool(Domain);
+    return;
+}
+
+PNET_PACKET_BUFFER
+NetpCacheAllocateBuffer (
+    PNET_BUFFER_CACHE Cache
+    )
+
+/*++
+
+Routine Description:
+
+    This routine allocates a buffer from a size class. It first tries the
+    current processor's magazine without taking any locks, then refills the
+    magazine from the shared depot, and finally creates a new buffer.
+
+Arguments:
+
+    Cache - Supplies a pointer to the size class to allocate from.
+
+Return Value:
+
+    Returns a pointer to the buffer on success.
+
+    NULL on allocation failure.
+
+--*/
+
+{
+
+    PNET_PACKET_BUFFER Batch[NET_BUFFER_MAGAZINE_BATCH];
+    PNET_PACKET_BUFFER Buffer;
+    ULONG Count;
+    ULONG Index;
+    PNET_BUFFER_MAGAZINE Magazine;
+    RUNLEVEL OldRunLevel;
+
+    //
+    // Raising to dispatch pins the thread to this processor, which makes the
+    // magazine private for the duration.
+    //
+
+    Buffer = NULL;
+    OldRunLevel = KeRaiseRunLevel(RunLevelDispatch);
+    Magazine = NetpGetBufferMagazine(Cache);
+    if ((Magazine != NULL) && (Magazine->Count != 0)) {
+        Magazine->Count -= 1;
+        Buffer = Magazine->Buffers[Magazine->Count];
+    }
+
+    KeLowerRunLevel(OldRunLevel);
+    if (Buffer != NULL) {
+        return Buffer;
+    }
+
+    //
+    // Grab a batch from the depot. Hand out the first and stash the rest in
+    // the magazine of whatever processor this thread is now running on.
+    //
+
+    Count = 0;
+    KeAcquireQueuedLock(Cache->DepotLock);
+    while ((Count < NET_BUFFER_MAGAZINE_BATCH) &&
+           (LIST_EMPTY(&(Cache->DepotList)) == FALSE)) {
+
+        Batch[Count] = LIST_VALUE(Cache->DepotList.Next,
+                                  NET_PACKET_BUFFER,
+                                  ListEntry);
+
+        LIST_REMOVE(&(Batch[Count]->ListEntry));
+        Count += 1;
+    }
+
+    Cache->DepotCount -= Count;
+    KeReleaseQueuedLock(Cache->DepotLock);
+    if (Count == 0) {
+        return NetpCreatePacketBuffer(Cache->Domain, Cache->Size);
+    }
+
+    Buffer = Batch[0];
+    Index = 1;
+    if (Count > 1) {
+        OldRunLevel = KeRaiseRunLevel(RunLevelDispatch);
+        Magazine = NetpGetBufferMagazine(Cache);
+        if (Magazine != NULL) {
+            while ((Index < Count) &&
+                   (Magazine->Count < NET_BUFFER_MAGAZINE_SIZE)) {
+
+                Magazine->Buffers[Magazine->Count] = Batch[Index];
+                Magazine->Count += 1;
+                Index += 1;
+            }
+        }
+
+        KeLowerRunLevel(OldRunLevel);
+        if (Index < Count) {
+            NetpSpillBuffers(Cache, &(Batch[Index]), Count - Index);
+        }
+    }
+
+    return Buffer;
+}
+
+VOID
+NetpCacheFreeBuffer (
+    PNET_BUFFER_CACHE Cache,
+    PNET_PACKET_BUFFER Buffer
+    )
+
+/*++
+
+Routine Description:
+
+    This routine returns a buffer to its size class. The buffer goes into the
+    current processor's magazine if there is room. Otherwise half of the
+    magazine is moved to the shared depot to make room.
+
+Arguments:
+
+    Cache - Supplies a pointer to the size class the buffer belongs to.
+
+    Buffer - Supplies a pointer to the buffer to free.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PNET_PACKET_BUFFER Batch[NET_BUFFER_MAGAZINE_BATCH + 1];
+    ULONG Count;
+    PNET_BUFFER_MAGAZINE Magazine;
+    RUNLEVEL OldRunLevel;
+
+    Count = 0;
+    OldRunLevel = KeRaiseRunLevel(RunLevelDispatch);
+    Magazine = NetpGetBufferMagazine(Cache);
+    if (Magazine == NULL) {
+        Batch[Count] = Buffer;
+        Count += 1;
+
+    } else {
+        if (Magazine->Count == NET_BUFFER_MAGAZINE_SIZE) {
+            while (Count < NET_BUFFER_MAGAZINE_BATCH) {
+                Magazine->Count -= 1;
+                Batch[Count] = Magazine->Buffers[Magazine->Count];
+                Count += 1;
+            }
+        }
+
+        Magazine->Buffers[Magazine->Count] = Buffer;
+        Magazine->Count += 1;
+    }
+
+    KeLowerRunLevel(OldRunLevel);
+    if (Count != 0) {
+        NetpSpillBuffers(Cache, Batch, Count);
+    }
+
+    return;
+}
+
+PNET_BUFFER_MAGAZINE
+NetpGetBufferMagazine (
+    PNET_BUFFER_CACHE Cache
+    )
+
+/*++
+
+Routine Description:
+
+    This routine returns the current processor's magazine for the given size
+    class. This routine must be called at dispatch level.
+
+Arguments:
+
+    Cache - Supplies a pointer to the size class.
+
+Return Value:
+
+    Returns a pointer to the magazine.
+
+    NULL if the current processor came online after the domain was created
+    and therefore has no magazine.
+
+--*/
+
+{
+
+    PNET_BUFFER_DOMAIN Domain;
+    ULONG Processor;
+
+    ASSERT(KeGetRunLevel() == RunLevelDispatch);
+
+    Domain = Cache->Domain;
+    Processor = KeGetCurrentProcessorNumber();
+    if (Processor >= Domain->ProcessorCount) {
+        return NULL;
+    }
+
+    return &(Domain->Magazines[(Processor * NET_BUFFER_CLASS_COUNT) +
+                               Cache->Class]);
+}
+
+VOID
+NetpSpillBuffers (
+    PNET_BUFFER_CACHE Cache,
+    PNET_PACKET_BUFFER *Buffers,
+    ULONG Count
+    )
+
+/*++
+
+Routine Description:
+
+    This routine moves free buffers to a size class's shared depot, destroying
+    any that do not fit under the depot limit.
+
+Arguments:
+
+    Cache - Supplies a pointer to the size class.
+
+    Buffers - Supplies an array of free buffers.
+
+    Count - Supplies the number of elements in the array.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    ULONG Index;
+
+    Index = 0;
+    KeAcquireQueuedLock(Cache->DepotLock);
+    while ((Index < Count) && (Cache->DepotCount < Cache->DepotMax)) {
+        INSERT_AFTER(&(Buffers[Index]->ListEntry), &(Cache->DepotList));
+        Cache->DepotCount += 1;
+        Index += 1;
+    }
+
+    KeReleaseQueuedLock(Cache->DepotLock);
+    while (Index < Count) {
+        NetpDestroyPacketBuffer(Buffers[Index]);
+        Index += 1;
+    }
+
+    return;
+}
+
+PNET_PACKET_BUFFER
+NetpCreatePacketBuffer (
+    PNET_BUFFER_DOMAIN Domain,
+    ULONG Size
+    )
+
+/*++
+
+Routine Description:
+
+    This routine creates a new network packet buffer from the system. Buffers
+    whose size matches a size class are recycled into that class when freed.
+
+Arguments:
+
+    Domain - Supplies a pointer to the domain whose constraints the buffer
+        must meet.
+
+    Size - Supplies the size of the buffer in bytes.
+
+Return Value:
+
+    Returns a pointer to the new buffer on success.
+
+    NULL on allocation failure.
+
+--*/
+
+{
+
+    PNET_PACKET_BUFFER Buffer;
+    ULONG Class;
+    ULONG IoBufferFlags;
+
+    ASSERT(KeGetRunLevel() == RunLevelLow);
+
+    //
+    // Allocate a network packet buffer, but do not bother to zero it. The
+    // allocation routine takes care to initialize all the necessary fields
+    // before it is used.
+    //
+
+    Buffer = MmAllocatePagedPool(sizeof(NET_PACKET_BUFFER),
+                                 NET_CORE_ALLOCATION_TAG);
+
+    if (Buffer == NULL) {
+        return NULL;
+    }
+
+    if (Domain->PhysicallyContiguous != FALSE) {
+        IoBufferFlags = IO_BUFFER_FLAG_PHYSICALLY_CONTIGUOUS;
+        Buffer->IoBuffer = MmAllocateNonPagedIoBuffer(
+                                                  0,
+                                                  Domain->MaxPhysicalAddress,
+                                                  Domain->Alignment,
+                                                  Size,
+                                                  IoBufferFlags);
+
+    } else {
+        Buffer->IoBuffer = MmAllocatePagedIoBuffer(Size, 0);
+    }
+
+    if (Buffer->IoBuffer == NULL) {
+        MmFreePagedPool(Buffer);
+        return NULL;
+    }
+
+    ASSERT(Buffer->IoBuffer->FragmentCount == 1);
+
+    Buffer->BufferPhysicalAddress =
+                                 Buffer->IoBuffer->Fragment[0].PhysicalAddress;
+
+    Buffer->Buffer = Buffer->IoBuffer->Fragment[0].VirtualAddress;
+    Buffer->Cache = NULL;
+    for (Class = 0; Class < NET_BUFFER_CLASS_COUNT; Class += 1) {
+        if (Domain->Caches[Class].Size == Size) {
+            Buffer->Cache = &(Domain->Caches[Class]);
+            break;
+        }
+    }
+
+    return Buffer;
+}
+
+VOID
+NetpDestroyPacketBuffer (
+    PNET_PACKET_BUFFER Buffer
+    )
+
+/*++
+
+Routine Description:
+
+    This routine releases a network packet buffer back to the system.
+
+Arguments:
+
+    Buffer - Supplies a pointer to the buffer to destroy.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    MmFreeIoBuffer(Buffer->IoBuffer);
+    MmFreePagedPool(Buffer);
+    return;
+}
+
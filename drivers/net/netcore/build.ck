@@ -47,6 +47,7 @@ function build() {
         "ipv6/ip6.c",
         "ipv6/mld.c",
         "ipv6/ndp.c",
+        "loopback.c",
         "mcast.c",
         "netcore.c",
         "netlink/netlink.c",
@@ -55,6 +56,8 @@ function build() {
         "raw.c",
         "tcp.c",
         "tcpcong.c",
+        "tcpcubic.c",
+        "tcpsack.c",
         "udp.c"
     ];
 
@@ -457,9 +457,35 @@ Return Value:
 {
 
     PNET_LINK_ADDRESS_ENTRY AddressEntry;
+    IP4_ADDRESS DefaultGateway;
     IP4_ADDRESS InitialAddress;
     IP4_ADDRESS MulticastAddress;
     KSTATUS Status;
+    IP4_ADDRESS Subnet;
+
+    RtlZeroMemory((PNETWORK_ADDRESS)&InitialAddress, sizeof(NETWORK_ADDRESS));
+    InitialAddress.Domain = NetDomainIp4;
+    InitialAddress.Address = 0;
+
+    //
+    // The loopback link always owns 127.0.0.1/8 and never needs DHCP.
+    //
+
+    if (NET_IS_LOOPBACK_LINK(Link) != FALSE) {
+        InitialAddress.Address = CPU_TO_NETWORK32(IP4_LOOPBACK_ADDRESS);
+        RtlZeroMemory((PNETWORK_ADDRESS)&Subnet, sizeof(NETWORK_ADDRESS));
+        Subnet.Domain = NetDomainIp4;
+        Subnet.Address = CPU_TO_NETWORK32(IP4_LOOPBACK_SUBNET_MASK);
+        RtlZeroMemory((PNETWORK_ADDRESS)&DefaultGateway,
+                      sizeof(NETWORK_ADDRESS));
+
+        DefaultGateway.Domain = NetDomainIp4;
+        Status = NetCreateLinkAddressEntry(Link,
+                                           (PNETWORK_ADDRESS)&InitialAddress,
+                                           (PNETWORK_ADDRESS)&Subnet,
+                                           (PNETWORK_ADDRESS)&DefaultGateway,
+                                           TRUE,
+                                           &AddressEntry);
 
     //
     // A dummy address with only the network filled in is required, otherwise
@@ -467,15 +493,14 @@ Return Value:
     // address.
     //
 
-    RtlZeroMemory((PNETWORK_ADDRESS)&InitialAddress, sizeof(NETWORK_ADDRESS));
-    InitialAddress.Domain = NetDomainIp4;
-    InitialAddress.Address = 0;
-    Status = NetCreateLinkAddressEntry(Link,
-                                       (PNETWORK_ADDRESS)&InitialAddress,
-                                       NULL,
-                                       NULL,
-                                       FALSE,
-                                       &AddressEntry);
+    } else {
+        Status = NetCreateLinkAddressEntry(Link,
+                                           (PNETWORK_ADDRESS)&InitialAddress,
+                                           NULL,
+                                           NULL,
+                                           FALSE,
+                                           &AddressEntry);
+    }
 
     if (!KSUCCESS(Status)) {
         goto Ip4InitializeLinkEnd;
@@ -1382,11 +1407,12 @@ Return Value:
     // If this is a multicast address and the loopback bit is set, send the
     // packets back up the stack before sending them down. This needs to be
     // done first because the physical layer releases the packet structures
-    // when it's finished with them.
+    // when it's finished with them. The loopback link delivers them anyway.
     //
 
     if ((IP4_IS_MULTICAST_ADDRESS(RemoteAddress->Address) != FALSE) &&
-        ((Socket->Flags & NET_SOCKET_FLAG_MULTICAST_LOOPBACK) != 0)) {
+        ((Socket->Flags & NET_SOCKET_FLAG_MULTICAST_LOOPBACK) != 0) &&
+        (NET_IS_LOOPBACK_LINK(Link) == FALSE)) {
 
         RtlZeroMemory(&ReceiveContext, sizeof(NET_RECEIVE_CONTEXT));
         ReceiveContext.Link = Link;
@@ -1541,6 +1567,24 @@ Return Value:
         }
     }
 
+    //
+    // Addresses in the loopback network must never appear on the wire (RFC
+    // 1122 section 3.2.1.3). Drop them unless they came in on the loopback
+    // link itself, so remote hosts can't spoof local-only services.
+    //
+
+    if ((NET_IS_LOOPBACK_LINK(ReceiveContext->Link) == FALSE) &&
+        ((IP4_IS_LOOPBACK_ADDRESS(Header->SourceAddress) != FALSE) ||
+         (IP4_IS_LOOPBACK_ADDRESS(Header->DestinationAddress) != FALSE))) {
+
+        if (NetIp4DebugPrintPackets != FALSE) {
+            RtlDebugPrint("IP4: Dropping loopback packet on link 0x%x.\n",
+                          ReceiveContext->Link);
+        }
+
+        goto Ip4ProcessReceivedDataEnd;
+    }
+
     //
     // Initialize the network address.
     //
@@ -2347,6 +2391,20 @@ Return Value:
 
     KSTATUS Status;
 
+    //
+    // The loopback link's address is static and always valid while the link
+    // is up.
+    //
+
+    if (NET_IS_LOOPBACK_LINK(Link) != FALSE) {
+        if (Configure != FALSE) {
+            RtlAtomicExchange32(&(LinkAddress->State),
+                                NetLinkAddressConfiguredStatic);
+        }
+
+        return STATUS_SUCCESS;
+    }
+
     if (Configure != FALSE) {
         Status = NetpDhcpBeginAssignment(Link, LinkAddress);
 
@@ -2506,6 +2564,19 @@ Return Value:
         goto Ip4TranslateNetworkAddressEnd;
     }
 
+    //
+    // Everything sent down the loopback link comes straight back up it, so
+    // there is nothing to resolve.
+    //
+
+    if (NET_IS_LOOPBACK_LINK(Link) != FALSE) {
+        RtlCopyMemory(PhysicalAddress,
+                      &(Link->Properties.PhysicalAddress),
+                      sizeof(NETWORK_ADDRESS));
+
+        return STATUS_SUCCESS;
+    }
+
     //
     // Make sure the link address is still configured when using it.
     //
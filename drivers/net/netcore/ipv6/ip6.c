@@ -324,47 +324,73 @@ Return Value:
 
     PNET_LINK_ADDRESS_ENTRY AddressEntry;
     PUCHAR BytePointer;
+    IP6_ADDRESS DefaultGateway;
     IP6_ADDRESS InitialAddress;
     PUCHAR MacAddress;
     IP6_ADDRESS MulticastAddress;
     PNETWORK_ADDRESS PhysicalAddress;
     KSTATUS Status;
+    IP6_ADDRESS Subnet;
+
+    RtlZeroMemory((PNETWORK_ADDRESS)&InitialAddress, sizeof(NETWORK_ADDRESS));
+    InitialAddress.Domain = NetDomainIp6;
 
     //
-    // Initizlie a link address entry with an EUI-64 formatted link-local
-    // address.
+    // The loopback link is statically configured with ::1/128.
     //
 
-    PhysicalAddress = &(Link->Properties.PhysicalAddress);
+    if (NET_IS_LOOPBACK_LINK(Link) != FALSE) {
+        InitialAddress.Address[3] = CPU_TO_NETWORK32(0x00000001);
+        RtlZeroMemory((PNETWORK_ADDRESS)&Subnet, sizeof(NETWORK_ADDRESS));
+        Subnet.Domain = NetDomainIp6;
+        RtlSetMemory(Subnet.Address, 0xFF, IP6_ADDRESS_SIZE);
+        RtlZeroMemory((PNETWORK_ADDRESS)&DefaultGateway,
+                      sizeof(NETWORK_ADDRESS));
+
+        DefaultGateway.Domain = NetDomainIp6;
+        Status = NetCreateLinkAddressEntry(Link,
+                                           (PNETWORK_ADDRESS)&InitialAddress,
+                                           (PNETWORK_ADDRESS)&Subnet,
+                                           (PNETWORK_ADDRESS)&DefaultGateway,
+                                           TRUE,
+                                           &AddressEntry);
 
     //
-    // This currently only supports creating an EUI-64 based interface
-    // identifier from 48-bit MAC addresses. If a different data link layer is
-    // added, this work probably needs to be farmed out to each data link layer.
+    // Otherwise initialize a link address entry with an EUI-64 formatted
+    // link-local address.
     //
 
-    ASSERT((PhysicalAddress->Domain == NetDomainEthernet) ||
-           (PhysicalAddress->Domain == NetDomain80211));
+    } else {
+        PhysicalAddress = &(Link->Properties.PhysicalAddress);
 
-    MacAddress = (PUCHAR)(PhysicalAddress->Address);
-    RtlZeroMemory((PNETWORK_ADDRESS)&InitialAddress, sizeof(NETWORK_ADDRESS));
-    InitialAddress.Domain = NetDomainIp6;
-    BytePointer = (PUCHAR)(InitialAddress.Address);
-    BytePointer[15] = MacAddress[5];
-    BytePointer[14] = MacAddress[4];
-    BytePointer[13] = MacAddress[3];
-    BytePointer[12] = 0xFE;
-    BytePointer[11] = 0xFF;
-    BytePointer[10] = MacAddress[2];
-    BytePointer[9] = MacAddress[1];
-    BytePointer[8] = (MacAddress[0] & 0xFD) | (~MacAddress[0] & 0x02);
-    InitialAddress.Address[0] = CPU_TO_NETWORK32(IP6_LINK_LOCAL_PREFIX);
-    Status = NetCreateLinkAddressEntry(Link,
-                                       (PNETWORK_ADDRESS)&InitialAddress,
-                                       NULL,
-                                       NULL,
-                                       TRUE,
-                                       &AddressEntry);
+        //
+        // This currently only supports creating an EUI-64 based interface
+        // identifier from 48-bit MAC addresses. If a different data link
+        // layer is added, this work probably needs to be farmed out to each
+        // data link layer.
+        //
+
+        ASSERT((PhysicalAddress->Domain == NetDomainEthernet) ||
+               (PhysicalAddress->Domain == NetDomain80211));
+
+        MacAddress = (PUCHAR)(PhysicalAddress->Address);
+        BytePointer = (PUCHAR)(InitialAddress.Address);
+        BytePointer[15] = MacAddress[5];
+        BytePointer[14] = MacAddress[4];
+        BytePointer[13] = MacAddress[3];
+        BytePointer[12] = 0xFE;
+        BytePointer[11] = 0xFF;
+        BytePointer[10] = MacAddress[2];
+        BytePointer[9] = MacAddress[1];
+        BytePointer[8] = (MacAddress[0] & 0xFD) | (~MacAddress[0] & 0x02);
+        InitialAddress.Address[0] = CPU_TO_NETWORK32(IP6_LINK_LOCAL_PREFIX);
+        Status = NetCreateLinkAddressEntry(Link,
+                                           (PNETWORK_ADDRESS)&InitialAddress,
+                                           NULL,
+                                           NULL,
+                                           TRUE,
+                                           &AddressEntry);
+    }
 
     if (!KSUCCESS(Status)) {
         goto Ip6InitializeLinkEnd;
@@ -1116,11 +1142,12 @@ Return Value:
     // If this is a multicast address and the loopback bit is set, send the
     // packets back up the stack before sending them down. This needs to be
     // done first because the physical layer releases the packet structures
-    // when it's finished with them.
+    // when it's finished with them. The loopback link delivers them anyway.
     //
 
     if ((IP6_IS_MULTICAST_ADDRESS(RemoteAddress->Address) != FALSE) &&
-        ((Socket->Flags & NET_SOCKET_FLAG_MULTICAST_LOOPBACK) != 0)) {
+        ((Socket->Flags & NET_SOCKET_FLAG_MULTICAST_LOOPBACK) != 0) &&
+        (NET_IS_LOOPBACK_LINK(Link) == FALSE)) {
 
         RtlZeroMemory(&ReceiveContext, sizeof(NET_RECEIVE_CONTEXT));
         ReceiveContext.Link = Link;
@@ -1271,6 +1298,23 @@ Return Value:
                   &(Header->DestinationAddress),
                   IP6_ADDRESS_SIZE);
 
+    //
+    // The loopback address must never appear on the wire (RFC 4291 section
+    // 2.5.3). Drop it unless it came in on the loopback link itself.
+    //
+
+    if ((NET_IS_LOOPBACK_LINK(ReceiveContext->Link) == FALSE) &&
+        ((IP6_IS_LOOPBACK_ADDRESS(SourceAddress.Address) != FALSE) ||
+         (IP6_IS_LOOPBACK_ADDRESS(DestinationAddress.Address) != FALSE))) {
+
+        if (NetIp6DebugPrintPackets != FALSE) {
+            RtlDebugPrint("IP6: Dropping loopback packet on link 0x%x.\n",
+                          ReceiveContext->Link);
+        }
+
+        goto Ip6ProcessReceivedDataEnd;
+    }
+
     //
     // Update the packet's size. Raw sockets should get everything at the IPv6
     // layer. So, lop any footers beyond the IPv6 packet. IPv6 has no footer
@@ -2016,6 +2060,20 @@ Return Value:
     UINTN RequestSize;
     KSTATUS Status;
 
+    //
+    // The loopback link's address is static and always valid while the link
+    // is up.
+    //
+
+    if (NET_IS_LOOPBACK_LINK(Link) != FALSE) {
+        if (Configure != FALSE) {
+            RtlAtomicExchange32(&(LinkAddress->State),
+                                NetLinkAddressConfiguredStatic);
+        }
+
+        return STATUS_SUCCESS;
+    }
+
     //
     // ICMPv6 handles address configuration, hand off to the protocol.
     //
@@ -2173,6 +2231,19 @@ Return Value:
         goto Ip6TranslateNetworkAddressEnd;
     }
 
+    //
+    // Everything sent down the loopback link comes straight back up it, so
+    // there is nothing to resolve.
+    //
+
+    if (NET_IS_LOOPBACK_LINK(Link) != FALSE) {
+        RtlCopyMemory(PhysicalAddress,
+                      &(Link->Properties.PhysicalAddress),
+                      sizeof(NETWORK_ADDRESS));
+
+        return STATUS_SUCCESS;
+    }
+
     //
     // Well, it looks like a run-of-the-mill IP address, translate it.
     //
@@ -0,0 +1,1126 @@
+/*++
+
+Copyright (c) 2026 Minoca Corp.
+
+    This file is licensed under the terms of the GNU General Public License
+    version 3. Alternative licensing terms are available. Contact
+    info@minocacorp.com for details. See the LICENSE file at the root of this
+    project for complete licensing information.
+
+Module Name:
+
+    loopback.c
+
+Abstract:
+
+    This module implements the software loopback link. Packets sent down the
+    loopback link are handed back up the receive path as-is, without being
+    copied and without any checksums being computed or validated.
+
+Author:
+
+    Minoca Corp. 18-Oct-2026
+
+Environment:
+
+    Kernel
+
+--*/
+
+//
+// ------------------------------------------------------------------- Includes
+//
+
+#include <minoca/kernel/driver.h>
+#include "netcore.h"
+
+//
+// ---------------------------------------------------------------- Definitions
+//
+
+#define LOOPBACK_ALLOCATION_TAG 0x706F6F4C // 'pooL'
+
+//
+// The loopback data link header simply records the network protocol number
+// of the packet.
+//
+
+#define LOOPBACK_HEADER_SIZE sizeof(ULONG)
+
+//
+// Define the largest payload the loopback link will carry. This leaves room
+// for the headers in the largest packet buffer class.
+//
+
+#define LOOPBACK_MAXIMUM_PAYLOAD_SIZE (32 * _1KB)
+
+//
+// Define the maximum number of packets that can be waiting for the receive
+// worker before the link starts dropping them.
+//
+
+#define LOOPBACK_MAX_QUEUED_PACKETS 1024
+
+//
+// Define the speed reported for the loopback link.
+//
+
+#define LOOPBACK_LINK_SPEED 10000000000ULL
+
+//
+// Printed loopback addresses are just "lo". Include the null terminator.
+//
+
+#define LOOPBACK_STRING_LENGTH 3
+
+//
+// ------------------------------------------------------ Data Type Definitions
+//
+
+/*++
+
+Structure Description:
+
+    This structure defines the loopback device.
+
+Members:
+
+    OsDevice - Stores a pointer to the OS device.
+
+    NetworkLink - Stores a pointer to the core networking link.
+
+    Lock - Stores a pointer to the lock protecting the receive list and the
+        worker state.
+
+    ReceiveList - Stores the list of packets sent down the link that are
+        waiting to travel back up it.
+
+    WorkItem - Stores a pointer to the work item that drains the receive list.
+
+    WorkerActive - Stores a boolean indicating whether or not the work item
+        has been queued or is currently draining the receive list.
+
+--*/
+
+typedef struct _LOOPBACK_DEVICE {
+    PDEVICE OsDevice;
+    PNET_LINK NetworkLink;
+    PQUEUED_LOCK Lock;
+    NET_PACKET_LIST ReceiveList;
+    PWORK_ITEM WorkItem;
+    BOOL WorkerActive;
+} LOOPBACK_DEVICE, *PLOOPBACK_DEVICE;
+
+//
+// ----------------------------------------------- Internal Function Prototypes
+//
+
+KSTATUS
+NetpLoopbackAddDevice (
+    PVOID Driver,
+    PCSTR DeviceId,
+    PCSTR ClassId,
+    PCSTR CompatibleIds,
+    PVOID DeviceToken
+    );
+
+VOID
+NetpLoopbackDispatchStateChange (
+    PIRP Irp,
+    PVOID DeviceContext,
+    PVOID IrpContext
+    );
+
+VOID
+NetpLoopbackDispatchSystemControl (
+    PIRP Irp,
+    PVOID DeviceContext,
+    PVOID IrpContext
+    );
+
+KSTATUS
+NetpLoopbackStartDevice (
+    PLOOPBACK_DEVICE Device
+    );
+
+KSTATUS
+NetpLoopbackDeviceSend (
+    PVOID DeviceContext,
+    PNET_PACKET_LIST PacketList
+    );
+
+KSTATUS
+NetpLoopbackDeviceGetSetInformation (
+    PVOID DeviceContext,
+    NET_LINK_INFORMATION_TYPE InformationType,
+    PVOID Data,
+    PUINTN DataSize,
+    BOOL Set
+    );
+
+VOID
+NetpLoopbackDeviceDestroyLink (
+    PVOID DeviceContext
+    );
+
+VOID
+NetpLoopbackReceiveWorker (
+    PVOID Parameter
+    );
+
+KSTATUS
+NetpLoopbackInitializeLink (
+    PNET_LINK Link
+    );
+
+VOID
+NetpLoopbackDestroyLink (
+    PNET_LINK Link
+    );
+
+KSTATUS
+NetpLoopbackSend (
+    PVOID DataLinkContext,
+    PNET_PACKET_LIST PacketList,
+    PNETWORK_ADDRESS SourcePhysicalAddress,
+    PNETWORK_ADDRESS DestinationPhysicalAddress,
+    ULONG ProtocolNumber
+    );
+
+VOID
+NetpLoopbackProcessReceivedPacket (
+    PVOID DataLinkContext,
+    PNET_PACKET_BUFFER Packet
+    );
+
+KSTATUS
+NetpLoopbackConvertToPhysicalAddress (
+    PNETWORK_ADDRESS NetworkAddress,
+    PNETWORK_ADDRESS PhysicalAddress,
+    NET_ADDRESS_TYPE NetworkAddressType
+    );
+
+ULONG
+NetpLoopbackPrintAddress (
+    PNETWORK_ADDRESS Address,
+    PSTR Buffer,
+    ULONG BufferLength
+    );
+
+VOID
+NetpLoopbackGetPacketSizeInformation (
+    PVOID DataLinkContext,
+    PNET_PACKET_SIZE_INFORMATION PacketSizeInformation,
+    ULONG Flags
+    );
+
+//
+// -------------------------------------------------------------------- Globals
+//
+
+PDRIVER NetLoopbackDriver;
+
+//
+// ------------------------------------------------------------------ Functions
+//
+
+VOID
+NetpLoopbackInitialize (
+    PDRIVER Driver
+    )
+
+/*++
+
+Routine Description:
+
+    This routine initializes support for the loopback link. It registers the
+    loopback data link layer and makes the core networking driver the
+    function driver for the loopback device.
+
+Arguments:
+
+    Driver - Supplies a pointer to the core networking driver object.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    NET_DATA_LINK_ENTRY DataLinkEntry;
+    HANDLE DataLinkHandle;
+    DRIVER_FUNCTION_TABLE FunctionTable;
+    PNET_DATA_LINK_INTERFACE Interface;
+    KSTATUS Status;
+
+    DataLinkEntry.Domain = NetDomainLoopback;
+    Interface = &(DataLinkEntry.Interface);
+    Interface->InitializeLink = NetpLoopbackInitializeLink;
+    Interface->DestroyLink = NetpLoopbackDestroyLink;
+    Interface->Send = NetpLoopbackSend;
+    Interface->ProcessReceivedPacket = NetpLoopbackProcessReceivedPacket;
+    Interface->ConvertToPhysicalAddress = NetpLoopbackConvertToPhysicalAddress;
+    Interface->PrintAddress = NetpLoopbackPrintAddress;
+    Interface->GetPacketSizeInformation = NetpLoopbackGetPacketSizeInformation;
+    Status = NetRegisterDataLinkLayer(&DataLinkEntry, &DataLinkHandle);
+    if (!KSUCCESS(Status)) {
+
+        ASSERT(FALSE);
+
+        return;
+    }
+
+    NetLoopbackDriver = Driver;
+    RtlZeroMemory(&FunctionTable, sizeof(DRIVER_FUNCTION_TABLE));
+    FunctionTable.Version = DRIVER_FUNCTION_TABLE_VERSION;
+    FunctionTable.AddDevice = NetpLoopbackAddDevice;
+    FunctionTable.DispatchStateChange = NetpLoopbackDispatchStateChange;
+    FunctionTable.DispatchSystemControl = NetpLoopbackDispatchSystemControl;
+    Status = IoRegisterDriverFunctions(Driver, &FunctionTable);
+    if (!KSUCCESS(Status)) {
+
+        ASSERT(FALSE);
+
+    }
+
+    return;
+}
+
+//
+// --------------------------------------------------------- Internal Functions
+//
+
+KSTATUS
+NetpLoopbackAddDevice (
+    PVOID Driver,
+    PCSTR DeviceId,
+    PCSTR ClassId,
+    PCSTR CompatibleIds,
+    PVOID DeviceToken
+    )
+
+/*++
+
+Routine Description:
+
+    This routine is called when the loopback device is detected. The core
+    networking driver acts as its function driver and attaches itself to the
+    stack.
+
+Arguments:
+
+    Driver - Supplies a pointer to the driver being called.
+
+    DeviceId - Supplies a pointer to a string with the device ID.
+
+    ClassId - Supplies a pointer to a string containing the device's class ID.
+
+    CompatibleIds - Supplies a pointer to a string containing device IDs
+        that would be compatible with this device.
+
+    DeviceToken - Supplies an opaque token that the driver can use to identify
+        the device in the system. This token should be used when attaching to
+        the stack.
+
+Return Value:
+
+    STATUS_SUCCESS on success.
+
+    Failure code if the driver was unsuccessful in attaching itself.
+
+--*/
+
+{
+
+    PLOOPBACK_DEVICE Device;
+    KSTATUS Status;
+
+    Device = MmAllocateNonPagedPool(sizeof(LOOPBACK_DEVICE),
+                                    LOOPBACK_ALLOCATION_TAG);
+
+    if (Device == NULL) {
+        Status = STATUS_INSUFFICIENT_RESOURCES;
+        goto AddDeviceEnd;
+    }
+
+    RtlZeroMemory(Device, sizeof(LOOPBACK_DEVICE));
+    Device->OsDevice = DeviceToken;
+    NET_INITIALIZE_PACKET_LIST(&(Device->ReceiveList));
+    Device->Lock = KeCreateQueuedLock();
+    if (Device->Lock == NULL) {
+        Status = STATUS_INSUFFICIENT_RESOURCES;
+        goto AddDeviceEnd;
+    }
+
+    Device->WorkItem = KeCreateWorkItem(NULL,
+                                        WorkPriorityNormal,
+                                        NetpLoopbackReceiveWorker,
+                                        Device,
+                                        LOOPBACK_ALLOCATION_TAG);
+
+    if (Device->WorkItem == NULL) {
+        Status = STATUS_INSUFFICIENT_RESOURCES;
+        goto AddDeviceEnd;
+    }
+
+    Status = IoAttachDriverToDevice(Driver, DeviceToken, Device);
+    if (!KSUCCESS(Status)) {
+        goto AddDeviceEnd;
+    }
+
+AddDeviceEnd:
+    if (!KSUCCESS(Status)) {
+        if (Device != NULL) {
+            if (Device->WorkItem != NULL) {
+                KeDestroyWorkItem(Device->WorkItem);
+            }
+
+            if (Device->Lock != NULL) {
+                KeDestroyQueuedLock(Device->Lock);
+            }
+
+            MmFreeNonPagedPool(Device);
+            Device = NULL;
+        }
+    }
+
+    return Status;
+}
+
+VOID
+NetpLoopbackDispatchStateChange (
+    PIRP Irp,
+    PVOID DeviceContext,
+    PVOID IrpContext
+    )
+
+/*++
+
+Routine Description:
+
+    This routine handles State Change IRPs for the loopback device.
+
+Arguments:
+
+    Irp - Supplies a pointer to the I/O request packet.
+
+    DeviceContext - Supplies the context pointer supplied by the driver when it
+        attached itself to the driver stack. Presumably this pointer contains
+        driver-specific device context.
+
+    IrpContext - Supplies the context pointer supplied by the driver when
+        the IRP was created.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    KSTATUS Status;
+
+    ASSERT(Irp->MajorCode == IrpMajorStateChange);
+
+    if (Irp->Direction == IrpUp) {
+        switch (Irp->MinorCode) {
+        case IrpMinorQueryResources:
+            IoCompleteIrp(NetLoopbackDriver, Irp, STATUS_SUCCESS);
+            break;
+
+        case IrpMinorStartDevice:
+            Status = NetpLoopbackStartDevice(DeviceContext);
+            IoCompleteIrp(NetLoopbackDriver, Irp, Status);
+            break;
+
+        default:
+            break;
+        }
+    }
+
+    return;
+}
+
+VOID
+NetpLoopbackDispatchSystemControl (
+    PIRP Irp,
+    PVOID DeviceContext,
+    PVOID IrpContext
+    )
+
+/*++
+
+Routine Description:
+
+    This routine handles System Control IRPs for the loopback device.
+
+Arguments:
+
+    Irp - Supplies a pointer to the I/O request packet.
+
+    DeviceContext - Supplies the context pointer supplied by the driver when it
+        attached itself to the driver stack. Presumably this pointer contains
+        driver-specific device context.
+
+    IrpContext - Supplies the context pointer supplied by the driver when
+        the IRP was created.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PLOOPBACK_DEVICE Device;
+    PSYSTEM_CONTROL_DEVICE_INFORMATION DeviceInformationRequest;
+    KSTATUS Status;
+
+    ASSERT(Irp->MajorCode == IrpMajorSystemControl);
+
+    Device = DeviceContext;
+    if (Irp->Direction == IrpDown) {
+        switch (Irp->MinorCode) {
+        case IrpMinorSystemControlDeviceInformation:
+            if (Device->NetworkLink == NULL) {
+                break;
+            }
+
+            DeviceInformationRequest = Irp->U.SystemControl.SystemContext;
+            Status = NetGetSetLinkDeviceInformation(
+                                         Device->NetworkLink,
+                                         &(DeviceInformationRequest->Uuid),
+                                         DeviceInformationRequest->Data,
+                                         &(DeviceInformationRequest->DataSize),
+                                         DeviceInformationRequest->Set);
+
+            IoCompleteIrp(NetLoopbackDriver, Irp, Status);
+            break;
+
+        default:
+            break;
+        }
+    }
+
+    return;
+}
+
+KSTATUS
+NetpLoopbackStartDevice (
+    PLOOPBACK_DEVICE Device
+    )
+
+/*++
+
+Routine Description:
+
+    This routine adds the loopback link to core networking and brings it up.
+
+Arguments:
+
+    Device - Supplies a pointer to the loopback device.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    NET_LINK_PROPERTIES Properties;
+    KSTATUS Status;
+
+    if (Device->NetworkLink != NULL) {
+        return STATUS_SUCCESS;
+    }
+
+    //
+    // The loopback link claims every checksum offload so that nothing is
+    // computed on the way down, and marks every packet as verified on the way
+    // back up. The data never leaves memory, so there is nothing to protect.
+    //
+
+    RtlZeroMemory(&Properties, sizeof(NET_LINK_PROPERTIES));
+    Properties.Version = NET_LINK_PROPERTIES_VERSION;
+    Properties.TransmitAlignment = 1;
+    Properties.Device = Device->OsDevice;
+    Properties.DeviceContext = Device;
+    Properties.PacketSizeInformation.MaxPacketSize =
+                         LOOPBACK_HEADER_SIZE + LOOPBACK_MAXIMUM_PAYLOAD_SIZE;
+
+    Properties.Capabilities = NET_LINK_CAPABILITY_CHECKSUM_MASK |
+                              NET_LINK_CAPABILITY_PROMISCUOUS_MODE |
+                              NET_LINK_CAPABILITY_MULTICAST_ALL;
+
+    Properties.DataLinkType = NetDomainLoopback;
+    Properties.MaxPhysicalAddress = MAX_ULONGLONG;
+    Properties.PhysicalAddress.Domain = NetDomainLoopback;
+    Properties.Interface.Send = NetpLoopbackDeviceSend;
+    Properties.Interface.GetSetInformation =
+                                          NetpLoopbackDeviceGetSetInformation;
+
+    Properties.Interface.DestroyLink = NetpLoopbackDeviceDestroyLink;
+    Status = NetAddLink(&Properties, &(Device->NetworkLink));
+    if (!KSUCCESS(Status)) {
+        Device->NetworkLink = NULL;
+        return Status;
+    }
+
+    NetSetLinkState(Device->NetworkLink, TRUE, LOOPBACK_LINK_SPEED);
+    return STATUS_SUCCESS;
+}
+
+KSTATUS
+NetpLoopbackDeviceSend (
+    PVOID DeviceContext,
+    PNET_PACKET_LIST PacketList
+    )
+
+/*++
+
+Routine Description:
+
+    This routine sends data through the loopback link, which just queues the
+    packets to travel back up the receive path.
+
+Arguments:
+
+    DeviceContext - Supplies a pointer to the loopback device.
+
+    PacketList - Supplies a pointer to a list of network packets to send. Data
+        in these packets may be modified by this routine, but must not be used
+        once this routine returns.
+
+Return Value:
+
+    STATUS_SUCCESS if all packets were sent.
+
+    STATUS_RESOURCE_IN_USE if the packets were dropped because too many are
+    already waiting to be received.
+
+--*/
+
+{
+
+    PLIST_ENTRY CurrentEntry;
+    PLOOPBACK_DEVICE Device;
+    PNET_PACKET_BUFFER Packet;
+    BOOL QueueWorker;
+    KSTATUS Status;
+
+    ASSERT(KeGetRunLevel() == RunLevelLow);
+
+    Device = (PLOOPBACK_DEVICE)DeviceContext;
+
+    //
+    // The receive path should trust the checksums that were never computed.
+    //
+
+    CurrentEntry = PacketList->Head.Next;
+    while (CurrentEntry != &(PacketList->Head)) {
+        Packet = LIST_VALUE(CurrentEntry, NET_PACKET_BUFFER, ListEntry);
+        CurrentEntry = CurrentEntry->Next;
+        Packet->Flags |= NET_PACKET_FLAG_CHECKSUM_OFFLOAD_MASK;
+    }
+
+    QueueWorker = FALSE;
+    KeAcquireQueuedLock(Device->Lock);
+    if (Device->ReceiveList.Count >= LOOPBACK_MAX_QUEUED_PACKETS) {
+        Status = STATUS_RESOURCE_IN_USE;
+
+    } else if (NET_PACKET_LIST_EMPTY(PacketList) != FALSE) {
+        Status = STATUS_SUCCESS;
+
+    } else {
+        NET_APPEND_PACKET_LIST(PacketList, &(Device->ReceiveList));
+        if (Device->WorkerActive == FALSE) {
+            Device->WorkerActive = TRUE;
+            QueueWorker = TRUE;
+        }
+
+        Status = STATUS_SUCCESS;
+    }
+
+    KeReleaseQueuedLock(Device->Lock);
+    if (QueueWorker != FALSE) {
+        KeQueueWorkItem(Device->WorkItem);
+    }
+
+    return Status;
+}
+
+KSTATUS
+NetpLoopbackDeviceGetSetInformation (
+    PVOID DeviceContext,
+    NET_LINK_INFORMATION_TYPE InformationType,
+    PVOID Data,
+    PUINTN DataSize,
+    BOOL Set
+    )
+
+/*++
+
+Routine Description:
+
+    This routine gets or sets the loopback device's link information.
+
+Arguments:
+
+    DeviceContext - Supplies a pointer to the loopback device.
+
+    InformationType - Supplies the type of information being queried or set.
+
+    Data - Supplies a pointer to the data buffer where the data is either
+        returned for a get operation or given for a set operation.
+
+    DataSize - Supplies a pointer that on input contains the size of the data
+        buffer. On output, contains the required size of the data buffer.
+
+    Set - Supplies a boolean indicating if this is a get operation (FALSE) or a
+        set operation (TRUE).
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    KSTATUS Status;
+
+    if (*DataSize != sizeof(ULONG)) {
+        *DataSize = sizeof(ULONG);
+        return STATUS_INVALID_PARAMETER;
+    }
+
+    Status = STATUS_SUCCESS;
+    switch (InformationType) {
+    case NetLinkInformationChecksumOffload:
+        if (Set != FALSE) {
+            Status = STATUS_NOT_SUPPORTED;
+            break;
+        }
+
+        *((PULONG)Data) = NET_LINK_CAPABILITY_CHECKSUM_MASK;
+        break;
+
+    //
+    // Everything sent on the loopback link is received, so multicast and
+    // promiscuous mode are always on.
+    //
+
+    case NetLinkInformationMulticastAll:
+    case NetLinkInformationPromiscuousMode:
+        if (Set == FALSE) {
+            *((PULONG)Data) = TRUE;
+        }
+
+        break;
+
+    default:
+        Status = STATUS_NOT_SUPPORTED;
+        break;
+    }
+
+    return Status;
+}
+
+VOID
+NetpLoopbackDeviceDestroyLink (
+    PVOID DeviceContext
+    )
+
+/*++
+
+Routine Description:
+
+    This routine notifies the loopback device that the networking core is in
+    the process of destroying the link and will no longer call into the device
+    for this link.
+
+Arguments:
+
+    DeviceContext - Supplies a pointer to the loopback device.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    return;
+}
+
+VOID
+NetpLoopbackReceiveWorker (
+    PVOID Parameter
+    )
+
+/*++
+
+Routine Description:
+
+    This routine drains the loopback device's receive list, sending each packet
+    back up the stack. Delivery is deferred to a work item rather than done
+    inline so that a protocol responding to a received packet never re-enters
+    itself while holding its own locks.
+
+Arguments:
+
+    Parameter - Supplies a pointer to the loopback device.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PLOOPBACK_DEVICE Device;
+    PNET_PACKET_BUFFER Packet;
+    NET_PACKET_LIST PacketList;
+
+    Device = (PLOOPBACK_DEVICE)Parameter;
+    NET_INITIALIZE_PACKET_LIST(&PacketList);
+    KeAcquireQueuedLock(Device->Lock);
+    while (NET_PACKET_LIST_EMPTY(&(Device->ReceiveList)) == FALSE) {
+        NET_APPEND_PACKET_LIST(&(Device->ReceiveList), &PacketList);
+        KeReleaseQueuedLock(Device->Lock);
+        while (NET_PACKET_LIST_EMPTY(&PacketList) == FALSE) {
+            Packet = LIST_VALUE(PacketList.Head.Next,
+                                NET_PACKET_BUFFER,
+                                ListEntry);
+
+            NET_REMOVE_PACKET_FROM_LIST(Packet, &PacketList);
+            NetProcessReceivedPacket(Device->NetworkLink, Packet);
+            NetFreeBuffer(Packet);
+        }
+
+        KeAcquireQueuedLock(Device->Lock);
+    }
+
+    Device->WorkerActive = FALSE;
+    KeReleaseQueuedLock(Device->Lock);
+    return;
+}
+
+KSTATUS
+NetpLoopbackInitializeLink (
+    PNET_LINK Link
+    )
+
+/*++
+
+Routine Description:
+
+    This routine initializes any pieces of information needed by the data link
+    layer for a new link.
+
+Arguments:
+
+    Link - Supplies a pointer to the new link.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    Link->DataLinkContext = Link;
+    return STATUS_SUCCESS;
+}
+
+VOID
+NetpLoopbackDestroyLink (
+    PNET_LINK Link
+    )
+
+/*++
+
+Routine Description:
+
+    This routine allows the data link layer to tear down any state before a
+    link is destroyed.
+
+Arguments:
+
+    Link - Supplies a pointer to the dying link.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    Link->DataLinkContext = NULL;
+    return;
+}
+
+KSTATUS
+NetpLoopbackSend (
+    PVOID DataLinkContext,
+    PNET_PACKET_LIST PacketList,
+    PNETWORK_ADDRESS SourcePhysicalAddress,
+    PNETWORK_ADDRESS DestinationPhysicalAddress,
+    ULONG ProtocolNumber
+    )
+
+/*++
+
+Routine Description:
+
+    This routine sends data through the loopback data link layer.
+
+Arguments:
+
+    DataLinkContext - Supplies a pointer to the data link context for the
+        link on which to send the data.
+
+    PacketList - Supplies a pointer to a list of network packets to send. Data
+        in these packets may be modified by this routine, but must not be used
+        once this routine returns.
+
+    SourcePhysicalAddress - Supplies a pointer to the source (local) physical
+        network address.
+
+    DestinationPhysicalAddress - Supplies the optional physical address of the
+        destination, or at least the next hop. If NULL is provided, then the
+        packets will be sent to the data link layer's broadcast address.
+
+    ProtocolNumber - Supplies the protocol number of the data inside the data
+        link header.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    PLIST_ENTRY CurrentEntry;
+    PNET_LINK Link;
+    PNET_PACKET_BUFFER Packet;
+    KSTATUS Status;
+
+    Link = (PNET_LINK)DataLinkContext;
+    CurrentEntry = PacketList->Head.Next;
+    while (CurrentEntry != &(PacketList->Head)) {
+        Packet = LIST_VALUE(CurrentEntry, NET_PACKET_BUFFER, ListEntry);
+        CurrentEntry = CurrentEntry->Next;
+
+        ASSERT(Packet->DataOffset >= LOOPBACK_HEADER_SIZE);
+
+        Packet->DataOffset -= LOOPBACK_HEADER_SIZE;
+        *((PULONG)(Packet->Buffer + Packet->DataOffset)) = ProtocolNumber;
+    }
+
+    Status = Link->Properties.Interface.Send(Link->Properties.DeviceContext,
+                                             PacketList);
+
+    //
+    // Like Ethernet, convert a backed up link into dropped packets.
+    //
+
+    if (Status == STATUS_RESOURCE_IN_USE) {
+        NetDestroyBufferList(PacketList);
+        Status = STATUS_SUCCESS;
+    }
+
+    return Status;
+}
+
+VOID
+NetpLoopbackProcessReceivedPacket (
+    PVOID DataLinkContext,
+    PNET_PACKET_BUFFER Packet
+    )
+
+/*++
+
+Routine Description:
+
+    This routine is called to process a packet received on the loopback link.
+
+Arguments:
+
+    DataLinkContext - Supplies a pointer to the data link context for the link
+        that received the packet.
+
+    Packet - Supplies a pointer to a structure describing the incoming packet.
+        This structure may be used as a scratch space while this routine
+        executes and the packet travels up the stack, but will not be accessed
+        after this routine returns.
+
+Return Value:
+
+    None. When the function returns, the memory associated with the packet may
+    be reclaimed and reused.
+
+--*/
+
+{
+
+    PNET_NETWORK_ENTRY NetworkEntry;
+    ULONG NetworkProtocol;
+    NET_RECEIVE_CONTEXT ReceiveContext;
+
+    NetworkProtocol = *((PULONG)(Packet->Buffer + Packet->DataOffset));
+    NetworkEntry = NetGetNetworkEntry(NetworkProtocol);
+    if (NetworkEntry == NULL) {
+        return;
+    }
+
+    Packet->DataOffset += LOOPBACK_HEADER_SIZE;
+    RtlZeroMemory(&ReceiveContext, sizeof(NET_RECEIVE_CONTEXT));
+    ReceiveContext.Packet = Packet;
+    ReceiveContext.Link = (PNET_LINK)DataLinkContext;
+    ReceiveContext.Network = NetworkEntry;
+    NetworkEntry->Interface.ProcessReceivedData(&ReceiveContext);
+    return;
+}
+
+KSTATUS
+NetpLoopbackConvertToPhysicalAddress (
+    PNETWORK_ADDRESS NetworkAddress,
+    PNETWORK_ADDRESS PhysicalAddress,
+    NET_ADDRESS_TYPE NetworkAddressType
+    )
+
+/*++
+
+Routine Description:
+
+    This routine converts the given network address to a physical layer
+    address. Every address on the loopback link converts to the link's own
+    address.
+
+Arguments:
+
+    NetworkAddress - Supplies a pointer to the network layer address to convert.
+
+    PhysicalAddress - Supplies a pointer to an address that receives the
+        converted physical layer address.
+
+    NetworkAddressType - Supplies the classified type of the given network
+        address, which aids in conversion.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    RtlZeroMemory(PhysicalAddress, sizeof(NETWORK_ADDRESS));
+    PhysicalAddress->Domain = NetDomainLoopback;
+    return STATUS_SUCCESS;
+}
+
+ULONG
+NetpLoopbackPrintAddress (
+    PNETWORK_ADDRESS Address,
+    PSTR Buffer,
+    ULONG BufferLength
+    )
+
+/*++
+
+Routine Description:
+
+    This routine is called to convert a network address into a string, or
+    determine the length of the buffer needed to convert an address into a
+    string.
+
+Arguments:
+
+    Address - Supplies an optional pointer to a network address to convert to
+        a string.
+
+    Buffer - Supplies an optional pointer where the string representation of
+        the address will be returned.
+
+    BufferLength - Supplies the length of the supplied buffer, in bytes.
+
+Return Value:
+
+    Returns the maximum length of any address if no network address is
+    supplied.
+
+    Returns the actual length of the network address string if a network address
+    was supplied, including the null terminator.
+
+--*/
+
+{
+
+    ULONG Length;
+
+    if (Address == NULL) {
+        return LOOPBACK_STRING_LENGTH;
+    }
+
+    ASSERT(Address->Domain == NetDomainLoopback);
+
+    Length = RtlPrintToString(Buffer,
+                              BufferLength,
+                              CharacterEncodingAscii,
+                              "lo");
+
+    return Length;
+}
+
+VOID
+NetpLoopbackGetPacketSizeInformation (
+    PVOID DataLinkContext,
+    PNET_PACKET_SIZE_INFORMATION PacketSizeInformation,
+    ULONG Flags
+    )
+
+/*++
+
+Routine Description:
+
+    This routine gets the current packet size information for the given link.
+
+Arguments:
+
+    DataLinkContext - Supplies a pointer to the data link context of the link
+        whose packet size information is being queried.
+
+    PacketSizeInformation - Supplies a pointer to a structure that receives the
+        link's data link layer packet size information.
+
+    Flags - Supplies a bitmask of flags indicating which packet size
+        information is desired. See NET_PACKET_SIZE_FLAG_* for definitions.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PacketSizeInformation->HeaderSize = LOOPBACK_HEADER_SIZE;
+    PacketSizeInformation->FooterSize = 0;
+    PacketSizeInformation->MaxPacketSize = LOOPBACK_HEADER_SIZE +
+                                           LOOPBACK_MAXIMUM_PAYLOAD_SIZE;
+
+    PacketSizeInformation->MinPacketSize = 0;
+    return;
+}
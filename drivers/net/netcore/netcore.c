@@ -105,6 +105,7 @@ NetListen (
 KSTATUS
 NetAccept (
     PSOCKET Socket,
+    BOOL NonBlocking,
     PIO_HANDLE *NewConnectionSocket,
     PNETWORK_ADDRESS RemoteAddress
     );
@@ -128,6 +129,15 @@ NetSendData (
     PIO_BUFFER IoBuffer
     );
 
+KSTATUS
+NetSendMessages (
+    BOOL FromKernelMode,
+    PSOCKET Socket,
+    PSOCKET_IO_MESSAGE Messages,
+    ULONG MessageCount,
+    PULONG MessagesCompleted
+    );
+
 KSTATUS
 NetReceiveData (
     BOOL FromKernelMode,
@@ -213,7 +223,8 @@ NET_INTERFACE NetInterface = {
     NetReceiveData,
     NetGetSetSocketInformation,
     NetShutdown,
-    NetUserControl
+    NetUserControl,
+    NetSendMessages
 };
 
 NET_SOCKET_OPTION NetBasicSocketOptions[] = {
@@ -363,6 +374,7 @@ Return Value:
     //
 
     NetpEthernetInitialize();
+    NetpLoopbackInitialize(Driver);
     NetpArpInitialize();
     NetpIp4Initialize();
     NetpUdpInitialize();
@@ -1741,6 +1753,7 @@ Return Value:
 KSTATUS
 NetAccept (
     PSOCKET Socket,
+    BOOL NonBlocking,
     PIO_HANDLE *NewConnectionSocket,
     PNETWORK_ADDRESS RemoteAddress
     )
@@ -1756,6 +1769,11 @@ Routine Description:
 
     Socket - Supplies a pointer to the socket to accept a connection from.
 
+    NonBlocking - Supplies a boolean indicating whether to fail with
+        STATUS_OPERATION_WOULD_BLOCK rather than wait if no connection is
+        pending. The accept also never waits if the socket's handle was
+        opened non-blocking.
+
     NewConnectionSocket - Supplies a pointer where a new socket will be
         returned that represents the accepted connection with the remote
         host.
@@ -1780,6 +1798,7 @@ Return Value:
     }
 
     Status = NetSocket->Protocol->Interface.Accept(NetSocket,
+                                                   NonBlocking,
                                                    NewConnectionSocket,
                                                    RemoteAddress);
 
@@ -1944,6 +1963,100 @@ Return Value:
     return Status;
 }
 
+KSTATUS
+NetSendMessages (
+    BOOL FromKernelMode,
+    PSOCKET Socket,
+    PSOCKET_IO_MESSAGE Messages,
+    ULONG MessageCount,
+    PULONG MessagesCompleted
+    )
+
+/*++
+
+Routine Description:
+
+    This routine sends a batch of messages through the network. Messages are
+    sent in order, and sending stops at the first message that fails.
+
+Arguments:
+
+    FromKernelMode - Supplies a boolean indicating whether the request is
+        coming from kernel mode (TRUE) or user mode (FALSE).
+
+    Socket - Supplies a pointer to the socket to send the data to.
+
+    Messages - Supplies an array of messages to send. The parameters are
+        always kernel mode pointers.
+
+    MessageCount - Supplies the number of elements in the message array.
+
+    MessagesCompleted - Supplies a pointer where the number of messages sent
+        will be returned.
+
+Return Value:
+
+    STATUS_SUCCESS if every message was sent.
+
+    Otherwise, returns the status of the message that stopped the batch.
+
+--*/
+
+{
+
+    ULONG Completed;
+    PNET_SOCKET NetSocket;
+    PNET_PROTOCOL_ENTRY Protocol;
+    KSTATUS Status;
+
+    NetSocket = (PNET_SOCKET)Socket;
+    Protocol = NetSocket->Protocol;
+    if (NetGlobalDebug != FALSE) {
+        RtlDebugPrint("Net: Sending %d messages on socket 0x%x...\n",
+                      MessageCount,
+                      NetSocket);
+    }
+
+    //
+    // Protocols that cannot batch get one message at a time.
+    //
+
+    Completed = 0;
+    if (Protocol->Interface.SendMessages != NULL) {
+        Status = Protocol->Interface.SendMessages(FromKernelMode,
+                                                  NetSocket,
+                                                  Messages,
+                                                  MessageCount,
+                                                  &Completed);
+
+    } else {
+        Status = STATUS_SUCCESS;
+        while (Completed < MessageCount) {
+            Status = Protocol->Interface.Send(FromKernelMode,
+                                              NetSocket,
+                                              &(Messages[Completed].Parameters),
+                                              Messages[Completed].IoBuffer);
+
+            if (!KSUCCESS(Status)) {
+                break;
+            }
+
+            Completed += 1;
+        }
+    }
+
+    if (NetGlobalDebug != FALSE) {
+        RtlDebugPrint("Net: Sent %d of %d messages on socket 0x%x: %d.\n",
+                      Completed,
+                      MessageCount,
+                      NetSocket,
+                      Status);
+    }
+
+    *MessagesCompleted = Completed;
+    return Status;
+}
+
 KSTATUS
 NetReceiveData (
     BOOL FromKernelMode,
@@ -122,6 +122,34 @@ Return Value:
 
 --*/
 
+PVOID
+NetpGetBufferDomain (
+    PHYSICAL_ADDRESS MaxPhysicalAddress,
+    ULONG Alignment
+    );
+
+/*++
+
+Routine Description:
+
+    This routine returns the set of packet buffer caches for physically
+    contiguous buffers with the given constraints, creating it if necessary.
+
+Arguments:
+
+    MaxPhysicalAddress - Supplies the maximum physical address buffers in the
+        domain may use.
+
+    Alignment - Supplies the required physical alignment of the buffers.
+
+Return Value:
+
+    Returns a pointer to the buffer domain on success.
+
+    NULL on allocation failure.
+
+--*/
+
 VOID
 NetpDestroyBuffers (
     VOID
@@ -514,6 +542,29 @@ Return Value:
 
 --*/
 
+VOID
+NetpLoopbackInitialize (
+    PDRIVER Driver
+    );
+
+/*++
+
+Routine Description:
+
+    This routine initializes support for the loopback link. It registers the
+    loopback data link layer and makes the core networking driver the
+    function driver for the loopback device.
+
+Arguments:
+
+    Driver - Supplies a pointer to the core networking driver object.
+
+Return Value:
+
+    None.
+
+--*/
+
 //
 // Prototypes to entry points for built in components.
 //
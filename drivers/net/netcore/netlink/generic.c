@@ -226,6 +226,7 @@ NetlinkpGenericListen (
 KSTATUS
 NetlinkpGenericAccept (
     PNET_SOCKET Socket,
+    BOOL NonBlocking,
     PIO_HANDLE *NewConnectionSocket,
     PNETWORK_ADDRESS RemoteAddress
     );
@@ -1359,6 +1360,7 @@ Return Value:
 KSTATUS
 NetlinkpGenericAccept (
     PNET_SOCKET Socket,
+    BOOL NonBlocking,
     PIO_HANDLE *NewConnectionSocket,
     PNETWORK_ADDRESS RemoteAddress
     )
@@ -1374,6 +1376,11 @@ Routine Description:
 
     Socket - Supplies a pointer to the socket to accept a connection from.
 
+    NonBlocking - Supplies a boolean indicating whether to fail with
+        STATUS_OPERATION_WOULD_BLOCK rather than wait if no connection is
+        pending. The accept also never waits if the socket's handle was
+        opened non-blocking.
+
     NewConnectionSocket - Supplies a pointer where a new socket will be
         returned that represents the accepted connection with the remote
         host.
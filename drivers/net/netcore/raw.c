@@ -236,6 +236,7 @@ NetpRawListen (
 KSTATUS
 NetpRawAccept (
     PNET_SOCKET Socket,
+    BOOL NonBlocking,
     PIO_HANDLE *NewConnectionSocket,
     PNETWORK_ADDRESS RemoteAddress
     );
@@ -782,6 +783,7 @@ Return Value:
 KSTATUS
 NetpRawAccept (
     PNET_SOCKET Socket,
+    BOOL NonBlocking,
     PIO_HANDLE *NewConnectionSocket,
     PNETWORK_ADDRESS RemoteAddress
     )
@@ -797,6 +799,11 @@ Routine Description:
 
     Socket - Supplies a pointer to the socket to accept a connection from.
 
+    NonBlocking - Supplies a boolean indicating whether to fail with
+        STATUS_OPERATION_WOULD_BLOCK rather than wait if no connection is
+        pending. The accept also never waits if the socket's handle was
+        opened non-blocking.
+
     NewConnectionSocket - Supplies a pointer where a new socket will be
         returned that represents the accepted connection with the remote
         host.
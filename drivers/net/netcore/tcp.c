@@ -126,6 +126,7 @@ NetpTcpConnect (
 KSTATUS
 NetpTcpAccept (
     PNET_SOCKET Socket,
+    BOOL NonBlocking,
     PIO_HANDLE *NewConnectionSocket,
     PNETWORK_ADDRESS RemoteAddress
     );
@@ -229,14 +230,21 @@ NetpTcpProcessAcknowledge (
     ULONG AcknowledgeNumber,
     ULONG SequenceNumber,
     ULONG DataLength,
-    USHORT WindowSize
+    USHORT WindowSize,
+    PTCP_PACKET_OPTIONS Options
     );
 
 VOID
-NetpTcpProcessPacketOptions (
-    PTCP_SOCKET Socket,
+NetpTcpParsePacketOptions (
     PTCP_HEADER Header,
-    PNET_PACKET_BUFFER Packet
+    PNET_PACKET_BUFFER Packet,
+    PTCP_PACKET_OPTIONS PacketOptions
+    );
+
+VOID
+NetpTcpNegotiateOptions (
+    PTCP_SOCKET Socket,
+    PTCP_PACKET_OPTIONS PacketOptions
     );
 
 VOID
@@ -543,6 +551,20 @@ TCP_SOCKET_OPTION NetTcpSocketOptions[] = {
         sizeof(ULONG),
         TRUE
     },
+
+    {
+        SocketInformationTcp,
+        SocketTcpOptionCongestionControl,
+        sizeof(ULONG),
+        TRUE
+    },
+
+    {
+        SocketInformationTcp,
+        SocketTcpOptionPacing,
+        sizeof(ULONG),
+        TRUE
+    },
 };
 
 //
@@ -791,7 +813,9 @@ Return Value:
     // Start by assuming the remote supports the desired options.
     //
 
-    TcpSocket->Flags |= TCP_SOCKET_FLAG_WINDOW_SCALING;
+    TcpSocket->Flags |= TCP_SOCKET_FLAG_WINDOW_SCALING |
+                        TCP_SOCKET_FLAG_SELECTIVE_ACKNOWLEDGE |
+                        TCP_SOCKET_FLAG_TIMESTAMPS;
 
     //
     // Initialize the socket on the lower layers.
@@ -1013,6 +1037,7 @@ Return Value:
 KSTATUS
 NetpTcpAccept (
     PNET_SOCKET Socket,
+    BOOL NonBlocking,
     PIO_HANDLE *NewConnectionSocket,
     PNETWORK_ADDRESS RemoteAddress
     )
@@ -1028,6 +1053,11 @@ Routine Description:
 
     Socket - Supplies a pointer to the socket to accept a connection from.
 
+    NonBlocking - Supplies a boolean indicating whether to fail with
+        STATUS_OPERATION_WOULD_BLOCK rather than wait if no connection is
+        pending. The accept also never waits if the socket's handle was
+        opened non-blocking.
+
     NewConnectionSocket - Supplies a pointer where a new socket will be
         returned that represents the accepted connection with the remote
         host.
@@ -1067,7 +1097,9 @@ Return Value:
 
     Timeout = WAIT_TIME_INDEFINITE;
     OpenFlags = IoGetIoHandleOpenFlags(Socket->KernelSocket.IoHandle);
-    if ((OpenFlags & OPEN_FLAG_NON_BLOCKING) != 0) {
+    if ((NonBlocking != FALSE) ||
+        ((OpenFlags & OPEN_FLAG_NON_BLOCKING) != 0)) {
+
         Timeout = 0;
     }
 
@@ -2872,6 +2904,7 @@ Return Value:
 
 {
 
+    ULONG AlgorithmOption;
     SOCKET_BASIC_OPTION BasicOption;
     ULONG BooleanOption;
     ULONG Count;
@@ -3414,6 +3447,44 @@ Return Value:
 
             break;
 
+        case SocketTcpOptionCongestionControl:
+            if (Set != FALSE) {
+                AlgorithmOption = *((PULONG)Data);
+                KeAcquireQueuedLock(TcpSocket->Lock);
+                Status = NetpTcpCongestionSetAlgorithm(TcpSocket,
+                                                       AlgorithmOption);
+
+                KeReleaseQueuedLock(TcpSocket->Lock);
+
+            } else {
+                Source = &AlgorithmOption;
+                AlgorithmOption = TcpSocket->CongestionAlgorithm;
+            }
+
+            break;
+
+        case SocketTcpOptionPacing:
+            if (Set != FALSE) {
+                BooleanOption = *((PULONG)Data);
+                KeAcquireQueuedLock(TcpSocket->Lock);
+                TcpSocket->Flags &= ~TCP_SOCKET_FLAG_PACING;
+                TcpSocket->PacingTime = 0;
+                if (BooleanOption != FALSE) {
+                    TcpSocket->Flags |= TCP_SOCKET_FLAG_PACING;
+                }
+
+                KeReleaseQueuedLock(TcpSocket->Lock);
+
+            } else {
+                Source = &BooleanOption;
+                BooleanOption = FALSE;
+                if ((TcpSocket->Flags & TCP_SOCKET_FLAG_PACING) != 0) {
+                    BooleanOption = TRUE;
+                }
+            }
+
+            break;
+
         default:
 
             ASSERT(FALSE);
@@ -4041,6 +4112,7 @@ Return Value:
     ULONG AcknowledgeNumber;
     ULONGLONG DueTime;
     PIO_OBJECT_STATE IoState;
+    TCP_PACKET_OPTIONS Options;
     PNET_PACKET_BUFFER Packet;
     ULONG RemoteFinalSequence;
     ULONG RemoteSequence;
@@ -4252,10 +4324,12 @@ Return Value:
 
             //
             // Process the options to get the max segment size and window scale
-            // that likely came with the SYN.
+            // that likely came with the SYN. This is the only time they are
+            // negotiated on an outgoing connection.
             //
 
-            NetpTcpProcessPacketOptions(Socket, Header, Packet);
+            NetpTcpParsePacketOptions(Header, Packet, &Options);
+            NetpTcpNegotiateOptions(Socket, &Options);
 
             //
             // If the local unacknowledged number is not equal to the initial
@@ -4294,8 +4368,18 @@ Return Value:
     }
 
     //
-    // Perform general processing for all states. Check to see if the sequence
-    // number is acceptable.
+    // Perform general processing for all states. Parse the options if that
+    // wasn't already done for the SYN above. Only the per-segment timestamps
+    // and SACK blocks are used from here on; a SYN arriving now, such as a
+    // retransmitted SYN+ACK, does not renegotiate anything.
+    //
+
+    if (SynHandled == FALSE) {
+        NetpTcpParsePacketOptions(Header, Packet, &Options);
+    }
+
+    //
+    // Check to see if the sequence number is acceptable.
     //
 
     SegmentLength = Packet->FooterOffset - Packet->DataOffset;
@@ -4320,6 +4404,20 @@ Return Value:
         return;
     }
 
+    //
+    // Drop old duplicates caught by their timestamps, acknowledging them like
+    // any other unacceptable segment.
+    //
+
+    if (NetpTcpProcessTimestamp(Socket, Header, &Options) == FALSE) {
+        if ((Socket->Flags & TCP_SOCKET_FLAG_SEND_ACKNOWLEDGE) == 0) {
+            Socket->Flags |= TCP_SOCKET_FLAG_SEND_ACKNOWLEDGE;
+            NetpTcpTimerAddReference(Socket);
+        }
+
+        return;
+    }
+
     //
     // Next up, check the reset bit. If it is set, close the connection. The
     // exception in the TCP specification is if the socket is in the
@@ -4375,7 +4473,8 @@ Return Value:
                                        AcknowledgeNumber,
                                        RemoteSequence,
                                        SegmentLength,
-                                       Header->WindowSize);
+                                       Header->WindowSize,
+                                       &Options);
 
     if (!KSUCCESS(Status)) {
 
@@ -4904,6 +5003,8 @@ Return Value:
         Header->AcknowledgmentNumber =
                                  CPU_TO_NETWORK32(Socket->ReceiveNextSequence);
 
+        Socket->LastAcknowledgeSent = Socket->ReceiveNextSequence;
+
     } else {
         Header->AcknowledgmentNumber = 0;
     }
@@ -5144,7 +5245,8 @@ NetpTcpProcessAcknowledge (
     ULONG AcknowledgeNumber,
     ULONG SequenceNumber,
     ULONG DataLength,
-    USHORT WindowSize
+    USHORT WindowSize,
+    PTCP_PACKET_OPTIONS Options
     )
 
 /*++
@@ -5171,6 +5273,8 @@ Routine Description:
         which may or may not get saved as the new send window. This value is
         expected to be straight from the header, in network order.
 
+    Options - Supplies a pointer to the options parsed from the packet.
+
 Return Value:
 
     Status code.
@@ -5185,7 +5289,9 @@ Return Value:
     ULONG ReceiveWindowEnd;
     ULONG RelativeAcknowledgeNumber;
     ULONG ResetFlags;
+    ULONGLONG RoundTripTicks;
     ULONG ScaledWindowSize;
+    ULONG TimestampDelta;
     BOOL UpdateValid;
 
     ASSERT(Socket->NetSocket.KernelSocket.ReferenceCount >= 1);
@@ -5279,6 +5385,24 @@ Return Value:
             }
         }
 
+        //
+        // With timestamps, every acknowledgment that moves the window forward
+        // carries a round trip time sample, even for retransmitted data.
+        //
+
+        if ((AcknowledgeNumber != Socket->SendUnacknowledgedSequence) &&
+            (Socket->TimestampEcho != 0)) {
+
+            TimestampDelta = NetpTcpGetTimestamp() - Socket->TimestampEcho;
+            if ((LONG)TimestampDelta >= 0) {
+                RoundTripTicks = ((ULONGLONG)TimestampDelta *
+                                  HlQueryTimeCounterFrequency()) /
+                                 MILLISECONDS_PER_SECOND;
+
+                NetpTcpProcessNewRoundTripTimeSample(Socket, RoundTripTicks);
+            }
+        }
+
         Socket->SendUnacknowledgedSequence = AcknowledgeNumber;
         ReceiveWindowEnd = Socket->ReceiveNextSequence +
                            Socket->ReceiveWindowFreeSize;
@@ -5345,6 +5469,7 @@ Return Value:
         //
 
         NetpTcpFreeSentSegments(Socket, &CurrentTime);
+        NetpTcpProcessSelectiveAcknowledge(Socket, Options, &CurrentTime);
 
     //
     // If the ACK is ahead of schedule, take note and send a response.
@@ -5500,29 +5625,27 @@ Return Value:
 }
 
 VOID
-NetpTcpProcessPacketOptions (
-    PTCP_SOCKET Socket,
+NetpTcpParsePacketOptions (
     PTCP_HEADER Header,
-    PNET_PACKET_BUFFER Packet
+    PNET_PACKET_BUFFER Packet,
+    PTCP_PACKET_OPTIONS PacketOptions
     )
 
 /*++
 
 Routine Description:
 
-    This routine is called to process TCP packet options.
+    This routine is called to parse TCP packet options. It does not change
+    any socket state.
 
 Arguments:
 
-    Socket - Supplies a pointer to the TCP socket.
-
     Header - Supplies a pointer to the TCP header.
 
     Packet - Supplies a pointer to the received packet information.
 
-    SourceAddress - Supplies a pointer to the source (remote) address that the
-        packet originated from. This memory will not be referenced once the
-        function returns, it can be stack allocated.
+    PacketOptions - Supplies a pointer where the parsed options will be
+        returned for further processing by the caller.
 
 Return Value:
 
@@ -5532,16 +5655,15 @@ Return Value:
 
 {
 
-    ULONG LocalMaxSegmentSize;
+    PTCP_SACK_BLOCK Block;
+    ULONG BlockIndex;
     ULONG OptionIndex;
     UCHAR OptionLength;
     PUCHAR Options;
     ULONG OptionsLength;
     UCHAR OptionType;
-    PNET_PACKET_SIZE_INFORMATION SizeInformation;
-    BOOL WindowScaleSupported;
 
-    WindowScaleSupported = FALSE;
+    RtlZeroMemory(PacketOptions, sizeof(TCP_PACKET_OPTIONS));
 
     //
     // Parse the options in the packet.
@@ -5571,6 +5693,10 @@ Return Value:
         // The option length accounts for the type and length fields themselves.
         //
 
+        if (Options[OptionIndex] < 2) {
+            break;
+        }
+
         OptionLength = Options[OptionIndex] - 2;
         OptionIndex += 1;
         if (OptionIndex + OptionLength > OptionsLength) {
@@ -5586,17 +5712,10 @@ Return Value:
             if (((Header->Flags & TCP_HEADER_FLAG_SYN) != 0) &&
                 (OptionLength == 2)) {
 
-                Socket->SendMaxSegmentSize =
+                PacketOptions->MaxSegmentSize =
                          NETWORK_TO_CPU16(*((PUSHORT)&(Options[OptionIndex])));
 
-                SizeInformation = &(Socket->NetSocket.PacketSizeInformation);
-                LocalMaxSegmentSize = SizeInformation->MaxPacketSize -
-                                      SizeInformation->HeaderSize -
-                                      SizeInformation->FooterSize;
-
-                if (LocalMaxSegmentSize < Socket->SendMaxSegmentSize) {
-                    Socket->SendMaxSegmentSize = LocalMaxSegmentSize;
-                }
+                PacketOptions->Flags |= TCP_PACKET_OPTION_MAXIMUM_SEGMENT_SIZE;
             }
 
         //
@@ -5607,8 +5726,57 @@ Return Value:
             if (((Header->Flags & TCP_HEADER_FLAG_SYN) != 0) &&
                 (OptionLength == 1)) {
 
-                Socket->SendWindowScale = Options[OptionIndex];
-                WindowScaleSupported = TRUE;
+                PacketOptions->WindowScale = Options[OptionIndex];
+                PacketOptions->Flags |= TCP_PACKET_OPTION_WINDOW_SCALE;
+            }
+
+        //
+        // SACK can only be offered on a SYN.
+        //
+
+        } else if (OptionType == TCP_OPTION_SACK_PERMITTED) {
+            if (((Header->Flags & TCP_HEADER_FLAG_SYN) != 0) &&
+                (OptionLength == 0)) {
+
+                PacketOptions->Flags |= TCP_PACKET_OPTION_SACK_PERMITTED;
+            }
+
+        } else if (OptionType == TCP_OPTION_SACK) {
+            if ((OptionLength != 0) &&
+                ((OptionLength % TCP_OPTION_SACK_BLOCK_SIZE) == 0)) {
+
+                BlockIndex = 0;
+                while ((BlockIndex < TCP_MAXIMUM_SACK_BLOCKS) &&
+                       (BlockIndex * TCP_OPTION_SACK_BLOCK_SIZE <
+                        OptionLength)) {
+
+                    Block = &(PacketOptions->SackBlocks[BlockIndex]);
+                    Block->LeftEdge = NETWORK_TO_CPU32(
+                        *((PULONG)&(Options[OptionIndex +
+                                    (BlockIndex *
+                                     TCP_OPTION_SACK_BLOCK_SIZE)])));
+
+                    Block->RightEdge = NETWORK_TO_CPU32(
+                        *((PULONG)&(Options[OptionIndex +
+                                    (BlockIndex *
+                                     TCP_OPTION_SACK_BLOCK_SIZE) + 4])));
+
+                    BlockIndex += 1;
+                }
+
+                PacketOptions->SackBlockCount = BlockIndex;
+                PacketOptions->Flags |= TCP_PACKET_OPTION_SACK;
+            }
+
+        } else if (OptionType == TCP_OPTION_TIMESTAMPS) {
+            if (OptionLength == TCP_OPTION_TIMESTAMPS_SIZE - 2) {
+                PacketOptions->TimestampValue = NETWORK_TO_CPU32(
+                                     *((PULONG)&(Options[OptionIndex])));
+
+                PacketOptions->TimestampEcho = NETWORK_TO_CPU32(
+                                     *((PULONG)&(Options[OptionIndex + 4])));
+
+                PacketOptions->Flags |= TCP_PACKET_OPTION_TIMESTAMPS;
             }
         }
 
@@ -5619,28 +5787,96 @@ Return Value:
         OptionIndex += OptionLength;
     }
 
-    if ((Header->Flags & TCP_HEADER_FLAG_SYN) != 0) {
+    return;
+}
+
+VOID
+NetpTcpNegotiateOptions (
+    PTCP_SOCKET Socket,
+    PTCP_PACKET_OPTIONS PacketOptions
+    )
+
+/*++
+
+Routine Description:
+
+    This routine applies the options offered in the remote host's SYN or
+    SYN+ACK to the socket. It must be called exactly once per connection, as
+    it settles the maximum segment size, window scaling, SACK, and timestamp
+    use for the life of the connection. This routine assumes the socket lock
+    is already held.
+
+Arguments:
+
+    Socket - Supplies a pointer to the TCP socket.
+
+    PacketOptions - Supplies a pointer to the options parsed from the SYN.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    ULONG LocalMaxSegmentSize;
+    PNET_PACKET_SIZE_INFORMATION SizeInformation;
+
+    if ((PacketOptions->Flags & TCP_PACKET_OPTION_MAXIMUM_SEGMENT_SIZE) != 0) {
+        Socket->SendMaxSegmentSize = PacketOptions->MaxSegmentSize;
+        SizeInformation = &(Socket->NetSocket.PacketSizeInformation);
+        LocalMaxSegmentSize = SizeInformation->MaxPacketSize -
+                              SizeInformation->HeaderSize -
+                              SizeInformation->FooterSize;
+
+        if (LocalMaxSegmentSize < Socket->SendMaxSegmentSize) {
+            Socket->SendMaxSegmentSize = LocalMaxSegmentSize;
+        }
+    }
+
+    //
+    // Disable window scaling locally if the remote doesn't understand it.
+    //
+
+    if ((PacketOptions->Flags & TCP_PACKET_OPTION_WINDOW_SCALE) != 0) {
+        Socket->SendWindowScale = PacketOptions->WindowScale;
+
+    } else {
+        Socket->Flags &= ~TCP_SOCKET_FLAG_WINDOW_SCALING;
 
         //
-        // Disable window scaling locally if the remote doesn't understand it.
+        // No data should have been sent yet.
         //
 
-        if (WindowScaleSupported == FALSE) {
-            Socket->Flags &= ~TCP_SOCKET_FLAG_WINDOW_SCALING;
+        ASSERT(Socket->ReceiveWindowFreeSize ==
+               Socket->ReceiveWindowTotalSize);
 
-            //
-            // No data should have been sent yet.
-            //
+        if (Socket->ReceiveWindowTotalSize > MAX_USHORT) {
+            Socket->ReceiveWindowTotalSize = MAX_USHORT;
+            Socket->ReceiveWindowFreeSize = MAX_USHORT;
+        }
 
-            ASSERT(Socket->ReceiveWindowFreeSize ==
-                   Socket->ReceiveWindowTotalSize);
+        Socket->ReceiveWindowScale = 0;
+    }
 
-            if (Socket->ReceiveWindowTotalSize > MAX_USHORT) {
-                Socket->ReceiveWindowTotalSize = MAX_USHORT;
-                Socket->ReceiveWindowFreeSize = MAX_USHORT;
-            }
+    if ((PacketOptions->Flags & TCP_PACKET_OPTION_SACK_PERMITTED) == 0) {
+        Socket->Flags &= ~TCP_SOCKET_FLAG_SELECTIVE_ACKNOWLEDGE;
+    }
+
+    //
+    // Timestamps are only used if both sides offered them. They take up room
+    // in every segment, so shrink the payload accordingly.
+    //
 
-            Socket->ReceiveWindowScale = 0;
+    if ((PacketOptions->Flags & TCP_PACKET_OPTION_TIMESTAMPS) == 0) {
+        Socket->Flags &= ~TCP_SOCKET_FLAG_TIMESTAMPS;
+
+    } else if ((Socket->Flags & TCP_SOCKET_FLAG_TIMESTAMPS) != 0) {
+        Socket->TimestampRecent = PacketOptions->TimestampValue;
+        Socket->TimestampRecentTime = KeGetRecentTimeCounter();
+        if (Socket->SendMaxSegmentSize > TCP_OPTION_TIMESTAMPS_PADDED_SIZE) {
+            Socket->SendMaxSegmentSize -= TCP_OPTION_TIMESTAMPS_PADDED_SIZE;
         }
     }
 
@@ -5676,6 +5912,8 @@ Return Value:
 
 {
 
+    UCHAR Options[TCP_MAXIMUM_OPTIONS_SIZE];
+    ULONG OptionsLength;
     PNET_PACKET_BUFFER Packet;
     NET_PACKET_LIST PacketList;
     ULONG SequenceNumber;
@@ -5701,10 +5939,20 @@ Return Value:
         return;
     }
 
+    //
+    // Resets don't carry options. Everything else carries timestamps and a
+    // description of any out of order data received.
+    //
+
+    OptionsLength = 0;
+    if ((Flags & TCP_HEADER_FLAG_RESET) == 0) {
+        OptionsLength = NetpTcpBuildOptions(Socket, TRUE, Options);
+    }
+
     Packet = NULL;
     SizeInformation = &(Socket->NetSocket.PacketSizeInformation);
     Status = NetAllocateBuffer(SizeInformation->HeaderSize,
-                               0,
+                               OptionsLength,
                                SizeInformation->FooterSize,
                                Socket->NetSocket.Link,
                                0,
@@ -5716,6 +5964,12 @@ Return Value:
 
     NET_ADD_PACKET_TO_LIST(Packet, &PacketList);
 
+    if (OptionsLength != 0) {
+        RtlCopyMemory(Packet->Buffer + Packet->DataOffset,
+                      Options,
+                      OptionsLength);
+    }
+
     ASSERT(Packet->DataOffset >= sizeof(TCP_HEADER));
 
     Packet->DataOffset -= sizeof(TCP_HEADER);
@@ -5731,7 +5985,13 @@ Return Value:
         Flags &= ~TCP_HEADER_FLAG_KEEP_ALIVE;
     }
 
-    NetpTcpFillOutHeader(Socket, Packet, SequenceNumber, Flags, 0, 0, 0);
+    NetpTcpFillOutHeader(Socket,
+                         Packet,
+                         SequenceNumber,
+                         Flags,
+                         OptionsLength,
+                         0,
+                         0);
 
     //
     // Send this control packet off down the network.
@@ -5795,6 +6055,7 @@ Return Value:
     PLIST_ENTRY CurrentEntry;
     PTCP_RECEIVED_SEGMENT CurrentSegment;
     BOOL DataMissing;
+    ULONG FullSegmentSize;
     BOOL InsertedSegment;
     PIO_OBJECT_STATE IoState;
     ULONG NextSequence;
@@ -5820,6 +6081,13 @@ Return Value:
                       Length);
     }
 
+    //
+    // Remember where the latest data landed so that the first SACK block sent
+    // describes it.
+    //
+
+    Socket->ReceiveSackRecentSequence = SequenceNumber;
+
     //
     // Loop through every segment to find a segment with a larger sequence than
     // this one. If such a segment is found, then try to fill in the hole
@@ -6012,13 +6280,18 @@ Return Value:
     // acknowledge right away, as there's probably not more data coming.
     //
 
+    FullSegmentSize = Socket->ReceiveMaxSegmentSize;
+    if ((Socket->Flags & TCP_SOCKET_FLAG_TIMESTAMPS) != 0) {
+        FullSegmentSize -= TCP_OPTION_TIMESTAMPS_PADDED_SIZE;
+    }
+
     if ((DataMissing != FALSE) ||
         ((Header->Flags & TCP_HEADER_FLAG_FIN) == 0) ||
         (Socket->ReceiveNextSequence != (SequenceNumber + RemainingLength))) {
 
         if ((DataMissing == FALSE) &&
             ((Header->Flags & TCP_HEADER_FLAG_PUSH) == 0) &&
-            (Length >= Socket->ReceiveMaxSegmentSize) &&
+            (Length >= FullSegmentSize) &&
             ((Socket->Flags & TCP_SOCKET_FLAG_SEND_ACKNOWLEDGE) == 0)) {
 
             Socket->Flags |= TCP_SOCKET_FLAG_SEND_ACKNOWLEDGE;
@@ -6484,6 +6757,7 @@ Return Value:
     PULONG Flags;
     BOOL InWindow;
     PTCP_SEND_SEGMENT LastSegment;
+    ULONG LostLength;
     ULONGLONG LocalCurrentTime;
     PNET_PACKET_BUFFER Packet;
     NET_PACKET_LIST PacketList;
@@ -6492,6 +6766,7 @@ Return Value:
     KSTATUS Status;
     ULONG WindowBegin;
     ULONG WindowEnd;
+    ULONG WindowExtension;
     ULONG WindowSize;
 
     //
@@ -6551,16 +6826,44 @@ Return Value:
 
     WindowBegin = Socket->SendWindowUpdateAcknowledge;
     WindowEnd = WindowBegin + WindowSize;
+    LocalCurrentTime = 0;
+    if (CurrentTime != NULL) {
+        LocalCurrentTime = *CurrentTime;
+    }
 
     //
-    // Loop adding as many segments as possible to the packets list.
+    // With selective acknowledgments, data that was SACKed or declared lost
+    // is no longer in flight, so the window can slide past it (up to what the
+    // receiver allows). Lost segments are retransmitted first below, eating
+    // into that extension. Also fire the RACK reordering timer if it's due.
     //
 
-    LocalCurrentTime = 0;
-    if (CurrentTime != NULL) {
-        LocalCurrentTime = *CurrentTime;
+    if ((Socket->Flags & TCP_SOCKET_FLAG_SELECTIVE_ACKNOWLEDGE) != 0) {
+        if (Socket->RackTimeout != 0) {
+            if (LocalCurrentTime == 0) {
+                LocalCurrentTime = HlQueryTimeCounter();
+            }
+
+            if (LocalCurrentTime >= Socket->RackTimeout) {
+                NetpTcpRackDetectLoss(Socket, LocalCurrentTime);
+            }
+        }
+
+        WindowExtension = Socket->SackedBytes + Socket->LostBytes;
+        if (WindowSize + WindowExtension > Socket->SendWindowSize) {
+            WindowExtension = 0;
+            if (Socket->SendWindowSize > WindowSize) {
+                WindowExtension = Socket->SendWindowSize - WindowSize;
+            }
+        }
+
+        WindowEnd += WindowExtension;
     }
 
+    //
+    // Loop adding as many segments as possible to the packets list.
+    //
+
     FirstSegment = NULL;
     LastSegment = NULL;
     NET_INITIALIZE_PACKET_LIST(&PacketList);
@@ -6596,6 +6899,14 @@ Return Value:
             break;
         }
 
+        //
+        // The receiver already has SACKed segments.
+        //
+
+        if ((Segment->Flags & TCP_SEND_SEGMENT_FLAG_SACKED) != 0) {
+            continue;
+        }
+
         //
         // Check to see if the packet needs to be sent for the first
         // time.
@@ -6616,6 +6927,7 @@ Return Value:
             }
 
             LastSegment = Segment;
+            Segment->Flags |= TCP_SEND_SEGMENT_FLAG_TRANSMIT_PENDING;
 
             //
             // Update the next pointer and record the send time.
@@ -6637,6 +6949,35 @@ Return Value:
             NetpTcpGetTransmitTimeoutInterval(Socket, Segment);
             Segment->SendAttemptCount += 1;
 
+        //
+        // Loss detection decided this segment needs to go again. Send it
+        // right away, without waiting for the retransmit timer.
+        //
+
+        } else if ((Segment->Flags & TCP_SEND_SEGMENT_FLAG_LOST) != 0) {
+            Packet = NetpTcpCreatePacket(Socket, Segment);
+            if (Packet == NULL) {
+                break;
+            }
+
+            NET_ADD_PACKET_TO_LIST(Packet, &PacketList);
+            if (FirstSegment == NULL) {
+                FirstSegment = Segment;
+            }
+
+            LastSegment = Segment;
+            LostLength = Segment->Length - Segment->Offset;
+
+            ASSERT(Socket->LostBytes >= LostLength);
+
+            Socket->LostBytes -= LostLength;
+            Segment->Flags &= ~TCP_SEND_SEGMENT_FLAG_LOST;
+            Segment->Flags |= TCP_SEND_SEGMENT_FLAG_RETRANSMITTED |
+                              TCP_SEND_SEGMENT_FLAG_TRANSMIT_PENDING;
+
+            Segment->SendAttemptCount += 1;
+            WindowEnd -= LostLength;
+
         //
         // This segment has been sent before. Check to see if enough
         // time has gone by without an acknowledge that it needs to be
@@ -6662,6 +7003,9 @@ Return Value:
                 }
 
                 LastSegment = Segment;
+                Segment->Flags |= TCP_SEND_SEGMENT_FLAG_RETRANSMITTED |
+                                  TCP_SEND_SEGMENT_FLAG_TRANSMIT_PENDING;
+
                 NetpTcpTransmissionTimeout(Socket, Segment);
                 NetpTcpGetTransmitTimeoutInterval(Socket, Segment);
                 Segment->SendAttemptCount += 1;
@@ -6680,23 +7024,28 @@ Return Value:
     }
 
     //
-    // Otherwise send off the whole group of packets.
+    // Otherwise send off the whole group of packets. Debug impairment may
+    // have eaten them all.
     //
 
-    Status = Socket->NetSocket.Network->Interface.Send(
+    NetpTcpDebugImpairTransmit(Socket, &PacketList);
+    Status = STATUS_SUCCESS;
+    if (NET_PACKET_LIST_EMPTY(&PacketList) == FALSE) {
+        Status = Socket->NetSocket.Network->Interface.Send(
                                             &(Socket->NetSocket),
                                             &(Socket->NetSocket.RemoteAddress),
                                             NULL,
                                             &PacketList);
 
-    if (!KSUCCESS(Status)) {
-        RtlDebugPrint("TCP segments failed to send %d.\n", Status);
-        goto TcpSendPendingSegmentsEnd;
+        if (!KSUCCESS(Status)) {
+            RtlDebugPrint("TCP segments failed to send %d.\n", Status);
+        }
     }
 
     //
-    // Update all the sent segments' last send time now that they have been
-    // sent to the physical layer.
+    // Update the last send time of the segments that went out now that they
+    // have been sent to the physical layer. SACKed segments in the range were
+    // skipped and keep their original send time.
     //
 
     LocalCurrentTime = HlQueryTimeCounter();
@@ -6704,7 +7053,12 @@ Return Value:
     while (CurrentEntry != LastSegment->Header.ListEntry.Next) {
         Segment = LIST_VALUE(CurrentEntry, TCP_SEND_SEGMENT, Header.ListEntry);
         CurrentEntry = CurrentEntry->Next;
-        Segment->LastSendTime = LocalCurrentTime;
+        if ((Segment->Flags & TCP_SEND_SEGMENT_FLAG_TRANSMIT_PENDING) != 0) {
+            Segment->Flags &= ~TCP_SEND_SEGMENT_FLAG_TRANSMIT_PENDING;
+            if (KSUCCESS(Status)) {
+                Segment->LastSendTime = LocalCurrentTime;
+            }
+        }
     }
 
 TcpSendPendingSegmentsEnd:
@@ -6763,15 +7117,18 @@ Return Value:
     }
 
     NET_ADD_PACKET_TO_LIST(Packet, &PacketList);
-    Status = Socket->NetSocket.Network->Interface.Send(
+    NetpTcpDebugImpairTransmit(Socket, &PacketList);
+    if (NET_PACKET_LIST_EMPTY(&PacketList) == FALSE) {
+        Status = Socket->NetSocket.Network->Interface.Send(
                                             &(Socket->NetSocket),
                                             &(Socket->NetSocket.RemoteAddress),
                                             NULL,
                                             &PacketList);
 
-    if (!KSUCCESS(Status)) {
-        RtlDebugPrint("TCP segment failed to send %d.\n", Status);
-        goto TcpSendSegmentEnd;
+        if (!KSUCCESS(Status)) {
+            RtlDebugPrint("TCP segment failed to send %d.\n", Status);
+            goto TcpSendSegmentEnd;
+        }
     }
 
     //
@@ -6795,6 +7152,9 @@ Return Value:
                 NetpTcpSetState(Socket, TcpStateFinWait1);
             }
         }
+
+    } else {
+        Segment->Flags |= TCP_SEND_SEGMENT_FLAG_RETRANSMITTED;
     }
 
     LastSendTime = Segment->LastSendTime;
@@ -6850,6 +7210,8 @@ Return Value:
 {
 
     USHORT HeaderFlags;
+    UCHAR Options[TCP_MAXIMUM_OPTIONS_SIZE];
+    ULONG OptionsLength;
     PNET_PACKET_BUFFER Packet;
     ULONG SegmentLength;
     PNET_PACKET_SIZE_INFORMATION SizeInformation;
@@ -6863,10 +7225,16 @@ Return Value:
 
     ASSERT(SegmentLength != 0);
 
+    //
+    // Data segments carry timestamps but not SACK blocks, as the segment size
+    // only accounts for the former.
+    //
+
+    OptionsLength = NetpTcpBuildOptions(Socket, FALSE, Options);
     Packet = NULL;
     SizeInformation = &(Socket->NetSocket.PacketSizeInformation);
     Status = NetAllocateBuffer(SizeInformation->HeaderSize,
-                               SegmentLength,
+                               OptionsLength + SegmentLength,
                                SizeInformation->FooterSize,
                                Socket->NetSocket.Link,
                                0,
@@ -6889,7 +7257,13 @@ Return Value:
     // Copy the segment data over and fill out the TCP header.
     //
 
-    RtlCopyMemory(Packet->Buffer + Packet->DataOffset,
+    if (OptionsLength != 0) {
+        RtlCopyMemory(Packet->Buffer + Packet->DataOffset,
+                      Options,
+                      OptionsLength);
+    }
+
+    RtlCopyMemory(Packet->Buffer + Packet->DataOffset + OptionsLength,
                   (PUCHAR)(Segment + 1) + Segment->Offset,
                   SegmentLength);
 
@@ -6900,7 +7274,7 @@ Return Value:
                          Packet,
                          Segment->SequenceNumber + Segment->Offset,
                          HeaderFlags,
-                         0,
+                         OptionsLength,
                          0,
                          SegmentLength);
 
@@ -6966,11 +7340,12 @@ Return Value:
             //
             // If the remote host is acknowledging exactly this segment, then
             // let congestion control know that there's a new round trip time
-            // in the house.
+            // in the house. Timestamps take care of this when enabled.
             //
 
             if ((AcknowledgeNumber == SegmentEnd) &&
-                (Segment->SendAttemptCount == 1)) {
+                (Segment->SendAttemptCount == 1) &&
+                ((Socket->Flags & TCP_SOCKET_FLAG_TIMESTAMPS) == 0)) {
 
                 if (*CurrentTime == 0) {
                     *CurrentTime = HlQueryTimeCounter();
@@ -6982,6 +7357,22 @@ Return Value:
 
             }
 
+            //
+            // Segments delivered for the first time by this acknowledgment
+            // move the RACK state forward.
+            //
+
+            if (((Socket->Flags &
+                  TCP_SOCKET_FLAG_SELECTIVE_ACKNOWLEDGE) != 0) &&
+                ((Segment->Flags & TCP_SEND_SEGMENT_FLAG_SACKED) == 0)) {
+
+                if (*CurrentTime == 0) {
+                    *CurrentTime = HlQueryTimeCounter();
+                }
+
+                NetpTcpRackUpdate(Socket, Segment, *CurrentTime);
+            }
+
             if (NetTcpDebugPrintSequenceNumbers != FALSE) {
                 NetpTcpPrintSocketEndpoints(Socket, TRUE);
                 RtlDebugPrint(
@@ -6998,6 +7389,7 @@ Return Value:
 
             ASSERT(Segment->SendAttemptCount != 0);
 
+            NetpTcpScoreboardRemoveSegment(Socket, Segment);
             LIST_REMOVE(&(Segment->Header.ListEntry));
             if (LIST_EMPTY(&(Socket->OutgoingSegmentList)) != FALSE) {
                 NetpTcpTimerReleaseReference(Socket);
@@ -7026,6 +7418,7 @@ Return Value:
 
             ASSERT(Segment->SendAttemptCount != 0);
 
+            NetpTcpScoreboardRemoveSegment(Socket, Segment);
             Segment->Offset = AcknowledgeNumber - Segment->SequenceNumber;
             if (NetTcpDebugPrintSequenceNumbers != FALSE) {
                 NetpTcpPrintSocketEndpoints(Socket, TRUE);
@@ -7112,6 +7505,9 @@ Return Value:
         MmFreePagedPool(OutgoingSegment);
     }
 
+    Socket->SackedBytes = 0;
+    Socket->LostBytes = 0;
+
     //
     // Loop through all received packets and clean them up too.
     //
@@ -7622,6 +8018,7 @@ Return Value:
     ULONG NetworkProtocol;
     PIO_HANDLE NewIoHandle;
     PTCP_SOCKET NewTcpSocket;
+    TCP_PACKET_OPTIONS PacketOptions;
     PNETWORK_ADDRESS RemoteAddress;
     ULONG RemoteSequence;
     ULONG ResetFlags;
@@ -7744,7 +8141,9 @@ Return Value:
     // numbers.
     //
 
-    NetpTcpProcessPacketOptions(NewTcpSocket, Header, ReceiveContext->Packet);
+    NetpTcpParsePacketOptions(Header, ReceiveContext->Packet, &PacketOptions);
+    NetpTcpNegotiateOptions(NewTcpSocket, &PacketOptions);
+
     RemoteSequence = NETWORK_TO_CPU32(Header->SequenceNumber);
     NewTcpSocket->ReceiveInitialSequence = RemoteSequence;
     NewTcpSocket->ReceiveNextSequence = RemoteSequence + 1;
@@ -8141,6 +8540,14 @@ Return Value:
         DataSize += TCP_OPTION_WINDOW_SCALE_SIZE + TCP_OPTION_NOP_SIZE;
     }
 
+    if ((Socket->Flags & TCP_SOCKET_FLAG_SELECTIVE_ACKNOWLEDGE) != 0) {
+        DataSize += TCP_OPTION_SACK_PERMITTED_SIZE + (2 * TCP_OPTION_NOP_SIZE);
+    }
+
+    if ((Socket->Flags & TCP_SOCKET_FLAG_TIMESTAMPS) != 0) {
+        DataSize += TCP_OPTION_TIMESTAMPS_PADDED_SIZE;
+    }
+
     //
     // Allocate the SYN packet that will kick things off with the remote host.
     //
@@ -8206,6 +8613,44 @@ Return Value:
         PacketBuffer += 1;
     }
 
+    //
+    // Offer selective acknowledgments, padded out in front.
+    //
+
+    if ((Socket->Flags & TCP_SOCKET_FLAG_SELECTIVE_ACKNOWLEDGE) != 0) {
+        *PacketBuffer = TCP_OPTION_NOP;
+        PacketBuffer += 1;
+        *PacketBuffer = TCP_OPTION_NOP;
+        PacketBuffer += 1;
+        *PacketBuffer = TCP_OPTION_SACK_PERMITTED;
+        PacketBuffer += 1;
+        *PacketBuffer = TCP_OPTION_SACK_PERMITTED_SIZE;
+        PacketBuffer += 1;
+    }
+
+    //
+    // Offer timestamps. A plain SYN has nothing to echo yet.
+    //
+
+    if ((Socket->Flags & TCP_SOCKET_FLAG_TIMESTAMPS) != 0) {
+        *PacketBuffer = TCP_OPTION_NOP;
+        PacketBuffer += 1;
+        *PacketBuffer = TCP_OPTION_NOP;
+        PacketBuffer += 1;
+        *PacketBuffer = TCP_OPTION_TIMESTAMPS;
+        PacketBuffer += 1;
+        *PacketBuffer = TCP_OPTION_TIMESTAMPS_SIZE;
+        PacketBuffer += 1;
+        *((PULONG)PacketBuffer) = CPU_TO_NETWORK32(NetpTcpGetTimestamp());
+        PacketBuffer += sizeof(ULONG);
+        *((PULONG)PacketBuffer) = 0;
+        if (WithAcknowledge != FALSE) {
+            *((PULONG)PacketBuffer) = CPU_TO_NETWORK32(Socket->TimestampRecent);
+        }
+
+        PacketBuffer += sizeof(ULONG);
+    }
+
     //
     // Add the TCP header and send this packet down the wire. Remember that the
     // semantics of the ACK flag are different for the function below, so by
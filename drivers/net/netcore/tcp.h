@@ -160,6 +160,21 @@ Module Name:
 
 #define TCP_DUPLICATE_ACK_THRESHOLD 3
 
+//
+// Define the fraction of the minimum round trip time that RACK waits for
+// reordered segments to show up before declaring a segment lost.
+//
+
+#define TCP_RACK_REORDER_WINDOW_DIVISOR 4
+
+//
+// Define the number of seconds a connection can be idle before its most
+// recent timestamp is considered too old to protect against wrapped sequence
+// numbers (24 days).
+//
+
+#define TCP_PAWS_IDLE_LIMIT (24 * 24 * 60 * 60)
+
 //
 // Define the default receive minimum size, in bytes.
 //
@@ -277,6 +292,9 @@ Module Name:
 #define TCP_OPTION_NOP                  1
 #define TCP_OPTION_MAXIMUM_SEGMENT_SIZE 2
 #define TCP_OPTION_WINDOW_SCALE         3
+#define TCP_OPTION_SACK_PERMITTED       4
+#define TCP_OPTION_SACK                 5
+#define TCP_OPTION_TIMESTAMPS           8
 
 //
 // Define TCP option sizes.
@@ -285,6 +303,42 @@ Module Name:
 #define TCP_OPTION_NOP_SIZE 1
 #define TCP_OPTION_MSS_SIZE 4
 #define TCP_OPTION_WINDOW_SCALE_SIZE 3
+#define TCP_OPTION_SACK_PERMITTED_SIZE 2
+#define TCP_OPTION_SACK_BLOCK_SIZE 8
+#define TCP_OPTION_TIMESTAMPS_SIZE 10
+
+//
+// Define the sizes of the SACK and timestamp options once padded out to a
+// 32-bit boundary with leading NOPs.
+//
+
+#define TCP_OPTION_SACK_PADDED_SIZE 4
+#define TCP_OPTION_TIMESTAMPS_PADDED_SIZE 12
+
+//
+// Define the maximum size of all TCP options, and the maximum number of SACK
+// blocks that can fit in a packet.
+//
+
+#define TCP_MAXIMUM_OPTIONS_SIZE 40
+#define TCP_MAXIMUM_SACK_BLOCKS 4
+
+//
+// Define the number of out of order received regions examined when building
+// the SACK blocks to send.
+//
+
+#define TCP_SACK_SCAN_BLOCKS 8
+
+//
+// Define the flags describing which options were found in a received packet.
+//
+
+#define TCP_PACKET_OPTION_MAXIMUM_SEGMENT_SIZE 0x00000001
+#define TCP_PACKET_OPTION_WINDOW_SCALE         0x00000002
+#define TCP_PACKET_OPTION_SACK_PERMITTED       0x00000004
+#define TCP_PACKET_OPTION_SACK                 0x00000008
+#define TCP_PACKET_OPTION_TIMESTAMPS           0x00000010
 
 //
 // Define the TCP receive segment flags. The first six bits matche up with the
@@ -325,6 +379,16 @@ Module Name:
      TCP_SEND_SEGMENT_FLAG_ACKNOWLEDGE |        \
      TCP_SEND_SEGMENT_FLAG_URGENT)
 
+//
+// The remaining send segment flags track the segment in the scoreboard used
+// for SACK based loss recovery.
+//
+
+#define TCP_SEND_SEGMENT_FLAG_SACKED           0x00000100
+#define TCP_SEND_SEGMENT_FLAG_LOST             0x00000200
+#define TCP_SEND_SEGMENT_FLAG_RETRANSMITTED    0x00000400
+#define TCP_SEND_SEGMENT_FLAG_TRANSMIT_PENDING 0x00000800
+
 //
 // Define the TCP socket flags.
 //
@@ -342,6 +406,9 @@ Module Name:
 #define TCP_SOCKET_FLAG_NO_DELAY                     0x00000400
 #define TCP_SOCKET_FLAG_WINDOW_SCALING               0x00000800
 #define TCP_SOCKET_FLAG_CONNECT_INTERRUPTED          0x00001000
+#define TCP_SOCKET_FLAG_SELECTIVE_ACKNOWLEDGE        0x00002000
+#define TCP_SOCKET_FLAG_TIMESTAMPS                   0x00004000
+#define TCP_SOCKET_FLAG_PACING                       0x00008000
 
 //
 // ------------------------------------------------------ Data Type Definitions
@@ -417,6 +484,161 @@ typedef enum _TCP_STATE {
     TcpStateClosed
 } TCP_STATE, *PTCP_STATE;
 
+typedef struct _TCP_SOCKET TCP_SOCKET, *PTCP_SOCKET;
+
+typedef
+VOID
+(*PTCP_CONGESTION_INITIALIZE) (
+    PTCP_SOCKET Socket
+    );
+
+/*++
+
+Routine Description:
+
+    This routine resets the congestion control algorithm's private state for
+    the given socket. It is called when a socket starts using the algorithm
+    and again when the connection is established.
+
+Arguments:
+
+    Socket - Supplies a pointer to the socket.
+
+Return Value:
+
+    None.
+
+--*/
+
+typedef
+ULONG
+(*PTCP_CONGESTION_GET_SLOW_START_THRESHOLD) (
+    PTCP_SOCKET Socket,
+    BOOL Timeout
+    );
+
+/*++
+
+Routine Description:
+
+    This routine is called when packet loss is detected. It determines the new
+    slow start threshold. The caller sets the congestion window based on it.
+
+Arguments:
+
+    Socket - Supplies a pointer to the socket that lost a packet.
+
+    Timeout - Supplies a boolean indicating whether the loss was detected by
+        a retransmission timeout (TRUE) or by fast retransmit or RACK (FALSE).
+
+Return Value:
+
+    Returns the new slow start threshold, in bytes.
+
+--*/
+
+typedef
+VOID
+(*PTCP_CONGESTION_AVOID) (
+    PTCP_SOCKET Socket,
+    ULONG AcknowledgedBytes
+    );
+
+/*++
+
+Routine Description:
+
+    This routine grows the congestion window in response to a new
+    acknowledgment while the socket is above the slow start threshold and not
+    in fast recovery.
+
+Arguments:
+
+    Socket - Supplies a pointer to the socket.
+
+    AcknowledgedBytes - Supplies the number of bytes newly acknowledged.
+
+Return Value:
+
+    None.
+
+--*/
+
+/*++
+
+Structure Description:
+
+    This structure stores the operations that make up a TCP congestion control
+    algorithm. Slow start, fast recovery, and the round trip time estimate are
+    common to all algorithms.
+
+Members:
+
+    Initialize - Stores a pointer to a function used to reset the algorithm's
+        private state.
+
+    GetSlowStartThreshold - Stores a pointer to a function called upon loss.
+
+    CongestionAvoid - Stores a pointer to a function used to grow the window
+        during congestion avoidance.
+
+--*/
+
+typedef struct _TCP_CONGESTION_OPERATIONS {
+    PTCP_CONGESTION_INITIALIZE Initialize;
+    PTCP_CONGESTION_GET_SLOW_START_THRESHOLD GetSlowStartThreshold;
+    PTCP_CONGESTION_AVOID CongestionAvoid;
+} TCP_CONGESTION_OPERATIONS, *PTCP_CONGESTION_OPERATIONS;
+
+/*++
+
+Structure Description:
+
+    This structure stores the CUBIC congestion control state of a socket.
+
+Members:
+
+    MaxWindow - Stores the congestion window size just before the last
+        reduction, in bytes.
+
+    OriginWindow - Stores the window size the cubic function plateaus at for
+        the current epoch, in bytes.
+
+    EstimatedWindow - Stores the window size New Reno would have reached in
+        the current epoch, in bytes. CUBIC never grows slower than this.
+
+    EpochStart - Stores the time counter value when the current congestion
+        avoidance epoch began, or 0 if no epoch is in progress.
+
+    PlateauTime - Stores the time in milliseconds from the start of the epoch
+        until the window reaches the origin again.
+
+--*/
+
+typedef struct _TCP_CUBIC_DATA {
+    ULONG MaxWindow;
+    ULONG OriginWindow;
+    ULONG EstimatedWindow;
+    ULONGLONG EpochStart;
+    ULONG PlateauTime;
+} TCP_CUBIC_DATA, *PTCP_CUBIC_DATA;
+
+/*++
+
+Structure Description:
+
+    This union stores the private state of the congestion control algorithms.
+
+Members:
+
+    Cubic - Stores the CUBIC state.
+
+--*/
+
+typedef union _TCP_CONGESTION_DATA {
+    TCP_CUBIC_DATA Cubic;
+} TCP_CONGESTION_DATA, *PTCP_CONGESTION_DATA;
+
 /*++
 
 Structure Description:
@@ -600,9 +822,60 @@ Structure Description:
     SegmentAllocationSize - Stores the allocation size for each of the send and
         receive TCP segments, including enough size for the header and data.
 
+    SackedBytes - Stores the number of sent but unacknowledged bytes the
+        remote host has selectively acknowledged.
+
+    LostBytes - Stores the number of sent but unacknowledged bytes that RACK
+        has declared lost and that have not yet been retransmitted.
+
+    MinRoundTripTime - Stores the smallest round trip time seen, in time
+        counter ticks.
+
+    RackSendTime - Stores the send time of the most recently sent segment that
+        has been delivered, in time counter ticks.
+
+    RackEndSequence - Stores the ending sequence number of the most recently
+        sent segment that has been delivered.
+
+    RackRoundTripTime - Stores the round trip time of the most recently sent
+        segment that has been delivered, in time counter ticks.
+
+    RackTimeout - Stores the time counter value at which RACK should look for
+        lost segments again, or 0 if nothing is pending.
+
+    TimestampRecent - Stores the most recent timestamp value received from the
+        remote host, which is echoed back in outgoing timestamp options.
+
+    TimestampRecentTime - Stores the time counter value when the recent
+        timestamp was recorded.
+
+    TimestampEcho - Stores the timestamp echo reply from the packet currently
+        being processed, or 0 if it did not carry one.
+
+    LastAcknowledgeSent - Stores the most recent acknowledge number sent to
+        the remote host.
+
+    ReceiveSackRecentSequence - Stores the sequence number of the most
+        recently received out of order segment, which is reported in the first
+        SACK block.
+
+    CongestionAlgorithm - Stores the congestion control algorithm in use. See
+        SOCKET_TCP_CONGESTION_ALGORITHM.
+
+    CongestionOperations - Stores a pointer to the congestion control
+        algorithm's operations.
+
+    CongestionData - Stores the congestion control algorithm's private state.
+
+    PacingTime - Stores the time counter value when the pacing limit was last
+        advanced.
+
+    PacingLimit - Stores the sequence number beyond which data cannot yet be
+        sent when pacing is enabled.
+
 --*/
 
-typedef struct _TCP_SOCKET {
+struct _TCP_SOCKET {
     NET_SOCKET NetSocket;
     LIST_ENTRY ListEntry;
     TCP_STATE State;
@@ -657,7 +930,24 @@ typedef struct _TCP_SOCKET {
     ULONG ShutdownTypes;
     LONG OutOfBandData;
     ULONG SegmentAllocationSize;
-} TCP_SOCKET, *PTCP_SOCKET;
+    ULONG SackedBytes;
+    ULONG LostBytes;
+    ULONGLONG MinRoundTripTime;
+    ULONGLONG RackSendTime;
+    ULONG RackEndSequence;
+    ULONGLONG RackRoundTripTime;
+    ULONGLONG RackTimeout;
+    ULONG TimestampRecent;
+    ULONGLONG TimestampRecentTime;
+    ULONG TimestampEcho;
+    ULONG LastAcknowledgeSent;
+    ULONG ReceiveSackRecentSequence;
+    ULONG CongestionAlgorithm;
+    PTCP_CONGESTION_OPERATIONS CongestionOperations;
+    TCP_CONGESTION_DATA CongestionData;
+    ULONGLONG PacingTime;
+    ULONG PacingLimit;
+};
 
 /*++
 
@@ -775,6 +1065,60 @@ typedef struct _TCP_SEND_SEGMENT {
 
 /*++
 
+Structure Description:
+
+    This structure stores a single selective acknowledgment block.
+
+Members:
+
+    LeftEdge - Stores the first sequence number of the block.
+
+    RightEdge - Stores the sequence number immediately after the block.
+
+--*/
+
+typedef struct _TCP_SACK_BLOCK {
+    ULONG LeftEdge;
+    ULONG RightEdge;
+} TCP_SACK_BLOCK, *PTCP_SACK_BLOCK;
+
+/*++
+
+Structure Description:
+
+    This structure stores the options parsed out of a received TCP packet.
+
+Members:
+
+    Flags - Stores a bitmask of which options were present. See
+        TCP_PACKET_OPTION_* for definitions.
+
+    MaxSegmentSize - Stores the remote maximum segment size.
+
+    WindowScale - Stores the remote window scale.
+
+    TimestampValue - Stores the remote host's timestamp.
+
+    TimestampEcho - Stores the local timestamp being echoed back.
+
+    SackBlockCount - Stores the number of valid SACK blocks.
+
+    SackBlocks - Stores the SACK blocks, converted to CPU byte order.
+
+--*/
+
+typedef struct _TCP_PACKET_OPTIONS {
+    ULONG Flags;
+    ULONG MaxSegmentSize;
+    ULONG WindowScale;
+    ULONG TimestampValue;
+    ULONG TimestampEcho;
+    ULONG SackBlockCount;
+    TCP_SACK_BLOCK SackBlocks[TCP_MAXIMUM_SACK_BLOCKS];
+} TCP_PACKET_OPTIONS, *PTCP_PACKET_OPTIONS;
+
+/*++
+
 Structure Description:
 
     This structure defines a TCP packet protocol header.
@@ -831,7 +1175,13 @@ typedef struct _TCP_HEADER {
 // -------------------------------------------------------------------- Globals
 //
 
+extern BOOL NetTcpDebugPrintSequenceNumbers;
 extern BOOL NetTcpDebugPrintCongestionControl;
+extern ULONG NetTcpDebugTransmitDropRate;
+extern ULONG NetTcpDebugTransmitReorderRate;
+extern ULONG NetTcpDefaultCongestionAlgorithm;
+extern TCP_CONGESTION_OPERATIONS NetTcpNewRenoOperations;
+extern TCP_CONGESTION_OPERATIONS NetTcpCubicOperations;
 
 //
 // -------------------------------------------------------- Function Prototypes
@@ -1056,3 +1406,278 @@ Return Value:
 
 --*/
 
+
+VOID
+NetpTcpCongestionEnterRecovery (
+    PTCP_SOCKET Socket
+    );
+
+/*++
+
+Routine Description:
+
+    This routine is called when packet loss has been detected by means other
+    than a timeout. It cuts the congestion window and enters fast recovery.
+    This routine assumes the socket lock is already held.
+
+Arguments:
+
+    Socket - Supplies a pointer to the socket that detected loss.
+
+Return Value:
+
+    None.
+
+--*/
+
+KSTATUS
+NetpTcpCongestionSetAlgorithm (
+    PTCP_SOCKET Socket,
+    ULONG Algorithm
+    );
+
+/*++
+
+Routine Description:
+
+    This routine switches the congestion control algorithm used by a socket.
+    The current congestion window is kept. This routine assumes the socket
+    lock is already held, or that the socket is still being created.
+
+Arguments:
+
+    Socket - Supplies a pointer to the socket.
+
+    Algorithm - Supplies the new algorithm. See
+        SOCKET_TCP_CONGESTION_ALGORITHM.
+
+Return Value:
+
+    STATUS_SUCCESS on success.
+
+    STATUS_INVALID_PARAMETER if the algorithm is not valid.
+
+--*/
+
+//
+// Selective acknowledgment and timestamp routines
+//
+
+ULONG
+NetpTcpGetTimestamp (
+    VOID
+    );
+
+/*++
+
+Routine Description:
+
+    This routine returns the current value of the clock used in outgoing
+    timestamp options.
+
+Arguments:
+
+    None.
+
+Return Value:
+
+    Returns the current timestamp, in milliseconds. This is never zero.
+
+--*/
+
+ULONG
+NetpTcpBuildOptions (
+    PTCP_SOCKET Socket,
+    BOOL IncludeSack,
+    PUCHAR Options
+    );
+
+/*++
+
+Routine Description:
+
+    This routine writes out the options that accompany a non-SYN packet. This
+    routine assumes the socket lock is already held.
+
+Arguments:
+
+    Socket - Supplies a pointer to the socket sending the packet.
+
+    IncludeSack - Supplies a boolean indicating whether SACK blocks describing
+        out of order received data should be included if there are any.
+
+    Options - Supplies a pointer to a buffer of at least
+        TCP_MAXIMUM_OPTIONS_SIZE bytes where the options will be written.
+
+Return Value:
+
+    Returns the number of bytes of options written, which is always a multiple
+    of four.
+
+--*/
+
+BOOL
+NetpTcpProcessTimestamp (
+    PTCP_SOCKET Socket,
+    PTCP_HEADER Header,
+    PTCP_PACKET_OPTIONS Options
+    );
+
+/*++
+
+Routine Description:
+
+    This routine processes the timestamp option of an acceptable incoming
+    segment, rejecting old duplicates and updating the timestamp to echo.
+    This routine assumes the socket lock is already held.
+
+Arguments:
+
+    Socket - Supplies a pointer to the socket.
+
+    Header - Supplies a pointer to the TCP header of the segment.
+
+    Options - Supplies a pointer to the options parsed from the segment.
+
+Return Value:
+
+    TRUE if the segment should be processed.
+
+    FALSE if the segment is an old duplicate and should be dropped.
+
+--*/
+
+VOID
+NetpTcpProcessSelectiveAcknowledge (
+    PTCP_SOCKET Socket,
+    PTCP_PACKET_OPTIONS Options,
+    PULONGLONG CurrentTime
+    );
+
+/*++
+
+Routine Description:
+
+    This routine marks outgoing segments covered by incoming SACK blocks and
+    runs RACK loss detection. This routine assumes the socket lock is already
+    held.
+
+Arguments:
+
+    Socket - Supplies a pointer to the socket.
+
+    Options - Supplies a pointer to the options parsed from the incoming
+        acknowledgment.
+
+    CurrentTime - Supplies a pointer to a time counter value for an approximate
+        current time. If it is set to 0, it may be updated by this routine.
+
+Return Value:
+
+    None.
+
+--*/
+
+VOID
+NetpTcpRackUpdate (
+    PTCP_SOCKET Socket,
+    PTCP_SEND_SEGMENT Segment,
+    ULONGLONG CurrentTime
+    );
+
+/*++
+
+Routine Description:
+
+    This routine updates the RACK state for a newly delivered segment, either
+    cumulatively or selectively acknowledged.
+
+Arguments:
+
+    Socket - Supplies a pointer to the socket.
+
+    Segment - Supplies a pointer to the newly delivered segment.
+
+    CurrentTime - Supplies the current time counter value.
+
+Return Value:
+
+    None.
+
+--*/
+
+VOID
+NetpTcpRackDetectLoss (
+    PTCP_SOCKET Socket,
+    ULONGLONG CurrentTime
+    );
+
+/*++
+
+Routine Description:
+
+    This routine marks outgoing segments as lost if a segment sent
+    sufficiently later has already been delivered. It enters fast recovery if
+    new losses are found. This routine assumes the socket lock is already held.
+
+Arguments:
+
+    Socket - Supplies a pointer to the socket.
+
+    CurrentTime - Supplies the current time counter value.
+
+Return Value:
+
+    None.
+
+--*/
+
+VOID
+NetpTcpScoreboardRemoveSegment (
+    PTCP_SOCKET Socket,
+    PTCP_SEND_SEGMENT Segment
+    );
+
+/*++
+
+Routine Description:
+
+    This routine removes a segment's contribution to the SACK scoreboard,
+    either because it is being freed or its offset is about to change.
+
+Arguments:
+
+    Socket - Supplies a pointer to the socket.
+
+    Segment - Supplies a pointer to the segment.
+
+Return Value:
+
+    None.
+
+--*/
+
+VOID
+NetpTcpDebugImpairTransmit (
+    PTCP_SOCKET Socket,
+    PNET_PACKET_LIST PacketList
+    );
+
+/*++
+
+Routine Description:
+
+    This routine randomly drops and reorders outgoing packets according to the
+    debug impairment rates. It is used to exercise loss recovery.
+
+Arguments:
+
+    Socket - Supplies a pointer to the sending socket.
+
+    PacketList - Supplies a pointer to the list of packets about to be sent.
+
+Return Value:
+
+    None.
+
+--*/
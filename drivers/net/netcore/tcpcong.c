@@ -13,10 +13,10 @@ Module Name:
 
 Abstract:
 
-    This module implements support for TCP congestion control. Specifically
-    this module implements the New Reno algorithm, however this set of functions
-    could easily be interfaced to include alternate congestion control
-    algorithms.
+    This module implements support for TCP congestion control. The common
+    parts (slow start, fast recovery, round trip time estimation, and pacing)
+    live here, and call out to a table of operations for the algorithm
+    specific parts. This module also implements the New Reno algorithm.
 
 Author:
 
@@ -49,6 +49,21 @@ Module Name:
 // ---------------------------------------------------------------- Definitions
 //
 
+//
+// Define the number of segments that can go out back to back when pacing.
+//
+
+#define TCP_PACING_BURST_SEGMENTS 2
+
+//
+// Define the pacing rate as a percentage of the congestion window per round
+// trip. Slow start paces faster so as not to hold back the window growth.
+//
+
+#define TCP_PACING_SLOW_START_GAIN 200
+#define TCP_PACING_CONGESTION_AVOIDANCE_GAIN 120
+#define TCP_PACING_GAIN_DENOMINATOR 100
+
 //
 // ------------------------------------------------------ Data Type Definitions
 //
@@ -57,12 +72,58 @@ Module Name:
 // ----------------------------------------------- Internal Function Prototypes
 //
 
+ULONG
+NetpTcpPaceSendWindow (
+    PTCP_SOCKET Socket,
+    ULONG WindowSize
+    );
+
+VOID
+NetpTcpNewRenoInitialize (
+    PTCP_SOCKET Socket
+    );
+
+ULONG
+NetpTcpNewRenoGetSlowStartThreshold (
+    PTCP_SOCKET Socket,
+    BOOL Timeout
+    );
+
+VOID
+NetpTcpNewRenoCongestionAvoid (
+    PTCP_SOCKET Socket,
+    ULONG AcknowledgedBytes
+    );
+
 //
 // -------------------------------------------------------------------- Globals
 //
 
 ULONGLONG NetDefaultRoundTripTicks = 0;
 
+//
+// Store the congestion control algorithm new sockets start out with.
+//
+
+ULONG NetTcpDefaultCongestionAlgorithm = SocketTcpCongestionCubic;
+
+TCP_CONGESTION_OPERATIONS NetTcpNewRenoOperations = {
+    NetpTcpNewRenoInitialize,
+    NetpTcpNewRenoGetSlowStartThreshold,
+    NetpTcpNewRenoCongestionAvoid
+};
+
+//
+// Store the table of algorithms, indexed by SOCKET_TCP_CONGESTION_ALGORITHM.
+//
+
+PTCP_CONGESTION_OPERATIONS
+    NetTcpCongestionAlgorithms[SocketTcpCongestionAlgorithmCount] = {
+
+    &NetTcpNewRenoOperations,
+    &NetTcpCubicOperations
+};
+
 //
 // ------------------------------------------------------------------ Functions
 //
@@ -104,6 +165,13 @@ Return Value:
     Socket->CongestionWindowSize = 2 * TCP_DEFAULT_MAX_SEGMENT_SIZE;
     Socket->FastRecoveryEndSequence = 0;
     Socket->RoundTripTime = NetDefaultRoundTripTicks;
+    if (!KSUCCESS(NetpTcpCongestionSetAlgorithm(
+                                         Socket,
+                                         NetTcpDefaultCongestionAlgorithm))) {
+
+        NetpTcpCongestionSetAlgorithm(Socket, SocketTcpCongestionNewReno);
+    }
+
     return;
 }
 
@@ -136,6 +204,7 @@ Return Value:
     }
 
     Socket->CongestionWindowSize = 2 * Socket->SendMaxSegmentSize;
+    Socket->CongestionOperations->Initialize(Socket);
     if (NetTcpDebugPrintCongestionControl != FALSE) {
         NetpTcpPrintSocketEndpoints(Socket, FALSE);
         RtlDebugPrint(" Initial SlowStartThreshold %d, "
@@ -218,6 +287,10 @@ Return Value:
         }
     }
 
+    if (((Socket->Flags & TCP_SOCKET_FLAG_PACING) != 0) && (WindowSize != 0)) {
+        WindowSize = NetpTcpPaceSendWindow(Socket, WindowSize);
+    }
+
     return WindowSize;
 }
 
@@ -248,9 +321,9 @@ Return Value:
 
 {
 
+    ULONG AcknowledgedBytes;
     ULONG Flags;
     ULONG SegmentSize;
-    ULONG WindowIncrease;
 
     //
     // Process an ACK that made progress.
@@ -267,27 +340,13 @@ Return Value:
         if (AcknowledgeNumber != Socket->PreviousAcknowledgeNumber) {
 
             //
-            // Perform slow start if below the threshold. With slow start,
-            // the congestion window is increased 1 Maximum Segment Size for
-            // every new ACK received. Thus it is really exponentially
-            // increasing.
+            // Perform fast recovery if enabled. This is checked first since
+            // with selective acknowledgments the window is not inflated during
+            // recovery, and may sit at or below the slow start threshold.
             //
 
             Flags = Socket->Flags;
-            if (Socket->CongestionWindowSize <= Socket->SlowStartThreshold) {
-                Socket->CongestionWindowSize += SegmentSize;
-                if (NetTcpDebugPrintCongestionControl != FALSE) {
-                    NetpTcpPrintSocketEndpoints(Socket, FALSE);
-                    RtlDebugPrint(" SlowStart Window up by %d to %d.\n",
-                                  SegmentSize,
-                                  Socket->CongestionWindowSize);
-                }
-
-            //
-            // Perform fast recovery if enabled.
-            //
-
-            } else if ((Flags & TCP_SOCKET_FLAG_IN_FAST_RECOVERY) != 0) {
+            if ((Flags & TCP_SOCKET_FLAG_IN_FAST_RECOVERY) != 0) {
 
                 //
                 // If the acknowledge number is greater than the highest
@@ -311,72 +370,69 @@ Return Value:
                 //
                 // If the socket is still in fast recovery mode, then only
                 // partial progress was made. The acknowledge number must point
-                // to the next hole, so send that off right away.
+                // to the next hole, so send that off right away. With
+                // selective acknowledgments, RACK has already marked whatever
+                // is lost for retransmission.
                 //
 
                 if (((Socket->Flags & TCP_SOCKET_FLAG_IN_FAST_RECOVERY) != 0) &&
+                    ((Flags & TCP_SOCKET_FLAG_SELECTIVE_ACKNOWLEDGE) == 0) &&
                     (Socket->SendWindowSize != 0)) {
 
                     NetpTcpRetransmit(Socket);
                 }
 
             //
-            // Perform congestion avoidance.
+            // Perform slow start if below the threshold. With slow start,
+            // the congestion window is increased 1 Maximum Segment Size for
+            // every new ACK received. Thus it is really exponentially
+            // increasing.
             //
 
-            } else {
-                WindowIncrease = SegmentSize * SegmentSize /
-                                 Socket->CongestionWindowSize;
-
-                if (WindowIncrease == 0) {
-                    WindowIncrease = 1;
-                }
+            } else if (Socket->CongestionWindowSize <=
+                       Socket->SlowStartThreshold) {
 
-                Socket->CongestionWindowSize += WindowIncrease;
+                Socket->CongestionWindowSize += SegmentSize;
                 if (NetTcpDebugPrintCongestionControl != FALSE) {
                     NetpTcpPrintSocketEndpoints(Socket, FALSE);
-                    RtlDebugPrint(" CongestionAvoid Window up by %d to %d.\n",
-                                  WindowIncrease,
+                    RtlDebugPrint(" SlowStart Window up by %d to %d.\n",
+                                  SegmentSize,
                                   Socket->CongestionWindowSize);
                 }
+
+            //
+            // Perform congestion avoidance, which is up to the algorithm.
+            //
+
+            } else {
+                AcknowledgedBytes = AcknowledgeNumber -
+                                    Socket->PreviousAcknowledgeNumber;
+
+                if (AcknowledgedBytes > Socket->CongestionWindowSize) {
+                    AcknowledgedBytes = Socket->CongestionWindowSize;
+                }
+
+                Socket->CongestionOperations->CongestionAvoid(
+                                                           Socket,
+                                                           AcknowledgedBytes);
             }
         }
 
     //
-    // Process a duplicate ACK.
+    // Process a duplicate ACK. With selective acknowledgments, loss is
+    // detected by RACK instead of by counting duplicates.
     //
 
-    } else if (Socket->DuplicateAcknowledgeCount >=
-               TCP_DUPLICATE_ACK_THRESHOLD) {
+    } else if (((Socket->Flags & TCP_SOCKET_FLAG_SELECTIVE_ACKNOWLEDGE) == 0) &&
+               (Socket->DuplicateAcknowledgeCount >=
+                TCP_DUPLICATE_ACK_THRESHOLD)) {
 
         //
         // Cut the window if this just crossed the "packet loss" threshold.
         //
 
         if (Socket->DuplicateAcknowledgeCount == TCP_DUPLICATE_ACK_THRESHOLD) {
-
-            //
-            // Set the slow start threshold to half the congestion window. The
-            // congestion window is also halved, but three segment sizes are
-            // added to it to represent the packets after the hole that are
-            // presumably buffered on the other side. This is called "inflating"
-            // the window.
-            //
-
-            Socket->SlowStartThreshold = Socket->CongestionWindowSize / 2;
-            Socket->CongestionWindowSize = (Socket->CongestionWindowSize / 2) +
-                                   (TCP_DUPLICATE_ACK_THRESHOLD * SegmentSize);
-
-            Socket->Flags |= TCP_SOCKET_FLAG_IN_FAST_RECOVERY;
-            Socket->FastRecoveryEndSequence = Socket->SendNextNetworkSequence;
-            if (NetTcpDebugPrintCongestionControl != FALSE) {
-                NetpTcpPrintSocketEndpoints(Socket, FALSE);
-                RtlDebugPrint(" Entering FastRecovery. SlowStartThreshold %d, "
-                              "Window %d, FastRecoveryEnd %x\n",
-                              Socket->SlowStartThreshold,
-                              Socket->CongestionWindowSize,
-                              Socket->FastRecoveryEndSequence);
-            }
+            NetpTcpCongestionEnterRecovery(Socket);
 
         //
         // Process additional duplicate ACKs coming in after the window was cut.
@@ -406,6 +462,63 @@ Return Value:
     return;
 }
 
+VOID
+NetpTcpCongestionEnterRecovery (
+    PTCP_SOCKET Socket
+    )
+
+/*++
+
+Routine Description:
+
+    This routine cuts the congestion window in response to detected packet
+    loss and enters fast recovery. This routine assumes the socket lock is
+    already held.
+
+Arguments:
+
+    Socket - Supplies a pointer to the socket that lost a packet.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    //
+    // Let the algorithm pick the new slow start threshold, and cut the
+    // congestion window down to it. Without selective acknowledgments three
+    // segment sizes are added to it to represent the packets after the hole
+    // that are presumably buffered on the other side. This is called
+    // "inflating" the window. With selective acknowledgments, the send path
+    // accounts for those packets precisely.
+    //
+
+    Socket->SlowStartThreshold =
+           Socket->CongestionOperations->GetSlowStartThreshold(Socket, FALSE);
+
+    Socket->CongestionWindowSize = Socket->SlowStartThreshold;
+    if ((Socket->Flags & TCP_SOCKET_FLAG_SELECTIVE_ACKNOWLEDGE) == 0) {
+        Socket->CongestionWindowSize += TCP_DUPLICATE_ACK_THRESHOLD *
+                                        Socket->SendMaxSegmentSize;
+    }
+
+    Socket->Flags |= TCP_SOCKET_FLAG_IN_FAST_RECOVERY;
+    Socket->FastRecoveryEndSequence = Socket->SendNextNetworkSequence;
+    if (NetTcpDebugPrintCongestionControl != FALSE) {
+        NetpTcpPrintSocketEndpoints(Socket, FALSE);
+        RtlDebugPrint(" Entering FastRecovery. SlowStartThreshold %d, "
+                      "Window %d, FastRecoveryEnd %x\n",
+                      Socket->SlowStartThreshold,
+                      Socket->CongestionWindowSize,
+                      Socket->FastRecoveryEndSequence);
+    }
+
+    return;
+}
+
 VOID
 NetpTcpProcessNewRoundTripTimeSample (
     PTCP_SOCKET Socket,
@@ -582,11 +695,14 @@ Return Value:
     ULONGLONG TimeoutTime;
 
     //
-    // Set the slow start threshold to half of what the congestion window was
-    // before the loss. Move all the way back to slow start for a loss.
+    // Let the algorithm set the slow start threshold based on what the
+    // congestion window was before the loss. Move all the way back to slow
+    // start for a loss.
     //
 
-    Socket->SlowStartThreshold = Socket->CongestionWindowSize / 2;
+    Socket->SlowStartThreshold =
+            Socket->CongestionOperations->GetSlowStartThreshold(Socket, TRUE);
+
     Socket->CongestionWindowSize = Socket->SendMaxSegmentSize;
     if (NetTcpDebugPrintCongestionControl != FALSE) {
         NetpTcpPrintSocketEndpoints(Socket, TRUE);
@@ -611,7 +727,238 @@ Return Value:
     return;
 }
 
+KSTATUS
+NetpTcpCongestionSetAlgorithm (
+    PTCP_SOCKET Socket,
+    ULONG Algorithm
+    )
+
+/*++
+
+Routine Description:
+
+    This routine switches the congestion control algorithm used by a socket.
+    The current congestion window is kept. This routine assumes the socket
+    lock is already held, or that the socket is still being created.
+
+Arguments:
+
+    Socket - Supplies a pointer to the socket.
+
+    Algorithm - Supplies the new algorithm. See
+        SOCKET_TCP_CONGESTION_ALGORITHM.
+
+Return Value:
+
+    STATUS_SUCCESS on success.
+
+    STATUS_INVALID_PARAMETER if the algorithm is not valid.
+
+--*/
+
+{
+
+    if (Algorithm >= SocketTcpCongestionAlgorithmCount) {
+        return STATUS_INVALID_PARAMETER;
+    }
+
+    Socket->CongestionAlgorithm = Algorithm;
+    Socket->CongestionOperations = NetTcpCongestionAlgorithms[Algorithm];
+    Socket->CongestionOperations->Initialize(Socket);
+    return STATUS_SUCCESS;
+}
+
 //
 // --------------------------------------------------------- Internal Functions
 //
 
+ULONG
+NetpTcpPaceSendWindow (
+    PTCP_SOCKET Socket,
+    ULONG WindowSize
+    )
+
+/*++
+
+Routine Description:
+
+    This routine limits the send window so that data goes out at a steady rate
+    over the round trip time rather than in one burst. The allowance grows
+    with time, and is capped at a small burst beyond what has already been
+    sent so that it doesn't pile up while the connection is idle.
+
+Arguments:
+
+    Socket - Supplies a pointer to the socket.
+
+    WindowSize - Supplies the send window allowed by congestion control and
+        the receiver.
+
+Return Value:
+
+    Returns the paced send window size.
+
+--*/
+
+{
+
+    ULONG Ceiling;
+    ULONGLONG Credit;
+    ULONGLONG CurrentTime;
+    ULONGLONG Elapsed;
+    ULONG Gain;
+    ULONG PacedWindow;
+    ULONGLONG RoundTripTicks;
+    ULONG WindowBegin;
+
+    RoundTripTicks = Socket->RoundTripTime / TCP_ROUND_TRIP_SAMPLE_DENOMINATOR;
+    if (RoundTripTicks == 0) {
+        return WindowSize;
+    }
+
+    CurrentTime = HlQueryTimeCounter();
+    Ceiling = Socket->SendNextNetworkSequence +
+              (TCP_PACING_BURST_SEGMENTS * Socket->SendMaxSegmentSize);
+
+    if (Socket->PacingTime == 0) {
+        Socket->PacingLimit = Ceiling;
+
+    } else {
+        Elapsed = CurrentTime - Socket->PacingTime;
+        if (Elapsed > RoundTripTicks) {
+            Elapsed = RoundTripTicks;
+        }
+
+        Gain = TCP_PACING_CONGESTION_AVOIDANCE_GAIN;
+        if (Socket->CongestionWindowSize <= Socket->SlowStartThreshold) {
+            Gain = TCP_PACING_SLOW_START_GAIN;
+        }
+
+        Credit = ((ULONGLONG)Socket->CongestionWindowSize * Gain) /
+                 TCP_PACING_GAIN_DENOMINATOR;
+
+        Credit = (Credit * Elapsed) / RoundTripTicks;
+        Socket->PacingLimit += (ULONG)Credit;
+        if (TCP_SEQUENCE_GREATER_THAN(Socket->PacingLimit, Ceiling)) {
+            Socket->PacingLimit = Ceiling;
+        }
+    }
+
+    Socket->PacingTime = CurrentTime;
+    WindowBegin = Socket->SendWindowUpdateAcknowledge;
+    if (!TCP_SEQUENCE_GREATER_THAN(Socket->PacingLimit, WindowBegin)) {
+        return 0;
+    }
+
+    PacedWindow = Socket->PacingLimit - WindowBegin;
+    if (PacedWindow < WindowSize) {
+        WindowSize = PacedWindow;
+    }
+
+    return WindowSize;
+}
+
+VOID
+NetpTcpNewRenoInitialize (
+    PTCP_SOCKET Socket
+    )
+
+/*++
+
+Routine Description:
+
+    This routine resets the New Reno state for the given socket. New Reno has
+    no private state.
+
+Arguments:
+
+    Socket - Supplies a pointer to the socket.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    return;
+}
+
+ULONG
+NetpTcpNewRenoGetSlowStartThreshold (
+    PTCP_SOCKET Socket,
+    BOOL Timeout
+    )
+
+/*++
+
+Routine Description:
+
+    This routine is called when packet loss is detected. It determines the new
+    slow start threshold.
+
+Arguments:
+
+    Socket - Supplies a pointer to the socket that lost a packet.
+
+    Timeout - Supplies a boolean indicating whether the loss was detected by
+        a retransmission timeout (TRUE) or by fast retransmit or RACK (FALSE).
+
+Return Value:
+
+    Returns half of the congestion window.
+
+--*/
+
+{
+
+    return Socket->CongestionWindowSize / 2;
+}
+
+VOID
+NetpTcpNewRenoCongestionAvoid (
+    PTCP_SOCKET Socket,
+    ULONG AcknowledgedBytes
+    )
+
+/*++
+
+Routine Description:
+
+    This routine grows the congestion window by about one segment per round
+    trip.
+
+Arguments:
+
+    Socket - Supplies a pointer to the socket.
+
+    AcknowledgedBytes - Supplies the number of bytes newly acknowledged.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    ULONG SegmentSize;
+    ULONG WindowIncrease;
+
+    SegmentSize = Socket->SendMaxSegmentSize;
+    WindowIncrease = SegmentSize * SegmentSize / Socket->CongestionWindowSize;
+    if (WindowIncrease == 0) {
+        WindowIncrease = 1;
+    }
+
+    Socket->CongestionWindowSize += WindowIncrease;
+    if (NetTcpDebugPrintCongestionControl != FALSE) {
+        NetpTcpPrintSocketEndpoints(Socket, FALSE);
+        RtlDebugPrint(" CongestionAvoid Window up by %d to %d.\n",
+                      WindowIncrease,
+                      Socket->CongestionWindowSize);
+    }
+
+    return;
+}
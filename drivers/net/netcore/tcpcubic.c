@@ -0,0 +1,497 @@
+/*++
+
+Copyright (c) 2026 Minoca Corp.
+
+    This file is licensed under the terms of the GNU General Public License
+    version 3. Alternative licensing terms are available. Contact
+    info@minocacorp.com for details. See the LICENSE file at the root of this
+    project for complete licensing information.
+
+Module Name:
+
+    tcpcubic.c
+
+Abstract:
+
+    This module implements the CUBIC TCP congestion control algorithm
+    (RFC 8312). After a loss, the window grows along a cubic function of the
+    time since the loss: quickly back up towards the window where the loss
+    happened, flat around it, and then quickly again beyond it. Growth doesn't
+    depend on the round trip time, so long fat links recover much faster than
+    with New Reno.
+
+Author:
+
+    Minoca Corp. 17-Oct-2026
+
+Environment:
+
+    Kernel
+
+--*/
+
+//
+// ------------------------------------------------------------------- Includes
+//
+
+//
+// Protocol drivers are supposed to be able to stand on their own (ie be able to
+// be implemented outside the core net library). For the builtin ones, avoid
+// including netcore.h, but still redefine those functions that would otherwise
+// generate imports.
+//
+
+#define NET_API __DLLEXPORT
+
+#include <minoca/kernel/driver.h>
+#include <minoca/net/netdrv.h>
+#include "tcp.h"
+
+//
+// ---------------------------------------------------------------- Definitions
+//
+
+//
+// Define the multiplicative decrease factor, beta, as a fraction. The window
+// is cut to 70% upon loss.
+//
+
+#define TCP_CUBIC_BETA_NUMERATOR 7
+#define TCP_CUBIC_BETA_DENOMINATOR 10
+
+//
+// Define the cubic scaling constant, C, as a fraction. This is in segments
+// per second cubed.
+//
+
+#define TCP_CUBIC_C_NUMERATOR 4
+#define TCP_CUBIC_C_DENOMINATOR 10
+
+//
+// Define the additive increase factor New Reno would need to match CUBIC's
+// average rate given beta: 3 * (1 - beta) / (1 + beta), as a fraction.
+//
+
+#define TCP_CUBIC_ALPHA_NUMERATOR 9
+#define TCP_CUBIC_ALPHA_DENOMINATOR 17
+
+//
+// Define the largest time offset from the plateau that the cubic function is
+// evaluated at, in milliseconds. This keeps the cube from overflowing.
+//
+
+#define TCP_CUBIC_MAX_TIME_OFFSET (1000 * MILLISECONDS_PER_SECOND)
+
+//
+// Define the smallest slow start threshold, in segments.
+//
+
+#define TCP_CUBIC_MIN_THRESHOLD_SEGMENTS 2
+
+//
+// ------------------------------------------------------ Data Type Definitions
+//
+
+//
+// ----------------------------------------------- Internal Function Prototypes
+//
+
+VOID
+NetpTcpCubicInitialize (
+    PTCP_SOCKET Socket
+    );
+
+ULONG
+NetpTcpCubicGetSlowStartThreshold (
+    PTCP_SOCKET Socket,
+    BOOL Timeout
+    );
+
+VOID
+NetpTcpCubicCongestionAvoid (
+    PTCP_SOCKET Socket,
+    ULONG AcknowledgedBytes
+    );
+
+ULONG
+NetpTcpCubicGetTargetWindow (
+    PTCP_SOCKET Socket,
+    ULONGLONG CurrentTime
+    );
+
+ULONG
+NetpTcpCubicRoot (
+    ULONGLONG Value
+    );
+
+//
+// -------------------------------------------------------------------- Globals
+//
+
+TCP_CONGESTION_OPERATIONS NetTcpCubicOperations = {
+    NetpTcpCubicInitialize,
+    NetpTcpCubicGetSlowStartThreshold,
+    NetpTcpCubicCongestionAvoid
+};
+
+//
+// ------------------------------------------------------------------ Functions
+//
+
+//
+// --------------------------------------------------------- Internal Functions
+//
+
+VOID
+NetpTcpCubicInitialize (
+    PTCP_SOCKET Socket
+    )
+
+/*++
+
+Routine Description:
+
+    This routine resets the CUBIC state for the given socket.
+
+Arguments:
+
+    Socket - Supplies a pointer to the socket.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    RtlZeroMemory(&(Socket->CongestionData.Cubic), sizeof(TCP_CUBIC_DATA));
+    return;
+}
+
+ULONG
+NetpTcpCubicGetSlowStartThreshold (
+    PTCP_SOCKET Socket,
+    BOOL Timeout
+    )
+
+/*++
+
+Routine Description:
+
+    This routine is called when packet loss is detected. It records the
+    window at which the loss happened and determines the new slow start
+    threshold.
+
+Arguments:
+
+    Socket - Supplies a pointer to the socket that lost a packet.
+
+    Timeout - Supplies a boolean indicating whether the loss was detected by
+        a retransmission timeout (TRUE) or by fast retransmit or RACK (FALSE).
+
+Return Value:
+
+    Returns the new slow start threshold, in bytes.
+
+--*/
+
+{
+
+    PTCP_CUBIC_DATA Cubic;
+    ULONG MinThreshold;
+    ULONG Threshold;
+    ULONG Window;
+
+    Cubic = &(Socket->CongestionData.Cubic);
+    Window = Socket->CongestionWindowSize;
+
+    //
+    // If the loss happened before the window got back to where the last one
+    // did, another flow is probably competing for the link. Give up a bit more
+    // bandwidth so it can converge faster.
+    //
+
+    if (Window < Cubic->MaxWindow) {
+        Cubic->MaxWindow = ((ULONGLONG)Window *
+                            (TCP_CUBIC_BETA_DENOMINATOR +
+                             TCP_CUBIC_BETA_NUMERATOR)) /
+                           (2 * TCP_CUBIC_BETA_DENOMINATOR);
+
+    } else {
+        Cubic->MaxWindow = Window;
+    }
+
+    Cubic->EpochStart = 0;
+    Threshold = ((ULONGLONG)Window * TCP_CUBIC_BETA_NUMERATOR) /
+                TCP_CUBIC_BETA_DENOMINATOR;
+
+    MinThreshold = TCP_CUBIC_MIN_THRESHOLD_SEGMENTS *
+                   Socket->SendMaxSegmentSize;
+
+    if (Threshold < MinThreshold) {
+        Threshold = MinThreshold;
+    }
+
+    if (NetTcpDebugPrintCongestionControl != FALSE) {
+        NetpTcpPrintSocketEndpoints(Socket, FALSE);
+        RtlDebugPrint(" CUBIC loss%s: MaxWindow %d, SlowStartThreshold %d.\n",
+                      (Timeout != FALSE) ? " (timeout)" : "",
+                      Cubic->MaxWindow,
+                      Threshold);
+    }
+
+    return Threshold;
+}
+
+VOID
+NetpTcpCubicCongestionAvoid (
+    PTCP_SOCKET Socket,
+    ULONG AcknowledgedBytes
+    )
+
+/*++
+
+Routine Description:
+
+    This routine grows the congestion window towards the cubic function's
+    target for one round trip from now.
+
+Arguments:
+
+    Socket - Supplies a pointer to the socket.
+
+    AcknowledgedBytes - Supplies the number of bytes newly acknowledged.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PTCP_CUBIC_DATA Cubic;
+    ULONGLONG CurrentTime;
+    ULONGLONG Increase;
+    ULONGLONG RenoIncrease;
+    ULONG SegmentSize;
+    ULONG Target;
+    ULONG Window;
+
+    Cubic = &(Socket->CongestionData.Cubic);
+    SegmentSize = Socket->SendMaxSegmentSize;
+    Window = Socket->CongestionWindowSize;
+    CurrentTime = KeGetRecentTimeCounter();
+
+    //
+    // Start a new epoch on the first acknowledgment of congestion avoidance.
+    // The plateau time is how long the cubic function takes to climb from the
+    // current window back to where the last loss happened.
+    //
+
+    if (Cubic->EpochStart == 0) {
+        Cubic->EpochStart = CurrentTime;
+        Cubic->EstimatedWindow = Window;
+        if (Window < Cubic->MaxWindow) {
+            Cubic->PlateauTime = NetpTcpCubicRoot(
+                        (((ULONGLONG)(Cubic->MaxWindow - Window) *
+                          MILLISECONDS_PER_SECOND) / SegmentSize) *
+                        ((ULONGLONG)MILLISECONDS_PER_SECOND *
+                         MILLISECONDS_PER_SECOND * TCP_CUBIC_C_DENOMINATOR /
+                         TCP_CUBIC_C_NUMERATOR));
+
+            Cubic->OriginWindow = Cubic->MaxWindow;
+
+        } else {
+            Cubic->PlateauTime = 0;
+            Cubic->OriginWindow = Window;
+        }
+    }
+
+    //
+    // Move towards the target a fraction of the gap for each acknowledged
+    // segment, so that it is reached in about a round trip. If already at the
+    // target, just creep forward.
+    //
+
+    Target = NetpTcpCubicGetTargetWindow(Socket, CurrentTime);
+    if (Target > Window) {
+        Increase = ((ULONGLONG)(Target - Window) * AcknowledgedBytes) / Window;
+        if (Increase == 0) {
+            Increase = 1;
+        }
+
+    } else {
+        Increase = ((ULONGLONG)SegmentSize * AcknowledgedBytes) /
+                   (100 * Window);
+    }
+
+    //
+    // Never grow slower than New Reno would in the same situation. This is
+    // what happens on short, slow links where the cubic function is flat.
+    //
+
+    RenoIncrease = ((ULONGLONG)SegmentSize * AcknowledgedBytes *
+                    TCP_CUBIC_ALPHA_NUMERATOR) /
+                   ((ULONGLONG)Window * TCP_CUBIC_ALPHA_DENOMINATOR);
+
+    Cubic->EstimatedWindow += RenoIncrease;
+    if (Cubic->EstimatedWindow > Window + Increase) {
+        Increase = Cubic->EstimatedWindow - Window;
+    }
+
+    if (Window + Increase > MAX_LONG) {
+        Increase = MAX_LONG - Window;
+    }
+
+    Socket->CongestionWindowSize += (ULONG)Increase;
+    if (NetTcpDebugPrintCongestionControl != FALSE) {
+        NetpTcpPrintSocketEndpoints(Socket, FALSE);
+        RtlDebugPrint(" CUBIC Window up by %d to %d, target %d.\n",
+                      (ULONG)Increase,
+                      Socket->CongestionWindowSize,
+                      Target);
+    }
+
+    return;
+}
+
+ULONG
+NetpTcpCubicGetTargetWindow (
+    PTCP_SOCKET Socket,
+    ULONGLONG CurrentTime
+    )
+
+/*++
+
+Routine Description:
+
+    This routine evaluates the cubic window function one round trip time from
+    now: W(t) = C * (t - K)^3 + Origin.
+
+Arguments:
+
+    Socket - Supplies a pointer to the socket.
+
+    CurrentTime - Supplies the current time counter value.
+
+Return Value:
+
+    Returns the target congestion window, in bytes.
+
+--*/
+
+{
+
+    PTCP_CUBIC_DATA Cubic;
+    ULONGLONG Delta;
+    ULONGLONG Frequency;
+    ULONGLONG Offset;
+    ULONGLONG RoundTripTicks;
+    ULONGLONG Target;
+    ULONGLONG Time;
+    ULONG Window;
+
+    Cubic = &(Socket->CongestionData.Cubic);
+    Frequency = HlQueryTimeCounterFrequency();
+    RoundTripTicks = Socket->MinRoundTripTime;
+    if (RoundTripTicks == 0) {
+        RoundTripTicks = Socket->RoundTripTime /
+                         TCP_ROUND_TRIP_SAMPLE_DENOMINATOR;
+    }
+
+    Time = ((CurrentTime - Cubic->EpochStart + RoundTripTicks) *
+            MILLISECONDS_PER_SECOND) / Frequency;
+
+    if (Time >= Cubic->PlateauTime) {
+        Offset = Time - Cubic->PlateauTime;
+
+    } else {
+        Offset = Cubic->PlateauTime - Time;
+    }
+
+    if (Offset > TCP_CUBIC_MAX_TIME_OFFSET) {
+        Offset = TCP_CUBIC_MAX_TIME_OFFSET;
+    }
+
+    //
+    // The offset is in milliseconds, so the cube is in units of 10^-9 seconds
+    // cubed. Divide some of that out first to stay clear of overflow.
+    //
+
+    Delta = (Offset * Offset * Offset) /
+            (MILLISECONDS_PER_SECOND * MILLISECONDS_PER_SECOND);
+
+    Delta = (Delta * TCP_CUBIC_C_NUMERATOR * Socket->SendMaxSegmentSize) /
+            (TCP_CUBIC_C_DENOMINATOR * MILLISECONDS_PER_SECOND);
+
+    if (Time >= Cubic->PlateauTime) {
+        Target = Cubic->OriginWindow + Delta;
+
+    } else if (Delta < Cubic->OriginWindow) {
+        Target = Cubic->OriginWindow - Delta;
+
+    } else {
+        Target = 0;
+    }
+
+    //
+    // Don't grow more than 50% in a single round trip.
+    //
+
+    Window = Socket->CongestionWindowSize;
+    if (Target > Window + (Window / 2)) {
+        Target = Window + (Window / 2);
+    }
+
+    return (ULONG)Target;
+}
+
+ULONG
+NetpTcpCubicRoot (
+    ULONGLONG Value
+    )
+
+/*++
+
+Routine Description:
+
+    This routine computes the integer cube root of the given value.
+
+Arguments:
+
+    Value - Supplies the value.
+
+Return Value:
+
+    Returns the largest integer whose cube is less than or equal to the value.
+
+--*/
+
+{
+
+    ULONGLONG Cube;
+    ULONGLONG Guess;
+    ULONGLONG High;
+    ULONGLONG Low;
+
+    //
+    // The cube root of the largest 64-bit value fits in 21 bits.
+    //
+
+    Low = 0;
+    High = (1ULL << 21);
+    while (Low < High) {
+        Guess = (Low + High + 1) / 2;
+        Cube = Guess * Guess * Guess;
+        if (Cube <= Value) {
+            Low = Guess;
+
+        } else {
+            High = Guess - 1;
+        }
+    }
+
+    return (ULONG)Low;
+}
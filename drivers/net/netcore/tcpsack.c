@@ -0,0 +1,896 @@
+/*++
+
+Copyright (c) 2026 Minoca Corp.
+
+    This file is licensed under the terms of the GNU General Public License
+    version 3. Alternative licensing terms are available. Contact
+    info@minocacorp.com for details. See the LICENSE file at the root of this
+    project for complete licensing information.
+
+Module Name:
+
+    tcpsack.c
+
+Abstract:
+
+    This module implements TCP selective acknowledgments (RFC 2018),
+    timestamps (RFC 7323), and RACK loss detection (RFC 8985). Loss detected
+    here is handed to the congestion control module.
+
+Author:
+
+    Minoca Corp. 17-Oct-2026
+
+Environment:
+
+    Kernel
+
+--*/
+
+//
+// ------------------------------------------------------------------- Includes
+//
+
+//
+// Protocol drivers are supposed to be able to stand on their own (ie be able to
+// be implemented outside the core net library). For the builtin ones, avoid
+// including netcore.h, but still redefine those functions that would otherwise
+// generate imports.
+//
+
+#define NET_API __DLLEXPORT
+
+#include <minoca/kernel/driver.h>
+#include <minoca/net/netdrv.h>
+#include "tcp.h"
+
+//
+// ---------------------------------------------------------------- Definitions
+//
+
+//
+// Define the denominator of the debug impairment rates.
+//
+
+#define TCP_DEBUG_IMPAIR_RATE_DENOMINATOR 1000
+
+//
+// ------------------------------------------------------ Data Type Definitions
+//
+
+//
+// ----------------------------------------------- Internal Function Prototypes
+//
+
+ULONG
+NetpTcpGetSackBlocks (
+    PTCP_SOCKET Socket,
+    PTCP_SACK_BLOCK Blocks,
+    ULONG MaxBlocks
+    );
+
+ULONG
+NetpTcpDebugRandom (
+    VOID
+    );
+
+//
+// -------------------------------------------------------------------- Globals
+//
+
+//
+// Store the debug transmit impairment rates, in packets per thousand. These
+// are meant to be set from the debugger to exercise loss recovery.
+//
+
+ULONG NetTcpDebugTransmitDropRate = 0;
+ULONG NetTcpDebugTransmitReorderRate = 0;
+ULONG NetTcpDebugImpairSeed = 1;
+
+//
+// ------------------------------------------------------------------ Functions
+//
+
+ULONG
+NetpTcpGetTimestamp (
+    VOID
+    )
+
+/*++
+
+Routine Description:
+
+    This routine returns the current value of the clock used in outgoing
+    timestamp options.
+
+Arguments:
+
+    None.
+
+Return Value:
+
+    Returns the current timestamp, in milliseconds. This is never zero.
+
+--*/
+
+{
+
+    ULONGLONG Counter;
+    ULONGLONG Frequency;
+    ULONG Timestamp;
+
+    //
+    // Convert whole seconds and the leftover ticks separately, as multiplying
+    // the raw counter by a thousand overflows after a few months of uptime on
+    // a fast counter. The timestamp itself is allowed to wrap.
+    //
+
+    Counter = HlQueryTimeCounter();
+    Frequency = HlQueryTimeCounterFrequency();
+    Timestamp = ((Counter / Frequency) * MILLISECONDS_PER_SECOND) +
+                (((Counter % Frequency) * MILLISECONDS_PER_SECOND) /
+                 Frequency);
+
+    //
+    // A zero echo means "no timestamp" to the receiving side, so avoid ever
+    // handing one out.
+    //
+
+    if (Timestamp == 0) {
+        Timestamp = 1;
+    }
+
+    return Timestamp;
+}
+
+ULONG
+NetpTcpBuildOptions (
+    PTCP_SOCKET Socket,
+    BOOL IncludeSack,
+    PUCHAR Options
+    )
+
+/*++
+
+Routine Description:
+
+    This routine writes out the options that accompany a non-SYN packet. This
+    routine assumes the socket lock is already held.
+
+Arguments:
+
+    Socket - Supplies a pointer to the socket sending the packet.
+
+    IncludeSack - Supplies a boolean indicating whether SACK blocks describing
+        out of order received data should be included if there are any.
+
+    Options - Supplies a pointer to a buffer of at least
+        TCP_MAXIMUM_OPTIONS_SIZE bytes where the options will be written.
+
+Return Value:
+
+    Returns the number of bytes of options written, which is always a multiple
+    of four.
+
+--*/
+
+{
+
+    TCP_SACK_BLOCK Blocks[TCP_MAXIMUM_SACK_BLOCKS];
+    ULONG BlockCount;
+    ULONG BlockIndex;
+    ULONG Length;
+    ULONG MaxBlocks;
+
+    Length = 0;
+    if ((Socket->Flags & TCP_SOCKET_FLAG_TIMESTAMPS) != 0) {
+        Options[0] = TCP_OPTION_NOP;
+        Options[1] = TCP_OPTION_NOP;
+        Options[2] = TCP_OPTION_TIMESTAMPS;
+        Options[3] = TCP_OPTION_TIMESTAMPS_SIZE;
+        *((PULONG)&(Options[4])) = CPU_TO_NETWORK32(NetpTcpGetTimestamp());
+        *((PULONG)&(Options[8])) = CPU_TO_NETWORK32(Socket->TimestampRecent);
+        Length += TCP_OPTION_TIMESTAMPS_PADDED_SIZE;
+    }
+
+    //
+    // Only describe received data if there is a hole in it.
+    //
+
+    if ((IncludeSack == FALSE) ||
+        ((Socket->Flags & TCP_SOCKET_FLAG_SELECTIVE_ACKNOWLEDGE) == 0) ||
+        ((Socket->Flags & TCP_SOCKET_FLAG_RECEIVE_MISSING_SEGMENTS) == 0)) {
+
+        return Length;
+    }
+
+    MaxBlocks = (TCP_MAXIMUM_OPTIONS_SIZE - Length -
+                 TCP_OPTION_SACK_PADDED_SIZE) / TCP_OPTION_SACK_BLOCK_SIZE;
+
+    if (MaxBlocks > TCP_MAXIMUM_SACK_BLOCKS) {
+        MaxBlocks = TCP_MAXIMUM_SACK_BLOCKS;
+    }
+
+    BlockCount = NetpTcpGetSackBlocks(Socket, Blocks, MaxBlocks);
+    if (BlockCount == 0) {
+        return Length;
+    }
+
+    Options[Length] = TCP_OPTION_NOP;
+    Options[Length + 1] = TCP_OPTION_NOP;
+    Options[Length + 2] = TCP_OPTION_SACK;
+    Options[Length + 3] = 2 + (BlockCount * TCP_OPTION_SACK_BLOCK_SIZE);
+    Length += TCP_OPTION_SACK_PADDED_SIZE;
+    for (BlockIndex = 0; BlockIndex < BlockCount; BlockIndex += 1) {
+        *((PULONG)&(Options[Length])) =
+                              CPU_TO_NETWORK32(Blocks[BlockIndex].LeftEdge);
+
+        *((PULONG)&(Options[Length + 4])) =
+                             CPU_TO_NETWORK32(Blocks[BlockIndex].RightEdge);
+
+        Length += TCP_OPTION_SACK_BLOCK_SIZE;
+    }
+
+    ASSERT(Length <= TCP_MAXIMUM_OPTIONS_SIZE);
+
+    return Length;
+}
+
+BOOL
+NetpTcpProcessTimestamp (
+    PTCP_SOCKET Socket,
+    PTCP_HEADER Header,
+    PTCP_PACKET_OPTIONS Options
+    )
+
+/*++
+
+Routine Description:
+
+    This routine processes the timestamp option of an acceptable incoming
+    segment, rejecting old duplicates and updating the timestamp to echo.
+    This routine assumes the socket lock is already held.
+
+Arguments:
+
+    Socket - Supplies a pointer to the socket.
+
+    Header - Supplies a pointer to the TCP header of the segment.
+
+    Options - Supplies a pointer to the options parsed from the segment.
+
+Return Value:
+
+    TRUE if the segment should be processed.
+
+    FALSE if the segment is an old duplicate and should be dropped.
+
+--*/
+
+{
+
+    ULONGLONG IdleTime;
+    ULONGLONG RecentTime;
+    ULONG SequenceNumber;
+
+    Socket->TimestampEcho = 0;
+    if (((Socket->Flags & TCP_SOCKET_FLAG_TIMESTAMPS) == 0) ||
+        ((Options->Flags & TCP_PACKET_OPTION_TIMESTAMPS) == 0)) {
+
+        return TRUE;
+    }
+
+    //
+    // Protect against wrapped sequence numbers by dropping segments whose
+    // timestamp went backwards, unless the connection has been idle so long
+    // that the recent timestamp itself is untrustworthy. Do this before
+    // taking anything from the segment.
+    //
+
+    RecentTime = KeGetRecentTimeCounter();
+    if (((Header->Flags & TCP_HEADER_FLAG_RESET) == 0) &&
+        (Socket->TimestampRecentTime != 0) &&
+        (TCP_SEQUENCE_LESS_THAN(Options->TimestampValue,
+                                Socket->TimestampRecent))) {
+
+        IdleTime = RecentTime - Socket->TimestampRecentTime;
+        if (IdleTime <
+            (TCP_PAWS_IDLE_LIMIT * HlQueryTimeCounterFrequency())) {
+
+            if (NetTcpDebugPrintSequenceNumbers != FALSE) {
+                NetpTcpPrintSocketEndpoints(Socket, FALSE);
+                RtlDebugPrint(" RX old timestamp %d, recent %d. Dropping.\n",
+                              Options->TimestampValue,
+                              Socket->TimestampRecent);
+            }
+
+            return FALSE;
+        }
+    }
+
+    //
+    // The segment is acceptable, so its echo can be used to measure the
+    // round trip time.
+    //
+
+    if ((Header->Flags & TCP_HEADER_FLAG_ACKNOWLEDGE) != 0) {
+        Socket->TimestampEcho = Options->TimestampEcho;
+    }
+
+    //
+    // Per RFC 7323 section 4.3, only remember the timestamp if it did not go
+    // backwards and the segment covers the last acknowledge sent
+    // (SEG.SEQ <= Last.ACK.sent), so that the echoed value reflects the
+    // oldest unacknowledged segment rather than delayed or reordered ones.
+    //
+
+    SequenceNumber = NETWORK_TO_CPU32(Header->SequenceNumber);
+    if (((Socket->TimestampRecentTime == 0) ||
+         (!TCP_SEQUENCE_LESS_THAN(Options->TimestampValue,
+                                  Socket->TimestampRecent))) &&
+        (!TCP_SEQUENCE_GREATER_THAN(SequenceNumber,
+                                    Socket->LastAcknowledgeSent))) {
+
+        Socket->TimestampRecent = Options->TimestampValue;
+        Socket->TimestampRecentTime = RecentTime;
+    }
+
+    return TRUE;
+}
+
+VOID
+NetpTcpProcessSelectiveAcknowledge (
+    PTCP_SOCKET Socket,
+    PTCP_PACKET_OPTIONS Options,
+    PULONGLONG CurrentTime
+    )
+
+/*++
+
+Routine Description:
+
+    This routine marks outgoing segments covered by incoming SACK blocks and
+    runs RACK loss detection. This routine assumes the socket lock is already
+    held.
+
+Arguments:
+
+    Socket - Supplies a pointer to the socket.
+
+    Options - Supplies a pointer to the options parsed from the incoming
+        acknowledgment.
+
+    CurrentTime - Supplies a pointer to a time counter value for an approximate
+        current time. If it is set to 0, it may be updated by this routine.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PTCP_SACK_BLOCK Block;
+    ULONG BlockIndex;
+    PLIST_ENTRY CurrentEntry;
+    PTCP_SEND_SEGMENT Segment;
+    ULONG SegmentBegin;
+    ULONG SegmentEnd;
+    ULONG SegmentLength;
+
+    if (((Socket->Flags & TCP_SOCKET_FLAG_SELECTIVE_ACKNOWLEDGE) == 0) ||
+        (LIST_EMPTY(&(Socket->OutgoingSegmentList)) != FALSE)) {
+
+        return;
+    }
+
+    if (*CurrentTime == 0) {
+        *CurrentTime = HlQueryTimeCounter();
+    }
+
+    if ((Options->Flags & TCP_PACKET_OPTION_SACK) != 0) {
+        for (BlockIndex = 0;
+             BlockIndex < Options->SackBlockCount;
+             BlockIndex += 1) {
+
+            Block = &(Options->SackBlocks[BlockIndex]);
+
+            //
+            // Ignore blocks that are malformed, stale, or describe data never
+            // sent.
+            //
+
+            if ((!TCP_SEQUENCE_GREATER_THAN(Block->RightEdge,
+                                            Block->LeftEdge)) ||
+                (!TCP_SEQUENCE_GREATER_THAN(
+                                      Block->RightEdge,
+                                      Socket->SendUnacknowledgedSequence)) ||
+                (TCP_SEQUENCE_GREATER_THAN(Block->RightEdge,
+                                           Socket->SendNextNetworkSequence))) {
+
+                continue;
+            }
+
+            CurrentEntry = Socket->OutgoingSegmentList.Next;
+            while (CurrentEntry != &(Socket->OutgoingSegmentList)) {
+                Segment = LIST_VALUE(CurrentEntry,
+                                     TCP_SEND_SEGMENT,
+                                     Header.ListEntry);
+
+                CurrentEntry = CurrentEntry->Next;
+                if (Segment->SendAttemptCount == 0) {
+                    break;
+                }
+
+                SegmentBegin = Segment->SequenceNumber + Segment->Offset;
+                SegmentEnd = Segment->SequenceNumber + Segment->Length;
+                if (!TCP_SEQUENCE_LESS_THAN(SegmentBegin, Block->RightEdge)) {
+                    break;
+                }
+
+                if (((Segment->Flags & TCP_SEND_SEGMENT_FLAG_SACKED) != 0) ||
+                    (TCP_SEQUENCE_LESS_THAN(SegmentBegin, Block->LeftEdge)) ||
+                    (TCP_SEQUENCE_GREATER_THAN(SegmentEnd,
+                                               Block->RightEdge))) {
+
+                    continue;
+                }
+
+                SegmentLength = SegmentEnd - SegmentBegin;
+                if ((Segment->Flags & TCP_SEND_SEGMENT_FLAG_LOST) != 0) {
+                    Segment->Flags &= ~TCP_SEND_SEGMENT_FLAG_LOST;
+
+                    ASSERT(Socket->LostBytes >= SegmentLength);
+
+                    Socket->LostBytes -= SegmentLength;
+                }
+
+                Segment->Flags |= TCP_SEND_SEGMENT_FLAG_SACKED;
+                Socket->SackedBytes += SegmentLength;
+                NetpTcpRackUpdate(Socket, Segment, *CurrentTime);
+            }
+        }
+    }
+
+    NetpTcpRackDetectLoss(Socket, *CurrentTime);
+    return;
+}
+
+VOID
+NetpTcpRackUpdate (
+    PTCP_SOCKET Socket,
+    PTCP_SEND_SEGMENT Segment,
+    ULONGLONG CurrentTime
+    )
+
+/*++
+
+Routine Description:
+
+    This routine updates the RACK state for a newly delivered segment, either
+    cumulatively or selectively acknowledged.
+
+Arguments:
+
+    Socket - Supplies a pointer to the socket.
+
+    Segment - Supplies a pointer to the newly delivered segment.
+
+    CurrentTime - Supplies the current time counter value.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    ULONG EndSequence;
+    ULONGLONG RoundTripTime;
+
+    if ((Segment->SendAttemptCount == 0) ||
+        (CurrentTime < Segment->LastSendTime)) {
+
+        return;
+    }
+
+    //
+    // If a retransmitted segment is acknowledged faster than any round trip
+    // ever seen, the acknowledgment is most likely for the original
+    // transmission. Don't let it advance RACK.
+    //
+
+    RoundTripTime = CurrentTime - Segment->LastSendTime;
+    if (((Segment->Flags & TCP_SEND_SEGMENT_FLAG_RETRANSMITTED) != 0) &&
+        (RoundTripTime < Socket->MinRoundTripTime)) {
+
+        return;
+    }
+
+    if ((Socket->MinRoundTripTime == 0) ||
+        (RoundTripTime < Socket->MinRoundTripTime)) {
+
+        Socket->MinRoundTripTime = RoundTripTime;
+    }
+
+    EndSequence = Segment->SequenceNumber + Segment->Length;
+    if ((Segment->LastSendTime > Socket->RackSendTime) ||
+        ((Segment->LastSendTime == Socket->RackSendTime) &&
+         (TCP_SEQUENCE_GREATER_THAN(EndSequence, Socket->RackEndSequence)))) {
+
+        Socket->RackSendTime = Segment->LastSendTime;
+        Socket->RackEndSequence = EndSequence;
+        Socket->RackRoundTripTime = RoundTripTime;
+    }
+
+    return;
+}
+
+VOID
+NetpTcpRackDetectLoss (
+    PTCP_SOCKET Socket,
+    ULONGLONG CurrentTime
+    )
+
+/*++
+
+Routine Description:
+
+    This routine marks outgoing segments as lost if a segment sent
+    sufficiently later has already been delivered. It enters fast recovery if
+    new losses are found. This routine assumes the socket lock is already held.
+
+Arguments:
+
+    Socket - Supplies a pointer to the socket.
+
+    CurrentTime - Supplies the current time counter value.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PLIST_ENTRY CurrentEntry;
+    ULONGLONG Deadline;
+    ULONG EndSequence;
+    BOOL NewLoss;
+    ULONGLONG ReorderWindow;
+    PTCP_SEND_SEGMENT Segment;
+    ULONG SegmentLength;
+
+    Socket->RackTimeout = 0;
+    if (Socket->RackSendTime == 0) {
+        return;
+    }
+
+    //
+    // Give reordered segments a quarter of the minimum round trip time to
+    // show up before calling them lost.
+    //
+
+    ReorderWindow = Socket->MinRoundTripTime / TCP_RACK_REORDER_WINDOW_DIVISOR;
+    NewLoss = FALSE;
+    CurrentEntry = Socket->OutgoingSegmentList.Next;
+    while (CurrentEntry != &(Socket->OutgoingSegmentList)) {
+        Segment = LIST_VALUE(CurrentEntry, TCP_SEND_SEGMENT, Header.ListEntry);
+        CurrentEntry = CurrentEntry->Next;
+        if (Segment->SendAttemptCount == 0) {
+            break;
+        }
+
+        if ((Segment->Flags & (TCP_SEND_SEGMENT_FLAG_SACKED |
+                               TCP_SEND_SEGMENT_FLAG_LOST)) != 0) {
+
+            continue;
+        }
+
+        //
+        // Only segments sent before the most recently delivered one can be
+        // judged.
+        //
+
+        EndSequence = Segment->SequenceNumber + Segment->Length;
+        if ((Segment->LastSendTime > Socket->RackSendTime) ||
+            ((Segment->LastSendTime == Socket->RackSendTime) &&
+             (!TCP_SEQUENCE_LESS_THAN(EndSequence, Socket->RackEndSequence)))) {
+
+            continue;
+        }
+
+        Deadline = Segment->LastSendTime + Socket->RackRoundTripTime +
+                   ReorderWindow;
+
+        if (CurrentTime >= Deadline) {
+            SegmentLength = Segment->Length - Segment->Offset;
+            Segment->Flags |= TCP_SEND_SEGMENT_FLAG_LOST;
+            Socket->LostBytes += SegmentLength;
+            NewLoss = TRUE;
+            if (NetTcpDebugPrintCongestionControl != FALSE) {
+                NetpTcpPrintSocketEndpoints(Socket, TRUE);
+                RtlDebugPrint(" RACK lost segment %d size %d.\n",
+                              (Segment->SequenceNumber -
+                               Socket->SendInitialSequence),
+                              SegmentLength);
+            }
+
+        } else if ((Socket->RackTimeout == 0) ||
+                   (Deadline < Socket->RackTimeout)) {
+
+            Socket->RackTimeout = Deadline;
+        }
+    }
+
+    if ((NewLoss != FALSE) &&
+        ((Socket->Flags & TCP_SOCKET_FLAG_IN_FAST_RECOVERY) == 0)) {
+
+        NetpTcpCongestionEnterRecovery(Socket);
+    }
+
+    return;
+}
+
+VOID
+NetpTcpScoreboardRemoveSegment (
+    PTCP_SOCKET Socket,
+    PTCP_SEND_SEGMENT Segment
+    )
+
+/*++
+
+Routine Description:
+
+    This routine removes a segment's contribution to the SACK scoreboard,
+    either because it is being freed or its offset is about to change.
+
+Arguments:
+
+    Socket - Supplies a pointer to the socket.
+
+    Segment - Supplies a pointer to the segment.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    ULONG SegmentLength;
+
+    SegmentLength = Segment->Length - Segment->Offset;
+    if ((Segment->Flags & TCP_SEND_SEGMENT_FLAG_SACKED) != 0) {
+
+        ASSERT(Socket->SackedBytes >= SegmentLength);
+
+        Socket->SackedBytes -= SegmentLength;
+    }
+
+    if ((Segment->Flags & TCP_SEND_SEGMENT_FLAG_LOST) != 0) {
+
+        ASSERT(Socket->LostBytes >= SegmentLength);
+
+        Socket->LostBytes -= SegmentLength;
+    }
+
+    Segment->Flags &= ~(TCP_SEND_SEGMENT_FLAG_SACKED |
+                        TCP_SEND_SEGMENT_FLAG_LOST);
+
+    return;
+}
+
+VOID
+NetpTcpDebugImpairTransmit (
+    PTCP_SOCKET Socket,
+    PNET_PACKET_LIST PacketList
+    )
+
+/*++
+
+Routine Description:
+
+    This routine randomly drops and reorders outgoing packets according to the
+    debug impairment rates. It is used to exercise loss recovery.
+
+Arguments:
+
+    Socket - Supplies a pointer to the sending socket.
+
+    PacketList - Supplies a pointer to the list of packets about to be sent.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PLIST_ENTRY CurrentEntry;
+    ULONG Index;
+    PNET_PACKET_BUFFER Packet;
+    ULONG PacketCount;
+    ULONG Roll;
+
+    if ((NetTcpDebugTransmitDropRate == 0) &&
+        (NetTcpDebugTransmitReorderRate == 0)) {
+
+        return;
+    }
+
+    //
+    // Dropped packets are freed, and reordered packets are moved to the end
+    // of the list so that they go out after the rest of the batch.
+    //
+
+    PacketCount = PacketList->Count;
+    CurrentEntry = PacketList->Head.Next;
+    for (Index = 0; Index < PacketCount; Index += 1) {
+        Packet = LIST_VALUE(CurrentEntry, NET_PACKET_BUFFER, ListEntry);
+        CurrentEntry = CurrentEntry->Next;
+        Roll = NetpTcpDebugRandom() % TCP_DEBUG_IMPAIR_RATE_DENOMINATOR;
+        if (Roll < NetTcpDebugTransmitDropRate) {
+            NET_REMOVE_PACKET_FROM_LIST(Packet, PacketList);
+            NetFreeBuffer(Packet);
+            if (NetTcpDebugPrintSequenceNumbers != FALSE) {
+                NetpTcpPrintSocketEndpoints(Socket, TRUE);
+                RtlDebugPrint(" Debug dropped packet.\n");
+            }
+
+        } else if (Roll < (NetTcpDebugTransmitDropRate +
+                           NetTcpDebugTransmitReorderRate)) {
+
+            NET_REMOVE_PACKET_FROM_LIST(Packet, PacketList);
+            NET_ADD_PACKET_TO_LIST(Packet, PacketList);
+        }
+    }
+
+    return;
+}
+
+//
+// --------------------------------------------------------- Internal Functions
+//
+
+ULONG
+NetpTcpGetSackBlocks (
+    PTCP_SOCKET Socket,
+    PTCP_SACK_BLOCK Blocks,
+    ULONG MaxBlocks
+    )
+
+/*++
+
+Routine Description:
+
+    This routine describes the out of order data sitting in the receive list.
+    The block containing the most recently received segment comes first, as
+    required by RFC 2018, followed by the rest in sequence order.
+
+Arguments:
+
+    Socket - Supplies a pointer to the socket.
+
+    Blocks - Supplies a pointer to an array where the blocks will be returned.
+
+    MaxBlocks - Supplies the number of elements in the blocks array.
+
+Return Value:
+
+    Returns the number of blocks returned.
+
+--*/
+
+{
+
+    ULONG BlockCount;
+    ULONG BlockIndex;
+    PLIST_ENTRY CurrentEntry;
+    ULONG RecentIndex;
+    ULONG RecentSequence;
+    TCP_SACK_BLOCK Regions[TCP_SACK_SCAN_BLOCKS];
+    ULONG RegionCount;
+    PTCP_RECEIVED_SEGMENT Segment;
+
+    RegionCount = 0;
+    RecentIndex = TCP_SACK_SCAN_BLOCKS;
+    RecentSequence = Socket->ReceiveSackRecentSequence;
+    CurrentEntry = Socket->ReceivedSegmentList.Next;
+    while (CurrentEntry != &(Socket->ReceivedSegmentList)) {
+        Segment = LIST_VALUE(CurrentEntry,
+                             TCP_RECEIVED_SEGMENT,
+                             Header.ListEntry);
+
+        CurrentEntry = CurrentEntry->Next;
+        if (!TCP_SEQUENCE_GREATER_THAN(Segment->SequenceNumber,
+                                       Socket->ReceiveNextSequence)) {
+
+            continue;
+        }
+
+        if ((RegionCount != 0) &&
+            (Regions[RegionCount - 1].RightEdge == Segment->SequenceNumber)) {
+
+            Regions[RegionCount - 1].RightEdge = Segment->NextSequence;
+
+        } else {
+            if (RegionCount == TCP_SACK_SCAN_BLOCKS) {
+                break;
+            }
+
+            Regions[RegionCount].LeftEdge = Segment->SequenceNumber;
+            Regions[RegionCount].RightEdge = Segment->NextSequence;
+            RegionCount += 1;
+        }
+
+        if ((!TCP_SEQUENCE_LESS_THAN(RecentSequence,
+                                     Segment->SequenceNumber)) &&
+            (TCP_SEQUENCE_LESS_THAN(RecentSequence, Segment->NextSequence))) {
+
+            RecentIndex = RegionCount - 1;
+        }
+    }
+
+    BlockCount = 0;
+    if (RecentIndex < RegionCount) {
+        Blocks[BlockCount] = Regions[RecentIndex];
+        BlockCount += 1;
+    }
+
+    for (BlockIndex = 0; BlockIndex < RegionCount; BlockIndex += 1) {
+        if (BlockCount == MaxBlocks) {
+            break;
+        }
+
+        if (BlockIndex != RecentIndex) {
+            Blocks[BlockCount] = Regions[BlockIndex];
+            BlockCount += 1;
+        }
+    }
+
+    return BlockCount;
+}
+
+ULONG
+NetpTcpDebugRandom (
+    VOID
+    )
+
+/*++
+
+Routine Description:
+
+    This routine returns a pseudo-random number for debug impairment. It is
+    deterministic for a given seed so that runs can be reproduced.
+
+Arguments:
+
+    None.
+
+Return Value:
+
+    Returns a pseudo-random 32-bit value.
+
+--*/
+
+{
+
+    ULONG Value;
+
+    Value = NetTcpDebugImpairSeed;
+    if (Value == 0) {
+        Value = 1;
+    }
+
+    Value ^= Value << 13;
+    Value ^= Value >> 17;
+    Value ^= Value << 5;
+    NetTcpDebugImpairSeed = Value;
+    return Value;
+}
@@ -258,6 +258,7 @@ NetpUdpListen (
 KSTATUS
 NetpUdpAccept (
     PNET_SOCKET Socket,
+    BOOL NonBlocking,
     PIO_HANDLE *NewConnectionSocket,
     PNETWORK_ADDRESS RemoteAddress
     );
@@ -287,6 +288,15 @@ NetpUdpSend (
     PIO_BUFFER IoBuffer
     );
 
+KSTATUS
+NetpUdpSendMessages (
+    BOOL FromKernelMode,
+    PNET_SOCKET Socket,
+    PSOCKET_IO_MESSAGE Messages,
+    ULONG MessageCount,
+    PULONG MessagesCompleted
+    );
+
 VOID
 NetpUdpProcessReceivedData (
     PNET_RECEIVE_CONTEXT ReceiveContext
@@ -325,6 +335,16 @@ NetpUdpUserControl (
     UINTN ContextBufferSize
     );
 
+KSTATUS
+NetpUdpSendRun (
+    PNET_SOCKET Socket,
+    PNETWORK_ADDRESS Destination,
+    PNET_SOCKET_LINK_OVERRIDE LinkOverride,
+    PNET_PACKET_LIST PacketList,
+    PSOCKET_IO_MESSAGE Messages,
+    ULONG MessageCount
+    );
+
 USHORT
 NetpUdpChecksumData (
     PNET_NETWORK_ENTRY Network,
@@ -360,7 +380,8 @@ NET_PROTOCOL_ENTRY NetUdpProtocol = {
         NetpUdpProcessReceivedSocketData,
         NetpUdpReceive,
         NetpUdpGetSetInformation,
-        NetpUdpUserControl
+        NetpUdpUserControl,
+        NetpUdpSendMessages
     }
 };
 
@@ -743,6 +764,7 @@ Return Value:
 KSTATUS
 NetpUdpAccept (
     PNET_SOCKET Socket,
+    BOOL NonBlocking,
     PIO_HANDLE *NewConnectionSocket,
     PNETWORK_ADDRESS RemoteAddress
     )
@@ -758,6 +780,11 @@ Routine Description:
 
     Socket - Supplies a pointer to the socket to accept a connection from.
 
+    NonBlocking - Supplies a boolean indicating whether to fail with
+        STATUS_OPERATION_WOULD_BLOCK rather than wait if no connection is
+        pending. The accept also never waits if the socket's handle was
+        opened non-blocking.
+
     NewConnectionSocket - Supplies a pointer where a new socket will be
         returned that represents the accepted connection with the remote
         host.
@@ -953,19 +980,88 @@ Return Value:
 
 {
 
-    UINTN BytesComplete;
+    ULONG MessagesCompleted;
+    SOCKET_IO_MESSAGE Message;
+    KSTATUS Status;
+
+    RtlCopyMemory(&(Message.Parameters),
+                  Parameters,
+                  sizeof(SOCKET_IO_PARAMETERS));
+
+    Message.IoBuffer = IoBuffer;
+    Status = NetpUdpSendMessages(FromKernelMode,
+                                 Socket,
+                                 &Message,
+                                 1,
+                                 &MessagesCompleted);
+
+    Parameters->SocketIoFlags = Message.Parameters.SocketIoFlags;
+    Parameters->BytesCompleted = Message.Parameters.BytesCompleted;
+    return Status;
+}
+
+KSTATUS
+NetpUdpSendMessages (
+    BOOL FromKernelMode,
+    PNET_SOCKET Socket,
+    PSOCKET_IO_MESSAGE Messages,
+    ULONG MessageCount,
+    PULONG MessagesCompleted
+    )
+
+/*++
+
+Routine Description:
+
+    This routine sends a batch of datagrams through the network. Consecutive
+    datagrams headed to the same destination are built into a single packet
+    list and handed to the network layer together, so the route lookup and
+    the trip down the stack are paid once per run rather than once per
+    datagram.
+
+Arguments:
+
+    FromKernelMode - Supplies a boolean indicating whether the request is
+        coming from kernel mode (TRUE) or user mode (FALSE).
+
+    Socket - Supplies a pointer to the socket to send the data to.
+
+    Messages - Supplies an array of kernel mode messages to send.
+
+    MessageCount - Supplies the number of elements in the message array.
+
+    MessagesCompleted - Supplies a pointer where the number of messages
+        successfully sent will be returned. Every message before this index
+        was sent, and no message at or after it was.
+
+Return Value:
+
+    Status code. If the status is a failure, it describes the first message
+    that was not sent.
+
+--*/
+
+{
+
+    ULONG Completed;
     PNETWORK_ADDRESS Destination;
     NETWORK_ADDRESS DestinationLocal;
     ULONG Flags;
     ULONG FooterSize;
     ULONG HeaderSize;
+    ULONG Index;
     PNET_LINK Link;
     NET_LINK_LOCAL_ADDRESS LinkInformation;
     PNET_SOCKET_LINK_OVERRIDE LinkOverride;
     NET_SOCKET_LINK_OVERRIDE LinkOverrideBuffer;
     NETWORK_ADDRESS LocalAddress;
+    PSOCKET_IO_MESSAGE Message;
     PNET_PACKET_BUFFER Packet;
     NET_PACKET_LIST PacketList;
+    ULONG RunCount;
+    PNETWORK_ADDRESS RunDestination;
+    NETWORK_ADDRESS RunDestinationLocal;
+    KSTATUS RunStatus;
     UINTN Size;
     PNETWORK_ADDRESS Source;
     KSTATUS Status;
@@ -974,232 +1070,314 @@ Return Value:
 
     ASSERT(Socket->PacketSizeInformation.MaxPacketSize > sizeof(UDP_HEADER));
 
-    BytesComplete = 0;
+    Completed = 0;
+    FooterSize = 0;
+    HeaderSize = 0;
     Link = NULL;
     LinkInformation.Link = NULL;
     LinkOverride = NULL;
+    Packet = NULL;
     NET_INITIALIZE_PACKET_LIST(&PacketList);
-    Size = Parameters->Size;
+    RunCount = 0;
+    RunDestination = NULL;
+    Source = NULL;
+    Status = STATUS_SUCCESS;
     UdpSocket = (PUDP_SOCKET)Socket;
-    Flags = Parameters->SocketIoFlags;
-    Parameters->SocketIoFlags = 0;
-    Destination = Parameters->NetworkAddress;
-    if ((Destination != NULL) && (FromKernelMode == FALSE)) {
-        Status = MmCopyFromUserMode(&DestinationLocal,
-                                    Destination,
-                                    sizeof(NETWORK_ADDRESS));
-
-        Destination = &DestinationLocal;
-        if (!KSUCCESS(Status)) {
-            goto UdpSendEnd;
-        }
-    }
-
-    if ((Destination == NULL) ||
-        (Destination->Domain == NetDomainInvalid)) {
-
-        if (Socket->RemoteAddress.Port == 0) {
-            Status = STATUS_NOT_CONFIGURED;
-            goto UdpSendEnd;
+    for (Index = 0; Index < MessageCount; Index += 1) {
+        Message = &(Messages[Index]);
+        Size = Message->Parameters.Size;
+        Flags = Message->Parameters.SocketIoFlags;
+        Message->Parameters.SocketIoFlags = 0;
+        Message->Parameters.BytesCompleted = 0;
+        Destination = Message->Parameters.NetworkAddress;
+        if ((Destination != NULL) && (FromKernelMode == FALSE)) {
+            Status = MmCopyFromUserMode(&DestinationLocal,
+                                        Destination,
+                                        sizeof(NETWORK_ADDRESS));
+
+            Destination = &DestinationLocal;
+            if (!KSUCCESS(Status)) {
+                break;
+            }
         }
 
-        Destination = &(Socket->RemoteAddress);
-
-    } else if (Destination->Domain != Socket->KernelSocket.Domain) {
-        Status = STATUS_DOMAIN_NOT_SUPPORTED;
-        goto UdpSendEnd;
-    }
+        if ((Destination == NULL) ||
+            (Destination->Domain == NetDomainInvalid)) {
 
-    //
-    // Fail if the socket has already been closed for writing.
-    //
+            if (Socket->RemoteAddress.Port == 0) {
+                Status = STATUS_NOT_CONFIGURED;
+                break;
+            }
 
-    if ((UdpSocket->ShutdownTypes & SOCKET_SHUTDOWN_WRITE) != 0) {
-        if ((Flags & SOCKET_IO_NO_SIGNAL) != 0) {
-            Status = STATUS_BROKEN_PIPE_SILENT;
+            Destination = &(Socket->RemoteAddress);
 
-        } else {
-            Status = STATUS_BROKEN_PIPE;
+        } else if (Destination->Domain != Socket->KernelSocket.Domain) {
+            Status = STATUS_DOMAIN_NOT_SUPPORTED;
+            break;
         }
 
-        goto UdpSendEnd;
-    }
+        //
+        // Fail if the socket has already been closed for writing.
+        //
 
-    //
-    // Fail if the socket's link went down.
-    //
+        if ((UdpSocket->ShutdownTypes & SOCKET_SHUTDOWN_WRITE) != 0) {
+            if ((Flags & SOCKET_IO_NO_SIGNAL) != 0) {
+                Status = STATUS_BROKEN_PIPE_SILENT;
 
-    if ((Socket->KernelSocket.IoState->Events & POLL_EVENT_DISCONNECTED) != 0) {
-        Status = STATUS_NO_NETWORK_CONNECTION;
-        goto UdpSendEnd;
-    }
+            } else {
+                Status = STATUS_BROKEN_PIPE;
+            }
 
-    //
-    // Fail if there's ancillary data.
-    //
+            break;
+        }
 
-    if (Parameters->ControlDataSize != 0) {
-        Status = STATUS_NOT_SUPPORTED;
-        goto UdpSendEnd;
-    }
+        //
+        // Fail if the socket's link went down.
+        //
 
-    //
-    // If the size, including the header, is greater than the UDP socket's
-    // maximum packet size, fail.
-    //
+        if ((Socket->KernelSocket.IoState->Events &
+             POLL_EVENT_DISCONNECTED) != 0) {
 
-    if ((Size + sizeof(UDP_HEADER)) > UdpSocket->MaxPacketSize) {
-        Status = STATUS_MESSAGE_TOO_LONG;
-        goto UdpSendEnd;
-    }
+            Status = STATUS_NO_NETWORK_CONNECTION;
+            break;
+        }
 
-    //
-    // If the socket is not yet bound, then at least try to bind it to a local
-    // port. This bind attempt may race with another bind attempt, but leave it
-    // to the socket owner to synchronize bind and send.
-    //
+        //
+        // Fail if there's ancillary data.
+        //
 
-    if (Socket->BindingType == SocketBindingInvalid) {
-        RtlZeroMemory(&LocalAddress, sizeof(NETWORK_ADDRESS));
-        LocalAddress.Domain = Socket->Network->Domain;
-        Status = NetpUdpBindToAddress(Socket, NULL, &LocalAddress);
-        if (!KSUCCESS(Status)) {
-            goto UdpSendEnd;
+        if (Message->Parameters.ControlDataSize != 0) {
+            Status = STATUS_NOT_SUPPORTED;
+            break;
         }
-    }
 
-    //
-    // The socket needs to at least be bound to a local port.
-    //
+        //
+        // If the size, including the header, is greater than the UDP socket's
+        // maximum packet size, fail.
+        //
 
-    ASSERT(Socket->LocalSendAddress.Port != 0);
+        if ((Size + sizeof(UDP_HEADER)) > UdpSocket->MaxPacketSize) {
+            Status = STATUS_MESSAGE_TOO_LONG;
+            break;
+        }
 
-    //
-    // If the socket has no link, then try to find a link that can service the
-    // destination address.
-    //
+        //
+        // If the socket is not yet bound, then at least try to bind it to a
+        // local port. This bind attempt may race with another bind attempt,
+        // but leave it to the socket owner to synchronize bind and send.
+        //
 
-    if (Socket->Link == NULL) {
-        Status = NetFindLinkForRemoteAddress(Destination, &LinkInformation);
-        if (!KSUCCESS(Status)) {
-            goto UdpSendEnd;
+        if (Socket->BindingType == SocketBindingInvalid) {
+            RtlZeroMemory(&LocalAddress, sizeof(NETWORK_ADDRESS));
+            LocalAddress.Domain = Socket->Network->Domain;
+            Status = NetpUdpBindToAddress(Socket, NULL, &LocalAddress);
+            if (!KSUCCESS(Status)) {
+                break;
+            }
         }
 
         //
-        // The link override should use the socket's port.
+        // The socket needs to at least be bound to a local port.
         //
 
-        LinkInformation.SendAddress.Port = Socket->LocalSendAddress.Port;
+        ASSERT(Socket->LocalSendAddress.Port != 0);
 
         //
-        // Synchronously get the correct header, footer, and max packet ssizes.
+        // If this datagram is headed somewhere other than the run built up so
+        // far, send that run off and start a new one.
         //
 
-        LinkOverride = &LinkOverrideBuffer;
-        NetInitializeSocketLinkOverride(Socket, &LinkInformation, LinkOverride);
-    }
+        if ((RunCount != 0) &&
+            (NetCompareNetworkAddresses(Destination, RunDestination) !=
+             ComparisonResultSame)) {
 
-    //
-    // Set the necessary local variables based on whether the socket's link or
-    // an override link will be used to send the data.
-    //
+            Status = NetpUdpSendRun(Socket,
+                                    RunDestination,
+                                    LinkOverride,
+                                    &PacketList,
+                                    &(Messages[Completed]),
+                                    RunCount);
 
-    if (LinkOverride != NULL) {
+            //
+            // A failed run has already destroyed its packets, so make sure
+            // the flush below doesn't try to send it again.
+            //
 
-        ASSERT(LinkOverride == &LinkOverrideBuffer);
+            if (!KSUCCESS(Status)) {
+                RunCount = 0;
+                break;
+            }
 
-        Link = LinkOverrideBuffer.LinkInformation.Link;
-        HeaderSize = LinkOverrideBuffer.PacketSizeInformation.HeaderSize;
-        FooterSize = LinkOverrideBuffer.PacketSizeInformation.FooterSize;
-        Source = &(LinkOverrideBuffer.LinkInformation.SendAddress);
+            Completed += RunCount;
+            RunCount = 0;
+            if (LinkInformation.Link != NULL) {
+                NetLinkReleaseReference(LinkInformation.Link);
+                LinkInformation.Link = NULL;
+            }
 
-    } else {
+            if (LinkOverride != NULL) {
+                NetLinkReleaseReference(LinkOverride->LinkInformation.Link);
+                LinkOverride = NULL;
+            }
+        }
 
-        ASSERT(Socket->Link != NULL);
+        if (RunCount == 0) {
 
-        Link = Socket->Link;
-        HeaderSize = Socket->PacketSizeInformation.HeaderSize;
-        FooterSize = Socket->PacketSizeInformation.FooterSize;
-        Source = &(Socket->LocalSendAddress);
-    }
+            //
+            // Keep a stable copy of the run's destination, as the local
+            // buffer gets overwritten by the next message.
+            //
 
-    //
-    // Allocate a buffer for the packet.
-    //
+            RunDestination = Destination;
+            if (Destination == &DestinationLocal) {
+                RtlCopyMemory(&RunDestinationLocal,
+                              Destination,
+                              sizeof(NETWORK_ADDRESS));
 
-    Status = NetAllocateBuffer(HeaderSize,
-                               Size,
-                               FooterSize,
-                               Link,
-                               0,
-                               &Packet);
+                RunDestination = &RunDestinationLocal;
+            }
 
-    if (!KSUCCESS(Status)) {
-        goto UdpSendEnd;
-    }
+            //
+            // If the socket has no link, then try to find a link that can
+            // service the destination address.
+            //
 
-    NET_ADD_PACKET_TO_LIST(Packet, &PacketList);
+            if (Socket->Link == NULL) {
+                Status = NetFindLinkForRemoteAddress(RunDestination,
+                                                     &LinkInformation);
 
-    //
-    // Copy the packet data.
-    //
+                if (!KSUCCESS(Status)) {
+                    break;
+                }
 
-    Status = MmCopyIoBufferData(IoBuffer,
-                                Packet->Buffer + Packet->DataOffset,
-                                BytesComplete,
-                                Size - BytesComplete,
-                                FALSE);
+                //
+                // The link override should use the socket's port.
+                //
 
-    if (!KSUCCESS(Status)) {
-        goto UdpSendEnd;
-    }
+                LinkInformation.SendAddress.Port =
+                                                 Socket->LocalSendAddress.Port;
 
-    //
-    // Add the UDP header.
-    //
+                //
+                // Synchronously get the correct header, footer, and max packet
+                // sizes.
+                //
+
+                LinkOverride = &LinkOverrideBuffer;
+                NetInitializeSocketLinkOverride(Socket,
+                                                &LinkInformation,
+                                                LinkOverride);
+            }
+
+            //
+            // Set the necessary local variables based on whether the socket's
+            // link or an override link will be used to send the data.
+            //
+
+            if (LinkOverride != NULL) {
 
-    ASSERT(Packet->DataOffset >= sizeof(UDP_HEADER));
-
-    Packet->DataOffset -= sizeof(UDP_HEADER);
-    UdpHeader = (PUDP_HEADER)(Packet->Buffer + Packet->DataOffset);
-    UdpHeader->SourcePort = CPU_TO_NETWORK16(Source->Port);
-    UdpHeader->DestinationPort = CPU_TO_NETWORK16(Destination->Port);
-    UdpHeader->Length = CPU_TO_NETWORK16(Size + sizeof(UDP_HEADER));
-    UdpHeader->Checksum = 0;
-    if ((Link->Properties.Capabilities &
-        NET_LINK_CAPABILITY_TRANSMIT_UDP_CHECKSUM_OFFLOAD) != 0) {
-
-        Packet->Flags |= NET_PACKET_FLAG_UDP_CHECKSUM_OFFLOAD;
-
-    } else if (Socket->KernelSocket.Domain == NetDomainIp6) {
-        UdpHeader->Checksum = NetpUdpChecksumData(Socket->Network,
-                                                  UdpHeader,
-                                                  Size + sizeof(UDP_HEADER),
-                                                  Source,
-                                                  Destination);
+                ASSERT(LinkOverride == &LinkOverrideBuffer);
+
+                Link = LinkOverrideBuffer.LinkInformation.Link;
+                HeaderSize =
+                          LinkOverrideBuffer.PacketSizeInformation.HeaderSize;
+
+                FooterSize =
+                          LinkOverrideBuffer.PacketSizeInformation.FooterSize;
+
+                Source = &(LinkOverrideBuffer.LinkInformation.SendAddress);
+
+            } else {
+
+                ASSERT(Socket->Link != NULL);
+
+                Link = Socket->Link;
+                HeaderSize = Socket->PacketSizeInformation.HeaderSize;
+                FooterSize = Socket->PacketSizeInformation.FooterSize;
+                Source = &(Socket->LocalSendAddress);
+            }
+        }
+
+        //
+        // Allocate a buffer for the packet.
+        //
+
+        Status = NetAllocateBuffer(HeaderSize,
+                                   Size,
+                                   FooterSize,
+                                   Link,
+                                   0,
+                                   &Packet);
+
+        if (!KSUCCESS(Status)) {
+            break;
+        }
+
+        //
+        // Copy the packet data.
+        //
+
+        Status = MmCopyIoBufferData(Message->IoBuffer,
+                                    Packet->Buffer + Packet->DataOffset,
+                                    0,
+                                    Size,
+                                    FALSE);
+
+        if (!KSUCCESS(Status)) {
+            NetFreeBuffer(Packet);
+            break;
+        }
+
+        //
+        // Add the UDP header.
+        //
+
+        ASSERT(Packet->DataOffset >= sizeof(UDP_HEADER));
+
+        Packet->DataOffset -= sizeof(UDP_HEADER);
+        UdpHeader = (PUDP_HEADER)(Packet->Buffer + Packet->DataOffset);
+        UdpHeader->SourcePort = CPU_TO_NETWORK16(Source->Port);
+        UdpHeader->DestinationPort = CPU_TO_NETWORK16(RunDestination->Port);
+        UdpHeader->Length = CPU_TO_NETWORK16(Size + sizeof(UDP_HEADER));
+        UdpHeader->Checksum = 0;
+        if ((Link->Properties.Capabilities &
+            NET_LINK_CAPABILITY_TRANSMIT_UDP_CHECKSUM_OFFLOAD) != 0) {
+
+            Packet->Flags |= NET_PACKET_FLAG_UDP_CHECKSUM_OFFLOAD;
+
+        } else if (Socket->KernelSocket.Domain == NetDomainIp6) {
+            UdpHeader->Checksum = NetpUdpChecksumData(
+                                                     Socket->Network,
+                                                     UdpHeader,
+                                                     Size + sizeof(UDP_HEADER),
+                                                     Source,
+                                                     RunDestination);
+        }
+
+        NET_ADD_PACKET_TO_LIST(Packet, &PacketList);
+        RunCount += 1;
     }
 
     //
-    // Send the datagram down to the network layer, which may have to send it
-    // in fragments.
+    // Send whatever run is left. If a later message failed, the datagrams
+    // before it still go out, and the failure gets reported for the message
+    // that caused it. If the run itself fails, that becomes the status since
+    // it describes the earlier message.
     //
 
-    Status = Socket->Network->Interface.Send(Socket,
-                                             Destination,
-                                             LinkOverride,
-                                             &PacketList);
+    if (RunCount != 0) {
+        RunStatus = NetpUdpSendRun(Socket,
+                                   RunDestination,
+                                   LinkOverride,
+                                   &PacketList,
+                                   &(Messages[Completed]),
+                                   RunCount);
 
-    if (!KSUCCESS(Status)) {
-        goto UdpSendEnd;
-    }
+        if (KSUCCESS(RunStatus)) {
+            Completed += RunCount;
 
-    Packet = NULL;
-    BytesComplete = Size;
-
-UdpSendEnd:
-    Parameters->BytesCompleted = BytesComplete;
-    if (!KSUCCESS(Status)) {
-        NetDestroyBufferList(&PacketList);
+        } else {
+            Status = RunStatus;
+        }
     }
 
     if (LinkInformation.Link != NULL) {
@@ -1213,6 +1391,7 @@ Return Value:
         NetLinkReleaseReference(LinkOverrideBuffer.LinkInformation.Link);
     }
 
+    *MessagesCompleted = Completed;
     return Status;
 }
 
@@ -2098,6 +2277,77 @@ Return Value:
 // --------------------------------------------------------- Internal Functions
 //
 
+KSTATUS
+NetpUdpSendRun (
+    PNET_SOCKET Socket,
+    PNETWORK_ADDRESS Destination,
+    PNET_SOCKET_LINK_OVERRIDE LinkOverride,
+    PNET_PACKET_LIST PacketList,
+    PSOCKET_IO_MESSAGE Messages,
+    ULONG MessageCount
+    )
+
+/*++
+
+Routine Description:
+
+    This routine sends a run of built UDP datagrams that all share the same
+    destination down to the network layer.
+
+Arguments:
+
+    Socket - Supplies a pointer to the socket sending the data.
+
+    Destination - Supplies a pointer to the destination shared by every
+        packet in the list.
+
+    LinkOverride - Supplies an optional pointer to the link information to
+        use if the socket is not bound to a link.
+
+    PacketList - Supplies a pointer to the list of packets to send, one per
+        message. This list will be empty when this routine returns.
+
+    Messages - Supplies a pointer to the messages that the packets were built
+        from. On success, each message's completed byte count is set.
+
+    MessageCount - Supplies the number of messages in the run.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    ULONG Index;
+    KSTATUS Status;
+
+    ASSERT(PacketList->Count == MessageCount);
+
+    //
+    // The network layer may have to send the datagrams in fragments.
+    //
+
+    Status = Socket->Network->Interface.Send(Socket,
+                                             Destination,
+                                             LinkOverride,
+                                             PacketList);
+
+    if (!KSUCCESS(Status)) {
+        NetDestroyBufferList(PacketList);
+        return Status;
+    }
+
+    NET_INITIALIZE_PACKET_LIST(PacketList);
+    for (Index = 0; Index < MessageCount; Index += 1) {
+        Messages[Index].Parameters.BytesCompleted =
+                                                Messages[Index].Parameters.Size;
+    }
+
+    return Status;
+}
+
 USHORT
 NetpUdpChecksumData (
     PNET_NETWORK_ENTRY Network,
@@ -0,0 +1,1717 @@
+/*++
+
+Copyright (c) 2026 Minoca Corp.
+
+    This file is licensed under the terms of the GNU General Public License
+    version 3. Alternative licensing terms are available. Contact
+    info@minocacorp.com for details. See the LICENSE file at the root of this
+    project for complete licensing information.
+
+Module Name:
+
+    vioblk.c
+
+Abstract:
+
+    This module implements the virtio block device driver. Each processor
+    gets its own request queue when the device offers enough of them.
+
+Author:
+
+    Minoca Corp. 18-Oct-2026
+
+Environment:
+
+    Kernel
+
+--*/
+
+//
+// ------------------------------------------------------------------- Includes
+//
+
+#include <minoca/kernel/driver.h>
+#include "vioblk.h"
+
+//
+// --------------------------------------------------------------------- Macros
+//
+
+//
+// ---------------------------------------------------------------- Definitions
+//
+
+//
+// ------------------------------------------------------ Data Type Definitions
+//
+
+//
+// ----------------------------------------------- Internal Function Prototypes
+//
+
+KSTATUS
+VioblkAddDevice (
+    PVOID Driver,
+    PCSTR DeviceId,
+    PCSTR ClassId,
+    PCSTR CompatibleIds,
+    PVOID DeviceToken
+    );
+
+VOID
+VioblkDispatchStateChange (
+    PIRP Irp,
+    PVOID DeviceContext,
+    PVOID IrpContext
+    );
+
+VOID
+VioblkDispatchOpen (
+    PIRP Irp,
+    PVOID DeviceContext,
+    PVOID IrpContext
+    );
+
+VOID
+VioblkDispatchClose (
+    PIRP Irp,
+    PVOID DeviceContext,
+    PVOID IrpContext
+    );
+
+VOID
+VioblkDispatchIo (
+    PIRP Irp,
+    PVOID DeviceContext,
+    PVOID IrpContext
+    );
+
+VOID
+VioblkDispatchSystemControl (
+    PIRP Irp,
+    PVOID DeviceContext,
+    PVOID IrpContext
+    );
+
+VOID
+VioblkpDispatchControllerStateChange (
+    PIRP Irp,
+    PVIOBLK_CONTROLLER Controller
+    );
+
+VOID
+VioblkpDispatchDiskStateChange (
+    PIRP Irp,
+    PVIOBLK_DISK Disk
+    );
+
+VOID
+VioblkpDispatchDiskSystemControl (
+    PIRP Irp,
+    PVIOBLK_DISK Disk
+    );
+
+KSTATUS
+VioblkpStartController (
+    PIRP Irp,
+    PVIOBLK_CONTROLLER Controller
+    );
+
+KSTATUS
+VioblkpReadConfiguration (
+    PVIOBLK_CONTROLLER Controller
+    );
+
+KSTATUS
+VioblkpCreateQueue (
+    PVIOBLK_CONTROLLER Controller,
+    ULONG QueueIndex
+    );
+
+VOID
+VioblkpEnumerateDisk (
+    PIRP Irp,
+    PVIOBLK_CONTROLLER Controller
+    );
+
+KSTATUS
+VioblkpEnqueueIrp (
+    PVIOBLK_CONTROLLER Controller,
+    PIRP Irp
+    );
+
+VOID
+VioblkpStartIrp (
+    PVIOBLK_QUEUE Queue,
+    PIRP Irp
+    );
+
+KSTATUS
+VioblkpSubmitRequest (
+    PVIOBLK_QUEUE Queue,
+    PVIOBLK_REQUEST Request,
+    BOOL Flush
+    );
+
+VOID
+VioblkpServiceQueue (
+    PVOID Context,
+    PVIRTIO_QUEUE VirtioQueue
+    );
+
+VOID
+VioblkpCompleteRequest (
+    PVIOBLK_QUEUE Queue,
+    PVIOBLK_REQUEST Request
+    );
+
+VOID
+VioblkpFreeRequest (
+    PVIOBLK_QUEUE Queue,
+    PVIOBLK_REQUEST Request
+    );
+
+//
+// -------------------------------------------------------------------- Globals
+//
+
+PDRIVER VioblkDriver = NULL;
+
+DRIVER_FUNCTION_TABLE VioblkDriverFunctionTable = {
+    DRIVER_FUNCTION_TABLE_VERSION,
+    NULL,
+    VioblkAddDevice,
+    NULL,
+    NULL,
+    VioblkDispatchStateChange,
+    VioblkDispatchOpen,
+    VioblkDispatchClose,
+    VioblkDispatchIo,
+    VioblkDispatchSystemControl,
+    NULL
+};
+
+//
+// ------------------------------------------------------------------ Functions
+//
+
+__USED
+KSTATUS
+DriverEntry (
+    PDRIVER Driver
+    )
+
+/*++
+
+Routine Description:
+
+    This routine is the entry point for the virtio block driver. It registers
+    its other dispatch functions, and performs driver-wide initialization.
+
+Arguments:
+
+    Driver - Supplies a pointer to the driver object.
+
+Return Value:
+
+    STATUS_SUCCESS on success.
+
+    Failure code on error.
+
+--*/
+
+{
+
+    KSTATUS Status;
+
+    VioblkDriver = Driver;
+    Status = IoRegisterDriverFunctions(Driver, &VioblkDriverFunctionTable);
+    return Status;
+}
+
+KSTATUS
+VioblkAddDevice (
+    PVOID Driver,
+    PCSTR DeviceId,
+    PCSTR ClassId,
+    PCSTR CompatibleIds,
+    PVOID DeviceToken
+    )
+
+/*++
+
+Routine Description:
+
+    This routine is called when a device is detected for which the virtio
+    block driver acts as the function driver. The driver will attach itself
+    to the stack.
+
+Arguments:
+
+    Driver - Supplies a pointer to the driver being called.
+
+    DeviceId - Supplies a pointer to a string with the device ID.
+
+    ClassId - Supplies a pointer to a string containing the device's class ID.
+
+    CompatibleIds - Supplies a pointer to a string containing device IDs
+        that would be compatible with this device.
+
+    DeviceToken - Supplies an opaque token that the driver can use to identify
+        the device in the system. This token should be used when attaching to
+        the stack.
+
+Return Value:
+
+    STATUS_SUCCESS on success.
+
+    Failure code if the driver was unsuccessful in attaching itself.
+
+--*/
+
+{
+
+    PVIOBLK_CONTROLLER Controller;
+    VIRTIO_DEVICE_PARAMETERS Parameters;
+    KSTATUS Status;
+
+    Controller = MmAllocateNonPagedPool(sizeof(VIOBLK_CONTROLLER),
+                                        VIOBLK_ALLOCATION_TAG);
+
+    if (Controller == NULL) {
+        Status = STATUS_INSUFFICIENT_RESOURCES;
+        goto AddDeviceEnd;
+    }
+
+    RtlZeroMemory(Controller, sizeof(VIOBLK_CONTROLLER));
+    Controller->Type = VioblkContextController;
+    Controller->OsDevice = DeviceToken;
+    Controller->Disk.Type = VioblkContextDisk;
+    Controller->Disk.Controller = Controller;
+    RtlZeroMemory(&Parameters, sizeof(VIRTIO_DEVICE_PARAMETERS));
+    Parameters.Version = VIRTIO_DEVICE_PARAMETERS_VERSION;
+    Parameters.OsDevice = DeviceToken;
+    Parameters.DriverFeatures = VIOBLK_DRIVER_FEATURES;
+    Parameters.Context = Controller;
+    Status = VirtioCreateDevice(&Parameters, &(Controller->Virtio));
+    if (!KSUCCESS(Status)) {
+        goto AddDeviceEnd;
+    }
+
+    Status = IoAttachDriverToDevice(Driver, DeviceToken, Controller);
+    if (!KSUCCESS(Status)) {
+        goto AddDeviceEnd;
+    }
+
+AddDeviceEnd:
+    if (!KSUCCESS(Status)) {
+        if (Controller != NULL) {
+            if (Controller->Virtio != NULL) {
+                VirtioDestroyDevice(Controller->Virtio);
+            }
+
+            MmFreeNonPagedPool(Controller);
+        }
+    }
+
+    return Status;
+}
+
+VOID
+VioblkDispatchStateChange (
+    PIRP Irp,
+    PVOID DeviceContext,
+    PVOID IrpContext
+    )
+
+/*++
+
+Routine Description:
+
+    This routine handles State Change IRPs.
+
+Arguments:
+
+    Irp - Supplies a pointer to the I/O request packet.
+
+    DeviceContext - Supplies the context pointer supplied by the driver when it
+        attached itself to the driver stack. Presumably this pointer contains
+        driver-specific device context.
+
+    IrpContext - Supplies the context pointer supplied by the driver when
+        the IRP was created.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PVIOBLK_CONTROLLER Controller;
+
+    Controller = DeviceContext;
+    switch (Controller->Type) {
+    case VioblkContextController:
+        VioblkpDispatchControllerStateChange(Irp, Controller);
+        break;
+
+    case VioblkContextDisk:
+        VioblkpDispatchDiskStateChange(Irp, (PVIOBLK_DISK)Controller);
+        break;
+
+    default:
+
+        ASSERT(FALSE);
+
+        IoCompleteIrp(VioblkDriver, Irp, STATUS_INVALID_CONFIGURATION);
+        break;
+    }
+
+    return;
+}
+
+VOID
+VioblkDispatchOpen (
+    PIRP Irp,
+    PVOID DeviceContext,
+    PVOID IrpContext
+    )
+
+/*++
+
+Routine Description:
+
+    This routine handles Open IRPs.
+
+Arguments:
+
+    Irp - Supplies a pointer to the I/O request packet.
+
+    DeviceContext - Supplies the context pointer supplied by the driver when it
+        attached itself to the driver stack. Presumably this pointer contains
+        driver-specific device context.
+
+    IrpContext - Supplies the context pointer supplied by the driver when
+        the IRP was created.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PVIOBLK_DISK Disk;
+
+    //
+    // Only the disk can be opened or closed.
+    //
+
+    Disk = (PVIOBLK_DISK)DeviceContext;
+    if (Disk->Type != VioblkContextDisk) {
+        return;
+    }
+
+    Irp->U.Open.DeviceContext = Disk;
+    IoCompleteIrp(VioblkDriver, Irp, STATUS_SUCCESS);
+    return;
+}
+
+VOID
+VioblkDispatchClose (
+    PIRP Irp,
+    PVOID DeviceContext,
+    PVOID IrpContext
+    )
+
+/*++
+
+Routine Description:
+
+    This routine handles Close IRPs.
+
+Arguments:
+
+    Irp - Supplies a pointer to the I/O request packet.
+
+    DeviceContext - Supplies the context pointer supplied by the driver when it
+        attached itself to the driver stack. Presumably this pointer contains
+        driver-specific device context.
+
+    IrpContext - Supplies the context pointer supplied by the driver when
+        the IRP was created.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PVIOBLK_DISK Disk;
+
+    //
+    // Only the disk can be opened or closed.
+    //
+
+    Disk = (PVIOBLK_DISK)DeviceContext;
+    if (Disk->Type != VioblkContextDisk) {
+        return;
+    }
+
+    IoCompleteIrp(VioblkDriver, Irp, STATUS_SUCCESS);
+    return;
+}
+
+VOID
+VioblkDispatchIo (
+    PIRP Irp,
+    PVOID DeviceContext,
+    PVOID IrpContext
+    )
+
+/*++
+
+Routine Description:
+
+    This routine handles I/O IRPs.
+
+Arguments:
+
+    Irp - Supplies a pointer to the I/O request packet.
+
+    DeviceContext - Supplies the context pointer supplied by the driver when it
+        attached itself to the driver stack. Presumably this pointer contains
+        driver-specific device context.
+
+    IrpContext - Supplies the context pointer supplied by the driver when
+        the IRP was created.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    BOOL CompleteIrp;
+    PVIOBLK_CONTROLLER Controller;
+    PVIOBLK_DISK Disk;
+    ULONG IrpReadWriteFlags;
+    KSTATUS Status;
+    BOOL Write;
+
+    Disk = (PVIOBLK_DISK)Irp->U.ReadWrite.DeviceContext;
+    if (Disk->Type != VioblkContextDisk) {
+        return;
+    }
+
+    Controller = Disk->Controller;
+    CompleteIrp = TRUE;
+    Write = FALSE;
+    if (Irp->MinorCode == IrpMinorIoWrite) {
+        Write = TRUE;
+    }
+
+    IrpReadWriteFlags = IRP_READ_WRITE_FLAG_DMA;
+    if (Write != FALSE) {
+        IrpReadWriteFlags |= IRP_READ_WRITE_FLAG_WRITE;
+    }
+
+    //
+    // If the IRP is on the way up, then clean up after the DMA. An IRP going
+    // up is already complete.
+    //
+
+    if (Irp->Direction == IrpUp) {
+        CompleteIrp = FALSE;
+        Status = IoCompleteReadWriteIrp(&(Irp->U.ReadWrite), IrpReadWriteFlags);
+        if (!KSUCCESS(Status)) {
+            IoUpdateIrpStatus(Irp, Status);
+        }
+
+    //
+    // Start the DMA on the way down.
+    //
+
+    } else {
+        if ((Write != FALSE) && (Controller->ReadOnly != FALSE)) {
+            Status = STATUS_ACCESS_DENIED;
+            goto DispatchIoEnd;
+        }
+
+        Irp->U.ReadWrite.NewIoOffset = Irp->U.ReadWrite.IoOffset;
+
+        //
+        // The device does its own address translation, so any physical
+        // address works. Requests must be in whole blocks.
+        //
+
+        Status = IoPrepareReadWriteIrp(&(Irp->U.ReadWrite),
+                                       Controller->BlockSize,
+                                       0,
+                                       MAX_ULONGLONG,
+                                       IrpReadWriteFlags);
+
+        if (!KSUCCESS(Status)) {
+            goto DispatchIoEnd;
+        }
+
+        CompleteIrp = FALSE;
+        Status = VioblkpEnqueueIrp(Controller, Irp);
+        if (!KSUCCESS(Status)) {
+            IoCompleteReadWriteIrp(&(Irp->U.ReadWrite), IrpReadWriteFlags);
+            CompleteIrp = TRUE;
+        }
+    }
+
+DispatchIoEnd:
+    if (CompleteIrp != FALSE) {
+        IoCompleteIrp(VioblkDriver, Irp, Status);
+    }
+
+    return;
+}
+
+VOID
+VioblkDispatchSystemControl (
+    PIRP Irp,
+    PVOID DeviceContext,
+    PVOID IrpContext
+    )
+
+/*++
+
+Routine Description:
+
+    This routine handles System Control IRPs.
+
+Arguments:
+
+    Irp - Supplies a pointer to the I/O request packet.
+
+    DeviceContext - Supplies the context pointer supplied by the driver when it
+        attached itself to the driver stack. Presumably this pointer contains
+        driver-specific device context.
+
+    IrpContext - Supplies the context pointer supplied by the driver when
+        the IRP was created.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PVIOBLK_DISK Disk;
+
+    ASSERT(Irp->MajorCode == IrpMajorSystemControl);
+
+    Disk = (PVIOBLK_DISK)DeviceContext;
+    if (Disk->Type == VioblkContextDisk) {
+        VioblkpDispatchDiskSystemControl(Irp, Disk);
+    }
+
+    return;
+}
+
+//
+// --------------------------------------------------------- Internal Functions
+//
+
+VOID
+VioblkpDispatchControllerStateChange (
+    PIRP Irp,
+    PVIOBLK_CONTROLLER Controller
+    )
+
+/*++
+
+Routine Description:
+
+    This routine handles state change IRPs for a virtio block device.
+
+Arguments:
+
+    Irp - Supplies a pointer to the I/O request packet.
+
+    Controller - Supplies a pointer to the controller context.
+
+Return Value:
+
+    None. The routine completes the IRP if appropriate.
+
+--*/
+
+{
+
+    KSTATUS Status;
+
+    if (Irp->Direction == IrpUp) {
+        if (!KSUCCESS(IoGetIrpStatus(Irp))) {
+            return;
+        }
+
+        switch (Irp->MinorCode) {
+        case IrpMinorQueryResources:
+            Status = VirtioProcessResourceRequirements(Controller->Virtio,
+                                                       Irp);
+
+            if (!KSUCCESS(Status)) {
+                IoCompleteIrp(VioblkDriver, Irp, Status);
+            }
+
+            break;
+
+        case IrpMinorStartDevice:
+            Status = VioblkpStartController(Irp, Controller);
+            if (!KSUCCESS(Status)) {
+                IoCompleteIrp(VioblkDriver, Irp, Status);
+            }
+
+            break;
+
+        case IrpMinorQueryChildren:
+            VioblkpEnumerateDisk(Irp, Controller);
+            break;
+
+        default:
+            break;
+        }
+    }
+
+    return;
+}
+
+VOID
+VioblkpDispatchDiskStateChange (
+    PIRP Irp,
+    PVIOBLK_DISK Disk
+    )
+
+/*++
+
+Routine Description:
+
+    This routine handles state change IRPs for the disk child device.
+
+Arguments:
+
+    Irp - Supplies a pointer to the I/O request packet.
+
+    Disk - Supplies a pointer to the disk.
+
+Return Value:
+
+    None. The routine completes the IRP if appropriate.
+
+--*/
+
+{
+
+    if (Irp->Direction == IrpDown) {
+        switch (Irp->MinorCode) {
+        case IrpMinorStartDevice:
+        case IrpMinorQueryResources:
+        case IrpMinorQueryChildren:
+            IoCompleteIrp(VioblkDriver, Irp, STATUS_SUCCESS);
+            break;
+
+        default:
+            break;
+        }
+    }
+
+    return;
+}
+
+VOID
+VioblkpDispatchDiskSystemControl (
+    PIRP Irp,
+    PVIOBLK_DISK Disk
+    )
+
+/*++
+
+Routine Description:
+
+    This routine handles System Control IRPs for the disk child device.
+
+Arguments:
+
+    Irp - Supplies a pointer to the I/O request packet.
+
+    Disk - Supplies a pointer to the disk.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    ULONGLONG BlockCount;
+    ULONG BlockSize;
+    PVOID Context;
+    PSYSTEM_CONTROL_FILE_OPERATION FileOperation;
+    PSYSTEM_CONTROL_LOOKUP Lookup;
+    PFILE_PROPERTIES Properties;
+    ULONGLONG PropertiesFileSize;
+    KSTATUS Status;
+
+    Context = Irp->U.SystemControl.SystemContext;
+    if (Irp->Direction == IrpUp) {
+        return;
+    }
+
+    BlockSize = Disk->Controller->BlockSize;
+    BlockCount = Disk->Controller->BlockCount;
+    switch (Irp->MinorCode) {
+    case IrpMinorSystemControlLookup:
+        Lookup = (PSYSTEM_CONTROL_LOOKUP)Context;
+        Status = STATUS_PATH_NOT_FOUND;
+        if (Lookup->Root != FALSE) {
+
+            //
+            // Enable opening of the root as a single file.
+            //
+
+            Properties = Lookup->Properties;
+            Properties->FileId = 0;
+            Properties->Type = IoObjectBlockDevice;
+            Properties->HardLinkCount = 1;
+            Properties->BlockSize = BlockSize;
+            Properties->BlockCount = BlockCount;
+            Properties->Size = BlockCount * BlockSize;
+            Status = STATUS_SUCCESS;
+        }
+
+        IoCompleteIrp(VioblkDriver, Irp, Status);
+        break;
+
+    //
+    // Writes to the disk's properties are not allowed. Fail if the data
+    // has changed.
+    //
+
+    case IrpMinorSystemControlWriteFileProperties:
+        FileOperation = (PSYSTEM_CONTROL_FILE_OPERATION)Context;
+        Properties = FileOperation->FileProperties;
+        PropertiesFileSize = Properties->Size;
+        if ((Properties->FileId != 0) ||
+            (Properties->Type != IoObjectBlockDevice) ||
+            (Properties->HardLinkCount != 1) ||
+            (Properties->BlockSize != BlockSize) ||
+            (Properties->BlockCount != BlockCount) ||
+            (PropertiesFileSize != (BlockCount * BlockSize))) {
+
+            Status = STATUS_NOT_SUPPORTED;
+
+        } else {
+            Status = STATUS_SUCCESS;
+        }
+
+        IoCompleteIrp(VioblkDriver, Irp, Status);
+        break;
+
+    //
+    // Do not support disk device truncation.
+    //
+
+    case IrpMinorSystemControlTruncate:
+        IoCompleteIrp(VioblkDriver, Irp, STATUS_NOT_SUPPORTED);
+        break;
+
+    //
+    // Gather and return device information.
+    //
+
+    case IrpMinorSystemControlDeviceInformation:
+        break;
+
+    //
+    // Flush the device's write cache upon getting a synchronize request.
+    // Devices without a write cache have nothing to flush.
+    //
+
+    case IrpMinorSystemControlSynchronize:
+        if (Disk->Controller->Flush == FALSE) {
+            IoCompleteIrp(VioblkDriver, Irp, STATUS_SUCCESS);
+            break;
+        }
+
+        Status = VioblkpEnqueueIrp(Disk->Controller, Irp);
+        if (!KSUCCESS(Status)) {
+            IoCompleteIrp(VioblkDriver, Irp, Status);
+        }
+
+        break;
+
+    //
+    // Ignore everything unrecognized.
+    //
+
+    default:
+
+        ASSERT(FALSE);
+
+        break;
+    }
+
+    return;
+}
+
+KSTATUS
+VioblkpStartController (
+    PIRP Irp,
+    PVIOBLK_CONTROLLER Controller
+    )
+
+/*++
+
+Routine Description:
+
+    This routine starts a virtio block device, creating a request queue per
+    processor if the device has enough queues.
+
+Arguments:
+
+    Irp - Supplies a pointer to the start IRP.
+
+    Controller - Supplies a pointer to the controller.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    UINTN AllocationSize;
+    ULONG QueueIndex;
+    KSTATUS Status;
+
+    if (Controller->Started != FALSE) {
+        return STATUS_SUCCESS;
+    }
+
+    Status = VirtioStartDevice(Controller->Virtio, Irp);
+    if (!KSUCCESS(Status)) {
+        goto StartControllerEnd;
+    }
+
+    Status = VioblkpReadConfiguration(Controller);
+    if (!KSUCCESS(Status)) {
+        goto StartControllerEnd;
+    }
+
+    AllocationSize = Controller->QueueCount * sizeof(VIOBLK_QUEUE);
+    Controller->Queues = MmAllocateNonPagedPool(AllocationSize,
+                                                VIOBLK_ALLOCATION_TAG);
+
+    if (Controller->Queues == NULL) {
+        Status = STATUS_INSUFFICIENT_RESOURCES;
+        goto StartControllerEnd;
+    }
+
+    RtlZeroMemory(Controller->Queues, AllocationSize);
+    for (QueueIndex = 0;
+         QueueIndex < Controller->QueueCount;
+         QueueIndex += 1) {
+
+        Status = VioblkpCreateQueue(Controller, QueueIndex);
+        if (!KSUCCESS(Status)) {
+            goto StartControllerEnd;
+        }
+    }
+
+    Status = VirtioEnableDevice(Controller->Virtio);
+    if (!KSUCCESS(Status)) {
+        goto StartControllerEnd;
+    }
+
+    Controller->Started = TRUE;
+
+StartControllerEnd:
+    if (!KSUCCESS(Status)) {
+        RtlDebugPrint("Vioblk: Failed to start: %d\n", Status);
+    }
+
+    return Status;
+}
+
+KSTATUS
+VioblkpReadConfiguration (
+    PVIOBLK_CONTROLLER Controller
+    )
+
+/*++
+
+Routine Description:
+
+    This routine reads the block device's geometry and limits.
+
+Arguments:
+
+    Controller - Supplies a pointer to the controller.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    ULONG BlockSize;
+    ULONGLONG Capacity;
+    ULONGLONG Features;
+    USHORT QueueCount;
+    ULONG SegmentMax;
+    ULONG SizeMax;
+    KSTATUS Status;
+
+    Features = VirtioGetFeatures(Controller->Virtio);
+    Status = VirtioReadConfiguration(Controller->Virtio,
+                                     VIOBLK_CONFIGURATION_CAPACITY,
+                                     &Capacity,
+                                     sizeof(ULONGLONG));
+
+    if (!KSUCCESS(Status)) {
+        return Status;
+    }
+
+    BlockSize = VIOBLK_SECTOR_SIZE;
+    if ((Features & VIOBLK_FEATURE_BLOCK_SIZE) != 0) {
+        Status = VirtioReadConfiguration(Controller->Virtio,
+                                         VIOBLK_CONFIGURATION_BLOCK_SIZE,
+                                         &BlockSize,
+                                         sizeof(ULONG));
+
+        if (!KSUCCESS(Status)) {
+            return Status;
+        }
+
+        if ((BlockSize < VIOBLK_SECTOR_SIZE) ||
+            (BlockSize > MmPageSize()) ||
+            (POWER_OF_2(BlockSize) == FALSE)) {
+
+            BlockSize = VIOBLK_SECTOR_SIZE;
+        }
+    }
+
+    Controller->BlockSize = BlockSize;
+    Controller->BlockCount = (Capacity * VIOBLK_SECTOR_SIZE) / BlockSize;
+    Controller->MaxSegments = VIOBLK_MAX_SEGMENTS;
+    if ((Features & VIOBLK_FEATURE_SEGMENT_MAX) != 0) {
+        Status = VirtioReadConfiguration(Controller->Virtio,
+                                         VIOBLK_CONFIGURATION_SEGMENT_MAX,
+                                         &SegmentMax,
+                                         sizeof(ULONG));
+
+        if (!KSUCCESS(Status)) {
+            return Status;
+        }
+
+        if ((SegmentMax != 0) && (SegmentMax < Controller->MaxSegments)) {
+            Controller->MaxSegments = SegmentMax;
+        }
+    }
+
+    Controller->MaxSegmentSize = VIOBLK_MAX_SEGMENT_SIZE;
+    if ((Features & VIOBLK_FEATURE_SIZE_MAX) != 0) {
+        Status = VirtioReadConfiguration(Controller->Virtio,
+                                         VIOBLK_CONFIGURATION_SIZE_MAX,
+                                         &SizeMax,
+                                         sizeof(ULONG));
+
+        if (!KSUCCESS(Status)) {
+            return Status;
+        }
+
+        //
+        // Segments are kept in whole blocks.
+        //
+
+        SizeMax = ALIGN_RANGE_DOWN(SizeMax, BlockSize);
+        if ((SizeMax != 0) && (SizeMax < Controller->MaxSegmentSize)) {
+            Controller->MaxSegmentSize = SizeMax;
+        }
+    }
+
+    //
+    // Use a queue per processor, if the device has that many.
+    //
+
+    QueueCount = 1;
+    if ((Features & VIOBLK_FEATURE_MULTI_QUEUE) != 0) {
+        Status = VirtioReadConfiguration(Controller->Virtio,
+                                         VIOBLK_CONFIGURATION_QUEUE_COUNT,
+                                         &QueueCount,
+                                         sizeof(USHORT));
+
+        if (!KSUCCESS(Status)) {
+            return Status;
+        }
+
+        if (QueueCount == 0) {
+            QueueCount = 1;
+        }
+    }
+
+    if (QueueCount > KeGetActiveProcessorCount()) {
+        QueueCount = KeGetActiveProcessorCount();
+    }
+
+    if (QueueCount > VirtioGetQueueCount(Controller->Virtio)) {
+        QueueCount = VirtioGetQueueCount(Controller->Virtio);
+    }
+
+    Controller->QueueCount = QueueCount;
+    if ((Features & VIOBLK_FEATURE_READ_ONLY) != 0) {
+        Controller->ReadOnly = TRUE;
+    }
+
+    if ((Features & VIOBLK_FEATURE_FLUSH) != 0) {
+        Controller->Flush = TRUE;
+    }
+
+    return STATUS_SUCCESS;
+}
+
+KSTATUS
+VioblkpCreateQueue (
+    PVIOBLK_CONTROLLER Controller,
+    ULONG QueueIndex
+    )
+
+/*++
+
+Routine Description:
+
+    This routine creates a request queue and its request slots.
+
+Arguments:
+
+    Controller - Supplies a pointer to the controller.
+
+    QueueIndex - Supplies the index of the queue to create, which is also the
+        processor it serves.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    UINTN AllocationSize;
+    UINTN BlockOffset;
+    PVIOBLK_QUEUE Queue;
+    VIRTIO_QUEUE_PARAMETERS QueueParameters;
+    ULONG QueueSize;
+    PVIOBLK_REQUEST Request;
+    ULONG RequestCount;
+    ULONG RequestIndex;
+    ULONG Segments;
+    KSTATUS Status;
+
+    Queue = &(Controller->Queues[QueueIndex]);
+    Queue->Controller = Controller;
+    KeInitializeSpinLock(&(Queue->Lock));
+    INITIALIZE_LIST_HEAD(&(Queue->IrpQueue));
+    RtlZeroMemory(&QueueParameters, sizeof(VIRTIO_QUEUE_PARAMETERS));
+    QueueParameters.Version = VIRTIO_QUEUE_PARAMETERS_VERSION;
+    QueueParameters.Index = QueueIndex;
+    QueueParameters.MaxSize = VIOBLK_MAX_QUEUE_SIZE;
+    QueueParameters.MaxSegments = Controller->MaxSegments +
+                                  VIOBLK_REQUEST_OVERHEAD;
+
+    QueueParameters.Processor = QueueIndex;
+    QueueParameters.ServiceRoutine = VioblkpServiceQueue;
+    QueueParameters.Context = Queue;
+    Status = VirtioCreateQueue(Controller->Virtio,
+                               &QueueParameters,
+                               &(Queue->Queue));
+
+    if (!KSUCCESS(Status)) {
+        return Status;
+    }
+
+    //
+    // With indirect descriptors every request takes one slot in the ring.
+    // Otherwise, reserve enough of the ring for each request to be as big as
+    // it can be.
+    //
+
+    QueueSize = VirtioGetQueueSize(Queue->Queue);
+    Segments = Controller->MaxSegments + VIOBLK_REQUEST_OVERHEAD;
+    if ((VirtioGetFeatures(Controller->Virtio) &
+         VIRTIO_FEATURE_INDIRECT_DESCRIPTORS) != 0) {
+
+        RequestCount = QueueSize;
+
+    } else {
+        if (Segments > QueueSize) {
+            Segments = QueueSize;
+            Controller->MaxSegments = Segments - VIOBLK_REQUEST_OVERHEAD;
+            if (Controller->MaxSegments == 0) {
+                return STATUS_NOT_SUPPORTED;
+            }
+        }
+
+        RequestCount = QueueSize / Segments;
+    }
+
+    Queue->RequestCount = RequestCount;
+    AllocationSize = (RequestCount * sizeof(VIOBLK_REQUEST)) +
+                     (Segments * sizeof(VIRTIO_BUFFER));
+
+    Queue->Requests = MmAllocateNonPagedPool(AllocationSize,
+                                             VIOBLK_ALLOCATION_TAG);
+
+    if (Queue->Requests == NULL) {
+        return STATUS_INSUFFICIENT_RESOURCES;
+    }
+
+    RtlZeroMemory(Queue->Requests, AllocationSize);
+    Queue->Buffers = (PVIRTIO_BUFFER)(Queue->Requests + RequestCount);
+    AllocationSize = ALIGN_RANGE_UP(RequestCount * sizeof(VIOBLK_REQUEST_BLOCK),
+                                    MmPageSize());
+
+    Queue->IoBuffer = MmAllocateNonPagedIoBuffer(0,
+                                                 MAX_ULONGLONG,
+                                                 sizeof(VIOBLK_REQUEST_BLOCK),
+                                                 AllocationSize,
+                                                 0);
+
+    if (Queue->IoBuffer == NULL) {
+        return STATUS_INSUFFICIENT_RESOURCES;
+    }
+
+    for (RequestIndex = 0; RequestIndex < RequestCount; RequestIndex += 1) {
+        Request = &(Queue->Requests[RequestIndex]);
+        BlockOffset = RequestIndex * sizeof(VIOBLK_REQUEST_BLOCK);
+        Request->Block = Queue->IoBuffer->Fragment[0].VirtualAddress +
+                         BlockOffset;
+
+        Request->BlockPhysical = MmGetIoBufferPhysicalAddress(Queue->IoBuffer,
+                                                              BlockOffset);
+
+        VioblkpFreeRequest(Queue, Request);
+    }
+
+    return STATUS_SUCCESS;
+}
+
+VOID
+VioblkpEnumerateDisk (
+    PIRP Irp,
+    PVIOBLK_CONTROLLER Controller
+    )
+
+/*++
+
+Routine Description:
+
+    This routine reports the disk child of the block device.
+
+Arguments:
+
+    Irp - Supplies a pointer to the query children IRP.
+
+    Controller - Supplies a pointer to the controller.
+
+Return Value:
+
+    None. The IRP is completed with the appropriate status.
+
+--*/
+
+{
+
+    KSTATUS Status;
+
+    if (Controller->Disk.OsDevice == NULL) {
+        Status = IoCreateDevice(VioblkDriver,
+                                &(Controller->Disk),
+                                Irp->Device,
+                                "Disk",
+                                DISK_CLASS_ID,
+                                NULL,
+                                &(Controller->Disk.OsDevice));
+
+        if (!KSUCCESS(Status)) {
+            goto EnumerateDiskEnd;
+        }
+    }
+
+    Status = IoMergeChildArrays(Irp,
+                                &(Controller->Disk.OsDevice),
+                                1,
+                                VIOBLK_ALLOCATION_TAG);
+
+EnumerateDiskEnd:
+    IoCompleteIrp(VioblkDriver, Irp, Status);
+    return;
+}
+
+KSTATUS
+VioblkpEnqueueIrp (
+    PVIOBLK_CONTROLLER Controller,
+    PIRP Irp
+    )
+
+/*++
+
+Routine Description:
+
+    This routine begins I/O on a fresh IRP using the current processor's
+    request queue.
+
+Arguments:
+
+    Controller - Supplies a pointer to the controller.
+
+    Irp - Supplies a pointer to the read/write or synchronize IRP.
+
+Return Value:
+
+    STATUS_SUCCESS if the IRP was successfully started or even queued.
+
+    Error code on failure.
+
+--*/
+
+{
+
+    RUNLEVEL OldRunLevel;
+    PVIOBLK_QUEUE Queue;
+    ULONG QueueIndex;
+
+    if (Controller->Started == FALSE) {
+        return STATUS_NOT_READY;
+    }
+
+    IoPendIrp(VioblkDriver, Irp);
+    OldRunLevel = KeRaiseRunLevel(RunLevelDispatch);
+    QueueIndex = KeGetCurrentProcessorNumber() % Controller->QueueCount;
+    Queue = &(Controller->Queues[QueueIndex]);
+    KeAcquireSpinLock(&(Queue->Lock));
+    VioblkpStartIrp(Queue, Irp);
+    VirtioNotifyQueue(Queue->Queue);
+    KeReleaseSpinLock(&(Queue->Lock));
+    KeLowerRunLevel(OldRunLevel);
+    return STATUS_SUCCESS;
+}
+
+VOID
+VioblkpStartIrp (
+    PVIOBLK_QUEUE Queue,
+    PIRP Irp
+    )
+
+/*++
+
+Routine Description:
+
+    This routine starts an IRP on a free request, or queues it if all
+    requests are busy. The queue lock must be held.
+
+Arguments:
+
+    Queue - Supplies a pointer to the queue.
+
+    Irp - Supplies a pointer to the IRP to start.
+
+Return Value:
+
+    None. The IRP is completed on failure.
+
+--*/
+
+{
+
+    BOOL Flush;
+    PVIOBLK_REQUEST Request;
+    KSTATUS Status;
+
+    ASSERT(KeIsSpinLockHeld(&(Queue->Lock)) != FALSE);
+
+    Request = Queue->FreeRequests;
+    if (Request == NULL) {
+        INSERT_BEFORE(&(Irp->ListEntry), &(Queue->IrpQueue));
+        return;
+    }
+
+    Queue->FreeRequests = Request->NextFree;
+    Request->NextFree = NULL;
+    Request->Irp = Irp;
+    Flush = FALSE;
+    if (Irp->MajorCode == IrpMajorSystemControl) {
+
+        ASSERT(Irp->MinorCode == IrpMinorSystemControlSynchronize);
+
+        Flush = TRUE;
+    }
+
+    Status = VioblkpSubmitRequest(Queue, Request, Flush);
+    if (!KSUCCESS(Status)) {
+        VioblkpFreeRequest(Queue, Request);
+        IoCompleteIrp(VioblkDriver, Irp, Status);
+    }
+
+    return;
+}
+
+KSTATUS
+VioblkpSubmitRequest (
+    PVIOBLK_QUEUE Queue,
+    PVIOBLK_REQUEST Request,
+    BOOL Flush
+    )
+
+/*++
+
+Routine Description:
+
+    This routine builds the next request for an IRP and adds it to the queue.
+    The caller is responsible for notifying the device. The queue lock must
+    be held.
+
+Arguments:
+
+    Queue - Supplies a pointer to the queue.
+
+    Request - Supplies a pointer to the request, whose IRP is set.
+
+    Flush - Supplies a boolean indicating whether to send a cache flush
+        rather than the next part of the transfer.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    PVIOBLK_REQUEST_BLOCK Block;
+    ULONG BufferCount;
+    PVIRTIO_BUFFER Buffers;
+    PVIOBLK_CONTROLLER Controller;
+    ULONG DataFlags;
+    UINTN EntrySize;
+    PIO_BUFFER_FRAGMENT Fragment;
+    UINTN FragmentIndex;
+    UINTN FragmentOffset;
+    PIO_BUFFER IoBuffer;
+    UINTN IoBufferOffset;
+    PIRP Irp;
+    ULONG MaxBuffers;
+    UINTN TransferSize;
+    UINTN TransferSizeRemaining;
+
+    Controller = Queue->Controller;
+    Irp = Request->Irp;
+    Block = Request->Block;
+    Buffers = Queue->Buffers;
+    RtlZeroMemory(Block, sizeof(VIOBLK_REQUEST_BLOCK));
+    Block->Status = VIOBLK_STATUS_IO_ERROR;
+    Buffers[0].Address = Request->BlockPhysical;
+    Buffers[0].Length = FIELD_OFFSET(VIOBLK_REQUEST_BLOCK, Status);
+    Buffers[0].Flags = 0;
+    BufferCount = 1;
+    TransferSize = 0;
+    if (Flush != FALSE) {
+        Block->Type = VIOBLK_REQUEST_FLUSH;
+        goto SubmitRequestEnd;
+    }
+
+    ASSERT(Irp->MajorCode == IrpMajorIo);
+    ASSERT(Irp->U.ReadWrite.IoBytesCompleted <
+           Irp->U.ReadWrite.IoSizeInBytes);
+
+    ASSERT(Irp->U.ReadWrite.NewIoOffset ==
+           (Irp->U.ReadWrite.IoOffset + Irp->U.ReadWrite.IoBytesCompleted));
+
+    if (Irp->MinorCode == IrpMinorIoWrite) {
+        Block->Type = VIOBLK_REQUEST_OUT;
+        DataFlags = 0;
+
+    } else {
+        Block->Type = VIOBLK_REQUEST_IN;
+        DataFlags = VIRTIO_BUFFER_FLAG_DEVICE_WRITE;
+    }
+
+    Block->Sector = Irp->U.ReadWrite.NewIoOffset / VIOBLK_SECTOR_SIZE;
+
+    //
+    // Get to the current spot in the I/O buffer.
+    //
+
+    IoBuffer = Irp->U.ReadWrite.IoBuffer;
+    IoBufferOffset = MmGetIoBufferCurrentOffset(IoBuffer);
+    IoBufferOffset += Irp->U.ReadWrite.IoBytesCompleted;
+    FragmentIndex = 0;
+    FragmentOffset = 0;
+    while (IoBufferOffset != 0) {
+
+        ASSERT(FragmentIndex < IoBuffer->FragmentCount);
+
+        Fragment = &(IoBuffer->Fragment[FragmentIndex]);
+        if (IoBufferOffset < Fragment->Size) {
+            FragmentOffset = IoBufferOffset;
+            break;
+        }
+
+        IoBufferOffset -= Fragment->Size;
+        FragmentIndex += 1;
+    }
+
+    //
+    // Describe as much of the remaining transfer as fits in a request.
+    //
+
+    TransferSizeRemaining = Irp->U.ReadWrite.IoSizeInBytes -
+                            Irp->U.ReadWrite.IoBytesCompleted;
+
+    MaxBuffers = Controller->MaxSegments + 1;
+    while ((TransferSizeRemaining != 0) && (BufferCount < MaxBuffers)) {
+
+        ASSERT(FragmentIndex < IoBuffer->FragmentCount);
+
+        Fragment = &(IoBuffer->Fragment[FragmentIndex]);
+        EntrySize = TransferSizeRemaining;
+        if (EntrySize > (Fragment->Size - FragmentOffset)) {
+            EntrySize = Fragment->Size - FragmentOffset;
+        }
+
+        if (EntrySize > Controller->MaxSegmentSize) {
+            EntrySize = Controller->MaxSegmentSize;
+        }
+
+        ASSERT(IS_ALIGNED(EntrySize, VIOBLK_SECTOR_SIZE) != FALSE);
+
+        Buffers[BufferCount].Address = Fragment->PhysicalAddress +
+                                       FragmentOffset;
+
+        Buffers[BufferCount].Length = EntrySize;
+        Buffers[BufferCount].Flags = DataFlags;
+        BufferCount += 1;
+        TransferSize += EntrySize;
+        TransferSizeRemaining -= EntrySize;
+        FragmentOffset += EntrySize;
+        if (FragmentOffset >= Fragment->Size) {
+            FragmentIndex += 1;
+            FragmentOffset = 0;
+        }
+    }
+
+SubmitRequestEnd:
+    Request->IoSize = TransferSize;
+    Buffers[BufferCount].Address = Request->BlockPhysical +
+                                   FIELD_OFFSET(VIOBLK_REQUEST_BLOCK, Status);
+
+    Buffers[BufferCount].Length = sizeof(UCHAR);
+    Buffers[BufferCount].Flags = VIRTIO_BUFFER_FLAG_DEVICE_WRITE;
+    BufferCount += 1;
+    return VirtioAddBuffers(Queue->Queue, Buffers, BufferCount, Request);
+}
+
+VOID
+VioblkpServiceQueue (
+    PVOID Context,
+    PVIRTIO_QUEUE VirtioQueue
+    )
+
+/*++
+
+Routine Description:
+
+    This routine completes requests the device has finished. It runs at
+    dispatch level on the processor the queue's interrupt is aimed at.
+
+Arguments:
+
+    Context - Supplies a pointer to the block queue.
+
+    VirtioQueue - Supplies a pointer to the virtqueue.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PVOID Cookie;
+    ULONG Length;
+    PVIOBLK_QUEUE Queue;
+
+    Queue = Context;
+    KeAcquireSpinLock(&(Queue->Lock));
+
+    //
+    // Keep the device from interrupting while the ring is drained, and go
+    // around again if it used more buffers just before interrupts came back.
+    //
+
+    do {
+        VirtioDisableQueueInterrupts(VirtioQueue);
+        while (VirtioGetUsedBuffer(VirtioQueue, &Cookie, &Length) != FALSE) {
+            VioblkpCompleteRequest(Queue, Cookie);
+        }
+
+    } while (VirtioEnableQueueInterrupts(VirtioQueue) != FALSE);
+
+    VirtioNotifyQueue(VirtioQueue);
+    KeReleaseSpinLock(&(Queue->Lock));
+    return;
+}
+
+VOID
+VioblkpCompleteRequest (
+    PVIOBLK_QUEUE Queue,
+    PVIOBLK_REQUEST Request
+    )
+
+/*++
+
+Routine Description:
+
+    This routine handles a finished request, either continuing its IRP or
+    completing it and starting the next waiting IRP. The queue lock must be
+    held.
+
+Arguments:
+
+    Queue - Supplies a pointer to the queue.
+
+    Request - Supplies a pointer to the finished request.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PIRP Irp;
+    UINTN IoSize;
+    KSTATUS Status;
+
+    ASSERT(KeIsSpinLockHeld(&(Queue->Lock)) != FALSE);
+
+    Irp = Request->Irp;
+    IoSize = Request->IoSize;
+    switch (Request->Block->Status) {
+    case VIOBLK_STATUS_OK:
+        Status = STATUS_SUCCESS;
+        break;
+
+    case VIOBLK_STATUS_UNSUPPORTED:
+        Status = STATUS_NOT_SUPPORTED;
+        break;
+
+    default:
+        Status = STATUS_DEVICE_IO_ERROR;
+        break;
+    }
+
+    if ((KSUCCESS(Status)) && (Irp->MajorCode == IrpMajorIo)) {
+        Irp->U.ReadWrite.IoBytesCompleted += IoSize;
+        Irp->U.ReadWrite.NewIoOffset += IoSize;
+
+        //
+        // If this is a synchronized write, then send a cache flush along
+        // with it. Use the IoSize as a hint as to whether or not the cache
+        // flush part has already gone around.
+        //
+
+        if ((Irp->MinorCode == IrpMinorIoWrite) &&
+            ((Irp->U.ReadWrite.IoFlags & IO_FLAG_DATA_SYNCHRONIZED) != 0) &&
+            (Irp->U.ReadWrite.IoBytesCompleted >=
+             Irp->U.ReadWrite.IoSizeInBytes) &&
+            (IoSize != 0) &&
+            (Queue->Controller->Flush != FALSE)) {
+
+            Status = VioblkpSubmitRequest(Queue, Request, TRUE);
+            if (KSUCCESS(Status)) {
+                return;
+            }
+
+        //
+        // If the IRP is not finished, send the next part.
+        //
+
+        } else if (Irp->U.ReadWrite.IoBytesCompleted <
+                   Irp->U.ReadWrite.IoSizeInBytes) {
+
+            Status = VioblkpSubmitRequest(Queue, Request, FALSE);
+            if (KSUCCESS(Status)) {
+                return;
+            }
+        }
+    }
+
+    VioblkpFreeRequest(Queue, Request);
+    IoCompleteIrp(VioblkDriver, Irp, Status);
+
+    //
+    // Start the next waiting IRP on the request just freed.
+    //
+
+    if (!LIST_EMPTY(&(Queue->IrpQueue))) {
+        Irp = LIST_VALUE(Queue->IrpQueue.Next, IRP, ListEntry);
+        LIST_REMOVE(&(Irp->ListEntry));
+        VioblkpStartIrp(Queue, Irp);
+    }
+
+    return;
+}
+
+VOID
+VioblkpFreeRequest (
+    PVIOBLK_QUEUE Queue,
+    PVIOBLK_REQUEST Request
+    )
+
+/*++
+
+Routine Description:
+
+    This routine returns a request to the queue's free list.
+
+Arguments:
+
+    Queue - Supplies a pointer to the queue.
+
+    Request - Supplies a pointer to the request.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    Request->Irp = NULL;
+    Request->IoSize = 0;
+    Request->NextFree = Queue->FreeRequests;
+    Queue->FreeRequests = Request;
+    return;
+}
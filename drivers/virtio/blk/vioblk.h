@@ -0,0 +1,304 @@
+/*++
+
+Copyright (c) 2026 Minoca Corp.
+
+    This file is licensed under the terms of the GNU General Public License
+    version 3. Alternative licensing terms are available. Contact
+    info@minocacorp.com for details. See the LICENSE file at the root of this
+    project for complete licensing information.
+
+Module Name:
+
+    vioblk.h
+
+Abstract:
+
+    This header contains internal definitions for the virtio block device
+    driver.
+
+Author:
+
+    Minoca Corp. 18-Oct-2026
+
+--*/
+
+//
+// ------------------------------------------------------------------- Includes
+//
+
+#include <minoca/virtio/virtio.h>
+
+//
+// ---------------------------------------------------------------- Definitions
+//
+
+#define VIOBLK_ALLOCATION_TAG 0x426F6956 // 'BoiV'
+
+//
+// Define the size of the sectors request offsets and capacity are given in,
+// regardless of the device's block size.
+//
+
+#define VIOBLK_SECTOR_SIZE 512
+
+//
+// Define the device specific feature bits.
+//
+
+#define VIOBLK_FEATURE_SIZE_MAX    (1ULL << 1)
+#define VIOBLK_FEATURE_SEGMENT_MAX (1ULL << 2)
+#define VIOBLK_FEATURE_READ_ONLY   (1ULL << 5)
+#define VIOBLK_FEATURE_BLOCK_SIZE  (1ULL << 6)
+#define VIOBLK_FEATURE_FLUSH       (1ULL << 9)
+#define VIOBLK_FEATURE_MULTI_QUEUE (1ULL << 12)
+
+#define VIOBLK_DRIVER_FEATURES \
+    (VIOBLK_FEATURE_SIZE_MAX | VIOBLK_FEATURE_SEGMENT_MAX | \
+     VIOBLK_FEATURE_READ_ONLY | VIOBLK_FEATURE_BLOCK_SIZE | \
+     VIOBLK_FEATURE_FLUSH | VIOBLK_FEATURE_MULTI_QUEUE)
+
+//
+// Define offsets into the device configuration space.
+//
+
+#define VIOBLK_CONFIGURATION_CAPACITY     0x00
+#define VIOBLK_CONFIGURATION_SIZE_MAX     0x08
+#define VIOBLK_CONFIGURATION_SEGMENT_MAX  0x0C
+#define VIOBLK_CONFIGURATION_BLOCK_SIZE   0x14
+#define VIOBLK_CONFIGURATION_QUEUE_COUNT  0x22
+
+//
+// Define request types.
+//
+
+#define VIOBLK_REQUEST_IN    0
+#define VIOBLK_REQUEST_OUT   1
+#define VIOBLK_REQUEST_FLUSH 4
+
+//
+// Define request completion status values.
+//
+
+#define VIOBLK_STATUS_OK          0
+#define VIOBLK_STATUS_IO_ERROR    1
+#define VIOBLK_STATUS_UNSUPPORTED 2
+
+//
+// Define the maximum number of data buffers in a single request, and the
+// largest single buffer used when the device does not say.
+//
+
+#define VIOBLK_MAX_SEGMENTS 64
+#define VIOBLK_MAX_SEGMENT_SIZE 0x00400000
+
+//
+// Define the largest queue the driver will use.
+//
+
+#define VIOBLK_MAX_QUEUE_SIZE 256
+
+//
+// Each request has a header and status buffer in addition to the data.
+//
+
+#define VIOBLK_REQUEST_OVERHEAD 2
+
+//
+// ------------------------------------------------------ Data Type Definitions
+//
+
+typedef enum _VIOBLK_CONTEXT_TYPE {
+    VioblkContextInvalid,
+    VioblkContextController,
+    VioblkContextDisk
+} VIOBLK_CONTEXT_TYPE, *PVIOBLK_CONTEXT_TYPE;
+
+typedef struct _VIOBLK_CONTROLLER VIOBLK_CONTROLLER, *PVIOBLK_CONTROLLER;
+
+/*++
+
+Structure Description:
+
+    This structure defines the device visible portion of a block request: the
+    header the device reads and the status byte it writes.
+
+Members:
+
+    Type - Stores the request type. See VIOBLK_REQUEST_* definitions.
+
+    Reserved - Stores a reserved value that must be zero.
+
+    Sector - Stores the first sector of the request.
+
+    Status - Stores the completion status written by the device. See
+        VIOBLK_STATUS_* definitions.
+
+    Padding - Stores padding so that blocks stay naturally aligned.
+
+--*/
+
+typedef struct _VIOBLK_REQUEST_BLOCK {
+    ULONG Type;
+    ULONG Reserved;
+    ULONGLONG Sector;
+    UCHAR Status;
+    UCHAR Padding[15];
+} PACKED VIOBLK_REQUEST_BLOCK, *PVIOBLK_REQUEST_BLOCK;
+
+/*++
+
+Structure Description:
+
+    This structure defines a block request slot.
+
+Members:
+
+    NextFree - Stores a pointer to the next free request, if this request is
+        free.
+
+    Irp - Stores a pointer to the IRP the request is working on.
+
+    IoSize - Stores the number of bytes being transferred by the request.
+        This is zero for flushes.
+
+    Block - Stores a pointer to the device visible part of the request.
+
+    BlockPhysical - Stores the physical address of the block.
+
+--*/
+
+typedef struct _VIOBLK_REQUEST VIOBLK_REQUEST, *PVIOBLK_REQUEST;
+struct _VIOBLK_REQUEST {
+    PVIOBLK_REQUEST NextFree;
+    PIRP Irp;
+    UINTN IoSize;
+    PVIOBLK_REQUEST_BLOCK Block;
+    PHYSICAL_ADDRESS BlockPhysical;
+};
+
+/*++
+
+Structure Description:
+
+    This structure defines a block request queue. Each processor submits to
+    its own queue when the device has enough of them, and completions
+    interrupt that same processor.
+
+Members:
+
+    Controller - Stores a pointer back to the controller.
+
+    Lock - Stores the spin lock that serializes access to the queue. It is
+        acquired at dispatch level.
+
+    Queue - Stores a pointer to the virtqueue.
+
+    IrpQueue - Stores the list of IRPs waiting for a free request.
+
+    Requests - Stores the array of request slots.
+
+    FreeRequests - Stores the head of the list of free request slots.
+
+    RequestCount - Stores the number of request slots.
+
+    IoBuffer - Stores the I/O buffer backing the request blocks.
+
+    Buffers - Stores a scratch array of buffers used to build a request.
+
+--*/
+
+typedef struct _VIOBLK_QUEUE {
+    PVIOBLK_CONTROLLER Controller;
+    KSPIN_LOCK Lock;
+    PVIRTIO_QUEUE Queue;
+    LIST_ENTRY IrpQueue;
+    PVIOBLK_REQUEST Requests;
+    PVIOBLK_REQUEST FreeRequests;
+    ULONG RequestCount;
+    PIO_BUFFER IoBuffer;
+    PVIRTIO_BUFFER Buffers;
+} VIOBLK_QUEUE, *PVIOBLK_QUEUE;
+
+/*++
+
+Structure Description:
+
+    This structure defines the disk exposed by a virtio block device.
+
+Members:
+
+    Type - Stores the context type, which is always VioblkContextDisk.
+
+    OsDevice - Stores a pointer to the OS device for the disk.
+
+    Controller - Stores a pointer to the controller.
+
+--*/
+
+typedef struct _VIOBLK_DISK {
+    VIOBLK_CONTEXT_TYPE Type;
+    PDEVICE OsDevice;
+    PVIOBLK_CONTROLLER Controller;
+} VIOBLK_DISK, *PVIOBLK_DISK;
+
+/*++
+
+Structure Description:
+
+    This structure defines a virtio block device.
+
+Members:
+
+    Type - Stores the context type, which is always VioblkContextController.
+
+    OsDevice - Stores a pointer to the OS device for the PCI function.
+
+    Virtio - Stores a pointer to the virtio device.
+
+    Started - Stores a boolean indicating whether the device has been started.
+
+    ReadOnly - Stores a boolean indicating whether the device refuses writes.
+
+    Flush - Stores a boolean indicating whether the device has a write cache
+        that needs flushing.
+
+    BlockSize - Stores the size of a block, in bytes.
+
+    BlockCount - Stores the number of blocks on the device.
+
+    MaxSegments - Stores the maximum number of data buffers in a request.
+
+    MaxSegmentSize - Stores the maximum size of a single data buffer.
+
+    QueueCount - Stores the number of request queues.
+
+    Queues - Stores the array of request queues.
+
+    Disk - Stores the disk child.
+
+--*/
+
+struct _VIOBLK_CONTROLLER {
+    VIOBLK_CONTEXT_TYPE Type;
+    PDEVICE OsDevice;
+    PVIRTIO_DEVICE Virtio;
+    BOOL Started;
+    BOOL ReadOnly;
+    BOOL Flush;
+    ULONG BlockSize;
+    ULONGLONG BlockCount;
+    ULONG MaxSegments;
+    ULONG MaxSegmentSize;
+    ULONG QueueCount;
+    PVIOBLK_QUEUE Queues;
+    VIOBLK_DISK Disk;
+};
+
+//
+// -------------------------------------------------------------------- Globals
+//
+
+//
+// -------------------------------------------------------- Function Prototypes
+//
+
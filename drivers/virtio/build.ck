@@ -0,0 +1,43 @@
+/*++
+
+Copyright (c) 2026 Minoca Corp.
+
+    This file is licensed under the terms of the GNU General Public License
+    version 3. Alternative licensing terms are available. Contact
+    info@minocacorp.com for details. See the LICENSE file at the root of this
+    project for complete licensing information.
+
+Module Name:
+
+    Virtio
+
+Abstract:
+
+    This file is responsible for building the virtio device drivers.
+
+Author:
+
+    Minoca Corp. 18-Oct-2026
+
+Environment:
+
+    Kernel
+
+--*/
+
+from menv import group;
+
+function build() {
+    var entries;
+    var virtioDrivers;
+
+    virtioDrivers = [
+        "drivers/virtio/core:virtio",
+        "drivers/virtio/blk:vioblk",
+        "drivers/virtio/net:vionet"
+    ];
+
+    entries = group("virtio_drivers", virtioDrivers);
+    return entries;
+}
+
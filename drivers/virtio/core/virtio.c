@@ -0,0 +1,2106 @@
+/*++
+
+Copyright (c) 2026 Minoca Corp.
+
+    This file is licensed under the terms of the GNU General Public License
+    version 3. Alternative licensing terms are available. Contact
+    info@minocacorp.com for details. See the LICENSE file at the root of this
+    project for complete licensing information.
+
+Module Name:
+
+    virtio.c
+
+Abstract:
+
+    This module implements the virtio PCI transport: discovering and mapping
+    the device's register regions, resetting the device and negotiating
+    features, programming virtqueues, and routing interrupts.
+
+Author:
+
+    Minoca Corp. 18-Oct-2026
+
+Environment:
+
+    Kernel
+
+--*/
+
+//
+// ------------------------------------------------------------------- Includes
+//
+
+#include <minoca/kernel/driver.h>
+#include "virtiop.h"
+
+//
+// --------------------------------------------------------------------- Macros
+//
+
+//
+// ---------------------------------------------------------------- Definitions
+//
+
+//
+// ------------------------------------------------------ Data Type Definitions
+//
+
+//
+// ----------------------------------------------- Internal Function Prototypes
+//
+
+INTERRUPT_STATUS
+VirtiopInterruptService (
+    PVOID Context
+    );
+
+INTERRUPT_STATUS
+VirtiopInterruptServiceDispatch (
+    PVOID Context
+    );
+
+INTERRUPT_STATUS
+VirtiopInterruptServiceWorker (
+    PVOID Context
+    );
+
+VOID
+VirtiopServiceQueues (
+    PVIRTIO_INTERRUPT Interrupt,
+    BOOL LowLevel
+    );
+
+KSTATUS
+VirtiopMapRegisters (
+    PVIRTIO_DEVICE Device,
+    PIRP Irp
+    );
+
+KSTATUS
+VirtiopMapRegion (
+    PVIRTIO_DEVICE Device,
+    PIRP Irp,
+    ULONG Bar,
+    ULONG Offset,
+    ULONG Length,
+    PVIRTIO_REGION Region
+    );
+
+VOID
+VirtiopUnmapRegion (
+    PVIRTIO_REGION Region
+    );
+
+KSTATUS
+VirtiopReadPciConfig (
+    PVIRTIO_DEVICE Device,
+    ULONG Offset,
+    ULONG Size,
+    PULONG Value
+    );
+
+KSTATUS
+VirtiopResetDevice (
+    PVIRTIO_DEVICE Device
+    );
+
+KSTATUS
+VirtiopNegotiateFeatures (
+    PVIRTIO_DEVICE Device
+    );
+
+KSTATUS
+VirtiopConnectInterrupts (
+    PVIRTIO_DEVICE Device
+    );
+
+VOID
+VirtiopDisconnectInterrupts (
+    PVIRTIO_DEVICE Device
+    );
+
+USHORT
+VirtiopGetQueueVector (
+    PVIRTIO_DEVICE Device,
+    ULONG Processor
+    );
+
+VOID
+VirtiopProcessPciConfigInterfaceChangeNotification (
+    PVOID Context,
+    PDEVICE Device,
+    PVOID InterfaceBuffer,
+    ULONG InterfaceBufferSize,
+    BOOL Arrival
+    );
+
+VOID
+VirtiopProcessPciMsiInterfaceChangeNotification (
+    PVOID Context,
+    PDEVICE Device,
+    PVOID InterfaceBuffer,
+    ULONG InterfaceBufferSize,
+    BOOL Arrival
+    );
+
+//
+// -------------------------------------------------------------------- Globals
+//
+
+PDRIVER VirtioDriver = NULL;
+UUID VirtioPciConfigurationInterfaceUuid = UUID_PCI_CONFIG_ACCESS;
+UUID VirtioPciMsiInterfaceUuid = UUID_PCI_MESSAGE_SIGNALED_INTERRUPTS;
+
+//
+// ------------------------------------------------------------------ Functions
+//
+
+__USED
+KSTATUS
+DriverEntry (
+    PDRIVER Driver
+    )
+
+/*++
+
+Routine Description:
+
+    This routine implements the initial entry point of the virtio core
+    library, called when the library is first loaded.
+
+Arguments:
+
+    Driver - Supplies a pointer to the driver object.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    VirtioDriver = Driver;
+    return STATUS_SUCCESS;
+}
+
+VIRTIO_API
+KSTATUS
+VirtioCreateDevice (
+    PVIRTIO_DEVICE_PARAMETERS Parameters,
+    PVIRTIO_DEVICE *Device
+    )
+
+/*++
+
+Routine Description:
+
+    This routine creates a virtio device context. This is usually called
+    when the driver attaches to the device.
+
+Arguments:
+
+    Parameters - Supplies a pointer to the device parameters.
+
+    Device - Supplies a pointer where a pointer to the new device will be
+        returned on success.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    PVIRTIO_DEVICE NewDevice;
+
+    *Device = NULL;
+    if ((Parameters->Version < VIRTIO_DEVICE_PARAMETERS_VERSION) ||
+        (Parameters->OsDevice == NULL)) {
+
+        return STATUS_INVALID_PARAMETER;
+    }
+
+    NewDevice = MmAllocateNonPagedPool(sizeof(VIRTIO_DEVICE),
+                                       VIRTIO_ALLOCATION_TAG);
+
+    if (NewDevice == NULL) {
+        return STATUS_INSUFFICIENT_RESOURCES;
+    }
+
+    RtlZeroMemory(NewDevice, sizeof(VIRTIO_DEVICE));
+    NewDevice->OsDevice = Parameters->OsDevice;
+    NewDevice->DriverFeatures = Parameters->DriverFeatures;
+    NewDevice->ConfigurationChangeRoutine =
+                                        Parameters->ConfigurationChangeRoutine;
+
+    NewDevice->Context = Parameters->Context;
+    NewDevice->InterruptLine = INVALID_INTERRUPT_LINE;
+    NewDevice->InterruptVector = INVALID_INTERRUPT_VECTOR;
+    *Device = NewDevice;
+    return STATUS_SUCCESS;
+}
+
+VIRTIO_API
+VOID
+VirtioDestroyDevice (
+    PVIRTIO_DEVICE Device
+    )
+
+/*++
+
+Routine Description:
+
+    This routine resets the device, disconnects its interrupts, and destroys
+    its queues and context.
+
+Arguments:
+
+    Device - Supplies a pointer to the device.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    ULONG QueueIndex;
+
+    //
+    // Reset the device first so it stops touching the rings.
+    //
+
+    if (Device->Common.Base != NULL) {
+        VirtiopResetDevice(Device);
+    }
+
+    VirtiopDisconnectInterrupts(Device);
+    if (Device->Queues != NULL) {
+        for (QueueIndex = 0; QueueIndex < Device->QueueCount; QueueIndex += 1) {
+            if (Device->Queues[QueueIndex] != NULL) {
+                VirtiopDestroyQueue(Device->Queues[QueueIndex]);
+            }
+        }
+
+        MmFreeNonPagedPool(Device->Queues);
+    }
+
+    if (Device->Interrupts != NULL) {
+        MmFreeNonPagedPool(Device->Interrupts);
+    }
+
+    VirtiopUnmapRegion(&(Device->Common));
+    VirtiopUnmapRegion(&(Device->Notify));
+    VirtiopUnmapRegion(&(Device->Isr));
+    VirtiopUnmapRegion(&(Device->DeviceConfiguration));
+    if ((Device->Flags & VIRTIO_DEVICE_FLAG_PCI_CONFIG_REGISTERED) != 0) {
+        IoUnregisterForInterfaceNotifications(
+                          &VirtioPciConfigurationInterfaceUuid,
+                          VirtiopProcessPciConfigInterfaceChangeNotification,
+                          Device->OsDevice,
+                          Device);
+    }
+
+    if ((Device->Flags & VIRTIO_DEVICE_FLAG_PCI_MSI_REGISTERED) != 0) {
+        IoUnregisterForInterfaceNotifications(
+                             &VirtioPciMsiInterfaceUuid,
+                             VirtiopProcessPciMsiInterfaceChangeNotification,
+                             Device->OsDevice,
+                             Device);
+    }
+
+    MmFreeNonPagedPool(Device);
+    return;
+}
+
+VIRTIO_API
+KSTATUS
+VirtioProcessResourceRequirements (
+    PVIRTIO_DEVICE Device,
+    PIRP Irp
+    )
+
+/*++
+
+Routine Description:
+
+    This routine filters the resource requirements of a virtio PCI device on
+    its way up. It requests a block of MSI-X vectors, one for configuration
+    changes and one per processor for the queues, with legacy interrupts as
+    the alternative.
+
+Arguments:
+
+    Device - Supplies a pointer to the device.
+
+    Irp - Supplies a pointer to the query resources IRP.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    PRESOURCE_CONFIGURATION_LIST ConfigurationList;
+    ULONGLONG LineCharacteristics;
+    PCI_MSI_INFORMATION MsiInformation;
+    PRESOURCE_REQUIREMENT NextRequirement;
+    PRESOURCE_REQUIREMENT Requirement;
+    PRESOURCE_REQUIREMENT_LIST RequirementList;
+    KSTATUS Status;
+    ULONGLONG VectorCharacteristics;
+    ULONGLONG VectorCount;
+    PRESOURCE_REQUIREMENT VectorRequirement;
+    RESOURCE_REQUIREMENT VectorTemplate;
+
+    ASSERT((Irp->MajorCode == IrpMajorStateChange) &&
+           (Irp->MinorCode == IrpMinorQueryResources));
+
+    RtlZeroMemory(&VectorTemplate, sizeof(RESOURCE_REQUIREMENT));
+    VectorTemplate.Type = ResourceTypeInterruptVector;
+    VectorTemplate.Minimum = 0;
+    VectorTemplate.Maximum = -1;
+    VectorTemplate.Length = 1;
+
+    //
+    // Listen for the PCI configuration interface, which is needed to find
+    // the register regions, and the MSI interface.
+    //
+
+    if ((Device->Flags & VIRTIO_DEVICE_FLAG_PCI_CONFIG_REGISTERED) == 0) {
+        Status = IoRegisterForInterfaceNotifications(
+                          &VirtioPciConfigurationInterfaceUuid,
+                          VirtiopProcessPciConfigInterfaceChangeNotification,
+                          Irp->Device,
+                          Device,
+                          TRUE);
+
+        if (!KSUCCESS(Status)) {
+            goto ProcessResourceRequirementsEnd;
+        }
+
+        Device->Flags |= VIRTIO_DEVICE_FLAG_PCI_CONFIG_REGISTERED;
+    }
+
+    if ((Device->Flags & VIRTIO_DEVICE_FLAG_PCI_MSI_REGISTERED) == 0) {
+        Status = IoRegisterForInterfaceNotifications(
+                             &VirtioPciMsiInterfaceUuid,
+                             VirtiopProcessPciMsiInterfaceChangeNotification,
+                             Irp->Device,
+                             Device,
+                             TRUE);
+
+        if (!KSUCCESS(Status)) {
+            goto ProcessResourceRequirementsEnd;
+        }
+
+        Device->Flags |= VIRTIO_DEVICE_FLAG_PCI_MSI_REGISTERED;
+    }
+
+    //
+    // Figure out how many MSI-X vectors to ask for: one for configuration
+    // changes, plus one for each processor so every processor's queues can
+    // be serviced where they were submitted.
+    //
+
+    VectorCount = 0;
+    if ((Device->Flags & VIRTIO_DEVICE_FLAG_PCI_MSI_AVAILABLE) != 0) {
+        RtlZeroMemory(&MsiInformation, sizeof(PCI_MSI_INFORMATION));
+        MsiInformation.Version = PCI_MSI_INTERFACE_INFORMATION_VERSION;
+        MsiInformation.MsiType = PciMsiTypeExtended;
+        Status = Device->PciMsiInterface.GetSetInformation(
+                                          Device->PciMsiInterface.DeviceToken,
+                                          &MsiInformation,
+                                          FALSE);
+
+        if (KSUCCESS(Status)) {
+            VectorCount = KeGetActiveProcessorCount() + 1;
+            if (VectorCount > MsiInformation.MaxVectorCount) {
+                VectorCount = MsiInformation.MaxVectorCount;
+            }
+        }
+    }
+
+    ConfigurationList = Irp->U.QueryResources.ResourceRequirements;
+    if (VectorCount == 0) {
+        Status = IoCreateAndAddInterruptVectorsForLines(ConfigurationList,
+                                                        &VectorTemplate);
+
+        goto ProcessResourceRequirementsEnd;
+    }
+
+    RequirementList = IoGetNextResourceConfiguration(ConfigurationList, NULL);
+    while (RequirementList != NULL) {
+        VectorTemplate.Length = VectorCount;
+        VectorTemplate.Characteristics = INTERRUPT_VECTOR_EDGE_TRIGGERED;
+        VectorTemplate.OwningRequirement = NULL;
+        Status = IoCreateAndAddResourceRequirement(&VectorTemplate,
+                                                   RequirementList,
+                                                   &VectorRequirement);
+
+        if (!KSUCCESS(Status)) {
+            goto ProcessResourceRequirementsEnd;
+        }
+
+        //
+        // In case the block of vectors cannot be allocated, fall back to a
+        // single vector for each legacy interrupt line.
+        //
+
+        VectorTemplate.Length = 1;
+        Requirement = IoGetNextResourceRequirement(RequirementList, NULL);
+        while (Requirement != NULL) {
+            NextRequirement = IoGetNextResourceRequirement(RequirementList,
+                                                           Requirement);
+
+            if (Requirement->Type != ResourceTypeInterruptLine) {
+                Requirement = NextRequirement;
+                continue;
+            }
+
+            VectorCharacteristics = 0;
+            LineCharacteristics = Requirement->Characteristics;
+            if ((LineCharacteristics & INTERRUPT_LINE_ACTIVE_LOW) != 0) {
+                VectorCharacteristics |= INTERRUPT_VECTOR_ACTIVE_LOW;
+            }
+
+            if ((LineCharacteristics & INTERRUPT_LINE_ACTIVE_HIGH) != 0) {
+                VectorCharacteristics |= INTERRUPT_VECTOR_ACTIVE_HIGH;
+            }
+
+            if ((LineCharacteristics & INTERRUPT_LINE_EDGE_TRIGGERED) != 0) {
+                VectorCharacteristics |= INTERRUPT_VECTOR_EDGE_TRIGGERED;
+            }
+
+            VectorTemplate.Characteristics = VectorCharacteristics;
+            VectorTemplate.OwningRequirement = Requirement;
+            Status = IoCreateAndAddResourceRequirementAlternative(
+                                                            &VectorTemplate,
+                                                            VectorRequirement);
+
+            if (!KSUCCESS(Status)) {
+                goto ProcessResourceRequirementsEnd;
+            }
+
+            Requirement = NextRequirement;
+        }
+
+        RequirementList = IoGetNextResourceConfiguration(ConfigurationList,
+                                                         RequirementList);
+    }
+
+    Device->Flags |= VIRTIO_DEVICE_FLAG_MSI_REQUESTED;
+    Status = STATUS_SUCCESS;
+
+ProcessResourceRequirementsEnd:
+    return Status;
+}
+
+VIRTIO_API
+KSTATUS
+VirtioStartDevice (
+    PVIRTIO_DEVICE Device,
+    PIRP Irp
+    )
+
+/*++
+
+Routine Description:
+
+    This routine maps the device's registers from its start IRP, resets the
+    device, and negotiates features. Queues can be created once this routine
+    succeeds.
+
+Arguments:
+
+    Device - Supplies a pointer to the device.
+
+    Irp - Supplies a pointer to the start device IRP.
+
+Return Value:
+
+    STATUS_NOT_SUPPORTED if the device does not implement the version 1
+    interface or refuses the driver's features.
+
+    Other status codes.
+
+--*/
+
+{
+
+    PRESOURCE_ALLOCATION Allocation;
+    PRESOURCE_ALLOCATION_LIST AllocationList;
+    UINTN AllocationSize;
+    PRESOURCE_ALLOCATION LineAllocation;
+    KSTATUS Status;
+    USHORT Vector;
+
+    //
+    // Starting again after a stop begins from scratch.
+    //
+
+    if ((Device->Flags & VIRTIO_DEVICE_FLAG_STARTED) != 0) {
+        return STATUS_SUCCESS;
+    }
+
+    //
+    // Find the interrupt. A vector without an owning line is a block of
+    // MSI-X vectors.
+    //
+
+    Device->InterruptCount = 0;
+    AllocationList = Irp->U.StartDevice.ProcessorLocalResources;
+    Allocation = IoGetNextResourceAllocation(AllocationList, NULL);
+    while (Allocation != NULL) {
+        if ((Allocation->Type == ResourceTypeInterruptVector) &&
+            (Device->InterruptCount == 0)) {
+
+            LineAllocation = Allocation->OwningAllocation;
+            if (LineAllocation == NULL) {
+
+                ASSERT((Device->Flags &
+                        VIRTIO_DEVICE_FLAG_MSI_REQUESTED) != 0);
+
+                Device->InterruptLine = INVALID_INTERRUPT_LINE;
+                Device->InterruptCount = Allocation->Length;
+                Device->Flags |= VIRTIO_DEVICE_FLAG_MSI_ALLOCATED;
+
+            } else {
+
+                ASSERT(LineAllocation->Type == ResourceTypeInterruptLine);
+
+                Device->InterruptLine = LineAllocation->Allocation;
+                Device->InterruptCount = 1;
+            }
+
+            Device->InterruptVector = Allocation->Allocation;
+        }
+
+        Allocation = IoGetNextResourceAllocation(AllocationList, Allocation);
+    }
+
+    if (Device->InterruptCount == 0) {
+        Status = STATUS_INVALID_CONFIGURATION;
+        goto StartDeviceEnd;
+    }
+
+    Status = VirtiopMapRegisters(Device, Irp);
+    if (!KSUCCESS(Status)) {
+        goto StartDeviceEnd;
+    }
+
+    Status = VirtiopResetDevice(Device);
+    if (!KSUCCESS(Status)) {
+        goto StartDeviceEnd;
+    }
+
+    VIRTIO_WRITE_COMMON8(Device,
+                         VirtioCommonDeviceStatus,
+                         VIRTIO_STATUS_ACKNOWLEDGE);
+
+    VIRTIO_WRITE_COMMON8(Device,
+                         VirtioCommonDeviceStatus,
+                         VIRTIO_STATUS_ACKNOWLEDGE | VIRTIO_STATUS_DRIVER);
+
+    Status = VirtiopNegotiateFeatures(Device);
+    if (!KSUCCESS(Status)) {
+        goto StartDeviceEnd;
+    }
+
+    //
+    // Route configuration changes to the first MSI-X vector.
+    //
+
+    if (Device->InterruptLine == INVALID_INTERRUPT_LINE) {
+        VIRTIO_WRITE_COMMON16(Device, VirtioCommonConfigurationVector, 0);
+        Vector = VIRTIO_READ_COMMON16(Device, VirtioCommonConfigurationVector);
+        if (Vector != 0) {
+            Status = STATUS_DEVICE_IO_ERROR;
+            goto StartDeviceEnd;
+        }
+    }
+
+    Device->QueueCount = VIRTIO_READ_COMMON16(Device, VirtioCommonQueueCount);
+    if (Device->QueueCount == 0) {
+        Status = STATUS_INVALID_CONFIGURATION;
+        goto StartDeviceEnd;
+    }
+
+    AllocationSize = Device->QueueCount * sizeof(PVIRTIO_QUEUE);
+    Device->Queues = MmAllocateNonPagedPool(AllocationSize,
+                                            VIRTIO_ALLOCATION_TAG);
+
+    if (Device->Queues == NULL) {
+        Status = STATUS_INSUFFICIENT_RESOURCES;
+        goto StartDeviceEnd;
+    }
+
+    RtlZeroMemory(Device->Queues, AllocationSize);
+    AllocationSize = Device->InterruptCount * sizeof(VIRTIO_INTERRUPT);
+    Device->Interrupts = MmAllocateNonPagedPool(AllocationSize,
+                                                VIRTIO_ALLOCATION_TAG);
+
+    if (Device->Interrupts == NULL) {
+        Status = STATUS_INSUFFICIENT_RESOURCES;
+        goto StartDeviceEnd;
+    }
+
+    RtlZeroMemory(Device->Interrupts, AllocationSize);
+    Device->Flags |= VIRTIO_DEVICE_FLAG_STARTED;
+    Status = STATUS_SUCCESS;
+
+StartDeviceEnd:
+    if (!KSUCCESS(Status)) {
+        if (Device->Common.Base != NULL) {
+            VIRTIO_WRITE_COMMON8(Device,
+                                 VirtioCommonDeviceStatus,
+                                 VIRTIO_STATUS_FAILED);
+        }
+
+        RtlDebugPrint("Virtio: Failed to start device: %d\n", Status);
+    }
+
+    return Status;
+}
+
+VIRTIO_API
+KSTATUS
+VirtioEnableDevice (
+    PVIRTIO_DEVICE Device
+    )
+
+/*++
+
+Routine Description:
+
+    This routine connects the device's interrupts and tells the device the
+    driver is ready. All queues should be created before calling this.
+
+Arguments:
+
+    Device - Supplies a pointer to the device.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    UCHAR DeviceStatus;
+    KSTATUS Status;
+
+    ASSERT((Device->Flags & VIRTIO_DEVICE_FLAG_STARTED) != 0);
+
+    if ((Device->Flags & VIRTIO_DEVICE_FLAG_ENABLED) != 0) {
+        return STATUS_SUCCESS;
+    }
+
+    Status = VirtiopConnectInterrupts(Device);
+    if (!KSUCCESS(Status)) {
+        return Status;
+    }
+
+    DeviceStatus = VIRTIO_READ_COMMON8(Device, VirtioCommonDeviceStatus);
+    DeviceStatus |= VIRTIO_STATUS_DRIVER_OK;
+    VIRTIO_WRITE_COMMON8(Device, VirtioCommonDeviceStatus, DeviceStatus);
+    Device->Flags |= VIRTIO_DEVICE_FLAG_ENABLED;
+    return STATUS_SUCCESS;
+}
+
+VIRTIO_API
+ULONGLONG
+VirtioGetFeatures (
+    PVIRTIO_DEVICE Device
+    )
+
+/*++
+
+Routine Description:
+
+    This routine returns the features negotiated with the device.
+
+Arguments:
+
+    Device - Supplies a pointer to the device.
+
+Return Value:
+
+    Returns the bitmask of negotiated features.
+
+--*/
+
+{
+
+    return Device->Features;
+}
+
+VIRTIO_API
+ULONG
+VirtioGetQueueCount (
+    PVIRTIO_DEVICE Device
+    )
+
+/*++
+
+Routine Description:
+
+    This routine returns the number of virtqueues the device implements.
+
+Arguments:
+
+    Device - Supplies a pointer to the device.
+
+Return Value:
+
+    Returns the number of queues.
+
+--*/
+
+{
+
+    return Device->QueueCount;
+}
+
+VIRTIO_API
+KSTATUS
+VirtioReadConfiguration (
+    PVIRTIO_DEVICE Device,
+    ULONG Offset,
+    PVOID Buffer,
+    ULONG Size
+    )
+
+/*++
+
+Routine Description:
+
+    This routine reads from the device specific configuration space,
+    retrying until the device reports a consistent snapshot.
+
+Arguments:
+
+    Device - Supplies a pointer to the device.
+
+    Offset - Supplies the offset into the device configuration to read.
+
+    Buffer - Supplies a pointer where the data will be returned.
+
+    Size - Supplies the number of bytes to read.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    PUCHAR Bytes;
+    UCHAR Generation;
+    ULONG Index;
+    PVOID Register;
+
+    if ((Device->DeviceConfiguration.Base == NULL) ||
+        (Offset + Size < Offset) ||
+        (Offset + Size > Device->DeviceConfiguration.Length)) {
+
+        return STATUS_INVALID_PARAMETER;
+    }
+
+    //
+    // Fields wider than 32 bits may change between reads. The generation
+    // counter changes if they did, so keep reading until it holds still.
+    //
+
+    Bytes = Buffer;
+    do {
+        Generation = VIRTIO_READ_COMMON8(Device,
+                                         VirtioCommonConfigurationGeneration);
+
+        Index = 0;
+        while (Index < Size) {
+            Register = Device->DeviceConfiguration.Base + Offset + Index;
+            if ((Size - Index >= sizeof(ULONG)) &&
+                (IS_ALIGNED(Offset + Index, sizeof(ULONG)) != FALSE)) {
+
+                *((PULONG)(Bytes + Index)) = HlReadRegister32(Register);
+                Index += sizeof(ULONG);
+
+            } else if ((Size - Index >= sizeof(USHORT)) &&
+                       (IS_ALIGNED(Offset + Index, sizeof(USHORT)) != FALSE)) {
+
+                *((PUSHORT)(Bytes + Index)) = HlReadRegister16(Register);
+                Index += sizeof(USHORT);
+
+            } else {
+                Bytes[Index] = HlReadRegister8(Register);
+                Index += 1;
+            }
+        }
+
+    } while (Generation !=
+             VIRTIO_READ_COMMON8(Device, VirtioCommonConfigurationGeneration));
+
+    return STATUS_SUCCESS;
+}
+
+VIRTIO_API
+KSTATUS
+VirtioCreateQueue (
+    PVIRTIO_DEVICE Device,
+    PVIRTIO_QUEUE_PARAMETERS Parameters,
+    PVIRTIO_QUEUE *Queue
+    )
+
+/*++
+
+Routine Description:
+
+    This routine allocates and enables a split virtqueue. The queue is
+    destroyed along with the device.
+
+Arguments:
+
+    Device - Supplies a pointer to the device.
+
+    Parameters - Supplies a pointer to the queue parameters.
+
+    Queue - Supplies a pointer where a pointer to the queue will be returned.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    PHYSICAL_ADDRESS Address;
+    ULONG InterruptIndex;
+    PVIRTIO_QUEUE NewQueue;
+    USHORT NotifyOffset;
+    UINTN NotifyRegister;
+    USHORT Size;
+    KSTATUS Status;
+    USHORT Vector;
+
+    *Queue = NULL;
+    NewQueue = NULL;
+    if ((Parameters->Version < VIRTIO_QUEUE_PARAMETERS_VERSION) ||
+        (Parameters->MaxSegments == 0) ||
+        ((Device->Flags & VIRTIO_DEVICE_FLAG_STARTED) == 0)) {
+
+        Status = STATUS_INVALID_PARAMETER;
+        goto CreateQueueEnd;
+    }
+
+    if ((Parameters->Index >= Device->QueueCount) ||
+        (Device->Queues[Parameters->Index] != NULL)) {
+
+        Status = STATUS_INVALID_PARAMETER;
+        goto CreateQueueEnd;
+    }
+
+    VIRTIO_WRITE_COMMON16(Device, VirtioCommonQueueSelect, Parameters->Index);
+    Size = VIRTIO_READ_COMMON16(Device, VirtioCommonQueueSize);
+    if (Size == 0) {
+        Status = STATUS_NOT_FOUND;
+        goto CreateQueueEnd;
+    }
+
+    //
+    // Shrink the queue if the caller asked for fewer descriptors. Split
+    // queues must stay a power of two.
+    //
+
+    if ((Parameters->MaxSize != 0) && (Parameters->MaxSize < Size)) {
+        Size = Parameters->MaxSize;
+    }
+
+    if (Size > VIRTIO_MAX_QUEUE_SIZE) {
+        Size = VIRTIO_MAX_QUEUE_SIZE;
+    }
+
+    while (POWER_OF_2(Size) == FALSE) {
+        Size &= Size - 1;
+    }
+
+    NewQueue = MmAllocateNonPagedPool(sizeof(VIRTIO_QUEUE),
+                                      VIRTIO_ALLOCATION_TAG);
+
+    if (NewQueue == NULL) {
+        Status = STATUS_INSUFFICIENT_RESOURCES;
+        goto CreateQueueEnd;
+    }
+
+    RtlZeroMemory(NewQueue, sizeof(VIRTIO_QUEUE));
+    NewQueue->Device = Device;
+    NewQueue->Index = Parameters->Index;
+    NewQueue->Flags = Parameters->Flags;
+    NewQueue->ServiceRoutine = Parameters->ServiceRoutine;
+    NewQueue->Context = Parameters->Context;
+    Status = VirtiopInitializeQueue(NewQueue, Size, Parameters->MaxSegments);
+    if (!KSUCCESS(Status)) {
+        goto CreateQueueEnd;
+    }
+
+    //
+    // Pick the interrupt for the queue. Queues without a service routine
+    // are polled, and never interrupt.
+    //
+
+    Vector = VIRTIO_MSI_NO_VECTOR;
+    InterruptIndex = 0;
+    if (Device->InterruptLine == INVALID_INTERRUPT_LINE) {
+        Vector = VirtiopGetQueueVector(Device, Parameters->Processor);
+        InterruptIndex = Vector;
+    }
+
+    if (NewQueue->ServiceRoutine != NULL) {
+        NewQueue->Interrupt = &(Device->Interrupts[InterruptIndex]);
+
+    } else {
+        Vector = VIRTIO_MSI_NO_VECTOR;
+        VirtioDisableQueueInterrupts(NewQueue);
+    }
+
+    //
+    // Program the queue.
+    //
+
+    VIRTIO_WRITE_COMMON16(Device, VirtioCommonQueueSize, Size);
+    Address = VirtiopGetQueueDescriptorsAddress(NewQueue);
+    VIRTIO_WRITE_COMMON64(Device, VirtioCommonQueueDescriptors, Address);
+    Address = VirtiopGetQueueAvailableAddress(NewQueue);
+    VIRTIO_WRITE_COMMON64(Device, VirtioCommonQueueAvailable, Address);
+    Address = VirtiopGetQueueUsedAddress(NewQueue);
+    VIRTIO_WRITE_COMMON64(Device, VirtioCommonQueueUsed, Address);
+    if (Device->InterruptLine == INVALID_INTERRUPT_LINE) {
+        VIRTIO_WRITE_COMMON16(Device, VirtioCommonQueueVector, Vector);
+        if (VIRTIO_READ_COMMON16(Device, VirtioCommonQueueVector) != Vector) {
+            Status = STATUS_DEVICE_IO_ERROR;
+            goto CreateQueueEnd;
+        }
+    }
+
+    NotifyOffset = VIRTIO_READ_COMMON16(Device, VirtioCommonQueueNotifyOffset);
+    NotifyRegister = (UINTN)NotifyOffset * Device->NotifyMultiplier;
+    if (NotifyRegister + sizeof(USHORT) > Device->Notify.Length) {
+        Status = STATUS_INVALID_CONFIGURATION;
+        goto CreateQueueEnd;
+    }
+
+    NewQueue->NotifyAddress = Device->Notify.Base + NotifyRegister;
+    VIRTIO_WRITE_COMMON16(Device, VirtioCommonQueueEnable, 1);
+    Device->Queues[NewQueue->Index] = NewQueue;
+    *Queue = NewQueue;
+    Status = STATUS_SUCCESS;
+
+CreateQueueEnd:
+    if (!KSUCCESS(Status)) {
+        if (NewQueue != NULL) {
+            VirtiopDestroyQueue(NewQueue);
+        }
+    }
+
+    return Status;
+}
+
+//
+// --------------------------------------------------------- Internal Functions
+//
+
+INTERRUPT_STATUS
+VirtiopInterruptService (
+    PVOID Context
+    )
+
+/*++
+
+Routine Description:
+
+    This routine implements the virtio interrupt service routine.
+
+Arguments:
+
+    Context - Supplies the context pointer given to the system when the
+        interrupt was connected. In this case, this points to the virtio
+        interrupt.
+
+Return Value:
+
+    Interrupt status.
+
+--*/
+
+{
+
+    PVIRTIO_DEVICE Device;
+    PVIRTIO_INTERRUPT Interrupt;
+    UCHAR IsrStatus;
+
+    Interrupt = Context;
+    Device = Interrupt->Device;
+
+    //
+    // MSI-X vectors are never shared, so they are always for this device.
+    //
+
+    if (Device->InterruptLine == INVALID_INTERRUPT_LINE) {
+        return InterruptStatusClaimed;
+    }
+
+    //
+    // Reading the ISR status acknowledges a legacy interrupt.
+    //
+
+    IsrStatus = HlReadRegister8(Device->Isr.Base);
+    if (IsrStatus == 0) {
+        return InterruptStatusNotClaimed;
+    }
+
+    RtlAtomicOr32(&(Device->PendingIsrStatus), IsrStatus);
+    return InterruptStatusClaimed;
+}
+
+INTERRUPT_STATUS
+VirtiopInterruptServiceDispatch (
+    PVOID Context
+    )
+
+/*++
+
+Routine Description:
+
+    This routine services the dispatch level queues of a virtio interrupt.
+
+Arguments:
+
+    Context - Supplies the context pointer given to the system when the
+        interrupt was connected. In this case, this points to the virtio
+        interrupt.
+
+Return Value:
+
+    Interrupt status.
+
+--*/
+
+{
+
+    VirtiopServiceQueues(Context, FALSE);
+    return InterruptStatusClaimed;
+}
+
+INTERRUPT_STATUS
+VirtiopInterruptServiceWorker (
+    PVOID Context
+    )
+
+/*++
+
+Routine Description:
+
+    This routine services the low level queues and configuration changes of
+    a virtio interrupt.
+
+Arguments:
+
+    Context - Supplies the context pointer given to the system when the
+        interrupt was connected. In this case, this points to the virtio
+        interrupt.
+
+Return Value:
+
+    Interrupt status.
+
+--*/
+
+{
+
+    BOOL ConfigurationChanged;
+    PVIRTIO_DEVICE Device;
+    PVIRTIO_INTERRUPT Interrupt;
+    ULONG IsrStatus;
+
+    Interrupt = Context;
+    Device = Interrupt->Device;
+    VirtiopServiceQueues(Interrupt, TRUE);
+
+    //
+    // With MSI-X, the first vector carries configuration changes. If it is
+    // the only vector it also carries queue interrupts, and the two cannot be
+    // told apart.
+    //
+
+    if (Device->InterruptLine == INVALID_INTERRUPT_LINE) {
+        ConfigurationChanged = FALSE;
+        if (Interrupt->Index == 0) {
+            ConfigurationChanged = TRUE;
+        }
+
+    } else {
+        IsrStatus = RtlAtomicAnd32(&(Device->PendingIsrStatus),
+                                   ~VIRTIO_ISR_CONFIGURATION);
+
+        ConfigurationChanged = FALSE;
+        if ((IsrStatus & VIRTIO_ISR_CONFIGURATION) != 0) {
+            ConfigurationChanged = TRUE;
+        }
+    }
+
+    if ((ConfigurationChanged != FALSE) &&
+        (Device->ConfigurationChangeRoutine != NULL)) {
+
+        Device->ConfigurationChangeRoutine(Device->Context);
+    }
+
+    return InterruptStatusClaimed;
+}
+
+VOID
+VirtiopServiceQueues (
+    PVIRTIO_INTERRUPT Interrupt,
+    BOOL LowLevel
+    )
+
+/*++
+
+Routine Description:
+
+    This routine calls the service routine of each queue served by the given
+    interrupt at the current run level.
+
+Arguments:
+
+    Interrupt - Supplies a pointer to the interrupt that fired.
+
+    LowLevel - Supplies a boolean indicating whether this is the low level
+        pass (TRUE) or the dispatch level pass (FALSE).
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PVIRTIO_DEVICE Device;
+    BOOL QueueLowLevel;
+    PVIRTIO_QUEUE Queue;
+    ULONG QueueIndex;
+
+    Device = Interrupt->Device;
+    for (QueueIndex = 0; QueueIndex < Device->QueueCount; QueueIndex += 1) {
+        Queue = Device->Queues[QueueIndex];
+        if ((Queue == NULL) || (Queue->Interrupt != Interrupt)) {
+            continue;
+        }
+
+        QueueLowLevel = FALSE;
+        if ((Queue->Flags & VIRTIO_QUEUE_FLAG_LOW_LEVEL) != 0) {
+            QueueLowLevel = TRUE;
+        }
+
+        if (QueueLowLevel == LowLevel) {
+            Queue->ServiceRoutine(Queue->Context, Queue);
+        }
+    }
+
+    return;
+}
+
+KSTATUS
+VirtiopMapRegisters (
+    PVIRTIO_DEVICE Device,
+    PIRP Irp
+    )
+
+/*++
+
+Routine Description:
+
+    This routine walks the device's PCI capability list to find and map the
+    common configuration, notification, ISR, and device configuration
+    regions.
+
+Arguments:
+
+    Device - Supplies a pointer to the device.
+
+    Irp - Supplies a pointer to the start device IRP.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    ULONG Bar;
+    ULONG CapabilityCount;
+    ULONG CapabilityId;
+    ULONG CapabilityType;
+    ULONG Length;
+    ULONG Offset;
+    ULONG Pointer;
+    PVIRTIO_REGION Region;
+    KSTATUS Status;
+    ULONG Value;
+
+    if ((Device->Flags & VIRTIO_DEVICE_FLAG_PCI_CONFIG_AVAILABLE) == 0) {
+        return STATUS_NOT_READY;
+    }
+
+    Status = VirtiopReadPciConfig(Device,
+                                  VIRTIO_PCI_STATUS_OFFSET,
+                                  sizeof(USHORT),
+                                  &Value);
+
+    if (!KSUCCESS(Status)) {
+        return Status;
+    }
+
+    if ((Value & VIRTIO_PCI_STATUS_CAPABILITIES_LIST) == 0) {
+        return STATUS_NOT_SUPPORTED;
+    }
+
+    Status = VirtiopReadPciConfig(Device,
+                                  VIRTIO_PCI_CAPABILITY_POINTER_OFFSET,
+                                  sizeof(UCHAR),
+                                  &Pointer);
+
+    if (!KSUCCESS(Status)) {
+        return Status;
+    }
+
+    Pointer &= VIRTIO_PCI_CAPABILITY_POINTER_MASK;
+    CapabilityCount = 0;
+    while ((Pointer != 0) && (CapabilityCount < VIRTIO_PCI_MAX_CAPABILITIES)) {
+        CapabilityCount += 1;
+        Status = VirtiopReadPciConfig(Device,
+                                      Pointer,
+                                      sizeof(UCHAR),
+                                      &CapabilityId);
+
+        if (!KSUCCESS(Status)) {
+            return Status;
+        }
+
+        if (CapabilityId != VIRTIO_PCI_CAPABILITY_VENDOR_ID) {
+            goto NextCapability;
+        }
+
+        Status = VirtiopReadPciConfig(
+                                   Device,
+                                   Pointer + VIRTIO_PCI_CAPABILITY_TYPE_OFFSET,
+                                   sizeof(UCHAR),
+                                   &CapabilityType);
+
+        if (!KSUCCESS(Status)) {
+            return Status;
+        }
+
+        switch (CapabilityType) {
+        case VIRTIO_PCI_CAPABILITY_COMMON:
+            Region = &(Device->Common);
+            break;
+
+        case VIRTIO_PCI_CAPABILITY_NOTIFY:
+            Region = &(Device->Notify);
+            break;
+
+        case VIRTIO_PCI_CAPABILITY_ISR:
+            Region = &(Device->Isr);
+            break;
+
+        case VIRTIO_PCI_CAPABILITY_DEVICE:
+            Region = &(Device->DeviceConfiguration);
+            break;
+
+        default:
+            Region = NULL;
+            break;
+        }
+
+        //
+        // Use the first capability of each type, as the specification
+        // prefers.
+        //
+
+        if ((Region == NULL) || (Region->Base != NULL)) {
+            goto NextCapability;
+        }
+
+        Status = VirtiopReadPciConfig(
+                                    Device,
+                                    Pointer + VIRTIO_PCI_CAPABILITY_BAR_OFFSET,
+                                    sizeof(UCHAR),
+                                    &Bar);
+
+        if (!KSUCCESS(Status)) {
+            return Status;
+        }
+
+        Status = VirtiopReadPciConfig(
+                                 Device,
+                                 Pointer + VIRTIO_PCI_CAPABILITY_REGION_OFFSET,
+                                 sizeof(ULONG),
+                                 &Offset);
+
+        if (!KSUCCESS(Status)) {
+            return Status;
+        }
+
+        Status = VirtiopReadPciConfig(
+                                 Device,
+                                 Pointer + VIRTIO_PCI_CAPABILITY_LENGTH_OFFSET,
+                                 sizeof(ULONG),
+                                 &Length);
+
+        if (!KSUCCESS(Status)) {
+            return Status;
+        }
+
+        if (CapabilityType == VIRTIO_PCI_CAPABILITY_NOTIFY) {
+            Status = VirtiopReadPciConfig(
+                             Device,
+                             Pointer + VIRTIO_PCI_CAPABILITY_MULTIPLIER_OFFSET,
+                             sizeof(ULONG),
+                             &(Device->NotifyMultiplier));
+
+            if (!KSUCCESS(Status)) {
+                return Status;
+            }
+        }
+
+        //
+        // Skip regions in BARs that cannot be mapped, in case another
+        // capability of the same type can be.
+        //
+
+        Status = VirtiopMapRegion(Device, Irp, Bar, Offset, Length, Region);
+        if ((!KSUCCESS(Status)) && (Status != STATUS_NOT_SUPPORTED)) {
+            return Status;
+        }
+
+NextCapability:
+        Status = VirtiopReadPciConfig(
+                                   Device,
+                                   Pointer + VIRTIO_PCI_CAPABILITY_NEXT_OFFSET,
+                                   sizeof(UCHAR),
+                                   &Pointer);
+
+        if (!KSUCCESS(Status)) {
+            return Status;
+        }
+
+        Pointer &= VIRTIO_PCI_CAPABILITY_POINTER_MASK;
+    }
+
+    //
+    // Legacy-only devices do not have the capabilities, and are not
+    // supported.
+    //
+
+    if ((Device->Common.Base == NULL) ||
+        (Device->Notify.Base == NULL) ||
+        (Device->Isr.Base == NULL)) {
+
+        RtlDebugPrint("Virtio: Device lacks modern PCI capabilities.\n");
+        return STATUS_NOT_SUPPORTED;
+    }
+
+    return STATUS_SUCCESS;
+}
+
+KSTATUS
+VirtiopMapRegion (
+    PVIRTIO_DEVICE Device,
+    PIRP Irp,
+    ULONG Bar,
+    ULONG Offset,
+    ULONG Length,
+    PVIRTIO_REGION Region
+    )
+
+/*++
+
+Routine Description:
+
+    This routine maps one register region described by a virtio capability.
+
+Arguments:
+
+    Device - Supplies a pointer to the device.
+
+    Irp - Supplies a pointer to the start device IRP.
+
+    Bar - Supplies the index of the BAR containing the region.
+
+    Offset - Supplies the offset of the region within the BAR.
+
+    Length - Supplies the length of the region.
+
+    Region - Supplies a pointer where the mapping will be described.
+
+Return Value:
+
+    STATUS_NOT_SUPPORTED if the region is in I/O space or could not be found
+    in the device's resources.
+
+    Other status codes.
+
+--*/
+
+{
+
+    ULONG AlignmentOffset;
+    PHYSICAL_ADDRESS BarAddress;
+    PRESOURCE_ALLOCATION BusAllocation;
+    PHYSICAL_ADDRESS EndAddress;
+    ULONG High;
+    ULONG Low;
+    ULONG PageSize;
+    PHYSICAL_ADDRESS PhysicalAddress;
+    PRESOURCE_ALLOCATION ProcessorAllocation;
+    KSTATUS Status;
+
+    if ((Bar >= VIRTIO_PCI_BAR_COUNT) || (Length == 0)) {
+        return STATUS_NOT_SUPPORTED;
+    }
+
+    Status = VirtiopReadPciConfig(Device,
+                                  VIRTIO_PCI_BAR_OFFSET + (Bar * sizeof(ULONG)),
+                                  sizeof(ULONG),
+                                  &Low);
+
+    if (!KSUCCESS(Status)) {
+        return Status;
+    }
+
+    if ((Low & VIRTIO_PCI_BAR_IO_SPACE) != 0) {
+        return STATUS_NOT_SUPPORTED;
+    }
+
+    BarAddress = Low & VIRTIO_PCI_BAR_ADDRESS_MASK;
+    if (((Low & VIRTIO_PCI_BAR_TYPE_MASK) == VIRTIO_PCI_BAR_TYPE_64_BIT) &&
+        (Bar + 1 < VIRTIO_PCI_BAR_COUNT)) {
+
+        Status = VirtiopReadPciConfig(
+                               Device,
+                               VIRTIO_PCI_BAR_OFFSET +
+                               ((Bar + 1) * sizeof(ULONG)),
+                               sizeof(ULONG),
+                               &High);
+
+        if (!KSUCCESS(Status)) {
+            return Status;
+        }
+
+        BarAddress |= (ULONGLONG)High << 32;
+    }
+
+    //
+    // Find the bus address in the device's resources, and translate it to
+    // the processor's view using the matching processor local allocation.
+    //
+
+    PhysicalAddress = BarAddress + Offset;
+    BusAllocation = IoGetNextResourceAllocation(
+                                        Irp->U.StartDevice.BusLocalResources,
+                                        NULL);
+
+    ProcessorAllocation = IoGetNextResourceAllocation(
+                                  Irp->U.StartDevice.ProcessorLocalResources,
+                                  NULL);
+
+    while ((BusAllocation != NULL) && (ProcessorAllocation != NULL)) {
+        if ((BusAllocation->Type == ResourceTypePhysicalAddressSpace) &&
+            (BusAllocation->Allocation <= PhysicalAddress) &&
+            (BusAllocation->Allocation + BusAllocation->Length >=
+             PhysicalAddress + Length)) {
+
+            break;
+        }
+
+        BusAllocation = IoGetNextResourceAllocation(
+                                        Irp->U.StartDevice.BusLocalResources,
+                                        BusAllocation);
+
+        ProcessorAllocation = IoGetNextResourceAllocation(
+                                  Irp->U.StartDevice.ProcessorLocalResources,
+                                  ProcessorAllocation);
+    }
+
+    if ((BusAllocation == NULL) || (ProcessorAllocation == NULL)) {
+        return STATUS_NOT_SUPPORTED;
+    }
+
+    PhysicalAddress = ProcessorAllocation->Allocation +
+                      (PhysicalAddress - BusAllocation->Allocation);
+
+    //
+    // Page align the mapping request.
+    //
+
+    PageSize = MmPageSize();
+    EndAddress = ALIGN_RANGE_UP(PhysicalAddress + Length, PageSize);
+    AlignmentOffset = PhysicalAddress - ALIGN_RANGE_DOWN(PhysicalAddress,
+                                                         PageSize);
+
+    PhysicalAddress -= AlignmentOffset;
+    Region->MappingSize = (UINTN)(EndAddress - PhysicalAddress);
+    Region->Mapping = MmMapPhysicalAddress(PhysicalAddress,
+                                           Region->MappingSize,
+                                           TRUE,
+                                           FALSE,
+                                           TRUE);
+
+    if (Region->Mapping == NULL) {
+        Region->MappingSize = 0;
+        return STATUS_NO_MEMORY;
+    }
+
+    Region->Base = Region->Mapping + AlignmentOffset;
+    Region->Length = Length;
+    return STATUS_SUCCESS;
+}
+
+VOID
+VirtiopUnmapRegion (
+    PVIRTIO_REGION Region
+    )
+
+/*++
+
+Routine Description:
+
+    This routine unmaps a register region.
+
+Arguments:
+
+    Region - Supplies a pointer to the region.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    if (Region->Mapping != NULL) {
+        MmUnmapAddress(Region->Mapping, Region->MappingSize);
+        Region->Mapping = NULL;
+        Region->MappingSize = 0;
+        Region->Base = NULL;
+        Region->Length = 0;
+    }
+
+    return;
+}
+
+KSTATUS
+VirtiopReadPciConfig (
+    PVIRTIO_DEVICE Device,
+    ULONG Offset,
+    ULONG Size,
+    PULONG Value
+    )
+
+/*++
+
+Routine Description:
+
+    This routine reads from the device's PCI configuration space.
+
+Arguments:
+
+    Device - Supplies a pointer to the device.
+
+    Offset - Supplies the offset to read.
+
+    Size - Supplies the access size, at most four bytes.
+
+    Value - Supplies a pointer where the value will be returned.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    KSTATUS Status;
+    ULONGLONG Value64;
+
+    Status = Device->PciConfigInterface.ReadPciConfig(
+                                       Device->PciConfigInterface.DeviceToken,
+                                       Offset,
+                                       Size,
+                                       &Value64);
+
+    *Value = (ULONG)Value64;
+    return Status;
+}
+
+KSTATUS
+VirtiopResetDevice (
+    PVIRTIO_DEVICE Device
+    )
+
+/*++
+
+Routine Description:
+
+    This routine resets the device and waits for the reset to complete.
+
+Arguments:
+
+    Device - Supplies a pointer to the device.
+
+Return Value:
+
+    STATUS_SUCCESS on success.
+
+    STATUS_TIMEOUT if the device never finished resetting.
+
+--*/
+
+{
+
+    ULONGLONG Timeout;
+
+    VIRTIO_WRITE_COMMON8(Device, VirtioCommonDeviceStatus, 0);
+    Timeout = HlQueryTimeCounter() +
+              ((HlQueryTimeCounterFrequency() * VIRTIO_RESET_TIMEOUT_MS) /
+               MILLISECONDS_PER_SECOND);
+
+    while (VIRTIO_READ_COMMON8(Device, VirtioCommonDeviceStatus) != 0) {
+        if (HlQueryTimeCounter() > Timeout) {
+            return STATUS_TIMEOUT;
+        }
+    }
+
+    return STATUS_SUCCESS;
+}
+
+KSTATUS
+VirtiopNegotiateFeatures (
+    PVIRTIO_DEVICE Device
+    )
+
+/*++
+
+Routine Description:
+
+    This routine negotiates features with the device, ending with the
+    features OK status bit set.
+
+Arguments:
+
+    Device - Supplies a pointer to the device.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    ULONGLONG DeviceFeatures;
+    UCHAR DeviceStatus;
+    ULONGLONG Features;
+
+    VIRTIO_WRITE_COMMON32(Device, VirtioCommonDeviceFeatureSelect, 0);
+    DeviceFeatures = VIRTIO_READ_COMMON32(Device, VirtioCommonDeviceFeature);
+    VIRTIO_WRITE_COMMON32(Device, VirtioCommonDeviceFeatureSelect, 1);
+    DeviceFeatures |= (ULONGLONG)VIRTIO_READ_COMMON32(
+                                                    Device,
+                                                    VirtioCommonDeviceFeature)
+                      << 32;
+
+    if ((DeviceFeatures & VIRTIO_FEATURE_VERSION_1) == 0) {
+        RtlDebugPrint("Virtio: Legacy-only device not supported.\n");
+        return STATUS_NOT_SUPPORTED;
+    }
+
+    Features = DeviceFeatures &
+               (Device->DriverFeatures | VIRTIO_LIBRARY_FEATURES);
+
+    VIRTIO_WRITE_COMMON32(Device, VirtioCommonDriverFeatureSelect, 0);
+    VIRTIO_WRITE_COMMON32(Device, VirtioCommonDriverFeature, (ULONG)Features);
+    VIRTIO_WRITE_COMMON32(Device, VirtioCommonDriverFeatureSelect, 1);
+    VIRTIO_WRITE_COMMON32(Device,
+                          VirtioCommonDriverFeature,
+                          (ULONG)(Features >> 32));
+
+    DeviceStatus = VIRTIO_READ_COMMON8(Device, VirtioCommonDeviceStatus);
+    DeviceStatus |= VIRTIO_STATUS_FEATURES_OK;
+    VIRTIO_WRITE_COMMON8(Device, VirtioCommonDeviceStatus, DeviceStatus);
+    DeviceStatus = VIRTIO_READ_COMMON8(Device, VirtioCommonDeviceStatus);
+    if ((DeviceStatus & VIRTIO_STATUS_FEATURES_OK) == 0) {
+        return STATUS_NOT_SUPPORTED;
+    }
+
+    Device->Features = Features;
+    return STATUS_SUCCESS;
+}
+
+KSTATUS
+VirtiopConnectInterrupts (
+    PVIRTIO_DEVICE Device
+    )
+
+/*++
+
+Routine Description:
+
+    This routine connects the device's interrupts, and programs and enables
+    MSI-X if it is in use. Each queue vector is aimed at its own processor.
+
+Arguments:
+
+    Device - Supplies a pointer to the device.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    IO_CONNECT_INTERRUPT_PARAMETERS Connect;
+    ULONG Index;
+    PVIRTIO_INTERRUPT Interrupt;
+    BOOL LowLevel;
+    PCI_MSI_INFORMATION MsiInformation;
+    PINTERFACE_PCI_MSI MsiInterface;
+    PROCESSOR_SET ProcessorSet;
+    PVIRTIO_QUEUE Queue;
+    ULONG QueueIndex;
+    KSTATUS Status;
+
+    for (Index = 0; Index < Device->InterruptCount; Index += 1) {
+        Interrupt = &(Device->Interrupts[Index]);
+        Interrupt->Device = Device;
+        Interrupt->Handle = INVALID_HANDLE;
+        Interrupt->Index = Index;
+        Interrupt->Vector = Device->InterruptVector + Index;
+        Interrupt->Processor = 0;
+        if (Index != 0) {
+            Interrupt->Processor = Index - 1;
+        }
+
+        //
+        // Only pay for the low level work item where something needs it: the
+        // configuration vector and vectors serving low level queues.
+        //
+
+        LowLevel = FALSE;
+        if ((Index == 0) && (Device->ConfigurationChangeRoutine != NULL)) {
+            LowLevel = TRUE;
+        }
+
+        for (QueueIndex = 0; QueueIndex < Device->QueueCount; QueueIndex += 1) {
+            Queue = Device->Queues[QueueIndex];
+            if ((Queue != NULL) &&
+                (Queue->Interrupt == Interrupt) &&
+                ((Queue->Flags & VIRTIO_QUEUE_FLAG_LOW_LEVEL) != 0)) {
+
+                LowLevel = TRUE;
+            }
+        }
+
+        RtlZeroMemory(&Connect, sizeof(IO_CONNECT_INTERRUPT_PARAMETERS));
+        Connect.Version = IO_CONNECT_INTERRUPT_PARAMETERS_VERSION;
+        Connect.Device = Device->OsDevice;
+        Connect.LineNumber = Device->InterruptLine;
+        Connect.Vector = Interrupt->Vector;
+        Connect.InterruptServiceRoutine = VirtiopInterruptService;
+        Connect.DispatchServiceRoutine = VirtiopInterruptServiceDispatch;
+        if (LowLevel != FALSE) {
+            Connect.LowLevelServiceRoutine = VirtiopInterruptServiceWorker;
+        }
+
+        Connect.Context = Interrupt;
+        Connect.Interrupt = &(Interrupt->Handle);
+        Status = IoConnectInterrupt(&Connect);
+        if (!KSUCCESS(Status)) {
+            goto ConnectInterruptsEnd;
+        }
+    }
+
+    if (Device->InterruptLine != INVALID_INTERRUPT_LINE) {
+        Status = STATUS_SUCCESS;
+        goto ConnectInterruptsEnd;
+    }
+
+    ASSERT((Device->Flags & VIRTIO_DEVICE_FLAG_MSI_ALLOCATED) != 0);
+
+    //
+    // Aim the configuration vector anywhere, and each queue vector at its
+    // processor.
+    //
+
+    MsiInterface = &(Device->PciMsiInterface);
+    for (Index = 0; Index < Device->InterruptCount; Index += 1) {
+        Interrupt = &(Device->Interrupts[Index]);
+        RtlZeroMemory(&ProcessorSet, sizeof(PROCESSOR_SET));
+        ProcessorSet.Target = ProcessorTargetAny;
+        if (Index != 0) {
+            ProcessorSet.Target = ProcessorTargetSingleProcessor;
+            ProcessorSet.U.Number = Interrupt->Processor;
+        }
+
+        Status = MsiInterface->SetVectors(MsiInterface->DeviceToken,
+                                          PciMsiTypeExtended,
+                                          Interrupt->Vector,
+                                          Index,
+                                          1,
+                                          &ProcessorSet);
+
+        if (!KSUCCESS(Status)) {
+            goto ConnectInterruptsEnd;
+        }
+    }
+
+    RtlZeroMemory(&MsiInformation, sizeof(PCI_MSI_INFORMATION));
+    MsiInformation.Version = PCI_MSI_INTERFACE_INFORMATION_VERSION;
+    MsiInformation.MsiType = PciMsiTypeExtended;
+    MsiInformation.Flags = PCI_MSI_INTERFACE_FLAG_ENABLED;
+    MsiInformation.VectorCount = Device->InterruptCount;
+    Status = MsiInterface->GetSetInformation(MsiInterface->DeviceToken,
+                                             &MsiInformation,
+                                             TRUE);
+
+ConnectInterruptsEnd:
+    if (!KSUCCESS(Status)) {
+        VirtiopDisconnectInterrupts(Device);
+    }
+
+    return Status;
+}
+
+VOID
+VirtiopDisconnectInterrupts (
+    PVIRTIO_DEVICE Device
+    )
+
+/*++
+
+Routine Description:
+
+    This routine disconnects any connected interrupts.
+
+Arguments:
+
+    Device - Supplies a pointer to the device.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    ULONG Index;
+    PVIRTIO_INTERRUPT Interrupt;
+
+    if (Device->Interrupts == NULL) {
+        return;
+    }
+
+    for (Index = 0; Index < Device->InterruptCount; Index += 1) {
+        Interrupt = &(Device->Interrupts[Index]);
+        if ((Interrupt->Handle != INVALID_HANDLE) &&
+            (Interrupt->Handle != NULL)) {
+
+            IoDisconnectInterrupt(Interrupt->Handle);
+            Interrupt->Handle = INVALID_HANDLE;
+        }
+    }
+
+    return;
+}
+
+USHORT
+VirtiopGetQueueVector (
+    PVIRTIO_DEVICE Device,
+    ULONG Processor
+    )
+
+/*++
+
+Routine Description:
+
+    This routine determines which MSI-X vector serves queues for the given
+    processor.
+
+Arguments:
+
+    Device - Supplies a pointer to the device.
+
+    Processor - Supplies the processor the queue is used from.
+
+Return Value:
+
+    Returns the MSI-X table index for the queue.
+
+--*/
+
+{
+
+    ASSERT(Device->InterruptLine == INVALID_INTERRUPT_LINE);
+
+    //
+    // With a single vector, everything shares it. Otherwise vector zero is
+    // for configuration changes, and the rest are dealt out to processors.
+    //
+
+    if (Device->InterruptCount <= 1) {
+        return 0;
+    }
+
+    return 1 + (Processor % (Device->InterruptCount - 1));
+}
+
+VOID
+VirtiopProcessPciConfigInterfaceChangeNotification (
+    PVOID Context,
+    PDEVICE Device,
+    PVOID InterfaceBuffer,
+    ULONG InterfaceBufferSize,
+    BOOL Arrival
+    )
+
+/*++
+
+Routine Description:
+
+    This routine is called when a PCI configuration space access interface
+    changes in availability.
+
+Arguments:
+
+    Context - Supplies the caller's context pointer, supplied when the caller
+        requested interface notifications.
+
+    Device - Supplies a pointer to the device exposing or deleting the
+        interface.
+
+    InterfaceBuffer - Supplies a pointer to the interface buffer of the
+        interface.
+
+    InterfaceBufferSize - Supplies the buffer size.
+
+    Arrival - Supplies TRUE if a new interface is arriving, or FALSE if an
+        interface is departing.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PVIRTIO_DEVICE VirtioDevice;
+
+    VirtioDevice = Context;
+    if (Arrival != FALSE) {
+        if (InterfaceBufferSize >= sizeof(INTERFACE_PCI_CONFIG_ACCESS)) {
+
+            ASSERT((VirtioDevice->Flags &
+                    VIRTIO_DEVICE_FLAG_PCI_CONFIG_AVAILABLE) == 0);
+
+            RtlCopyMemory(&(VirtioDevice->PciConfigInterface),
+                          InterfaceBuffer,
+                          sizeof(INTERFACE_PCI_CONFIG_ACCESS));
+
+            VirtioDevice->Flags |= VIRTIO_DEVICE_FLAG_PCI_CONFIG_AVAILABLE;
+        }
+
+    } else {
+        VirtioDevice->Flags &= ~VIRTIO_DEVICE_FLAG_PCI_CONFIG_AVAILABLE;
+    }
+
+    return;
+}
+
+VOID
+VirtiopProcessPciMsiInterfaceChangeNotification (
+    PVOID Context,
+    PDEVICE Device,
+    PVOID InterfaceBuffer,
+    ULONG InterfaceBufferSize,
+    BOOL Arrival
+    )
+
+/*++
+
+Routine Description:
+
+    This routine is called when a PCI MSI interface changes in availability.
+
+Arguments:
+
+    Context - Supplies the caller's context pointer, supplied when the caller
+        requested interface notifications.
+
+    Device - Supplies a pointer to the device exposing or deleting the
+        interface.
+
+    InterfaceBuffer - Supplies a pointer to the interface buffer of the
+        interface.
+
+    InterfaceBufferSize - Supplies the buffer size.
+
+    Arrival - Supplies TRUE if a new interface is arriving, or FALSE if an
+        interface is departing.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PVIRTIO_DEVICE VirtioDevice;
+
+    VirtioDevice = Context;
+    if (Arrival != FALSE) {
+        if (InterfaceBufferSize >= sizeof(INTERFACE_PCI_MSI)) {
+
+            ASSERT((VirtioDevice->Flags &
+                    VIRTIO_DEVICE_FLAG_PCI_MSI_AVAILABLE) == 0);
+
+            RtlCopyMemory(&(VirtioDevice->PciMsiInterface),
+                          InterfaceBuffer,
+                          sizeof(INTERFACE_PCI_MSI));
+
+            VirtioDevice->Flags |= VIRTIO_DEVICE_FLAG_PCI_MSI_AVAILABLE;
+        }
+
+    } else {
+        VirtioDevice->Flags &= ~VIRTIO_DEVICE_FLAG_PCI_MSI_AVAILABLE;
+    }
+
+    return;
+}
@@ -0,0 +1,682 @@
+/*++
+
+Copyright (c) 2026 Minoca Corp.
+
+    This file is licensed under the terms of the GNU General Public License
+    version 3. Alternative licensing terms are available. Contact
+    info@minocacorp.com for details. See the LICENSE file at the root of this
+    project for complete licensing information.
+
+Module Name:
+
+    virtiop.h
+
+Abstract:
+
+    This header contains internal definitions for the virtio core library.
+
+Author:
+
+    Minoca Corp. 18-Oct-2026
+
+--*/
+
+//
+// ------------------------------------------------------------------- Includes
+//
+
+#define VIRTIO_API __DLLEXPORT
+
+#include <minoca/intrface/pci.h>
+#include <minoca/virtio/virtio.h>
+
+//
+// --------------------------------------------------------------------- Macros
+//
+
+//
+// These macros access the common configuration registers.
+//
+
+#define VIRTIO_READ_COMMON8(_Device, _Register) \
+    HlReadRegister8((_Device)->Common.Base + (_Register))
+
+#define VIRTIO_WRITE_COMMON8(_Device, _Register, _Value) \
+    HlWriteRegister8((_Device)->Common.Base + (_Register), (_Value))
+
+#define VIRTIO_READ_COMMON16(_Device, _Register) \
+    HlReadRegister16((_Device)->Common.Base + (_Register))
+
+#define VIRTIO_WRITE_COMMON16(_Device, _Register, _Value) \
+    HlWriteRegister16((_Device)->Common.Base + (_Register), (_Value))
+
+#define VIRTIO_READ_COMMON32(_Device, _Register) \
+    HlReadRegister32((_Device)->Common.Base + (_Register))
+
+#define VIRTIO_WRITE_COMMON32(_Device, _Register, _Value) \
+    HlWriteRegister32((_Device)->Common.Base + (_Register), (_Value))
+
+#define VIRTIO_WRITE_COMMON64(_Device, _Register, _Value)             \
+    VIRTIO_WRITE_COMMON32((_Device), (_Register), (ULONG)(_Value));   \
+    VIRTIO_WRITE_COMMON32((_Device),                                  \
+                          (_Register) + sizeof(ULONG),                \
+                          (ULONG)((_Value) >> 32))
+
+//
+// ---------------------------------------------------------------- Definitions
+//
+
+#define VIRTIO_ALLOCATION_TAG 0x74726956 // 'triV'
+
+//
+// Define the PCI configuration space offsets the library needs.
+//
+
+#define VIRTIO_PCI_STATUS_OFFSET 0x06
+#define VIRTIO_PCI_STATUS_CAPABILITIES_LIST 0x0010
+#define VIRTIO_PCI_BAR_OFFSET 0x10
+#define VIRTIO_PCI_BAR_COUNT 6
+#define VIRTIO_PCI_CAPABILITY_POINTER_OFFSET 0x34
+#define VIRTIO_PCI_CAPABILITY_POINTER_MASK 0xFC
+
+#define VIRTIO_PCI_BAR_IO_SPACE 0x00000001
+#define VIRTIO_PCI_BAR_TYPE_MASK 0x00000006
+#define VIRTIO_PCI_BAR_TYPE_64_BIT 0x00000004
+#define VIRTIO_PCI_BAR_ADDRESS_MASK 0xFFFFFFF0
+
+//
+// Define the layout of a virtio vendor specific PCI capability.
+//
+
+#define VIRTIO_PCI_CAPABILITY_VENDOR_ID 0x09
+#define VIRTIO_PCI_CAPABILITY_NEXT_OFFSET 1
+#define VIRTIO_PCI_CAPABILITY_TYPE_OFFSET 3
+#define VIRTIO_PCI_CAPABILITY_BAR_OFFSET 4
+#define VIRTIO_PCI_CAPABILITY_REGION_OFFSET 8
+#define VIRTIO_PCI_CAPABILITY_LENGTH_OFFSET 12
+#define VIRTIO_PCI_CAPABILITY_MULTIPLIER_OFFSET 16
+
+//
+// Guard against a malformed capability list looping forever.
+//
+
+#define VIRTIO_PCI_MAX_CAPABILITIES 48
+
+//
+// Define the virtio PCI capability types.
+//
+
+#define VIRTIO_PCI_CAPABILITY_COMMON 1
+#define VIRTIO_PCI_CAPABILITY_NOTIFY 2
+#define VIRTIO_PCI_CAPABILITY_ISR 3
+#define VIRTIO_PCI_CAPABILITY_DEVICE 4
+
+//
+// Define the device status bits.
+//
+
+#define VIRTIO_STATUS_ACKNOWLEDGE 0x01
+#define VIRTIO_STATUS_DRIVER      0x02
+#define VIRTIO_STATUS_DRIVER_OK   0x04
+#define VIRTIO_STATUS_FEATURES_OK 0x08
+#define VIRTIO_STATUS_FAILED      0x80
+
+//
+// Define the ISR status bits, used with legacy interrupts.
+//
+
+#define VIRTIO_ISR_QUEUE         0x01
+#define VIRTIO_ISR_CONFIGURATION 0x02
+
+//
+// Define the MSI-X vector value that means no vector.
+//
+
+#define VIRTIO_MSI_NO_VECTOR 0xFFFF
+
+//
+// Define the amount of time to wait for the device to reset, in milliseconds.
+//
+
+#define VIRTIO_RESET_TIMEOUT_MS 1000
+
+//
+// Define the transport features the library itself handles.
+//
+
+#define VIRTIO_LIBRARY_FEATURES             \
+    (VIRTIO_FEATURE_INDIRECT_DESCRIPTORS |  \
+     VIRTIO_FEATURE_EVENT_INDEX |           \
+     VIRTIO_FEATURE_VERSION_1)
+
+//
+// Define the maximum queue size in the split ring format.
+//
+
+#define VIRTIO_MAX_QUEUE_SIZE 0x8000
+
+//
+// Define the ring alignments required by the split ring format.
+//
+
+#define VIRTIO_DESCRIPTOR_ALIGNMENT 16
+#define VIRTIO_USED_RING_ALIGNMENT 4
+
+//
+// Define virtqueue descriptor flags.
+//
+
+#define VIRTIO_DESCRIPTOR_NEXT     0x0001
+#define VIRTIO_DESCRIPTOR_WRITE    0x0002
+#define VIRTIO_DESCRIPTOR_INDIRECT 0x0004
+
+//
+// Define available ring flags.
+//
+
+#define VIRTIO_AVAILABLE_NO_INTERRUPT 0x0001
+
+//
+// Define used ring flags.
+//
+
+#define VIRTIO_USED_NO_NOTIFY 0x0001
+
+//
+// Define virtio device flags.
+//
+
+#define VIRTIO_DEVICE_FLAG_PCI_CONFIG_REGISTERED 0x00000001
+#define VIRTIO_DEVICE_FLAG_PCI_CONFIG_AVAILABLE  0x00000002
+#define VIRTIO_DEVICE_FLAG_PCI_MSI_REGISTERED    0x00000004
+#define VIRTIO_DEVICE_FLAG_PCI_MSI_AVAILABLE     0x00000008
+#define VIRTIO_DEVICE_FLAG_MSI_REQUESTED         0x00000010
+#define VIRTIO_DEVICE_FLAG_MSI_ALLOCATED         0x00000020
+#define VIRTIO_DEVICE_FLAG_STARTED               0x00000040
+#define VIRTIO_DEVICE_FLAG_ENABLED               0x00000080
+
+//
+// ------------------------------------------------------ Data Type Definitions
+//
+
+/*++
+
+Structure Description:
+
+    This structure defines a virtqueue descriptor, as laid out in memory.
+
+Members:
+
+    Address - Stores the physical address of the buffer.
+
+    Length - Stores the length of the buffer in bytes.
+
+    Flags - Stores a bitmask of flags. See VIRTIO_DESCRIPTOR_* definitions.
+
+    Next - Stores the index of the next descriptor in the chain. For free
+        descriptors, this links the free list.
+
+--*/
+
+typedef struct _VIRTIO_DESCRIPTOR {
+    ULONGLONG Address;
+    ULONG Length;
+    USHORT Flags;
+    USHORT Next;
+} PACKED VIRTIO_DESCRIPTOR, *PVIRTIO_DESCRIPTOR;
+
+/*++
+
+Structure Description:
+
+    This structure defines the available ring, written by the driver. The
+    used event index follows the ring entries.
+
+Members:
+
+    Flags - Stores a bitmask of flags. See VIRTIO_AVAILABLE_* definitions.
+
+    Index - Stores the index where the driver will put the next entry, modulo
+        the queue size.
+
+    Ring - Stores the head descriptor indices of available requests.
+
+--*/
+
+typedef struct _VIRTIO_AVAILABLE_RING {
+    USHORT Flags;
+    USHORT Index;
+    USHORT Ring[ANYSIZE_ARRAY];
+} PACKED VIRTIO_AVAILABLE_RING, *PVIRTIO_AVAILABLE_RING;
+
+/*++
+
+Structure Description:
+
+    This structure defines an entry in the used ring.
+
+Members:
+
+    Id - Stores the head descriptor index of the used request.
+
+    Length - Stores the number of bytes the device wrote into the request.
+
+--*/
+
+typedef struct _VIRTIO_USED_ELEMENT {
+    ULONG Id;
+    ULONG Length;
+} PACKED VIRTIO_USED_ELEMENT, *PVIRTIO_USED_ELEMENT;
+
+/*++
+
+Structure Description:
+
+    This structure defines the used ring, written by the device. The
+    available event index follows the ring entries.
+
+Members:
+
+    Flags - Stores a bitmask of flags. See VIRTIO_USED_* definitions.
+
+    Index - Stores the index where the device will put the next entry, modulo
+        the queue size.
+
+    Ring - Stores the used requests.
+
+--*/
+
+typedef struct _VIRTIO_USED_RING {
+    USHORT Flags;
+    USHORT Index;
+    VIRTIO_USED_ELEMENT Ring[ANYSIZE_ARRAY];
+} PACKED VIRTIO_USED_RING, *PVIRTIO_USED_RING;
+
+//
+// Define the offsets of the common configuration registers.
+//
+
+typedef enum _VIRTIO_COMMON_REGISTER {
+    VirtioCommonDeviceFeatureSelect = 0x00,
+    VirtioCommonDeviceFeature = 0x04,
+    VirtioCommonDriverFeatureSelect = 0x08,
+    VirtioCommonDriverFeature = 0x0C,
+    VirtioCommonConfigurationVector = 0x10,
+    VirtioCommonQueueCount = 0x12,
+    VirtioCommonDeviceStatus = 0x14,
+    VirtioCommonConfigurationGeneration = 0x15,
+    VirtioCommonQueueSelect = 0x16,
+    VirtioCommonQueueSize = 0x18,
+    VirtioCommonQueueVector = 0x1A,
+    VirtioCommonQueueEnable = 0x1C,
+    VirtioCommonQueueNotifyOffset = 0x1E,
+    VirtioCommonQueueDescriptors = 0x20,
+    VirtioCommonQueueAvailable = 0x28,
+    VirtioCommonQueueUsed = 0x30
+} VIRTIO_COMMON_REGISTER, *PVIRTIO_COMMON_REGISTER;
+
+/*++
+
+Structure Description:
+
+    This structure defines a mapped region of a virtio device's BARs.
+
+Members:
+
+    Mapping - Stores the page aligned virtual address of the mapping.
+
+    MappingSize - Stores the size of the mapping, in bytes.
+
+    Base - Stores the virtual address of the start of the region.
+
+    Length - Stores the length of the region, in bytes.
+
+--*/
+
+typedef struct _VIRTIO_REGION {
+    PVOID Mapping;
+    UINTN MappingSize;
+    PVOID Base;
+    ULONG Length;
+} VIRTIO_REGION, *PVIRTIO_REGION;
+
+/*++
+
+Structure Description:
+
+    This structure defines one connected virtio interrupt.
+
+Members:
+
+    Device - Stores a pointer to the device that owns the interrupt.
+
+    Handle - Stores the connected interrupt handle.
+
+    Index - Stores the MSI-X table index of the interrupt. This is zero for
+        legacy interrupts.
+
+    Vector - Stores the interrupt vector.
+
+    Processor - Stores the processor the interrupt is aimed at, for queue
+        vectors.
+
+--*/
+
+typedef struct _VIRTIO_INTERRUPT {
+    PVIRTIO_DEVICE Device;
+    HANDLE Handle;
+    ULONG Index;
+    ULONGLONG Vector;
+    ULONG Processor;
+} VIRTIO_INTERRUPT, *PVIRTIO_INTERRUPT;
+
+/*++
+
+Structure Description:
+
+    This structure defines a virtio device context.
+
+Members:
+
+    OsDevice - Stores a pointer to the OS device.
+
+    Flags - Stores a bitmask of flags. See VIRTIO_DEVICE_FLAG_* definitions.
+
+    PciConfigInterface - Stores the PCI configuration space interface.
+
+    PciMsiInterface - Stores the PCI MSI interface.
+
+    Common - Stores the common configuration register region.
+
+    Notify - Stores the queue notification region.
+
+    Isr - Stores the ISR status register region.
+
+    DeviceConfiguration - Stores the device specific configuration region.
+
+    NotifyMultiplier - Stores the multiplier applied to each queue's notify
+        offset.
+
+    DriverFeatures - Stores the device specific features the driver supports.
+
+    Features - Stores the negotiated features.
+
+    QueueCount - Stores the number of queues the device implements.
+
+    Queues - Stores an array of pointers to created queues, indexed by queue
+        index.
+
+    InterruptLine - Stores the legacy interrupt line, or
+        INVALID_INTERRUPT_LINE when MSI-X is used.
+
+    InterruptVector - Stores the first allocated interrupt vector.
+
+    InterruptCount - Stores the number of allocated interrupt vectors.
+
+    Interrupts - Stores the array of interrupts.
+
+    PendingIsrStatus - Stores the ISR status bits read by the legacy
+        interrupt service routine that have not yet been handled.
+
+    ConfigurationChangeRoutine - Stores an optional pointer to the routine to
+        call when the configuration changes.
+
+    Context - Stores the context passed to the configuration change routine.
+
+--*/
+
+struct _VIRTIO_DEVICE {
+    PDEVICE OsDevice;
+    ULONG Flags;
+    INTERFACE_PCI_CONFIG_ACCESS PciConfigInterface;
+    INTERFACE_PCI_MSI PciMsiInterface;
+    VIRTIO_REGION Common;
+    VIRTIO_REGION Notify;
+    VIRTIO_REGION Isr;
+    VIRTIO_REGION DeviceConfiguration;
+    ULONG NotifyMultiplier;
+    ULONGLONG DriverFeatures;
+    ULONGLONG Features;
+    ULONG QueueCount;
+    PVIRTIO_QUEUE *Queues;
+    ULONGLONG InterruptLine;
+    ULONGLONG InterruptVector;
+    ULONG InterruptCount;
+    PVIRTIO_INTERRUPT Interrupts;
+    volatile ULONG PendingIsrStatus;
+    PVIRTIO_CONFIGURATION_CHANGE_ROUTINE ConfigurationChangeRoutine;
+    PVOID Context;
+};
+
+/*++
+
+Structure Description:
+
+    This structure defines a split virtqueue.
+
+Members:
+
+    Device - Stores a pointer to the device that owns the queue.
+
+    Index - Stores the queue index.
+
+    Size - Stores the number of descriptors in the queue.
+
+    Flags - Stores a bitmask of flags. See VIRTIO_QUEUE_FLAG_* definitions.
+
+    EventIndex - Stores a boolean indicating whether the event index feature
+        was negotiated.
+
+    InterruptsDisabled - Stores a boolean indicating whether the driver last
+        asked the device not to interrupt.
+
+    MaxSegments - Stores the maximum number of buffers in one request.
+
+    IoBuffer - Stores the I/O buffer backing the rings.
+
+    Descriptors - Stores the descriptor table.
+
+    Available - Stores the available ring.
+
+    Used - Stores the used ring.
+
+    UsedEvent - Stores a pointer to the used event index, written by the
+        driver to say when it next wants an interrupt.
+
+    AvailableEvent - Stores a pointer to the available event index, written
+        by the device to say when it next wants a notification.
+
+    FreeHead - Stores the index of the first free descriptor.
+
+    FreeCount - Stores the number of free descriptors.
+
+    NextAvailable - Stores the driver's copy of the available ring index.
+
+    LastUsed - Stores the index of the next used ring entry to process.
+
+    AddedSinceNotify - Stores the number of requests made available since
+        the device was last notified.
+
+    Cookies - Stores the caller's cookie for each request, indexed by head
+        descriptor.
+
+    DescriptorCounts - Stores the number of ring descriptors each request
+        uses, indexed by head descriptor.
+
+    IndirectIoBuffer - Stores the I/O buffer backing the indirect descriptor
+        tables, if indirect descriptors are in use.
+
+    IndirectTables - Stores the indirect descriptor tables, one per head
+        descriptor.
+
+    IndirectPhysical - Stores the physical address of each indirect table.
+
+    IndirectStride - Stores the distance between indirect tables, in
+        descriptors.
+
+    NotifyAddress - Stores the address to write to notify the device.
+
+    Interrupt - Stores a pointer to the interrupt serving the queue.
+
+    ServiceRoutine - Stores the routine to call when buffers are used.
+
+    Context - Stores the service routine context.
+
+--*/
+
+struct _VIRTIO_QUEUE {
+    PVIRTIO_DEVICE Device;
+    USHORT Index;
+    USHORT Size;
+    ULONG Flags;
+    BOOL EventIndex;
+    BOOL InterruptsDisabled;
+    ULONG MaxSegments;
+    PIO_BUFFER IoBuffer;
+    PVIRTIO_DESCRIPTOR Descriptors;
+    PVIRTIO_AVAILABLE_RING Available;
+    PVIRTIO_USED_RING Used;
+    volatile USHORT *UsedEvent;
+    volatile USHORT *AvailableEvent;
+    USHORT FreeHead;
+    USHORT FreeCount;
+    USHORT NextAvailable;
+    USHORT LastUsed;
+    USHORT AddedSinceNotify;
+    PVOID *Cookies;
+    PUSHORT DescriptorCounts;
+    PIO_BUFFER IndirectIoBuffer;
+    PVIRTIO_DESCRIPTOR IndirectTables;
+    PPHYSICAL_ADDRESS IndirectPhysical;
+    ULONG IndirectStride;
+    PVOID NotifyAddress;
+    PVIRTIO_INTERRUPT Interrupt;
+    PVIRTIO_QUEUE_SERVICE_ROUTINE ServiceRoutine;
+    PVOID Context;
+};
+
+//
+// -------------------------------------------------------------------- Globals
+//
+
+//
+// -------------------------------------------------------- Function Prototypes
+//
+
+//
+// Virtqueue functions
+//
+
+KSTATUS
+VirtiopInitializeQueue (
+    PVIRTIO_QUEUE Queue,
+    USHORT Size,
+    ULONG MaxSegments
+    );
+
+/*++
+
+Routine Description:
+
+    This routine allocates and initializes the rings and descriptor
+    bookkeeping for a virtqueue.
+
+Arguments:
+
+    Queue - Supplies a pointer to the queue, which has its device and flags
+        already filled in.
+
+    Size - Supplies the number of descriptors in the queue.
+
+    MaxSegments - Supplies the maximum number of buffers per request.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+VOID
+VirtiopDestroyQueue (
+    PVIRTIO_QUEUE Queue
+    );
+
+/*++
+
+Routine Description:
+
+    This routine frees a virtqueue and its rings. The device must already be
+    reset.
+
+Arguments:
+
+    Queue - Supplies a pointer to the queue.
+
+Return Value:
+
+    None.
+
+--*/
+
+PHYSICAL_ADDRESS
+VirtiopGetQueueDescriptorsAddress (
+    PVIRTIO_QUEUE Queue
+    );
+
+/*++
+
+Routine Description:
+
+    This routine returns the physical address of a queue's descriptor table.
+
+Arguments:
+
+    Queue - Supplies a pointer to the queue.
+
+Return Value:
+
+    Returns the physical address.
+
+--*/
+
+PHYSICAL_ADDRESS
+VirtiopGetQueueAvailableAddress (
+    PVIRTIO_QUEUE Queue
+    );
+
+/*++
+
+Routine Description:
+
+    This routine returns the physical address of a queue's available ring.
+
+Arguments:
+
+    Queue - Supplies a pointer to the queue.
+
+Return Value:
+
+    Returns the physical address.
+
+--*/
+
+PHYSICAL_ADDRESS
+VirtiopGetQueueUsedAddress (
+    PVIRTIO_QUEUE Queue
+    );
+
+/*++
+
+Routine Description:
+
+    This routine returns the physical address of a queue's used ring.
+
+Arguments:
+
+    Queue - Supplies a pointer to the queue.
+
+Return Value:
+
+    Returns the physical address.
+
+--*/
@@ -0,0 +1,828 @@
+/*++
+
+Copyright (c) 2026 Minoca Corp.
+
+    This file is licensed under the terms of the GNU General Public License
+    version 3. Alternative licensing terms are available. Contact
+    info@minocacorp.com for details. See the LICENSE file at the root of this
+    project for complete licensing information.
+
+Module Name:
+
+    vqueue.c
+
+Abstract:
+
+    This module implements split virtqueues: the descriptor table, available
+    ring, and used ring shared with the device, along with indirect
+    descriptor tables and event index interrupt suppression.
+
+Author:
+
+    Minoca Corp. 18-Oct-2026
+
+Environment:
+
+    Kernel
+
+--*/
+
+//
+// ------------------------------------------------------------------- Includes
+//
+
+#include <minoca/kernel/driver.h>
+#include "virtiop.h"
+
+//
+// --------------------------------------------------------------------- Macros
+//
+
+//
+// These macros return the size of the available and used rings for a queue
+// with the given number of entries, including the trailing event field.
+//
+
+#define VIRTIO_AVAILABLE_RING_SIZE(_QueueSize) \
+    (FIELD_OFFSET(VIRTIO_AVAILABLE_RING, Ring) + \
+     (((_QueueSize) + 1) * sizeof(USHORT)))
+
+#define VIRTIO_USED_RING_SIZE(_QueueSize) \
+    (FIELD_OFFSET(VIRTIO_USED_RING, Ring) + \
+     ((_QueueSize) * sizeof(VIRTIO_USED_ELEMENT)) + sizeof(USHORT))
+
+//
+// This macro accesses a ring field shared with the device.
+//
+
+#define VIRTIO_RING_INDEX(_Index) (*((volatile USHORT *)&(_Index)))
+
+//
+// ---------------------------------------------------------------- Definitions
+//
+
+//
+// ------------------------------------------------------ Data Type Definitions
+//
+
+//
+// ----------------------------------------------- Internal Function Prototypes
+//
+
+KSTATUS
+VirtiopInitializeIndirectTables (
+    PVIRTIO_QUEUE Queue
+    );
+
+//
+// -------------------------------------------------------------------- Globals
+//
+
+//
+// ------------------------------------------------------------------ Functions
+//
+
+VIRTIO_API
+ULONG
+VirtioGetQueueSize (
+    PVIRTIO_QUEUE Queue
+    )
+
+/*++
+
+Routine Description:
+
+    This routine returns the number of descriptors in a virtqueue.
+
+Arguments:
+
+    Queue - Supplies a pointer to the queue.
+
+Return Value:
+
+    Returns the queue size.
+
+--*/
+
+{
+
+    return Queue->Size;
+}
+
+VIRTIO_API
+KSTATUS
+VirtioAddBuffers (
+    PVIRTIO_QUEUE Queue,
+    PVIRTIO_BUFFER Buffers,
+    ULONG Count,
+    PVOID Cookie
+    )
+
+/*++
+
+Routine Description:
+
+    This routine makes a chain of buffers available to the device. The device
+    does not see it until the queue is notified. The caller is responsible
+    for synchronizing access to the queue.
+
+Arguments:
+
+    Queue - Supplies a pointer to the queue.
+
+    Buffers - Supplies an array of buffers making up the request. Buffers the
+        device reads must come before buffers the device writes.
+
+    Count - Supplies the number of buffers in the array.
+
+    Cookie - Supplies a non-null context pointer returned when the device
+        is done with the buffers.
+
+Return Value:
+
+    STATUS_SUCCESS on success.
+
+    STATUS_RESOURCE_IN_USE if the queue does not have room for the buffers.
+
+    STATUS_INVALID_PARAMETER if there are more buffers than the queue was
+    created to take.
+
+--*/
+
+{
+
+    PVIRTIO_DESCRIPTOR Descriptor;
+    USHORT DescriptorIndex;
+    USHORT Flags;
+    USHORT Head;
+    ULONG Index;
+    PVIRTIO_DESCRIPTOR Table;
+
+    ASSERT(Cookie != NULL);
+
+    if ((Count == 0) || (Count > Queue->MaxSegments)) {
+        return STATUS_INVALID_PARAMETER;
+    }
+
+    if (Queue->FreeCount == 0) {
+        return STATUS_RESOURCE_IN_USE;
+    }
+
+    Head = Queue->FreeHead;
+
+    //
+    // Put multi-buffer requests in the head descriptor's indirect table so
+    // that they only use one slot in the ring.
+    //
+
+    if ((Count > 1) && (Queue->IndirectTables != NULL)) {
+        Table = (PVOID)Queue->IndirectTables + (Head * Queue->IndirectStride);
+        for (Index = 0; Index < Count; Index += 1) {
+            Flags = 0;
+            if ((Buffers[Index].Flags & VIRTIO_BUFFER_FLAG_DEVICE_WRITE) != 0) {
+                Flags |= VIRTIO_DESCRIPTOR_WRITE;
+            }
+
+            if (Index + 1 != Count) {
+                Flags |= VIRTIO_DESCRIPTOR_NEXT;
+            }
+
+            Table[Index].Address = Buffers[Index].Address;
+            Table[Index].Length = Buffers[Index].Length;
+            Table[Index].Flags = Flags;
+            Table[Index].Next = Index + 1;
+        }
+
+        Descriptor = &(Queue->Descriptors[Head]);
+        Descriptor->Address = Queue->IndirectPhysical[Head];
+        Descriptor->Length = Count * sizeof(VIRTIO_DESCRIPTOR);
+        Descriptor->Flags = VIRTIO_DESCRIPTOR_INDIRECT;
+        Queue->FreeHead = Descriptor->Next;
+        Queue->FreeCount -= 1;
+        Queue->DescriptorCounts[Head] = 1;
+
+    } else {
+        if (Count > Queue->FreeCount) {
+            return STATUS_RESOURCE_IN_USE;
+        }
+
+        DescriptorIndex = Head;
+        for (Index = 0; Index < Count; Index += 1) {
+            Descriptor = &(Queue->Descriptors[DescriptorIndex]);
+            Flags = 0;
+            if ((Buffers[Index].Flags & VIRTIO_BUFFER_FLAG_DEVICE_WRITE) != 0) {
+                Flags |= VIRTIO_DESCRIPTOR_WRITE;
+            }
+
+            if (Index + 1 != Count) {
+                Flags |= VIRTIO_DESCRIPTOR_NEXT;
+            }
+
+            Descriptor->Address = Buffers[Index].Address;
+            Descriptor->Length = Buffers[Index].Length;
+            Descriptor->Flags = Flags;
+            DescriptorIndex = Descriptor->Next;
+        }
+
+        Queue->FreeHead = DescriptorIndex;
+        Queue->FreeCount -= Count;
+        Queue->DescriptorCounts[Head] = Count;
+    }
+
+    Queue->Cookies[Head] = Cookie;
+
+    //
+    // Publish the chain in the available ring. The descriptors must be
+    // visible before the index that exposes them.
+    //
+
+    Queue->Available->Ring[Queue->NextAvailable & (Queue->Size - 1)] = Head;
+    RtlMemoryBarrier();
+    Queue->NextAvailable += 1;
+    VIRTIO_RING_INDEX(Queue->Available->Index) = Queue->NextAvailable;
+    Queue->AddedSinceNotify += 1;
+    return STATUS_SUCCESS;
+}
+
+VIRTIO_API
+VOID
+VirtioNotifyQueue (
+    PVIRTIO_QUEUE Queue
+    )
+
+/*++
+
+Routine Description:
+
+    This routine tells the device about buffers added since the last
+    notification, unless the device has asked not to be told. Batching
+    several additions before notifying saves register writes, which are
+    expensive traps in a virtual machine.
+
+Arguments:
+
+    Queue - Supplies a pointer to the queue.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    USHORT Event;
+    BOOL Kick;
+    USHORT New;
+    USHORT Old;
+
+    if (Queue->AddedSinceNotify == 0) {
+        return;
+    }
+
+    //
+    // The new available index must be visible before the device's
+    // suppression state is sampled, or a notification could be missed.
+    //
+
+    RtlMemoryBarrier();
+    New = Queue->NextAvailable;
+    Old = New - Queue->AddedSinceNotify;
+    Queue->AddedSinceNotify = 0;
+    if (Queue->EventIndex != FALSE) {
+
+        //
+        // Notify only if the index the device asked to hear about was
+        // crossed by this batch.
+        //
+
+        Event = *(Queue->AvailableEvent);
+        Kick = FALSE;
+        if ((USHORT)(New - Event - 1) < (USHORT)(New - Old)) {
+            Kick = TRUE;
+        }
+
+    } else {
+        Kick = TRUE;
+        if ((VIRTIO_RING_INDEX(Queue->Used->Flags) &
+             VIRTIO_USED_NO_NOTIFY) != 0) {
+
+            Kick = FALSE;
+        }
+    }
+
+    if (Kick != FALSE) {
+        HlWriteRegister16(Queue->NotifyAddress, Queue->Index);
+    }
+
+    return;
+}
+
+VIRTIO_API
+BOOL
+VirtioGetUsedBuffer (
+    PVIRTIO_QUEUE Queue,
+    PVOID *Cookie,
+    PULONG Length
+    )
+
+/*++
+
+Routine Description:
+
+    This routine pops a buffer chain the device has finished with off of the
+    used ring, returning its descriptors to the queue. The caller is
+    responsible for synchronizing access to the queue.
+
+Arguments:
+
+    Queue - Supplies a pointer to the queue.
+
+    Cookie - Supplies a pointer where the cookie supplied when the buffers
+        were added will be returned.
+
+    Length - Supplies a pointer where the number of bytes the device wrote
+        into the buffers will be returned.
+
+Return Value:
+
+    TRUE if a completed chain was returned.
+
+    FALSE if the used ring is empty.
+
+--*/
+
+{
+
+    ULONG Count;
+    USHORT DescriptorIndex;
+    USHORT Head;
+    ULONG Index;
+    PVIRTIO_USED_ELEMENT Used;
+
+    if (Queue->LastUsed == VIRTIO_RING_INDEX(Queue->Used->Index)) {
+        return FALSE;
+    }
+
+    //
+    // Don't read the element until the index covering it has been seen.
+    //
+
+    RtlMemoryBarrier();
+    Used = &(Queue->Used->Ring[Queue->LastUsed & (Queue->Size - 1)]);
+    Head = (USHORT)Used->Id;
+
+    ASSERT((Head < Queue->Size) && (Queue->Cookies[Head] != NULL));
+
+    *Cookie = Queue->Cookies[Head];
+    *Length = Used->Length;
+    Queue->Cookies[Head] = NULL;
+    Queue->LastUsed += 1;
+
+    //
+    // Return the chain to the front of the free list.
+    //
+
+    Count = Queue->DescriptorCounts[Head];
+    DescriptorIndex = Head;
+    for (Index = 1; Index < Count; Index += 1) {
+        DescriptorIndex = Queue->Descriptors[DescriptorIndex].Next;
+    }
+
+    Queue->Descriptors[DescriptorIndex].Next = Queue->FreeHead;
+    Queue->FreeHead = Head;
+    Queue->FreeCount += Count;
+    return TRUE;
+}
+
+VIRTIO_API
+VOID
+VirtioDisableQueueInterrupts (
+    PVIRTIO_QUEUE Queue
+    )
+
+/*++
+
+Routine Description:
+
+    This routine asks the device not to interrupt when it uses buffers. This
+    is only a hint; interrupts may still arrive.
+
+Arguments:
+
+    Queue - Supplies a pointer to the queue.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    if (Queue->InterruptsDisabled != FALSE) {
+        return;
+    }
+
+    Queue->InterruptsDisabled = TRUE;
+
+    //
+    // With event index, park the used event just behind the consumer so it
+    // will not be crossed until the ring wraps.
+    //
+
+    if (Queue->EventIndex != FALSE) {
+        *(Queue->UsedEvent) = Queue->LastUsed - 1;
+
+    } else {
+        Queue->Available->Flags |= VIRTIO_AVAILABLE_NO_INTERRUPT;
+    }
+
+    return;
+}
+
+VIRTIO_API
+BOOL
+VirtioEnableQueueInterrupts (
+    PVIRTIO_QUEUE Queue
+    )
+
+/*++
+
+Routine Description:
+
+    This routine asks the device to interrupt when it next uses buffers.
+    Callers should drain the queue again if this routine returns TRUE, since
+    buffers used before interrupts were enabled will not interrupt.
+
+Arguments:
+
+    Queue - Supplies a pointer to the queue.
+
+Return Value:
+
+    TRUE if the used ring already has entries waiting.
+
+    FALSE if the used ring is empty.
+
+--*/
+
+{
+
+    Queue->InterruptsDisabled = FALSE;
+    if (Queue->EventIndex != FALSE) {
+        *(Queue->UsedEvent) = Queue->LastUsed;
+
+    } else {
+        Queue->Available->Flags &= ~VIRTIO_AVAILABLE_NO_INTERRUPT;
+    }
+
+    //
+    // The device must see the new event before the used index is checked
+    // again, or an entry added in between could go unnoticed.
+    //
+
+    RtlMemoryBarrier();
+    if (Queue->LastUsed != VIRTIO_RING_INDEX(Queue->Used->Index)) {
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
+KSTATUS
+VirtiopInitializeQueue (
+    PVIRTIO_QUEUE Queue,
+    USHORT Size,
+    ULONG MaxSegments
+    )
+
+/*++
+
+Routine Description:
+
+    This routine allocates the rings and bookkeeping for a virtqueue.
+
+Arguments:
+
+    Queue - Supplies a pointer to the queue, whose device, index, and flags
+        are already filled in.
+
+    Size - Supplies the number of descriptors in the queue. This must be a
+        power of two.
+
+    MaxSegments - Supplies the maximum number of buffers in a single request.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    UINTN AllocationSize;
+    UINTN AvailableOffset;
+    PVOID Base;
+    ULONG Index;
+    ULONG PageSize;
+    UINTN RingSize;
+    KSTATUS Status;
+    UINTN UsedOffset;
+
+    ASSERT((Size != 0) && (POWER_OF_2(Size) != FALSE));
+
+    PageSize = MmPageSize();
+    Queue->Size = Size;
+    Queue->MaxSegments = MaxSegments;
+    if ((Queue->Device->Features & VIRTIO_FEATURE_EVENT_INDEX) != 0) {
+        Queue->EventIndex = TRUE;
+    }
+
+    //
+    // Lay the descriptor table, available ring, and used ring out back to
+    // back in one physically contiguous buffer.
+    //
+
+    AvailableOffset = Size * sizeof(VIRTIO_DESCRIPTOR);
+    UsedOffset = ALIGN_RANGE_UP(
+                          AvailableOffset + VIRTIO_AVAILABLE_RING_SIZE(Size),
+                          VIRTIO_USED_RING_ALIGNMENT);
+
+    RingSize = UsedOffset + VIRTIO_USED_RING_SIZE(Size);
+    Queue->IoBuffer = MmAllocateNonPagedIoBuffer(
+                                         0,
+                                         MAX_ULONGLONG,
+                                         PageSize,
+                                         ALIGN_RANGE_UP(RingSize, PageSize),
+                                         IO_BUFFER_FLAG_PHYSICALLY_CONTIGUOUS);
+
+    if (Queue->IoBuffer == NULL) {
+        Status = STATUS_INSUFFICIENT_RESOURCES;
+        goto InitializeQueueEnd;
+    }
+
+    ASSERT(Queue->IoBuffer->FragmentCount == 1);
+
+    Base = Queue->IoBuffer->Fragment[0].VirtualAddress;
+    RtlZeroMemory(Base, RingSize);
+    Queue->Descriptors = Base;
+    Queue->Available = Base + AvailableOffset;
+    Queue->Used = Base + UsedOffset;
+    Queue->UsedEvent = (PVOID)Queue->Available +
+                       FIELD_OFFSET(VIRTIO_AVAILABLE_RING, Ring) +
+                       (Size * sizeof(USHORT));
+
+    Queue->AvailableEvent = (PVOID)Queue->Used +
+                            FIELD_OFFSET(VIRTIO_USED_RING, Ring) +
+                            (Size * sizeof(VIRTIO_USED_ELEMENT));
+
+    AllocationSize = Size * (sizeof(PVOID) + sizeof(USHORT));
+    Queue->Cookies = MmAllocateNonPagedPool(AllocationSize,
+                                            VIRTIO_ALLOCATION_TAG);
+
+    if (Queue->Cookies == NULL) {
+        Status = STATUS_INSUFFICIENT_RESOURCES;
+        goto InitializeQueueEnd;
+    }
+
+    RtlZeroMemory(Queue->Cookies, AllocationSize);
+    Queue->DescriptorCounts = (PUSHORT)(Queue->Cookies + Size);
+
+    //
+    // Chain every descriptor onto the free list.
+    //
+
+    for (Index = 0; Index < Size; Index += 1) {
+        Queue->Descriptors[Index].Next = Index + 1;
+    }
+
+    Queue->FreeHead = 0;
+    Queue->FreeCount = Size;
+    if ((MaxSegments > 1) &&
+        ((Queue->Device->Features &
+          VIRTIO_FEATURE_INDIRECT_DESCRIPTORS) != 0)) {
+
+        Status = VirtiopInitializeIndirectTables(Queue);
+        if (!KSUCCESS(Status)) {
+            goto InitializeQueueEnd;
+        }
+    }
+
+    //
+    // Without indirect tables a request takes a descriptor per buffer, and
+    // can never use more than the whole ring.
+    //
+
+    if ((Queue->IndirectTables == NULL) && (Queue->MaxSegments > Size)) {
+        Queue->MaxSegments = Size;
+    }
+
+    Status = STATUS_SUCCESS;
+
+InitializeQueueEnd:
+    return Status;
+}
+
+VOID
+VirtiopDestroyQueue (
+    PVIRTIO_QUEUE Queue
+    )
+
+/*++
+
+Routine Description:
+
+    This routine destroys a virtqueue. The device must have been reset or the
+    queue never enabled.
+
+Arguments:
+
+    Queue - Supplies a pointer to the queue, which may be partially
+        initialized.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    if (Queue->IndirectPhysical != NULL) {
+        MmFreeNonPagedPool(Queue->IndirectPhysical);
+    }
+
+    if (Queue->IndirectIoBuffer != NULL) {
+        MmFreeIoBuffer(Queue->IndirectIoBuffer);
+    }
+
+    if (Queue->Cookies != NULL) {
+        MmFreeNonPagedPool(Queue->Cookies);
+    }
+
+    if (Queue->IoBuffer != NULL) {
+        MmFreeIoBuffer(Queue->IoBuffer);
+    }
+
+    MmFreeNonPagedPool(Queue);
+    return;
+}
+
+PHYSICAL_ADDRESS
+VirtiopGetQueueDescriptorsAddress (
+    PVIRTIO_QUEUE Queue
+    )
+
+/*++
+
+Routine Description:
+
+    This routine returns the physical address of a queue's descriptor table.
+
+Arguments:
+
+    Queue - Supplies a pointer to the queue.
+
+Return Value:
+
+    Returns the physical address of the descriptor table.
+
+--*/
+
+{
+
+    return Queue->IoBuffer->Fragment[0].PhysicalAddress;
+}
+
+PHYSICAL_ADDRESS
+VirtiopGetQueueAvailableAddress (
+    PVIRTIO_QUEUE Queue
+    )
+
+/*++
+
+Routine Description:
+
+    This routine returns the physical address of a queue's available ring.
+
+Arguments:
+
+    Queue - Supplies a pointer to the queue.
+
+Return Value:
+
+    Returns the physical address of the available ring.
+
+--*/
+
+{
+
+    UINTN Offset;
+
+    Offset = (PVOID)Queue->Available - (PVOID)Queue->Descriptors;
+    return Queue->IoBuffer->Fragment[0].PhysicalAddress + Offset;
+}
+
+PHYSICAL_ADDRESS
+VirtiopGetQueueUsedAddress (
+    PVIRTIO_QUEUE Queue
+    )
+
+/*++
+
+Routine Description:
+
+    This routine returns the physical address of a queue's used ring.
+
+Arguments:
+
+    Queue - Supplies a pointer to the queue.
+
+Return Value:
+
+    Returns the physical address of the used ring.
+
+--*/
+
+{
+
+    UINTN Offset;
+
+    Offset = (PVOID)Queue->Used - (PVOID)Queue->Descriptors;
+    return Queue->IoBuffer->Fragment[0].PhysicalAddress + Offset;
+}
+
+//
+// --------------------------------------------------------- Internal Functions
+//
+
+KSTATUS
+VirtiopInitializeIndirectTables (
+    PVIRTIO_QUEUE Queue
+    )
+
+/*++
+
+Routine Description:
+
+    This routine allocates an indirect descriptor table for each descriptor
+    in the queue. Tables are sized to a power of two so that none of them
+    straddles a page, letting the backing memory be discontiguous.
+
+Arguments:
+
+    Queue - Supplies a pointer to the queue.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    UINTN AllocationSize;
+    ULONG Index;
+    ULONG PageSize;
+    ULONG Stride;
+
+    PageSize = MmPageSize();
+    Stride = VIRTIO_DESCRIPTOR_ALIGNMENT;
+    while (Stride < Queue->MaxSegments * sizeof(VIRTIO_DESCRIPTOR)) {
+        Stride <<= 1;
+    }
+
+    if (Stride > PageSize) {
+        return STATUS_INVALID_PARAMETER;
+    }
+
+    AllocationSize = Queue->Size * sizeof(PHYSICAL_ADDRESS);
+    Queue->IndirectPhysical = MmAllocateNonPagedPool(AllocationSize,
+                                                     VIRTIO_ALLOCATION_TAG);
+
+    if (Queue->IndirectPhysical == NULL) {
+        return STATUS_INSUFFICIENT_RESOURCES;
+    }
+
+    AllocationSize = ALIGN_RANGE_UP(Queue->Size * Stride, PageSize);
+    Queue->IndirectIoBuffer = MmAllocateNonPagedIoBuffer(0,
+                                                         MAX_ULONGLONG,
+                                                         PageSize,
+                                                         AllocationSize,
+                                                         0);
+
+    if (Queue->IndirectIoBuffer == NULL) {
+        return STATUS_INSUFFICIENT_RESOURCES;
+    }
+
+    for (Index = 0; Index < Queue->Size; Index += 1) {
+        Queue->IndirectPhysical[Index] = MmGetIoBufferPhysicalAddress(
+                                                      Queue->IndirectIoBuffer,
+                                                      Index * Stride);
+    }
+
+    Queue->IndirectTables = Queue->IndirectIoBuffer->Fragment[0].VirtualAddress;
+    Queue->IndirectStride = Stride;
+    return STATUS_SUCCESS;
+}
@@ -0,0 +1,1661 @@
+/*++
+
+Copyright (c) 2026 Minoca Corp.
+
+    This file is licensed under the terms of the GNU General Public License
+    version 3. Alternative licensing terms are available. Contact
+    info@minocacorp.com for details. See the LICENSE file at the root of this
+    project for complete licensing information.
+
+Module Name:
+
+    vionet.c
+
+Abstract:
+
+    This module implements the virtio network device driver. Each processor
+    gets its own receive and transmit queue pair when the device offers
+    enough of them.
+
+Author:
+
+    Minoca Corp. 18-Oct-2026
+
+Environment:
+
+    Kernel
+
+--*/
+
+//
+// ------------------------------------------------------------------- Includes
+//
+
+#include <minoca/kernel/driver.h>
+#include <minoca/net/netdrv.h>
+#include "vionet.h"
+
+//
+// --------------------------------------------------------------------- Macros
+//
+
+//
+// ---------------------------------------------------------------- Definitions
+//
+
+//
+// ------------------------------------------------------ Data Type Definitions
+//
+
+//
+// ----------------------------------------------- Internal Function Prototypes
+//
+
+KSTATUS
+VionetAddDevice (
+    PVOID Driver,
+    PCSTR DeviceId,
+    PCSTR ClassId,
+    PCSTR CompatibleIds,
+    PVOID DeviceToken
+    );
+
+VOID
+VionetDispatchStateChange (
+    PIRP Irp,
+    PVOID DeviceContext,
+    PVOID IrpContext
+    );
+
+VOID
+VionetDispatchOpen (
+    PIRP Irp,
+    PVOID DeviceContext,
+    PVOID IrpContext
+    );
+
+VOID
+VionetDispatchClose (
+    PIRP Irp,
+    PVOID DeviceContext,
+    PVOID IrpContext
+    );
+
+VOID
+VionetDispatchIo (
+    PIRP Irp,
+    PVOID DeviceContext,
+    PVOID IrpContext
+    );
+
+VOID
+VionetDispatchSystemControl (
+    PIRP Irp,
+    PVOID DeviceContext,
+    PVOID IrpContext
+    );
+
+KSTATUS
+VionetSend (
+    PVOID DeviceContext,
+    PNET_PACKET_LIST PacketList
+    );
+
+KSTATUS
+VionetGetSetInformation (
+    PVOID DeviceContext,
+    NET_LINK_INFORMATION_TYPE InformationType,
+    PVOID Data,
+    PUINTN DataSize,
+    BOOL Set
+    );
+
+VOID
+VionetDestroyLink (
+    PVOID DeviceContext
+    );
+
+KSTATUS
+VionetpStartDevice (
+    PIRP Irp,
+    PVIONET_DEVICE Device
+    );
+
+KSTATUS
+VionetpReadConfiguration (
+    PVIONET_DEVICE Device
+    );
+
+KSTATUS
+VionetpCreateQueues (
+    PVIONET_DEVICE Device
+    );
+
+KSTATUS
+VionetpAddNetworkDevice (
+    PVIONET_DEVICE Device
+    );
+
+KSTATUS
+VionetpFillReceiveQueue (
+    PVIONET_QUEUE_PAIR Pair
+    );
+
+VOID
+VionetpServiceReceiveQueue (
+    PVOID Context,
+    PVIRTIO_QUEUE Queue
+    );
+
+VOID
+VionetpServiceTransmitQueue (
+    PVOID Context,
+    PVIRTIO_QUEUE Queue
+    );
+
+VOID
+VionetpReapTransmittedPackets (
+    PVIONET_QUEUE_PAIR Pair
+    );
+
+VOID
+VionetpSendPendingPackets (
+    PVIONET_QUEUE_PAIR Pair
+    );
+
+VOID
+VionetpConfigurationChange (
+    PVOID Context
+    );
+
+VOID
+VionetpUpdateLinkState (
+    PVIONET_DEVICE Device
+    );
+
+KSTATUS
+VionetpSendControlCommand (
+    PVIONET_DEVICE Device,
+    UCHAR Class,
+    UCHAR Command,
+    PVOID Data,
+    ULONG DataSize
+    );
+
+//
+// -------------------------------------------------------------------- Globals
+//
+
+PDRIVER VionetDriver = NULL;
+
+//
+// ------------------------------------------------------------------ Functions
+//
+
+__USED
+KSTATUS
+DriverEntry (
+    PDRIVER Driver
+    )
+
+/*++
+
+Routine Description:
+
+    This routine is the entry point for the virtio network driver. It
+    registers its other dispatch functions, and performs driver-wide
+    initialization.
+
+Arguments:
+
+    Driver - Supplies a pointer to the driver object.
+
+Return Value:
+
+    STATUS_SUCCESS on success.
+
+    Failure code on error.
+
+--*/
+
+{
+
+    DRIVER_FUNCTION_TABLE FunctionTable;
+    KSTATUS Status;
+
+    VionetDriver = Driver;
+    RtlZeroMemory(&FunctionTable, sizeof(DRIVER_FUNCTION_TABLE));
+    FunctionTable.Version = DRIVER_FUNCTION_TABLE_VERSION;
+    FunctionTable.AddDevice = VionetAddDevice;
+    FunctionTable.DispatchStateChange = VionetDispatchStateChange;
+    FunctionTable.DispatchOpen = VionetDispatchOpen;
+    FunctionTable.DispatchClose = VionetDispatchClose;
+    FunctionTable.DispatchIo = VionetDispatchIo;
+    FunctionTable.DispatchSystemControl = VionetDispatchSystemControl;
+    Status = IoRegisterDriverFunctions(Driver, &FunctionTable);
+    return Status;
+}
+
+KSTATUS
+VionetAddDevice (
+    PVOID Driver,
+    PCSTR DeviceId,
+    PCSTR ClassId,
+    PCSTR CompatibleIds,
+    PVOID DeviceToken
+    )
+
+/*++
+
+Routine Description:
+
+    This routine is called when a device is detected for which the virtio
+    network driver acts as the function driver. The driver will attach itself
+    to the stack.
+
+Arguments:
+
+    Driver - Supplies a pointer to the driver being called.
+
+    DeviceId - Supplies a pointer to a string with the device ID.
+
+    ClassId - Supplies a pointer to a string containing the device's class ID.
+
+    CompatibleIds - Supplies a pointer to a string containing device IDs
+        that would be compatible with this device.
+
+    DeviceToken - Supplies an opaque token that the driver can use to identify
+        the device in the system. This token should be used when attaching to
+        the stack.
+
+Return Value:
+
+    STATUS_SUCCESS on success.
+
+    Failure code if the driver was unsuccessful in attaching itself.
+
+--*/
+
+{
+
+    PVIONET_DEVICE Device;
+    VIRTIO_DEVICE_PARAMETERS Parameters;
+    KSTATUS Status;
+
+    Device = MmAllocateNonPagedPool(sizeof(VIONET_DEVICE),
+                                    VIONET_ALLOCATION_TAG);
+
+    if (Device == NULL) {
+        Status = STATUS_INSUFFICIENT_RESOURCES;
+        goto AddDeviceEnd;
+    }
+
+    RtlZeroMemory(Device, sizeof(VIONET_DEVICE));
+    Device->OsDevice = DeviceToken;
+    Device->ConfigurationLock = KeCreateQueuedLock();
+    if (Device->ConfigurationLock == NULL) {
+        Status = STATUS_INSUFFICIENT_RESOURCES;
+        goto AddDeviceEnd;
+    }
+
+    RtlZeroMemory(&Parameters, sizeof(VIRTIO_DEVICE_PARAMETERS));
+    Parameters.Version = VIRTIO_DEVICE_PARAMETERS_VERSION;
+    Parameters.OsDevice = DeviceToken;
+    Parameters.DriverFeatures = VIONET_DRIVER_FEATURES;
+    Parameters.ConfigurationChangeRoutine = VionetpConfigurationChange;
+    Parameters.Context = Device;
+    Status = VirtioCreateDevice(&Parameters, &(Device->Virtio));
+    if (!KSUCCESS(Status)) {
+        goto AddDeviceEnd;
+    }
+
+    Status = IoAttachDriverToDevice(Driver, DeviceToken, Device);
+    if (!KSUCCESS(Status)) {
+        goto AddDeviceEnd;
+    }
+
+AddDeviceEnd:
+    if (!KSUCCESS(Status)) {
+        if (Device != NULL) {
+            if (Device->Virtio != NULL) {
+                VirtioDestroyDevice(Device->Virtio);
+            }
+
+            if (Device->ConfigurationLock != NULL) {
+                KeDestroyQueuedLock(Device->ConfigurationLock);
+            }
+
+            MmFreeNonPagedPool(Device);
+        }
+    }
+
+    return Status;
+}
+
+VOID
+VionetDispatchStateChange (
+    PIRP Irp,
+    PVOID DeviceContext,
+    PVOID IrpContext
+    )
+
+/*++
+
+Routine Description:
+
+    This routine handles State Change IRPs.
+
+Arguments:
+
+    Irp - Supplies a pointer to the I/O request packet.
+
+    DeviceContext - Supplies the context pointer supplied by the driver when it
+        attached itself to the driver stack. Presumably this pointer contains
+        driver-specific device context.
+
+    IrpContext - Supplies the context pointer supplied by the driver when
+        the IRP was created.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PVIONET_DEVICE Device;
+    KSTATUS Status;
+
+    ASSERT(Irp->MajorCode == IrpMajorStateChange);
+
+    Device = DeviceContext;
+    if (Irp->Direction == IrpUp) {
+        if (!KSUCCESS(IoGetIrpStatus(Irp))) {
+            return;
+        }
+
+        switch (Irp->MinorCode) {
+        case IrpMinorQueryResources:
+            Status = VirtioProcessResourceRequirements(Device->Virtio, Irp);
+            if (!KSUCCESS(Status)) {
+                IoCompleteIrp(VionetDriver, Irp, Status);
+            }
+
+            break;
+
+        case IrpMinorStartDevice:
+            Status = VionetpStartDevice(Irp, Device);
+            if (!KSUCCESS(Status)) {
+                IoCompleteIrp(VionetDriver, Irp, Status);
+            }
+
+            break;
+
+        default:
+            break;
+        }
+    }
+
+    return;
+}
+
+VOID
+VionetDispatchOpen (
+    PIRP Irp,
+    PVOID DeviceContext,
+    PVOID IrpContext
+    )
+
+/*++
+
+Routine Description:
+
+    This routine handles Open IRPs.
+
+Arguments:
+
+    Irp - Supplies a pointer to the I/O request packet.
+
+    DeviceContext - Supplies the context pointer supplied by the driver when it
+        attached itself to the driver stack. Presumably this pointer contains
+        driver-specific device context.
+
+    IrpContext - Supplies the context pointer supplied by the driver when
+        the IRP was created.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    return;
+}
+
+VOID
+VionetDispatchClose (
+    PIRP Irp,
+    PVOID DeviceContext,
+    PVOID IrpContext
+    )
+
+/*++
+
+Routine Description:
+
+    This routine handles Close IRPs.
+
+Arguments:
+
+    Irp - Supplies a pointer to the I/O request packet.
+
+    DeviceContext - Supplies the context pointer supplied by the driver when it
+        attached itself to the driver stack. Presumably this pointer contains
+        driver-specific device context.
+
+    IrpContext - Supplies the context pointer supplied by the driver when
+        the IRP was created.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    return;
+}
+
+VOID
+VionetDispatchIo (
+    PIRP Irp,
+    PVOID DeviceContext,
+    PVOID IrpContext
+    )
+
+/*++
+
+Routine Description:
+
+    This routine handles I/O IRPs.
+
+Arguments:
+
+    Irp - Supplies a pointer to the I/O request packet.
+
+    DeviceContext - Supplies the context pointer supplied by the driver when it
+        attached itself to the driver stack. Presumably this pointer contains
+        driver-specific device context.
+
+    IrpContext - Supplies the context pointer supplied by the driver when
+        the IRP was created.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    return;
+}
+
+VOID
+VionetDispatchSystemControl (
+    PIRP Irp,
+    PVOID DeviceContext,
+    PVOID IrpContext
+    )
+
+/*++
+
+Routine Description:
+
+    This routine handles System Control IRPs.
+
+Arguments:
+
+    Irp - Supplies a pointer to the I/O request packet.
+
+    DeviceContext - Supplies the context pointer supplied by the driver when it
+        attached itself to the driver stack. Presumably this pointer contains
+        driver-specific device context.
+
+    IrpContext - Supplies the context pointer supplied by the driver when
+        the IRP was created.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PVIONET_DEVICE Device;
+    PSYSTEM_CONTROL_DEVICE_INFORMATION DeviceInformationRequest;
+    KSTATUS Status;
+
+    ASSERT(Irp->MajorCode == IrpMajorSystemControl);
+
+    Device = DeviceContext;
+    if (Irp->Direction == IrpDown) {
+        switch (Irp->MinorCode) {
+        case IrpMinorSystemControlDeviceInformation:
+            DeviceInformationRequest = Irp->U.SystemControl.SystemContext;
+            Status = NetGetSetLinkDeviceInformation(
+                                         Device->NetworkLink,
+                                         &(DeviceInformationRequest->Uuid),
+                                         DeviceInformationRequest->Data,
+                                         &(DeviceInformationRequest->DataSize),
+                                         DeviceInformationRequest->Set);
+
+            IoCompleteIrp(VionetDriver, Irp, Status);
+            break;
+
+        default:
+            break;
+        }
+    }
+
+    return;
+}
+
+KSTATUS
+VionetSend (
+    PVOID DeviceContext,
+    PNET_PACKET_LIST PacketList
+    )
+
+/*++
+
+Routine Description:
+
+    This routine sends data through the network, using the current
+    processor's transmit queue.
+
+Arguments:
+
+    DeviceContext - Supplies a pointer to the device context associated with
+        the link down which this data is to be sent.
+
+    PacketList - Supplies a pointer to a list of network packets to send. Data
+        in these packets may be modified by this routine, but must not be used
+        once this routine returns.
+
+Return Value:
+
+    STATUS_SUCCESS if all packets were sent.
+
+    STATUS_RESOURCE_IN_USE if some or all of the packets were dropped due to
+    the hardware being backed up with too many packets to send.
+
+    Other failure codes indicate that none of the packets were sent.
+
+--*/
+
+{
+
+    UINTN Count;
+    PVIONET_DEVICE Device;
+    PVIONET_QUEUE_PAIR Pair;
+    ULONG PairIndex;
+    KSTATUS Status;
+
+    ASSERT(KeGetRunLevel() == RunLevelLow);
+
+    Device = (PVIONET_DEVICE)DeviceContext;
+    PairIndex = KeGetCurrentProcessorNumber() % Device->PairCount;
+    Pair = &(Device->Pairs[PairIndex]);
+    KeAcquireQueuedLock(Pair->TransmitLock);
+    if (Device->LinkUp == FALSE) {
+        Status = STATUS_NO_NETWORK_CONNECTION;
+        goto SendEnd;
+    }
+
+    //
+    // Free up whatever the device is done with before deciding whether
+    // there is room.
+    //
+
+    VionetpReapTransmittedPackets(Pair);
+    Count = Pair->TransmitPacketList.Count;
+    if (Count < VIONET_MAX_TRANSMIT_PACKET_LIST_COUNT) {
+        NET_APPEND_PACKET_LIST(PacketList, &(Pair->TransmitPacketList));
+        VionetpSendPendingPackets(Pair);
+        Status = STATUS_SUCCESS;
+
+    } else {
+        Status = STATUS_RESOURCE_IN_USE;
+    }
+
+SendEnd:
+    KeReleaseQueuedLock(Pair->TransmitLock);
+    return Status;
+}
+
+KSTATUS
+VionetGetSetInformation (
+    PVOID DeviceContext,
+    NET_LINK_INFORMATION_TYPE InformationType,
+    PVOID Data,
+    PUINTN DataSize,
+    BOOL Set
+    )
+
+/*++
+
+Routine Description:
+
+    This routine gets or sets the network device layer's link information.
+
+Arguments:
+
+    DeviceContext - Supplies a pointer to the device context associated with
+        the link for which information is being set or queried.
+
+    InformationType - Supplies the type of information being queried or set.
+
+    Data - Supplies a pointer to the data buffer where the data is either
+        returned for a get operation or given for a set operation.
+
+    DataSize - Supplies a pointer that on input contains the size of the data
+        buffer. On output, contains the required size of the data buffer.
+
+    Set - Supplies a boolean indicating if this is a get operation (FALSE) or a
+        set operation (TRUE).
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    PULONG BooleanOption;
+    ULONG Capability;
+    UCHAR Command;
+    PVIONET_DEVICE Device;
+    PULONG Flags;
+    UCHAR OnOff;
+    KSTATUS Status;
+
+    Device = (PVIONET_DEVICE)DeviceContext;
+    switch (InformationType) {
+    case NetLinkInformationChecksumOffload:
+        if (*DataSize != sizeof(ULONG)) {
+            return STATUS_INVALID_PARAMETER;
+        }
+
+        if (Set != FALSE) {
+            return STATUS_NOT_SUPPORTED;
+        }
+
+        Flags = (PULONG)Data;
+        *Flags = Device->EnabledCapabilities &
+                 NET_LINK_CAPABILITY_CHECKSUM_MASK;
+
+        Status = STATUS_SUCCESS;
+        break;
+
+    case NetLinkInformationMulticastAll:
+    case NetLinkInformationPromiscuousMode:
+        if (*DataSize != sizeof(ULONG)) {
+            Status = STATUS_INVALID_PARAMETER;
+            break;
+        }
+
+        Capability = NET_LINK_CAPABILITY_PROMISCUOUS_MODE;
+        Command = VIONET_CONTROL_RX_PROMISCUOUS;
+        if (InformationType == NetLinkInformationMulticastAll) {
+            Capability = NET_LINK_CAPABILITY_MULTICAST_ALL;
+            Command = VIONET_CONTROL_RX_ALL_MULTICAST;
+        }
+
+        Status = STATUS_SUCCESS;
+        BooleanOption = (PULONG)Data;
+        if (Set == FALSE) {
+            if ((Device->EnabledCapabilities & Capability) != 0) {
+                *BooleanOption = TRUE;
+
+            } else {
+                *BooleanOption = FALSE;
+            }
+
+            break;
+        }
+
+        //
+        // Fail if the capability is not supported.
+        //
+
+        if ((Device->SupportedCapabilities & Capability) == 0) {
+            Status = STATUS_NOT_SUPPORTED;
+            break;
+        }
+
+        OnOff = FALSE;
+        if (*BooleanOption != FALSE) {
+            OnOff = TRUE;
+        }
+
+        KeAcquireQueuedLock(Device->ConfigurationLock);
+        Status = VionetpSendControlCommand(Device,
+                                           VIONET_CONTROL_CLASS_RX,
+                                           Command,
+                                           &OnOff,
+                                           sizeof(UCHAR));
+
+        if (KSUCCESS(Status)) {
+            if (OnOff != FALSE) {
+                Device->EnabledCapabilities |= Capability;
+
+            } else {
+                Device->EnabledCapabilities &= ~Capability;
+            }
+        }
+
+        KeReleaseQueuedLock(Device->ConfigurationLock);
+        break;
+
+    default:
+        Status = STATUS_NOT_SUPPORTED;
+        break;
+    }
+
+    return Status;
+}
+
+VOID
+VionetDestroyLink (
+    PVOID DeviceContext
+    )
+
+/*++
+
+Routine Description:
+
+    This routine notifies the device layer that the networking core is in the
+    process of destroying the link and will no longer call into the device for
+    this link. This allows the device layer to release any context that was
+    supporting the device link interface.
+
+Arguments:
+
+    DeviceContext - Supplies a pointer to the device context associated with
+        the link being destroyed.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    return;
+}
+
+//
+// --------------------------------------------------------- Internal Functions
+//
+
+KSTATUS
+VionetpStartDevice (
+    PIRP Irp,
+    PVIONET_DEVICE Device
+    )
+
+/*++
+
+Routine Description:
+
+    This routine starts the virtio network device.
+
+Arguments:
+
+    Irp - Supplies a pointer to the start IRP.
+
+    Device - Supplies a pointer to the device information.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    ULONG PairIndex;
+    USHORT PairCount;
+    KSTATUS Status;
+
+    if (Device->Started != FALSE) {
+        return STATUS_SUCCESS;
+    }
+
+    Status = VirtioStartDevice(Device->Virtio, Irp);
+    if (!KSUCCESS(Status)) {
+        goto StartDeviceEnd;
+    }
+
+    Status = VionetpReadConfiguration(Device);
+    if (!KSUCCESS(Status)) {
+        goto StartDeviceEnd;
+    }
+
+    Status = VionetpCreateQueues(Device);
+    if (!KSUCCESS(Status)) {
+        goto StartDeviceEnd;
+    }
+
+    Status = VionetpAddNetworkDevice(Device);
+    if (!KSUCCESS(Status)) {
+        goto StartDeviceEnd;
+    }
+
+    Status = VirtioEnableDevice(Device->Virtio);
+    if (!KSUCCESS(Status)) {
+        goto StartDeviceEnd;
+    }
+
+    for (PairIndex = 0; PairIndex < Device->PairCount; PairIndex += 1) {
+        Status = VionetpFillReceiveQueue(&(Device->Pairs[PairIndex]));
+        if (!KSUCCESS(Status)) {
+            goto StartDeviceEnd;
+        }
+    }
+
+    //
+    // Turn on the extra queue pairs. If the device refuses, get by with
+    // just the first.
+    //
+
+    if (Device->PairCount > 1) {
+        PairCount = Device->PairCount;
+        KeAcquireQueuedLock(Device->ConfigurationLock);
+        Status = VionetpSendControlCommand(
+                                        Device,
+                                        VIONET_CONTROL_CLASS_MULTI_QUEUE,
+                                        VIONET_CONTROL_MULTI_QUEUE_SET_PAIRS,
+                                        &PairCount,
+                                        sizeof(USHORT));
+
+        KeReleaseQueuedLock(Device->ConfigurationLock);
+        if (!KSUCCESS(Status)) {
+            RtlDebugPrint("Vionet: Failed to enable %d queues: %d\n",
+                          Device->PairCount,
+                          Status);
+
+            Device->PairCount = 1;
+        }
+    }
+
+    Device->Started = TRUE;
+    VionetpUpdateLinkState(Device);
+    Status = STATUS_SUCCESS;
+
+StartDeviceEnd:
+    if (!KSUCCESS(Status)) {
+        RtlDebugPrint("Vionet: Failed to start: %d\n", Status);
+    }
+
+    return Status;
+}
+
+KSTATUS
+VionetpReadConfiguration (
+    PVIONET_DEVICE Device
+    )
+
+/*++
+
+Routine Description:
+
+    This routine reads the network device's address and queue limits.
+
+Arguments:
+
+    Device - Supplies a pointer to the device.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    USHORT MaxPairs;
+    ULONGLONG Seed;
+    KSTATUS Status;
+
+    Device->Features = VirtioGetFeatures(Device->Virtio);
+    if ((Device->Features & VIONET_FEATURE_MAC) != 0) {
+        Status = VirtioReadConfiguration(Device->Virtio,
+                                         VIONET_CONFIGURATION_MAC,
+                                         Device->MacAddress,
+                                         ETHERNET_ADDRESS_SIZE);
+
+        if (!KSUCCESS(Status)) {
+            return Status;
+        }
+
+    //
+    // Make up a locally administered address if the device has none.
+    //
+
+    } else {
+        Seed = HlQueryTimeCounter();
+        RtlCopyMemory(Device->MacAddress, &Seed, ETHERNET_ADDRESS_SIZE);
+        Device->MacAddress[0] &= ~0x01;
+        Device->MacAddress[0] |= 0x02;
+    }
+
+    //
+    // Multiple queue pairs need the control queue to turn them on.
+    //
+
+    MaxPairs = 1;
+    if (((Device->Features & VIONET_FEATURE_MULTI_QUEUE) != 0) &&
+        ((Device->Features & VIONET_FEATURE_CONTROL_QUEUE) != 0)) {
+
+        Status = VirtioReadConfiguration(Device->Virtio,
+                                         VIONET_CONFIGURATION_MAX_PAIRS,
+                                         &MaxPairs,
+                                         sizeof(USHORT));
+
+        if (!KSUCCESS(Status)) {
+            return Status;
+        }
+
+        if (MaxPairs == 0) {
+            MaxPairs = 1;
+        }
+    }
+
+    Device->MaxPairCount = MaxPairs;
+    Device->PairCount = MaxPairs;
+    if (Device->PairCount > KeGetActiveProcessorCount()) {
+        Device->PairCount = KeGetActiveProcessorCount();
+    }
+
+    Device->SupportedCapabilities = 0;
+    if ((Device->Features & VIONET_FEATURE_GUEST_CHECKSUM) != 0) {
+        Device->SupportedCapabilities |=
+                              NET_LINK_CAPABILITY_RECEIVE_TCP_CHECKSUM_OFFLOAD |
+                              NET_LINK_CAPABILITY_RECEIVE_UDP_CHECKSUM_OFFLOAD;
+    }
+
+    if (((Device->Features & VIONET_FEATURE_CONTROL_QUEUE) != 0) &&
+        ((Device->Features & VIONET_FEATURE_CONTROL_RX) != 0)) {
+
+        Device->SupportedCapabilities |= NET_LINK_CAPABILITY_PROMISCUOUS_MODE |
+                                         NET_LINK_CAPABILITY_MULTICAST_ALL;
+    }
+
+    Device->EnabledCapabilities = Device->SupportedCapabilities &
+                                  NET_LINK_CAPABILITY_CHECKSUM_MASK;
+
+    return STATUS_SUCCESS;
+}
+
+KSTATUS
+VionetpCreateQueues (
+    PVIONET_DEVICE Device
+    )
+
+/*++
+
+Routine Description:
+
+    This routine creates the queue pairs and the control queue.
+
+Arguments:
+
+    Device - Supplies a pointer to the device.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    UINTN AllocationSize;
+    USHORT ControlIndex;
+    PVIONET_QUEUE_PAIR Pair;
+    ULONG PairIndex;
+    VIRTIO_QUEUE_PARAMETERS Parameters;
+    KSTATUS Status;
+
+    AllocationSize = Device->PairCount * sizeof(VIONET_QUEUE_PAIR);
+    Device->Pairs = MmAllocateNonPagedPool(AllocationSize,
+                                           VIONET_ALLOCATION_TAG);
+
+    if (Device->Pairs == NULL) {
+        return STATUS_INSUFFICIENT_RESOURCES;
+    }
+
+    RtlZeroMemory(Device->Pairs, AllocationSize);
+    RtlZeroMemory(&Parameters, sizeof(VIRTIO_QUEUE_PARAMETERS));
+    Parameters.Version = VIRTIO_QUEUE_PARAMETERS_VERSION;
+    Parameters.MaxSize = VIONET_MAX_QUEUE_SIZE;
+    Parameters.MaxSegments = 1;
+    Parameters.Flags = VIRTIO_QUEUE_FLAG_LOW_LEVEL;
+    for (PairIndex = 0; PairIndex < Device->PairCount; PairIndex += 1) {
+        Pair = &(Device->Pairs[PairIndex]);
+        Pair->Device = Device;
+        NET_INITIALIZE_PACKET_LIST(&(Pair->TransmitPacketList));
+        Pair->ReceiveLock = KeCreateQueuedLock();
+        Pair->TransmitLock = KeCreateQueuedLock();
+        if ((Pair->ReceiveLock == NULL) || (Pair->TransmitLock == NULL)) {
+            return STATUS_INSUFFICIENT_RESOURCES;
+        }
+
+        //
+        // Both queues of a pair interrupt the processor that uses them.
+        //
+
+        Parameters.Processor = PairIndex;
+        Parameters.Context = Pair;
+        Parameters.Index = PairIndex * 2;
+        Parameters.ServiceRoutine = VionetpServiceReceiveQueue;
+        Status = VirtioCreateQueue(Device->Virtio,
+                                   &Parameters,
+                                   &(Pair->ReceiveQueue));
+
+        if (!KSUCCESS(Status)) {
+            return Status;
+        }
+
+        Parameters.Index = (PairIndex * 2) + 1;
+        Parameters.ServiceRoutine = VionetpServiceTransmitQueue;
+        Status = VirtioCreateQueue(Device->Virtio,
+                                   &Parameters,
+                                   &(Pair->TransmitQueue));
+
+        if (!KSUCCESS(Status)) {
+            return Status;
+        }
+    }
+
+    if ((Device->Features & VIONET_FEATURE_CONTROL_QUEUE) == 0) {
+        return STATUS_SUCCESS;
+    }
+
+    //
+    // The control queue comes after every queue pair the device has, used or
+    // not. It is polled, so it has no service routine.
+    //
+
+    ControlIndex = 2;
+    if ((Device->Features & VIONET_FEATURE_MULTI_QUEUE) != 0) {
+        ControlIndex = Device->MaxPairCount * 2;
+    }
+
+    RtlZeroMemory(&Parameters, sizeof(VIRTIO_QUEUE_PARAMETERS));
+    Parameters.Version = VIRTIO_QUEUE_PARAMETERS_VERSION;
+    Parameters.Index = ControlIndex;
+    Parameters.MaxSize = VIONET_CONTROL_QUEUE_SIZE;
+    Parameters.MaxSegments = 3;
+    Status = VirtioCreateQueue(Device->Virtio,
+                               &Parameters,
+                               &(Device->ControlQueue));
+
+    if (!KSUCCESS(Status)) {
+        return Status;
+    }
+
+    Device->ControlIoBuffer = MmAllocateNonPagedIoBuffer(
+                                         0,
+                                         MAX_ULONGLONG,
+                                         MmPageSize(),
+                                         MmPageSize(),
+                                         IO_BUFFER_FLAG_PHYSICALLY_CONTIGUOUS);
+
+    if (Device->ControlIoBuffer == NULL) {
+        return STATUS_INSUFFICIENT_RESOURCES;
+    }
+
+    return STATUS_SUCCESS;
+}
+
+KSTATUS
+VionetpAddNetworkDevice (
+    PVIONET_DEVICE Device
+    )
+
+/*++
+
+Routine Description:
+
+    This routine adds the device to core networking's available links.
+
+Arguments:
+
+    Device - Supplies a pointer to the device to add.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    NET_LINK_PROPERTIES Properties;
+    KSTATUS Status;
+
+    if (Device->NetworkLink != NULL) {
+        return STATUS_SUCCESS;
+    }
+
+    RtlZeroMemory(&Properties, sizeof(NET_LINK_PROPERTIES));
+    Properties.Version = NET_LINK_PROPERTIES_VERSION;
+    Properties.TransmitAlignment = 1;
+    Properties.Device = Device->OsDevice;
+    Properties.DeviceContext = Device;
+    Properties.PacketSizeInformation.MaxPacketSize = VIONET_MAX_PACKET_SIZE;
+    Properties.PacketSizeInformation.HeaderSize =
+                                                 sizeof(VIONET_PACKET_HEADER);
+
+    Properties.DataLinkType = NetDomainEthernet;
+    Properties.MaxPhysicalAddress = MAX_ULONGLONG;
+    Properties.PhysicalAddress.Domain = NetDomainEthernet;
+    RtlCopyMemory(&(Properties.PhysicalAddress.Address),
+                  Device->MacAddress,
+                  sizeof(Device->MacAddress));
+
+    Properties.Interface.Send = VionetSend;
+    Properties.Interface.GetSetInformation = VionetGetSetInformation;
+    Properties.Interface.DestroyLink = VionetDestroyLink;
+    Properties.Capabilities = Device->SupportedCapabilities;
+    Status = NetAddLink(&Properties, &(Device->NetworkLink));
+    return Status;
+}
+
+KSTATUS
+VionetpFillReceiveQueue (
+    PVIONET_QUEUE_PAIR Pair
+    )
+
+/*++
+
+Routine Description:
+
+    This routine fills a receive queue with empty packet buffers.
+
+Arguments:
+
+    Pair - Supplies a pointer to the queue pair.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    ULONG Count;
+    VIRTIO_BUFFER Buffer;
+    ULONG Index;
+    PNET_PACKET_BUFFER Packet;
+    KSTATUS Status;
+
+    Count = VirtioGetQueueSize(Pair->ReceiveQueue);
+    Status = STATUS_SUCCESS;
+    KeAcquireQueuedLock(Pair->ReceiveLock);
+    for (Index = 0; Index < Count; Index += 1) {
+        Status = NetAllocateBuffer(0,
+                                   VIONET_MAX_PACKET_SIZE,
+                                   0,
+                                   Pair->Device->NetworkLink,
+                                   0,
+                                   &Packet);
+
+        if (!KSUCCESS(Status)) {
+            break;
+        }
+
+        Buffer.Address = Packet->BufferPhysicalAddress;
+        Buffer.Length = Packet->BufferSize;
+        Buffer.Flags = VIRTIO_BUFFER_FLAG_DEVICE_WRITE;
+        Status = VirtioAddBuffers(Pair->ReceiveQueue, &Buffer, 1, Packet);
+        if (!KSUCCESS(Status)) {
+            NetFreeBuffer(Packet);
+            break;
+        }
+    }
+
+    VirtioNotifyQueue(Pair->ReceiveQueue);
+    KeReleaseQueuedLock(Pair->ReceiveLock);
+    return Status;
+}
+
+VOID
+VionetpServiceReceiveQueue (
+    PVOID Context,
+    PVIRTIO_QUEUE Queue
+    )
+
+/*++
+
+Routine Description:
+
+    This routine hands received packets to core networking and gives the
+    buffers back to the device. It runs at low level.
+
+Arguments:
+
+    Context - Supplies a pointer to the queue pair.
+
+    Queue - Supplies a pointer to the receive virtqueue.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    VIRTIO_BUFFER Buffer;
+    PVIONET_DEVICE Device;
+    ULONG Flags;
+    PVIONET_PACKET_HEADER Header;
+    UCHAR HeaderFlags;
+    ULONG Length;
+    PNET_PACKET_BUFFER Packet;
+    PVIONET_QUEUE_PAIR Pair;
+    KSTATUS Status;
+
+    Pair = Context;
+    Device = Pair->Device;
+    KeAcquireQueuedLock(Pair->ReceiveLock);
+    do {
+        VirtioDisableQueueInterrupts(Queue);
+        while (VirtioGetUsedBuffer(Queue, (PVOID *)&Packet, &Length) != FALSE) {
+            if (Length > sizeof(VIONET_PACKET_HEADER)) {
+                Header = Packet->Buffer;
+
+                //
+                // A valid or not yet computed checksum both mean the packet
+                // never crossed a wire that could corrupt it.
+                //
+
+                Flags = 0;
+                HeaderFlags = VIONET_HEADER_FLAG_DATA_VALID |
+                              VIONET_HEADER_FLAG_NEEDS_CHECKSUM;
+
+                if ((Header->Flags & HeaderFlags) != 0) {
+
+                    Flags = NET_PACKET_FLAG_TCP_CHECKSUM_OFFLOAD |
+                            NET_PACKET_FLAG_UDP_CHECKSUM_OFFLOAD;
+                }
+
+                Packet->Flags = Flags;
+                Packet->DataOffset = sizeof(VIONET_PACKET_HEADER);
+                Packet->DataSize = Length;
+                Packet->FooterOffset = Length;
+                NetProcessReceivedPacket(Device->NetworkLink, Packet);
+            }
+
+            Buffer.Address = Packet->BufferPhysicalAddress;
+            Buffer.Length = Packet->BufferSize;
+            Buffer.Flags = VIRTIO_BUFFER_FLAG_DEVICE_WRITE;
+            Status = VirtioAddBuffers(Queue, &Buffer, 1, Packet);
+            if (!KSUCCESS(Status)) {
+                NetFreeBuffer(Packet);
+            }
+        }
+
+    } while (VirtioEnableQueueInterrupts(Queue) != FALSE);
+
+    VirtioNotifyQueue(Queue);
+    KeReleaseQueuedLock(Pair->ReceiveLock);
+    return;
+}
+
+VOID
+VionetpServiceTransmitQueue (
+    PVOID Context,
+    PVIRTIO_QUEUE Queue
+    )
+
+/*++
+
+Routine Description:
+
+    This routine frees transmitted packets and sends any that were waiting
+    for room. It runs at low level.
+
+Arguments:
+
+    Context - Supplies a pointer to the queue pair.
+
+    Queue - Supplies a pointer to the transmit virtqueue.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PVIONET_QUEUE_PAIR Pair;
+
+    Pair = Context;
+    KeAcquireQueuedLock(Pair->TransmitLock);
+    do {
+        VirtioDisableQueueInterrupts(Queue);
+        VionetpReapTransmittedPackets(Pair);
+
+    } while (VirtioEnableQueueInterrupts(Queue) != FALSE);
+
+    VionetpSendPendingPackets(Pair);
+    KeReleaseQueuedLock(Pair->TransmitLock);
+    return;
+}
+
+VOID
+VionetpReapTransmittedPackets (
+    PVIONET_QUEUE_PAIR Pair
+    )
+
+/*++
+
+Routine Description:
+
+    This routine frees packets the device has finished sending. The transmit
+    lock must be held.
+
+Arguments:
+
+    Pair - Supplies a pointer to the queue pair.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    ULONG Length;
+    PNET_PACKET_BUFFER Packet;
+
+    while (VirtioGetUsedBuffer(Pair->TransmitQueue,
+                               (PVOID *)&Packet,
+                               &Length) != FALSE) {
+
+        NetFreeBuffer(Packet);
+    }
+
+    return;
+}
+
+VOID
+VionetpSendPendingPackets (
+    PVIONET_QUEUE_PAIR Pair
+    )
+
+/*++
+
+Routine Description:
+
+    This routine moves as many waiting packets as fit onto the transmit
+    queue, and notifies the device once for the batch. The transmit lock must
+    be held.
+
+Arguments:
+
+    Pair - Supplies a pointer to the queue pair.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    VIRTIO_BUFFER Buffer;
+    PVIONET_PACKET_HEADER Header;
+    PNET_PACKET_BUFFER Packet;
+    KSTATUS Status;
+
+    while (NET_PACKET_LIST_EMPTY(&(Pair->TransmitPacketList)) == FALSE) {
+        Packet = LIST_VALUE(Pair->TransmitPacketList.Head.Next,
+                            NET_PACKET_BUFFER,
+                            ListEntry);
+
+        //
+        // Core networking left room for the header in front of the data.
+        //
+
+        ASSERT(Packet->DataOffset >= sizeof(VIONET_PACKET_HEADER));
+
+        Header = Packet->Buffer + Packet->DataOffset -
+                 sizeof(VIONET_PACKET_HEADER);
+
+        RtlZeroMemory(Header, sizeof(VIONET_PACKET_HEADER));
+        Buffer.Address = Packet->BufferPhysicalAddress + Packet->DataOffset -
+                         sizeof(VIONET_PACKET_HEADER);
+
+        Buffer.Length = Packet->FooterOffset - Packet->DataOffset +
+                        sizeof(VIONET_PACKET_HEADER);
+
+        Buffer.Flags = 0;
+        Status = VirtioAddBuffers(Pair->TransmitQueue, &Buffer, 1, Packet);
+        if (!KSUCCESS(Status)) {
+            break;
+        }
+
+        NET_REMOVE_PACKET_FROM_LIST(Packet, &(Pair->TransmitPacketList));
+    }
+
+    VirtioNotifyQueue(Pair->TransmitQueue);
+    return;
+}
+
+VOID
+VionetpConfigurationChange (
+    PVOID Context
+    )
+
+/*++
+
+Routine Description:
+
+    This routine is called at low level when the device's configuration
+    changes.
+
+Arguments:
+
+    Context - Supplies a pointer to the network device.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PVIONET_DEVICE Device;
+
+    Device = Context;
+    if (Device->Started != FALSE) {
+        VionetpUpdateLinkState(Device);
+    }
+
+    return;
+}
+
+VOID
+VionetpUpdateLinkState (
+    PVIONET_DEVICE Device
+    )
+
+/*++
+
+Routine Description:
+
+    This routine reads the link status and reports changes to core
+    networking. Devices without link status are always up.
+
+Arguments:
+
+    Device - Supplies a pointer to the device.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    BOOL LinkUp;
+    USHORT LinkStatus;
+    KSTATUS Status;
+
+    LinkUp = TRUE;
+    KeAcquireQueuedLock(Device->ConfigurationLock);
+    if ((Device->Features & VIONET_FEATURE_STATUS) != 0) {
+        Status = VirtioReadConfiguration(Device->Virtio,
+                                         VIONET_CONFIGURATION_STATUS,
+                                         &LinkStatus,
+                                         sizeof(USHORT));
+
+        if ((!KSUCCESS(Status)) ||
+            ((LinkStatus & VIONET_STATUS_LINK_UP) == 0)) {
+
+            LinkUp = FALSE;
+        }
+    }
+
+    if (LinkUp != Device->LinkUp) {
+        Device->LinkUp = LinkUp;
+        if (LinkUp != FALSE) {
+            NetSetLinkState(Device->NetworkLink, TRUE, NET_SPEED_1000_MBPS);
+
+        } else {
+            NetSetLinkState(Device->NetworkLink, FALSE, 0);
+        }
+    }
+
+    KeReleaseQueuedLock(Device->ConfigurationLock);
+    return;
+}
+
+KSTATUS
+VionetpSendControlCommand (
+    PVIONET_DEVICE Device,
+    UCHAR Class,
+    UCHAR Command,
+    PVOID Data,
+    ULONG DataSize
+    )
+
+/*++
+
+Routine Description:
+
+    This routine sends a command on the control queue and waits for the
+    device to acknowledge it. The configuration lock must be held.
+
+Arguments:
+
+    Device - Supplies a pointer to the device.
+
+    Class - Supplies the command class.
+
+    Command - Supplies the command.
+
+    Data - Supplies a pointer to the command data.
+
+    DataSize - Supplies the size of the command data.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    volatile UCHAR *Acknowledge;
+    PVOID Base;
+    VIRTIO_BUFFER Buffers[3];
+    PVOID Cookie;
+    PVIONET_CONTROL_HEADER Header;
+    ULONG Length;
+    PHYSICAL_ADDRESS PhysicalAddress;
+    KSTATUS Status;
+    ULONGLONG Timeout;
+
+    if ((Device->ControlQueue == NULL) ||
+        (DataSize > VIONET_CONTROL_DATA_SIZE)) {
+
+        return STATUS_NOT_SUPPORTED;
+    }
+
+    Base = Device->ControlIoBuffer->Fragment[0].VirtualAddress;
+    PhysicalAddress = Device->ControlIoBuffer->Fragment[0].PhysicalAddress;
+    Header = Base;
+    Header->Class = Class;
+    Header->Command = Command;
+    RtlCopyMemory(Base + VIONET_CONTROL_DATA_OFFSET, Data, DataSize);
+    Acknowledge = Base + VIONET_CONTROL_ACK_OFFSET;
+    *Acknowledge = VIONET_CONTROL_ERROR;
+    Buffers[0].Address = PhysicalAddress;
+    Buffers[0].Length = sizeof(VIONET_CONTROL_HEADER);
+    Buffers[0].Flags = 0;
+    Buffers[1].Address = PhysicalAddress + VIONET_CONTROL_DATA_OFFSET;
+    Buffers[1].Length = DataSize;
+    Buffers[1].Flags = 0;
+    Buffers[2].Address = PhysicalAddress + VIONET_CONTROL_ACK_OFFSET;
+    Buffers[2].Length = sizeof(UCHAR);
+    Buffers[2].Flags = VIRTIO_BUFFER_FLAG_DEVICE_WRITE;
+    Status = VirtioAddBuffers(Device->ControlQueue, Buffers, 3, Device);
+    if (!KSUCCESS(Status)) {
+        return Status;
+    }
+
+    VirtioNotifyQueue(Device->ControlQueue);
+
+    //
+    // The device normally answers control commands immediately, so poll.
+    //
+
+    Timeout = HlQueryTimeCounter() +
+              ((HlQueryTimeCounterFrequency() * VIONET_CONTROL_TIMEOUT_MS) /
+               MILLISECONDS_PER_SECOND);
+
+    while (VirtioGetUsedBuffer(Device->ControlQueue, &Cookie, &Length) ==
+           FALSE) {
+
+        if (HlQueryTimeCounter() > Timeout) {
+            return STATUS_TIMEOUT;
+        }
+
+        KeYield();
+    }
+
+    if (*Acknowledge != VIONET_CONTROL_OK) {
+        return STATUS_UNSUCCESSFUL;
+    }
+
+    return STATUS_SUCCESS;
+}
@@ -0,0 +1,287 @@
+/*++
+
+Copyright (c) 2026 Minoca Corp.
+
+    This file is licensed under the terms of the GNU General Public License
+    version 3. Alternative licensing terms are available. Contact
+    info@minocacorp.com for details. See the LICENSE file at the root of this
+    project for complete licensing information.
+
+Module Name:
+
+    vionet.h
+
+Abstract:
+
+    This header contains internal definitions for the virtio network device
+    driver.
+
+Author:
+
+    Minoca Corp. 18-Oct-2026
+
+--*/
+
+//
+// ------------------------------------------------------------------- Includes
+//
+
+#include <minoca/virtio/virtio.h>
+
+//
+// ---------------------------------------------------------------- Definitions
+//
+
+#define VIONET_ALLOCATION_TAG 0x4E6F6956 // 'NoiV'
+
+//
+// Define the device specific feature bits.
+//
+
+#define VIONET_FEATURE_GUEST_CHECKSUM (1ULL << 1)
+#define VIONET_FEATURE_MAC            (1ULL << 5)
+#define VIONET_FEATURE_STATUS         (1ULL << 16)
+#define VIONET_FEATURE_CONTROL_QUEUE  (1ULL << 17)
+#define VIONET_FEATURE_CONTROL_RX     (1ULL << 18)
+#define VIONET_FEATURE_MULTI_QUEUE    (1ULL << 22)
+
+#define VIONET_DRIVER_FEATURES \
+    (VIONET_FEATURE_GUEST_CHECKSUM | VIONET_FEATURE_MAC | \
+     VIONET_FEATURE_STATUS | VIONET_FEATURE_CONTROL_QUEUE | \
+     VIONET_FEATURE_CONTROL_RX | VIONET_FEATURE_MULTI_QUEUE)
+
+//
+// Define offsets into the device configuration space.
+//
+
+#define VIONET_CONFIGURATION_MAC        0x00
+#define VIONET_CONFIGURATION_STATUS     0x06
+#define VIONET_CONFIGURATION_MAX_PAIRS  0x08
+
+//
+// Define the link status bits.
+//
+
+#define VIONET_STATUS_LINK_UP 0x0001
+
+//
+// Define the flags in the packet header.
+//
+
+#define VIONET_HEADER_FLAG_NEEDS_CHECKSUM 0x01
+#define VIONET_HEADER_FLAG_DATA_VALID     0x02
+
+//
+// Define the control queue command classes, commands, and acknowledgements.
+//
+
+#define VIONET_CONTROL_CLASS_RX 0
+#define VIONET_CONTROL_RX_PROMISCUOUS 0
+#define VIONET_CONTROL_RX_ALL_MULTICAST 1
+
+#define VIONET_CONTROL_CLASS_MULTI_QUEUE 4
+#define VIONET_CONTROL_MULTI_QUEUE_SET_PAIRS 0
+
+#define VIONET_CONTROL_OK 0
+#define VIONET_CONTROL_ERROR 1
+
+//
+// Define the layout of the control command page.
+//
+
+#define VIONET_CONTROL_DATA_OFFSET 0x10
+#define VIONET_CONTROL_DATA_SIZE 0x20
+#define VIONET_CONTROL_ACK_OFFSET 0x30
+
+//
+// Define how long to wait for the device to answer a control command.
+//
+
+#define VIONET_CONTROL_TIMEOUT_MS 1000
+
+//
+// Define the size of a packet buffer, which holds the packet header and a
+// full ethernet frame.
+//
+
+#define VIONET_MAX_PACKET_SIZE 1536
+
+//
+// Define the largest queue the driver will use.
+//
+
+#define VIONET_MAX_QUEUE_SIZE 256
+#define VIONET_CONTROL_QUEUE_SIZE 16
+
+//
+// Define the maximum number of packets waiting to be sent on a queue before
+// packets are dropped.
+//
+
+#define VIONET_MAX_TRANSMIT_PACKET_LIST_COUNT (VIONET_MAX_QUEUE_SIZE * 2)
+
+//
+// ------------------------------------------------------ Data Type Definitions
+//
+
+typedef struct _VIONET_DEVICE VIONET_DEVICE, *PVIONET_DEVICE;
+
+/*++
+
+Structure Description:
+
+    This structure defines the header that precedes every packet on the
+    receive and transmit queues.
+
+Members:
+
+    Flags - Stores a bitmask of flags. See VIONET_HEADER_FLAG_* definitions.
+
+    GsoType - Stores the segmentation offload type, which is not used.
+
+    HeaderLength - Stores the length of the headers for segmentation offload.
+
+    GsoSize - Stores the segment size for segmentation offload.
+
+    ChecksumStart - Stores the offset where checksumming starts, if the
+        checksum needs to be filled in.
+
+    ChecksumOffset - Stores the offset from the checksum start where the
+        checksum is stored.
+
+    BufferCount - Stores the number of buffers a received packet spans.
+
+--*/
+
+typedef struct _VIONET_PACKET_HEADER {
+    UCHAR Flags;
+    UCHAR GsoType;
+    USHORT HeaderLength;
+    USHORT GsoSize;
+    USHORT ChecksumStart;
+    USHORT ChecksumOffset;
+    USHORT BufferCount;
+} PACKED VIONET_PACKET_HEADER, *PVIONET_PACKET_HEADER;
+
+/*++
+
+Structure Description:
+
+    This structure defines the header of a control queue command.
+
+Members:
+
+    Class - Stores the command class.
+
+    Command - Stores the command within the class.
+
+--*/
+
+typedef struct _VIONET_CONTROL_HEADER {
+    UCHAR Class;
+    UCHAR Command;
+} PACKED VIONET_CONTROL_HEADER, *PVIONET_CONTROL_HEADER;
+
+/*++
+
+Structure Description:
+
+    This structure defines a receive and transmit queue pair. Each processor
+    uses its own pair when the device has enough of them.
+
+Members:
+
+    Device - Stores a pointer back to the device.
+
+    ReceiveQueue - Stores a pointer to the receive virtqueue.
+
+    TransmitQueue - Stores a pointer to the transmit virtqueue.
+
+    ReceiveLock - Stores a pointer to the lock serializing the receive queue.
+
+    TransmitLock - Stores a pointer to the lock serializing the transmit
+        queue and the pending transmit list.
+
+    TransmitPacketList - Stores the list of packets waiting for room in the
+        transmit queue.
+
+--*/
+
+typedef struct _VIONET_QUEUE_PAIR {
+    PVIONET_DEVICE Device;
+    PVIRTIO_QUEUE ReceiveQueue;
+    PVIRTIO_QUEUE TransmitQueue;
+    PQUEUED_LOCK ReceiveLock;
+    PQUEUED_LOCK TransmitLock;
+    NET_PACKET_LIST TransmitPacketList;
+} VIONET_QUEUE_PAIR, *PVIONET_QUEUE_PAIR;
+
+/*++
+
+Structure Description:
+
+    This structure defines a virtio network device.
+
+Members:
+
+    OsDevice - Stores a pointer to the OS device.
+
+    Virtio - Stores a pointer to the virtio device.
+
+    NetworkLink - Stores a pointer to the core networking link.
+
+    Started - Stores a boolean indicating whether the device has been started.
+
+    LinkUp - Stores a boolean indicating whether the link is up.
+
+    MacAddress - Stores the device's MAC address.
+
+    Features - Stores the negotiated features.
+
+    MaxPairCount - Stores the number of queue pairs the device has.
+
+    PairCount - Stores the number of queue pairs in use.
+
+    Pairs - Stores the array of queue pairs.
+
+    ControlQueue - Stores an optional pointer to the control virtqueue.
+
+    ControlIoBuffer - Stores the I/O buffer used to send control commands.
+
+    ConfigurationLock - Stores a pointer to the lock serializing
+        configuration changes and control commands.
+
+    SupportedCapabilities - Stores the set of link capabilities the device
+        supports. See NET_LINK_CAPABILITY_* definitions.
+
+    EnabledCapabilities - Stores the set of link capabilities currently
+        enabled.
+
+--*/
+
+struct _VIONET_DEVICE {
+    PDEVICE OsDevice;
+    PVIRTIO_DEVICE Virtio;
+    PNET_LINK NetworkLink;
+    BOOL Started;
+    BOOL LinkUp;
+    BYTE MacAddress[ETHERNET_ADDRESS_SIZE];
+    ULONGLONG Features;
+    ULONG MaxPairCount;
+    ULONG PairCount;
+    PVIONET_QUEUE_PAIR Pairs;
+    PVIRTIO_QUEUE ControlQueue;
+    PIO_BUFFER ControlIoBuffer;
+    PQUEUED_LOCK ConfigurationLock;
+    ULONG SupportedCapabilities;
+    ULONG EnabledCapabilities;
+};
+
+//
+// -------------------------------------------------------------------- Globals
+//
+
+//
+// -------------------------------------------------------- Function Prototypes
+//
+
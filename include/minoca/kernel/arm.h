@@ -381,6 +381,8 @@ Module Name:
 #define MPIDR_MP_EXTENSIONS_ENABLED          0x80000000
 #define MPIDR_UNIPROCESSOR_SYSTEM            0x40000000
 #define MPIDR_LOWEST_AFFINITY_INTERDEPENDENT 0x01000000
+#define MPIDR_AFFINITY_1_MASK                0x0000FF00
+#define MPIDR_AFFINITY_1_SHIFT               8
 
 //
 // Define processor features bits.
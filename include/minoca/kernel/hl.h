@@ -495,6 +495,33 @@ Return Value:
 
 --*/
 
+BOOL
+HlGetUserModeTimeCounterOffset (
+    PULONGLONG Offset
+    );
+
+/*++
+
+Routine Description:
+
+    This routine determines whether user mode can compute the time counter by
+    reading the hardware counter directly. This is only possible if the time
+    counter is a full 64-bit counter that user mode has access to and that
+    ticks at a constant rate through all power states.
+
+Arguments:
+
+    Offset - Supplies a pointer where the value to add to the raw hardware
+        counter to get the time counter will be returned on success.
+
+Return Value:
+
+    TRUE if user mode can read the time counter directly.
+
+    FALSE if user mode must ask the kernel for the time counter.
+
+--*/
+
 KERNEL_API
 ULONGLONG
 HlQueryTimeCounterFrequency (
@@ -1195,6 +1222,43 @@ Return Value:
 
 --*/
 
+KSTATUS
+HlSetInterruptLineTarget (
+    PKINTERRUPT Interrupt,
+    PPROCESSOR_SET Target
+    );
+
+/*++
+
+Routine Description:
+
+    This routine re-targets an enabled interrupt line at a different set of
+    processors. The interrupt's DPC is queued on whichever processor takes the
+    interrupt, so it follows the line. If the line is shared, the other
+    interrupts connected to it move as well.
+
+Arguments:
+
+    Interrupt - Supplies a pointer to the connected interrupt whose line should
+        be re-targeted.
+
+    Target - Supplies a pointer to the set of processors the line should
+        target.
+
+Return Value:
+
+    STATUS_SUCCESS on success.
+
+    STATUS_NOT_SUPPORTED if the interrupt has no line (such as an MSI-based
+    interrupt), or its line belongs to a secondary interrupt controller.
+
+    STATUS_INVALID_PARAMETER if the line is not enabled or the target is
+    invalid.
+
+    Other error codes if the controller failed to program the line.
+
+--*/
+
 KSTATUS
 HlStartProfilerTimer (
     VOID
@@ -187,6 +187,14 @@ Module Name:
 
 #define TIMER_FEATURE_ABSOLUTE 0x00000100
 
+//
+// Set this flag if user mode can read the timer's counter directly using the
+// architecture's standard counter instruction (rdtsc on PC platforms, CNTVCT
+// on ARM). The timer module is responsible for granting that access.
+//
+
+#define TIMER_FEATURE_USER_MODE_READABLE 0x00000200
+
 //
 // Define calendar timer features.
 //
@@ -72,6 +72,18 @@ Module Name:
     IoPathEntryAddReference((_PathPoint)->PathEntry);   \
     IoMountPointAddReference((_PathPoint)->MountPoint);
 
+//
+// This macro returns the size of the memory region backing an I/O ring with
+// the given number of submission and completion entries. The region holds the
+// ring header, followed by the submission array, followed by the completion
+// array.
+//
+
+#define IO_RING_SIZE(_SubmissionCount, _CompletionCount)        \
+    (sizeof(IO_RING_HEADER) +                                   \
+     ((_SubmissionCount) * sizeof(IO_RING_SUBMISSION)) +        \
+     ((_CompletionCount) * sizeof(IO_RING_COMPLETION)))
+
 //
 // This macros releases a reference from both the path entry and mount point of
 // a path point.
@@ -939,6 +951,69 @@ Module Name:
 
 #define SHARED_MEMORY_PROPERTY_UNLINKED 0x00010000
 
+//
+// Define event queue registration flags. These live in the upper bits of the
+// registered event mask, above the poll events.
+//
+
+//
+// Set this flag to report a registration only when new events arrive, rather
+// than on every wait for as long as the events remain set.
+//
+
+#define EVENT_QUEUE_FLAG_EDGE_TRIGGERED 0x80000000
+
+//
+// Set this flag to disarm a registration after it is reported once. A modify
+// operation re-arms it.
+//
+
+#define EVENT_QUEUE_FLAG_ONE_SHOT 0x40000000
+
+#define EVENT_QUEUE_FLAG_MASK \
+    (EVENT_QUEUE_FLAG_EDGE_TRIGGERED | EVENT_QUEUE_FLAG_ONE_SHOT)
+
+//
+// Define the maximum number of events returned by a single event queue wait.
+//
+
+#define EVENT_QUEUE_MAX_WAIT_EVENTS 512
+
+//
+// Define I/O ring submission flags.
+//
+
+//
+// Set this flag to interpret the submission's handle as an index into the
+// ring's registered handles.
+//
+
+#define IO_RING_SUBMIT_REGISTERED_HANDLE 0x0001
+
+//
+// Set this flag to use the registered buffer selected by the buffer index.
+// The submission's buffer must lie entirely within it.
+//
+
+#define IO_RING_SUBMIT_REGISTERED_BUFFER 0x0002
+
+#define IO_RING_SUBMIT_FLAG_MASK \
+    (IO_RING_SUBMIT_REGISTERED_HANDLE | IO_RING_SUBMIT_REGISTERED_BUFFER)
+
+//
+// Define the maximum number of submission or completion entries in an I/O
+// ring. Both counts must be powers of two.
+//
+
+#define IO_RING_MAX_ENTRIES 4096
+
+//
+// Define the maximum number of handles or buffers that can be registered
+// with an I/O ring.
+//
+
+#define IO_RING_MAX_REGISTERED 1024
+
 //
 // ------------------------------------------------------ Data Type Definitions
 //
@@ -963,6 +1038,180 @@ typedef enum _SEEK_COMMAND {
     SeekCommandFromEnd,
 } SEEK_COMMAND, *PSEEK_COMMAND;
 
+typedef enum _IO_ADVICE {
+    IoAdviceNormal,
+    IoAdviceRandom,
+    IoAdviceSequential,
+    IoAdviceWillNeed,
+    IoAdviceDontNeed,
+    IoAdviceLargePages,
+    IoAdviceNoLargePages,
+    IoAdviceCount
+} IO_ADVICE, *PIO_ADVICE;
+
+typedef enum _EVENT_QUEUE_OPERATION {
+    EventQueueOperationInvalid,
+    EventQueueOperationAdd,
+    EventQueueOperationDelete,
+    EventQueueOperationModify
+} EVENT_QUEUE_OPERATION, *PEVENT_QUEUE_OPERATION;
+
+/*++
+
+Structure Description:
+
+    This structure defines an event queue registration or a reported event.
+    This lines up with struct epoll_event in the C library.
+
+Members:
+
+    Events - Stores the mask of poll events. On registration this is the set of
+        events to watch, plus any EVENT_QUEUE_FLAG_* flags. When returned from
+        a wait, this is the set of events that are signaled.
+
+    Data - Stores an opaque value supplied at registration time and handed back
+        with every reported event.
+
+--*/
+
+typedef struct _EVENT_QUEUE_EVENT {
+    ULONG Events;
+    ULONGLONG Data;
+} EVENT_QUEUE_EVENT, *PEVENT_QUEUE_EVENT;
+
+typedef enum _IO_RING_OPERATION {
+    IoRingOperationNop,
+    IoRingOperationRead,
+    IoRingOperationWrite,
+    IoRingOperationFlush,
+    IoRingOperationAccept,
+    IoRingOperationConnect,
+    IoRingOperationSend,
+    IoRingOperationReceive,
+    IoRingOperationCount
+} IO_RING_OPERATION, *PIO_RING_OPERATION;
+
+typedef enum _IO_RING_REGISTER_OPERATION {
+    IoRingRegisterInvalid,
+    IoRingRegisterHandles,
+    IoRingUnregisterHandles,
+    IoRingRegisterBuffers,
+    IoRingUnregisterBuffers
+} IO_RING_REGISTER_OPERATION, *PIO_RING_REGISTER_OPERATION;
+
+/*++
+
+Structure Description:
+
+    This structure defines the header at the start of an I/O ring's memory
+    region, which is shared between user mode and the kernel. The indices are
+    free running and are reduced modulo the entry counts to find an entry.
+
+Members:
+
+    SubmissionHead - Stores the index of the next submission the kernel will
+        consume. Only the kernel writes this.
+
+    SubmissionTail - Stores the index one beyond the last submission user mode
+        has filled in. Only user mode writes this.
+
+    CompletionHead - Stores the index of the next completion user mode will
+        consume. Only user mode writes this.
+
+    CompletionTail - Stores the index one beyond the last completion the kernel
+        has posted. Only the kernel writes this.
+
+    SubmissionCount - Stores the number of entries in the submission array.
+
+    CompletionCount - Stores the number of entries in the completion array.
+
+    Reserved - Stores padding to keep the arrays aligned.
+
+--*/
+
+typedef struct _IO_RING_HEADER {
+    ULONG SubmissionHead;
+    ULONG SubmissionTail;
+    ULONG CompletionHead;
+    ULONG CompletionTail;
+    ULONG SubmissionCount;
+    ULONG CompletionCount;
+    ULONGLONG Reserved;
+} IO_RING_HEADER, *PIO_RING_HEADER;
+
+/*++
+
+Structure Description:
+
+    This structure defines a single I/O ring submission.
+
+Members:
+
+    UserData - Stores an opaque value handed back with the completion.
+
+    Offset - Stores the file offset for reads and writes. Supply
+        IO_OFFSET_NONE to use and advance the handle's current offset.
+
+    Buffer - Stores a pointer to the data buffer. For connect operations this
+        points to the NETWORK_ADDRESS to connect to. For accept operations
+        this optionally points to a NETWORK_ADDRESS that receives the remote
+        address. If the registered buffer flag is set, this must lie within
+        the registered buffer.
+
+    Size - Stores the size of the buffer in bytes.
+
+    Handle - Stores the handle to operate on, or the index of a registered
+        handle if the registered handle flag is set.
+
+    Operation - Stores the IO_RING_OPERATION to perform.
+
+    Flags - Stores a bitfield of IO_RING_SUBMIT_* flags.
+
+    BufferIndex - Stores the index of the registered buffer to use if the
+        registered buffer flag is set.
+
+    OperationFlags - Stores flags specific to the operation. Send and receive
+        take SOCKET_IO_* flags, and accept takes the SYS_OPEN_FLAG_* flags
+        for the new handle.
+
+    Reserved - Stores padding. This must be zero.
+
+--*/
+
+typedef struct _IO_RING_SUBMISSION {
+    ULONGLONG UserData;
+    IO_OFFSET Offset;
+    PVOID Buffer;
+    UINTN Size;
+    HANDLE Handle;
+    USHORT Operation;
+    USHORT Flags;
+    ULONG BufferIndex;
+    ULONG OperationFlags;
+    ULONG Reserved;
+} IO_RING_SUBMISSION, *PIO_RING_SUBMISSION;
+
+/*++
+
+Structure Description:
+
+    This structure defines a single I/O ring completion.
+
+Members:
+
+    UserData - Stores the opaque value from the submission.
+
+    Result - Stores the result of the operation. On success this is the
+        number of bytes transferred, or the new handle for accept operations.
+        On failure this is a negative status code.
+
+--*/
+
+typedef struct _IO_RING_COMPLETION {
+    ULONGLONG UserData;
+    LONGLONG Result;
+} IO_RING_COMPLETION, *PIO_RING_COMPLETION;
+
 typedef enum _TERMINAL_CONTROL_CHARACTER {
     TerminalCharacterEndOfFile,
     TerminalCharacterEndOfLine,
@@ -1516,6 +1765,8 @@ typedef enum _IO_OBJECT_TYPE {
     IoObjectTerminalSlave,
     IoObjectSharedMemoryObject,
     IoObjectSymbolicLink,
+    IoObjectEventQueue,
+    IoObjectIoRing,
     IoObjectTypeCount
 } IO_OBJECT_TYPE, *PIO_OBJECT_TYPE;
 
@@ -1714,6 +1965,27 @@ typedef struct _IO_ASYNC_STATE {
 
 /*++
 
+Structure Description:
+
+    This structure defines the event queue notification state of an I/O
+    object. It is always allocated from non-paged pool.
+
+Members:
+
+    Lock - Stores the spin lock protecting the registration list.
+
+    RegistrationList - Stores the head of the list of event queue
+        registrations watching this I/O object state.
+
+--*/
+
+typedef struct _IO_NOTIFY_STATE {
+    KSPIN_LOCK Lock;
+    LIST_ENTRY RegistrationList;
+} IO_NOTIFY_STATE, *PIO_NOTIFY_STATE;
+
+/*++
+
 Structure Description:
 
     This structure defines generic state associated with an I/O object.
@@ -1740,6 +2012,9 @@ Structure Description:
 
     Async - Stores an optional pointer to the asynchronous object state.
 
+    Notify - Stores an optional pointer to the event queue notification state,
+        created the first time the object is added to an event queue.
+
 --*/
 
 typedef struct _IO_OBJECT_STATE {
@@ -1750,6 +2025,7 @@ typedef struct _IO_OBJECT_STATE {
     PKEVENT ErrorEvent;
     volatile ULONG Events;
     PIO_ASYNC_STATE Async;
+    PIO_NOTIFY_STATE Notify;
 } IO_OBJECT_STATE, *PIO_OBJECT_STATE;
 
 typedef enum _IRP_MAJOR_CODE {
@@ -4447,6 +4723,97 @@ Return Value:
 
 --*/
 
+KERNEL_API
+KSTATUS
+IoAdvise (
+    PIO_HANDLE Handle,
+    IO_OFFSET Offset,
+    ULONGLONG Size,
+    IO_ADVICE Advice
+    );
+
+/*++
+
+Routine Description:
+
+    This routine passes a hint about the expected access pattern of a region
+    of a file or block device to the page cache.
+
+Arguments:
+
+    Handle - Supplies the open I/O handle.
+
+    Offset - Supplies the offset from the beginning of the file or device
+        where the region starts.
+
+    Size - Supplies the size of the region in bytes. Supply 0 to cover
+        everything from the offset to the end of the file.
+
+    Advice - Supplies the hint. Normal, sequential, and random advice changes
+        how aggressively reads through this handle prefetch. Will-need advice
+        starts reading the region into the cache in the background. Don't-need
+        advice makes the region's clean cached pages the first to be reclaimed.
+
+Return Value:
+
+    STATUS_SUCCESS on success.
+
+    STATUS_NOT_SUPPORTED if the handle does not refer to a file or block
+    device.
+
+    STATUS_INVALID_PARAMETER if the advice is not valid.
+
+--*/
+
+KERNEL_API
+KSTATUS
+IoSplice (
+    PIO_HANDLE Source,
+    IO_OFFSET SourceOffset,
+    PIO_HANDLE Destination,
+    IO_OFFSET DestinationOffset,
+    UINTN SizeInBytes,
+    ULONG TimeoutInMilliseconds,
+    PUINTN BytesCompleted
+    );
+
+/*++
+
+Routine Description:
+
+    This routine moves data from one I/O handle to another without copying it
+    through an intermediate buffer. If the source is a cached file, its page
+    cache entries are handed to the destination by reference. Other sources
+    are read into a kernel buffer and written out from there.
+
+Arguments:
+
+    Source - Supplies the open I/O handle to read from.
+
+    SourceOffset - Supplies the offset in the source to read from. Supply
+        IO_OFFSET_NONE to use and advance the source's current file position.
+
+    Destination - Supplies the open I/O handle to write to.
+
+    DestinationOffset - Supplies the offset in the destination to write to.
+        Supply IO_OFFSET_NONE to use and advance the destination's current file
+        position.
+
+    SizeInBytes - Supplies the number of bytes to move.
+
+    TimeoutInMilliseconds - Supplies the number of milliseconds to wait for
+        the source to produce data. Use WAIT_TIME_INDEFINITE to wait forever.
+
+    BytesCompleted - Supplies a pointer where the number of bytes written to
+        the destination will be returned.
+
+Return Value:
+
+    Status code. A failing status code does not necessarily mean no data was
+    moved. Check the bytes completed value to find out how much occurred.
+
+--*/
+
 KERNEL_API
 KSTATUS
 IoGetFileSize (
@@ -5193,6 +5560,129 @@ Return Value:
 
 --*/
 
+KERNEL_API
+KSTATUS
+IoCreateEventQueue (
+    BOOL FromKernelMode,
+    ULONG OpenFlags,
+    PIO_HANDLE *Handle
+    );
+
+/*++
+
+Routine Description:
+
+    This routine creates and opens a new event queue. An event queue holds a
+    persistent set of registered I/O handles and collects the ones that become
+    ready, so that waiting on it costs time proportional to the number of
+    ready handles rather than the number registered.
+
+Arguments:
+
+    FromKernelMode - Supplies a boolean indicating whether this request is
+        originating from kernel mode (TRUE) or user mode (FALSE).
+
+    OpenFlags - Supplies the open flags for the queue. See OPEN_FLAG_*
+        definitions. OPEN_FLAG_CREATE is automatically applied.
+
+    Handle - Supplies a pointer where the handle to the new event queue will
+        be returned.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+KERNEL_API
+KSTATUS
+IoControlEventQueue (
+    PIO_HANDLE QueueHandle,
+    EVENT_QUEUE_OPERATION Operation,
+    PIO_HANDLE Handle,
+    PEVENT_QUEUE_EVENT Event
+    );
+
+/*++
+
+Routine Description:
+
+    This routine adds, modifies, or removes an I/O handle's registration with
+    an event queue.
+
+Arguments:
+
+    QueueHandle - Supplies a pointer to the open event queue handle.
+
+    Operation - Supplies the operation to perform.
+
+    Handle - Supplies a pointer to the I/O handle to register. Registrations
+        are tied to this handle, and are removed automatically when it is
+        closed for the last time.
+
+    Event - Supplies a pointer to the events to watch and the data to report
+        for add and modify operations. This is ignored for delete operations.
+
+Return Value:
+
+    STATUS_SUCCESS on success.
+
+    STATUS_INVALID_PARAMETER if the queue handle is not an event queue or the
+    handle is itself an event queue.
+
+    STATUS_NOT_SUPPORTED if the handle has no pollable state, such as a
+    regular file.
+
+    STATUS_DUPLICATE_ENTRY if the handle is already registered on an add.
+
+    STATUS_NOT_FOUND if the handle is not registered on a modify or delete.
+
+--*/
+
+KERNEL_API
+KSTATUS
+IoWaitForEventQueue (
+    PIO_HANDLE QueueHandle,
+    PEVENT_QUEUE_EVENT Events,
+    ULONG EventCount,
+    ULONG TimeoutInMilliseconds,
+    PULONG EventsReturned
+    );
+
+/*++
+
+Routine Description:
+
+    This routine waits for registered I/O handles on an event queue to become
+    ready.
+
+Arguments:
+
+    QueueHandle - Supplies a pointer to the open event queue handle.
+
+    Events - Supplies a pointer to an array where the ready events will
+        be returned.
+
+    EventCount - Supplies the number of elements in the events array.
+
+    TimeoutInMilliseconds - Supplies the number of milliseconds to wait for an
+        event before giving up. Use WAIT_TIME_INDEFINITE to wait forever.
+
+    EventsReturned - Supplies a pointer where the number of events returned
+        will be stored.
+
+Return Value:
+
+    STATUS_SUCCESS if one or more events were returned.
+
+    STATUS_TIMEOUT if no events arrived in the given amount of time.
+
+    STATUS_INTERRUPTED if the wait was interrupted by a signal.
+
+    Other error codes on failure.
+
+--*/
+
 KERNEL_API
 KSTATUS
 IoCreateTerminal (
@@ -5781,6 +6271,188 @@ Return Value:
 
 --*/
 
+INTN
+IoSysCreateEventQueue (
+    PVOID SystemCallParameter
+    );
+
+/*++
+
+Routine Description:
+
+    This routine handles the system call that creates a new event queue.
+
+Arguments:
+
+    SystemCallParameter - Supplies a pointer to the parameters supplied with
+        the system call. This structure will be a stack-local copy of the
+        actual parameters passed from user-mode.
+
+Return Value:
+
+    STATUS_SUCCESS or positive integer on success.
+
+    Error status code on failure.
+
+--*/
+
+INTN
+IoSysControlEventQueue (
+    PVOID SystemCallParameter
+    );
+
+/*++
+
+Routine Description:
+
+    This routine handles the system call that adds, modifies, or removes a
+    handle registration on an event queue.
+
+Arguments:
+
+    SystemCallParameter - Supplies a pointer to the parameters supplied with
+        the system call. This structure will be a stack-local copy of the
+        actual parameters passed from user-mode.
+
+Return Value:
+
+    STATUS_SUCCESS or positive integer on success.
+
+    Error status code on failure.
+
+--*/
+
+INTN
+IoSysWaitForEventQueue (
+    PVOID SystemCallParameter
+    );
+
+/*++
+
+Routine Description:
+
+    This routine handles the system call that waits for events on an event
+    queue.
+
+Arguments:
+
+    SystemCallParameter - Supplies a pointer to the parameters supplied with
+        the system call. This structure will be a stack-local copy of the
+        actual parameters passed from user-mode.
+
+Return Value:
+
+    STATUS_SUCCESS or the number of events returned (a positive integer) on
+    success.
+
+    Error status code (a negative integer) on failure.
+
+--*/
+
+INTN
+IoSysSplice (
+    PVOID SystemCallParameter
+    );
+
+/*++
+
+Routine Description:
+
+    This routine moves data from one handle to another on behalf of user mode.
+
+Arguments:
+
+    SystemCallParameter - Supplies a pointer to the parameters supplied with
+        the system call. This structure will be a stack-local copy of the
+        actual parameters passed from user-mode.
+
+Return Value:
+
+    STATUS_SUCCESS or the number of bytes completed (a positive integer) on
+    success.
+
+    Error status code (a negative integer) on failure.
+
+--*/
+
+INTN
+IoSysCreateIoRing (
+    PVOID SystemCallParameter
+    );
+
+/*++
+
+Routine Description:
+
+    This routine handles the system call that creates a new I/O ring.
+
+Arguments:
+
+    SystemCallParameter - Supplies a pointer to the parameters supplied with
+        the system call. This structure will be a stack-local copy of the
+        actual parameters passed from user-mode.
+
+Return Value:
+
+    STATUS_SUCCESS or positive integer on success.
+
+    Error status code on failure.
+
+--*/
+
+INTN
+IoSysEnterIoRing (
+    PVOID SystemCallParameter
+    );
+
+/*++
+
+Routine Description:
+
+    This routine handles the system call that submits requests from an I/O
+    ring and optionally waits for completions.
+
+Arguments:
+
+    SystemCallParameter - Supplies a pointer to the parameters supplied with
+        the system call. This structure will be a stack-local copy of the
+        actual parameters passed from user-mode.
+
+Return Value:
+
+    STATUS_SUCCESS or the number of submissions consumed (a positive integer)
+    on success.
+
+    Error status code (a negative integer) on failure.
+
+--*/
+
+INTN
+IoSysRegisterIoRing (
+    PVOID SystemCallParameter
+    );
+
+/*++
+
+Routine Description:
+
+    This routine handles the system call that registers or unregisters
+    handles or buffers with an I/O ring.
+
+Arguments:
+
+    SystemCallParameter - Supplies a pointer to the parameters supplied with
+        the system call. This structure will be a stack-local copy of the
+        actual parameters passed from user-mode.
+
+Return Value:
+
+    STATUS_SUCCESS or positive integer on success.
+
+    Error status code on failure.
+
+--*/
+
 INTN
 IoSysDuplicateHandle (
     PVOID SystemCallParameter
@@ -6316,6 +6988,32 @@ Return Value:
 
 --*/
 
+INTN
+IoSysSocketPerformMessageIo (
+    PVOID SystemCallParameter
+    );
+
+/*++
+
+Routine Description:
+
+    This routine handles the system call that sends or receives several socket
+    messages at once.
+
+Arguments:
+
+    SystemCallParameter - Supplies a pointer to the parameters supplied with
+        the system call. This structure will be a stack-local copy of the
+        actual parameters passed from user-mode.
+
+Return Value:
+
+    Returns the number of messages completed on success.
+
+    Error status code on failure.
+
+--*/
+
 INTN
 IoSysSocketGetSetInformation (
     PVOID SystemCallParameter
@@ -7333,6 +8031,44 @@ Return Value:
 
 --*/
 
+KERNEL_API
+KSTATUS
+IoSetInterruptAffinity (
+    HANDLE InterruptHandle,
+    ULONG Processor
+    );
+
+/*++
+
+Routine Description:
+
+    This routine steers a connected interrupt to a single processor, so that
+    its interrupt service routine and DPC both run there. Drivers that hand
+    work off to a dedicated thread can pin that thread to the same processor
+    with KeSetThreadAffinity to keep a flow on one core. Interrupts using
+    message signaled interrupts are targeted when the driver programs the
+    message address, by passing a processor set to HlGetMsiInformation.
+
+Arguments:
+
+    InterruptHandle - Supplies the handle to the interrupt, returned when the
+        interrupt was connected.
+
+    Processor - Supplies the number of the processor to steer the interrupt
+        to.
+
+Return Value:
+
+    STATUS_SUCCESS on success.
+
+    STATUS_INVALID_PARAMETER if the processor is not active.
+
+    STATUS_NOT_SUPPORTED if the interrupt cannot be re-targeted.
+
+    Other error codes on failure.
+
+--*/
+
 PSTREAM_BUFFER
 IoCreateStreamBuffer (
     PIO_OBJECT_STATE IoState,
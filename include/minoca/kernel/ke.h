@@ -94,6 +94,13 @@ Module Name:
 #define KERNEL_MAX_ARGUMENT_VALUES 10
 #define KERNEL_MAX_COMMAND_LINE 4096
 
+//
+// Define the fixed point scale of scheduler load averages. A load of one
+// ready thread is represented by this value.
+//
+
+#define SCHEDULER_LOAD_SCALE 1024
+
 //
 // Work queue flags.
 //
@@ -247,6 +254,7 @@ typedef enum _KE_INFORMATION_TYPE {
     KeInformationProcessorCount,
     KeInformationKernelCommandLine,
     KeInformationBannerThread,
+    KeInformationSchedulerStatistics,
 } KE_INFORMATION_TYPE, *PKE_INFORMATION_TYPE;
 
 typedef enum _SYSTEM_FIRMWARE_TYPE {
@@ -411,12 +419,18 @@ Structure Description:
 
     Entry - Stores the regular scheduling entry data.
 
-    Children - Stores the head of the list of scheduling entries that are ready
-        to be run within this group.
+    Children - Stores the fair run queue: the tree of scheduling entries that
+        are ready to be run within this group, ordered by virtual runtime.
 
-    ReadyThreadCount - Stores the number of threads inside this group and all
-        its children (meaning this includes all ready threads inside child and
-        grandchild groups).
+    MinimumVirtualRuntime - Stores the monotonically increasing virtual
+        runtime floor of the group, which tracks the smallest virtual runtime
+        in the run queue. Entries are placed relative to this value when they
+        are queued.
+
+    ReadyThreadCount - Stores the number of fair threads inside this group and
+        all its children (meaning this includes all ready threads inside child
+        and grandchild groups). For the processor's root group, this also
+        includes the ready real-time threads.
 
     Scheduler - Stores a pointer to the root CPU this group belongs to.
 
@@ -426,7 +440,8 @@ Structure Description:
 
 struct _SCHEDULER_GROUP_ENTRY {
     SCHEDULER_ENTRY Entry;
-    LIST_ENTRY Children;
+    RED_BLACK_TREE Children;
+    ULONGLONG MinimumVirtualRuntime;
     UINTN ReadyThreadCount;
     PSCHEDULER_DATA Scheduler;
     PSCHEDULER_GROUP Group;
@@ -434,6 +449,48 @@ struct _SCHEDULER_GROUP_ENTRY {
 
 /*++
 
+Structure Description:
+
+    This structure contains the load balancing counters for a processor's
+    scheduler.
+
+Members:
+
+    BalanceCount - Stores the number of times this processor has run the
+        periodic load balancer.
+
+    MigrationsIn - Stores the number of threads moved onto this processor
+        from another processor.
+
+    MigrationsOut - Stores the number of threads moved off of this processor
+        onto another processor.
+
+    IdleSteals - Stores the number of threads this processor pulled from
+        another processor because it had nothing to run.
+
+    BalancePulls - Stores the number of threads this processor pulled from a
+        busier processor during periodic balancing.
+
+    BalancePushes - Stores the number of threads this processor pushed to an
+        idle processor during periodic balancing.
+
+    WakeMigrations - Stores the number of threads that were moved onto this
+        processor when they were woken.
+
+--*/
+
+typedef struct _SCHEDULER_STATISTICS {
+    ULONGLONG BalanceCount;
+    ULONGLONG MigrationsIn;
+    ULONGLONG MigrationsOut;
+    ULONGLONG IdleSteals;
+    ULONGLONG BalancePulls;
+    ULONGLONG BalancePushes;
+    ULONGLONG WakeMigrations;
+} SCHEDULER_STATISTICS, *PSCHEDULER_STATISTICS;
+
+/*++
+
 Structure Description:
 
     This structure contains the scheduler context for a specific processor.
@@ -444,11 +501,54 @@ Structure Description:
 
     Group - Stores the fixed head scheduling group for this processor.
 
+    RealTimeMask - Stores a bitmask of which real-time ready lists are not
+        empty. Bit zero corresponds to the lowest real-time priority.
+
+    RealTime - Stores the array of real-time ready lists, indexed by priority.
+        Real-time threads are queued directly on the processor regardless of
+        which group they belong to.
+
+    Granularity - Stores the minimum virtual runtime lead, in processor counter
+        ticks, another fair thread must have before it preempts the running
+        one.
+
+    WakeupCredit - Stores the maximum amount of virtual runtime, in processor
+        counter ticks, a fair thread is placed behind its group's minimum when
+        it wakes up.
+
+    Quantum - Stores the time slice of round robin threads, in processor
+        counter ticks.
+
+    BalanceInterval - Stores the period of the load balancer, in time counter
+        ticks.
+
+    MigrationCost - Stores the amount of time, in time counter ticks, a thread
+        must stay on a processor after migrating before it can be migrated
+        again.
+
+    NextBalanceTime - Stores the time counter value at which the load balancer
+        should next run on this processor.
+
+    LoadAverage - Stores the decaying average of the number of ready threads
+        on this processor, in units of 1 / SCHEDULER_LOAD_SCALE threads.
+
+    Statistics - Stores the load balancing counters for this processor.
+
 --*/
 
 struct _SCHEDULER_DATA {
     KSPIN_LOCK Lock;
     SCHEDULER_GROUP_ENTRY Group;
+    ULONG RealTimeMask;
+    LIST_ENTRY RealTime[SCHEDULER_REAL_TIME_PRIORITY_COUNT];
+    ULONGLONG Granularity;
+    ULONGLONG WakeupCredit;
+    ULONGLONG Quantum;
+    ULONGLONG BalanceInterval;
+    ULONGLONG MigrationCost;
+    ULONGLONG NextBalanceTime;
+    ULONG LoadAverage;
+    SCHEDULER_STATISTICS Statistics;
 };
 
 /*++
@@ -647,6 +747,16 @@ Structure Description:
 
     CpuVersion - Stores the processor identification information for this CPU.
 
+    PoolCache - Stores a pointer to the memory manager's per-processor cache
+        of small pool allocations.
+
+    PhysicalPageCache - Stores a pointer to the memory manager's
+        per-processor cache of free physical pages.
+
+    CacheDomain - Stores an identifier shared by all processors that share a
+        last level cache with this one. The scheduler prefers to move threads
+        between processors in the same cache domain.
+
 --*/
 
 typedef struct _PROCESSOR_BLOCK PROCESSOR_BLOCK, *PPROCESSOR_BLOCK;
@@ -682,6 +792,9 @@ struct _PROCESSOR_BLOCK {
     PVOID SwapPage;
     UINTN NmiCount;
     PROCESSOR_IDENTIFICATION CpuVersion;
+    PVOID PoolCache;
+    PVOID PhysicalPageCache;
+    ULONG CacheDomain;
 };
 
 /*++
@@ -732,6 +845,35 @@ typedef struct _PROCESSOR_COUNT_INFORMATION {
 
 /*++
 
+Structure Description:
+
+    This structure defines scheduler load balancing information for one or
+    more processors.
+
+Members:
+
+    ProcessorNumber - Stores the processor number to query, or -1 to sum the
+        information for all processors.
+
+    ReadyThreadCount - Stores the number of threads currently ready to run,
+        including running threads.
+
+    LoadAverage - Stores the decaying average of the number of ready threads,
+        in units of 1 / SCHEDULER_LOAD_SCALE threads.
+
+    Statistics - Stores the load balancing counters.
+
+--*/
+
+typedef struct _SCHEDULER_STATISTICS_INFORMATION {
+    UINTN ProcessorNumber;
+    UINTN ReadyThreadCount;
+    ULONG LoadAverage;
+    SCHEDULER_STATISTICS Statistics;
+} SCHEDULER_STATISTICS_INFORMATION, *PSCHEDULER_STATISTICS_INFORMATION;
+
+/*++
+
 Structure Description:
 
     This structure defines a queued lock. These locks can be used at or below
@@ -974,6 +1116,18 @@ Structure Description:
     ProcessorFeatures - Stores a bitfield of architecture-specific feature
         flags.
 
+    TimeCounterSequence - Stores a sequence number guarding the direct time
+        counter members below. It is odd while an update is in progress.
+        Readers should read it, read the other members, and retry if it was
+        odd or has since changed.
+
+    TimeCounterDirect - Stores a boolean indicating whether user mode can
+        compute the time counter by reading the hardware counter itself
+        (rdtsc on PC, CNTVCT on ARM) rather than making a system call.
+
+    TimeCounterDirectOffset - Stores the value to add to the raw hardware
+        counter to get the time counter when direct reads are enabled.
+
 --*/
 
 typedef struct _USER_SHARED_DATA {
@@ -988,6 +1142,9 @@ typedef struct _USER_SHARED_DATA {
     volatile ULONGLONG TickCount;
     volatile ULONGLONG TickCount2;
     ULONG ProcessorFeatures;
+    volatile ULONG TimeCounterSequence;
+    volatile ULONG TimeCounterDirect;
+    volatile ULONGLONG TimeCounterDirectOffset;
 } USER_SHARED_DATA, *PUSER_SHARED_DATA;
 
 //
@@ -2261,6 +2418,7 @@ Return Value:
 
 --*/
 
+KERNEL_API
 ULONG
 KeGetCurrentProcessorNumber (
     VOID
@@ -2283,6 +2441,7 @@ Return Value:
 
 --*/
 
+KERNEL_API
 ULONG
 KeGetActiveProcessorCount (
     VOID
@@ -3278,6 +3437,94 @@ Return Value:
 
 --*/
 
+KSTATUS
+KeSetThreadSchedulingParameters (
+    PKTHREAD Thread,
+    PSCHEDULER_PARAMETERS Parameters
+    );
+
+/*++
+
+Routine Description:
+
+    This routine changes the scheduling policy and priorities of a thread. If
+    the thread is ready, it is requeued according to its new parameters. The
+    caller is responsible for any permission checks.
+
+Arguments:
+
+    Thread - Supplies a pointer to the thread to change.
+
+    Parameters - Supplies a pointer to the new scheduling parameters.
+
+Return Value:
+
+    STATUS_SUCCESS on success.
+
+    STATUS_INVALID_PARAMETER if the policy or one of the priorities is out of
+    range.
+
+--*/
+
+KERNEL_API
+KSTATUS
+KeSetThreadAffinity (
+    PKTHREAD Thread,
+    PPROCESSOR_AFFINITY Affinity
+    );
+
+/*++
+
+Routine Description:
+
+    This routine changes the set of processors a thread is allowed to run on.
+    A ready thread queued on a processor that is no longer allowed is moved
+    immediately. A running thread moves the next time it is scheduled out.
+    The caller is responsible for any permission checks.
+
+Arguments:
+
+    Thread - Supplies a pointer to the thread to change.
+
+    Affinity - Supplies a pointer to the new processor affinity.
+
+Return Value:
+
+    STATUS_SUCCESS on success.
+
+    STATUS_INVALID_PARAMETER if the affinity does not include any active
+    processors.
+
+--*/
+
+KERNEL_API
+KSTATUS
+KeGetSchedulerStatistics (
+    PSCHEDULER_STATISTICS_INFORMATION Information
+    );
+
+/*++
+
+Routine Description:
+
+    This routine returns a snapshot of the scheduler load balancing
+    information for one or all processors.
+
+Arguments:
+
+    Information - Supplies a pointer to the information structure. On input,
+        the processor number field contains the processor to query, or -1 to
+        sum the information for all processors. On output, the remaining
+        fields are filled in.
+
+Return Value:
+
+    STATUS_SUCCESS on success.
+
+    STATUS_INVALID_PARAMETER if an invalid processor number was supplied.
+
+--*/
+
 VOID
 KeIdleLoop (
     VOID
@@ -208,6 +208,14 @@ Module Name:
 
 #define SOCKET_IO_DONT_ROUTE 0x00000100
 
+//
+// This flag applies to multiple message receives. It requests that the
+// operation block only until the first message arrives, and then collect
+// whatever other messages are already waiting without blocking.
+//
+
+#define SOCKET_IO_WAIT_FOR_ONE 0x00000200
+
 //
 // Define common internet protocol numbers, as defined by the IANA.
 //
@@ -311,7 +319,8 @@ typedef enum _NET_DOMAIN_TYPE {
     NetDomainArp = NET_DOMAIN_LOW_LEVEL_NETWORK_BASE,
     NetDomainEapol,
     NetDomainEthernet = NET_DOMAIN_PHYSICAL_BASE,
-    NetDomain80211
+    NetDomain80211,
+    NetDomainLoopback
 } NET_DOMAIN_TYPE, *PNET_DOMAIN_TYPE;
 
 typedef enum _NET_SOCKET_TYPE {
@@ -717,6 +726,14 @@ Enumeration Description:
         probes to be sent, without response, before the connection is aborted.
         This option takes a ULONG.
 
+    SocketTcpOptionCongestionControl - Indicates the congestion control
+        algorithm used by the socket. This option takes a ULONG, one of the
+        SOCKET_TCP_CONGESTION_ALGORITHM values.
+
+    SocketTcpOptionPacing - Indicates whether outgoing data is spread out over
+        the round trip time rather than sent in bursts. This option takes a
+        ULONG boolean.
+
     SocketTcpOptionCount - Indicates the number of TCP socket options.
 
 --*/
@@ -726,11 +743,39 @@ typedef enum _SOCKET_TCP_OPTION {
     SocketTcpOptionNoDelay,
     SocketTcpOptionKeepAliveTimeout,
     SocketTcpOptionKeepAlivePeriod,
-    SocketTcpOptionKeepAliveProbeLimit
+    SocketTcpOptionKeepAliveProbeLimit,
+    SocketTcpOptionCongestionControl,
+    SocketTcpOptionPacing
 } SOCKET_TCP_OPTION, *PSOCKET_TCP_OPTION;
 
 /*++
 
+Enumeration Description:
+
+    This enumeration describes the TCP congestion control algorithms that can
+    be selected with the congestion control TCP socket option.
+
+Values:
+
+    SocketTcpCongestionNewReno - Indicates the New Reno algorithm.
+
+    SocketTcpCongestionCubic - Indicates the CUBIC algorithm, which grows the
+        window as a function of the time since the last loss rather than the
+        number of round trips, and so recovers faster on links with a large
+        bandwidth-delay product.
+
+    SocketTcpCongestionAlgorithmCount - Indicates the number of algorithms.
+
+--*/
+
+typedef enum _SOCKET_TCP_CONGESTION_ALGORITHM {
+    SocketTcpCongestionNewReno,
+    SocketTcpCongestionCubic,
+    SocketTcpCongestionAlgorithmCount
+} SOCKET_TCP_CONGESTION_ALGORITHM, *PSOCKET_TCP_CONGESTION_ALGORITHM;
+
+/*++
+
 Structure Description:
 
     This structure defines the common portion of a socket that must be at the
@@ -825,6 +870,26 @@ typedef struct _SOCKET_IO_PARAMETERS {
 
 /*++
 
+Structure Description:
+
+    This structure defines one message of a multiple message socket I/O
+    request.
+
+Members:
+
+    Parameters - Stores the socket I/O parameters for this message.
+
+    IoBuffer - Stores a pointer to the I/O buffer holding the message data.
+
+--*/
+
+typedef struct _SOCKET_IO_MESSAGE {
+    SOCKET_IO_PARAMETERS Parameters;
+    PIO_BUFFER IoBuffer;
+} SOCKET_IO_MESSAGE, *PSOCKET_IO_MESSAGE;
+
+/*++
+
 Structure Description:
 
     This structure defines a socket control message, the header for the socket
@@ -973,6 +1038,7 @@ typedef
 KSTATUS
 (*PNET_ACCEPT) (
     PSOCKET Socket,
+    BOOL NonBlocking,
     PIO_HANDLE *NewConnectionSocket,
     PNETWORK_ADDRESS RemoteAddress
     );
@@ -988,6 +1054,11 @@ Routine Description:
 
     Socket - Supplies a pointer to the socket to accept a connection from.
 
+    NonBlocking - Supplies a boolean indicating whether to fail with
+        STATUS_OPERATION_WOULD_BLOCK rather than wait if no connection is
+        pending. The accept also never waits if the socket's handle was
+        opened non-blocking.
+
     NewConnectionSocket - Supplies a pointer where a new socket will be
         returned that represents the accepted connection with the remote
         host.
@@ -1122,6 +1193,46 @@ Return Value:
 
 --*/
 
+typedef
+KSTATUS
+(*PNET_SEND_MESSAGES) (
+    BOOL FromKernelMode,
+    PSOCKET Socket,
+    PSOCKET_IO_MESSAGE Messages,
+    ULONG MessageCount,
+    PULONG MessagesCompleted
+    );
+
+/*++
+
+Routine Description:
+
+    This routine sends a batch of messages through the network. Messages are
+    sent in order, and sending stops at the first message that fails.
+
+Arguments:
+
+    FromKernelMode - Supplies a boolean indicating whether the request is
+        coming from kernel mode (TRUE) or user mode (FALSE).
+
+    Socket - Supplies a pointer to the socket to send the data to.
+
+    Messages - Supplies an array of messages to send. The parameters are
+        always kernel mode pointers.
+
+    MessageCount - Supplies the number of elements in the message array.
+
+    MessagesCompleted - Supplies a pointer where the number of messages sent
+        will be returned.
+
+Return Value:
+
+    STATUS_SUCCESS if every message was sent.
+
+    Otherwise, returns the status of the message that stopped the batch.
+
+--*/
+
 typedef
 KSTATUS
 (*PNET_GET_SET_SOCKET_INFORMATION) (
@@ -1279,6 +1390,9 @@ Structure Description:
     UserControl - Stores a pointer to a function used to support ioctls to
         sockets.
 
+    SendMessages - Stores a pointer to a function used to send a batch of
+        messages into a socket.
+
 --*/
 
 typedef struct _NET_INTERFACE {
@@ -1294,6 +1408,7 @@ typedef struct _NET_INTERFACE {
     PNET_GET_SET_SOCKET_INFORMATION GetSetSocketInformation;
     PNET_SHUTDOWN Shutdown;
     PNET_USER_CONTROL UserControl;
+    PNET_SEND_MESSAGES SendMessages;
 } NET_INTERFACE, *PNET_INTERFACE;
 
 //
@@ -1519,6 +1634,7 @@ KERNEL_API
 KSTATUS
 IoSocketAccept (
     PIO_HANDLE Handle,
+    BOOL NonBlocking,
     PIO_HANDLE *NewConnectionSocket,
     PNETWORK_ADDRESS RemoteAddress,
     PCSTR *RemotePath,
@@ -1536,6 +1652,11 @@ Routine Description:
 
     Handle - Supplies a pointer to the socket to accept a connection from.
 
+    NonBlocking - Supplies a boolean indicating whether to fail with
+        STATUS_OPERATION_WOULD_BLOCK rather than wait if no connection is
+        pending. The accept also never waits if the socket's handle was
+        opened non-blocking.
+
     NewConnectionSocket - Supplies a pointer where a new socket will be
         returned that represents the accepted connection with the remote
         host.
@@ -1669,6 +1790,89 @@ Return Value:
 
 --*/
 
+KERNEL_API
+KSTATUS
+IoSocketSendMessages (
+    BOOL FromKernelMode,
+    PIO_HANDLE Handle,
+    PSOCKET_IO_MESSAGE Messages,
+    ULONG MessageCount,
+    PULONG MessagesCompleted
+    );
+
+/*++
+
+Routine Description:
+
+    This routine sends a batch of messages through the network. Messages are
+    sent in order, and sending stops at the first message that fails.
+
+Arguments:
+
+    FromKernelMode - Supplies a boolean indicating if the request is coming
+        from kernel mode or user mode. This value affects the root path node
+        to traverse for local domain sockets.
+
+    Handle - Supplies a pointer to the socket to send the data to.
+
+    Messages - Supplies an array of messages to send.
+
+    MessageCount - Supplies the number of elements in the message array.
+
+    MessagesCompleted - Supplies a pointer where the number of messages sent
+        will be returned.
+
+Return Value:
+
+    STATUS_SUCCESS if every message was sent.
+
+    Otherwise, returns the status of the message that stopped the batch.
+
+--*/
+
+KERNEL_API
+KSTATUS
+IoSocketReceiveMessages (
+    BOOL FromKernelMode,
+    PIO_HANDLE Handle,
+    PSOCKET_IO_MESSAGE Messages,
+    ULONG MessageCount,
+    PULONG MessagesCompleted
+    );
+
+/*++
+
+Routine Description:
+
+    This routine receives a batch of messages from a socket. Messages are
+    received in order, and receiving stops at the first message that fails.
+    If a message's flags include SOCKET_IO_WAIT_FOR_ONE, that message does not
+    block unless it is the first.
+
+Arguments:
+
+    FromKernelMode - Supplies a boolean indicating if the request is coming
+        from kernel mode or user mode. This value affects the root path node
+        to traverse for local domain sockets.
+
+    Handle - Supplies a pointer to the socket to receive data from.
+
+    Messages - Supplies an array of messages to receive into.
+
+    MessageCount - Supplies the number of elements in the message array.
+
+    MessagesCompleted - Supplies a pointer where the number of messages
+        received will be returned. A message that reached the end of the file
+        counts as received.
+
+Return Value:
+
+    STATUS_SUCCESS if every message was received.
+
+    Otherwise, returns the status of the message that stopped the batch.
+
+--*/
+
 KERNEL_API
 KSTATUS
 IoSocketGetSetInformation (
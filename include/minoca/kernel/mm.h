@@ -91,9 +91,30 @@ Module Name:
 
 #define USER_STACK_HEADROOM (128 * _1MB)
 #define USER_STACK_MAX (((UINTN)MAX_USER_ADDRESS + 1) * 3 / 4)
-#define MM_STATISTICS_VERSION 1
+#define MM_STATISTICS_VERSION 3
 #define MM_STATISTICS_MAX_VERSION 0x10000000
 
+//
+// Define the memory statistics version that added the physical page
+// allocator counters. Callers passing an older version get a structure that
+// ends just before them.
+//
+
+#define MM_STATISTICS_PHYSICAL_BLOCKS_VERSION 2
+
+//
+// Define the memory statistics version that added the large page counters.
+//
+
+#define MM_STATISTICS_LARGE_PAGES_VERSION 3
+
+//
+// Define the number of block sizes the physical page allocator keeps free
+// lists for. Blocks of order N are 2^N pages.
+//
+
+#define MM_PHYSICAL_BLOCK_ORDER_COUNT 11
+
 //
 // Define flags for memory accounting systems.
 //
@@ -146,6 +167,7 @@ Module Name:
 #define IMAGE_SECTION_DESTROYED         0x00000200
 #define IMAGE_SECTION_WAS_WRITABLE      0x00000400
 #define IMAGE_SECTION_PAGE_CACHE_BACKED 0x00000800
+#define IMAGE_SECTION_NO_LARGE_PAGES    0x00001000
 
 //
 // Define a mask of image section flags that should be transfered when an image
@@ -171,7 +193,7 @@ Module Name:
 
 #define IMAGE_SECTION_INTERNAL_MASK \
     (IMAGE_SECTION_BACKED | IMAGE_SECTION_NO_IMAGE_BACKING | \
-     IMAGE_SECTION_PAGE_CACHE_BACKED)
+     IMAGE_SECTION_PAGE_CACHE_BACKED | IMAGE_SECTION_NO_LARGE_PAGES)
 
 //
 // Define flags used for unmapping image sections.
@@ -677,6 +699,37 @@ Structure Description:
     NonPagedPhysicalPages - Stores the number of physical pages that are
         pinned in memory and cannot be paged out to disk.
 
+    CachedPhysicalPages - Stores the number of free physical pages sitting in
+        per-processor caches. These are counted as allocated and non-paged
+        above.
+
+    FreePhysicalBlocks - Stores the number of free blocks of each order in
+        the physical page allocator. A system whose free memory is all in low
+        order blocks is fragmented.
+
+    PageAllocations - Stores the number of single page allocations.
+
+    PageCacheHits - Stores the number of single page allocations satisfied
+        directly from a processor's page cache.
+
+    BlockAllocations - Stores the number of times a block was taken from the
+        buddy allocator, either for a cache refill or a multi-page allocation.
+
+    BlockAllocationCycles - Stores the total number of processor counter
+        cycles spent acquiring the buddy allocator's lock and taking blocks.
+
+    MaxBlockAllocationCycles - Stores the longest single block allocation, in
+        processor counter cycles.
+
+    LargePageAllocations - Stores the number of times a whole large page
+        region of user mode memory was faulted in at once.
+
+    LargePagePromotions - Stores the number of times a region of user mode
+        memory went from individual page mappings to a large page mapping.
+
+    LargePageSplits - Stores the number of times a large page mapping was
+        split back into individual page mappings.
+
 --*/
 
 typedef struct _MM_STATISTICS {
@@ -687,8 +740,26 @@ typedef struct _MM_STATISTICS {
     UINTN PhysicalPages;
     UINTN AllocatedPhysicalPages;
     UINTN NonPagedPhysicalPages;
+    UINTN CachedPhysicalPages;
+    UINTN FreePhysicalBlocks[MM_PHYSICAL_BLOCK_ORDER_COUNT];
+    ULONGLONG PageAllocations;
+    ULONGLONG PageCacheHits;
+    ULONGLONG BlockAllocations;
+    ULONGLONG BlockAllocationCycles;
+    ULONGLONG MaxBlockAllocationCycles;
+    ULONGLONG LargePageAllocations;
+    ULONGLONG LargePagePromotions;
+    ULONGLONG LargePageSplits;
 } MM_STATISTICS, *PMM_STATISTICS;
 
+//
+// Define the sizes of the memory statistics structure for callers that pass
+// an older version.
+//
+
+#define MM_STATISTICS_V1_SIZE FIELD_OFFSET(MM_STATISTICS, CachedPhysicalPages)
+#define MM_STATISTICS_V2_SIZE FIELD_OFFSET(MM_STATISTICS, LargePageAllocations)
+
 /*++
 
 Structure Description:
@@ -2141,7 +2212,8 @@ Routine Description:
         success. The caller should zero this buffer beforehand and set the
         version member to MM_STATISTICS_VERSION. Failure to zero the structure
         beforehand may result in uninitialized data when a driver built for a
-        newer OS is run on an older OS.
+        newer OS is run on an older OS. Older versions are accepted, and only
+        the members that version defines are filled in.
 
 Return Value:
 
@@ -2660,6 +2732,33 @@ Return Value:
 
 --*/
 
+INTN
+MmSysAdviseMemory (
+    PVOID SystemCallParameter
+    );
+
+/*++
+
+Routine Description:
+
+    This routine responds to system calls from user mode passing a hint about
+    the expected access pattern of a region of memory. Hints for regions
+    mapped from files are passed along to the page cache.
+
+Arguments:
+
+    SystemCallParameter - Supplies a pointer to the parameters supplied with
+        the system call. This structure will be a stack-local copy of the
+        actual parameters passed from user-mode.
+
+Return Value:
+
+    STATUS_SUCCESS or positive integer on success.
+
+    Error status code on failure.
+
+--*/
+
 INTN
 MmSysSetBreak (
     PVOID SystemCallParameter
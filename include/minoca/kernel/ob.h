@@ -127,6 +127,8 @@ typedef enum _OBJECT_TYPE {
     ObjectTerminalMaster,
     ObjectTerminalSlave,
     ObjectSharedMemoryObject,
+    ObjectEventQueue,
+    ObjectIoRing,
     ObjectMaxTypes
 } OBJECT_TYPE, *POBJECT_TYPE;
 
@@ -122,6 +122,35 @@ Module Name:
 #define PsIsSessionLeader(_Process) \
     ((_Process)->Identifiers.SessionId == (_Process)->Identifiers.ProcessId)
 
+//
+// These macros manipulate processor affinity masks.
+//
+
+#define PROCESSOR_AFFINITY_WORD(_Processor) \
+    ((_Processor) / PROCESSOR_AFFINITY_BITS_PER_WORD)
+
+#define PROCESSOR_AFFINITY_BIT(_Processor) \
+    (1UL << ((_Processor) % PROCESSOR_AFFINITY_BITS_PER_WORD))
+
+#define PROCESSOR_AFFINITY_ADD(_Affinity, _Processor)          \
+    ((_Affinity)->Mask[PROCESSOR_AFFINITY_WORD(_Processor)] |= \
+     PROCESSOR_AFFINITY_BIT(_Processor))
+
+#define PROCESSOR_AFFINITY_REMOVE(_Affinity, _Processor)       \
+    ((_Affinity)->Mask[PROCESSOR_AFFINITY_WORD(_Processor)] &= \
+     ~PROCESSOR_AFFINITY_BIT(_Processor))
+
+//
+// This macro evaluates to non-zero if the given processor is allowed by the
+// affinity mask. Processors beyond what the mask can describe are always
+// allowed.
+//
+
+#define PROCESSOR_AFFINITY_CHECK(_Affinity, _Processor)         \
+    (((_Processor) >= PROCESSOR_AFFINITY_MAX_PROCESSORS) ||     \
+     (((_Affinity)->Mask[PROCESSOR_AFFINITY_WORD(_Processor)] & \
+       PROCESSOR_AFFINITY_BIT(_Processor)) != 0))
+
 //
 // ---------------------------------------------------------------- Definitions
 //
@@ -148,6 +177,39 @@ Module Name:
 #define SUPPLEMENTARY_GROUP_MAX 128
 #define SUPPLEMENTARY_GROUP_MIN 8
 
+//
+// Define the range of nice values for fair scheduling. Lower values get a
+// larger share of the processor.
+//
+
+#define SCHEDULER_NICE_MIN (-20)
+#define SCHEDULER_NICE_MAX 19
+
+//
+// Define the scheduling weight of an entry with a nice value of zero.
+//
+
+#define SCHEDULER_NICE_ZERO_WEIGHT 1024
+
+//
+// Define the range of real-time priorities. Higher values run first.
+//
+
+#define SCHEDULER_REAL_TIME_PRIORITY_MIN 1
+#define SCHEDULER_REAL_TIME_PRIORITY_MAX 32
+#define SCHEDULER_REAL_TIME_PRIORITY_COUNT \
+    (SCHEDULER_REAL_TIME_PRIORITY_MAX - SCHEDULER_REAL_TIME_PRIORITY_MIN + 1)
+
+//
+// Define the number of processors that can be described in a processor
+// affinity mask. Processors beyond this limit are always allowed.
+//
+
+#define PROCESSOR_AFFINITY_MAX_PROCESSORS 128
+#define PROCESSOR_AFFINITY_BITS_PER_WORD (sizeof(ULONG) * BITS_PER_BYTE)
+#define PROCESSOR_AFFINITY_WORD_COUNT \
+    (PROCESSOR_AFFINITY_MAX_PROCESSORS / PROCESSOR_AFFINITY_BITS_PER_WORD)
+
 //
 // Define privileged permission bit indices.
 //
@@ -607,10 +669,27 @@ typedef enum _SCHEDULER_ENTRY_TYPE {
     SchedulerEntryGroup,
 } SCHEDULER_ENTRY_TYPE, *PSCHEDULER_ENTRY_TYPE;
 
+//
+// Define the scheduling policies. Fair threads share the processor in
+// proportion to the weight derived from their nice value. Real-time threads
+// always run ahead of fair threads, and among themselves by priority. FIFO
+// threads run until they block or yield, round robin threads also give way to
+// peers of the same priority when their time slice expires.
+//
+
+typedef enum _SCHEDULER_POLICY {
+    SchedulerPolicyInvalid,
+    SchedulerPolicyFair,
+    SchedulerPolicyFifo,
+    SchedulerPolicyRoundRobin,
+    SchedulerPolicyCount
+} SCHEDULER_POLICY, *PSCHEDULER_POLICY;
+
 typedef enum _USER_LOCK_OPERATION {
     UserLockInvalid,
     UserLockWait,
     UserLockWake,
+    UserLockRequeue,
 } USER_LOCK_OPERATION, *PUSER_LOCK_OPERATION;
 
 //
@@ -624,7 +703,6 @@ typedef enum _USER_LOCK_OPERATION {
 // TODO: Implement ResourceLimitAddressSpace.
 // TODO: Implement ResourceLimitProcessCount.
 // TODO: Implement ResourceLimitSignals.
-// TODO: Implement ResourceLimitNice.
 //
 
 typedef enum _RESOURCE_LIMIT_TYPE {
@@ -1253,6 +1331,51 @@ typedef struct _RESOURCE_LIMIT {
 
 /*++
 
+Structure Description:
+
+    This structure stores the scheduling parameters of a thread.
+
+Members:
+
+    Policy - Stores the scheduling policy. See SCHEDULER_POLICY.
+
+    NiceValue - Stores the nice value, used by the fair policy. Valid values
+        are between SCHEDULER_NICE_MIN and SCHEDULER_NICE_MAX.
+
+    RealTimePriority - Stores the real-time priority, used by the FIFO and
+        round robin policies. Valid values are between
+        SCHEDULER_REAL_TIME_PRIORITY_MIN and SCHEDULER_REAL_TIME_PRIORITY_MAX.
+        This is zero for fair threads.
+
+--*/
+
+typedef struct _SCHEDULER_PARAMETERS {
+    SCHEDULER_POLICY Policy;
+    LONG NiceValue;
+    ULONG RealTimePriority;
+} SCHEDULER_PARAMETERS, *PSCHEDULER_PARAMETERS;
+
+/*++
+
+Structure Description:
+
+    This structure stores the set of processors a thread is allowed to run
+    on.
+
+Members:
+
+    Mask - Stores the bitmap of allowed processors, where processor N is
+        bit N % 32 of word N / 32. Use the PROCESSOR_AFFINITY_* macros to
+        manipulate the mask.
+
+--*/
+
+typedef struct _PROCESSOR_AFFINITY {
+    ULONG Mask[PROCESSOR_AFFINITY_WORD_COUNT];
+} PROCESSOR_AFFINITY, *PPROCESSOR_AFFINITY;
+
+/*++
+
 Structure Description:
 
     This structure defines the set of IDs for a process.
@@ -1565,7 +1688,29 @@ Structure Description:
     Parent - Stores the parent group this entry belongs to.
 
     ListEntry - Stores pointers to the next and previous threads in the
-        ready list.
+        real-time ready list.
+
+    TreeNode - Stores the node in the parent group's fair run queue, which is
+        ordered by virtual runtime.
+
+    Parameters - Stores the scheduling policy and priorities of the entry.
+
+    Weight - Stores the fair scheduling weight, derived from the nice value.
+
+    Queued - Stores a boolean indicating whether or not the entry is currently
+        in a ready queue.
+
+    VirtualRuntime - Stores the weighted processor time this entry has
+        consumed, in processor counter ticks. While the entry is not queued
+        this is relative to the minimum virtual runtime of its group.
+
+    RunStart - Stores the processor counter value when the entry's run time
+        was last charged.
+
+    LastMigration - Stores the time counter value when the entry was last
+        moved to a different processor.
+
+    Affinity - Stores the set of processors the entry is allowed to run on.
 
 --*/
 
@@ -1574,6 +1719,14 @@ struct _SCHEDULER_ENTRY {
     SCHEDULER_ENTRY_TYPE Type;
     PSCHEDULER_ENTRY Parent;
     LIST_ENTRY ListEntry;
+    RED_BLACK_TREE_NODE TreeNode;
+    SCHEDULER_PARAMETERS Parameters;
+    ULONG Weight;
+    BOOL Queued;
+    ULONGLONG VirtualRuntime;
+    ULONGLONG RunStart;
+    ULONGLONG LastMigration;
+    PROCESSOR_AFFINITY Affinity;
 };
 
 /*++
@@ -2612,6 +2765,58 @@ Return Value:
 
 --*/
 
+INTN
+PsSysSetSchedulingParameters (
+    PVOID SystemCallParameter
+    );
+
+/*++
+
+Routine Description:
+
+    This routine implements the system call that gets or sets the scheduling
+    policy and priorities of a thread or process.
+
+Arguments:
+
+    SystemCallParameter - Supplies a pointer to the parameters supplied with
+        the system call. This structure will be a stack-local copy of the
+        actual parameters passed from user-mode.
+
+Return Value:
+
+    STATUS_SUCCESS or positive integer on success.
+
+    Error status code on failure.
+
+--*/
+
+INTN
+PsSysSetThreadAffinity (
+    PVOID SystemCallParameter
+    );
+
+/*++
+
+Routine Description:
+
+    This routine implements the system call that gets or sets the set of
+    processors a thread or process is allowed to run on.
+
+Arguments:
+
+    SystemCallParameter - Supplies a pointer to the parameters supplied with
+        the system call. This structure will be a stack-local copy of the
+        actual parameters passed from user-mode.
+
+Return Value:
+
+    STATUS_SUCCESS or positive integer on success.
+
+    Error status code on failure.
+
+--*/
+
 INTN
 PsSysUserLock (
     PVOID SystemCallParameter
@@ -153,6 +153,13 @@ Module Name:
 #define SYS_IO_FLAG_WRITE 0x00000001
 #define SYS_IO_FLAG_MASK  0x00000001
 
+//
+// Define the maximum number of messages in one multiple message socket I/O
+// request.
+//
+
+#define SYS_SOCKET_MESSAGE_MAX 1024
+
 //
 // Define flush flags.
 //
@@ -357,6 +364,17 @@ typedef enum _SYSTEM_CALL_NUMBER {
     SystemCallSetITimer,
     SystemCallSetResourceLimit,
     SystemCallSetBreak,
+    SystemCallSetSchedulingParameters,
+    SystemCallSetThreadAffinity,
+    SystemCallCreateEventQueue,
+    SystemCallControlEventQueue,
+    SystemCallWaitForEventQueue,
+    SystemCallAdviseMemory,
+    SystemCallSplice,
+    SystemCallCreateIoRing,
+    SystemCallEnterIoRing,
+    SystemCallRegisterIoRing,
+    SystemCallSocketPerformMessageIo,
     SystemCallCount
 } SYSTEM_CALL_NUMBER, *PSYSTEM_CALL_NUMBER;
 
@@ -410,6 +428,7 @@ typedef enum _FILE_CONTROL_COMMAND {
     FileControlCommandSetDirectoryFlag,
     FileControlCommandCloseFrom,
     FileControlCommandGetPath,
+    FileControlCommandAdvise,
     FileControlCommandCount
 } FILE_CONTROL_COMMAND, *PFILE_CONTROL_COMMAND;
 
@@ -600,6 +619,43 @@ typedef struct _SYSTEM_CALL_PERFORM_VECTORED_IO {
 
 /*++
 
+Structure Description:
+
+    This structure defines the system call parameters for moving data from one
+    handle to another without passing it through user mode.
+
+Members:
+
+    Source - Stores the handle to read data from.
+
+    Destination - Stores the handle to write data to.
+
+    TimeoutInMilliseconds - Stores the number of milliseconds that the source
+        should be waited on for data before timing out. Use
+        SYS_WAIT_TIME_INDEFINITE to wait forever.
+
+    SourceOffset - Stores the offset in the source to read from. Supply -1ULL
+        to use and advance the source's current file pointer offset.
+
+    DestinationOffset - Stores the offset in the destination to write to.
+        Supply -1ULL to use and advance the destination's current file pointer
+        offset.
+
+    Size - Stores the number of bytes to move on input.
+
+--*/
+
+typedef struct _SYSTEM_CALL_SPLICE {
+    HANDLE Source;
+    HANDLE Destination;
+    ULONG TimeoutInMilliseconds;
+    IO_OFFSET SourceOffset;
+    IO_OFFSET DestinationOffset;
+    INTN Size;
+} SYSCALL_STRUCT SYSTEM_CALL_SPLICE, *PSYSTEM_CALL_SPLICE;
+
+/*++
+
 Structure Description:
 
     This structure defines the system call parameters for the create pipe call.
@@ -1223,6 +1279,29 @@ typedef struct _FILE_PATH {
 
 /*++
 
+Structure Description:
+
+    This structure defines an access pattern hint for a region of a file.
+
+Members:
+
+    Advice - Stores the hint.
+
+    Offset - Stores the offset of the start of the region.
+
+    Size - Stores the size of the region in bytes. Zero means the region runs
+        to the end of the file.
+
+--*/
+
+typedef struct _FILE_ADVICE {
+    IO_ADVICE Advice;
+    ULONGLONG Offset;
+    ULONGLONG Size;
+} FILE_ADVICE, *PFILE_ADVICE;
+
+/*++
+
 Structure Description:
 
     This structure defines union of various parameters used by the file control
@@ -1245,6 +1324,8 @@ Structure Description:
     Owner - Stores the ID of the process to receive signals on asynchronous
         I/O events.
 
+    Advice - Stores the access pattern hint.
+
 --*/
 
 typedef union _FILE_CONTROL_PARAMETERS_UNION {
@@ -1254,6 +1335,7 @@ typedef union _FILE_CONTROL_PARAMETERS_UNION {
     ULONG Flags;
     FILE_PATH FilePath;
     PROCESS_ID Owner;
+    FILE_ADVICE Advice;
 } FILE_CONTROL_PARAMETERS_UNION, *PFILE_CONTROL_PARAMETERS_UNION;
 
 /*++
@@ -2191,6 +2273,30 @@ typedef struct _SYSTEM_CALL_SET_MEMORY_PROTECTION {
 
 /*++
 
+Structure Description:
+
+    This structure defines the system call parameters for passing an access
+    pattern hint for a region of memory.
+
+Members:
+
+    Address - Stores the starting address of the region. This must be aligned
+        to a page boundary.
+
+    Size - Stores the length of the region in bytes.
+
+    Advice - Stores the hint.
+
+--*/
+
+typedef struct _SYSTEM_CALL_ADVISE_MEMORY {
+    PVOID Address;
+    UINTN Size;
+    IO_ADVICE Advice;
+} SYSCALL_STRUCT SYSTEM_CALL_ADVISE_MEMORY, *PSYSTEM_CALL_ADVISE_MEMORY;
+
+/*++
+
 Structure Description:
 
     This structure defines the system call parameters for getting and setting
@@ -2363,6 +2469,8 @@ Structure Description:
     Address - Stores a pointer to the address of the lock.
 
     Value - Stores the value, whose meaning depends on the lock operation.
+        For wake and requeue operations, this stores the number of waiters to
+        wake on input, and returns the number actually woken.
 
     Operation - Stores the type of operation to perform on the lock. This is of
         type USER_LOCK_OPERATION, but is also combined with USER_LOCK_* flags.
@@ -2370,6 +2478,15 @@ Structure Description:
     TimeoutInMilliseconds - Stores the timeout in milliseconds the caller
         should wait. Set to SYS_WAIT_TIME_INDEFINITE to wait forever.
 
+    RequeueAddress - Stores a pointer to the address remaining waiters should
+        be moved to for a requeue operation.
+
+    RequeueCount - Stores the maximum number of waiters to move to the requeue
+        address on input, and returns the number actually moved.
+
+    CompareValue - Stores the value the lock address must still contain for a
+        requeue operation to proceed.
+
 --*/
 
 typedef struct _SYSTEM_CALL_USER_LOCK {
@@ -2377,6 +2494,9 @@ typedef struct _SYSTEM_CALL_USER_LOCK {
     ULONG Value;
     ULONG Operation;
     ULONG TimeoutInMilliseconds;
+    PULONG RequeueAddress;
+    ULONG RequeueCount;
+    ULONG CompareValue;
 } SYSCALL_STRUCT SYSTEM_CALL_USER_LOCK, *PSYSTEM_CALL_USER_LOCK;
 
 /*++
@@ -2512,6 +2632,299 @@ typedef struct _SYSTEM_CALL_SET_RESOURCE_LIMIT {
 
 /*++
 
+Structure Description:
+
+    This structure defines the system call parameters for getting or setting
+    the scheduling parameters of a thread or process.
+
+Members:
+
+    Type - Stores the type of identifier in the ID member. Valid values are
+        ProcessIdProcess, which sets every thread in the process and gets the
+        parameters of the process' first thread, and ProcessIdThread, which
+        identifies a thread in the current process.
+
+    Id - Stores the process or thread ID. Supply zero to use the current
+        process or thread.
+
+    Set - Stores a boolean indicating whether to get the scheduling parameters
+        (FALSE) or set them (TRUE).
+
+    Parameters - Stores the new parameters to set for set operations on input.
+        Returns the previous parameters.
+
+--*/
+
+typedef struct _SYSTEM_CALL_SET_SCHEDULING_PARAMETERS {
+    PROCESS_ID_TYPE Type;
+    PROCESS_ID Id;
+    BOOL Set;
+    SCHEDULER_PARAMETERS Parameters;
+} SYSCALL_STRUCT SYSTEM_CALL_SET_SCHEDULING_PARAMETERS,
+    *PSYSTEM_CALL_SET_SCHEDULING_PARAMETERS;
+
+/*++
+
+Structure Description:
+
+    This structure defines the system call parameters for getting or setting
+    the set of processors a thread or process is allowed to run on.
+
+Members:
+
+    Type - Stores the type of identifier in the ID member. Valid values are
+        ProcessIdProcess, which sets every thread in the process and gets the
+        affinity of the process' first thread, and ProcessIdThread, which
+        identifies a thread in the current process.
+
+    Id - Stores the process or thread ID. Supply zero to use the current
+        process or thread.
+
+    Set - Stores a boolean indicating whether to get the affinity (FALSE) or
+        set it (TRUE).
+
+    Affinity - Stores the new affinity to set for set operations on input.
+        Returns the previous affinity.
+
+--*/
+
+typedef struct _SYSTEM_CALL_SET_THREAD_AFFINITY {
+    PROCESS_ID_TYPE Type;
+    PROCESS_ID Id;
+    BOOL Set;
+    PROCESSOR_AFFINITY Affinity;
+} SYSCALL_STRUCT SYSTEM_CALL_SET_THREAD_AFFINITY,
+    *PSYSTEM_CALL_SET_THREAD_AFFINITY;
+
+/*++
+
+Structure Description:
+
+    This structure defines the system call parameters for creating an event
+    queue.
+
+Members:
+
+    OpenFlags - Stores the set of open flags associated with the handle. Only
+        SYS_OPEN_FLAG_CLOSE_ON_EXECUTE is accepted.
+
+    Handle - Stores the returned handle to the new event queue.
+
+--*/
+
+typedef struct _SYSTEM_CALL_CREATE_EVENT_QUEUE {
+    ULONG OpenFlags;
+    HANDLE Handle;
+} SYSCALL_STRUCT SYSTEM_CALL_CREATE_EVENT_QUEUE,
+    *PSYSTEM_CALL_CREATE_EVENT_QUEUE;
+
+/*++
+
+Structure Description:
+
+    This structure defines the system call parameters for adding, modifying,
+    or removing a handle registration on an event queue.
+
+Members:
+
+    Queue - Stores the handle to the event queue.
+
+    Operation - Stores the operation to perform.
+
+    Handle - Stores the I/O handle whose registration is being changed.
+
+    Event - Stores the events to watch, any EVENT_QUEUE_FLAG_* flags, and the
+        data to report. This is ignored for delete operations.
+
+--*/
+
+typedef struct _SYSTEM_CALL_CONTROL_EVENT_QUEUE {
+    HANDLE Queue;
+    EVENT_QUEUE_OPERATION Operation;
+    HANDLE Handle;
+    EVENT_QUEUE_EVENT Event;
+} SYSCALL_STRUCT SYSTEM_CALL_CONTROL_EVENT_QUEUE,
+    *PSYSTEM_CALL_CONTROL_EVENT_QUEUE;
+
+/*++
+
+Structure Description:
+
+    This structure defines the system call parameters for waiting on an event
+    queue.
+
+Members:
+
+    Queue - Stores the handle to the event queue.
+
+    SignalMask - Stores an optional pointer to a signal mask to set for the
+        duration of the wait.
+
+    Events - Stores a pointer to a buffer where the ready events are returned.
+
+    EventCount - Stores the number of elements in the events array.
+
+    TimeoutInMilliseconds - Stores the number of milliseconds to wait for an
+        event before giving up.
+
+--*/
+
+typedef struct _SYSTEM_CALL_WAIT_FOR_EVENT_QUEUE {
+    HANDLE Queue;
+    PSIGNAL_SET SignalMask;
+    PEVENT_QUEUE_EVENT Events;
+    LONG EventCount;
+    ULONG TimeoutInMilliseconds;
+} SYSCALL_STRUCT SYSTEM_CALL_WAIT_FOR_EVENT_QUEUE,
+    *PSYSTEM_CALL_WAIT_FOR_EVENT_QUEUE;
+
+/*++
+
+Structure Description:
+
+    This structure defines the system call parameters for creating an I/O
+    ring.
+
+Members:
+
+    Ring - Stores a pointer to the user mode memory region backing the ring.
+        This must be at least IO_RING_SIZE bytes for the given counts, and
+        aligned to 8 bytes.
+
+    SubmissionCount - Stores the number of submission entries. This must be a
+        power of two.
+
+    CompletionCount - Stores the number of completion entries. This must be a
+        power of two.
+
+    OpenFlags - Stores the set of open flags associated with the handle. Only
+        SYS_OPEN_FLAG_CLOSE_ON_EXECUTE is accepted, and the handle is always
+        closed on execute since the ring memory does not survive.
+
+    Handle - Stores the returned handle to the new I/O ring.
+
+--*/
+
+typedef struct _SYSTEM_CALL_CREATE_IO_RING {
+    PVOID Ring;
+    ULONG SubmissionCount;
+    ULONG CompletionCount;
+    ULONG OpenFlags;
+    HANDLE Handle;
+} SYSCALL_STRUCT SYSTEM_CALL_CREATE_IO_RING, *PSYSTEM_CALL_CREATE_IO_RING;
+
+/*++
+
+Structure Description:
+
+    This structure defines the system call parameters for submitting requests
+    from an I/O ring and waiting for their completions.
+
+Members:
+
+    Ring - Stores the handle to the I/O ring.
+
+    SubmitCount - Stores the maximum number of submissions to consume.
+
+    WaitCount - Stores the number of completions that should be available in
+        the completion array before returning.
+
+    TimeoutInMilliseconds - Stores the number of milliseconds to wait for the
+        completions before giving up.
+
+--*/
+
+typedef struct _SYSTEM_CALL_ENTER_IO_RING {
+    HANDLE Ring;
+    ULONG SubmitCount;
+    ULONG WaitCount;
+    ULONG TimeoutInMilliseconds;
+} SYSCALL_STRUCT SYSTEM_CALL_ENTER_IO_RING, *PSYSTEM_CALL_ENTER_IO_RING;
+
+/*++
+
+Structure Description:
+
+    This structure defines the system call parameters for registering handles
+    or buffers with an I/O ring.
+
+Members:
+
+    Ring - Stores the handle to the I/O ring.
+
+    Operation - Stores the registration operation to perform.
+
+    Array - Stores a pointer to an array of handles or I/O vectors to
+        register. This is ignored when unregistering.
+
+    Count - Stores the number of elements in the array.
+
+--*/
+
+typedef struct _SYSTEM_CALL_REGISTER_IO_RING {
+    HANDLE Ring;
+    IO_RING_REGISTER_OPERATION Operation;
+    PVOID Array;
+    ULONG Count;
+} SYSCALL_STRUCT SYSTEM_CALL_REGISTER_IO_RING, *PSYSTEM_CALL_REGISTER_IO_RING;
+
+/*++
+
+Structure Description:
+
+    This structure defines one message of a multiple message socket I/O
+    system call.
+
+Members:
+
+    Parameters - Stores the socket I/O parameters for this message. On
+        return, the bytes completed, socket I/O flags, remote path size, and
+        control data size are updated.
+
+    VectorArray - Stores a pointer to an array of I/O vectors holding the
+        message data.
+
+    VectorCount - Stores the number of elements in the vector array.
+
+--*/
+
+typedef struct _SOCKET_MESSAGE {
+    SOCKET_IO_PARAMETERS Parameters;
+    PIO_VECTOR VectorArray;
+    UINTN VectorCount;
+} SOCKET_MESSAGE, *PSOCKET_MESSAGE;
+
+/*++
+
+Structure Description:
+
+    This structure defines the system call parameters for sending or receiving
+    several socket messages with a single system call.
+
+Members:
+
+    Socket - Stores the socket to use.
+
+    MessageArray - Stores a pointer to an array of messages.
+
+    MessageCount - Stores the number of elements in the message array. This
+        can be at most SYS_SOCKET_MESSAGE_MAX.
+
+    IoFlags - Stores the I/O flags for every message. Set SYS_IO_FLAG_WRITE
+        to send, or clear it to receive.
+
+--*/
+
+typedef struct _SYSTEM_CALL_SOCKET_PERFORM_MESSAGE_IO {
+    HANDLE Socket;
+    PSOCKET_MESSAGE MessageArray;
+    ULONG MessageCount;
+    ULONG IoFlags;
+} SYSCALL_STRUCT SYSTEM_CALL_SOCKET_PERFORM_MESSAGE_IO,
+    *PSYSTEM_CALL_SOCKET_PERFORM_MESSAGE_IO;
+
+/*++
+
 Structure Description:
 
     This structure defines a union of all possible system call parameter
@@ -2589,6 +3002,17 @@ typedef union _SYSTEM_CALL_PARAMETER_UNION {
     SYSTEM_CALL_SET_ITIMER SetITimer;
     SYSTEM_CALL_SET_RESOURCE_LIMIT SetResourceLimit;
     SYSTEM_CALL_SET_BREAK SetBreak;
+    SYSTEM_CALL_SET_SCHEDULING_PARAMETERS SetSchedulingParameters;
+    SYSTEM_CALL_SET_THREAD_AFFINITY SetThreadAffinity;
+    SYSTEM_CALL_CREATE_EVENT_QUEUE CreateEventQueue;
+    SYSTEM_CALL_CONTROL_EVENT_QUEUE ControlEventQueue;
+    SYSTEM_CALL_WAIT_FOR_EVENT_QUEUE WaitForEventQueue;
+    SYSTEM_CALL_ADVISE_MEMORY AdviseMemory;
+    SYSTEM_CALL_SPLICE Splice;
+    SYSTEM_CALL_CREATE_IO_RING CreateIoRing;
+    SYSTEM_CALL_ENTER_IO_RING EnterIoRing;
+    SYSTEM_CALL_REGISTER_IO_RING RegisterIoRing;
+    SYSTEM_CALL_SOCKET_PERFORM_MESSAGE_IO SocketPerformMessageIo;
 } SYSCALL_STRUCT SYSTEM_CALL_PARAMETER_UNION, *PSYSTEM_CALL_PARAMETER_UNION;
 
 typedef
@@ -78,6 +78,8 @@ Module Name:
 #define X64_PTE_MASK (X64_PT_MASK << X64_PTE_SHIFT)
 #define X64_PDE_SHIFT 21
 #define X64_PDE_MASK (X64_PT_MASK << X64_PDE_SHIFT)
+#define X64_LARGE_PAGE_SIZE (1ULL << X64_PDE_SHIFT)
+#define X64_LARGE_PAGE_MASK (X64_LARGE_PAGE_SIZE - 1)
 #define X64_PDPE_SHIFT 30
 #define X64_PDPE_MASK (X64_PT_MASK << X64_PDPE_SHIFT)
 #define X64_PML4E_SHIFT 39
@@ -607,6 +609,15 @@ Structure Description:
     ActivePageTables - Stores the number of page table pages that are in
         service for user mode of this process.
 
+    LargePageLock - Stores the spin lock serializing the promotion of page
+        directory entries to large pages and their splitting back.
+
+    LargePageTree - Stores the tree of page tables set aside while their
+        regions are mapped by large page directory entries.
+
+    FreeLargePageList - Stores the list of spare large page records, which
+        allows a split to complete without allocating or freeing pool.
+
 --*/
 
 typedef struct _ADDRESS_SPACE_X64 {
@@ -614,6 +625,9 @@ typedef struct _ADDRESS_SPACE_X64 {
     PHYSICAL_ADDRESS Pml4Physical;
     UINTN AllocatedPageTables;
     UINTN ActivePageTables;
+    KSPIN_LOCK LargePageLock;
+    RED_BLACK_TREE LargePageTree;
+    LIST_ENTRY FreeLargePageList;
 } ADDRESS_SPACE_X64, *PADDRESS_SPACE_X64;
 
 //
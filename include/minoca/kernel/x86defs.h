@@ -237,6 +237,7 @@ Module Name:
 
 #define X86_CPUID_IDENTIFICATION 0x00000000
 #define X86_CPUID_BASIC_INFORMATION 0x00000001
+#define X86_CPUID_CACHE_PARAMETERS 0x00000004
 #define X86_CPUID_MWAIT 0x00000005
 #define X86_CPUID_EXTENDED_IDENTIFICATION 0x80000000
 #define X86_CPUID_EXTENDED_INFORMATION 0x80000001
@@ -256,10 +257,33 @@ Module Name:
 #define X86_CPUID_BASIC_EAX_EXTENDED_FAMILY_MASK (0xFF << 20)
 #define X86_CPUID_BASIC_EAX_EXTENDED_FAMILY_SHIFT 20
 
+#define X86_CPUID_BASIC_EBX_LOGICAL_COUNT_MASK (0xFF << 16)
+#define X86_CPUID_BASIC_EBX_LOGICAL_COUNT_SHIFT 16
+#define X86_CPUID_BASIC_EBX_APIC_ID_MASK (0xFF << 24)
+#define X86_CPUID_BASIC_EBX_APIC_ID_SHIFT 24
+
 #define X86_CPUID_BASIC_ECX_MONITOR (1 << 3)
 #define X86_CPUID_BASIC_EDX_SYSENTER (1 << 11)
 #define X86_CPUID_BASIC_EDX_CMOV (1 << 15)
 #define X86_CPUID_BASIC_EDX_FX_SAVE_RESTORE (1 << 24)
+#define X86_CPUID_BASIC_EDX_HYPERTHREADING (1 << 28)
+
+//
+// Define deterministic cache parameter bits (eax is 4, ecx is the cache
+// index).
+//
+
+#define X86_CPUID_CACHE_EAX_TYPE_MASK 0x0000001F
+#define X86_CPUID_CACHE_EAX_LEVEL_MASK (0x7 << 5)
+#define X86_CPUID_CACHE_EAX_LEVEL_SHIFT 5
+#define X86_CPUID_CACHE_EAX_SHARING_MASK (0xFFF << 14)
+#define X86_CPUID_CACHE_EAX_SHARING_SHIFT 14
+
+//
+// Define the maximum number of cache levels to query.
+//
+
+#define X86_CPUID_CACHE_MAX_INDEX 8
 
 //
 // Define known CPU vendors.
@@ -478,6 +478,12 @@ Structure Description:
     Flags - Stores a bitfield of flags governing the operation of the
         interpreter See CK_CONFIGURATION_* definitions.
 
+    NurserySize - Stores the number of bytes that can be allocated since the
+        last garbage collection before a young collection is triggered. Young
+        collections only traverse objects allocated since the previous
+        collection, plus any older objects that have been written to. Set
+        this to zero to always perform full collections.
+
 --*/
 
 typedef struct _CK_CONFIGURATION {
@@ -492,6 +498,7 @@ typedef struct _CK_CONFIGURATION {
     UINTN MinimumHeapSize;
     ULONG HeapGrowthPercent;
     ULONG Flags;
+    UINTN NurserySize;
 } CK_CONFIGURATION, *PCK_CONFIGURATION;
 
 /*++
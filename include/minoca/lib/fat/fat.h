@@ -834,9 +834,9 @@ FatAllocateFileClusters (
 Routine Description:
 
     This routine expands the file capacity of the given file ID by allocating
-    clusters for it. It does not zero out those clusters, so the usefulness of
-    this function is limited to scenarios where the security of uninitialized
-    disk contents is not a concern.
+    clusters for it, in contiguous runs where possible. It does not zero out
+    those clusters, so the usefulness of this function is limited to scenarios
+    where the security of uninitialized disk contents is not a concern.
 
 Arguments:
 
@@ -495,6 +495,53 @@ Return Value:
 
 --*/
 
+OS_API
+KSTATUS
+OsSplice (
+    HANDLE Source,
+    IO_OFFSET SourceOffset,
+    HANDLE Destination,
+    IO_OFFSET DestinationOffset,
+    UINTN Size,
+    ULONG TimeoutInMilliseconds,
+    PUINTN BytesCompleted
+    );
+
+/*++
+
+Routine Description:
+
+    This routine moves data from one open handle to another inside the kernel,
+    without copying it through a user mode buffer.
+
+Arguments:
+
+    Source - Supplies the handle to read data from.
+
+    SourceOffset - Supplies the offset in the source to read from. Set this to
+        IO_OFFSET_NONE to use and advance the source's current file position.
+
+    Destination - Supplies the handle to write data to.
+
+    DestinationOffset - Supplies the offset in the destination to write to.
+        Set this to IO_OFFSET_NONE to use and advance the destination's current
+        file position.
+
+    Size - Supplies the number of bytes to move.
+
+    TimeoutInMilliseconds - Supplies the number of milliseconds to wait for
+        the source to produce data. Use SYS_WAIT_TIME_INDEFINITE to wait
+        forever.
+
+    BytesCompleted - Supplies a pointer where the number of bytes moved will
+        be returned.
+
+Return Value:
+
+    Status code.
+
+--*/
+
 OS_API
 KSTATUS
 OsFlush (
@@ -891,6 +938,253 @@ Return Value:
 
 --*/
 
+OS_API
+KSTATUS
+OsCreateEventQueue (
+    ULONG Flags,
+    PHANDLE Handle
+    );
+
+/*++
+
+Routine Description:
+
+    This routine creates a new event queue, which watches a persistent set of
+    handles and returns the ones that are ready.
+
+Arguments:
+
+    Flags - Supplies a bitfield of flags governing the new handle. Only
+        SYS_OPEN_FLAG_CLOSE_ON_EXECUTE is permitted.
+
+    Handle - Supplies a pointer where the handle to the new event queue will
+        be returned on success.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+OS_API
+KSTATUS
+OsControlEventQueue (
+    HANDLE Queue,
+    EVENT_QUEUE_OPERATION Operation,
+    HANDLE Handle,
+    PEVENT_QUEUE_EVENT Event
+    );
+
+/*++
+
+Routine Description:
+
+    This routine adds, modifies, or removes a handle's registration on an
+    event queue.
+
+Arguments:
+
+    Queue - Supplies the open event queue handle.
+
+    Operation - Supplies the operation to perform.
+
+    Handle - Supplies the handle to register, change, or remove.
+
+    Event - Supplies a pointer to the poll events and EVENT_QUEUE_FLAG_* flags
+        to watch, and the data to return with each event. This is ignored
+        when removing a registration.
+
+Return Value:
+
+    STATUS_SUCCESS on success.
+
+    STATUS_DUPLICATE_ENTRY if the handle is already registered on an add.
+
+    STATUS_NOT_FOUND if the handle is not registered on a modify or delete.
+
+    STATUS_NOT_SUPPORTED if the handle cannot be watched.
+
+    Other error codes on failure.
+
+--*/
+
+OS_API
+KSTATUS
+OsWaitForEventQueue (
+    HANDLE Queue,
+    PSIGNAL_SET SignalMask,
+    PEVENT_QUEUE_EVENT Events,
+    ULONG EventCount,
+    ULONG TimeoutInMilliseconds,
+    PULONG EventsReturned
+    );
+
+/*++
+
+Routine Description:
+
+    This routine waits for handles registered on an event queue to become
+    ready.
+
+Arguments:
+
+    Queue - Supplies the open event queue handle.
+
+    SignalMask - Supplies an optional pointer to a mask to set for the
+        duration of the wait.
+
+    Events - Supplies a pointer to an array where the ready events will be
+        returned.
+
+    EventCount - Supplies the number of elements in the events array.
+
+    TimeoutInMilliseconds - Supplies the number of milliseconds to wait before
+        giving up.
+
+    EventsReturned - Supplies a pointer where the number of events returned
+        will be stored on success.
+
+Return Value:
+
+    STATUS_SUCCESS if one or more events were returned.
+
+    STATUS_INTERRUPTED if a signal was caught during the wait.
+
+    STATUS_TIMEOUT if no events arrived in the given amount of time.
+
+    STATUS_INVALID_PARAMETER if more than MAX_LONG events are requested.
+
+--*/
+
+OS_API
+KSTATUS
+OsCreateIoRing (
+    PVOID Ring,
+    ULONG SubmissionCount,
+    ULONG CompletionCount,
+    ULONG Flags,
+    PHANDLE Handle
+    );
+
+/*++
+
+Routine Description:
+
+    This routine creates a new I/O ring on top of the given memory. The
+    kernel fills in the ring header.
+
+Arguments:
+
+    Ring - Supplies a pointer to the memory backing the ring. This must be at
+        least IO_RING_SIZE bytes for the given counts, aligned to 8 bytes, and
+        must stay valid for as long as the ring is open.
+
+    SubmissionCount - Supplies the number of submission entries. This must be
+        a power of two.
+
+    CompletionCount - Supplies the number of completion entries. This must be
+        a power of two.
+
+    Flags - Supplies a bitfield of flags governing the new handle. Only
+        SYS_OPEN_FLAG_CLOSE_ON_EXECUTE is permitted, and the handle is always
+        closed on execute.
+
+    Handle - Supplies a pointer where the handle to the new I/O ring will be
+        returned on success.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+OS_API
+KSTATUS
+OsEnterIoRing (
+    HANDLE Ring,
+    ULONG SubmitCount,
+    ULONG WaitCount,
+    ULONG TimeoutInMilliseconds,
+    PULONG Submitted
+    );
+
+/*++
+
+Routine Description:
+
+    This routine hands submissions from an I/O ring to the kernel and
+    optionally waits for completions to arrive.
+
+Arguments:
+
+    Ring - Supplies the open I/O ring handle.
+
+    SubmitCount - Supplies the maximum number of submissions to consume.
+
+    WaitCount - Supplies the number of completions that should be available
+        in the completion array before returning. Supply 0 to not wait.
+
+    TimeoutInMilliseconds - Supplies the number of milliseconds to wait for
+        the completions before giving up.
+
+    Submitted - Supplies a pointer where the number of submissions consumed
+        will be returned. Submissions may be consumed even if the wait fails.
+
+Return Value:
+
+    STATUS_SUCCESS on success.
+
+    STATUS_TIMEOUT if the completions did not arrive in time.
+
+    STATUS_INTERRUPTED if a signal was caught during the wait.
+
+    STATUS_BUFFER_FULL if the completion array has no room for any more
+    requests.
+
+    Other error codes on failure.
+
+--*/
+
+OS_API
+KSTATUS
+OsRegisterIoRing (
+    HANDLE Ring,
+    IO_RING_REGISTER_OPERATION Operation,
+    PVOID Array,
+    ULONG Count
+    );
+
+/*++
+
+Routine Description:
+
+    This routine registers handles or buffers with an I/O ring, or drops the
+    current registrations. Submissions can then name a registered handle or
+    buffer by index, skipping the handle lookup and buffer validation.
+
+Arguments:
+
+    Ring - Supplies the open I/O ring handle.
+
+    Operation - Supplies the registration operation to perform.
+
+    Array - Supplies a pointer to an array of handles or I/O vectors,
+        depending on the operation. This is ignored when unregistering.
+
+    Count - Supplies the number of elements in the array.
+
+Return Value:
+
+    STATUS_SUCCESS on success.
+
+    STATUS_RESOURCE_IN_USE if handles or buffers are already registered.
+
+    STATUS_NOT_FOUND if nothing is registered when unregistering.
+
+    Other error codes on failure.
+
+--*/
+
 OS_API
 PSIGNAL_HANDLER_ROUTINE
 OsSetSignalHandler (
@@ -2153,6 +2447,37 @@ Return Value:
 
 --*/
 
+OS_API
+KSTATUS
+OsAdviseMemory (
+    PVOID Address,
+    UINTN Size,
+    IO_ADVICE Advice
+    );
+
+/*++
+
+Routine Description:
+
+    This routine passes a hint about the expected access pattern of a region
+    of the current process' mapped memory. Hints for regions backed by a file
+    are applied to the file's cached pages.
+
+Arguments:
+
+    Address - Supplies the starting address of the region. This must be
+        aligned to a page boundary.
+
+    Size - Supplies the size of the region, in bytes.
+
+    Advice - Supplies the access pattern hint.
+
+Return Value:
+
+    Status code.
+
+--*/
+
 OS_API
 KSTATUS
 OsSetThreadIdentity (
@@ -2294,6 +2619,97 @@ Return Value:
 
 --*/
 
+OS_API
+KSTATUS
+OsSetSchedulingParameters (
+    PROCESS_ID_TYPE Type,
+    PROCESS_ID Id,
+    PSCHEDULER_PARAMETERS NewParameters,
+    PSCHEDULER_PARAMETERS OldParameters
+    );
+
+/*++
+
+Routine Description:
+
+    This routine gets or sets the scheduling policy and priorities of a thread
+    or process.
+
+Arguments:
+
+    Type - Supplies the type of identifier given. Valid values are
+        ProcessIdProcess, which sets all threads in the process, and
+        ProcessIdThread, which identifies a thread in the current process.
+
+    Id - Supplies the process or thread ID. Supply zero to use the current
+        process or thread.
+
+    NewParameters - Supplies an optional pointer to the new scheduling
+        parameters to set. If this is NULL, then new parameters are not set.
+
+    OldParameters - Supplies an optional pointer where the previous scheduling
+        parameters will be returned.
+
+Return Value:
+
+    STATUS_SUCCESS on success.
+
+    STATUS_INVALID_PARAMETER if the policy or a priority is out of range.
+
+    STATUS_NO_SUCH_PROCESS or STATUS_NO_SUCH_THREAD if the given ID does not
+    exist.
+
+    STATUS_PERMISSION_DENIED if the caller is trying to raise the priority and
+    does not have the scheduling permission.
+
+--*/
+
+OS_API
+KSTATUS
+OsSetThreadAffinity (
+    PROCESS_ID_TYPE Type,
+    PROCESS_ID Id,
+    PPROCESSOR_AFFINITY NewAffinity,
+    PPROCESSOR_AFFINITY OldAffinity
+    );
+
+/*++
+
+Routine Description:
+
+    This routine gets or sets the set of processors a thread or process is
+    allowed to run on.
+
+Arguments:
+
+    Type - Supplies the type of identifier given. Valid values are
+        ProcessIdProcess, which sets all threads in the process, and
+        ProcessIdThread, which identifies a thread in the current process.
+
+    Id - Supplies the process or thread ID. Supply zero to use the current
+        process or thread.
+
+    NewAffinity - Supplies an optional pointer to the new affinity to set. If
+        this is NULL, then the affinity is not changed.
+
+    OldAffinity - Supplies an optional pointer where the previous affinity
+        will be returned.
+
+Return Value:
+
+    STATUS_SUCCESS on success.
+
+    STATUS_INVALID_PARAMETER if the new affinity does not contain any active
+    processors.
+
+    STATUS_NO_SUCH_PROCESS or STATUS_NO_SUCH_THREAD if the given ID does not
+    exist.
+
+    STATUS_PERMISSION_DENIED if the caller is trying to change another user's
+    process and does not have the scheduling permission.
+
+--*/
+
 OS_API
 KSTATUS
 OsCreateTerminal (
@@ -2998,6 +3414,46 @@ Return Value:
 
 --*/
 
+OS_API
+KSTATUS
+OsSocketPerformMessageIo (
+    HANDLE Socket,
+    PSOCKET_MESSAGE Messages,
+    ULONG MessageCount,
+    ULONG IoFlags,
+    PULONG MessagesCompleted
+    );
+
+/*++
+
+Routine Description:
+
+    This routine sends or receives several messages on a socket with a single
+    system call.
+
+Arguments:
+
+    Socket - Supplies a pointer to the socket.
+
+    Messages - Supplies an array of messages. On return, the parameters of
+        each completed message are updated.
+
+    MessageCount - Supplies the number of elements in the message array. This
+        can be at most SYS_SOCKET_MESSAGE_MAX.
+
+    IoFlags - Supplies the I/O flags. Set SYS_IO_FLAG_WRITE to send the
+        messages, or leave it clear to receive them.
+
+    MessagesCompleted - Supplies a pointer where the number of messages
+        completed will be returned.
+
+Return Value:
+
+    Status code. If some messages completed before an error occurred, success
+    is returned along with the count.
+
+--*/
+
 OS_API
 KSTATUS
 OsSocketGetSetInformation (
@@ -4155,6 +4611,55 @@ Return Value:
 
 --*/
 
+OS_API
+KSTATUS
+OsUserLockRequeue (
+    PVOID Address,
+    ULONG Flags,
+    ULONG CompareValue,
+    PULONG WakeCount,
+    PVOID RequeueAddress,
+    PULONG RequeueCount
+    );
+
+/*++
+
+Routine Description:
+
+    This routine wakes some threads blocked on a user mode lock, and moves
+    some of the remaining waiters to block on a second address without waking
+    them. This is useful for waking a single thread blocked on a condition
+    variable and transferring the rest to the associated mutex.
+
+Arguments:
+
+    Address - Supplies a pointer to a 32-bit value representing the lock
+        threads are currently blocked on.
+
+    Flags - Supplies a bitfield of USER_LOCK_* flags governing the operation.
+
+    CompareValue - Supplies the value the given address must still contain
+        for the operation to proceed.
+
+    WakeCount - Supplies a pointer that on input contains the number of
+        threads to wake. On output, contains the number of threads woken.
+
+    RequeueAddress - Supplies a pointer to the 32-bit value remaining waiters
+        should be moved to.
+
+    RequeueCount - Supplies a pointer that on input contains the maximum
+        number of threads to move to the requeue address. On output, contains
+        the number of threads actually moved.
+
+Return Value:
+
+    STATUS_SUCCESS if the operation succeeded.
+
+    STATUS_OPERATION_WOULD_BLOCK if the value at the given address was not
+    equal to the compare value. No threads are woken or moved in this case.
+
+--*/
+
 OS_API
 PVOID
 OsGetTlsAddress (
@@ -3262,6 +3262,32 @@ Return Value:
 
 --*/
 
+RTL_API
+VOID
+RtlInitializeMemoryRoutines (
+    VOID
+    );
+
+/*++
+
+Routine Description:
+
+    This routine detects processor features and selects the fastest
+    implementations of the memory copy, set, and compare routines. Until this
+    is called, those routines only use general purpose registers. This must
+    only be called in environments where vector registers can be freely
+    used, which excludes the kernel.
+
+Arguments:
+
+    None.
+
+Return Value:
+
+    None.
+
+--*/
+
 RTL_API
 BOOL
 RtlAreUuidsEqual (
@@ -6283,6 +6309,38 @@ Return Value:
 
 --*/
 
+RTL_API
+UINTN
+RtlHeapGetAllocationSize (
+    PMEMORY_HEAP Heap,
+    PVOID Memory,
+    PUINTN Tag
+    );
+
+/*++
+
+Routine Description:
+
+    This routine returns the number of usable bytes in an active heap
+    allocation, which may be larger than the size originally requested. The
+    heap does not need to be locked, as the caller owns the allocation and the
+    chunk bookkeeping does not change while it is in use.
+
+Arguments:
+
+    Heap - Supplies the heap the memory was allocated from.
+
+    Memory - Supplies the allocation created by the heap allocation routine.
+
+    Tag - Supplies an optional pointer where the tag the allocation was made
+        with will be returned.
+
+Return Value:
+
+    Returns the usable size of the allocation in bytes.
+
+--*/
+
 RTL_API
 VOID
 RtlHeapProfilerGetStatistics (
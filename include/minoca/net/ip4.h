@@ -37,6 +37,15 @@ Module Name:
 #define IP4_IS_MULTICAST_ADDRESS(_Ip4Address) \
     (((_Ip4Address) & 0x000000F0) == 0x000000E0)
 
+//
+// This macro determines whether or not the given IPv4 address is in the
+// loopback network (127.0.0.0/8). The address is treated as being in network
+// byte order.
+//
+
+#define IP4_IS_LOOPBACK_ADDRESS(_Ip4Address) \
+    (((_Ip4Address) & 0x000000FF) == 0x0000007F)
+
 //
 // ---------------------------------------------------------------- Definitions
 //
@@ -73,6 +82,14 @@ Module Name:
 
 #define IP4_BROADCAST_ADDRESS    0xFFFFFFFF
 
+//
+// Define the address and subnet mask assigned to the loopback link, in CPU
+// byte order.
+//
+
+#define IP4_LOOPBACK_ADDRESS     0x7F000001
+#define IP4_LOOPBACK_SUBNET_MASK 0xFF000000
+
 #define IP4_ADDRESS_SIZE         4
 
 //
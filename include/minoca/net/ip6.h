@@ -33,6 +33,16 @@ Module Name:
     (((_Ip6Address)[0] == 0) && ((_Ip6Address)[1] == 0) && \
      ((_Ip6Address)[2] == 0) && ((_Ip6Address)[3] == 0))
 
+//
+// This macros determines whether or not the given IPv6 address is the
+// loopback address (::1).
+//
+
+#define IP6_IS_LOOPBACK_ADDRESS(_Ip6Address)               \
+    (((_Ip6Address)[0] == 0) && ((_Ip6Address)[1] == 0) && \
+     ((_Ip6Address)[2] == 0) &&                            \
+     ((_Ip6Address)[3] == CPU_TO_NETWORK32(0x00000001)))
+
 //
 // This macros determines whether or not the given IPv6 address is a multicast
 // address.
@@ -135,6 +135,13 @@ Module Name:
     (_ExistingList)->Count += (_AppendList)->Count;                \
     NET_INITIALIZE_PACKET_LIST(_AppendList);
 
+//
+// This macro returns TRUE if the given link is the software loopback link.
+//
+
+#define NET_IS_LOOPBACK_LINK(_Link) \
+    ((_Link)->Properties.DataLinkType == NetDomainLoopback)
+
 //
 // ---------------------------------------------------------------- Definitions
 //
@@ -444,6 +451,10 @@ Structure Description:
         beginning of the footer data (ie the location to store the first byte
         of new footer).
 
+    Cache - Stores a pointer to the core networking library's private
+        bookkeeping used to recycle the buffer when it is freed. Drivers
+        should not touch this.
+
 --*/
 
 typedef struct _NET_PACKET_BUFFER {
@@ -456,6 +467,7 @@ typedef struct _NET_PACKET_BUFFER {
     ULONG DataSize;
     ULONG DataOffset;
     ULONG FooterOffset;
+    PVOID Cache;
 } NET_PACKET_BUFFER, *PNET_PACKET_BUFFER;
 
 /*++
@@ -728,6 +740,9 @@ Structure Description:
     MulticastGroupList - Stores a list of the multicast groups to which this
         link belongs.
 
+    BufferDomain - Stores a pointer to the core networking library's private
+        packet buffer caches for buffers meeting this link's DMA constraints.
+
 --*/
 
 typedef struct _NET_LINK {
@@ -743,6 +758,7 @@ typedef struct _NET_LINK {
     PKEVENT AddressTranslationEvent;
     RED_BLACK_TREE AddressTranslationTree;
     LIST_ENTRY MulticastGroupList;
+    PVOID BufferDomain;
 } NET_LINK, *PNET_LINK;
 
 typedef
@@ -1433,6 +1449,7 @@ typedef
 KSTATUS
 (*PNET_PROTOCOL_ACCEPT) (
     PNET_SOCKET Socket,
+    BOOL NonBlocking,
     PIO_HANDLE *NewConnectionSocket,
     PNETWORK_ADDRESS RemoteAddress
     );
@@ -1448,6 +1465,11 @@ Routine Description:
 
     Socket - Supplies a pointer to the socket to accept a connection from.
 
+    NonBlocking - Supplies a boolean indicating whether to fail with
+        STATUS_OPERATION_WOULD_BLOCK rather than wait if no connection is
+        pending. The accept also never waits if the socket's handle was
+        opened non-blocking.
+
     NewConnectionSocket - Supplies a pointer where a new socket will be
         returned that represents the accepted connection with the remote
         host.
@@ -1569,6 +1591,47 @@ Return Value:
 
 --*/
 
+typedef
+KSTATUS
+(*PNET_PROTOCOL_SEND_MESSAGES) (
+    BOOL FromKernelMode,
+    PNET_SOCKET Socket,
+    PSOCKET_IO_MESSAGE Messages,
+    ULONG MessageCount,
+    PULONG MessagesCompleted
+    );
+
+/*++
+
+Routine Description:
+
+    This routine sends a batch of messages through the network using a
+    specific protocol. Messages are sent in order, and sending stops at the
+    first message that fails.
+
+Arguments:
+
+    FromKernelMode - Supplies a boolean indicating whether the request is
+        coming from kernel mode (TRUE) or user mode (FALSE).
+
+    Socket - Supplies a pointer to the socket to send the data to.
+
+    Messages - Supplies an array of messages to send. The parameters are
+        always kernel mode pointers.
+
+    MessageCount - Supplies the number of elements in the message array.
+
+    MessagesCompleted - Supplies a pointer where the number of messages sent
+        will be returned.
+
+Return Value:
+
+    STATUS_SUCCESS if every message was sent.
+
+    Otherwise, returns the status of the message that stopped the batch.
+
+--*/
+
 typedef
 VOID
 (*PNET_PROTOCOL_PROCESS_RECEIVED_DATA) (
@@ -1801,6 +1864,10 @@ Structure Description:
     UserControl - Stores a pointer to a function used to respond to user
         control (ioctl) requests.
 
+    SendMessages - Stores an optional pointer to a function used to send a
+        batch of messages at once. If this is NULL, each message is sent
+        individually.
+
 --*/
 
 typedef struct _NET_PROTOCOL_INTERFACE {
@@ -1818,6 +1885,7 @@ typedef struct _NET_PROTOCOL_INTERFACE {
     PNET_PROTOCOL_RECEIVE Receive;
     PNET_PROTOCOL_GET_SET_INFORMATION GetSetInformation;
     PNET_PROTOCOL_USER_CONTROL UserControl;
+    PNET_PROTOCOL_SEND_MESSAGES SendMessages;
 } NET_PROTOCOL_INTERFACE, *PNET_PROTOCOL_INTERFACE;
 
 /*++
@@ -42,6 +42,34 @@ Module Name:
 
 #define ATA_SUPPORTED_COMMAND_LBA48 (1 << 26)
 
+//
+// Define SATA capability bits, found in word 76 of the identify data.
+//
+
+#define ATA_SATA_CAPABILITY_NATIVE_COMMAND_QUEUING (1 << 8)
+
+//
+// Define the mask of the queue depth field of the identify data.
+//
+
+#define ATA_QUEUE_DEPTH_MASK 0x001F
+
+//
+// Define the log address of the NCQ command error log, and the bits within
+// the first byte of it.
+//
+
+#define ATA_LOG_NCQ_COMMAND_ERROR 0x10
+#define ATA_NCQ_ERROR_LOG_TAG_MASK 0x1F
+#define ATA_NCQ_ERROR_LOG_NOT_QUEUED 0x80
+
+//
+// Define the shift of the tag in the sector count register of queued
+// commands.
+//
+
+#define ATA_NCQ_TAG_SHIFT 3
+
 //
 // Define values that come out of the LBA1 and LBA2 registers when ATAPI or
 // SATA devices are interrogated using an ATA IDENTIFY command.
@@ -82,6 +110,9 @@ typedef enum _ATA_COMMAND {
     AtaCommandWritePio28        = 0x30,
     AtaCommandWritePio48        = 0x34,
     AtaCommandWriteDma48        = 0x35,
+    AtaCommandReadLogExt        = 0x2F,
+    AtaCommandReadFpdmaQueued   = 0x60,
+    AtaCommandWriteFpdmaQueued  = 0x61,
     AtaCommandPacket            = 0xA0,
     AtaCommandIdentifyPacket    = 0xA1,
     AtaCommandReadDma28         = 0xC8,
@@ -147,6 +178,9 @@ Structure Description:
 
     QueueDepth - Stores the maximum queue depth minus one.
 
+    SataCapabilities - Stores the Serial ATA capabilities, including whether
+        or not native command queuing is supported.
+
     MajorVersion - Stores the major version of the ATA/ATAPI protocol
         supported.
 
@@ -229,7 +263,8 @@ typedef struct _ATA_IDENTIFY_PACKET {
     USHORT MinPioTransferCyclesWithFlow;
     USHORT Reserved7[6];
     USHORT QueueDepth;
-    USHORT Reserved8[4];
+    USHORT SataCapabilities;
+    USHORT Reserved8[3];
     USHORT MajorVersion;
     USHORT MinorVersion;
     ULONG CommandSetSupported;
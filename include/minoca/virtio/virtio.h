@@ -0,0 +1,655 @@
+/*++
+
+Copyright (c) 2026 Minoca Corp.
+
+    This file is licensed under the terms of the GNU General Public License
+    version 3. Alternative licensing terms are available. Contact
+    info@minocacorp.com for details. See the LICENSE file at the root of this
+    project for complete licensing information.
+
+Module Name:
+
+    virtio.h
+
+Abstract:
+
+    This header contains definitions for the virtio core library, which
+    implements the virtio PCI transport and split virtqueues for virtio
+    device drivers.
+
+Author:
+
+    Minoca Corp. 18-Oct-2026
+
+--*/
+
+//
+// ------------------------------------------------------------------- Includes
+//
+
+//
+// --------------------------------------------------------------------- Macros
+//
+
+//
+// ---------------------------------------------------------------- Definitions
+//
+
+#ifndef VIRTIO_API
+
+#define VIRTIO_API __DLLIMPORT
+
+#endif
+
+//
+// Define the PCI vendor ID of all virtio devices.
+//
+
+#define VIRTIO_PCI_VENDOR_ID 0x1AF4
+
+//
+// Define the feature bits common to all virtio devices. Device specific
+// feature bits live below bit 24.
+//
+
+#define VIRTIO_FEATURE_INDIRECT_DESCRIPTORS (1ULL << 28)
+#define VIRTIO_FEATURE_EVENT_INDEX          (1ULL << 29)
+#define VIRTIO_FEATURE_VERSION_1            (1ULL << 32)
+
+//
+// Define virtio buffer flags.
+//
+
+//
+// This flag is set if the device writes into the buffer, rather than reading
+// from it.
+//
+
+#define VIRTIO_BUFFER_FLAG_DEVICE_WRITE 0x00000001
+
+//
+// Define virtio queue flags.
+//
+
+//
+// This flag is set if the queue's service routine must be called at low run
+// level. Otherwise it is called at dispatch level.
+//
+
+#define VIRTIO_QUEUE_FLAG_LOW_LEVEL 0x00000001
+
+//
+// Define the current versions of the device and queue parameters.
+//
+
+#define VIRTIO_DEVICE_PARAMETERS_VERSION 1
+#define VIRTIO_QUEUE_PARAMETERS_VERSION 1
+
+//
+// ------------------------------------------------------ Data Type Definitions
+//
+
+typedef struct _VIRTIO_DEVICE VIRTIO_DEVICE, *PVIRTIO_DEVICE;
+typedef struct _VIRTIO_QUEUE VIRTIO_QUEUE, *PVIRTIO_QUEUE;
+
+typedef
+VOID
+(*PVIRTIO_QUEUE_SERVICE_ROUTINE) (
+    PVOID Context,
+    PVIRTIO_QUEUE Queue
+    );
+
+/*++
+
+Routine Description:
+
+    This routine is called when the device has signaled that it used buffers
+    in a virtqueue. It runs at dispatch level unless the queue was created
+    with the low level flag.
+
+Arguments:
+
+    Context - Supplies the context pointer supplied when the queue was
+        created.
+
+    Queue - Supplies a pointer to the queue that was signaled.
+
+Return Value:
+
+    None.
+
+--*/
+
+typedef
+VOID
+(*PVIRTIO_CONFIGURATION_CHANGE_ROUTINE) (
+    PVOID Context
+    );
+
+/*++
+
+Routine Description:
+
+    This routine is called at low level when the device has signaled a
+    change in its device-specific configuration space.
+
+Arguments:
+
+    Context - Supplies the context pointer supplied when the device was
+        created.
+
+Return Value:
+
+    None.
+
+--*/
+
+/*++
+
+Structure Description:
+
+    This structure defines the parameters used to create a virtio device.
+
+Members:
+
+    Version - Stores the version of this structure. Set to
+        VIRTIO_DEVICE_PARAMETERS_VERSION.
+
+    OsDevice - Stores a pointer to the OS device the driver is attached to.
+
+    DriverFeatures - Stores the bitmask of device specific features the
+        driver understands. The transport features are added by the library.
+
+    ConfigurationChangeRoutine - Stores an optional pointer to a routine to
+        call when the device's configuration space changes.
+
+    Context - Stores a context pointer passed to the configuration change
+        routine.
+
+--*/
+
+typedef struct _VIRTIO_DEVICE_PARAMETERS {
+    ULONG Version;
+    PDEVICE OsDevice;
+    ULONGLONG DriverFeatures;
+    PVIRTIO_CONFIGURATION_CHANGE_ROUTINE ConfigurationChangeRoutine;
+    PVOID Context;
+} VIRTIO_DEVICE_PARAMETERS, *PVIRTIO_DEVICE_PARAMETERS;
+
+/*++
+
+Structure Description:
+
+    This structure defines the parameters used to create a virtqueue.
+
+Members:
+
+    Version - Stores the version of this structure. Set to
+        VIRTIO_QUEUE_PARAMETERS_VERSION.
+
+    Index - Stores the index of the queue on the device.
+
+    MaxSize - Stores the maximum number of descriptors the driver would like
+        in the queue. The queue may be smaller if the device supports fewer.
+        Supply zero to use the device's maximum.
+
+    MaxSegments - Stores the maximum number of buffers the driver will add
+        in one request. If indirect descriptors were negotiated, a request
+        always takes a single ring descriptor, and a table of this many
+        descriptors must fit in a page. Otherwise a request takes one ring
+        descriptor per buffer.
+
+    Processor - Stores the processor the queue's interrupt should be aimed
+        at, when the device has enough interrupt vectors.
+
+    Flags - Stores a bitmask of flags. See VIRTIO_QUEUE_FLAG_* definitions.
+
+    ServiceRoutine - Stores an optional pointer to the routine to call when
+        the device uses buffers in the queue.
+
+    Context - Stores a context pointer passed to the service routine.
+
+--*/
+
+typedef struct _VIRTIO_QUEUE_PARAMETERS {
+    ULONG Version;
+    USHORT Index;
+    USHORT MaxSize;
+    ULONG MaxSegments;
+    ULONG Processor;
+    ULONG Flags;
+    PVIRTIO_QUEUE_SERVICE_ROUTINE ServiceRoutine;
+    PVOID Context;
+} VIRTIO_QUEUE_PARAMETERS, *PVIRTIO_QUEUE_PARAMETERS;
+
+/*++
+
+Structure Description:
+
+    This structure defines a physically contiguous buffer handed to the
+    device.
+
+Members:
+
+    Address - Stores the physical address of the buffer.
+
+    Length - Stores the length of the buffer, in bytes.
+
+    Flags - Stores a bitmask of flags. See VIRTIO_BUFFER_FLAG_* definitions.
+
+--*/
+
+typedef struct _VIRTIO_BUFFER {
+    PHYSICAL_ADDRESS Address;
+    ULONG Length;
+    ULONG Flags;
+} VIRTIO_BUFFER, *PVIRTIO_BUFFER;
+
+//
+// -------------------------------------------------------------------- Globals
+//
+
+//
+// -------------------------------------------------------- Function Prototypes
+//
+
+VIRTIO_API
+KSTATUS
+VirtioCreateDevice (
+    PVIRTIO_DEVICE_PARAMETERS Parameters,
+    PVIRTIO_DEVICE *Device
+    );
+
+/*++
+
+Routine Description:
+
+    This routine creates a virtio device context. This is usually called
+    when the driver attaches to the device.
+
+Arguments:
+
+    Parameters - Supplies a pointer to the device parameters.
+
+    Device - Supplies a pointer where a pointer to the new device will be
+        returned on success.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+VIRTIO_API
+VOID
+VirtioDestroyDevice (
+    PVIRTIO_DEVICE Device
+    );
+
+/*++
+
+Routine Description:
+
+    This routine resets the device, disconnects its interrupts, and destroys
+    its queues and context.
+
+Arguments:
+
+    Device - Supplies a pointer to the device.
+
+Return Value:
+
+    None.
+
+--*/
+
+VIRTIO_API
+KSTATUS
+VirtioProcessResourceRequirements (
+    PVIRTIO_DEVICE Device,
+    PIRP Irp
+    );
+
+/*++
+
+Routine Description:
+
+    This routine filters the resource requirements of a virtio PCI device on
+    its way up. It requests a block of MSI-X vectors, one for configuration
+    changes and one per processor for the queues, with legacy interrupts as
+    the alternative.
+
+Arguments:
+
+    Device - Supplies a pointer to the device.
+
+    Irp - Supplies a pointer to the query resources IRP.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+VIRTIO_API
+KSTATUS
+VirtioStartDevice (
+    PVIRTIO_DEVICE Device,
+    PIRP Irp
+    );
+
+/*++
+
+Routine Description:
+
+    This routine maps the device's registers from its start IRP, resets the
+    device, and negotiates features. Queues can be created once this routine
+    succeeds.
+
+Arguments:
+
+    Device - Supplies a pointer to the device.
+
+    Irp - Supplies a pointer to the start device IRP.
+
+Return Value:
+
+    STATUS_NOT_SUPPORTED if the device does not implement the version 1
+    interface or refuses the driver's features.
+
+    Other status codes.
+
+--*/
+
+VIRTIO_API
+KSTATUS
+VirtioEnableDevice (
+    PVIRTIO_DEVICE Device
+    );
+
+/*++
+
+Routine Description:
+
+    This routine connects the device's interrupts and tells the device the
+    driver is ready. All queues should be created before calling this.
+
+Arguments:
+
+    Device - Supplies a pointer to the device.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+VIRTIO_API
+ULONGLONG
+VirtioGetFeatures (
+    PVIRTIO_DEVICE Device
+    );
+
+/*++
+
+Routine Description:
+
+    This routine returns the features negotiated with the device.
+
+Arguments:
+
+    Device - Supplies a pointer to the device.
+
+Return Value:
+
+    Returns the bitmask of negotiated features.
+
+--*/
+
+VIRTIO_API
+ULONG
+VirtioGetQueueCount (
+    PVIRTIO_DEVICE Device
+    );
+
+/*++
+
+Routine Description:
+
+    This routine returns the number of virtqueues the device implements.
+
+Arguments:
+
+    Device - Supplies a pointer to the device.
+
+Return Value:
+
+    Returns the number of queues.
+
+--*/
+
+VIRTIO_API
+KSTATUS
+VirtioReadConfiguration (
+    PVIRTIO_DEVICE Device,
+    ULONG Offset,
+    PVOID Buffer,
+    ULONG Size
+    );
+
+/*++
+
+Routine Description:
+
+    This routine reads from the device specific configuration space,
+    retrying until the device reports a consistent snapshot.
+
+Arguments:
+
+    Device - Supplies a pointer to the device.
+
+    Offset - Supplies the offset into the device configuration to read.
+
+    Buffer - Supplies a pointer where the data will be returned.
+
+    Size - Supplies the number of bytes to read.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+VIRTIO_API
+KSTATUS
+VirtioCreateQueue (
+    PVIRTIO_DEVICE Device,
+    PVIRTIO_QUEUE_PARAMETERS Parameters,
+    PVIRTIO_QUEUE *Queue
+    );
+
+/*++
+
+Routine Description:
+
+    This routine allocates and enables a split virtqueue. The queue is
+    destroyed along with the device.
+
+Arguments:
+
+    Device - Supplies a pointer to the device.
+
+    Parameters - Supplies a pointer to the queue parameters.
+
+    Queue - Supplies a pointer where a pointer to the queue will be returned.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+VIRTIO_API
+ULONG
+VirtioGetQueueSize (
+    PVIRTIO_QUEUE Queue
+    );
+
+/*++
+
+Routine Description:
+
+    This routine returns the number of descriptors in a virtqueue.
+
+Arguments:
+
+    Queue - Supplies a pointer to the queue.
+
+Return Value:
+
+    Returns the queue size.
+
+--*/
+
+VIRTIO_API
+KSTATUS
+VirtioAddBuffers (
+    PVIRTIO_QUEUE Queue,
+    PVIRTIO_BUFFER Buffers,
+    ULONG Count,
+    PVOID Cookie
+    );
+
+/*++
+
+Routine Description:
+
+    This routine makes a request available to the device. The device is not
+    told until the queue is notified. The caller must synchronize access to
+    the queue.
+
+Arguments:
+
+    Queue - Supplies a pointer to the queue.
+
+    Buffers - Supplies an array of buffers making up the request, in order.
+        All buffers the device reads must come before all buffers it writes.
+
+    Count - Supplies the number of buffers in the array.
+
+    Cookie - Supplies a pointer returned when the device uses the request.
+
+Return Value:
+
+    STATUS_SUCCESS on success.
+
+    STATUS_RESOURCE_IN_USE if the queue does not have enough free
+    descriptors.
+
+--*/
+
+VIRTIO_API
+VOID
+VirtioNotifyQueue (
+    PVIRTIO_QUEUE Queue
+    );
+
+/*++
+
+Routine Description:
+
+    This routine notifies the device of requests added to the queue, unless
+    the device has said it does not need to be told. The caller must
+    synchronize access to the queue.
+
+Arguments:
+
+    Queue - Supplies a pointer to the queue.
+
+Return Value:
+
+    None.
+
+--*/
+
+VIRTIO_API
+BOOL
+VirtioGetUsedBuffer (
+    PVIRTIO_QUEUE Queue,
+    PVOID *Cookie,
+    PULONG Length
+    );
+
+/*++
+
+Routine Description:
+
+    This routine pops the next request used by the device and frees its
+    descriptors. The caller must synchronize access to the queue.
+
+Arguments:
+
+    Queue - Supplies a pointer to the queue.
+
+    Cookie - Supplies a pointer where the request's cookie will be returned.
+
+    Length - Supplies a pointer where the number of bytes the device wrote
+        will be returned.
+
+Return Value:
+
+    TRUE if a used request was returned.
+
+    FALSE if the device has not used any more requests.
+
+--*/
+
+VIRTIO_API
+VOID
+VirtioDisableQueueInterrupts (
+    PVIRTIO_QUEUE Queue
+    );
+
+/*++
+
+Routine Description:
+
+    This routine asks the device not to interrupt when it uses buffers in the
+    queue. This is only a hint. The caller must synchronize access to the
+    queue.
+
+Arguments:
+
+    Queue - Supplies a pointer to the queue.
+
+Return Value:
+
+    None.
+
+--*/
+
+VIRTIO_API
+BOOL
+VirtioEnableQueueInterrupts (
+    PVIRTIO_QUEUE Queue
+    );
+
+/*++
+
+Routine Description:
+
+    This routine asks the device to interrupt the next time it uses a buffer
+    in the queue. The caller must synchronize access to the queue.
+
+Arguments:
+
+    Queue - Supplies a pointer to the queue.
+
+Return Value:
+
+    TRUE if the device already used more buffers, in which case the caller
+    should process them rather than wait for an interrupt.
+
+    FALSE if there is nothing left to process.
+
+--*/
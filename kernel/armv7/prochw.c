@@ -678,6 +678,7 @@ Return Value:
 
     PPROCESSOR_IDENTIFICATION Identification;
     ULONG MainId;
+    ULONG MultiprocessorId;
 
     MainId = ArGetMainIdRegister();
     Identification = &(ProcessorBlock->CpuVersion);
@@ -691,6 +692,21 @@ Return Value:
                             ARM_MAIN_ID_VARIANT_SHIFT;
 
     Identification->Stepping = MainId & ARM_MAIN_ID_REVISION_MASK;
+
+    //
+    // Processors in the same cluster share a level 2 cache, so use the
+    // cluster number as the cache domain for the scheduler.
+    //
+
+    MultiprocessorId = ArGetMultiprocessorIdRegister();
+    if (((MultiprocessorId & MPIDR_MP_EXTENSIONS_ENABLED) != 0) &&
+        ((MultiprocessorId & MPIDR_UNIPROCESSOR_SYSTEM) == 0)) {
+
+        ProcessorBlock->CacheDomain =
+                             (MultiprocessorId & MPIDR_AFFINITY_1_MASK) >>
+                             MPIDR_AFFINITY_1_SHIFT;
+    }
+
     return;
 }
 
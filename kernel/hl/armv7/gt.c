@@ -55,6 +55,12 @@ Module Name:
 #define GT_CONTROL_INTERRUPT_MASKED          0x00000002
 #define GT_CONTROL_TIMER_ENABLE              0x00000001
 
+//
+// Define the bits for the generic timer kernel control register.
+//
+
+#define GT_KERNEL_CONTROL_USER_VIRTUAL_COUNT 0x00000002
+
 //
 // --------------------------------------------------------------------- Macros
 //
@@ -100,6 +106,11 @@ HlpGtSetVirtualTimerControl (
     ULONG Control
     );
 
+VOID
+HlpGtSetKernelControl (
+    ULONG Control
+    );
+
 ULONGLONG
 HlpGtGetVirtualCount (
     VOID
@@ -198,7 +209,8 @@ Return Value:
     Gt.Features = TIMER_FEATURE_ABSOLUTE |
                   TIMER_FEATURE_ONE_SHOT |
                   TIMER_FEATURE_READABLE |
-                  TIMER_FEATURE_PER_PROCESSOR;
+                  TIMER_FEATURE_PER_PROCESSOR |
+                  TIMER_FEATURE_USER_MODE_READABLE;
 
     Gt.CounterBitWidth = 64;
     Gt.CounterFrequency = Frequency;
@@ -258,10 +270,13 @@ Return Value:
 {
 
     //
-    // The timer is already running, just make sure interrupts are off.
+    // The timer is already running, just make sure interrupts are off. Let
+    // user mode read the virtual count so it can query time without a system
+    // call. This runs on every processor.
     //
 
     HlpGtSetVirtualTimerControl(0);
+    HlpGtSetKernelControl(GT_KERNEL_CONTROL_USER_VIRTUAL_COUNT);
     return STATUS_SUCCESS;
 }
 
@@ -951,6 +951,123 @@ Return Value:
     return;
 }
 
+KSTATUS
+HlSetInterruptLineTarget (
+    PKINTERRUPT Interrupt,
+    PPROCESSOR_SET Target
+    )
+
+/*++
+
+Routine Description:
+
+    This routine re-targets an enabled interrupt line at a different set of
+    processors. The interrupt's DPC is queued on whichever processor takes the
+    interrupt, so it follows the line. If the line is shared, the other
+    interrupts connected to it move as well.
+
+Arguments:
+
+    Interrupt - Supplies a pointer to the connected interrupt whose line should
+        be re-targeted.
+
+    Target - Supplies a pointer to the set of processors the line should
+        target.
+
+Return Value:
+
+    STATUS_SUCCESS on success.
+
+    STATUS_NOT_SUPPORTED if the interrupt has no line (such as an MSI-based
+    interrupt), or its line belongs to a secondary interrupt controller.
+
+    STATUS_INVALID_PARAMETER if the line is not enabled or the target is
+    invalid.
+
+    Other error codes if the controller failed to program the line.
+
+--*/
+
+{
+
+    PINTERRUPT_CONTROLLER Controller;
+    ULONG LineOffset;
+    PINTERRUPT_LINES Lines;
+    INTERRUPT_LINE_STATE OldState;
+    PINTERRUPT_LINE_STATE State;
+    KSTATUS Status;
+
+    //
+    // Message signaled interrupts are targeted by the device itself, which
+    // the driver programs using the information from HlGetMsiInformation.
+    //
+
+    if (Interrupt->Line.Type == InterruptLineInvalid) {
+        return STATUS_NOT_SUPPORTED;
+    }
+
+    HlpInterruptAcquireLock();
+    Status = HlpInterruptFindLines(&(Interrupt->Line),
+                                   &Controller,
+                                   &Lines,
+                                   &LineOffset);
+
+    if (!KSUCCESS(Status)) {
+        goto SetInterruptLineTargetEnd;
+    }
+
+    //
+    // Lines on secondary controllers are routed through their parent's line,
+    // which may be shared with many other devices.
+    //
+
+    if (Controller->RunLevel != RunLevelCount) {
+        Status = STATUS_NOT_SUPPORTED;
+        goto SetInterruptLineTargetEnd;
+    }
+
+    State = &(Lines->State[LineOffset].PublicState);
+    if ((State->Flags & INTERRUPT_LINE_STATE_FLAG_ENABLED) == 0) {
+        Status = STATUS_INVALID_PARAMETER;
+        goto SetInterruptLineTargetEnd;
+    }
+
+    RtlCopyMemory(&OldState, State, sizeof(INTERRUPT_LINE_STATE));
+    Status = HlpInterruptConvertProcessorSetToInterruptTarget(
+                                                       Target,
+                                                       &(State->Target));
+
+    if (!KSUCCESS(Status)) {
+        goto SetInterruptLineTargetEnd;
+    }
+
+    //
+    // Lowest priority delivery lets the hardware pick among the targets, which
+    // defeats the purpose of aiming at one processor.
+    //
+
+    if (Target->Target == ProcessorTargetSingleProcessor) {
+        State->Flags &= ~INTERRUPT_LINE_STATE_FLAG_LOWEST_PRIORITY;
+
+    } else if (Target->Target == ProcessorTargetAny) {
+        State->Flags |= INTERRUPT_LINE_STATE_FLAG_LOWEST_PRIORITY;
+    }
+
+    Status = Controller->FunctionTable.SetLineState(Controller->PrivateContext,
+                                                    &(Interrupt->Line),
+                                                    State,
+                                                    NULL,
+                                                    0);
+
+    if (!KSUCCESS(Status)) {
+        RtlCopyMemory(State, &OldState, sizeof(INTERRUPT_LINE_STATE));
+    }
+
+SetInterruptLineTargetEnd:
+    HlpInterruptReleaseLock();
+    return Status;
+}
+
 KERNEL_API
 KSTATUS
 HlGetMsiInformation (
@@ -261,6 +261,50 @@ Return Value:
     return HlProcessorCounter->CounterFrequency;
 }
 
+BOOL
+HlGetUserModeTimeCounterOffset (
+    PULONGLONG Offset
+    )
+
+/*++
+
+Routine Description:
+
+    This routine determines whether user mode can compute the time counter by
+    reading the hardware counter directly. This is only possible if the time
+    counter is a full 64-bit counter that user mode has access to and that
+    ticks at a constant rate through all power states.
+
+Arguments:
+
+    Offset - Supplies a pointer where the value to add to the raw hardware
+        counter to get the time counter will be returned on success.
+
+Return Value:
+
+    TRUE if user mode can read the time counter directly.
+
+    FALSE if user mode must ask the kernel for the time counter.
+
+--*/
+
+{
+
+    PHARDWARE_TIMER Timer;
+
+    Timer = HlTimeCounter;
+    if ((Timer == NULL) ||
+        ((Timer->Features & TIMER_FEATURE_USER_MODE_READABLE) == 0) ||
+        ((Timer->Features & TIMER_FEATURE_VARIANT) != 0) ||
+        (Timer->CounterBitWidth < 64)) {
+
+        return FALSE;
+    }
+
+    READ_INT64_SYNC(&(Timer->SoftwareOffset), Offset);
+    return TRUE;
+}
+
 KERNEL_API
 VOID
 HlBusySpin (
@@ -46,6 +46,7 @@ function build() {
         "devrem.c",
         "devres.c",
         "driver.c",
+        "evqueue.c",
         "fileobj.c",
         "filesys.c",
         "flock.c",
@@ -55,6 +56,7 @@ function build() {
         "intrupt.c",
         "iobase.c",
         "iohandle.c",
+        "ioring.c",
         "irp.c",
         "mount.c",
         "obfs.c",
@@ -69,6 +71,7 @@ function build() {
         "pwropt.c",
         "shmemobj.c",
         "socket.c",
+        "splice.c",
         "stream.c",
         "testhook.c",
         "unsocket.c",
@@ -96,6 +96,35 @@ typedef struct _IO_WRITE_CONTEXT {
     ULONG IoFlags;
 } IO_WRITE_CONTEXT, *PIO_WRITE_CONTEXT;
 
+/*++
+
+Structure Description:
+
+    This structure defines a request to read a region of a file into the page
+    cache in the background.
+
+Members:
+
+    FileObject - Stores a pointer to the file object to read. A reference is
+        held on the file object for the duration of the request.
+
+    Handle - Stores an optional pointer to the I/O handle whose read-ahead
+        state started the request. A reference is held on the handle, and its
+        in-flight flag is cleared when the request completes.
+
+    Offset - Stores the page-aligned starting offset of the region to read.
+
+    Size - Stores the size of the region to read, in bytes.
+
+--*/
+
+typedef struct _IO_READ_AHEAD_REQUEST {
+    PFILE_OBJECT FileObject;
+    PIO_HANDLE Handle;
+    IO_OFFSET Offset;
+    ULONGLONG Size;
+} IO_READ_AHEAD_REQUEST, *PIO_READ_AHEAD_REQUEST;
+
 //
 // ----------------------------------------------- Internal Function Prototypes
 //
@@ -161,6 +190,31 @@ IopPerformDefaultPartialWrite (
     UINTN IoBufferOffset
     );
 
+VOID
+IopUpdateReadAhead (
+    PIO_HANDLE Handle,
+    IO_OFFSET Offset,
+    UINTN Size
+    );
+
+KSTATUS
+IopQueueReadAhead (
+    PFILE_OBJECT FileObject,
+    PIO_HANDLE Handle,
+    IO_OFFSET Offset,
+    ULONGLONG Size
+    );
+
+VOID
+IopReadAheadWorker (
+    PVOID Parameter
+    );
+
+VOID
+IopResetReadAhead (
+    PIO_READ_AHEAD_STATE State
+    );
+
 //
 // -------------------------------------------------------------------- Globals
 //
@@ -326,6 +380,20 @@ Return Value:
                                              Handle->DeviceContext);
         }
 
+        //
+        // Sequential reads of regular files start reading ahead of the caller
+        // in the background. Block devices already read ahead on misses.
+        //
+
+        if ((IoContext->BytesCompleted != 0) &&
+            (FileObject->Properties.Type == IoObjectRegularFile) &&
+            (IO_IS_FILE_OBJECT_CACHEABLE(FileObject) != FALSE)) {
+
+            IopUpdateReadAhead(Handle,
+                               StartOffset,
+                               IoContext->BytesCompleted);
+        }
+
         TimeType = FileObjectAccessTime;
     }
 
@@ -482,6 +550,110 @@ Return Value:
     return Status;
 }
 
+KSTATUS
+IopAdviseCacheableObject (
+    PIO_HANDLE Handle,
+    IO_OFFSET Offset,
+    ULONGLONG Size,
+    IO_ADVICE Advice
+    )
+
+/*++
+
+Routine Description:
+
+    This routine applies an access pattern hint to a cacheable file object.
+    The file object must be cacheable.
+
+Arguments:
+
+    Handle - Supplies a pointer to the I/O handle.
+
+    Offset - Supplies the starting file offset of the region the hint applies
+        to.
+
+    Size - Supplies the size of the region in bytes. Supply 0 to apply the hint
+        through the end of the file.
+
+    Advice - Supplies the access pattern hint.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    PFILE_OBJECT FileObject;
+    ULONGLONG FileSize;
+    ULONG PageSize;
+    IO_OFFSET StartOffset;
+    KSTATUS Status;
+
+    FileObject = Handle->FileObject;
+
+    ASSERT(IO_IS_FILE_OBJECT_CACHEABLE(FileObject) != FALSE);
+
+    Status = STATUS_SUCCESS;
+    switch (Advice) {
+
+    //
+    // The access pattern hints change how the handle reads ahead. Start the
+    // window over either way.
+    //
+
+    case IoAdviceNormal:
+    case IoAdviceSequential:
+    case IoAdviceRandom:
+        Handle->ReadAhead.Advice = Advice;
+        IopResetReadAhead(&(Handle->ReadAhead));
+        break;
+
+    //
+    // Read the region into the cache in the background, stopping at the end
+    // of the file.
+    //
+
+    case IoAdviceWillNeed:
+        PageSize = MmPageSize();
+        StartOffset = ALIGN_RANGE_DOWN(Offset, PageSize);
+        KeAcquireSharedExclusiveLockShared(FileObject->Lock);
+        FileSize = FileObject->Properties.Size;
+        KeReleaseSharedExclusiveLockShared(FileObject->Lock);
+        if (StartOffset >= FileSize) {
+            break;
+        }
+
+        if ((Size == 0) || (Size > FileSize - Offset)) {
+            Size = FileSize - Offset;
+        }
+
+        Size += Offset - StartOffset;
+        Status = IopQueueReadAhead(FileObject, NULL, StartOffset, Size);
+        break;
+
+    //
+    // Make the cached pages for the region the first to go when memory is
+    // needed. They are not evicted outright, since other handles or mappings
+    // may still be using them.
+    //
+
+    case IoAdviceDontNeed:
+        KeAcquireSharedExclusiveLockShared(FileObject->Lock);
+        IopDeprioritizePageCacheEntries(FileObject, Offset, Size);
+        KeReleaseSharedExclusiveLockShared(FileObject->Lock);
+        IopResetReadAhead(&(Handle->ReadAhead));
+        break;
+
+    default:
+        Status = STATUS_INVALID_PARAMETER;
+        break;
+    }
+
+    return Status;
+}
+
 //
 // --------------------------------------------------------- Internal Functions
 //
@@ -2446,3 +2618,318 @@ Return Value:
     return Status;
 }
 
+VOID
+IopUpdateReadAhead (
+    PIO_HANDLE Handle,
+    IO_OFFSET Offset,
+    UINTN Size
+    )
+
+/*++
+
+Routine Description:
+
+    This routine records a completed cached read on the given handle and, if
+    the handle is being read sequentially and has caught up to its read-ahead
+    window, starts reading the next window into the page cache in the
+    background. Each window is twice the size of the last, up to a limit. The
+    file object lock must be held.
+
+Arguments:
+
+    Handle - Supplies a pointer to the I/O handle that was read.
+
+    Offset - Supplies the file offset the read started at.
+
+    Size - Supplies the number of bytes read.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    IO_OFFSET End;
+    PFILE_OBJECT FileObject;
+    ULONG PageSize;
+    IO_OFFSET Start;
+    PIO_READ_AHEAD_STATE State;
+    KSTATUS Status;
+    UINTN WindowSize;
+
+    FileObject = Handle->FileObject;
+    State = &(Handle->ReadAhead);
+    if (State->Advice == IoAdviceRandom) {
+        return;
+    }
+
+    End = Offset + Size;
+    if ((Offset != State->NextOffset) &&
+        (State->Advice != IoAdviceSequential)) {
+
+        IopResetReadAhead(State);
+        State->NextOffset = End;
+        return;
+    }
+
+    State->NextOffset = End;
+    if ((End < State->Trigger) ||
+        (MmGetPhysicalMemoryWarningLevel() != MemoryWarningLevelNone)) {
+
+        return;
+    }
+
+    //
+    // The first window starts right after the read. Later windows start where
+    // the last one left off, unless the reader has already passed it.
+    //
+
+    PageSize = MmPageSize();
+    if (State->WindowSize == 0) {
+        WindowSize = IO_READ_AHEAD_INITIAL_SIZE;
+        if (State->Advice == IoAdviceSequential) {
+            WindowSize = IO_READ_AHEAD_MAX_SIZE;
+        }
+
+        Start = ALIGN_RANGE_UP(End, PageSize);
+
+    } else {
+        WindowSize = State->WindowSize << 1;
+        if (WindowSize > IO_READ_AHEAD_MAX_SIZE) {
+            WindowSize = IO_READ_AHEAD_MAX_SIZE;
+        }
+
+        Start = State->End;
+        if (Start < End) {
+            Start = ALIGN_RANGE_UP(End, PageSize);
+        }
+    }
+
+    if (Start >= FileObject->Properties.Size) {
+        return;
+    }
+
+    //
+    // Only allow one read-ahead at a time per handle. If the last one is
+    // still going, try again on the next read.
+    //
+
+    if (RtlAtomicCompareExchange32(&(State->InFlight), TRUE, FALSE) != FALSE) {
+        return;
+    }
+
+    Status = IopQueueReadAhead(FileObject, Handle, Start, WindowSize);
+    if (!KSUCCESS(Status)) {
+        State->InFlight = FALSE;
+        return;
+    }
+
+    State->WindowSize = WindowSize;
+    State->Trigger = Start;
+    State->End = Start + WindowSize;
+    return;
+}
+
+KSTATUS
+IopQueueReadAhead (
+    PFILE_OBJECT FileObject,
+    PIO_HANDLE Handle,
+    IO_OFFSET Offset,
+    ULONGLONG Size
+    )
+
+/*++
+
+Routine Description:
+
+    This routine queues a work item to read the given region of a file into
+    the page cache.
+
+Arguments:
+
+    FileObject - Supplies a pointer to the file object to read.
+
+    Handle - Supplies an optional pointer to the I/O handle whose in-flight
+        flag should be cleared when the read-ahead completes.
+
+    Offset - Supplies the page-aligned offset to start reading at.
+
+    Size - Supplies the number of bytes to read.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    PIO_READ_AHEAD_REQUEST Request;
+    KSTATUS Status;
+
+    ASSERT(IS_ALIGNED(Offset, MmPageSize()) != FALSE);
+
+    Request = MmAllocatePagedPool(sizeof(IO_READ_AHEAD_REQUEST),
+                                  IO_ALLOCATION_TAG);
+
+    if (Request == NULL) {
+        return STATUS_INSUFFICIENT_RESOURCES;
+    }
+
+    IopFileObjectAddReference(FileObject);
+    if (Handle != NULL) {
+        IoIoHandleAddReference(Handle);
+    }
+
+    Request->FileObject = FileObject;
+    Request->Handle = Handle;
+    Request->Offset = Offset;
+    Request->Size = Size;
+    Status = KeCreateAndQueueWorkItem(NULL,
+                                      WorkPriorityNormal,
+                                      IopReadAheadWorker,
+                                      Request);
+
+    if (!KSUCCESS(Status)) {
+        if (Handle != NULL) {
+            IoIoHandleReleaseReference(Handle);
+        }
+
+        IopFileObjectReleaseReference(FileObject);
+        MmFreePagedPool(Request);
+    }
+
+    return Status;
+}
+
+VOID
+IopReadAheadWorker (
+    PVOID Parameter
+    )
+
+/*++
+
+Routine Description:
+
+    This routine reads a region of a file into the page cache. The data read
+    is discarded; it is the side effect of filling the cache that matters.
+
+Arguments:
+
+    Parameter - Supplies a pointer to the read-ahead request.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    UINTN ChunkSize;
+    PFILE_OBJECT FileObject;
+    IO_CONTEXT IoContext;
+    BOOL LockHeldExclusive;
+    IO_OFFSET Offset;
+    PIO_BUFFER ReadIoBuffer;
+    ULONGLONG Remaining;
+    PIO_READ_AHEAD_REQUEST Request;
+    KSTATUS Status;
+
+    Request = Parameter;
+    FileObject = Request->FileObject;
+    Offset = Request->Offset;
+    Remaining = Request->Size;
+    while (Remaining != 0) {
+        if ((MmGetPhysicalMemoryWarningLevel() != MemoryWarningLevelNone) ||
+            (Offset >= FileObject->Properties.Size)) {
+
+            break;
+        }
+
+        ChunkSize = IO_READ_AHEAD_SIZE;
+        if (ChunkSize > Remaining) {
+            ChunkSize = ALIGN_RANGE_UP(Remaining, MmPageSize());
+        }
+
+        //
+        // Cached reads into an uninitialized buffer just collect references
+        // to the page cache entries, so nothing is copied.
+        //
+
+        ReadIoBuffer = MmAllocateUninitializedIoBuffer(ChunkSize, 0);
+        if (ReadIoBuffer == NULL) {
+            break;
+        }
+
+        IoContext.IoBuffer = ReadIoBuffer;
+        IoContext.Offset = Offset;
+        IoContext.SizeInBytes = ChunkSize;
+        IoContext.BytesCompleted = 0;
+        IoContext.Flags = 0;
+        IoContext.TimeoutInMilliseconds = WAIT_TIME_INDEFINITE;
+        IoContext.Write = FALSE;
+        KeAcquireSharedExclusiveLockShared(FileObject->Lock);
+        LockHeldExclusive = FALSE;
+        Status = IopPerformCachedRead(FileObject,
+                                      &IoContext,
+                                      &LockHeldExclusive);
+
+        if (LockHeldExclusive != FALSE) {
+            KeReleaseSharedExclusiveLockExclusive(FileObject->Lock);
+
+        } else {
+            KeReleaseSharedExclusiveLockShared(FileObject->Lock);
+        }
+
+        MmFreeIoBuffer(ReadIoBuffer);
+        if ((!KSUCCESS(Status)) || (IoContext.BytesCompleted != ChunkSize)) {
+            break;
+        }
+
+        Offset += ChunkSize;
+        Remaining -= ChunkSize;
+    }
+
+    if (Request->Handle != NULL) {
+        Request->Handle->ReadAhead.InFlight = FALSE;
+        IoIoHandleReleaseReference(Request->Handle);
+    }
+
+    IopFileObjectReleaseReference(FileObject);
+    MmFreePagedPool(Request);
+    return;
+}
+
+VOID
+IopResetReadAhead (
+    PIO_READ_AHEAD_STATE State
+    )
+
+/*++
+
+Routine Description:
+
+    This routine shrinks a handle's read-ahead window back down so that the
+    next sequential read starts over with a small window.
+
+Arguments:
+
+    State - Supplies a pointer to the read-ahead state to reset.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    State->Trigger = 0;
+    State->End = 0;
+    State->WindowSize = 0;
+    return;
+}
+
@@ -0,0 +1,1907 @@
+/*++
+
+Copyright (c) 2026 Minoca Corp.
+
+    This file is licensed under the terms of the GNU General Public License
+    version 3. Alternative licensing terms are available. Contact
+    info@minocacorp.com for details. See the LICENSE file at the root of this
+    project for complete licensing information.
+
+Module Name:
+
+    evqueue.c
+
+Abstract:
+
+    This module implements event queues. An event queue holds a persistent
+    set of registered I/O handles. Changes to their I/O object state are
+    pushed onto the queue's ready list as they happen, so waiting only looks
+    at handles that are actually ready rather than rescanning every handle.
+
+Author:
+
+    Minoca Corp. 18-Oct-2026
+
+Environment:
+
+    Kernel
+
+--*/
+
+//
+// ------------------------------------------------------------------- Includes
+//
+
+#include <minoca/kernel/kernel.h>
+#include "iop.h"
+
+//
+// ---------------------------------------------------------------- Definitions
+//
+
+//
+// Define the poll events a registration can watch. Unknown bits are ignored.
+//
+
+#define EVENT_QUEUE_POLL_EVENTS                                 \
+    (POLL_EVENT_IN | POLL_EVENT_IN_HIGH_PRIORITY |              \
+     POLL_EVENT_OUT | POLL_EVENT_OUT_HIGH_PRIORITY |            \
+     POLL_ERROR_EVENTS)
+
+//
+// ------------------------------------------------------ Data Type Definitions
+//
+
+/*++
+
+Enumeration Description:
+
+    This enumeration describes where an event queue entry currently sits.
+
+Values:
+
+    EventQueueEntryIdle - Indicates the entry is not on any list besides the
+        queue's entry list and its object's registration list.
+
+    EventQueueEntryReady - Indicates the entry is on the queue's ready list.
+
+    EventQueueEntryReporting - Indicates a waiter has pulled the entry off the
+        ready list and is checking its events.
+
+    EventQueueEntryZombie - Indicates the registered handle was closed and
+        the entry is on the queue's zombie list waiting to be freed.
+
+--*/
+
+typedef enum _EVENT_QUEUE_ENTRY_STATE {
+    EventQueueEntryIdle,
+    EventQueueEntryReady,
+    EventQueueEntryReporting,
+    EventQueueEntryZombie
+} EVENT_QUEUE_ENTRY_STATE, *PEVENT_QUEUE_ENTRY_STATE;
+
+/*++
+
+Structure Description:
+
+    This structure defines an event queue.
+
+Members:
+
+    Header - Stores the standard object header.
+
+    Lock - Stores a pointer to the queued lock serializing registration
+        changes and waits. It protects the entry list and the armed state of
+        each entry.
+
+    ReadyLock - Stores the spin lock protecting the ready and zombie lists and
+        the state of each entry. This is acquired with an object's notify lock
+        held, never the other way around.
+
+    EntryList - Stores the head of the list of every registration on the
+        queue.
+
+    ReadyList - Stores the head of the list of registrations that may have
+        events to report.
+
+    ZombieList - Stores the head of the list of registrations whose handles
+        have been closed.
+
+    IoState - Stores a pointer to the I/O object state of the queue itself.
+        Its read event is signaled while the ready list is not empty. This
+        state is allocated from non-paged pool.
+
+    FileObject - Stores a pointer to the queue's own file object. No reference
+        is held. The file object is alive for as long as any registration is
+        linked to an object's notify state.
+
+    NotifyWorkItem - Stores a pointer to the work item that sets the queue's
+        own state when a registration becomes ready above low level.
+
+    NotifyPending - Stores a boolean indicating whether the notify work item
+        is queued. It holds a reference on the queue's file object while set.
+
+--*/
+
+typedef struct _EVENT_QUEUE {
+    OBJECT_HEADER Header;
+    PQUEUED_LOCK Lock;
+    KSPIN_LOCK ReadyLock;
+    LIST_ENTRY EntryList;
+    LIST_ENTRY ReadyList;
+    LIST_ENTRY ZombieList;
+    PIO_OBJECT_STATE IoState;
+    PFILE_OBJECT FileObject;
+    PWORK_ITEM NotifyWorkItem;
+    volatile ULONG NotifyPending;
+} EVENT_QUEUE, *PEVENT_QUEUE;
+
+/*++
+
+Structure Description:
+
+    This structure defines a single I/O handle's registration on an event
+    queue.
+
+Members:
+
+    QueueListEntry - Stores pointers to the next and previous registrations on
+        the queue.
+
+    NotifyListEntry - Stores pointers to the next and previous registrations
+        watching the same I/O object state.
+
+    ReadyListEntry - Stores pointers to the next and previous entries on the
+        ready list, a waiter's local report list, or the zombie list.
+
+    Queue - Stores a pointer to the owning event queue.
+
+    Handle - Stores a pointer to the registered I/O handle. No reference is
+        held on the handle; it is only used as an identity.
+
+    FileObject - Stores a pointer to the file object behind the handle. A
+        reference is held, which keeps its I/O object state alive.
+
+    Notify - Stores a pointer to the notify state of the I/O object.
+
+    Events - Stores the mask of poll events the registration watches.
+
+    Flags - Stores the mask of EVENT_QUEUE_FLAG_* flags.
+
+    Data - Stores the opaque data returned with each event.
+
+    State - Stores the current entry state.
+
+    Armed - Stores a boolean indicating whether the entry can be reported.
+        One-shot entries are disarmed after they fire.
+
+    Requeue - Stores a boolean indicating that new events arrived while a
+        waiter was reporting the entry.
+
+    Detached - Stores a boolean indicating the registered handle was closed.
+
+--*/
+
+typedef struct _EVENT_QUEUE_ENTRY {
+    LIST_ENTRY QueueListEntry;
+    LIST_ENTRY NotifyListEntry;
+    LIST_ENTRY ReadyListEntry;
+    PEVENT_QUEUE Queue;
+    PIO_HANDLE Handle;
+    PFILE_OBJECT FileObject;
+    PIO_NOTIFY_STATE Notify;
+    ULONG Events;
+    ULONG Flags;
+    ULONGLONG Data;
+    EVENT_QUEUE_ENTRY_STATE State;
+    BOOL Armed;
+    BOOL Requeue;
+    BOOL Detached;
+} EVENT_QUEUE_ENTRY, *PEVENT_QUEUE_ENTRY;
+
+//
+// ----------------------------------------------- Internal Function Prototypes
+//
+
+VOID
+IopDestroyEventQueue (
+    PVOID Object
+    );
+
+PIO_NOTIFY_STATE
+IopGetNotifyState (
+    PIO_OBJECT_STATE IoState
+    );
+
+PEVENT_QUEUE_ENTRY
+IopFindEventQueueEntry (
+    PEVENT_QUEUE Queue,
+    PIO_HANDLE Handle
+    );
+
+VOID
+IopCheckEventQueueEntry (
+    PEVENT_QUEUE_ENTRY Entry
+    );
+
+BOOL
+IopReadyEventQueueEntry (
+    PEVENT_QUEUE_ENTRY Entry
+    );
+
+VOID
+IopQueueEventQueueNotification (
+    PEVENT_QUEUE Queue
+    );
+
+VOID
+IopEventQueueNotifyWorker (
+    PVOID Parameter
+    );
+
+VOID
+IopRemoveEventQueueEntry (
+    PEVENT_QUEUE_ENTRY Entry
+    );
+
+VOID
+IopReapEventQueueEntries (
+    PEVENT_QUEUE Queue
+    );
+
+ULONG
+IopCollectEventQueueEvents (
+    PEVENT_QUEUE Queue,
+    PEVENT_QUEUE_EVENT Events,
+    ULONG EventCount
+    );
+
+//
+// -------------------------------------------------------------------- Globals
+//
+
+//
+// ------------------------------------------------------------------ Functions
+//
+
+KERNEL_API
+KSTATUS
+IoCreateEventQueue (
+    BOOL FromKernelMode,
+    ULONG OpenFlags,
+    PIO_HANDLE *Handle
+    )
+
+/*++
+
+Routine Description:
+
+    This routine creates and opens a new event queue. An event queue holds a
+    persistent set of registered I/O handles and collects the ones that become
+    ready, so that waiting on it costs time proportional to the number of
+    ready handles rather than the number registered.
+
+Arguments:
+
+    FromKernelMode - Supplies a boolean indicating whether this request is
+        originating from kernel mode (TRUE) or user mode (FALSE).
+
+    OpenFlags - Supplies the open flags for the queue. See OPEN_FLAG_*
+        definitions. OPEN_FLAG_CREATE is automatically applied.
+
+    Handle - Supplies a pointer where the handle to the new event queue will
+        be returned.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    CREATE_PARAMETERS Create;
+
+    Create.Type = IoObjectEventQueue;
+    Create.Context = NULL;
+    Create.Permissions = FILE_PERMISSION_USER_READ | FILE_PERMISSION_USER_WRITE;
+    Create.Created = FALSE;
+    return IopOpen(FromKernelMode,
+                   NULL,
+                   NULL,
+                   0,
+                   IO_ACCESS_READ | IO_ACCESS_WRITE,
+                   OpenFlags | OPEN_FLAG_CREATE,
+                   &Create,
+                   Handle);
+}
+
+KERNEL_API
+KSTATUS
+IoControlEventQueue (
+    PIO_HANDLE QueueHandle,
+    EVENT_QUEUE_OPERATION Operation,
+    PIO_HANDLE Handle,
+    PEVENT_QUEUE_EVENT Event
+    )
+
+/*++
+
+Routine Description:
+
+    This routine adds, modifies, or removes an I/O handle's registration with
+    an event queue.
+
+Arguments:
+
+    QueueHandle - Supplies a pointer to the open event queue handle.
+
+    Operation - Supplies the operation to perform.
+
+    Handle - Supplies a pointer to the I/O handle to register. Registrations
+        are tied to this handle, and are removed automatically when it is
+        closed for the last time.
+
+    Event - Supplies a pointer to the events to watch and the data to report
+        for add and modify operations. This is ignored for delete operations.
+
+Return Value:
+
+    STATUS_SUCCESS on success.
+
+    STATUS_INVALID_PARAMETER if the queue handle is not an event queue or the
+    handle is itself an event queue.
+
+    STATUS_NOT_SUPPORTED if the handle has no pollable state, such as a
+    regular file.
+
+    STATUS_DUPLICATE_ENTRY if the handle is already registered on an add.
+
+    STATUS_NOT_FOUND if the handle is not registered on a modify or delete.
+
+--*/
+
+{
+
+    PEVENT_QUEUE_ENTRY Entry;
+    PFILE_OBJECT FileObject;
+    PIO_OBJECT_STATE IoState;
+    PEVENT_QUEUE_ENTRY NewEntry;
+    PIO_NOTIFY_STATE Notify;
+    RUNLEVEL OldRunLevel;
+    PEVENT_QUEUE Queue;
+    KSTATUS Status;
+
+    ASSERT(KeGetRunLevel() == RunLevelLow);
+
+    NewEntry = NULL;
+    if (QueueHandle->FileObject->Properties.Type != IoObjectEventQueue) {
+        return STATUS_INVALID_PARAMETER;
+    }
+
+    Queue = QueueHandle->FileObject->SpecialIo;
+    FileObject = Handle->FileObject;
+    if (FileObject->Properties.Type == IoObjectEventQueue) {
+        return STATUS_INVALID_PARAMETER;
+    }
+
+    IoState = FileObject->IoState;
+    if (IoState == NULL) {
+        return STATUS_NOT_SUPPORTED;
+    }
+
+    //
+    // Allocate the new entry before acquiring the lock.
+    //
+
+    if (Operation == EventQueueOperationAdd) {
+        Notify = IopGetNotifyState(IoState);
+        if (Notify == NULL) {
+            return STATUS_INSUFFICIENT_RESOURCES;
+        }
+
+        NewEntry = MmAllocateNonPagedPool(sizeof(EVENT_QUEUE_ENTRY),
+                                          IO_ALLOCATION_TAG);
+
+        if (NewEntry == NULL) {
+            return STATUS_INSUFFICIENT_RESOURCES;
+        }
+
+        RtlZeroMemory(NewEntry, sizeof(EVENT_QUEUE_ENTRY));
+        NewEntry->Queue = Queue;
+        NewEntry->Handle = Handle;
+        NewEntry->FileObject = FileObject;
+        NewEntry->Notify = Notify;
+        NewEntry->Events = Event->Events & EVENT_QUEUE_POLL_EVENTS;
+        NewEntry->Flags = Event->Events & EVENT_QUEUE_FLAG_MASK;
+        NewEntry->Data = Event->Data;
+        NewEntry->State = EventQueueEntryIdle;
+        NewEntry->Armed = TRUE;
+    }
+
+    KeAcquireQueuedLock(Queue->Lock);
+    IopReapEventQueueEntries(Queue);
+    Entry = IopFindEventQueueEntry(Queue, Handle);
+    switch (Operation) {
+    case EventQueueOperationAdd:
+        if (Entry != NULL) {
+            Status = STATUS_DUPLICATE_ENTRY;
+            break;
+        }
+
+        IopFileObjectAddReference(FileObject);
+        INSERT_BEFORE(&(NewEntry->QueueListEntry), &(Queue->EntryList));
+        OldRunLevel = KeRaiseRunLevel(RunLevelDispatch);
+        KeAcquireSpinLock(&(Notify->Lock));
+        INSERT_BEFORE(&(NewEntry->NotifyListEntry),
+                      &(Notify->RegistrationList));
+
+        KeReleaseSpinLock(&(Notify->Lock));
+        KeLowerRunLevel(OldRunLevel);
+
+        //
+        // Now that the entry will hear about new events, pick up any events
+        // that are already set.
+        //
+
+        IopCheckEventQueueEntry(NewEntry);
+        NewEntry = NULL;
+        Status = STATUS_SUCCESS;
+        break;
+
+    case EventQueueOperationModify:
+        if (Entry == NULL) {
+            Status = STATUS_NOT_FOUND;
+            break;
+        }
+
+        //
+        // The events are read by the notification path, so change them under
+        // the notify lock.
+        //
+
+        OldRunLevel = KeRaiseRunLevel(RunLevelDispatch);
+        KeAcquireSpinLock(&(Entry->Notify->Lock));
+        Entry->Events = Event->Events & EVENT_QUEUE_POLL_EVENTS;
+        Entry->Flags = Event->Events & EVENT_QUEUE_FLAG_MASK;
+        Entry->Data = Event->Data;
+        Entry->Armed = TRUE;
+        KeReleaseSpinLock(&(Entry->Notify->Lock));
+        KeLowerRunLevel(OldRunLevel);
+        IopCheckEventQueueEntry(Entry);
+        Status = STATUS_SUCCESS;
+        break;
+
+    case EventQueueOperationDelete:
+        if (Entry == NULL) {
+            Status = STATUS_NOT_FOUND;
+            break;
+        }
+
+        IopRemoveEventQueueEntry(Entry);
+        Status = STATUS_SUCCESS;
+        break;
+
+    default:
+        Status = STATUS_INVALID_PARAMETER;
+        break;
+    }
+
+    KeReleaseQueuedLock(Queue->Lock);
+    if (NewEntry != NULL) {
+        MmFreeNonPagedPool(NewEntry);
+    }
+
+    return Status;
+}
+
+KERNEL_API
+KSTATUS
+IoWaitForEventQueue (
+    PIO_HANDLE QueueHandle,
+    PEVENT_QUEUE_EVENT Events,
+    ULONG EventCount,
+    ULONG TimeoutInMilliseconds,
+    PULONG EventsReturned
+    )
+
+/*++
+
+Routine Description:
+
+    This routine waits for registered I/O handles on an event queue to become
+    ready.
+
+Arguments:
+
+    QueueHandle - Supplies a pointer to the open event queue handle.
+
+    Events - Supplies a pointer to an array where the ready events will be
+        returned.
+
+    EventCount - Supplies the number of elements in the events array.
+
+    TimeoutInMilliseconds - Supplies the number of milliseconds to wait for an
+        event before giving up. Use WAIT_TIME_INDEFINITE to wait forever.
+
+    EventsReturned - Supplies a pointer where the number of events returned
+        will be stored.
+
+Return Value:
+
+    STATUS_SUCCESS if one or more events were returned.
+
+    STATUS_TIMEOUT if no events arrived in the given amount of time.
+
+    STATUS_INTERRUPTED if the wait was interrupted by a signal.
+
+    Other error codes on failure.
+
+--*/
+
+{
+
+    ULONG Count;
+    ULONGLONG CurrentTime;
+    ULONGLONG EndTime;
+    PEVENT_QUEUE Queue;
+    KSTATUS Status;
+    ULONG WaitTime;
+
+    ASSERT(KeGetRunLevel() == RunLevelLow);
+
+    *EventsReturned = 0;
+    if (QueueHandle->FileObject->Properties.Type != IoObjectEventQueue) {
+        return STATUS_INVALID_PARAMETER;
+    }
+
+    if (EventCount == 0) {
+        return STATUS_INVALID_PARAMETER;
+    }
+
+    //
+    // Spurious wakes go around the loop again, so compute the deadline once
+    // and only ever wait for whatever is left of the timeout.
+    //
+
+    EndTime = 0;
+    if ((TimeoutInMilliseconds != 0) &&
+        (TimeoutInMilliseconds != WAIT_TIME_INDEFINITE)) {
+
+        EndTime = HlQueryTimeCounter() +
+                  KeConvertMicrosecondsToTimeTicks(
+                      (ULONGLONG)TimeoutInMilliseconds *
+                      MICROSECONDS_PER_MILLISECOND);
+    }
+
+    Queue = QueueHandle->FileObject->SpecialIo;
+    WaitTime = TimeoutInMilliseconds;
+    while (TRUE) {
+        KeAcquireQueuedLock(Queue->Lock);
+        IopReapEventQueueEntries(Queue);
+        Count = IopCollectEventQueueEvents(Queue, Events, EventCount);
+        KeReleaseQueuedLock(Queue->Lock);
+        if (Count != 0) {
+            Status = STATUS_SUCCESS;
+            break;
+        }
+
+        if (TimeoutInMilliseconds == 0) {
+            Status = STATUS_TIMEOUT;
+            break;
+        }
+
+        if (EndTime != 0) {
+            CurrentTime = HlQueryTimeCounter();
+            if (CurrentTime >= EndTime) {
+                Status = STATUS_TIMEOUT;
+                break;
+            }
+
+            WaitTime = ((EndTime - CurrentTime) * MILLISECONDS_PER_SECOND) /
+                       HlQueryTimeCounterFrequency();
+
+            if (WaitTime == 0) {
+                WaitTime = 1;
+            }
+        }
+
+        //
+        // Wait for something to land on the ready list. Entries on it may
+        // turn out to have nothing to report, in which case go around again.
+        //
+
+        Status = IoWaitForIoObjectState(Queue->IoState,
+                                        POLL_EVENT_IN,
+                                        TRUE,
+                                        WaitTime,
+                                        NULL);
+
+        if (!KSUCCESS(Status)) {
+            break;
+        }
+    }
+
+    *EventsReturned = Count;
+    return Status;
+}
+
+INTN
+IoSysCreateEventQueue (
+    PVOID SystemCallParameter
+    )
+
+/*++
+
+Routine Description:
+
+    This routine handles the system call that creates a new event queue.
+
+Arguments:
+
+    SystemCallParameter - Supplies a pointer to the parameters supplied with
+        the system call. This structure will be a stack-local copy of the
+        actual parameters passed from user-mode.
+
+Return Value:
+
+    STATUS_SUCCESS or positive integer on success.
+
+    Error status code on failure.
+
+--*/
+
+{
+
+    ULONG HandleFlags;
+    PIO_HANDLE IoHandle;
+    PSYSTEM_CALL_CREATE_EVENT_QUEUE Parameters;
+    PKPROCESS Process;
+    KSTATUS Status;
+
+    Parameters = (PSYSTEM_CALL_CREATE_EVENT_QUEUE)SystemCallParameter;
+    Parameters->Handle = INVALID_HANDLE;
+    IoHandle = NULL;
+    Process = PsGetCurrentProcess();
+
+    ASSERT(Process != PsGetKernelProcess());
+
+    if ((Parameters->OpenFlags & ~SYS_OPEN_FLAG_CLOSE_ON_EXECUTE) != 0) {
+        Status = STATUS_INVALID_PARAMETER;
+        goto SysCreateEventQueueEnd;
+    }
+
+    Status = IoCreateEventQueue(FALSE, 0, &IoHandle);
+    if (!KSUCCESS(Status)) {
+        goto SysCreateEventQueueEnd;
+    }
+
+    HandleFlags = 0;
+    if ((Parameters->OpenFlags & SYS_OPEN_FLAG_CLOSE_ON_EXECUTE) != 0) {
+        HandleFlags |= FILE_DESCRIPTOR_CLOSE_ON_EXECUTE;
+    }
+
+    Status = ObCreateHandle(Process->HandleTable,
+                            IoHandle,
+                            HandleFlags,
+                            &(Parameters->Handle));
+
+    if (!KSUCCESS(Status)) {
+        goto SysCreateEventQueueEnd;
+    }
+
+SysCreateEventQueueEnd:
+    if (!KSUCCESS(Status)) {
+        if (IoHandle != NULL) {
+            IoClose(IoHandle);
+        }
+    }
+
+    return Status;
+}
+
+INTN
+IoSysControlEventQueue (
+    PVOID SystemCallParameter
+    )
+
+/*++
+
+Routine Description:
+
+    This routine handles the system call that adds, modifies, or removes a
+    handle registration on an event queue.
+
+Arguments:
+
+    SystemCallParameter - Supplies a pointer to the parameters supplied with
+        the system call. This structure will be a stack-local copy of the
+        actual parameters passed from user-mode.
+
+Return Value:
+
+    STATUS_SUCCESS or positive integer on success.
+
+    Error status code on failure.
+
+--*/
+
+{
+
+    PIO_HANDLE IoHandle;
+    PSYSTEM_CALL_CONTROL_EVENT_QUEUE Parameters;
+    PKPROCESS Process;
+    PIO_HANDLE QueueHandle;
+    KSTATUS Status;
+
+    Parameters = (PSYSTEM_CALL_CONTROL_EVENT_QUEUE)SystemCallParameter;
+    Process = PsGetCurrentProcess();
+    IoHandle = NULL;
+    QueueHandle = ObGetHandleValue(Process->HandleTable,
+                                   Parameters->Queue,
+                                   NULL);
+
+    if (QueueHandle == NULL) {
+        Status = STATUS_INVALID_HANDLE;
+        goto SysControlEventQueueEnd;
+    }
+
+    IoHandle = ObGetHandleValue(Process->HandleTable, Parameters->Handle, NULL);
+    if (IoHandle == NULL) {
+        Status = STATUS_INVALID_HANDLE;
+        goto SysControlEventQueueEnd;
+    }
+
+    Status = IoControlEventQueue(QueueHandle,
+                                 Parameters->Operation,
+                                 IoHandle,
+                                 &(Parameters->Event));
+
+SysControlEventQueueEnd:
+    if (IoHandle != NULL) {
+        IoIoHandleReleaseReference(IoHandle);
+    }
+
+    if (QueueHandle != NULL) {
+        IoIoHandleReleaseReference(QueueHandle);
+    }
+
+    return Status;
+}
+
+INTN
+IoSysWaitForEventQueue (
+    PVOID SystemCallParameter
+    )
+
+/*++
+
+Routine Description:
+
+    This routine handles the system call that waits for events on an event
+    queue.
+
+Arguments:
+
+    SystemCallParameter - Supplies a pointer to the parameters supplied with
+        the system call. This structure will be a stack-local copy of the
+        actual parameters passed from user-mode.
+
+Return Value:
+
+    STATUS_SUCCESS or the number of events returned (a positive integer) on
+    success.
+
+    Error status code (a negative integer) on failure.
+
+--*/
+
+{
+
+    ULONG Count;
+    ULONG EventCount;
+    PEVENT_QUEUE_EVENT Events;
+    SIGNAL_SET OldSignalSet;
+    PSYSTEM_CALL_WAIT_FOR_EVENT_QUEUE Parameters;
+    PIO_HANDLE QueueHandle;
+    BOOL RestoreSignalMask;
+    INTN Result;
+    SIGNAL_SET SignalMask;
+    KSTATUS Status;
+    PKTHREAD Thread;
+
+    Parameters = (PSYSTEM_CALL_WAIT_FOR_EVENT_QUEUE)SystemCallParameter;
+    Thread = KeGetCurrentThread();
+    Count = 0;
+    Events = NULL;
+    QueueHandle = NULL;
+    RestoreSignalMask = FALSE;
+    if (Parameters->EventCount <= 0) {
+        Status = STATUS_INVALID_PARAMETER;
+        goto SysWaitForEventQueueEnd;
+    }
+
+    QueueHandle = ObGetHandleValue(Thread->OwningProcess->HandleTable,
+                                   Parameters->Queue,
+                                   NULL);
+
+    if (QueueHandle == NULL) {
+        Status = STATUS_INVALID_HANDLE;
+        goto SysWaitForEventQueueEnd;
+    }
+
+    //
+    // Fewer events than requested may always be returned, so cap the size of
+    // the kernel buffer.
+    //
+
+    EventCount = Parameters->EventCount;
+    if (EventCount > EVENT_QUEUE_MAX_WAIT_EVENTS) {
+        EventCount = EVENT_QUEUE_MAX_WAIT_EVENTS;
+    }
+
+    Events = MmAllocatePagedPool(EventCount * sizeof(EVENT_QUEUE_EVENT),
+                                 IO_ALLOCATION_TAG);
+
+    if (Events == NULL) {
+        Status = STATUS_INSUFFICIENT_RESOURCES;
+        goto SysWaitForEventQueueEnd;
+    }
+
+    //
+    // Set the signal mask if supplied.
+    //
+
+    if (Parameters->SignalMask != NULL) {
+        Status = MmCopyFromUserMode(&SignalMask,
+                                    Parameters->SignalMask,
+                                    sizeof(SIGNAL_SET));
+
+        if (!KSUCCESS(Status)) {
+            goto SysWaitForEventQueueEnd;
+        }
+
+        PsSetSignalMask(&SignalMask, &OldSignalSet);
+        RestoreSignalMask = TRUE;
+    }
+
+    Status = IoWaitForEventQueue(QueueHandle,
+                                 Events,
+                                 EventCount,
+                                 Parameters->TimeoutInMilliseconds,
+                                 &Count);
+
+    if (!KSUCCESS(Status)) {
+        goto SysWaitForEventQueueEnd;
+    }
+
+    Status = MmCopyToUserMode(Parameters->Events,
+                              Events,
+                              Count * sizeof(EVENT_QUEUE_EVENT));
+
+SysWaitForEventQueueEnd:
+    if (RestoreSignalMask != FALSE) {
+
+        //
+        // If a signal arrived during the wait, then do not restore the
+        // blocked mask until it gets a chance to be dispatched.
+        //
+
+        PsCheckRuntimeTimers(Thread);
+        if (Thread->SignalPending == ThreadSignalPending) {
+            Thread->RestoreSignals = OldSignalSet;
+            Thread->Flags |= THREAD_FLAG_RESTORE_SIGNALS;
+
+        } else {
+            PsSetSignalMask(&OldSignalSet, NULL);
+        }
+    }
+
+    if (Events != NULL) {
+        MmFreePagedPool(Events);
+    }
+
+    if (QueueHandle != NULL) {
+        IoIoHandleReleaseReference(QueueHandle);
+    }
+
+    Result = Status;
+    if (KSUCCESS(Result)) {
+        Result = Count;
+    }
+
+    return Result;
+}
+
+KSTATUS
+IopCreateEventQueue (
+    PCREATE_PARAMETERS Create,
+    PFILE_OBJECT *FileObject
+    )
+
+/*++
+
+Routine Description:
+
+    This routine creates a new event queue and its file object.
+
+Arguments:
+
+    Create - Supplies a pointer to the creation parameters.
+
+    FileObject - Supplies a pointer where a pointer to the new file object
+        will be returned on success.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    BOOL Created;
+    FILE_PROPERTIES FileProperties;
+    PFILE_OBJECT NewFileObject;
+    PEVENT_QUEUE Queue;
+    KSTATUS Status;
+    PKTHREAD Thread;
+
+    ASSERT(*FileObject == NULL);
+
+    NewFileObject = NULL;
+
+    //
+    // Create the queue object. This reference is transferred to the file
+    // object's special I/O member on success.
+    //
+
+    Queue = ObCreateObject(ObjectEventQueue,
+                           NULL,
+                           NULL,
+                           0,
+                           sizeof(EVENT_QUEUE),
+                           IopDestroyEventQueue,
+                           0,
+                           IO_ALLOCATION_TAG);
+
+    if (Queue == NULL) {
+        Status = STATUS_INSUFFICIENT_RESOURCES;
+        goto CreateEventQueueEnd;
+    }
+
+    KeInitializeSpinLock(&(Queue->ReadyLock));
+    INITIALIZE_LIST_HEAD(&(Queue->EntryList));
+    INITIALIZE_LIST_HEAD(&(Queue->ReadyList));
+    INITIALIZE_LIST_HEAD(&(Queue->ZombieList));
+    Queue->Lock = KeCreateQueuedLock();
+    if (Queue->Lock == NULL) {
+        Status = STATUS_INSUFFICIENT_RESOURCES;
+        goto CreateEventQueueEnd;
+    }
+
+    Queue->NotifyWorkItem = KeCreateWorkItem(NULL,
+                                             WorkPriorityNormal,
+                                             IopEventQueueNotifyWorker,
+                                             Queue,
+                                             IO_ALLOCATION_TAG);
+
+    if (Queue->NotifyWorkItem == NULL) {
+        Status = STATUS_INSUFFICIENT_RESOURCES;
+        goto CreateEventQueueEnd;
+    }
+
+    //
+    // The queue's own I/O state is signaled with registrations' notify locks
+    // held, so it must come from non-paged pool.
+    //
+
+    Thread = KeGetCurrentThread();
+    IopFillOutFilePropertiesForObject(&FileProperties, &(Queue->Header));
+    FileProperties.Permissions = Create->Permissions;
+    FileProperties.Type = IoObjectEventQueue;
+    FileProperties.UserId = Thread->Identity.EffectiveUserId;
+    FileProperties.GroupId = Thread->Identity.EffectiveGroupId;
+    Status = IopCreateOrLookupFileObject(&FileProperties,
+                                         ObGetRootObject(),
+                                         FILE_OBJECT_FLAG_NON_PAGED_IO_STATE,
+                                         0,
+                                         &NewFileObject,
+                                         &Created);
+
+    if (!KSUCCESS(Status)) {
+
+        //
+        // Release the reference added by filling out the file properties.
+        //
+
+        ObReleaseReference(Queue);
+        goto CreateEventQueueEnd;
+    }
+
+    ASSERT(Created != FALSE);
+    ASSERT(NewFileObject->IoState != NULL);
+
+    Queue->IoState = NewFileObject->IoState;
+    Queue->FileObject = NewFileObject;
+    NewFileObject->SpecialIo = Queue;
+    Queue = NULL;
+    *FileObject = NewFileObject;
+    Create->Created = TRUE;
+    Status = STATUS_SUCCESS;
+
+CreateEventQueueEnd:
+
+    //
+    // Other threads may be waiting on the ready event, so signal it on both
+    // success and failure.
+    //
+
+    if (NewFileObject != NULL) {
+        KeSignalEvent(NewFileObject->ReadyEvent, SignalOptionSignalAll);
+        if (!KSUCCESS(Status)) {
+            IopFileObjectReleaseReference(NewFileObject);
+        }
+    }
+
+    if (Queue != NULL) {
+        ObReleaseReference(Queue);
+    }
+
+    return Status;
+}
+
+KSTATUS
+IopCloseEventQueue (
+    PIO_HANDLE IoHandle
+    )
+
+/*++
+
+Routine Description:
+
+    This routine closes an event queue handle, tearing down every registration
+    on the queue.
+
+Arguments:
+
+    IoHandle - Supplies a pointer to the event queue handle being closed.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    PEVENT_QUEUE_ENTRY Entry;
+    PEVENT_QUEUE Queue;
+
+    ASSERT(IoHandle->FileObject->Properties.Type == IoObjectEventQueue);
+
+    Queue = IoHandle->FileObject->SpecialIo;
+    KeAcquireQueuedLock(Queue->Lock);
+    IopReapEventQueueEntries(Queue);
+    while (LIST_EMPTY(&(Queue->EntryList)) == FALSE) {
+        Entry = LIST_VALUE(Queue->EntryList.Next,
+                           EVENT_QUEUE_ENTRY,
+                           QueueListEntry);
+
+        IopRemoveEventQueueEntry(Entry);
+    }
+
+    KeReleaseQueuedLock(Queue->Lock);
+    return STATUS_SUCCESS;
+}
+
+VOID
+IopNotifyEventQueues (
+    PIO_OBJECT_STATE IoState,
+    ULONG Events,
+    BOOL Set
+    )
+
+/*++
+
+Routine Description:
+
+    This routine pushes a change in an I/O object state's events out to the
+    event queues watching it. Registrations interested in newly set events
+    are moved to their queue's ready list.
+
+Arguments:
+
+    IoState - Supplies a pointer to the I/O object state that changed. Its
+        notify state must exist.
+
+    Events - Supplies the mask of poll events that changed.
+
+    Set - Supplies a boolean indicating if the events were set (TRUE) or
+        cleared (FALSE).
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PLIST_ENTRY CurrentEntry;
+    PEVENT_QUEUE_ENTRY Entry;
+    BOOL LowLevel;
+    PIO_NOTIFY_STATE Notify;
+    RUNLEVEL OldRunLevel;
+    PFILE_OBJECT QueueFileObject;
+
+    //
+    // Cleared events need no work. Waiters check the live state before
+    // reporting anything, so a stale ready entry is simply skipped.
+    //
+
+    if (Set == FALSE) {
+        return;
+    }
+
+    Notify = IoState->Notify;
+    do {
+        QueueFileObject = NULL;
+        OldRunLevel = KeRaiseRunLevel(RunLevelDispatch);
+        LowLevel = FALSE;
+        if (OldRunLevel == RunLevelLow) {
+            LowLevel = TRUE;
+        }
+
+        KeAcquireSpinLock(&(Notify->Lock));
+        CurrentEntry = Notify->RegistrationList.Next;
+        while (CurrentEntry != &(Notify->RegistrationList)) {
+            Entry = LIST_VALUE(CurrentEntry,
+                               EVENT_QUEUE_ENTRY,
+                               NotifyListEntry);
+
+            CurrentEntry = CurrentEntry->Next;
+            if ((Events & (Entry->Events | POLL_NONMASKABLE_EVENTS)) == 0) {
+                continue;
+            }
+
+            //
+            // Setting the queue's own state may signal its asynchronous
+            // owner, which takes a queued lock. Hold on to the queue's file
+            // object, which is alive while this registration is linked, and
+            // set the state once the spin lock is dropped. Then scan again for
+            // other queues. Callers above low level, such as a driver's DPC,
+            // hand the queue off to a work item instead.
+            //
+
+            if (IopReadyEventQueueEntry(Entry) != FALSE) {
+                if (LowLevel == FALSE) {
+                    IopQueueEventQueueNotification(Entry->Queue);
+                    continue;
+                }
+
+                QueueFileObject = Entry->Queue->FileObject;
+                IopFileObjectAddReference(QueueFileObject);
+                break;
+            }
+        }
+
+        KeReleaseSpinLock(&(Notify->Lock));
+        KeLowerRunLevel(OldRunLevel);
+        if (QueueFileObject != NULL) {
+            IoSetIoObjectState(QueueFileObject->IoState, POLL_EVENT_IN, TRUE);
+            IopFileObjectReleaseReference(QueueFileObject);
+        }
+
+    } while (QueueFileObject != NULL);
+
+    return;
+}
+
+VOID
+IopDetachEventQueueHandle (
+    PIO_HANDLE IoHandle
+    )
+
+/*++
+
+Routine Description:
+
+    This routine detaches every event queue registration made through the
+    given I/O handle. It is called when the handle is closed for the last
+    time.
+
+Arguments:
+
+    IoHandle - Supplies a pointer to the I/O handle being closed.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PLIST_ENTRY CurrentEntry;
+    PEVENT_QUEUE_ENTRY Entry;
+    PIO_NOTIFY_STATE Notify;
+    RUNLEVEL OldRunLevel;
+    PEVENT_QUEUE Queue;
+
+    Notify = IoHandle->FileObject->IoState->Notify;
+    OldRunLevel = KeRaiseRunLevel(RunLevelDispatch);
+    KeAcquireSpinLock(&(Notify->Lock));
+    CurrentEntry = Notify->RegistrationList.Next;
+    while (CurrentEntry != &(Notify->RegistrationList)) {
+        Entry = LIST_VALUE(CurrentEntry, EVENT_QUEUE_ENTRY, NotifyListEntry);
+        CurrentEntry = CurrentEntry->Next;
+        if (Entry->Handle != IoHandle) {
+            continue;
+        }
+
+        //
+        // The entry cannot be freed here, as the queue owns it. Unhook it so
+        // it never fires again, and hand it to the queue to reap. An entry
+        // being reported is handed over by the waiter when it is done.
+        //
+
+        LIST_REMOVE(&(Entry->NotifyListEntry));
+        Queue = Entry->Queue;
+        KeAcquireSpinLock(&(Queue->ReadyLock));
+        Entry->Detached = TRUE;
+        if (Entry->State != EventQueueEntryReporting) {
+            if (Entry->State == EventQueueEntryReady) {
+                LIST_REMOVE(&(Entry->ReadyListEntry));
+            }
+
+            INSERT_BEFORE(&(Entry->ReadyListEntry), &(Queue->ZombieList));
+            Entry->State = EventQueueEntryZombie;
+        }
+
+        KeReleaseSpinLock(&(Queue->ReadyLock));
+    }
+
+    KeReleaseSpinLock(&(Notify->Lock));
+    KeLowerRunLevel(OldRunLevel);
+    return;
+}
+
+//
+// --------------------------------------------------------- Internal Functions
+//
+
+VOID
+IopDestroyEventQueue (
+    PVOID Object
+    )
+
+/*++
+
+Routine Description:
+
+    This routine is called when an event queue's reference count drops to
+    zero. It destroys all resources associated with the queue. This occurs
+    well after all the handles have been closed.
+
+Arguments:
+
+    Object - Supplies a pointer to the object being destroyed.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PEVENT_QUEUE Queue;
+
+    Queue = (PEVENT_QUEUE)Object;
+
+    ASSERT(LIST_EMPTY(&(Queue->EntryList)) != FALSE);
+    ASSERT(LIST_EMPTY(&(Queue->ZombieList)) != FALSE);
+
+    //
+    // A pending notification holds a file object reference, so the work item
+    // is at most finishing up here. It keeps its own reference while it runs.
+    //
+
+    if (Queue->NotifyWorkItem != NULL) {
+        KeDestroyWorkItem(Queue->NotifyWorkItem);
+    }
+
+    if (Queue->Lock != NULL) {
+        KeDestroyQueuedLock(Queue->Lock);
+    }
+
+    return;
+}
+
+PIO_NOTIFY_STATE
+IopGetNotifyState (
+    PIO_OBJECT_STATE IoState
+    )
+
+/*++
+
+Routine Description:
+
+    This routine returns or attempts to create the event queue notify state
+    for an I/O object state.
+
+Arguments:
+
+    IoState - Supplies a pointer to the I/O object state.
+
+Return Value:
+
+    Returns a pointer to the notify state on success. This may have just been
+    created.
+
+    NULL if no notify state exists and none could be created.
+
+--*/
+
+{
+
+    PIO_NOTIFY_STATE Notify;
+    PIO_NOTIFY_STATE OldValue;
+
+    if (IoState->Notify != NULL) {
+        return IoState->Notify;
+    }
+
+    Notify = MmAllocateNonPagedPool(sizeof(IO_NOTIFY_STATE),
+                                    IO_ALLOCATION_TAG);
+
+    if (Notify == NULL) {
+        return NULL;
+    }
+
+    KeInitializeSpinLock(&(Notify->Lock));
+    INITIALIZE_LIST_HEAD(&(Notify->RegistrationList));
+
+    //
+    // Try to atomically set the notify state. Someone else may race and win.
+    //
+
+    OldValue = (PIO_NOTIFY_STATE)RtlAtomicCompareExchange(
+                                                    (PUINTN)&(IoState->Notify),
+                                                    (UINTN)Notify,
+                                                    (UINTN)NULL);
+
+    if (OldValue != NULL) {
+        MmFreeNonPagedPool(Notify);
+    }
+
+    return IoState->Notify;
+}
+
+PEVENT_QUEUE_ENTRY
+IopFindEventQueueEntry (
+    PEVENT_QUEUE Queue,
+    PIO_HANDLE Handle
+    )
+
+/*++
+
+Routine Description:
+
+    This routine finds the registration for the given handle. The queue lock
+    must be held.
+
+Arguments:
+
+    Queue - Supplies a pointer to the event queue.
+
+    Handle - Supplies a pointer to the registered I/O handle.
+
+Return Value:
+
+    Returns a pointer to the registration on success.
+
+    NULL if the handle is not registered.
+
+--*/
+
+{
+
+    PLIST_ENTRY CurrentEntry;
+    PEVENT_QUEUE_ENTRY Entry;
+
+    CurrentEntry = Queue->EntryList.Next;
+    while (CurrentEntry != &(Queue->EntryList)) {
+        Entry = LIST_VALUE(CurrentEntry, EVENT_QUEUE_ENTRY, QueueListEntry);
+        if ((Entry->Handle == Handle) && (Entry->Detached == FALSE)) {
+            return Entry;
+        }
+
+        CurrentEntry = CurrentEntry->Next;
+    }
+
+    return NULL;
+}
+
+VOID
+IopCheckEventQueueEntry (
+    PEVENT_QUEUE_ENTRY Entry
+    )
+
+/*++
+
+Routine Description:
+
+    This routine readies a registration if its object already has events set
+    that the registration is watching. The queue lock must be held.
+
+Arguments:
+
+    Entry - Supplies a pointer to the registration to check.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    ULONG Events;
+    RUNLEVEL OldRunLevel;
+    BOOL Ready;
+
+    //
+    // The I/O object state may be paged, so read it before raising. Any
+    // events set after this point will come through the notify path.
+    //
+
+    Events = Entry->FileObject->IoState->Events;
+    if ((Events & (Entry->Events | POLL_NONMASKABLE_EVENTS)) == 0) {
+        return;
+    }
+
+    Ready = FALSE;
+    OldRunLevel = KeRaiseRunLevel(RunLevelDispatch);
+    KeAcquireSpinLock(&(Entry->Notify->Lock));
+    if (Entry->Detached == FALSE) {
+        Ready = IopReadyEventQueueEntry(Entry);
+    }
+
+    KeReleaseSpinLock(&(Entry->Notify->Lock));
+    KeLowerRunLevel(OldRunLevel);
+
+    //
+    // The queue lock is held, so the queue's state is not going anywhere.
+    //
+
+    if (Ready != FALSE) {
+        IoSetIoObjectState(Entry->Queue->IoState, POLL_EVENT_IN, TRUE);
+    }
+
+    return;
+}
+
+BOOL
+IopReadyEventQueueEntry (
+    PEVENT_QUEUE_ENTRY Entry
+    )
+
+/*++
+
+Routine Description:
+
+    This routine puts a registration on its queue's ready list. The caller
+    must hold the registration's notify lock.
+
+Arguments:
+
+    Entry - Supplies a pointer to the registration that may have events.
+
+Return Value:
+
+    TRUE if the entry was newly put on the ready list. The caller must set
+    the queue's in event once it has released its spin locks.
+
+    FALSE if the entry was already ready or is being reported.
+
+--*/
+
+{
+
+    PEVENT_QUEUE Queue;
+    BOOL Ready;
+
+    ASSERT(KeGetRunLevel() == RunLevelDispatch);
+
+    Queue = Entry->Queue;
+    Ready = FALSE;
+    KeAcquireSpinLock(&(Queue->ReadyLock));
+    switch (Entry->State) {
+    case EventQueueEntryIdle:
+        INSERT_BEFORE(&(Entry->ReadyListEntry), &(Queue->ReadyList));
+        Entry->State = EventQueueEntryReady;
+        Ready = TRUE;
+        break;
+
+    //
+    // A waiter is looking at this entry. Make sure it goes back on the ready
+    // list when the waiter is done, since it may have read the old state.
+    //
+
+    case EventQueueEntryReporting:
+        Entry->Requeue = TRUE;
+        break;
+
+    case EventQueueEntryReady:
+        break;
+
+    default:
+
+        ASSERT(FALSE);
+
+        break;
+    }
+
+    KeReleaseSpinLock(&(Queue->ReadyLock));
+    return Ready;
+}
+
+VOID
+IopQueueEventQueueNotification (
+    PEVENT_QUEUE Queue
+    )
+
+/*++
+
+Routine Description:
+
+    This routine queues the work item that marks an event queue as readable.
+    It is used when a registration becomes ready above low level, where the
+    queue's own state cannot be set directly.
+
+Arguments:
+
+    Queue - Supplies a pointer to the event queue. The caller must hold the
+        notify lock of an object the queue is registered on, which keeps the
+        queue's file object alive.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    KSTATUS Status;
+
+    ASSERT(KeGetRunLevel() == RunLevelDispatch);
+
+    //
+    // A notification that is already pending will set the state. Otherwise
+    // take a reference on the file object on behalf of the work item.
+    //
+
+    if (RtlAtomicCompareExchange32(&(Queue->NotifyPending), TRUE, FALSE) !=
+        FALSE) {
+
+        return;
+    }
+
+    IopFileObjectAddReference(Queue->FileObject);
+    Status = KeQueueWorkItem(Queue->NotifyWorkItem);
+
+    ASSERT(KSUCCESS(Status));
+
+    return;
+}
+
+VOID
+IopEventQueueNotifyWorker (
+    PVOID Parameter
+    )
+
+/*++
+
+Routine Description:
+
+    This routine marks an event queue as readable on behalf of a registration
+    that became ready above low level.
+
+Arguments:
+
+    Parameter - Supplies a pointer to the event queue.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PFILE_OBJECT FileObject;
+    PEVENT_QUEUE Queue;
+
+    Queue = Parameter;
+    FileObject = Queue->FileObject;
+
+    //
+    // Clear the pending flag first so that a registration readied from here
+    // on queues the work item again rather than being missed.
+    //
+
+    RtlAtomicExchange32(&(Queue->NotifyPending), FALSE);
+    IoSetIoObjectState(Queue->IoState, POLL_EVENT_IN, TRUE);
+    IopFileObjectReleaseReference(FileObject);
+    return;
+}
+
+VOID
+IopRemoveEventQueueEntry (
+    PEVENT_QUEUE_ENTRY Entry
+    )
+
+/*++
+
+Routine Description:
+
+    This routine unhooks and frees a registration. The queue lock must be
+    held.
+
+Arguments:
+
+    Entry - Supplies a pointer to the registration to remove.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    RUNLEVEL OldRunLevel;
+    PEVENT_QUEUE Queue;
+
+    Queue = Entry->Queue;
+    OldRunLevel = KeRaiseRunLevel(RunLevelDispatch);
+    KeAcquireSpinLock(&(Entry->Notify->Lock));
+    if (Entry->Detached == FALSE) {
+        LIST_REMOVE(&(Entry->NotifyListEntry));
+        Entry->Detached = TRUE;
+    }
+
+    KeAcquireSpinLock(&(Queue->ReadyLock));
+
+    ASSERT(Entry->State != EventQueueEntryReporting);
+
+    if (Entry->State != EventQueueEntryIdle) {
+        LIST_REMOVE(&(Entry->ReadyListEntry));
+        Entry->State = EventQueueEntryIdle;
+    }
+
+    KeReleaseSpinLock(&(Queue->ReadyLock));
+    KeReleaseSpinLock(&(Entry->Notify->Lock));
+    KeLowerRunLevel(OldRunLevel);
+    LIST_REMOVE(&(Entry->QueueListEntry));
+    IopFileObjectReleaseReference(Entry->FileObject);
+    MmFreeNonPagedPool(Entry);
+    return;
+}
+
+VOID
+IopReapEventQueueEntries (
+    PEVENT_QUEUE Queue
+    )
+
+/*++
+
+Routine Description:
+
+    This routine frees the registrations whose handles have been closed. The
+    queue lock must be held.
+
+Arguments:
+
+    Queue - Supplies a pointer to the event queue.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PEVENT_QUEUE_ENTRY Entry;
+    RUNLEVEL OldRunLevel;
+    LIST_ENTRY ZombieList;
+
+    if (LIST_EMPTY(&(Queue->ZombieList)) != FALSE) {
+        return;
+    }
+
+    INITIALIZE_LIST_HEAD(&ZombieList);
+    OldRunLevel = KeRaiseRunLevel(RunLevelDispatch);
+    KeAcquireSpinLock(&(Queue->ReadyLock));
+    while (LIST_EMPTY(&(Queue->ZombieList)) == FALSE) {
+        Entry = LIST_VALUE(Queue->ZombieList.Next,
+                           EVENT_QUEUE_ENTRY,
+                           ReadyListEntry);
+
+        LIST_REMOVE(&(Entry->ReadyListEntry));
+        INSERT_BEFORE(&(Entry->ReadyListEntry), &ZombieList);
+    }
+
+    KeReleaseSpinLock(&(Queue->ReadyLock));
+    KeLowerRunLevel(OldRunLevel);
+
+    //
+    // The entries are off every list the notify path can reach, so they can
+    // be torn down without any spin locks.
+    //
+
+    while (LIST_EMPTY(&ZombieList) == FALSE) {
+        Entry = LIST_VALUE(ZombieList.Next, EVENT_QUEUE_ENTRY, ReadyListEntry);
+        LIST_REMOVE(&(Entry->ReadyListEntry));
+        LIST_REMOVE(&(Entry->QueueListEntry));
+        IopFileObjectReleaseReference(Entry->FileObject);
+        MmFreeNonPagedPool(Entry);
+    }
+
+    return;
+}
+
+ULONG
+IopCollectEventQueueEvents (
+    PEVENT_QUEUE Queue,
+    PEVENT_QUEUE_EVENT Events,
+    ULONG EventCount
+    )
+
+/*++
+
+Routine Description:
+
+    This routine pulls entries off the ready list and reports the ones whose
+    objects really do have events. Level-triggered entries that still have
+    events go back on the end of the ready list. The queue lock must be held.
+
+Arguments:
+
+    Queue - Supplies a pointer to the event queue.
+
+    Events - Supplies a pointer to the array where events are returned.
+
+    EventCount - Supplies the number of elements in the events array.
+
+Return Value:
+
+    Returns the number of events returned.
+
+--*/
+
+{
+
+    ULONG Count;
+    PLIST_ENTRY CurrentEntry;
+    PEVENT_QUEUE_ENTRY Entry;
+    RUNLEVEL OldRunLevel;
+    ULONG Pulled;
+    ULONG Ready;
+    BOOL Requeue;
+    LIST_ENTRY ReportList;
+
+    //
+    // Move up to the requested number of entries onto a local list. The
+    // states of I/O objects may be paged, so they cannot be examined with the
+    // ready lock held.
+    //
+
+    INITIALIZE_LIST_HEAD(&ReportList);
+    Pulled = 0;
+    OldRunLevel = KeRaiseRunLevel(RunLevelDispatch);
+    KeAcquireSpinLock(&(Queue->ReadyLock));
+    while ((Pulled < EventCount) &&
+           (LIST_EMPTY(&(Queue->ReadyList)) == FALSE)) {
+
+        Entry = LIST_VALUE(Queue->ReadyList.Next,
+                           EVENT_QUEUE_ENTRY,
+                           ReadyListEntry);
+
+        LIST_REMOVE(&(Entry->ReadyListEntry));
+        INSERT_BEFORE(&(Entry->ReadyListEntry), &ReportList);
+        Entry->State = EventQueueEntryReporting;
+        Pulled += 1;
+    }
+
+    //
+    // The notify path sets the in event after dropping its locks, so it may
+    // land after the entry it announced was already collected. Clear it here
+    // so waiters do not spin on an empty list.
+    //
+
+    if (Pulled == 0) {
+        IoSetIoObjectState(Queue->IoState, POLL_EVENT_IN, FALSE);
+    }
+
+    KeReleaseSpinLock(&(Queue->ReadyLock));
+    KeLowerRunLevel(OldRunLevel);
+    if (Pulled == 0) {
+        return 0;
+    }
+
+    //
+    // Check the live state of each pulled entry. The file object reference
+    // keeps the state around even if the handle is being closed.
+    //
+
+    Count = 0;
+    CurrentEntry = ReportList.Next;
+    while (CurrentEntry != &ReportList) {
+        Entry = LIST_VALUE(CurrentEntry, EVENT_QUEUE_ENTRY, ReadyListEntry);
+        CurrentEntry = CurrentEntry->Next;
+        if (Entry->Armed == FALSE) {
+            continue;
+        }
+
+        Ready = Entry->FileObject->IoState->Events &
+                (Entry->Events | POLL_NONMASKABLE_EVENTS);
+
+        if (Ready == 0) {
+            continue;
+        }
+
+        Events[Count].Events = Ready;
+        Events[Count].Data = Entry->Data;
+        Count += 1;
+        if ((Entry->Flags & EVENT_QUEUE_FLAG_ONE_SHOT) != 0) {
+            Entry->Armed = FALSE;
+
+        //
+        // Level-triggered entries stay ready for as long as their events are
+        // set, so put them back for the next wait to recheck. Use the
+        // requeue flag the notify path uses.
+        //
+
+        } else if ((Entry->Flags & EVENT_QUEUE_FLAG_EDGE_TRIGGERED) == 0) {
+            Entry->Requeue = TRUE;
+        }
+    }
+
+    //
+    // Put the entries back where they belong.
+    //
+
+    OldRunLevel = KeRaiseRunLevel(RunLevelDispatch);
+    KeAcquireSpinLock(&(Queue->ReadyLock));
+    while (LIST_EMPTY(&ReportList) == FALSE) {
+        Entry = LIST_VALUE(ReportList.Next, EVENT_QUEUE_ENTRY, ReadyListEntry);
+        LIST_REMOVE(&(Entry->ReadyListEntry));
+        Requeue = Entry->Requeue;
+        Entry->Requeue = FALSE;
+        if (Entry->Detached != FALSE) {
+            INSERT_BEFORE(&(Entry->ReadyListEntry), &(Queue->ZombieList));
+            Entry->State = EventQueueEntryZombie;
+
+        } else if ((Requeue != FALSE) && (Entry->Armed != FALSE)) {
+            INSERT_BEFORE(&(Entry->ReadyListEntry), &(Queue->ReadyList));
+            Entry->State = EventQueueEntryReady;
+
+        } else {
+            Entry->State = EventQueueEntryIdle;
+        }
+    }
+
+    if (LIST_EMPTY(&(Queue->ReadyList)) != FALSE) {
+        IoSetIoObjectState(Queue->IoState, POLL_EVENT_IN, FALSE);
+    }
+
+    KeReleaseSpinLock(&(Queue->ReadyLock));
+    KeLowerRunLevel(OldRunLevel);
+    return Count;
+}
+
@@ -196,6 +196,14 @@ Return Value:
         KeSignalEvent(IoState->ErrorEvent, SignalOption);
     }
 
+    //
+    // Push the change out to any event queues watching this object.
+    //
+
+    if (IoState->Notify != NULL) {
+        IopNotifyEventQueues(IoState, Events, Set);
+    }
+
     //
     // If read or write just went high, potentially signal the owner.
     //
@@ -491,6 +499,13 @@ Return Value:
         IopDestroyAsyncState(State->Async);
     }
 
+    if (State->Notify != NULL) {
+
+        ASSERT(LIST_EMPTY(&(State->Notify->RegistrationList)) != FALSE);
+
+        MmFreeNonPagedPool(State->Notify);
+    }
+
     if (State->ReadEvent != NULL) {
         KeDestroyEvent(State->ReadEvent);
     }
@@ -876,6 +891,8 @@ Return Value:
                 case IoObjectTerminalMaster:
                 case IoObjectTerminalSlave:
                 case IoObjectSharedMemoryObject:
+                case IoObjectEventQueue:
+                case IoObjectIoRing:
                     break;
 
                 default:
@@ -1244,6 +1261,8 @@ Return Value:
             case IoObjectTerminalMaster:
             case IoObjectTerminalSlave:
             case IoObjectSharedMemoryObject:
+            case IoObjectEventQueue:
+            case IoObjectIoRing:
                 ObReleaseReference(Object->SpecialIo);
                 break;
 
@@ -430,6 +430,62 @@ Return Value:
     return Runlevel;
 }
 
+KERNEL_API
+KSTATUS
+IoSetInterruptAffinity (
+    HANDLE InterruptHandle,
+    ULONG Processor
+    )
+
+/*++
+
+Routine Description:
+
+    This routine steers a connected interrupt to a single processor, so that
+    its interrupt service routine and DPC both run there. Drivers that hand
+    work off to a dedicated thread can pin that thread to the same processor
+    with KeSetThreadAffinity to keep a flow on one core. Interrupts using
+    message signaled interrupts are targeted when the driver programs the
+    message address, by passing a processor set to HlGetMsiInformation.
+
+Arguments:
+
+    InterruptHandle - Supplies the handle to the interrupt, returned when the
+        interrupt was connected.
+
+    Processor - Supplies the number of the processor to steer the interrupt
+        to.
+
+Return Value:
+
+    STATUS_SUCCESS on success.
+
+    STATUS_INVALID_PARAMETER if the processor is not active.
+
+    STATUS_NOT_SUPPORTED if the interrupt cannot be re-targeted.
+
+    Other error codes on failure.
+
+--*/
+
+{
+
+    PKINTERRUPT Interrupt;
+    PROCESSOR_SET Target;
+
+    ASSERT((InterruptHandle != INVALID_HANDLE) && (InterruptHandle != NULL));
+
+    if (Processor >= KeGetActiveProcessorCount()) {
+        return STATUS_INVALID_PARAMETER;
+    }
+
+    Interrupt = (PKINTERRUPT)InterruptHandle;
+    RtlZeroMemory(&Target, sizeof(PROCESSOR_SET));
+    Target.Target = ProcessorTargetSingleProcessor;
+    Target.U.Number = Processor;
+    return HlSetInterruptLineTarget(Interrupt, &Target);
+}
+
 //
 // --------------------------------------------------------- Internal Functions
 //
@@ -1069,6 +1069,81 @@ Return Value:
     return Status;
 }
 
+KERNEL_API
+KSTATUS
+IoAdvise (
+    PIO_HANDLE Handle,
+    IO_OFFSET Offset,
+    ULONGLONG Size,
+    IO_ADVICE Advice
+    )
+
+/*++
+
+Routine Description:
+
+    This routine passes a hint about the expected access pattern of a region
+    of a file or block device to the page cache.
+
+Arguments:
+
+    Handle - Supplies the open I/O handle.
+
+    Offset - Supplies the offset from the beginning of the file or device
+        where the region starts.
+
+    Size - Supplies the size of the region in bytes. Supply 0 to cover
+        everything from the offset to the end of the file.
+
+    Advice - Supplies the hint. Normal, sequential, and random advice changes
+        how aggressively reads through this handle prefetch. Will-need advice
+        starts reading the region into the cache in the background. Don't-need
+        advice makes the region's clean cached pages the first to be reclaimed.
+
+Return Value:
+
+    STATUS_SUCCESS on success.
+
+    STATUS_NOT_SUPPORTED if the handle does not refer to a file or block
+    device.
+
+    STATUS_INVALID_PARAMETER if the advice is not valid.
+
+--*/
+
+{
+
+    PFILE_OBJECT FileObject;
+
+    ASSERT(KeGetRunLevel() == RunLevelLow);
+
+    if ((Advice >= IoAdviceCount) || (Offset < 0)) {
+        return STATUS_INVALID_PARAMETER;
+    }
+
+    FileObject = Handle->FileObject;
+    switch (FileObject->Properties.Type) {
+    case IoObjectRegularFile:
+    case IoObjectBlockDevice:
+    case IoObjectSharedMemoryObject:
+        break;
+
+    default:
+        return STATUS_NOT_SUPPORTED;
+    }
+
+    //
+    // Hints only affect the page cache, so there is nothing to do for objects
+    // that do not use it.
+    //
+
+    if (IO_IS_FILE_OBJECT_CACHEABLE(FileObject) == FALSE) {
+        return STATUS_SUCCESS;
+    }
+
+    return IopAdviseCacheableObject(Handle, Offset, Size, Advice);
+}
+
 KERNEL_API
 KSTATUS
 IoGetFileSize (
@@ -3539,6 +3614,15 @@ Return Value:
         Status = IopTerminalOpenSlave(NewHandle);
         break;
 
+    //
+    // Event queues and I/O rings have no per-handle state.
+    //
+
+    case IoObjectEventQueue:
+    case IoObjectIoRing:
+        Status = STATUS_SUCCESS;
+        break;
+
     case IoObjectSharedMemoryObject:
         if ((Flags & OPEN_FLAG_TRUNCATE) != 0) {
             Status = IopModifyFileObjectSize(FileObject, NULL, 0);
@@ -3732,6 +3816,14 @@ Return Value:
 
         break;
 
+    case IoObjectEventQueue:
+        Status = IopCreateEventQueue(Create, FileObject);
+        break;
+
+    case IoObjectIoRing:
+        Status = IopCreateIoRing(Create, FileObject);
+        break;
+
     default:
 
         ASSERT(FALSE);
@@ -3822,6 +3914,14 @@ Return Value:
             Status = IopTerminalCloseSlave(IoHandle);
             break;
 
+        case IoObjectEventQueue:
+            Status = IopCloseEventQueue(IoHandle);
+            break;
+
+        case IoObjectIoRing:
+            Status = IopCloseIoRing(IoHandle);
+            break;
+
         default:
             Status = STATUS_SUCCESS;
             break;
@@ -3830,6 +3930,16 @@ Return Value:
         if (!KSUCCESS(Status)) {
             goto CloseEnd;
         }
+
+        //
+        // Drop any event queue registrations made through this handle.
+        //
+
+        if ((FileObject->IoState != NULL) &&
+            (FileObject->IoState->Notify != NULL)) {
+
+            IopDetachEventQueueHandle(IoHandle);
+        }
     }
 
     //
@@ -5390,6 +5500,16 @@ Return Value:
         Status = IopPerformObjectIoOperation(Handle, Context);
         break;
 
+    //
+    // Event queues are read with the wait routine, and I/O rings through
+    // their shared memory, not through I/O.
+    //
+
+    case IoObjectEventQueue:
+    case IoObjectIoRing:
+        Status = STATUS_NOT_SUPPORTED;
+        break;
+
     default:
 
         ASSERT(FALSE);
@@ -240,6 +240,15 @@ Module Name:
 
 #define IO_READ_AHEAD_SIZE _128KB
 
+//
+// Define the bounds of the adaptive read-ahead window kept for each handle
+// doing sequential reads. The window starts small and doubles each time the
+// reader catches up to it.
+//
+
+#define IO_READ_AHEAD_INITIAL_SIZE _64KB
+#define IO_READ_AHEAD_MAX_SIZE _1MB
+
 //
 // This flag is set to indicate that the eviction operation is executing as a
 // result of a truncate. All image sections should be unmapped and all page
@@ -558,6 +567,43 @@ typedef enum _IO_HANDLE_TYPE {
 
 /*++
 
+Structure Description:
+
+    This structure defines the read-ahead state for an I/O handle. It is only
+    a heuristic, so it is updated without synchronization.
+
+Members:
+
+    Advice - Stores the access pattern hint most recently supplied for the
+        handle.
+
+    NextOffset - Stores the file offset that a sequential read would start at.
+
+    Trigger - Stores the file offset that, once read past, starts the next
+        asynchronous read-ahead.
+
+    End - Stores the file offset just past the last read-ahead that was
+        started.
+
+    WindowSize - Stores the size of the last read-ahead, in bytes. This is 0
+        if no read-ahead has been started since the last non-sequential read.
+
+    InFlight - Stores a boolean indicating whether a read-ahead work item for
+        the handle is currently queued or running.
+
+--*/
+
+typedef struct _IO_READ_AHEAD_STATE {
+    IO_ADVICE Advice;
+    IO_OFFSET NextOffset;
+    IO_OFFSET Trigger;
+    IO_OFFSET End;
+    UINTN WindowSize;
+    volatile ULONG InFlight;
+} IO_READ_AHEAD_STATE, *PIO_READ_AHEAD_STATE;
+
+/*++
+
 Structure Description:
 
     This structure defines the context behind a generic I/O handle.
@@ -593,6 +639,8 @@ Structure Description:
 
     Async - Stores an optional pointer to the asynchronous receiver state.
 
+    ReadAhead - Stores the read-ahead state for cached reads.
+
 --*/
 
 struct _IO_HANDLE {
@@ -605,6 +653,7 @@ struct _IO_HANDLE {
     PFILE_OBJECT FileObject;
     IO_OFFSET CurrentOffset;
     PASYNC_IO_RECEIVER Async;
+    IO_READ_AHEAD_STATE ReadAhead;
 };
 
 /*++
@@ -2270,6 +2319,39 @@ Return Value:
 
 --*/
 
+KSTATUS
+IopAdviseCacheableObject (
+    PIO_HANDLE Handle,
+    IO_OFFSET Offset,
+    ULONGLONG Size,
+    IO_ADVICE Advice
+    );
+
+/*++
+
+Routine Description:
+
+    This routine applies an access pattern hint to a cacheable file object.
+    The file object must be cacheable.
+
+Arguments:
+
+    Handle - Supplies a pointer to the I/O handle.
+
+    Offset - Supplies the starting file offset of the region the hint applies
+        to.
+
+    Size - Supplies the size of the region in bytes. Supply 0 to apply the hint
+        through the end of the file.
+
+    Advice - Supplies the access pattern hint.
+
+Return Value:
+
+    Status code.
+
+--*/
+
 KSTATUS
 IopPerformNonCachedRead (
     PFILE_OBJECT FileObject,
@@ -3803,6 +3885,155 @@ Return Value:
 
 --*/
 
+KSTATUS
+IopCreateEventQueue (
+    PCREATE_PARAMETERS Create,
+    PFILE_OBJECT *FileObject
+    );
+
+/*++
+
+Routine Description:
+
+    This routine creates a new event queue and its file object.
+
+Arguments:
+
+    Create - Supplies a pointer to the creation parameters.
+
+    FileObject - Supplies a pointer where a pointer to the new file object
+        will be returned on success.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+KSTATUS
+IopCloseEventQueue (
+    PIO_HANDLE IoHandle
+    );
+
+/*++
+
+Routine Description:
+
+    This routine closes an event queue handle, tearing down every registration
+    on the queue.
+
+Arguments:
+
+    IoHandle - Supplies a pointer to the event queue handle being closed.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+VOID
+IopNotifyEventQueues (
+    PIO_OBJECT_STATE IoState,
+    ULONG Events,
+    BOOL Set
+    );
+
+/*++
+
+Routine Description:
+
+    This routine pushes a change in an I/O object state's events out to the
+    event queues watching it. Registrations interested in newly set events
+    are moved to their queue's ready list.
+
+Arguments:
+
+    IoState - Supplies a pointer to the I/O object state that changed. Its
+        notify state must exist.
+
+    Events - Supplies the mask of poll events that changed.
+
+    Set - Supplies a boolean indicating if the events were set (TRUE) or
+        cleared (FALSE).
+
+Return Value:
+
+    None.
+
+--*/
+
+VOID
+IopDetachEventQueueHandle (
+    PIO_HANDLE IoHandle
+    );
+
+/*++
+
+Routine Description:
+
+    This routine detaches every event queue registration made through the
+    given I/O handle. It is called when the handle is closed for the last
+    time.
+
+Arguments:
+
+    IoHandle - Supplies a pointer to the I/O handle being closed.
+
+Return Value:
+
+    None.
+
+--*/
+
+KSTATUS
+IopCreateIoRing (
+    PCREATE_PARAMETERS Create,
+    PFILE_OBJECT *FileObject
+    );
+
+/*++
+
+Routine Description:
+
+    This routine creates a new I/O ring and its file object. The ring is not
+    attached to any memory until it is set up by the creating system call.
+
+Arguments:
+
+    Create - Supplies a pointer to the creation parameters.
+
+    FileObject - Supplies a pointer where a pointer to the new file object
+        will be returned on success.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+KSTATUS
+IopCloseIoRing (
+    PIO_HANDLE IoHandle
+    );
+
+/*++
+
+Routine Description:
+
+    This routine closes an I/O ring handle, abandoning any requests still
+    waiting and releasing the registered handles.
+
+Arguments:
+
+    IoHandle - Supplies a pointer to the I/O ring handle being closed.
+
+Return Value:
+
+    Status code.
+
+--*/
+
 KSTATUS
 IopInitializePathSupport (
     VOID
@@ -0,0 +1,2174 @@
+/*++
+
+Copyright (c) 2026 Minoca Corp.
+
+    This file is licensed under the terms of the GNU General Public License
+    version 3. Alternative licensing terms are available. Contact
+    info@minocacorp.com for details. See the LICENSE file at the root of this
+    project for complete licensing information.
+
+Module Name:
+
+    ioring.c
+
+Abstract:
+
+    This module implements I/O rings. An I/O ring is a pair of submission and
+    completion arrays living in user mode memory. User mode fills in
+    submissions and hands over a whole batch with one system call. Each
+    request is attempted without blocking, and requests that cannot finish
+    yet are parked on an internal event queue until their handle is ready,
+    at which point they are finished and posted to the completion array.
+
+Author:
+
+    Minoca Corp. 18-Oct-2026
+
+Environment:
+
+    Kernel
+
+--*/
+
+//
+// ------------------------------------------------------------------- Includes
+//
+
+#include <minoca/kernel/kernel.h>
+#include "iop.h"
+
+//
+// ---------------------------------------------------------------- Definitions
+//
+
+//
+// Define the number of event queue events collected per wait.
+//
+
+#define IO_RING_WAIT_EVENT_COUNT 16
+
+//
+// Define the socket I/O flags a submission may pass to send and receive.
+//
+
+#define IO_RING_SOCKET_IO_FLAGS                                     \
+    (SOCKET_IO_OUT_OF_BAND | SOCKET_IO_PEEK | SOCKET_IO_WAIT_ALL |  \
+     SOCKET_IO_DONT_ROUTE | SOCKET_IO_NO_SIGNAL |                   \
+     SOCKET_IO_NON_BLOCKING)
+
+//
+// ------------------------------------------------------ Data Type Definitions
+//
+
+/*++
+
+Structure Description:
+
+    This structure defines a buffer registered with an I/O ring.
+
+Members:
+
+    Buffer - Stores the user mode address of the buffer.
+
+    Size - Stores the size of the buffer in bytes.
+
+--*/
+
+typedef struct _IO_RING_BUFFER {
+    PVOID Buffer;
+    UINTN Size;
+} IO_RING_BUFFER, *PIO_RING_BUFFER;
+
+/*++
+
+Structure Description:
+
+    This structure defines an I/O ring.
+
+Members:
+
+    Header - Stores the standard object header.
+
+    Lock - Stores a pointer to the queued lock serializing access to the ring.
+
+    Process - Stores a pointer to the process whose address space holds the
+        ring memory. A reference is held on the process.
+
+    Shared - Stores the user mode pointer to the ring header.
+
+    Submissions - Stores the user mode pointer to the submission array.
+
+    Completions - Stores the user mode pointer to the completion array.
+
+    SubmissionCount - Stores the number of submission entries.
+
+    CompletionCount - Stores the number of completion entries.
+
+    SubmissionHead - Stores the kernel's copy of the submission head.
+
+    CompletionTail - Stores the kernel's copy of the completion tail.
+
+    EventQueue - Stores a pointer to the kernel event queue handle used to
+        find out when handles with parked requests become ready.
+
+    PendingList - Stores the head of the list of parked requests.
+
+    PendingCount - Stores the number of parked requests. Each one has a
+        completion slot set aside for it.
+
+    Handles - Stores an array of registered I/O handles. A reference is held
+        on each one.
+
+    HandleCount - Stores the number of registered handles.
+
+    Buffers - Stores an array of registered buffers.
+
+    BufferCount - Stores the number of registered buffers.
+
+--*/
+
+typedef struct _IO_RING {
+    OBJECT_HEADER Header;
+    PQUEUED_LOCK Lock;
+    PKPROCESS Process;
+    PIO_RING_HEADER Shared;
+    PIO_RING_SUBMISSION Submissions;
+    PIO_RING_COMPLETION Completions;
+    ULONG SubmissionCount;
+    ULONG CompletionCount;
+    ULONG SubmissionHead;
+    ULONG CompletionTail;
+    PIO_HANDLE EventQueue;
+    LIST_ENTRY PendingList;
+    ULONG PendingCount;
+    PIO_HANDLE *Handles;
+    ULONG HandleCount;
+    PIO_RING_BUFFER Buffers;
+    ULONG BufferCount;
+} IO_RING, *PIO_RING;
+
+/*++
+
+Structure Description:
+
+    This structure defines a request taken from an I/O ring.
+
+Members:
+
+    ListEntry - Stores pointers to the next and previous parked requests.
+
+    Handle - Stores a pointer to the I/O handle being operated on. A
+        reference is held on the handle.
+
+    Buffer - Stores the resolved user mode buffer address.
+
+    Size - Stores the size of the buffer in bytes.
+
+    Offset - Stores the file offset for reads and writes.
+
+    UserData - Stores the opaque value to post with the completion.
+
+    Operation - Stores the operation to perform.
+
+    OperationFlags - Stores the operation specific flags.
+
+    Events - Stores the poll events the request is waiting for when parked.
+
+--*/
+
+typedef struct _IO_RING_REQUEST {
+    LIST_ENTRY ListEntry;
+    PIO_HANDLE Handle;
+    PVOID Buffer;
+    UINTN Size;
+    IO_OFFSET Offset;
+    ULONGLONG UserData;
+    IO_RING_OPERATION Operation;
+    ULONG OperationFlags;
+    ULONG Events;
+} IO_RING_REQUEST, *PIO_RING_REQUEST;
+
+//
+// ----------------------------------------------- Internal Function Prototypes
+//
+
+VOID
+IopDestroyIoRing (
+    PVOID Object
+    );
+
+KSTATUS
+IopInitializeIoRing (
+    PIO_RING Ring,
+    PVOID Memory,
+    ULONG SubmissionCount,
+    ULONG CompletionCount
+    );
+
+KSTATUS
+IopSubmitIoRingRequests (
+    PIO_RING Ring,
+    ULONG SubmitCount,
+    PULONG Submitted
+    );
+
+KSTATUS
+IopStartIoRingRequest (
+    PIO_RING Ring,
+    PIO_RING_SUBMISSION Submission
+    );
+
+KSTATUS
+IopPerformIoRingRequest (
+    PIO_RING Ring,
+    PIO_RING_REQUEST Request,
+    PINTN Result
+    );
+
+KSTATUS
+IopParkIoRingRequest (
+    PIO_RING Ring,
+    PIO_RING_REQUEST Request
+    );
+
+KSTATUS
+IopArmIoRingHandle (
+    PIO_RING Ring,
+    PIO_HANDLE Handle
+    );
+
+KSTATUS
+IopRetryIoRingRequests (
+    PIO_RING Ring,
+    PIO_HANDLE Handle
+    );
+
+KSTATUS
+IopWaitForIoRingCompletions (
+    PIO_RING Ring,
+    ULONG WaitCount,
+    ULONG TimeoutInMilliseconds
+    );
+
+KSTATUS
+IopGetIoRingCompletionCount (
+    PIO_RING Ring,
+    PULONG Count
+    );
+
+KSTATUS
+IopPostIoRingCompletion (
+    PIO_RING Ring,
+    ULONGLONG UserData,
+    INTN Result
+    );
+
+KSTATUS
+IopRegisterIoRingHandles (
+    PIO_RING Ring,
+    PHANDLE Array,
+    ULONG Count
+    );
+
+KSTATUS
+IopRegisterIoRingBuffers (
+    PIO_RING Ring,
+    PIO_VECTOR Array,
+    ULONG Count
+    );
+
+VOID
+IopUnregisterIoRingHandles (
+    PIO_RING Ring
+    );
+
+VOID
+IopUnregisterIoRingBuffers (
+    PIO_RING Ring
+    );
+
+//
+// -------------------------------------------------------------------- Globals
+//
+
+//
+// ------------------------------------------------------------------ Functions
+//
+
+INTN
+IoSysCreateIoRing (
+    PVOID SystemCallParameter
+    )
+
+/*++
+
+Routine Description:
+
+    This routine handles the system call that creates a new I/O ring.
+
+Arguments:
+
+    SystemCallParameter - Supplies a pointer to the parameters supplied with
+        the system call. This structure will be a stack-local copy of the
+        actual parameters passed from user-mode.
+
+Return Value:
+
+    STATUS_SUCCESS or positive integer on success.
+
+    Error status code on failure.
+
+--*/
+
+{
+
+    CREATE_PARAMETERS Create;
+    PIO_HANDLE IoHandle;
+    PSYSTEM_CALL_CREATE_IO_RING Parameters;
+    PKPROCESS Process;
+    KSTATUS Status;
+
+    Parameters = (PSYSTEM_CALL_CREATE_IO_RING)SystemCallParameter;
+    Parameters->Handle = INVALID_HANDLE;
+    IoHandle = NULL;
+    Process = PsGetCurrentProcess();
+
+    ASSERT(Process != PsGetKernelProcess());
+
+    if ((Parameters->OpenFlags & ~SYS_OPEN_FLAG_CLOSE_ON_EXECUTE) != 0) {
+        Status = STATUS_INVALID_PARAMETER;
+        goto SysCreateIoRingEnd;
+    }
+
+    Create.Type = IoObjectIoRing;
+    Create.Context = NULL;
+    Create.Permissions = FILE_PERMISSION_USER_READ | FILE_PERMISSION_USER_WRITE;
+    Create.Created = FALSE;
+    Status = IopOpen(FALSE,
+                     NULL,
+                     NULL,
+                     0,
+                     IO_ACCESS_READ | IO_ACCESS_WRITE,
+                     OPEN_FLAG_CREATE,
+                     &Create,
+                     &IoHandle);
+
+    if (!KSUCCESS(Status)) {
+        goto SysCreateIoRingEnd;
+    }
+
+    Status = IopInitializeIoRing(IoHandle->FileObject->SpecialIo,
+                                 Parameters->Ring,
+                                 Parameters->SubmissionCount,
+                                 Parameters->CompletionCount);
+
+    if (!KSUCCESS(Status)) {
+        goto SysCreateIoRingEnd;
+    }
+
+    //
+    // The ring memory does not survive an execute, so the handle must not
+    // either.
+    //
+
+    Status = ObCreateHandle(Process->HandleTable,
+                            IoHandle,
+                            FILE_DESCRIPTOR_CLOSE_ON_EXECUTE,
+                            &(Parameters->Handle));
+
+    if (!KSUCCESS(Status)) {
+        goto SysCreateIoRingEnd;
+    }
+
+SysCreateIoRingEnd:
+    if (!KSUCCESS(Status)) {
+        if (IoHandle != NULL) {
+            IoClose(IoHandle);
+        }
+    }
+
+    return Status;
+}
+
+INTN
+IoSysEnterIoRing (
+    PVOID SystemCallParameter
+    )
+
+/*++
+
+Routine Description:
+
+    This routine handles the system call that submits requests from an I/O
+    ring and optionally waits for completions.
+
+Arguments:
+
+    SystemCallParameter - Supplies a pointer to the parameters supplied with
+        the system call. This structure will be a stack-local copy of the
+        actual parameters passed from user-mode.
+
+Return Value:
+
+    STATUS_SUCCESS or the number of submissions consumed (a positive integer)
+    on success.
+
+    Error status code (a negative integer) on failure.
+
+--*/
+
+{
+
+    PSYSTEM_CALL_ENTER_IO_RING Parameters;
+    PKPROCESS Process;
+    INTN Result;
+    PIO_RING Ring;
+    PIO_HANDLE RingHandle;
+    KSTATUS Status;
+    ULONG Submitted;
+
+    Parameters = (PSYSTEM_CALL_ENTER_IO_RING)SystemCallParameter;
+    Process = PsGetCurrentProcess();
+    Submitted = 0;
+    RingHandle = ObGetHandleValue(Process->HandleTable, Parameters->Ring, NULL);
+    if (RingHandle == NULL) {
+        Status = STATUS_INVALID_HANDLE;
+        goto SysEnterIoRingEnd;
+    }
+
+    if (RingHandle->FileObject->Properties.Type != IoObjectIoRing) {
+        Status = STATUS_INVALID_PARAMETER;
+        goto SysEnterIoRingEnd;
+    }
+
+    //
+    // The ring memory belongs to the process that created it. A child that
+    // inherited the handle across a fork cannot use it.
+    //
+
+    Ring = RingHandle->FileObject->SpecialIo;
+    if (Ring->Process != Process) {
+        Status = STATUS_ACCESS_DENIED;
+        goto SysEnterIoRingEnd;
+    }
+
+    KeAcquireQueuedLock(Ring->Lock);
+    Status = IopSubmitIoRingRequests(Ring, Parameters->SubmitCount, &Submitted);
+    KeReleaseQueuedLock(Ring->Lock);
+    if (!KSUCCESS(Status)) {
+        goto SysEnterIoRingEnd;
+    }
+
+    if (Parameters->WaitCount != 0) {
+        Status = IopWaitForIoRingCompletions(
+                                          Ring,
+                                          Parameters->WaitCount,
+                                          Parameters->TimeoutInMilliseconds);
+    }
+
+SysEnterIoRingEnd:
+    if (RingHandle != NULL) {
+        IoIoHandleReleaseReference(RingHandle);
+    }
+
+    //
+    // Once submissions have been consumed they cannot be handed back, so
+    // report them even if the wait afterwards failed.
+    //
+
+    Result = Status;
+    if (KSUCCESS(Status) || (Submitted != 0)) {
+        Result = Submitted;
+    }
+
+    return Result;
+}
+
+INTN
+IoSysRegisterIoRing (
+    PVOID SystemCallParameter
+    )
+
+/*++
+
+Routine Description:
+
+    This routine handles the system call that registers or unregisters
+    handles or buffers with an I/O ring.
+
+Arguments:
+
+    SystemCallParameter - Supplies a pointer to the parameters supplied with
+        the system call. This structure will be a stack-local copy of the
+        actual parameters passed from user-mode.
+
+Return Value:
+
+    STATUS_SUCCESS or positive integer on success.
+
+    Error status code on failure.
+
+--*/
+
+{
+
+    PVOID Array;
+    UINTN ArraySize;
+    UINTN ElementSize;
+    PSYSTEM_CALL_REGISTER_IO_RING Parameters;
+    PKPROCESS Process;
+    PIO_RING Ring;
+    PIO_HANDLE RingHandle;
+    KSTATUS Status;
+
+    Parameters = (PSYSTEM_CALL_REGISTER_IO_RING)SystemCallParameter;
+    Array = NULL;
+    Process = PsGetCurrentProcess();
+    RingHandle = ObGetHandleValue(Process->HandleTable, Parameters->Ring, NULL);
+    if (RingHandle == NULL) {
+        Status = STATUS_INVALID_HANDLE;
+        goto SysRegisterIoRingEnd;
+    }
+
+    if (RingHandle->FileObject->Properties.Type != IoObjectIoRing) {
+        Status = STATUS_INVALID_PARAMETER;
+        goto SysRegisterIoRingEnd;
+    }
+
+    Ring = RingHandle->FileObject->SpecialIo;
+    if (Ring->Process != Process) {
+        Status = STATUS_ACCESS_DENIED;
+        goto SysRegisterIoRingEnd;
+    }
+
+    //
+    // Copy the array in before acquiring the lock.
+    //
+
+    ElementSize = 0;
+    switch (Parameters->Operation) {
+    case IoRingRegisterHandles:
+        ElementSize = sizeof(HANDLE);
+        break;
+
+    case IoRingRegisterBuffers:
+        ElementSize = sizeof(IO_VECTOR);
+        break;
+
+    case IoRingUnregisterHandles:
+    case IoRingUnregisterBuffers:
+        break;
+
+    default:
+        Status = STATUS_INVALID_PARAMETER;
+        goto SysRegisterIoRingEnd;
+    }
+
+    if (ElementSize != 0) {
+        if ((Parameters->Count == 0) ||
+            (Parameters->Count > IO_RING_MAX_REGISTERED)) {
+
+            Status = STATUS_INVALID_PARAMETER;
+            goto SysRegisterIoRingEnd;
+        }
+
+        ArraySize = Parameters->Count * ElementSize;
+        Array = MmAllocatePagedPool(ArraySize, IO_ALLOCATION_TAG);
+        if (Array == NULL) {
+            Status = STATUS_INSUFFICIENT_RESOURCES;
+            goto SysRegisterIoRingEnd;
+        }
+
+        Status = MmCopyFromUserMode(Array, Parameters->Array, ArraySize);
+        if (!KSUCCESS(Status)) {
+            goto SysRegisterIoRingEnd;
+        }
+    }
+
+    KeAcquireQueuedLock(Ring->Lock);
+    switch (Parameters->Operation) {
+    case IoRingRegisterHandles:
+        Status = IopRegisterIoRingHandles(Ring, Array, Parameters->Count);
+        break;
+
+    case IoRingRegisterBuffers:
+        Status = IopRegisterIoRingBuffers(Ring, Array, Parameters->Count);
+        break;
+
+    case IoRingUnregisterHandles:
+        Status = STATUS_NOT_FOUND;
+        if (Ring->Handles != NULL) {
+            IopUnregisterIoRingHandles(Ring);
+            Status = STATUS_SUCCESS;
+        }
+
+        break;
+
+    case IoRingUnregisterBuffers:
+        Status = STATUS_NOT_FOUND;
+        if (Ring->Buffers != NULL) {
+            IopUnregisterIoRingBuffers(Ring);
+            Status = STATUS_SUCCESS;
+        }
+
+        break;
+
+    default:
+
+        ASSERT(FALSE);
+
+        Status = STATUS_INVALID_PARAMETER;
+        break;
+    }
+
+    KeReleaseQueuedLock(Ring->Lock);
+
+SysRegisterIoRingEnd:
+    if (Array != NULL) {
+        MmFreePagedPool(Array);
+    }
+
+    if (RingHandle != NULL) {
+        IoIoHandleReleaseReference(RingHandle);
+    }
+
+    return Status;
+}
+
+KSTATUS
+IopCreateIoRing (
+    PCREATE_PARAMETERS Create,
+    PFILE_OBJECT *FileObject
+    )
+
+/*++
+
+Routine Description:
+
+    This routine creates a new I/O ring and its file object. The ring is not
+    attached to any memory until it is set up by the creating system call.
+
+Arguments:
+
+    Create - Supplies a pointer to the creation parameters.
+
+    FileObject - Supplies a pointer where a pointer to the new file object
+        will be returned on success.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    BOOL Created;
+    FILE_PROPERTIES FileProperties;
+    PFILE_OBJECT NewFileObject;
+    PIO_RING Ring;
+    KSTATUS Status;
+    PKTHREAD Thread;
+
+    ASSERT(*FileObject == NULL);
+
+    NewFileObject = NULL;
+
+    //
+    // Create the ring object. This reference is transferred to the file
+    // object's special I/O member on success.
+    //
+
+    Ring = ObCreateObject(ObjectIoRing,
+                          NULL,
+                          NULL,
+                          0,
+                          sizeof(IO_RING),
+                          IopDestroyIoRing,
+                          0,
+                          IO_ALLOCATION_TAG);
+
+    if (Ring == NULL) {
+        Status = STATUS_INSUFFICIENT_RESOURCES;
+        goto CreateIoRingEnd;
+    }
+
+    INITIALIZE_LIST_HEAD(&(Ring->PendingList));
+    Ring->Lock = KeCreateQueuedLock();
+    if (Ring->Lock == NULL) {
+        Status = STATUS_INSUFFICIENT_RESOURCES;
+        goto CreateIoRingEnd;
+    }
+
+    Status = IoCreateEventQueue(TRUE, 0, &(Ring->EventQueue));
+    if (!KSUCCESS(Status)) {
+        goto CreateIoRingEnd;
+    }
+
+    Thread = KeGetCurrentThread();
+    IopFillOutFilePropertiesForObject(&FileProperties, &(Ring->Header));
+    FileProperties.Permissions = Create->Permissions;
+    FileProperties.Type = IoObjectIoRing;
+    FileProperties.UserId = Thread->Identity.EffectiveUserId;
+    FileProperties.GroupId = Thread->Identity.EffectiveGroupId;
+    Status = IopCreateOrLookupFileObject(&FileProperties,
+                                         ObGetRootObject(),
+                                         0,
+                                         0,
+                                         &NewFileObject,
+                                         &Created);
+
+    if (!KSUCCESS(Status)) {
+
+        //
+        // Release the reference added by filling out the file properties.
+        //
+
+        ObReleaseReference(Ring);
+        goto CreateIoRingEnd;
+    }
+
+    ASSERT(Created != FALSE);
+
+    NewFileObject->SpecialIo = Ring;
+    Ring = NULL;
+    *FileObject = NewFileObject;
+    Create->Created = TRUE;
+    Status = STATUS_SUCCESS;
+
+CreateIoRingEnd:
+
+    //
+    // Other threads may be waiting on the ready event, so signal it on both
+    // success and failure.
+    //
+
+    if (NewFileObject != NULL) {
+        KeSignalEvent(NewFileObject->ReadyEvent, SignalOptionSignalAll);
+        if (!KSUCCESS(Status)) {
+            IopFileObjectReleaseReference(NewFileObject);
+        }
+    }
+
+    if (Ring != NULL) {
+        ObReleaseReference(Ring);
+    }
+
+    return Status;
+}
+
+KSTATUS
+IopCloseIoRing (
+    PIO_HANDLE IoHandle
+    )
+
+/*++
+
+Routine Description:
+
+    This routine closes an I/O ring handle, abandoning any requests still
+    waiting and releasing the registered handles.
+
+Arguments:
+
+    IoHandle - Supplies a pointer to the I/O ring handle being closed.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    PIO_RING_REQUEST Request;
+    PIO_RING Ring;
+
+    ASSERT(IoHandle->FileObject->Properties.Type == IoObjectIoRing);
+
+    //
+    // Nobody is left to reap completions, so parked requests are simply
+    // dropped. Their registrations go away with the event queue.
+    //
+
+    Ring = IoHandle->FileObject->SpecialIo;
+    KeAcquireQueuedLock(Ring->Lock);
+    while (LIST_EMPTY(&(Ring->PendingList)) == FALSE) {
+        Request = LIST_VALUE(Ring->PendingList.Next,
+                             IO_RING_REQUEST,
+                             ListEntry);
+
+        LIST_REMOVE(&(Request->ListEntry));
+        IoControlEventQueue(Ring->EventQueue,
+                            EventQueueOperationDelete,
+                            Request->Handle,
+                            NULL);
+
+        IoIoHandleReleaseReference(Request->Handle);
+        MmFreePagedPool(Request);
+    }
+
+    Ring->PendingCount = 0;
+    IopUnregisterIoRingHandles(Ring);
+    IopUnregisterIoRingBuffers(Ring);
+    KeReleaseQueuedLock(Ring->Lock);
+    return STATUS_SUCCESS;
+}
+
+//
+// --------------------------------------------------------- Internal Functions
+//
+
+VOID
+IopDestroyIoRing (
+    PVOID Object
+    )
+
+/*++
+
+Routine Description:
+
+    This routine is called when an I/O ring's reference count drops to zero.
+
+Arguments:
+
+    Object - Supplies a pointer to the I/O ring being destroyed.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PIO_RING Ring;
+
+    Ring = Object;
+
+    ASSERT(LIST_EMPTY(&(Ring->PendingList)) != FALSE);
+    ASSERT((Ring->Handles == NULL) && (Ring->Buffers == NULL));
+
+    if (Ring->EventQueue != NULL) {
+        IoClose(Ring->EventQueue);
+    }
+
+    if (Ring->Process != NULL) {
+        ObReleaseReference(Ring->Process);
+    }
+
+    if (Ring->Lock != NULL) {
+        KeDestroyQueuedLock(Ring->Lock);
+    }
+
+    return;
+}
+
+KSTATUS
+IopInitializeIoRing (
+    PIO_RING Ring,
+    PVOID Memory,
+    ULONG SubmissionCount,
+    ULONG CompletionCount
+    )
+
+/*++
+
+Routine Description:
+
+    This routine attaches a new I/O ring to its user mode memory and fills in
+    the shared header.
+
+Arguments:
+
+    Ring - Supplies a pointer to the new I/O ring.
+
+    Memory - Supplies the user mode address of the ring memory.
+
+    SubmissionCount - Supplies the number of submission entries.
+
+    CompletionCount - Supplies the number of completion entries.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    IO_RING_HEADER Header;
+    UINTN Size;
+    KSTATUS Status;
+
+    if ((SubmissionCount == 0) ||
+        (SubmissionCount > IO_RING_MAX_ENTRIES) ||
+        (POWER_OF_2(SubmissionCount) == FALSE) ||
+        (CompletionCount == 0) ||
+        (CompletionCount > IO_RING_MAX_ENTRIES) ||
+        (POWER_OF_2(CompletionCount) == FALSE)) {
+
+        return STATUS_INVALID_PARAMETER;
+    }
+
+    Size = IO_RING_SIZE(SubmissionCount, CompletionCount);
+    if ((IS_POINTER_ALIGNED(Memory, sizeof(ULONGLONG)) == FALSE) ||
+        (Memory + Size > USER_VA_END) ||
+        (Memory + Size < Memory)) {
+
+        return STATUS_INVALID_PARAMETER;
+    }
+
+    RtlZeroMemory(&Header, sizeof(IO_RING_HEADER));
+    Header.SubmissionCount = SubmissionCount;
+    Header.CompletionCount = CompletionCount;
+    Status = MmCopyToUserMode(Memory, &Header, sizeof(IO_RING_HEADER));
+    if (!KSUCCESS(Status)) {
+        return Status;
+    }
+
+    Ring->Shared = Memory;
+    Ring->Submissions = (PIO_RING_SUBMISSION)(Ring->Shared + 1);
+    Ring->Completions =
+           (PIO_RING_COMPLETION)(Ring->Submissions + SubmissionCount);
+
+    Ring->SubmissionCount = SubmissionCount;
+    Ring->CompletionCount = CompletionCount;
+    Ring->Process = PsGetCurrentProcess();
+    ObAddReference(Ring->Process);
+    return STATUS_SUCCESS;
+}
+
+KSTATUS
+IopSubmitIoRingRequests (
+    PIO_RING Ring,
+    ULONG SubmitCount,
+    PULONG Submitted
+    )
+
+/*++
+
+Routine Description:
+
+    This routine consumes submissions from an I/O ring and starts each one.
+    The ring lock must be held.
+
+Arguments:
+
+    Ring - Supplies a pointer to the I/O ring.
+
+    SubmitCount - Supplies the maximum number of submissions to consume.
+
+    Submitted - Supplies a pointer where the number of submissions consumed
+        will be returned.
+
+Return Value:
+
+    STATUS_SUCCESS if zero or more submissions were consumed.
+
+    STATUS_BUFFER_FULL if there was room in the completion array for none of
+    the requested submissions.
+
+    STATUS_ACCESS_VIOLATION if the ring memory is no longer accessible.
+
+    STATUS_INVALID_PARAMETER if user mode corrupted the ring indices.
+
+--*/
+
+{
+
+    ULONG Available;
+    ULONG Completed;
+    ULONG Index;
+    KSTATUS Status;
+    IO_RING_SUBMISSION Submission;
+    ULONG Tail;
+
+    *Submitted = 0;
+
+    //
+    // Pick up any parked requests whose handles became ready first, freeing
+    // their completion slots and keeping completions in a sensible order.
+    //
+
+    Status = IopWaitForIoRingCompletions(Ring, 0, 0);
+    if (!KSUCCESS(Status)) {
+        return Status;
+    }
+
+    if (SubmitCount == 0) {
+        return STATUS_SUCCESS;
+    }
+
+    if (MmUserRead32(&(Ring->Shared->SubmissionTail), &Tail) == FALSE) {
+        return STATUS_ACCESS_VIOLATION;
+    }
+
+    Available = Tail - Ring->SubmissionHead;
+    if (Available > Ring->SubmissionCount) {
+        return STATUS_INVALID_PARAMETER;
+    }
+
+    if (SubmitCount > Available) {
+        SubmitCount = Available;
+    }
+
+    while (*Submitted < SubmitCount) {
+
+        //
+        // Only take a submission if its completion is guaranteed a slot.
+        // Parked requests already have slots set aside.
+        //
+
+        Status = IopGetIoRingCompletionCount(Ring, &Completed);
+        if (!KSUCCESS(Status)) {
+            break;
+        }
+
+        if (Completed + Ring->PendingCount >= Ring->CompletionCount) {
+            if (*Submitted == 0) {
+                Status = STATUS_BUFFER_FULL;
+            }
+
+            break;
+        }
+
+        Index = Ring->SubmissionHead & (Ring->SubmissionCount - 1);
+        Status = MmCopyFromUserMode(&Submission,
+                                    &(Ring->Submissions[Index]),
+                                    sizeof(IO_RING_SUBMISSION));
+
+        if (!KSUCCESS(Status)) {
+            break;
+        }
+
+        Ring->SubmissionHead += 1;
+        *Submitted += 1;
+        Status = IopStartIoRingRequest(Ring, &Submission);
+        if (!KSUCCESS(Status)) {
+            break;
+        }
+    }
+
+    if (MmUserWrite32(&(Ring->Shared->SubmissionHead),
+                      Ring->SubmissionHead) == FALSE) {
+
+        Status = STATUS_ACCESS_VIOLATION;
+    }
+
+    return Status;
+}
+
+KSTATUS
+IopStartIoRingRequest (
+    PIO_RING Ring,
+    PIO_RING_SUBMISSION Submission
+    )
+
+/*++
+
+Routine Description:
+
+    This routine resolves the handle and buffer of a submission and attempts
+    the request. Problems with the request itself are reported through its
+    completion. The ring lock must be held.
+
+Arguments:
+
+    Ring - Supplies a pointer to the I/O ring.
+
+    Submission - Supplies a pointer to the kernel copy of the submission.
+
+Return Value:
+
+    Status code. Failure indicates the ring memory itself could not be
+    accessed.
+
+--*/
+
+{
+
+    PIO_RING_BUFFER Buffer;
+    ULONG BufferIndex;
+    UINTN BufferOffset;
+    UINTN HandleIndex;
+    IO_RING_REQUEST Request;
+    INTN Result;
+    KSTATUS Status;
+
+    RtlZeroMemory(&Request, sizeof(IO_RING_REQUEST));
+    Request.UserData = Submission->UserData;
+    Request.Operation = Submission->Operation;
+    Request.OperationFlags = Submission->OperationFlags;
+    Request.Offset = Submission->Offset;
+    Request.Size = Submission->Size;
+    Request.Buffer = Submission->Buffer;
+    if (Request.Operation == IoRingOperationNop) {
+        Result = STATUS_SUCCESS;
+        goto StartIoRingRequestEnd;
+    }
+
+    if ((Request.Operation >= IoRingOperationCount) ||
+        ((Submission->Flags & ~IO_RING_SUBMIT_FLAG_MASK) != 0) ||
+        (Submission->Reserved != 0) ||
+        (Request.Size > (UINTN)MAX_INTN)) {
+
+        Result = STATUS_INVALID_PARAMETER;
+        goto StartIoRingRequestEnd;
+    }
+
+    //
+    // Registered handles already have their lookup done, so only a
+    // reference is needed.
+    //
+
+    if ((Submission->Flags & IO_RING_SUBMIT_REGISTERED_HANDLE) != 0) {
+        HandleIndex = (UINTN)(Submission->Handle);
+        if ((HandleIndex >= Ring->HandleCount) ||
+            (Ring->Handles[HandleIndex] == NULL)) {
+
+            Result = STATUS_INVALID_HANDLE;
+            goto StartIoRingRequestEnd;
+        }
+
+        Request.Handle = Ring->Handles[HandleIndex];
+        IoIoHandleAddReference(Request.Handle);
+
+    } else {
+        Request.Handle = ObGetHandleValue(Ring->Process->HandleTable,
+                                          Submission->Handle,
+                                          NULL);
+
+        if (Request.Handle == NULL) {
+            Result = STATUS_INVALID_HANDLE;
+            goto StartIoRingRequestEnd;
+        }
+    }
+
+    //
+    // Registered buffers were validated when they were registered, so only
+    // the range within the buffer needs checking.
+    //
+
+    if ((Submission->Flags & IO_RING_SUBMIT_REGISTERED_BUFFER) != 0) {
+        BufferIndex = Submission->BufferIndex;
+        if (BufferIndex >= Ring->BufferCount) {
+            Result = STATUS_INVALID_PARAMETER;
+            goto StartIoRingRequestEnd;
+        }
+
+        Buffer = &(Ring->Buffers[BufferIndex]);
+        BufferOffset = (UINTN)(Request.Buffer - Buffer->Buffer);
+        if ((Request.Buffer < Buffer->Buffer) ||
+            (BufferOffset > Buffer->Size) ||
+            (Request.Size > Buffer->Size - BufferOffset)) {
+
+            Result = STATUS_INVALID_PARAMETER;
+            goto StartIoRingRequestEnd;
+        }
+
+    } else if ((Request.Buffer + Request.Size > USER_VA_END) ||
+               (Request.Buffer + Request.Size < Request.Buffer)) {
+
+        Result = STATUS_INVALID_PARAMETER;
+        goto StartIoRingRequestEnd;
+    }
+
+    Status = IopPerformIoRingRequest(Ring, &Request, &Result);
+    if (Status == STATUS_OPERATION_WOULD_BLOCK) {
+        Status = IopParkIoRingRequest(Ring, &Request);
+        if (KSUCCESS(Status)) {
+            return STATUS_SUCCESS;
+        }
+
+        Result = Status;
+    }
+
+StartIoRingRequestEnd:
+    if (Request.Handle != NULL) {
+        IoIoHandleReleaseReference(Request.Handle);
+    }
+
+    return IopPostIoRingCompletion(Ring, Request.UserData, Result);
+}
+
+KSTATUS
+IopPerformIoRingRequest (
+    PIO_RING Ring,
+    PIO_RING_REQUEST Request,
+    PINTN Result
+    )
+
+/*++
+
+Routine Description:
+
+    This routine attempts an I/O ring request without blocking.
+
+Arguments:
+
+    Ring - Supplies a pointer to the I/O ring.
+
+    Request - Supplies a pointer to the request. If the request needs to wait,
+        the events it is waiting for are stored here.
+
+    Result - Supplies a pointer where the result to post will be returned if
+        the request finished.
+
+Return Value:
+
+    STATUS_SUCCESS if the request finished, successfully or not.
+
+    STATUS_OPERATION_WOULD_BLOCK if the request needs to wait for its handle.
+
+--*/
+
+{
+
+    BOOL Blocked;
+    UINTN BytesCompleted;
+    ULONG HandleFlags;
+    IO_BUFFER IoBuffer;
+    NETWORK_ADDRESS NetworkAddress;
+    PIO_HANDLE NewHandle;
+    HANDLE NewUserHandle;
+    PCSTR RemotePath;
+    UINTN RemotePathSize;
+    SOCKET_IO_PARAMETERS SocketParameters;
+    KSTATUS Status;
+
+    Blocked = FALSE;
+    BytesCompleted = 0;
+    switch (Request->Operation) {
+    case IoRingOperationRead:
+    case IoRingOperationWrite:
+        if (Request->Size == 0) {
+            Status = STATUS_SUCCESS;
+            break;
+        }
+
+        //
+        // As with ordinary I/O, don't pin the pages unless the request
+        // actually reaches a driver.
+        //
+
+        Status = MmInitializeIoBuffer(&IoBuffer,
+                                      Request->Buffer,
+                                      INVALID_PHYSICAL_ADDRESS,
+                                      Request->Size,
+                                      0);
+
+        if (!KSUCCESS(Status)) {
+            break;
+        }
+
+        if (Request->Operation == IoRingOperationRead) {
+            Request->Events = POLL_EVENT_IN;
+            Status = IoReadAtOffset(Request->Handle,
+                                    &IoBuffer,
+                                    Request->Offset,
+                                    Request->Size,
+                                    0,
+                                    0,
+                                    &BytesCompleted,
+                                    NULL);
+
+        } else {
+            Request->Events = POLL_EVENT_OUT;
+            Status = IoWriteAtOffset(Request->Handle,
+                                     &IoBuffer,
+                                     Request->Offset,
+                                     Request->Size,
+                                     0,
+                                     0,
+                                     &BytesCompleted,
+                                     NULL);
+
+            if (Status == STATUS_BROKEN_PIPE) {
+                PsSignalProcess(Ring->Process, SIGNAL_BROKEN_PIPE, NULL);
+            }
+        }
+
+        if (((Status == STATUS_TIMEOUT) ||
+             (Status == STATUS_OPERATION_WOULD_BLOCK)) &&
+            (BytesCompleted == 0)) {
+
+            Blocked = TRUE;
+        }
+
+        break;
+
+    case IoRingOperationFlush:
+        Status = IoFlush(Request->Handle, 0, -1, 0);
+        break;
+
+    //
+    // Never let the accept wait, as the ring lock is held. Another acceptor
+    // may take the pending connection at any time, so a request with nothing
+    // to accept parks until the listening socket is readable again.
+    //
+
+    case IoRingOperationAccept:
+        Request->Events = POLL_EVENT_IN;
+        NewHandle = NULL;
+        Status = IoSocketAccept(Request->Handle,
+                                TRUE,
+                                &NewHandle,
+                                &NetworkAddress,
+                                &RemotePath,
+                                &RemotePathSize);
+
+        if (Status == STATUS_OPERATION_WOULD_BLOCK) {
+            Blocked = TRUE;
+            break;
+        }
+
+        if (!KSUCCESS(Status)) {
+            break;
+        }
+
+        if ((Request->OperationFlags & SYS_OPEN_FLAG_NON_BLOCKING) != 0) {
+            NewHandle->OpenFlags |= OPEN_FLAG_NON_BLOCKING;
+        }
+
+        HandleFlags = 0;
+        if ((Request->OperationFlags & SYS_OPEN_FLAG_CLOSE_ON_EXECUTE) != 0) {
+            HandleFlags |= FILE_DESCRIPTOR_CLOSE_ON_EXECUTE;
+        }
+
+        Status = ObCreateHandle(Ring->Process->HandleTable,
+                                NewHandle,
+                                HandleFlags,
+                                &NewUserHandle);
+
+        if (!KSUCCESS(Status)) {
+            IoIoHandleReleaseReference(NewHandle);
+            break;
+        }
+
+        if ((Request->Buffer != NULL) &&
+            (Request->Size >= sizeof(NETWORK_ADDRESS))) {
+
+            MmCopyToUserMode(Request->Buffer,
+                             &NetworkAddress,
+                             sizeof(NETWORK_ADDRESS));
+        }
+
+        BytesCompleted = (UINTN)NewUserHandle;
+        break;
+
+    //
+    // The network stack has no non-blocking connect, so a connect finishes
+    // inline.
+    //
+
+    case IoRingOperationConnect:
+        if (Request->Size != sizeof(NETWORK_ADDRESS)) {
+            Status = STATUS_INVALID_PARAMETER;
+            break;
+        }
+
+        Status = MmCopyFromUserMode(&NetworkAddress,
+                                    Request->Buffer,
+                                    sizeof(NETWORK_ADDRESS));
+
+        if (!KSUCCESS(Status)) {
+            break;
+        }
+
+        Status = IoSocketConnect(FALSE,
+                                 Request->Handle,
+                                 &NetworkAddress,
+                                 NULL,
+                                 0);
+
+        break;
+
+    case IoRingOperationSend:
+    case IoRingOperationReceive:
+        Status = MmInitializeIoBuffer(&IoBuffer,
+                                      Request->Buffer,
+                                      INVALID_PHYSICAL_ADDRESS,
+                                      Request->Size,
+                                      0);
+
+        if (!KSUCCESS(Status)) {
+            break;
+        }
+
+        RtlZeroMemory(&SocketParameters, sizeof(SOCKET_IO_PARAMETERS));
+        SocketParameters.Size = Request->Size;
+        SocketParameters.SocketIoFlags = (Request->OperationFlags &
+                                          IO_RING_SOCKET_IO_FLAGS) |
+                                         SOCKET_IO_NON_BLOCKING;
+
+        if (Request->Operation == IoRingOperationSend) {
+            Request->Events = POLL_EVENT_OUT;
+            Status = IoSocketSendData(FALSE,
+                                      Request->Handle,
+                                      &SocketParameters,
+                                      &IoBuffer);
+
+            if ((Status == STATUS_BROKEN_PIPE) &&
+                ((SocketParameters.SocketIoFlags &
+                  SOCKET_IO_NO_SIGNAL) == 0)) {
+
+                PsSignalProcess(Ring->Process, SIGNAL_BROKEN_PIPE, NULL);
+            }
+
+        } else {
+            Request->Events = POLL_EVENT_IN;
+            Status = IoSocketReceiveData(FALSE,
+                                         Request->Handle,
+                                         &SocketParameters,
+                                         &IoBuffer);
+        }
+
+        BytesCompleted = SocketParameters.BytesCompleted;
+
+        //
+        // Only park the request if the submitter did not ask for it to fail
+        // rather than wait.
+        //
+
+        if ((Status == STATUS_OPERATION_WOULD_BLOCK) &&
+            (BytesCompleted == 0) &&
+            ((Request->OperationFlags & SOCKET_IO_NON_BLOCKING) == 0)) {
+
+            Blocked = TRUE;
+        }
+
+        break;
+
+    default:
+
+        ASSERT(FALSE);
+
+        Status = STATUS_INVALID_PARAMETER;
+        break;
+    }
+
+    if (Blocked != FALSE) {
+        return STATUS_OPERATION_WOULD_BLOCK;
+    }
+
+    //
+    // Partial transfers are successes, like any other non-blocking I/O.
+    //
+
+    if (KSUCCESS(Status) ||
+        (((Status == STATUS_TIMEOUT) ||
+          (Status == STATUS_OPERATION_WOULD_BLOCK) ||
+          (Status == STATUS_INTERRUPTED)) &&
+         (BytesCompleted != 0))) {
+
+        ASSERT(BytesCompleted <= (UINTN)MAX_INTN);
+
+        *Result = (INTN)BytesCompleted;
+
+    } else {
+        *Result = Status;
+    }
+
+    return STATUS_SUCCESS;
+}
+
+KSTATUS
+IopParkIoRingRequest (
+    PIO_RING Ring,
+    PIO_RING_REQUEST Request
+    )
+
+/*++
+
+Routine Description:
+
+    This routine sets aside a request that needs to wait for its handle and
+    arms the handle on the ring's event queue. The ring lock must be held.
+
+Arguments:
+
+    Ring - Supplies a pointer to the I/O ring.
+
+    Request - Supplies a pointer to the request, which is copied. On success
+        the handle reference is transferred to the copy.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    PIO_RING_REQUEST Parked;
+    KSTATUS Status;
+
+    Parked = MmAllocatePagedPool(sizeof(IO_RING_REQUEST), IO_ALLOCATION_TAG);
+    if (Parked == NULL) {
+        return STATUS_INSUFFICIENT_RESOURCES;
+    }
+
+    RtlCopyMemory(Parked, Request, sizeof(IO_RING_REQUEST));
+    INSERT_BEFORE(&(Parked->ListEntry), &(Ring->PendingList));
+    Ring->PendingCount += 1;
+    Status = IopArmIoRingHandle(Ring, Parked->Handle);
+    if (!KSUCCESS(Status)) {
+        LIST_REMOVE(&(Parked->ListEntry));
+        Ring->PendingCount -= 1;
+        MmFreePagedPool(Parked);
+        return Status;
+    }
+
+    Request->Handle = NULL;
+    return STATUS_SUCCESS;
+}
+
+KSTATUS
+IopArmIoRingHandle (
+    PIO_RING Ring,
+    PIO_HANDLE Handle
+    )
+
+/*++
+
+Routine Description:
+
+    This routine updates a handle's registration on the ring's event queue to
+    watch for the combined events of all requests parked on it. The
+    registration is one-shot, so it fires once per arming. The ring lock must
+    be held.
+
+Arguments:
+
+    Ring - Supplies a pointer to the I/O ring.
+
+    Handle - Supplies a pointer to the I/O handle to arm.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    PLIST_ENTRY CurrentEntry;
+    EVENT_QUEUE_EVENT Event;
+    PIO_RING_REQUEST Request;
+    KSTATUS Status;
+
+    Event.Events = 0;
+    Event.Data = (UINTN)Handle;
+    CurrentEntry = Ring->PendingList.Next;
+    while (CurrentEntry != &(Ring->PendingList)) {
+        Request = LIST_VALUE(CurrentEntry, IO_RING_REQUEST, ListEntry);
+        CurrentEntry = CurrentEntry->Next;
+        if (Request->Handle == Handle) {
+            Event.Events |= Request->Events;
+        }
+    }
+
+    if (Event.Events == 0) {
+        IoControlEventQueue(Ring->EventQueue,
+                            EventQueueOperationDelete,
+                            Handle,
+                            &Event);
+
+        return STATUS_SUCCESS;
+    }
+
+    //
+    // Re-arming picks up events that are already set, so nothing that
+    // arrived since the last attempt is missed.
+    //
+
+    Event.Events |= EVENT_QUEUE_FLAG_ONE_SHOT;
+    Status = IoControlEventQueue(Ring->EventQueue,
+                                 EventQueueOperationModify,
+                                 Handle,
+                                 &Event);
+
+    if (Status == STATUS_NOT_FOUND) {
+        Status = IoControlEventQueue(Ring->EventQueue,
+                                     EventQueueOperationAdd,
+                                     Handle,
+                                     &Event);
+    }
+
+    return Status;
+}
+
+KSTATUS
+IopRetryIoRingRequests (
+    PIO_RING Ring,
+    PIO_HANDLE Handle
+    )
+
+/*++
+
+Routine Description:
+
+    This routine retries every request parked on the given handle, posting
+    the ones that finish and re-arming the handle for the rest. The ring lock
+    must be held.
+
+Arguments:
+
+    Ring - Supplies a pointer to the I/O ring.
+
+    Handle - Supplies a pointer to the I/O handle that became ready.
+
+Return Value:
+
+    Status code. Failure indicates the ring memory could not be accessed.
+
+--*/
+
+{
+
+    PLIST_ENTRY CurrentEntry;
+    BOOL Found;
+    PIO_RING_REQUEST Request;
+    INTN Result;
+    KSTATUS Status;
+
+    Found = FALSE;
+    Status = STATUS_SUCCESS;
+    CurrentEntry = Ring->PendingList.Next;
+    while (CurrentEntry != &(Ring->PendingList)) {
+        Request = LIST_VALUE(CurrentEntry, IO_RING_REQUEST, ListEntry);
+        CurrentEntry = CurrentEntry->Next;
+        if (Request->Handle != Handle) {
+            continue;
+        }
+
+        Found = TRUE;
+        Status = IopPerformIoRingRequest(Ring, Request, &Result);
+        if (Status == STATUS_OPERATION_WOULD_BLOCK) {
+            Status = STATUS_SUCCESS;
+            continue;
+        }
+
+        //
+        // The request's completion slot was set aside when it was parked,
+        // so give it back right before posting into it.
+        //
+
+        LIST_REMOVE(&(Request->ListEntry));
+        Ring->PendingCount -= 1;
+        Status = IopPostIoRingCompletion(Ring, Request->UserData, Result);
+        IoIoHandleReleaseReference(Request->Handle);
+        MmFreePagedPool(Request);
+        if (!KSUCCESS(Status)) {
+            break;
+        }
+    }
+
+    //
+    // A stale event for a handle with nothing parked is simply ignored.
+    //
+
+    if (Found != FALSE) {
+        IopArmIoRingHandle(Ring, Handle);
+    }
+
+    return Status;
+}
+
+KSTATUS
+IopWaitForIoRingCompletions (
+    PIO_RING Ring,
+    ULONG WaitCount,
+    ULONG TimeoutInMilliseconds
+    )
+
+/*++
+
+Routine Description:
+
+    This routine finishes parked requests whose handles are ready, waiting
+    until the given number of completions are available to user mode. When
+    the wait count is zero this only collects what is already ready, and the
+    ring lock must be held. Otherwise the ring lock must not be held, as it
+    is dropped while waiting.
+
+Arguments:
+
+    Ring - Supplies a pointer to the I/O ring.
+
+    WaitCount - Supplies the number of completions that should be available
+        in the completion array before returning.
+
+    TimeoutInMilliseconds - Supplies the number of milliseconds to wait.
+
+Return Value:
+
+    STATUS_SUCCESS if the completions are available, or if nothing is left
+    parked that could add to them.
+
+    STATUS_TIMEOUT if the completions did not arrive in time.
+
+    STATUS_INTERRUPTED if the wait was interrupted by a signal.
+
+    Other error codes on failure.
+
+--*/
+
+{
+
+    ULONG Available;
+    ULONG Count;
+    ULONGLONG CurrentTime;
+    ULONGLONG EndTime;
+    EVENT_QUEUE_EVENT Events[IO_RING_WAIT_EVENT_COUNT];
+    PIO_HANDLE Handle;
+    ULONG Index;
+    ULONG Timeout;
+    KSTATUS Status;
+
+    if (WaitCount != 0) {
+        KeAcquireQueuedLock(Ring->Lock);
+    }
+
+    //
+    // Each pass may only retire some of the wanted completions, so compute
+    // the deadline once and only wait for whatever is left of it.
+    //
+
+    EndTime = 0;
+    if ((WaitCount != 0) &&
+        (TimeoutInMilliseconds != 0) &&
+        (TimeoutInMilliseconds != WAIT_TIME_INDEFINITE)) {
+
+        EndTime = HlQueryTimeCounter() +
+                  KeConvertMicrosecondsToTimeTicks(
+                      (ULONGLONG)TimeoutInMilliseconds *
+                      MICROSECONDS_PER_MILLISECOND);
+    }
+
+    Timeout = 0;
+    while (TRUE) {
+
+        //
+        // Collect any ready handles without waiting.
+        //
+
+        Count = 0;
+        if (Ring->PendingCount != 0) {
+            if (Timeout != 0) {
+                KeReleaseQueuedLock(Ring->Lock);
+            }
+
+            Status = IoWaitForEventQueue(Ring->EventQueue,
+                                         Events,
+                                         IO_RING_WAIT_EVENT_COUNT,
+                                         Timeout,
+                                         &Count);
+
+            if (Timeout != 0) {
+                KeAcquireQueuedLock(Ring->Lock);
+            }
+
+            if ((!KSUCCESS(Status)) && (Status != STATUS_TIMEOUT)) {
+                break;
+            }
+
+            for (Index = 0; Index < Count; Index += 1) {
+                Handle = (PIO_HANDLE)(UINTN)(Events[Index].Data);
+                Status = IopRetryIoRingRequests(Ring, Handle);
+
+                if (!KSUCCESS(Status)) {
+                    goto WaitForIoRingCompletionsEnd;
+                }
+            }
+        }
+
+        Status = STATUS_SUCCESS;
+        if (WaitCount == 0) {
+            break;
+        }
+
+        Status = IopGetIoRingCompletionCount(Ring, &Available);
+        if ((!KSUCCESS(Status)) ||
+            (Available >= WaitCount) ||
+            (Ring->PendingCount == 0)) {
+
+            break;
+        }
+
+        //
+        // Don't go back to sleep after a real wait came back empty.
+        //
+
+        if ((Timeout != 0) && (Count == 0)) {
+            Status = STATUS_TIMEOUT;
+            break;
+        }
+
+        Timeout = TimeoutInMilliseconds;
+        if (Timeout == 0) {
+            Status = STATUS_TIMEOUT;
+            break;
+        }
+
+        if (EndTime != 0) {
+            CurrentTime = HlQueryTimeCounter();
+            if (CurrentTime >= EndTime) {
+                Status = STATUS_TIMEOUT;
+                break;
+            }
+
+            Timeout = ((EndTime - CurrentTime) * MILLISECONDS_PER_SECOND) /
+                      HlQueryTimeCounterFrequency();
+
+            if (Timeout == 0) {
+                Timeout = 1;
+            }
+        }
+    }
+
+WaitForIoRingCompletionsEnd:
+    if (WaitCount != 0) {
+        KeReleaseQueuedLock(Ring->Lock);
+    }
+
+    return Status;
+}
+
+KSTATUS
+IopGetIoRingCompletionCount (
+    PIO_RING Ring,
+    PULONG Count
+    )
+
+/*++
+
+Routine Description:
+
+    This routine determines how many posted completions user mode has not yet
+    consumed. The ring lock must be held.
+
+Arguments:
+
+    Ring - Supplies a pointer to the I/O ring.
+
+    Count - Supplies a pointer where the number of unconsumed completions
+        will be returned.
+
+Return Value:
+
+    STATUS_SUCCESS on success.
+
+    STATUS_ACCESS_VIOLATION if the ring memory is no longer accessible.
+
+    STATUS_INVALID_PARAMETER if user mode corrupted the completion head.
+
+--*/
+
+{
+
+    ULONG Head;
+
+    if (MmUserRead32(&(Ring->Shared->CompletionHead), &Head) == FALSE) {
+        return STATUS_ACCESS_VIOLATION;
+    }
+
+    *Count = Ring->CompletionTail - Head;
+    if (*Count > Ring->CompletionCount) {
+        return STATUS_INVALID_PARAMETER;
+    }
+
+    return STATUS_SUCCESS;
+}
+
+KSTATUS
+IopPostIoRingCompletion (
+    PIO_RING Ring,
+    ULONGLONG UserData,
+    INTN Result
+    )
+
+/*++
+
+Routine Description:
+
+    This routine writes a completion into the ring and publishes it to user
+    mode. Requests are only taken when their completion has a slot, so the
+    completion array never overflows. The ring lock must be held.
+
+Arguments:
+
+    Ring - Supplies a pointer to the I/O ring.
+
+    UserData - Supplies the opaque value from the submission.
+
+    Result - Supplies the result of the request.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    IO_RING_COMPLETION Completion;
+    ULONG Index;
+    KSTATUS Status;
+
+    Completion.UserData = UserData;
+    Completion.Result = Result;
+    Index = Ring->CompletionTail & (Ring->CompletionCount - 1);
+    Status = MmCopyToUserMode(&(Ring->Completions[Index]),
+                              &Completion,
+                              sizeof(IO_RING_COMPLETION));
+
+    if (!KSUCCESS(Status)) {
+        return Status;
+    }
+
+    //
+    // Make sure the entry is visible before the new tail.
+    //
+
+    RtlMemoryBarrier();
+    Ring->CompletionTail += 1;
+    if (MmUserWrite32(&(Ring->Shared->CompletionTail),
+                      Ring->CompletionTail) == FALSE) {
+
+        return STATUS_ACCESS_VIOLATION;
+    }
+
+    return STATUS_SUCCESS;
+}
+
+KSTATUS
+IopRegisterIoRingHandles (
+    PIO_RING Ring,
+    PHANDLE Array,
+    ULONG Count
+    )
+
+/*++
+
+Routine Description:
+
+    This routine looks up and registers a set of handles with an I/O ring so
+    that submissions can refer to them by index. The ring lock must be held.
+
+Arguments:
+
+    Ring - Supplies a pointer to the I/O ring.
+
+    Array - Supplies a pointer to the kernel copy of the handle array.
+        INVALID_HANDLE leaves a slot empty.
+
+    Count - Supplies the number of handles.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    PIO_HANDLE *Handles;
+    ULONG Index;
+    PIO_HANDLE IoHandle;
+    KSTATUS Status;
+
+    if (Ring->Handles != NULL) {
+        return STATUS_RESOURCE_IN_USE;
+    }
+
+    Handles = MmAllocatePagedPool(Count * sizeof(PIO_HANDLE),
+                                  IO_ALLOCATION_TAG);
+
+    if (Handles == NULL) {
+        return STATUS_INSUFFICIENT_RESOURCES;
+    }
+
+    RtlZeroMemory(Handles, Count * sizeof(PIO_HANDLE));
+    Ring->Handles = Handles;
+    Ring->HandleCount = Count;
+    for (Index = 0; Index < Count; Index += 1) {
+        if (Array[Index] == INVALID_HANDLE) {
+            continue;
+        }
+
+        IoHandle = ObGetHandleValue(Ring->Process->HandleTable,
+                                    Array[Index],
+                                    NULL);
+
+        if (IoHandle == NULL) {
+            Status = STATUS_INVALID_HANDLE;
+            goto RegisterIoRingHandlesEnd;
+        }
+
+        //
+        // A ring holding a reference to itself would never be closed.
+        //
+
+        if (IoHandle->FileObject->Properties.Type == IoObjectIoRing) {
+            IoIoHandleReleaseReference(IoHandle);
+            Status = STATUS_INVALID_PARAMETER;
+            goto RegisterIoRingHandlesEnd;
+        }
+
+        Handles[Index] = IoHandle;
+    }
+
+    Status = STATUS_SUCCESS;
+
+RegisterIoRingHandlesEnd:
+    if (!KSUCCESS(Status)) {
+        IopUnregisterIoRingHandles(Ring);
+    }
+
+    return Status;
+}
+
+KSTATUS
+IopRegisterIoRingBuffers (
+    PIO_RING Ring,
+    PIO_VECTOR Array,
+    ULONG Count
+    )
+
+/*++
+
+Routine Description:
+
+    This routine validates and registers a set of buffers with an I/O ring so
+    that submissions can refer to them by index. The ring lock must be held.
+
+Arguments:
+
+    Ring - Supplies a pointer to the I/O ring.
+
+    Array - Supplies a pointer to the kernel copy of the I/O vector array
+        describing the buffers.
+
+    Count - Supplies the number of buffers.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    PIO_RING_BUFFER Buffers;
+    PVOID End;
+    ULONG Index;
+
+    if (Ring->Buffers != NULL) {
+        return STATUS_RESOURCE_IN_USE;
+    }
+
+    for (Index = 0; Index < Count; Index += 1) {
+        End = Array[Index].Data + Array[Index].Length;
+        if ((Array[Index].Length > (UINTN)MAX_INTN) ||
+            (End > USER_VA_END) ||
+            (End < Array[Index].Data)) {
+
+            return STATUS_INVALID_PARAMETER;
+        }
+    }
+
+    Buffers = MmAllocatePagedPool(Count * sizeof(IO_RING_BUFFER),
+                                  IO_ALLOCATION_TAG);
+
+    if (Buffers == NULL) {
+        return STATUS_INSUFFICIENT_RESOURCES;
+    }
+
+    for (Index = 0; Index < Count; Index += 1) {
+        Buffers[Index].Buffer = Array[Index].Data;
+        Buffers[Index].Size = Array[Index].Length;
+    }
+
+    Ring->Buffers = Buffers;
+    Ring->BufferCount = Count;
+    return STATUS_SUCCESS;
+}
+
+VOID
+IopUnregisterIoRingHandles (
+    PIO_RING Ring
+    )
+
+/*++
+
+Routine Description:
+
+    This routine releases the handles registered with an I/O ring. Parked
+    requests hold their own references, so they are unaffected. The ring lock
+    must be held.
+
+Arguments:
+
+    Ring - Supplies a pointer to the I/O ring.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    ULONG Index;
+
+    if (Ring->Handles == NULL) {
+        return;
+    }
+
+    for (Index = 0; Index < Ring->HandleCount; Index += 1) {
+        if (Ring->Handles[Index] != NULL) {
+            IoIoHandleReleaseReference(Ring->Handles[Index]);
+        }
+    }
+
+    MmFreePagedPool(Ring->Handles);
+    Ring->Handles = NULL;
+    Ring->HandleCount = 0;
+    return;
+}
+
+VOID
+IopUnregisterIoRingBuffers (
+    PIO_RING Ring
+    )
+
+/*++
+
+Routine Description:
+
+    This routine forgets the buffers registered with an I/O ring. The ring
+    lock must be held.
+
+Arguments:
+
+    Ring - Supplies a pointer to the I/O ring.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    if (Ring->Buffers == NULL) {
+        return;
+    }
+
+    MmFreePagedPool(Ring->Buffers);
+    Ring->Buffers = NULL;
+    Ring->BufferCount = 0;
+    return;
+}
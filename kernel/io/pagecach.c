@@ -2415,6 +2415,93 @@ Return Value:
     return;
 }
 
+VOID
+IopDeprioritizePageCacheEntries (
+    PFILE_OBJECT FileObject,
+    IO_OFFSET Offset,
+    ULONGLONG Size
+    )
+
+/*++
+
+Routine Description:
+
+    This routine moves the clean page cache entries for the given region of a
+    file or device to the front of the clean list, so that they are the first
+    to be reclaimed when the page cache is trimmed. Dirty entries are left
+    alone. The file object lock must be held at least shared.
+
+Arguments:
+
+    FileObject - Supplies a pointer to a file object for the device or file.
+
+    Offset - Supplies the starting offset into the file or device.
+
+    Size - Supplies the size of the region, in bytes. Supply 0 to include all
+        entries after the offset.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PPAGE_CACHE_ENTRY CacheEntry;
+    IO_OFFSET EndOffset;
+    PRED_BLACK_TREE_NODE Node;
+    PAGE_CACHE_ENTRY SearchEntry;
+
+    ASSERT(KeIsSharedExclusiveLockHeld(FileObject->Lock) != FALSE);
+
+    if ((IO_IS_FILE_OBJECT_CACHEABLE(FileObject) == FALSE) ||
+        (RED_BLACK_TREE_EMPTY(&(FileObject->PageCacheTree)) != FALSE)) {
+
+        return;
+    }
+
+    EndOffset = MAX_LONGLONG;
+    if ((Size != 0) && (Size < (ULONGLONG)(MAX_LONGLONG - Offset))) {
+        EndOffset = Offset + Size;
+    }
+
+    SearchEntry.FileObject = FileObject;
+    SearchEntry.Offset = Offset;
+    SearchEntry.Flags = 0;
+    Node = RtlRedBlackTreeSearchClosest(&(FileObject->PageCacheTree),
+                                        &(SearchEntry.Node),
+                                        TRUE);
+
+    //
+    // Insert each entry at the head of the clean list. Entries that are not
+    // on a list currently have references, and will be put back at the tail
+    // when those are released.
+    //
+
+    KeAcquireQueuedLock(IoPageCacheListLock);
+    while (Node != NULL) {
+        CacheEntry = LIST_VALUE(Node, PAGE_CACHE_ENTRY, Node);
+        if (CacheEntry->Offset >= EndOffset) {
+            break;
+        }
+
+        if (((CacheEntry->Flags & PAGE_CACHE_ENTRY_FLAG_DIRTY_MASK) == 0) &&
+            (CacheEntry->ListEntry.Next != NULL)) {
+
+            LIST_REMOVE(&(CacheEntry->ListEntry));
+            INSERT_AFTER(&(CacheEntry->ListEntry), &IoPageCacheCleanList);
+        }
+
+        Node = RtlRedBlackTreeGetNextNode(&(FileObject->PageCacheTree),
+                                          FALSE,
+                                          Node);
+    }
+
+    KeReleaseQueuedLock(IoPageCacheListLock);
+    return;
+}
+
 BOOL
 IopIsIoBufferPageCacheBacked (
     PFILE_OBJECT FileObject,
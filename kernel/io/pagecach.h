@@ -309,6 +309,37 @@ Return Value:
 
 --*/
 
+VOID
+IopDeprioritizePageCacheEntries (
+    PFILE_OBJECT FileObject,
+    IO_OFFSET Offset,
+    ULONGLONG Size
+    );
+
+/*++
+
+Routine Description:
+
+    This routine moves the clean page cache entries for the given region of a
+    file or device to the front of the clean list, so that they are the first
+    to be reclaimed when the page cache is trimmed. Dirty entries are left
+    alone. The file object lock must be held at least shared.
+
+Arguments:
+
+    FileObject - Supplies a pointer to a file object for the device or file.
+
+    Offset - Supplies the starting offset into the file or device.
+
+    Size - Supplies the size of the region, in bytes. Supply 0 to include all
+        entries after the offset.
+
+Return Value:
+
+    None.
+
+--*/
+
 BOOL
 IopIsIoBufferPageCacheBacked (
     PFILE_OBJECT FileObject,
@@ -108,7 +108,8 @@ Return Value:
            (Interface->Receive != NULL) &&
            (Interface->GetSetSocketInformation != NULL) &&
            (Interface->Shutdown != NULL) &&
-           (Interface->UserControl != NULL));
+           (Interface->UserControl != NULL) &&
+           (Interface->SendMessages != NULL));
 
     if (IoNetInterfaceInitialized != FALSE) {
 
@@ -456,6 +457,7 @@ KERNEL_API
 KSTATUS
 IoSocketAccept (
     PIO_HANDLE Handle,
+    BOOL NonBlocking,
     PIO_HANDLE *NewConnectionSocket,
     PNETWORK_ADDRESS RemoteAddress,
     PCSTR *RemotePath,
@@ -473,6 +475,11 @@ Routine Description:
 
     Handle - Supplies a pointer to the socket to accept a connection from.
 
+    NonBlocking - Supplies a boolean indicating whether to fail with
+        STATUS_OPERATION_WOULD_BLOCK rather than wait if no connection is
+        pending. The accept also never waits if the socket's handle was
+        opened non-blocking.
+
     NewConnectionSocket - Supplies a pointer where a new socket will be
         returned that represents the accepted connection with the remote
         host.
@@ -508,6 +515,7 @@ Return Value:
 
     if (Socket->Domain == NetDomainLocal) {
         Status = IopUnixSocketAccept(Socket,
+                                     NonBlocking,
                                      NewConnectionSocket,
                                      RemoteAddress,
                                      RemotePath,
@@ -519,6 +527,7 @@ Return Value:
 
         } else {
             Status = IoNetInterface.Accept(Socket,
+                                           NonBlocking,
                                            NewConnectionSocket,
                                            RemoteAddress);
         }
@@ -761,6 +770,196 @@ Return Value:
     return Status;
 }
 
+KERNEL_API
+KSTATUS
+IoSocketSendMessages (
+    BOOL FromKernelMode,
+    PIO_HANDLE Handle,
+    PSOCKET_IO_MESSAGE Messages,
+    ULONG MessageCount,
+    PULONG MessagesCompleted
+    )
+
+/*++
+
+Routine Description:
+
+    This routine sends a batch of messages through the network. Messages are
+    sent in order, and sending stops at the first message that fails.
+
+Arguments:
+
+    FromKernelMode - Supplies a boolean indicating if the request is coming
+        from kernel mode or user mode. This value affects the root path node
+        to traverse for local domain sockets.
+
+    Handle - Supplies a pointer to the socket to send the data to.
+
+    Messages - Supplies an array of messages to send.
+
+    MessageCount - Supplies the number of elements in the message array.
+
+    MessagesCompleted - Supplies a pointer where the number of messages sent
+        will be returned.
+
+Return Value:
+
+    STATUS_SUCCESS if every message was sent.
+
+    Otherwise, returns the status of the message that stopped the batch.
+
+--*/
+
+{
+
+    ULONG Completed;
+    ULONG Index;
+    PSOCKET_IO_PARAMETERS Parameters;
+    PSOCKET Socket;
+    ULONG SocketIoFlags;
+    KSTATUS Status;
+
+    Completed = 0;
+    Socket = NULL;
+    Status = IoGetSocketFromHandle(Handle, &Socket);
+    if (!KSUCCESS(Status)) {
+        goto SocketSendMessagesEnd;
+    }
+
+    for (Index = 0; Index < MessageCount; Index += 1) {
+        Parameters = &(Messages[Index].Parameters);
+        if ((Parameters->SocketIoFlags & SOCKET_IO_NON_BLOCKING) != 0) {
+            Parameters->TimeoutInMilliseconds = 0;
+        }
+    }
+
+    //
+    // Local sockets have no packets to batch, so send each message in turn.
+    // Network sockets hand the whole batch down so that protocols can build
+    // the packets together.
+    //
+
+    if (Socket->Domain == NetDomainLocal) {
+        while (Completed < MessageCount) {
+            Parameters = &(Messages[Completed].Parameters);
+            Status = IopUnixSocketSendData(FromKernelMode,
+                                           Socket,
+                                           Parameters,
+                                           Messages[Completed].IoBuffer);
+
+            if (!KSUCCESS(Status)) {
+                break;
+            }
+
+            Completed += 1;
+        }
+
+    } else {
+        if (IoNetInterfaceInitialized == FALSE) {
+            Status = STATUS_NOT_IMPLEMENTED;
+
+        } else {
+            Status = IoNetInterface.SendMessages(FromKernelMode,
+                                                 Socket,
+                                                 Messages,
+                                                 MessageCount,
+                                                 &Completed);
+        }
+    }
+
+    if ((Status == STATUS_TIMEOUT) && (Completed < MessageCount)) {
+        SocketIoFlags = Messages[Completed].Parameters.SocketIoFlags;
+        if ((SocketIoFlags & SOCKET_IO_NON_BLOCKING) != 0) {
+            Status = STATUS_OPERATION_WOULD_BLOCK;
+        }
+    }
+
+SocketSendMessagesEnd:
+    *MessagesCompleted = Completed;
+    return Status;
+}
+
+KERNEL_API
+KSTATUS
+IoSocketReceiveMessages (
+    BOOL FromKernelMode,
+    PIO_HANDLE Handle,
+    PSOCKET_IO_MESSAGE Messages,
+    ULONG MessageCount,
+    PULONG MessagesCompleted
+    )
+
+/*++
+
+Routine Description:
+
+    This routine receives a batch of messages from a socket. Messages are
+    received in order, and receiving stops at the first message that fails.
+    If a message's flags include SOCKET_IO_WAIT_FOR_ONE, that message does not
+    block unless it is the first.
+
+Arguments:
+
+    FromKernelMode - Supplies a boolean indicating if the request is coming
+        from kernel mode or user mode. This value affects the root path node
+        to traverse for local domain sockets.
+
+    Handle - Supplies a pointer to the socket to receive data from.
+
+    Messages - Supplies an array of messages to receive into.
+
+    MessageCount - Supplies the number of elements in the message array.
+
+    MessagesCompleted - Supplies a pointer where the number of messages
+        received will be returned. A message that reached the end of the file
+        counts as received.
+
+Return Value:
+
+    STATUS_SUCCESS if every message was received.
+
+    Otherwise, returns the status of the message that stopped the batch.
+
+--*/
+
+{
+
+    ULONG Completed;
+    PSOCKET_IO_PARAMETERS Parameters;
+    KSTATUS Status;
+
+    Completed = 0;
+    Status = STATUS_SUCCESS;
+    while (Completed < MessageCount) {
+        Parameters = &(Messages[Completed].Parameters);
+        if ((Completed != 0) &&
+            ((Parameters->SocketIoFlags & SOCKET_IO_WAIT_FOR_ONE) != 0)) {
+
+            Parameters->SocketIoFlags |= SOCKET_IO_NON_BLOCKING;
+        }
+
+        Parameters->SocketIoFlags &= ~SOCKET_IO_WAIT_FOR_ONE;
+        Status = IoSocketReceiveData(FromKernelMode,
+                                     Handle,
+                                     Parameters,
+                                     Messages[Completed].IoBuffer);
+
+        if (Status == STATUS_END_OF_FILE) {
+            Completed += 1;
+            break;
+        }
+
+        if (!KSUCCESS(Status)) {
+            break;
+        }
+
+        Completed += 1;
+    }
+
+    *MessagesCompleted = Completed;
+    return Status;
+}
+
 KERNEL_API
 KSTATUS
 IoSocketGetSetInformation (
@@ -1407,6 +1606,7 @@ Return Value:
     RemotePath = NULL;
     RemotePathSize = 0;
     Status = IoSocketAccept(IoHandle,
+                            FALSE,
                             &NewHandle,
                             &(Parameters->Address),
                             &RemotePath,
@@ -1849,6 +2049,202 @@ Return Value:
     return Status;
 }
 
+INTN
+IoSysSocketPerformMessageIo (
+    PVOID SystemCallParameter
+    )
+
+/*++
+
+Routine Description:
+
+    This routine handles the system call that sends or receives several socket
+    messages at once.
+
+Arguments:
+
+    SystemCallParameter - Supplies a pointer to the parameters supplied with
+        the system call. This structure will be a stack-local copy of the
+        actual parameters passed from user-mode.
+
+Return Value:
+
+    Returns the number of messages completed on success.
+
+    Error status code on failure.
+
+--*/
+
+{
+
+    UINTN AllocationSize;
+    ULONG Completed;
+    ULONG CopyCount;
+    ULONG Count;
+    ULONG Index;
+    PIO_HANDLE IoHandle;
+    PSOCKET_IO_MESSAGE IoMessages;
+    PSOCKET_MESSAGE Messages;
+    PSOCKET_IO_PARAMETERS MessageParameters;
+    PSYSTEM_CALL_SOCKET_PERFORM_MESSAGE_IO Parameters;
+    PKPROCESS Process;
+    KSTATUS Status;
+    BOOL Write;
+
+    Completed = 0;
+    Count = 0;
+    IoMessages = NULL;
+    Messages = NULL;
+    Parameters = (PSYSTEM_CALL_SOCKET_PERFORM_MESSAGE_IO)SystemCallParameter;
+    Process = PsGetCurrentProcess();
+    Write = ((Parameters->IoFlags & SYS_IO_FLAG_WRITE) != 0);
+    IoHandle = ObGetHandleValue(Process->HandleTable, Parameters->Socket, NULL);
+    if (IoHandle == NULL) {
+        Status = STATUS_INVALID_HANDLE;
+        goto SysSocketPerformMessageIoEnd;
+    }
+
+    if (Parameters->MessageCount == 0) {
+        Status = STATUS_SUCCESS;
+        goto SysSocketPerformMessageIoEnd;
+    }
+
+    if (Parameters->MessageCount > SYS_SOCKET_MESSAGE_MAX) {
+        Status = STATUS_INVALID_PARAMETER;
+        goto SysSocketPerformMessageIoEnd;
+    }
+
+    //
+    // Make one allocation for the copy of the user's messages and the kernel
+    // messages built from them.
+    //
+
+    AllocationSize = (sizeof(SOCKET_MESSAGE) + sizeof(SOCKET_IO_MESSAGE)) *
+                     Parameters->MessageCount;
+
+    Messages = MmAllocatePagedPool(AllocationSize, IO_ALLOCATION_TAG);
+    if (Messages == NULL) {
+        Status = STATUS_INSUFFICIENT_RESOURCES;
+        goto SysSocketPerformMessageIoEnd;
+    }
+
+    IoMessages = (PSOCKET_IO_MESSAGE)(Messages + Parameters->MessageCount);
+    Status = MmCopyFromUserMode(Messages,
+                                Parameters->MessageArray,
+                                sizeof(SOCKET_MESSAGE) *
+                                Parameters->MessageCount);
+
+    if (!KSUCCESS(Status)) {
+        goto SysSocketPerformMessageIoEnd;
+    }
+
+    while (Count < Parameters->MessageCount) {
+        MessageParameters = &(IoMessages[Count].Parameters);
+        RtlCopyMemory(MessageParameters,
+                      &(Messages[Count].Parameters),
+                      sizeof(SOCKET_IO_PARAMETERS));
+
+        MessageParameters->BytesCompleted = 0;
+        MessageParameters->IoFlags = Parameters->IoFlags & SYS_IO_FLAG_MASK;
+
+        //
+        // Non-blocking handles always have a timeout of zero.
+        //
+
+        if ((IoHandle->OpenFlags & OPEN_FLAG_NON_BLOCKING) != 0) {
+            MessageParameters->TimeoutInMilliseconds = 0;
+        }
+
+        Status = MmCreateIoBufferFromVector(Messages[Count].VectorArray,
+                                            FALSE,
+                                            Messages[Count].VectorCount,
+                                            &(IoMessages[Count].IoBuffer));
+
+        if (!KSUCCESS(Status)) {
+            goto SysSocketPerformMessageIoEnd;
+        }
+
+        Count += 1;
+    }
+
+    if (Write != FALSE) {
+        Status = IoSocketSendMessages(FALSE,
+                                      IoHandle,
+                                      IoMessages,
+                                      Count,
+                                      &Completed);
+
+        //
+        // Send a pipe signal if the returning status was "broken pipe".
+        //
+
+        if (Status == STATUS_BROKEN_PIPE) {
+
+            ASSERT(Process != PsGetKernelProcess());
+
+            PsSignalProcess(Process, SIGNAL_BROKEN_PIPE, NULL);
+        }
+
+    } else {
+        Status = IoSocketReceiveMessages(FALSE,
+                                         IoHandle,
+                                         IoMessages,
+                                         Count,
+                                         &Completed);
+    }
+
+    //
+    // Copy the updated parameters out for every message that was attempted.
+    //
+
+    CopyCount = Completed;
+    if (CopyCount < Count) {
+        CopyCount += 1;
+    }
+
+    for (Index = 0; Index < CopyCount; Index += 1) {
+        MmCopyToUserMode(&(Parameters->MessageArray[Index].Parameters),
+                         &(IoMessages[Index].Parameters),
+                         sizeof(SOCKET_IO_PARAMETERS));
+    }
+
+SysSocketPerformMessageIoEnd:
+    for (Index = 0; Index < Count; Index += 1) {
+        MmFreeIoBuffer(IoMessages[Index].IoBuffer);
+    }
+
+    if (Messages != NULL) {
+        MmFreePagedPool(Messages);
+    }
+
+    //
+    // An interrupted socket cannot be restarted if a timeout has been set.
+    //
+
+    if ((Status == STATUS_INTERRUPTED) && (Completed == 0)) {
+        Status = IopConvertInterruptedSocketStatus(IoHandle, 0, Write);
+    }
+
+    //
+    // Release the reference that was added when the handle was looked up.
+    //
+
+    if (IoHandle != NULL) {
+        IoIoHandleReleaseReference(IoHandle);
+    }
+
+    //
+    // Report the messages that made it. The failure that stopped the batch
+    // will be seen again on the next call.
+    //
+
+    if (Completed != 0) {
+        return Completed;
+    }
+
+    return Status;
+}
+
 INTN
 IoSysSocketGetSetInformation (
     PVOID SystemCallParameter
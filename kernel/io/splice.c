@@ -0,0 +1,670 @@
+/*++
+
+Copyright (c) 2026 Minoca Corp.
+
+    This file is licensed under the terms of the GNU General Public License
+    version 3. Alternative licensing terms are available. Contact
+    info@minocacorp.com for details. See the LICENSE file at the root of this
+    project for complete licensing information.
+
+Module Name:
+
+    splice.c
+
+Abstract:
+
+    This module implements moving data directly from one I/O handle to
+    another. Data read from a cached file is handed to the destination as
+    references to the page cache entries themselves, so it is never copied
+    into an intermediate buffer or through user mode.
+
+Author:
+
+    Minoca Corp. 18-Oct-2026
+
+Environment:
+
+    Kernel
+
+--*/
+
+//
+// ------------------------------------------------------------------- Includes
+//
+
+#include <minoca/kernel/kernel.h>
+#include "iop.h"
+
+//
+// ---------------------------------------------------------------- Definitions
+//
+
+//
+// Define the largest amount of data moved in each round. This bounds how many
+// page cache entries are held at once.
+//
+
+#define SPLICE_MAX_ROUND_SIZE _64KB
+
+//
+// Define the most data read from an uncached source for a non-blocking
+// destination. A writable pipe always has room for an atomic write, so the
+// destination can take all of it once it reports that it is writable.
+//
+
+#define SPLICE_NON_BLOCKING_ROUND_SIZE PIPE_ATOMIC_WRITE_SIZE
+
+//
+// This macro evaluates to non-zero if the given status means that a
+// non-blocking handle was not ready.
+//
+
+#define SPLICE_WOULD_BLOCK(_Status)                 \
+    (((_Status) == STATUS_TRY_AGAIN) ||             \
+     ((_Status) == STATUS_OPERATION_WOULD_BLOCK) || \
+     ((_Status) == STATUS_TIMEOUT))
+
+//
+// ------------------------------------------------------ Data Type Definitions
+//
+
+//
+// ----------------------------------------------- Internal Function Prototypes
+//
+
+KSTATUS
+IopSpliceFromPageCache (
+    PIO_HANDLE Source,
+    IO_OFFSET SourceOffset,
+    PIO_HANDLE Destination,
+    IO_OFFSET DestinationOffset,
+    UINTN SizeInBytes,
+    ULONG TimeoutInMilliseconds,
+    ULONG DestinationTimeout,
+    PUINTN BytesCompleted
+    );
+
+KSTATUS
+IopSpliceThroughBuffer (
+    PIO_HANDLE Source,
+    IO_OFFSET SourceOffset,
+    PIO_HANDLE Destination,
+    IO_OFFSET DestinationOffset,
+    UINTN SizeInBytes,
+    ULONG TimeoutInMilliseconds,
+    ULONG DestinationTimeout,
+    PUINTN BytesCompleted
+    );
+
+//
+// -------------------------------------------------------------------- Globals
+//
+
+//
+// ------------------------------------------------------------------ Functions
+//
+
+KERNEL_API
+KSTATUS
+IoSplice (
+    PIO_HANDLE Source,
+    IO_OFFSET SourceOffset,
+    PIO_HANDLE Destination,
+    IO_OFFSET DestinationOffset,
+    UINTN SizeInBytes,
+    ULONG TimeoutInMilliseconds,
+    PUINTN BytesCompleted
+    )
+
+/*++
+
+Routine Description:
+
+    This routine moves data from one I/O handle to another without copying it
+    through an intermediate buffer. If the source is a cached file, its page
+    cache entries are handed to the destination by reference. Other sources
+    are read into a kernel buffer and written out from there.
+
+Arguments:
+
+    Source - Supplies the open I/O handle to read from.
+
+    SourceOffset - Supplies the offset in the source to read from. Supply
+        IO_OFFSET_NONE to use and advance the source's current file position.
+
+    Destination - Supplies the open I/O handle to write to.
+
+    DestinationOffset - Supplies the offset in the destination to write to.
+        Supply IO_OFFSET_NONE to use and advance the destination's current file
+        position.
+
+    SizeInBytes - Supplies the number of bytes to move.
+
+    TimeoutInMilliseconds - Supplies the number of milliseconds to wait for
+        the source to produce data. Use WAIT_TIME_INDEFINITE to wait forever.
+        This is ignored if the source is non-blocking.
+
+    BytesCompleted - Supplies a pointer where the number of bytes written to
+        the destination will be returned.
+
+Return Value:
+
+    Status code. A failing status code does not necessarily mean no data was
+    moved. Check the bytes completed value to find out how much occurred.
+
+--*/
+
+{
+
+    ULONG DestinationTimeout;
+    PFILE_OBJECT FileObject;
+    KSTATUS Status;
+
+    ASSERT(KeGetRunLevel() == RunLevelLow);
+
+    *BytesCompleted = 0;
+    if ((Source->HandleType != IoHandleTypeDefault) ||
+        (Destination->HandleType != IoHandleTypeDefault)) {
+
+        return STATUS_INVALID_HANDLE;
+    }
+
+    if (SizeInBytes == 0) {
+        return STATUS_SUCCESS;
+    }
+
+    //
+    // Non-blocking handles never wait. Otherwise the source wait is bounded by
+    // the caller's timeout, and destination writes block like a regular write.
+    //
+
+    if ((Source->OpenFlags & OPEN_FLAG_NON_BLOCKING) != 0) {
+        TimeoutInMilliseconds = 0;
+    }
+
+    DestinationTimeout = WAIT_TIME_INDEFINITE;
+    if ((Destination->OpenFlags & OPEN_FLAG_NON_BLOCKING) != 0) {
+        DestinationTimeout = 0;
+    }
+
+    FileObject = Source->FileObject;
+    if ((FileObject != NULL) &&
+        (IO_IS_FILE_OBJECT_CACHEABLE(FileObject) != FALSE)) {
+
+        Status = IopSpliceFromPageCache(Source,
+                                        SourceOffset,
+                                        Destination,
+                                        DestinationOffset,
+                                        SizeInBytes,
+                                        TimeoutInMilliseconds,
+                                        DestinationTimeout,
+                                        BytesCompleted);
+
+    } else {
+        Status = IopSpliceThroughBuffer(Source,
+                                        SourceOffset,
+                                        Destination,
+                                        DestinationOffset,
+                                        SizeInBytes,
+                                        TimeoutInMilliseconds,
+                                        DestinationTimeout,
+                                        BytesCompleted);
+    }
+
+    return Status;
+}
+
+INTN
+IoSysSplice (
+    PVOID SystemCallParameter
+    )
+
+/*++
+
+Routine Description:
+
+    This routine moves data from one handle to another on behalf of user mode.
+
+Arguments:
+
+    SystemCallParameter - Supplies a pointer to the parameters supplied with
+        the system call. This structure will be a stack-local copy of the
+        actual parameters passed from user-mode.
+
+Return Value:
+
+    STATUS_SUCCESS or the number of bytes completed (a positive integer) on
+    success.
+
+    Error status code (a negative integer) on failure.
+
+--*/
+
+{
+
+    UINTN BytesCompleted;
+    PKPROCESS CurrentProcess;
+    PIO_HANDLE Destination;
+    PSYSTEM_CALL_SPLICE Parameters;
+    INTN Result;
+    PIO_HANDLE Source;
+    KSTATUS Status;
+
+    ASSERT(SYS_WAIT_TIME_INDEFINITE == WAIT_TIME_INDEFINITE);
+
+    CurrentProcess = PsGetCurrentProcess();
+    Parameters = (PSYSTEM_CALL_SPLICE)SystemCallParameter;
+    BytesCompleted = 0;
+    Destination = NULL;
+    Source = ObGetHandleValue(CurrentProcess->HandleTable,
+                              Parameters->Source,
+                              NULL);
+
+    if (Source == NULL) {
+        Status = STATUS_INVALID_HANDLE;
+        goto SysSpliceEnd;
+    }
+
+    Destination = ObGetHandleValue(CurrentProcess->HandleTable,
+                                   Parameters->Destination,
+                                   NULL);
+
+    if (Destination == NULL) {
+        Status = STATUS_INVALID_HANDLE;
+        goto SysSpliceEnd;
+    }
+
+    //
+    // Like regular I/O, treat negative sizes as zero.
+    //
+
+    if (Parameters->Size <= 0) {
+        Status = STATUS_SUCCESS;
+        goto SysSpliceEnd;
+    }
+
+    Status = IoSplice(Source,
+                      Parameters->SourceOffset,
+                      Destination,
+                      Parameters->DestinationOffset,
+                      Parameters->Size,
+                      Parameters->TimeoutInMilliseconds,
+                      &BytesCompleted);
+
+    if (Status == STATUS_BROKEN_PIPE) {
+
+        ASSERT(CurrentProcess != PsGetKernelProcess());
+
+        PsSignalProcess(CurrentProcess, SIGNAL_BROKEN_PIPE, NULL);
+    }
+
+    //
+    // A handle that wasn't ready ends the splice early. Report the partial
+    // count if anything moved. Otherwise tell a non-blocking caller to try
+    // again, leaving real timeouts on blocking handles alone.
+    //
+
+    if (SPLICE_WOULD_BLOCK(Status)) {
+        if (BytesCompleted != 0) {
+            Status = STATUS_SUCCESS;
+
+        } else if ((Status != STATUS_TIMEOUT) ||
+                   ((Source->OpenFlags & OPEN_FLAG_NON_BLOCKING) != 0) ||
+                   ((Destination->OpenFlags & OPEN_FLAG_NON_BLOCKING) != 0)) {
+
+            Status = STATUS_TRY_AGAIN;
+        }
+    }
+
+SysSpliceEnd:
+    if (Source != NULL) {
+        IoIoHandleReleaseReference(Source);
+    }
+
+    if (Destination != NULL) {
+        IoIoHandleReleaseReference(Destination);
+    }
+
+    if (Status == STATUS_INTERRUPTED) {
+        if (BytesCompleted == 0) {
+            Status = STATUS_RESTART_AFTER_SIGNAL;
+
+        } else {
+            Status = STATUS_SUCCESS;
+        }
+    }
+
+    Result = Status;
+    if (KSUCCESS(Status)) {
+
+        ASSERT(BytesCompleted <= (UINTN)MAX_INTN);
+
+        Result = (INTN)BytesCompleted;
+    }
+
+    return Result;
+}
+
+//
+// --------------------------------------------------------- Internal Functions
+//
+
+KSTATUS
+IopSpliceFromPageCache (
+    PIO_HANDLE Source,
+    IO_OFFSET SourceOffset,
+    PIO_HANDLE Destination,
+    IO_OFFSET DestinationOffset,
+    UINTN SizeInBytes,
+    ULONG TimeoutInMilliseconds,
+    ULONG DestinationTimeout,
+    PUINTN BytesCompleted
+    )
+
+/*++
+
+Routine Description:
+
+    This routine moves data from a cached file to another handle. Each round
+    reads a page aligned region into an empty I/O buffer, which the cache
+    fills with references to its own page cache entries. The entries stay
+    pinned until the destination has consumed them.
+
+Arguments:
+
+    Source - Supplies the open I/O handle of the cached file to read from.
+
+    SourceOffset - Supplies the offset in the source to read from, or
+        IO_OFFSET_NONE to use the current file position.
+
+    Destination - Supplies the open I/O handle to write to.
+
+    DestinationOffset - Supplies the offset in the destination to write to, or
+        IO_OFFSET_NONE to use the current file position.
+
+    SizeInBytes - Supplies the number of bytes to move.
+
+    TimeoutInMilliseconds - Supplies the timeout for reading the source.
+
+    DestinationTimeout - Supplies the timeout for writing the destination.
+
+    BytesCompleted - Supplies a pointer where the number of bytes written to
+        the destination will be returned.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    IO_OFFSET AlignedOffset;
+    UINTN AlignedSize;
+    UINTN BytesRead;
+    UINTN BytesThisRound;
+    UINTN BytesWritten;
+    PIO_BUFFER IoBuffer;
+    IO_OFFSET Offset;
+    ULONG PageOffset;
+    ULONG PageSize;
+    KSTATUS Status;
+    UINTN TotalBytesWritten;
+
+    PageSize = MmPageSize();
+    Status = STATUS_SUCCESS;
+    TotalBytesWritten = 0;
+    Offset = SourceOffset;
+    if (Offset == IO_OFFSET_NONE) {
+        Offset = RtlAtomicOr64((PULONGLONG)&(Source->CurrentOffset), 0);
+    }
+
+    while (TotalBytesWritten < SizeInBytes) {
+        PageOffset = REMAINDER(Offset, PageSize);
+        AlignedOffset = Offset - PageOffset;
+        BytesThisRound = SizeInBytes - TotalBytesWritten;
+        if (BytesThisRound > SPLICE_MAX_ROUND_SIZE - PageOffset) {
+            BytesThisRound = SPLICE_MAX_ROUND_SIZE - PageOffset;
+        }
+
+        AlignedSize = ALIGN_RANGE_UP(PageOffset + BytesThisRound, PageSize);
+
+        //
+        // Page aligned reads into an empty buffer are satisfied by appending
+        // the page cache entries themselves rather than copying out of them.
+        //
+
+        IoBuffer = MmAllocateUninitializedIoBuffer(AlignedSize, 0);
+        if (IoBuffer == NULL) {
+            Status = STATUS_INSUFFICIENT_RESOURCES;
+            break;
+        }
+
+        Status = IoReadAtOffset(Source,
+                                IoBuffer,
+                                AlignedOffset,
+                                AlignedSize,
+                                0,
+                                TimeoutInMilliseconds,
+                                &BytesRead,
+                                NULL);
+
+        if ((!KSUCCESS(Status)) || (BytesRead <= PageOffset)) {
+            MmFreeIoBuffer(IoBuffer);
+            if (Status == STATUS_END_OF_FILE) {
+                Status = STATUS_SUCCESS;
+            }
+
+            break;
+        }
+
+        BytesRead -= PageOffset;
+        if (BytesRead > BytesThisRound) {
+            BytesRead = BytesThisRound;
+        }
+
+        MmIoBufferIncrementOffset(IoBuffer, PageOffset);
+        Status = IoWriteAtOffset(Destination,
+                                 IoBuffer,
+                                 DestinationOffset,
+                                 BytesRead,
+                                 0,
+                                 DestinationTimeout,
+                                 &BytesWritten,
+                                 NULL);
+
+        MmFreeIoBuffer(IoBuffer);
+        TotalBytesWritten += BytesWritten;
+        Offset += BytesWritten;
+        if (DestinationOffset != IO_OFFSET_NONE) {
+            DestinationOffset += BytesWritten;
+        }
+
+        //
+        // Stop on errors, on short writes, and at the end of the file.
+        //
+
+        if ((!KSUCCESS(Status)) ||
+            (BytesWritten != BytesRead) ||
+            (BytesRead != BytesThisRound)) {
+
+            break;
+        }
+    }
+
+    if ((SourceOffset == IO_OFFSET_NONE) && (TotalBytesWritten != 0)) {
+        RtlAtomicExchange64((PULONGLONG)&(Source->CurrentOffset), Offset);
+    }
+
+    *BytesCompleted = TotalBytesWritten;
+    return Status;
+}
+
+KSTATUS
+IopSpliceThroughBuffer (
+    PIO_HANDLE Source,
+    IO_OFFSET SourceOffset,
+    PIO_HANDLE Destination,
+    IO_OFFSET DestinationOffset,
+    UINTN SizeInBytes,
+    ULONG TimeoutInMilliseconds,
+    ULONG DestinationTimeout,
+    PUINTN BytesCompleted
+    )
+
+/*++
+
+Routine Description:
+
+    This routine moves data from an uncached source, such as a pipe or socket,
+    to another handle using a kernel buffer. Like a read, it only waits for
+    the first data to arrive and then moves what is available. Data taken
+    from the source cannot be put back. A blocking destination waits until it
+    has taken all of it. A non-blocking destination never waits, so it must be
+    writable before anything is read, and the read is limited to what a
+    writable destination is able to take.
+
+Arguments:
+
+    Source - Supplies the open I/O handle to read from.
+
+    SourceOffset - Supplies the offset in the source to read from, or
+        IO_OFFSET_NONE to use the current position.
+
+    Destination - Supplies the open I/O handle to write to.
+
+    DestinationOffset - Supplies the offset in the destination to write to, or
+        IO_OFFSET_NONE to use the current file position.
+
+    SizeInBytes - Supplies the number of bytes to move.
+
+    TimeoutInMilliseconds - Supplies the number of milliseconds to wait for
+        the source to produce data.
+
+    DestinationTimeout - Supplies the timeout for writing the destination.
+        Zero means the destination is non-blocking.
+
+    BytesCompleted - Supplies a pointer where the number of bytes written to
+        the destination will be returned.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    UINTN BytesRead;
+    UINTN BytesWritten;
+    PIO_BUFFER IoBuffer;
+    PIO_OBJECT_STATE IoState;
+    ULONG ReturnedEvents;
+    KSTATUS Status;
+    UINTN TotalBytesWritten;
+
+    IoBuffer = NULL;
+    IoState = NULL;
+    TotalBytesWritten = 0;
+    if (SizeInBytes > SPLICE_MAX_ROUND_SIZE) {
+        SizeInBytes = SPLICE_MAX_ROUND_SIZE;
+    }
+
+    //
+    // Don't pull data out of the source for a non-blocking destination that
+    // couldn't take any of it, or more than it can take at once.
+    //
+
+    if ((DestinationTimeout == 0) && (Destination->FileObject != NULL)) {
+        if (SizeInBytes > SPLICE_NON_BLOCKING_ROUND_SIZE) {
+            SizeInBytes = SPLICE_NON_BLOCKING_ROUND_SIZE;
+        }
+
+        IoState = Destination->FileObject->IoState;
+        Status = IoWaitForIoObjectState(IoState,
+                                        POLL_EVENT_OUT,
+                                        FALSE,
+                                        0,
+                                        &ReturnedEvents);
+
+        if ((KSUCCESS(Status)) &&
+            ((ReturnedEvents & (POLL_EVENT_OUT | POLL_ERROR_EVENTS)) == 0)) {
+
+            Status = STATUS_TRY_AGAIN;
+        }
+
+        if (!KSUCCESS(Status)) {
+            if (Status == STATUS_TIMEOUT) {
+                Status = STATUS_TRY_AGAIN;
+            }
+
+            goto SpliceThroughBufferEnd;
+        }
+    }
+
+    IoBuffer = MmAllocatePagedIoBuffer(SizeInBytes, 0);
+    if (IoBuffer == NULL) {
+        Status = STATUS_INSUFFICIENT_RESOURCES;
+        goto SpliceThroughBufferEnd;
+    }
+
+    Status = IoReadAtOffset(Source,
+                            IoBuffer,
+                            SourceOffset,
+                            SizeInBytes,
+                            0,
+                            TimeoutInMilliseconds,
+                            &BytesRead,
+                            NULL);
+
+    if (BytesRead == 0) {
+        if (Status == STATUS_END_OF_FILE) {
+            Status = STATUS_SUCCESS;
+        }
+
+        goto SpliceThroughBufferEnd;
+    }
+
+    while (TotalBytesWritten < BytesRead) {
+        Status = IoWriteAtOffset(Destination,
+                                 IoBuffer,
+                                 DestinationOffset,
+                                 BytesRead - TotalBytesWritten,
+                                 0,
+                                 DestinationTimeout,
+                                 &BytesWritten,
+                                 NULL);
+
+        TotalBytesWritten += BytesWritten;
+        MmIoBufferIncrementOffset(IoBuffer, BytesWritten);
+        if (DestinationOffset != IO_OFFSET_NONE) {
+            DestinationOffset += BytesWritten;
+        }
+
+        //
+        // A non-blocking destination that filled up anyway ends the splice
+        // with whatever was written. Never wait on it.
+        //
+
+        if ((!KSUCCESS(Status)) || (BytesWritten == 0)) {
+            break;
+        }
+    }
+
+    //
+    // The data made it across, so whatever ended the read (such as a timeout
+    // after a partial read) is not an error.
+    //
+
+    if (TotalBytesWritten == BytesRead) {
+        Status = STATUS_SUCCESS;
+    }
+
+SpliceThroughBufferEnd:
+    if (IoBuffer != NULL) {
+        MmFreeIoBuffer(IoBuffer);
+    }
+
+    *BytesCompleted = TotalBytesWritten;
+    return Status;
+}
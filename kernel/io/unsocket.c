@@ -804,6 +804,7 @@ Return Value:
 KSTATUS
 IopUnixSocketAccept (
     PSOCKET Socket,
+    BOOL NonBlocking,
     PIO_HANDLE *NewConnectionSocket,
     PNETWORK_ADDRESS RemoteAddress,
     PCSTR *RemotePath,
@@ -821,6 +822,11 @@ Routine Description:
 
     Socket - Supplies a pointer to the socket to accept a connection from.
 
+    NonBlocking - Supplies a boolean indicating whether to fail with
+        STATUS_OPERATION_WOULD_BLOCK rather than wait if no connection is
+        pending. The accept also never waits if the socket's handle was
+        opened non-blocking.
+
     NewConnectionSocket - Supplies a pointer where a new socket will be
         returned that represents the accepted connection with the remote
         host.
@@ -858,7 +864,9 @@ Return Value:
     NewSocketHandle = NULL;
     Timeout = WAIT_TIME_INDEFINITE;
     OpenFlags = IoGetIoHandleOpenFlags(Socket->IoHandle);
-    if ((OpenFlags & OPEN_FLAG_NON_BLOCKING) != 0) {
+    if ((NonBlocking != FALSE) ||
+        ((OpenFlags & OPEN_FLAG_NON_BLOCKING) != 0)) {
+
         Timeout = 0;
     }
 
@@ -2195,6 +2195,27 @@ Return Value:
 
         break;
 
+    case FileControlCommandAdvise:
+        if (FileControl->Parameters == NULL) {
+            Status = STATUS_INVALID_PARAMETER;
+            goto SysFileControlEnd;
+        }
+
+        Status = MmCopyFromUserMode(&LocalParameters,
+                                    FileControl->Parameters,
+                                    sizeof(FILE_ADVICE));
+
+        if (!KSUCCESS(Status)) {
+            goto SysFileControlEnd;
+        }
+
+        Status = IoAdvise(IoHandle,
+                          LocalParameters.Advice.Offset,
+                          LocalParameters.Advice.Size,
+                          LocalParameters.Advice.Advice);
+
+        break;
+
     default:
         Status = STATUS_INVALID_PARAMETER;
         break;
@@ -133,6 +133,7 @@ Return Value:
     return ArGetProcessorBlockRegisterForDebugger();
 }
 
+KERNEL_API
 ULONG
 KeGetCurrentProcessorNumber (
     VOID
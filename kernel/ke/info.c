@@ -107,6 +107,13 @@ KepGetKernelCommandLine (
     BOOL Set
     );
 
+KSTATUS
+KepGetSchedulerStatistics (
+    PVOID Data,
+    PUINTN DataSize,
+    BOOL Set
+    );
+
 //
 // -------------------------------------------------------------------- Globals
 //
@@ -572,6 +579,10 @@ Return Value:
         Status = KepSetBannerThread(Data, DataSize, Set);
         break;
 
+    case KeInformationSchedulerStatistics:
+        Status = KepGetSchedulerStatistics(Data, DataSize, Set);
+        break;
+
     default:
         Status = STATUS_INVALID_PARAMETER;
         *DataSize = 0;
@@ -921,6 +932,60 @@ Return Value:
     return STATUS_SUCCESS;
 }
 
+KSTATUS
+KepGetSchedulerStatistics (
+    PVOID Data,
+    PUINTN DataSize,
+    BOOL Set
+    )
+
+/*++
+
+Routine Description:
+
+    This routine gets scheduler load balancing statistics.
+
+Arguments:
+
+    Data - Supplies a pointer to the data buffer where the data is either
+        returned for a get operation or given for a set operation.
+
+    DataSize - Supplies a pointer that on input contains the size of the
+        data buffer. On output, contains the required size of the data buffer.
+
+    Set - Supplies a boolean indicating if this is a get operation (FALSE) or
+        a set operation (TRUE).
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    PSCHEDULER_STATISTICS_INFORMATION Information;
+    KSTATUS Status;
+
+    if (Set != FALSE) {
+        return STATUS_ACCESS_DENIED;
+    }
+
+    Status = PsCheckPermission(PERMISSION_RESOURCES);
+    if (!KSUCCESS(Status)) {
+        return Status;
+    }
+
+    if (*DataSize != sizeof(SCHEDULER_STATISTICS_INFORMATION)) {
+        *DataSize = sizeof(SCHEDULER_STATISTICS_INFORMATION);
+        return STATUS_DATA_LENGTH_MISMATCH;
+    }
+
+    Information = Data;
+    Status = KeGetSchedulerStatistics(Information);
+    return Status;
+}
+
 KSTATUS
 KepGetKernelCommandLine (
     PVOID Data,
@@ -524,6 +524,8 @@ Return Value:
     UserSharedData->ProcessorCounterFrequency =
                                             HlQueryProcessorCounterFrequency();
 
+    KepPublishUserTimeCounter();
+
     //
     // If no calendar services are around, set this to the boot time and go
     // from there.
@@ -358,6 +358,29 @@ Return Value:
 
 --*/
 
+VOID
+KepPublishUserTimeCounter (
+    VOID
+    );
+
+/*++
+
+Routine Description:
+
+    This routine publishes whether user mode can read the time counter
+    directly from hardware, along with the offset it needs to do so, in the
+    shared user data page.
+
+Arguments:
+
+    None.
+
+Return Value:
+
+    None.
+
+--*/
+
 VOID
 KepInitializeClock (
     PPROCESSOR_BLOCK Processor
@@ -32,6 +32,28 @@ Module Name:
 #include <minoca/kernel/kernel.h>
 #include "kep.h"
 
+//
+// --------------------------------------------------------------------- Macros
+//
+
+//
+// This macro evaluates to non-zero if the given scheduler entry belongs on the
+// real-time ready lists rather than in a fair run queue.
+//
+
+#define SCHEDULER_ENTRY_IS_REAL_TIME(_Entry)                    \
+    (((_Entry)->Parameters.Policy == SchedulerPolicyFifo) ||    \
+     ((_Entry)->Parameters.Policy == SchedulerPolicyRoundRobin))
+
+//
+// This macro evaluates to non-zero if the first virtual runtime is less than
+// the second. Virtual runtimes are compared by difference so that wrapping is
+// tolerated.
+//
+
+#define SCHEDULER_VIRTUAL_RUNTIME_BEFORE(_First, _Second) \
+    ((LONGLONG)((_First) - (_Second)) < 0)
+
 //
 // ---------------------------------------------------------------- Definitions
 //
@@ -43,6 +65,36 @@ Module Name:
 
 #define SCHEDULER_REBALANCE_MINIMUM_THREADS 2
 
+//
+// Define how many more ready threads another processor must have than this
+// one before the periodic balancer pulls a thread over. Processors in another
+// cache domain must be further out of balance, since the migrated thread will
+// start with a cold cache.
+//
+
+#define SCHEDULER_REBALANCE_IMBALANCE 2
+#define SCHEDULER_REBALANCE_REMOTE_IMBALANCE 3
+
+//
+// Define the weight of history in the scheduler load average. Each balance
+// period, the new sample accounts for 1 / SCHEDULER_LOAD_DECAY of the
+// average.
+//
+
+#define SCHEDULER_LOAD_DECAY 8
+
+//
+// Define the scheduling periods, in microseconds. These are converted into
+// processor counter ticks for each scheduler. See the SCHEDULER_DATA
+// structure for what each one means.
+//
+
+#define SCHEDULER_GRANULARITY_MICROSECONDS 1000
+#define SCHEDULER_WAKEUP_CREDIT_MICROSECONDS 3000
+#define SCHEDULER_QUANTUM_MICROSECONDS 10000
+#define SCHEDULER_BALANCE_INTERVAL_MICROSECONDS 8000
+#define SCHEDULER_MIGRATION_COST_MICROSECONDS 5000
+
 //
 // ------------------------------------------------------ Data Type Definitions
 //
@@ -61,6 +113,32 @@ KepBalanceIdleScheduler (
     VOID
     );
 
+VOID
+KepBalanceScheduler (
+    PPROCESSOR_BLOCK Processor,
+    ULONGLONG CurrentTime
+    );
+
+BOOL
+KepMigrateThread (
+    PSCHEDULER_DATA Source,
+    PPROCESSOR_BLOCK Destination,
+    ULONGLONG CurrentTime
+    );
+
+VOID
+KepEnqueueMigratedThread (
+    PKTHREAD Thread,
+    PPROCESSOR_BLOCK Destination,
+    ULONGLONG CurrentTime
+    );
+
+PPROCESSOR_BLOCK
+KepFindAllowedProcessor (
+    PSCHEDULER_ENTRY Entry,
+    PPROCESSOR_BLOCK Preferred
+    );
+
 BOOL
 KepEnqueueSchedulerEntry (
     PSCHEDULER_ENTRY Entry,
@@ -76,7 +154,58 @@ KepDequeueSchedulerEntry (
 PKTHREAD
 KepGetNextThread (
     PSCHEDULER_DATA Scheduler,
-    BOOL SkipRunning
+    PPROCESSOR_BLOCK Destination,
+    ULONGLONG MigratedBefore
+    );
+
+BOOL
+KepCanMigrateThread (
+    PKTHREAD Thread,
+    PPROCESSOR_BLOCK Destination,
+    ULONGLONG MigratedBefore
+    );
+
+VOID
+KepChargeSchedulerEntry (
+    PSCHEDULER_ENTRY Entry,
+    ULONGLONG CurrentTime
+    );
+
+VOID
+KepRequeueRunningEntry (
+    PSCHEDULER_DATA Scheduler,
+    PSCHEDULER_ENTRY Entry,
+    SCHEDULER_REASON Reason,
+    ULONGLONG CurrentTime
+    );
+
+VOID
+KepPlaceSchedulerEntry (
+    PSCHEDULER_GROUP_ENTRY GroupEntry,
+    PSCHEDULER_ENTRY Entry
+    );
+
+VOID
+KepUpdateMinimumVirtualRuntime (
+    PSCHEDULER_GROUP_ENTRY GroupEntry
+    );
+
+BOOL
+KepShouldPreempt (
+    PKTHREAD RunningThread,
+    PKTHREAD Thread
+    );
+
+VOID
+KepInitializeSchedulerPeriods (
+    PSCHEDULER_DATA Scheduler
+    );
+
+COMPARISON_RESULT
+KepCompareSchedulerEntries (
+    PRED_BLACK_TREE Tree,
+    PRED_BLACK_TREE_NODE FirstNode,
+    PRED_BLACK_TREE_NODE SecondNode
     );
 
 KSTATUS
@@ -105,11 +234,37 @@ SCHEDULER_GROUP KeRootSchedulerGroup;
 KSPIN_LOCK KeSchedulerGroupLock;
 
 //
-// Set this to TRUE to move a thread onto the current processor when unblocking
-// that thread.
+// Set this to TRUE to allow a thread to be moved onto the current processor
+// when unblocking that thread. This only happens if the current processor
+// shares a cache with the thread's previous processor and is less loaded.
 //
 
-BOOL KeSchedulerStealReadyThreads = FALSE;
+BOOL KeSchedulerStealReadyThreads = TRUE;
+
+//
+// Set this to TRUE to have busy processors periodically balance their load
+// against the other processors.
+//
+
+BOOL KeSchedulerLoadBalancing = TRUE;
+
+//
+// Store the weight of each nice value for fair scheduling, starting at
+// SCHEDULER_NICE_MIN. Each step of nice changes the share of processor time
+// by about 10 percent relative to a competing thread, which works out to a
+// factor of 1.25 between adjacent weights.
+//
+
+ULONG KeSchedulerNiceWeights[SCHEDULER_NICE_MAX - SCHEDULER_NICE_MIN + 1] = {
+    88761, 71755, 56483, 46273, 36291,
+    29154, 23254, 18705, 14949, 11916,
+    9548, 7620, 6100, 4904, 3906,
+    3121, 2501, 1991, 1586, 1277,
+    1024, 820, 655, 526, 423,
+    335, 272, 215, 172, 137,
+    110, 87, 70, 56, 45,
+    36, 29, 23, 18, 15
+};
 
 //
 // ------------------------------------------------------------------ Functions
@@ -174,14 +329,19 @@ Return Value:
 
 {
 
+    ULONGLONG BalanceTime;
+    ULONGLONG CurrentTime;
     BOOL Enabled;
     BOOL FirstTime;
+    PSCHEDULER_ENTRY NextEntry;
     PKTHREAD NextThread;
     PVOID NextThreadStack;
     THREAD_STATE NextThreadState;
+    PSCHEDULER_ENTRY OldEntry;
     PKTHREAD OldThread;
     PPROCESSOR_BLOCK Processor;
     PVOID *SaveLocation;
+    PSCHEDULER_DATA Scheduler;
 
     Enabled = FALSE;
     FirstTime = FALSE;
@@ -207,20 +367,51 @@ Return Value:
     }
 
     OldThread = Processor->RunningThread;
-    KeAcquireSpinLock(&(Processor->Scheduler.Lock));
+    OldEntry = &(OldThread->SchedulerEntry);
+    Scheduler = &(Processor->Scheduler);
+
+    //
+    // Periodically even out the load with the other processors. This is done
+    // before acquiring this scheduler's lock, as balancing acquires the locks
+    // of other schedulers.
+    //
+
+    if ((Reason == SchedulerReasonDispatchInterrupt) &&
+        (KeSchedulerLoadBalancing != FALSE) &&
+        (Scheduler->BalanceInterval != 0)) {
+
+        BalanceTime = KeGetRecentTimeCounter();
+        if (BalanceTime >= Scheduler->NextBalanceTime) {
+            KepBalanceScheduler(Processor, BalanceTime);
+        }
+    }
+
+    CurrentTime = HlQueryProcessorCounter();
+    KeAcquireSpinLock(&(Scheduler->Lock));
+    if (Scheduler->Quantum == 0) {
+        KepInitializeSchedulerPeriods(Scheduler);
+    }
 
     //
-    // Remove the old thread from the scheduler. Immediately put it back if
-    // it's not blocking.
+    // Charge the old thread for the time it ran, and then either remove it
+    // from the scheduler if it's blocking or move it to its new place in line.
+    // A thread that is no longer allowed to run on this processor is pulled
+    // out of the queue as well, and is readied on an allowed processor once
+    // it has been swapped out.
     //
 
     if (OldThread != Processor->IdleThread) {
-        KepDequeueSchedulerEntry(&(OldThread->SchedulerEntry), TRUE);
+        KepChargeSchedulerEntry(OldEntry, CurrentTime);
         if ((Reason != SchedulerReasonThreadBlocking) &&
             (Reason != SchedulerReasonThreadSuspending) &&
-            (Reason != SchedulerReasonThreadExiting)) {
+            (Reason != SchedulerReasonThreadExiting) &&
+            (PROCESSOR_AFFINITY_CHECK(&(OldEntry->Affinity),
+                                      Processor->ProcessorNumber))) {
 
-            KepEnqueueSchedulerEntry(&(OldThread->SchedulerEntry), TRUE);
+            KepRequeueRunningEntry(Scheduler, OldEntry, Reason, CurrentTime);
+
+        } else {
+            KepDequeueSchedulerEntry(OldEntry, TRUE);
         }
     }
 
@@ -229,7 +420,31 @@ Return Value:
     // to run. This might be the old thread again.
     //
 
-    NextThread = KepGetNextThread(&(Processor->Scheduler), FALSE);
+    NextThread = KepGetNextThread(Scheduler, NULL, 0);
+
+    //
+    // Avoid bouncing between fair threads on every dispatch interrupt. If the
+    // old thread is still ready and is not far enough ahead of the new one,
+    // let it keep running.
+    //
+
+    if ((Reason == SchedulerReasonDispatchInterrupt) &&
+        (NextThread != NULL) &&
+        (NextThread != OldThread) &&
+        (OldThread != Processor->IdleThread) &&
+        (OldEntry->Queued != FALSE)) {
+
+        NextEntry = &(NextThread->SchedulerEntry);
+        if ((!SCHEDULER_ENTRY_IS_REAL_TIME(NextEntry)) &&
+            (!SCHEDULER_ENTRY_IS_REAL_TIME(OldEntry)) &&
+            (OldEntry->Parent == NextEntry->Parent) &&
+            ((LONGLONG)(OldEntry->VirtualRuntime -
+                        NextEntry->VirtualRuntime) <
+             (LONGLONG)(Scheduler->Granularity))) {
+
+            NextThread = OldThread;
+        }
+    }
 
     //
     // If there are no threads to run, run the idle thread.
@@ -255,7 +470,11 @@ Return Value:
 
     NextThreadState = NextThread->State;
     NextThread->State = ThreadStateRunning;
-    KeReleaseSpinLock(&(Processor->Scheduler.Lock));
+    if (NextThread != OldThread) {
+        NextThread->SchedulerEntry.RunStart = CurrentTime;
+    }
+
+    KeReleaseSpinLock(&(Scheduler->Lock));
 
     //
     // Just return if there's no change.
@@ -449,6 +668,10 @@ Return Value:
 
 {
 
+    PSCHEDULER_ENTRY Entry;
+    PPROCESSOR_BLOCK CurrentProcessor;
+    ULONGLONG CurrentTime;
+    PPROCESSOR_BLOCK Destination;
     BOOL FirstThread;
     PSCHEDULER_GROUP Group;
     PSCHEDULER_GROUP_ENTRY GroupEntry;
@@ -460,10 +683,8 @@ Return Value:
            (Thread->State == ThreadStateFirstTime));
 
     OldRunLevel = KeRaiseRunLevel(RunLevelDispatch);
-    GroupEntry = PARENT_STRUCTURE(Thread->SchedulerEntry.Parent,
-                                  SCHEDULER_GROUP_ENTRY,
-                                  Entry);
-
+    Entry = &(Thread->SchedulerEntry);
+    GroupEntry = PARENT_STRUCTURE(Entry->Parent, SCHEDULER_GROUP_ENTRY, Entry);
     if (Thread->State == ThreadStateFirstTime) {
         RtlAtomicAdd(&(GroupEntry->Group->ThreadCount), 1);
 
@@ -472,48 +693,101 @@ Return Value:
     }
 
     //
-    // If the configuration option is set, steal the thread to run on the
-    // current processor. This is bad for cache locality, but doesn't need an
-    // IPI.
+    // If the configuration option is set, consider pulling the thread over
+    // to run on the current processor. This saves an IPI and spreads work
+    // out, but is only worth it if the thread's cache contents come along
+    // (meaning the processors share a cache), the thread's previous
+    // processor is busier, and the thread has not just been moved.
     //
 
-    if (KeSchedulerStealReadyThreads != FALSE) {
-        ProcessorBlock = KeGetCurrentProcessorBlock();
+    CurrentProcessor = KeGetCurrentProcessorBlock();
+    ProcessorBlock = PARENT_STRUCTURE(GroupEntry->Scheduler,
+                                      PROCESSOR_BLOCK,
+                                      Scheduler);
+
+    Destination = ProcessorBlock;
+    CurrentTime = 0;
+    if ((KeSchedulerStealReadyThreads != FALSE) &&
+        (ProcessorBlock != CurrentProcessor) &&
+        (ProcessorBlock->CacheDomain == CurrentProcessor->CacheDomain) &&
+        (ProcessorBlock->Scheduler.Group.ReadyThreadCount >
+         CurrentProcessor->Scheduler.Group.ReadyThreadCount) &&
+        (PROCESSOR_AFFINITY_CHECK(&(Entry->Affinity),
+                                  CurrentProcessor->ProcessorNumber))) {
+
+        CurrentTime = KeGetRecentTimeCounter();
+        if (CurrentTime - Entry->LastMigration >=
+            CurrentProcessor->Scheduler.MigrationCost) {
+
+            Destination = CurrentProcessor;
+            CurrentProcessor->Scheduler.Statistics.WakeMigrations += 1;
+        }
+    }
+
+    //
+    // The thread has to move if its affinity no longer allows the processor
+    // it last ran on.
+    //
+
+    if (!PROCESSOR_AFFINITY_CHECK(&(Entry->Affinity),
+                                  ProcessorBlock->ProcessorNumber)) {
+
+        Destination = KepFindAllowedProcessor(Entry, CurrentProcessor);
+        if (CurrentTime == 0) {
+            CurrentTime = KeGetRecentTimeCounter();
+        }
+    }
+
+    if (Destination != ProcessorBlock) {
         Group = GroupEntry->Group;
         if (Group == &KeRootSchedulerGroup) {
-            NewGroupEntry = &(ProcessorBlock->Scheduler.Group);
+            NewGroupEntry = &(Destination->Scheduler.Group);
 
         } else {
 
-            ASSERT(Group->EntryCount > ProcessorBlock->ProcessorNumber);
+            ASSERT(Group->EntryCount > Destination->ProcessorNumber);
 
-            NewGroupEntry = &(Group->Entries[ProcessorBlock->ProcessorNumber]);
+            NewGroupEntry = &(Group->Entries[Destination->ProcessorNumber]);
         }
 
-        Thread->SchedulerEntry.Parent = &(NewGroupEntry->Entry);
-        KepEnqueueSchedulerEntry(&(Thread->SchedulerEntry), FALSE);
+        //
+        // Carry the thread's virtual runtime over relative to the new group's
+        // floor. The floors are read without their locks, which is fine
+        // since this is only a placement hint.
+        //
+
+        Entry->VirtualRuntime += NewGroupEntry->MinimumVirtualRuntime -
+                                 GroupEntry->MinimumVirtualRuntime;
+
+        Entry->Parent = &(NewGroupEntry->Entry);
+        Entry->LastMigration = CurrentTime;
+        RtlAtomicAdd64(&(Destination->Scheduler.Statistics.MigrationsIn), 1);
+        RtlAtomicAdd64(&(ProcessorBlock->Scheduler.Statistics.MigrationsOut),
+                       1);
+
+        ProcessorBlock = Destination;
+    }
 
     //
-    // Enqueue the thread on the processor it was previously on. This may
-    // require waking that processor up.
+    // Enqueue the thread. If this is the first thread being scheduled on the
+    // processor, then make sure the clock is running (or wake it up).
     //
 
-    } else {
-        FirstThread = KepEnqueueSchedulerEntry(&(Thread->SchedulerEntry),
-                                               FALSE);
+    FirstThread = KepEnqueueSchedulerEntry(Entry, FALSE);
+    if (FirstThread != FALSE) {
+        KepSetClockToPeriodic(ProcessorBlock);
+    }
 
-        //
-        // If this is the first thread being scheduled on the processor, then
-        // make sure the clock is running (or wake it up).
-        //
+    //
+    // If the thread landed on this processor and deserves to run ahead of the
+    // current thread, request a dispatch interrupt so that the scheduler runs
+    // as soon as the run level drops rather than at the next clock tick.
+    //
 
-        if (FirstThread != FALSE) {
-            ProcessorBlock = PARENT_STRUCTURE(GroupEntry->Scheduler,
-                                              PROCESSOR_BLOCK,
-                                              Scheduler);
+    if ((ProcessorBlock == CurrentProcessor) &&
+        (KepShouldPreempt(CurrentProcessor->RunningThread, Thread) != FALSE)) {
 
-            KepSetClockToPeriodic(ProcessorBlock);
-        }
+        CurrentProcessor->PendingDispatchInterrupt = TRUE;
     }
 
     KeLowerRunLevel(OldRunLevel);
@@ -588,7 +862,7 @@ Return Value:
 
         if (Entry->Type == SchedulerEntryThread) {
 
-            ASSERT(Entry->ListEntry.Next == NULL);
+            ASSERT(Entry->Queued == FALSE);
 
             OldCount = RtlAtomicAdd(&(ParentGroupEntry->Group->ThreadCount),
                                     -1);
@@ -606,12 +880,14 @@ Return Value:
             //
 
             if ((GroupEntry->Group->ThreadCount == 0) &&
-                (LIST_EMPTY(&(GroupEntry->Children)) != FALSE)) {
+                (RED_BLACK_TREE_EMPTY(&(GroupEntry->Children)) != FALSE)) {
 
                 Group = GroupEntry->Group;
-                for (Index = 0; Index < Group->EntryCount; Group += 1) {
+                for (Index = 0; Index < Group->EntryCount; Index += 1) {
                     GroupEntry = &(Group->Entries[Index]);
-                    if (LIST_EMPTY(&(GroupEntry->Children)) == FALSE) {
+                    if (RED_BLACK_TREE_EMPTY(&(GroupEntry->Children)) ==
+                        FALSE) {
+
                         break;
                     }
                 }
@@ -633,145 +909,502 @@ Return Value:
     return;
 }
 
-VOID
-KeIdleLoop (
-    VOID
+KSTATUS
+KeSetThreadSchedulingParameters (
+    PKTHREAD Thread,
+    PSCHEDULER_PARAMETERS Parameters
     )
 
 /*++
 
 Routine Description:
 
-    This routine executes the idle loop. It does not return. It can be
-    executed only from the idle thread.
+    This routine changes the scheduling policy and priorities of a thread. If
+    the thread is ready, it is requeued according to its new parameters. The
+    caller is responsible for any permission checks.
 
 Arguments:
 
-    None.
+    Thread - Supplies a pointer to the thread to change.
+
+    Parameters - Supplies a pointer to the new scheduling parameters.
 
 Return Value:
 
-    None.
+    STATUS_SUCCESS on success.
+
+    STATUS_INVALID_PARAMETER if the policy or one of the priorities is out of
+    range.
 
 --*/
 
 {
 
-    BOOL Enabled;
+    PSCHEDULER_ENTRY Entry;
+    PSCHEDULER_GROUP_ENTRY GroupEntry;
+    RUNLEVEL OldRunLevel;
     PPROCESSOR_BLOCK ProcessorBlock;
+    BOOL Queued;
+    PSCHEDULER_DATA Scheduler;
+    BOOL WasRealTime;
 
-    ProcessorBlock = KeGetCurrentProcessorBlock();
-    while (TRUE) {
-        KeYield();
-        if (ProcessorBlock->Scheduler.Group.ReadyThreadCount != 0) {
-            continue;
-        }
-
-        KepBalanceIdleScheduler();
+    if ((Parameters->NiceValue < SCHEDULER_NICE_MIN) ||
+        (Parameters->NiceValue > SCHEDULER_NICE_MAX)) {
 
-        //
-        // Disable interrupts to commit to going down for idle. Without this
-        // IPIs could come in and schedule new work after the ready thread
-        // check but before halting.
-        //
+        return STATUS_INVALID_PARAMETER;
+    }
 
-        Enabled = ArDisableInterrupts();
+    switch (Parameters->Policy) {
+    case SchedulerPolicyFair:
+        if (Parameters->RealTimePriority != 0) {
+            return STATUS_INVALID_PARAMETER;
+        }
 
-        ASSERT(Enabled != FALSE);
+        break;
 
-        //
-        // After disabling interrupts, check to see if any threads snuck on
-        // in the meantime, and abort the idle if so.
-        //
+    case SchedulerPolicyFifo:
+    case SchedulerPolicyRoundRobin:
+        if ((Parameters->RealTimePriority <
+             SCHEDULER_REAL_TIME_PRIORITY_MIN) ||
+            (Parameters->RealTimePriority >
+             SCHEDULER_REAL_TIME_PRIORITY_MAX)) {
 
-        if (ProcessorBlock->Scheduler.Group.ReadyThreadCount != 0) {
-            ArEnableInterrupts();
-            continue;
+            return STATUS_INVALID_PARAMETER;
         }
 
-        KepIdle(ProcessorBlock);
+        break;
+
+    default:
+        return STATUS_INVALID_PARAMETER;
     }
 
-    return;
-}
+    Entry = &(Thread->SchedulerEntry);
+    OldRunLevel = KeRaiseRunLevel(RunLevelDispatch);
 
-VOID
-KepInitializeScheduler (
-    PPROCESSOR_BLOCK ProcessorBlock
-    )
+    //
+    // Chase the entity around as it bounces from group entry to group entry.
+    //
 
-/*++
+    while (TRUE) {
+        GroupEntry = PARENT_STRUCTURE(Entry->Parent,
+                                      SCHEDULER_GROUP_ENTRY,
+                                      Entry);
 
-Routine Description:
+        Scheduler = GroupEntry->Scheduler;
+        KeAcquireSpinLock(&(Scheduler->Lock));
+        if (Entry->Parent == &(GroupEntry->Entry)) {
+            break;
+        }
 
-    This routine initializes the scheduler for a processor.
+        KeReleaseSpinLock(&(Scheduler->Lock));
+    }
 
-Arguments:
+    //
+    // Pull the thread out of the ready queue while its parameters change,
+    // since they determine where it's queued.
+    //
 
-    ProcessorBlock - Supplies a pointer to the processor block.
+    Queued = Entry->Queued;
+    if (Queued != FALSE) {
+        KepDequeueSchedulerEntry(Entry, TRUE);
+    }
 
-Return Value:
+    WasRealTime = SCHEDULER_ENTRY_IS_REAL_TIME(Entry);
+    RtlCopyMemory(&(Entry->Parameters),
+                  Parameters,
+                  sizeof(SCHEDULER_PARAMETERS));
 
-    None.
+    Entry->Weight =
+            KeSchedulerNiceWeights[Parameters->NiceValue - SCHEDULER_NICE_MIN];
 
---*/
+    //
+    // A thread coming back from a real-time policy starts over at the group's
+    // floor, as its virtual runtime has not been kept up.
+    //
 
-{
+    if ((WasRealTime != FALSE) && (!SCHEDULER_ENTRY_IS_REAL_TIME(Entry))) {
+        Entry->VirtualRuntime = GroupEntry->MinimumVirtualRuntime;
+    }
 
-    KeInitializeSpinLock(&KeSchedulerGroupLock);
-    INITIALIZE_LIST_HEAD(&(KeRootSchedulerGroup.Children));
-    KeInitializeSpinLock(&(ProcessorBlock->Scheduler.Lock));
-    KepInitializeSchedulerGroupEntry(&(ProcessorBlock->Scheduler.Group),
-                                     &(ProcessorBlock->Scheduler),
-                                     &KeRootSchedulerGroup,
-                                     NULL);
+    if (Queued != FALSE) {
+        KepEnqueueSchedulerEntry(Entry, TRUE);
 
-    return;
-}
+        //
+        // If the thread is ready on this processor, have the scheduler take
+        // another look once the run level drops.
+        //
 
-//
-// --------------------------------------------------------- Internal Functions
-//
+        ProcessorBlock = PARENT_STRUCTURE(Scheduler,
+                                          PROCESSOR_BLOCK,
+                                          Scheduler);
 
-VOID
-KepIdle (
-    PPROCESSOR_BLOCK Processor
+        if (ProcessorBlock == KeGetCurrentProcessorBlock()) {
+            ProcessorBlock->PendingDispatchInterrupt = TRUE;
+        }
+    }
+
+    KeReleaseSpinLock(&(Scheduler->Lock));
+    KeLowerRunLevel(OldRunLevel);
+    return STATUS_SUCCESS;
+}
+
+KERNEL_API
+KSTATUS
+KeSetThreadAffinity (
+    PKTHREAD Thread,
+    PPROCESSOR_AFFINITY Affinity
     )
 
 /*++
 
 Routine Description:
 
-    This routine is called when a processor has nothing to run. This routine is
-    called with interrupts disabled, and returns with interrupts enabled.
+    This routine changes the set of processors a thread is allowed to run on.
+    A ready thread queued on a processor that is no longer allowed is moved
+    immediately. A running thread moves the next time it is scheduled out.
+    The caller is responsible for any permission checks.
 
 Arguments:
 
-    Processor - Supplies a pointer to the processor block of the current
-        processor.
+    Thread - Supplies a pointer to the thread to change.
+
+    Affinity - Supplies a pointer to the new processor affinity.
 
 Return Value:
 
-    None.
+    STATUS_SUCCESS on success.
+
+    STATUS_INVALID_PARAMETER if the affinity does not include any active
+    processors.
 
 --*/
 
 {
 
-    KepClockIdle(Processor);
+    ULONG ActiveCount;
+    ULONGLONG CurrentTime;
+    PPROCESSOR_BLOCK Destination;
+    PSCHEDULER_ENTRY Entry;
+    PSCHEDULER_GROUP_ENTRY GroupEntry;
+    BOOL Move;
+    ULONG Number;
+    RUNLEVEL OldRunLevel;
+    PPROCESSOR_BLOCK ProcessorBlock;
+    PSCHEDULER_DATA Scheduler;
+
+    ActiveCount = KeGetActiveProcessorCount();
+    for (Number = 0; Number < ActiveCount; Number += 1) {
+        if (PROCESSOR_AFFINITY_CHECK(Affinity, Number)) {
+            break;
+        }
+    }
+
+    if (Number == ActiveCount) {
+        return STATUS_INVALID_PARAMETER;
+    }
+
+    Entry = &(Thread->SchedulerEntry);
+    Move = FALSE;
+    OldRunLevel = KeRaiseRunLevel(RunLevelDispatch);
 
     //
-    // Begin counting this time as idle time. There's no need to put it back
-    // to its previous setting at the end because the next thing this thread
-    // will do is yield, and the scheduler will set the new period.
+    // Chase the entity around as it bounces from group entry to group entry.
     //
 
-    KeBeginCycleAccounting(CycleAccountIdle);
-    PmIdle(Processor);
-    return;
-}
-
-VOID
+    while (TRUE) {
+        GroupEntry = PARENT_STRUCTURE(Entry->Parent,
+                                      SCHEDULER_GROUP_ENTRY,
+                                      Entry);
+
+        Scheduler = GroupEntry->Scheduler;
+        KeAcquireSpinLock(&(Scheduler->Lock));
+        if (Entry->Parent == &(GroupEntry->Entry)) {
+            break;
+        }
+
+        KeReleaseSpinLock(&(Scheduler->Lock));
+    }
+
+    RtlCopyMemory(&(Entry->Affinity), Affinity, sizeof(PROCESSOR_AFFINITY));
+    ProcessorBlock = PARENT_STRUCTURE(Scheduler, PROCESSOR_BLOCK, Scheduler);
+    Number = ProcessorBlock->ProcessorNumber;
+    if ((Entry->Queued != FALSE) &&
+        (!PROCESSOR_AFFINITY_CHECK(Affinity, Number))) {
+
+        //
+        // A running thread cannot be queued elsewhere until it has been
+        // swapped out. The scheduler takes it out of this queue the next time
+        // it runs on its processor, so nudge that along if it's this one.
+        //
+
+        if (Thread->State == ThreadStateRunning) {
+            if (ProcessorBlock == KeGetCurrentProcessorBlock()) {
+                ProcessorBlock->PendingDispatchInterrupt = TRUE;
+            }
+
+        //
+        // A waiting thread is pulled out of the ready queue, and its virtual
+        // runtime made relative to the floor of the group it's leaving.
+        //
+
+        } else {
+            KepDequeueSchedulerEntry(Entry, TRUE);
+            Entry->VirtualRuntime -= GroupEntry->MinimumVirtualRuntime;
+            Move = TRUE;
+        }
+    }
+
+    KeReleaseSpinLock(&(Scheduler->Lock));
+    if (Move != FALSE) {
+        CurrentTime = KeGetRecentTimeCounter();
+        Destination = KepFindAllowedProcessor(Entry,
+                                              KeGetCurrentProcessorBlock());
+
+        KepEnqueueMigratedThread(Thread, Destination, CurrentTime);
+        RtlAtomicAdd64(&(Scheduler->Statistics.MigrationsOut), 1);
+    }
+
+    KeLowerRunLevel(OldRunLevel);
+    return STATUS_SUCCESS;
+}
+
+KERNEL_API
+KSTATUS
+KeGetSchedulerStatistics (
+    PSCHEDULER_STATISTICS_INFORMATION Information
+    )
+
+/*++
+
+Routine Description:
+
+    This routine returns a snapshot of the scheduler load balancing
+    information for one or all processors.
+
+Arguments:
+
+    Information - Supplies a pointer to the information structure. On input,
+        the processor number field contains the processor to query, or -1 to
+        sum the information for all processors. On output, the remaining
+        fields are filled in.
+
+Return Value:
+
+    STATUS_SUCCESS on success.
+
+    STATUS_INVALID_PARAMETER if an invalid processor number was supplied.
+
+--*/
+
+{
+
+    ULONG ActiveCount;
+    ULONG End;
+    ULONG Number;
+    PSCHEDULER_DATA Scheduler;
+    PSCHEDULER_STATISTICS Statistics;
+
+    ActiveCount = KeGetActiveProcessorCount();
+    if (Information->ProcessorNumber == (UINTN)-1) {
+        Number = 0;
+        End = ActiveCount;
+
+    } else if (Information->ProcessorNumber < ActiveCount) {
+        Number = Information->ProcessorNumber;
+        End = Number + 1;
+
+    } else {
+        return STATUS_INVALID_PARAMETER;
+    }
+
+    Information->ReadyThreadCount = 0;
+    Information->LoadAverage = 0;
+    Statistics = &(Information->Statistics);
+    RtlZeroMemory(Statistics, sizeof(SCHEDULER_STATISTICS));
+
+    //
+    // The counters are read without the scheduler locks, so the snapshot may
+    // be slightly inconsistent.
+    //
+
+    while (Number < End) {
+        Scheduler = &(KeProcessorBlocks[Number]->Scheduler);
+        Information->ReadyThreadCount += Scheduler->Group.ReadyThreadCount;
+        Information->LoadAverage += Scheduler->LoadAverage;
+        Statistics->BalanceCount += Scheduler->Statistics.BalanceCount;
+        Statistics->MigrationsIn += Scheduler->Statistics.MigrationsIn;
+        Statistics->MigrationsOut += Scheduler->Statistics.MigrationsOut;
+        Statistics->IdleSteals += Scheduler->Statistics.IdleSteals;
+        Statistics->BalancePulls += Scheduler->Statistics.BalancePulls;
+        Statistics->BalancePushes += Scheduler->Statistics.BalancePushes;
+        Statistics->WakeMigrations += Scheduler->Statistics.WakeMigrations;
+        Number += 1;
+    }
+
+    return STATUS_SUCCESS;
+}
+
+VOID
+KeIdleLoop (
+    VOID
+    )
+
+/*++
+
+Routine Description:
+
+    This routine executes the idle loop. It does not return. It can be
+    executed only from the idle thread.
+
+Arguments:
+
+    None.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    BOOL Enabled;
+    PPROCESSOR_BLOCK ProcessorBlock;
+
+    ProcessorBlock = KeGetCurrentProcessorBlock();
+    while (TRUE) {
+        KeYield();
+        if (ProcessorBlock->Scheduler.Group.ReadyThreadCount != 0) {
+            continue;
+        }
+
+        KepBalanceIdleScheduler();
+
+        //
+        // Disable interrupts to commit to going down for idle. Without this
+        // IPIs could come in and schedule new work after the ready thread
+        // check but before halting.
+        //
+
+        Enabled = ArDisableInterrupts();
+
+        ASSERT(Enabled != FALSE);
+
+        //
+        // After disabling interrupts, check to see if any threads snuck on
+        // in the meantime, and abort the idle if so.
+        //
+
+        if (ProcessorBlock->Scheduler.Group.ReadyThreadCount != 0) {
+            ArEnableInterrupts();
+            continue;
+        }
+
+        KepIdle(ProcessorBlock);
+    }
+
+    return;
+}
+
+VOID
+KepInitializeScheduler (
+    PPROCESSOR_BLOCK ProcessorBlock
+    )
+
+/*++
+
+Routine Description:
+
+    This routine initializes the scheduler for a processor.
+
+Arguments:
+
+    ProcessorBlock - Supplies a pointer to the processor block.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    ULONG Index;
+    PSCHEDULER_DATA Scheduler;
+
+    Scheduler = &(ProcessorBlock->Scheduler);
+    KeInitializeSpinLock(&KeSchedulerGroupLock);
+    INITIALIZE_LIST_HEAD(&(KeRootSchedulerGroup.Children));
+    KeInitializeSpinLock(&(Scheduler->Lock));
+    KepInitializeSchedulerGroupEntry(&(Scheduler->Group),
+                                     Scheduler,
+                                     &KeRootSchedulerGroup,
+                                     NULL);
+
+    Scheduler->RealTimeMask = 0;
+    for (Index = 0; Index < SCHEDULER_REAL_TIME_PRIORITY_COUNT; Index += 1) {
+        INITIALIZE_LIST_HEAD(&(Scheduler->RealTime[Index]));
+    }
+
+    //
+    // The scheduling periods are filled in the first time the scheduler runs,
+    // as the processor counter may not be running yet.
+    //
+
+    Scheduler->Granularity = 0;
+    Scheduler->WakeupCredit = 0;
+    Scheduler->Quantum = 0;
+    Scheduler->BalanceInterval = 0;
+    Scheduler->MigrationCost = 0;
+    Scheduler->NextBalanceTime = 0;
+    Scheduler->LoadAverage = 0;
+    RtlZeroMemory(&(Scheduler->Statistics), sizeof(SCHEDULER_STATISTICS));
+    return;
+}
+
+//
+// --------------------------------------------------------- Internal Functions
+//
+
+VOID
+KepIdle (
+    PPROCESSOR_BLOCK Processor
+    )
+
+/*++
+
+Routine Description:
+
+    This routine is called when a processor has nothing to run. This routine is
+    called with interrupts disabled, and returns with interrupts enabled.
+
+Arguments:
+
+    Processor - Supplies a pointer to the processor block of the current
+        processor.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    KepClockIdle(Processor);
+
+    //
+    // Begin counting this time as idle time. There's no need to put it back
+    // to its previous setting at the end because the next thing this thread
+    // will do is yield, and the scheduler will set the new period.
+    //
+
+    KeBeginCycleAccounting(CycleAccountIdle);
+    PmIdle(Processor);
+    return;
+}
+
+VOID
 KepBalanceIdleScheduler (
     VOID
     )
@@ -781,7 +1414,8 @@ KepBalanceIdleScheduler (
 Routine Description:
 
     This routine is called when the processor is idle. It tries to steal
-    threads from a busier processor.
+    threads from a busier processor, preferring processors that share a cache
+    with this one.
 
 Arguments:
 
@@ -797,15 +1431,14 @@ Return Value:
 
     ULONG ActiveCount;
     ULONG CurrentNumber;
-    PSCHEDULER_GROUP_ENTRY DestinationGroupEntry;
-    BOOL FirstThread;
-    PSCHEDULER_GROUP Group;
+    ULONGLONG CurrentTime;
+    BOOL Near;
     ULONG Number;
     RUNLEVEL OldRunLevel;
+    ULONG Pass;
+    PPROCESSOR_BLOCK Processor;
     PPROCESSOR_BLOCK ProcessorBlock;
-    PSCHEDULER_GROUP_ENTRY SourceGroupEntry;
     PSCHEDULER_DATA VictimScheduler;
-    PKTHREAD VictimThread;
 
     ActiveCount = KeGetActiveProcessorCount();
     if (ActiveCount == 1) {
@@ -816,222 +1449,1109 @@ Return Value:
 
     ASSERT(OldRunLevel == RunLevelLow);
 
-    CurrentNumber = KeGetCurrentProcessorNumber();
-    VictimThread = NULL;
+    Processor = KeGetCurrentProcessorBlock();
+    CurrentNumber = Processor->ProcessorNumber;
+    CurrentTime = KeGetRecentTimeCounter();
 
     //
     // Try to steal from another processor, starting with the next neighbor.
+    // The first pass only looks at processors in the same cache domain, and
+    // the second pass looks at everything else.
     //
 
-    Number = CurrentNumber + 1;
-    while (TRUE) {
-        if (Number == ActiveCount) {
-            Number = 0;
-        }
+    for (Pass = 0; Pass < 2; Pass += 1) {
+        Number = CurrentNumber + 1;
+        while (TRUE) {
+            if (Number == ActiveCount) {
+                Number = 0;
+            }
 
-        if (Number == CurrentNumber) {
-            break;
-        }
+            if (Number == CurrentNumber) {
+                break;
+            }
 
-        ProcessorBlock = KeProcessorBlocks[Number];
-        VictimScheduler = &(ProcessorBlock->Scheduler);
-        if (VictimScheduler->Group.ReadyThreadCount >=
-            SCHEDULER_REBALANCE_MINIMUM_THREADS) {
+            ProcessorBlock = KeProcessorBlocks[Number];
+            Number += 1;
+            Near = FALSE;
+            if (ProcessorBlock->CacheDomain == Processor->CacheDomain) {
+                Near = TRUE;
+            }
 
-            KeAcquireSpinLock(&(VictimScheduler->Lock));
-            VictimThread = KepGetNextThread(VictimScheduler, TRUE);
-            if (VictimThread != NULL) {
+            if ((Near == FALSE) && (Pass == 0)) {
+                continue;
+            }
 
-                ASSERT((VictimThread->State == ThreadStateReady) ||
-                       (VictimThread->State == ThreadStateFirstTime));
+            if ((Near != FALSE) && (Pass != 0)) {
+                continue;
+            }
 
-                //
-                // Pull the thread out of the ready queue.
-                //
+            VictimScheduler = &(ProcessorBlock->Scheduler);
+            if (VictimScheduler->Group.ReadyThreadCount <
+                SCHEDULER_REBALANCE_MINIMUM_THREADS) {
 
-                KepDequeueSchedulerEntry(&(VictimThread->SchedulerEntry), TRUE);
+                continue;
             }
 
-            KeReleaseSpinLock(&(VictimScheduler->Lock));
-            if (VictimThread != NULL) {
+            if (KepMigrateThread(VictimScheduler, Processor, CurrentTime) !=
+                FALSE) {
 
-                //
-                // Move the entry to this processor's queue.
-                //
+                Processor->Scheduler.Statistics.IdleSteals += 1;
+                goto BalanceIdleSchedulerEnd;
+            }
+        }
+    }
 
-                SourceGroupEntry = PARENT_STRUCTURE(
-                                           VictimThread->SchedulerEntry.Parent,
-                                           SCHEDULER_GROUP_ENTRY,
-                                           Entry);
+BalanceIdleSchedulerEnd:
+    KeLowerRunLevel(OldRunLevel);
+    return;
+}
 
-                Group = SourceGroupEntry->Group;
-                if (Group == &KeRootSchedulerGroup) {
-                    DestinationGroupEntry =
-                          &(KeProcessorBlocks[CurrentNumber]->Scheduler.Group);
+VOID
+KepBalanceScheduler (
+    PPROCESSOR_BLOCK Processor,
+    ULONGLONG CurrentTime
+    )
 
-                } else {
+/*++
 
-                    ASSERT(Group->EntryCount > CurrentNumber);
+Routine Description:
 
-                    DestinationGroupEntry = &(Group->Entries[CurrentNumber]);
-                }
+    This routine periodically balances the load of a busy processor against
+    the other processors. If another processor is idle, a waiting thread is
+    pushed to it. Otherwise, if another processor has a deeper run queue that
+    has persisted for a while, a thread is pulled from it. This routine must
+    be called at dispatch level without any scheduler locks held.
 
-                VictimThread->SchedulerEntry.Parent =
-                                               &(DestinationGroupEntry->Entry);
+Arguments:
 
-                //
-                // Enqueue the thread on this processor.
-                //
+    Processor - Supplies a pointer to the current processor block.
 
-                FirstThread =
-                      KepEnqueueSchedulerEntry(&(VictimThread->SchedulerEntry),
-                                               FALSE);
+    CurrentTime - Supplies the current time counter value.
 
-                if (FirstThread != FALSE) {
-                    KepSetClockToPeriodic(KeProcessorBlocks[CurrentNumber]);
-                }
+Return Value:
 
-                break;
-            }
+    None.
+
+--*/
+
+{
+
+    ULONG ActiveCount;
+    PPROCESSOR_BLOCK Busiest;
+    UINTN BusiestCount;
+    BOOL BusiestNear;
+    UINTN Count;
+    PPROCESSOR_BLOCK Idlest;
+    BOOL IdlestNear;
+    BOOL Near;
+    ULONG Number;
+    PPROCESSOR_BLOCK Other;
+    UINTN ReadyCount;
+    UINTN Required;
+    PSCHEDULER_DATA Scheduler;
+
+    ASSERT(KeGetRunLevel() == RunLevelDispatch);
+
+    Scheduler = &(Processor->Scheduler);
+    Scheduler->NextBalanceTime = CurrentTime + Scheduler->BalanceInterval;
+    ReadyCount = Scheduler->Group.ReadyThreadCount;
+    Scheduler->LoadAverage =
+               ((Scheduler->LoadAverage * (SCHEDULER_LOAD_DECAY - 1)) +
+                (ReadyCount * SCHEDULER_LOAD_SCALE)) / SCHEDULER_LOAD_DECAY;
+
+    Scheduler->Statistics.BalanceCount += 1;
+    ActiveCount = KeGetActiveProcessorCount();
+    if (ActiveCount == 1) {
+        return;
+    }
+
+    //
+    // Survey the other processors without their locks. The counts may be
+    // stale by the time a migration happens, which is fine since balancing
+    // is only a heuristic.
+    //
+
+    Busiest = NULL;
+    BusiestCount = 0;
+    BusiestNear = FALSE;
+    Idlest = NULL;
+    IdlestNear = FALSE;
+    for (Number = 0; Number < ActiveCount; Number += 1) {
+        Other = KeProcessorBlocks[Number];
+        if (Other == Processor) {
+            continue;
+        }
+
+        Near = FALSE;
+        if (Other->CacheDomain == Processor->CacheDomain) {
+            Near = TRUE;
+        }
+
+        Count = Other->Scheduler.Group.ReadyThreadCount;
+        if (Count == 0) {
+            if ((Idlest == NULL) ||
+                ((Near != FALSE) && (IdlestNear == FALSE))) {
+
+                Idlest = Other;
+                IdlestNear = Near;
+            }
+
+            continue;
+        }
+
+        //
+        // Only consider pulling from processors that are out of balance now
+        // and have been busier than this one on average, so that brief
+        // spikes do not cause threads to bounce around.
+        //
+
+        Required = ReadyCount + SCHEDULER_REBALANCE_IMBALANCE;
+        if (Near == FALSE) {
+            Required = ReadyCount + SCHEDULER_REBALANCE_REMOTE_IMBALANCE;
+        }
+
+        if ((Count < Required) ||
+            (Other->Scheduler.LoadAverage <= Scheduler->LoadAverage)) {
+
+            continue;
+        }
+
+        if ((Busiest == NULL) ||
+            (Count > BusiestCount) ||
+            ((Count == BusiestCount) &&
+             (Near != FALSE) &&
+             (BusiestNear == FALSE))) {
+
+            Busiest = Other;
+            BusiestCount = Count;
+            BusiestNear = Near;
+        }
+    }
+
+    //
+    // Idle processors turn their clocks off, so they will not come looking
+    // for work on their own. Push a waiting thread over to one.
+    //
+
+    if ((Idlest != NULL) &&
+        (ReadyCount >= SCHEDULER_REBALANCE_MINIMUM_THREADS)) {
+
+        if (KepMigrateThread(Scheduler, Idlest, CurrentTime) != FALSE) {
+            Scheduler->Statistics.BalancePushes += 1;
+            return;
+        }
+    }
+
+    if (Busiest != NULL) {
+        if (KepMigrateThread(&(Busiest->Scheduler), Processor, CurrentTime) !=
+            FALSE) {
+
+            Scheduler->Statistics.BalancePulls += 1;
+        }
+    }
+
+    return;
+}
+
+BOOL
+KepMigrateThread (
+    PSCHEDULER_DATA Source,
+    PPROCESSOR_BLOCK Destination,
+    ULONGLONG CurrentTime
+    )
+
+/*++
+
+Routine Description:
+
+    This routine moves a ready thread from the given scheduler onto the given
+    processor. Running threads, threads that were migrated too recently, and
+    threads whose affinity excludes the destination are not moved. This
+    routine must be called at dispatch level without any scheduler locks held.
+
+Arguments:
+
+    Source - Supplies a pointer to the scheduler to take a thread from.
+
+    Destination - Supplies a pointer to the processor to move the thread to.
+
+    CurrentTime - Supplies the current time counter value.
+
+Return Value:
+
+    TRUE if a thread was moved.
+
+    FALSE if no thread could be moved.
+
+--*/
+
+{
+
+    ULONGLONG MigratedBefore;
+    ULONGLONG MigrationCost;
+    PSCHEDULER_GROUP_ENTRY SourceGroupEntry;
+    PKTHREAD Thread;
+
+    ASSERT(Source != &(Destination->Scheduler));
+
+    MigrationCost = KeGetCurrentProcessorBlock()->Scheduler.MigrationCost;
+    MigratedBefore = 0;
+    if (CurrentTime > MigrationCost) {
+        MigratedBefore = CurrentTime - MigrationCost;
+    }
+
+    KeAcquireSpinLock(&(Source->Lock));
+    Thread = KepGetNextThread(Source, Destination, MigratedBefore);
+    if (Thread != NULL) {
+
+        ASSERT((Thread->State == ThreadStateReady) ||
+               (Thread->State == ThreadStateFirstTime));
+
+        //
+        // Pull the thread out of the ready queue, and make its virtual
+        // runtime relative to the floor of the group it's leaving.
+        //
+
+        KepDequeueSchedulerEntry(&(Thread->SchedulerEntry), TRUE);
+        SourceGroupEntry = PARENT_STRUCTURE(Thread->SchedulerEntry.Parent,
+                                            SCHEDULER_GROUP_ENTRY,
+                                            Entry);
+
+        Thread->SchedulerEntry.VirtualRuntime -=
+                                       SourceGroupEntry->MinimumVirtualRuntime;
+    }
+
+    KeReleaseSpinLock(&(Source->Lock));
+    if (Thread == NULL) {
+        return FALSE;
+    }
+
+    KepEnqueueMigratedThread(Thread, Destination, CurrentTime);
+    RtlAtomicAdd64(&(Source->Statistics.MigrationsOut), 1);
+    return TRUE;
+}
+
+VOID
+KepEnqueueMigratedThread (
+    PKTHREAD Thread,
+    PPROCESSOR_BLOCK Destination,
+    ULONGLONG CurrentTime
+    )
+
+/*++
+
+Routine Description:
+
+    This routine queues a thread that was pulled out of another processor's
+    ready queue onto the given processor. This routine must be called at
+    dispatch level without any scheduler locks held.
+
+Arguments:
+
+    Thread - Supplies a pointer to the thread to move. It must not be queued,
+        and its virtual runtime must be relative to the floor of the group
+        entry it was removed from.
+
+    Destination - Supplies a pointer to the processor to move the thread to.
+
+    CurrentTime - Supplies the current time counter value.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PSCHEDULER_GROUP_ENTRY DestinationGroupEntry;
+    BOOL FirstThread;
+    PSCHEDULER_GROUP Group;
+    PSCHEDULER_GROUP_ENTRY SourceGroupEntry;
+
+    ASSERT(Thread->SchedulerEntry.Queued == FALSE);
+
+    SourceGroupEntry = PARENT_STRUCTURE(Thread->SchedulerEntry.Parent,
+                                        SCHEDULER_GROUP_ENTRY,
+                                        Entry);
+
+    Group = SourceGroupEntry->Group;
+    if (Group == &KeRootSchedulerGroup) {
+        DestinationGroupEntry = &(Destination->Scheduler.Group);
+
+    } else {
+
+        ASSERT(Group->EntryCount > Destination->ProcessorNumber);
+
+        DestinationGroupEntry = &(Group->Entries[Destination->ProcessorNumber]);
+    }
+
+    Thread->SchedulerEntry.Parent = &(DestinationGroupEntry->Entry);
+    Thread->SchedulerEntry.VirtualRuntime +=
+                                  DestinationGroupEntry->MinimumVirtualRuntime;
+
+    Thread->SchedulerEntry.LastMigration = CurrentTime;
+    FirstThread = KepEnqueueSchedulerEntry(&(Thread->SchedulerEntry), FALSE);
+    if (FirstThread != FALSE) {
+        KepSetClockToPeriodic(Destination);
+    }
+
+    RtlAtomicAdd64(&(Destination->Scheduler.Statistics.MigrationsIn), 1);
+    return;
+}
+
+PPROCESSOR_BLOCK
+KepFindAllowedProcessor (
+    PSCHEDULER_ENTRY Entry,
+    PPROCESSOR_BLOCK Preferred
+    )
+
+/*++
+
+Routine Description:
+
+    This routine picks a processor for a thread that is allowed by the
+    thread's affinity. The preferred processor is used if allowed, otherwise
+    the least loaded allowed processor is chosen, favoring processors that
+    share a cache with the preferred one.
+
+Arguments:
+
+    Entry - Supplies a pointer to the thread's scheduler entry.
+
+    Preferred - Supplies a pointer to the processor to use if possible.
+
+Return Value:
+
+    Returns a pointer to the processor block to run the thread on.
+
+--*/
+
+{
+
+    ULONG ActiveCount;
+    PPROCESSOR_BLOCK Best;
+    UINTN BestCount;
+    BOOL BestNear;
+    UINTN Count;
+    BOOL Near;
+    ULONG Number;
+    PPROCESSOR_BLOCK ProcessorBlock;
+
+    if (PROCESSOR_AFFINITY_CHECK(&(Entry->Affinity),
+                                 Preferred->ProcessorNumber)) {
+
+        return Preferred;
+    }
+
+    Best = NULL;
+    BestCount = 0;
+    BestNear = FALSE;
+    ActiveCount = KeGetActiveProcessorCount();
+    for (Number = 0; Number < ActiveCount; Number += 1) {
+        if (!PROCESSOR_AFFINITY_CHECK(&(Entry->Affinity), Number)) {
+            continue;
+        }
+
+        ProcessorBlock = KeProcessorBlocks[Number];
+        Count = ProcessorBlock->Scheduler.Group.ReadyThreadCount;
+        Near = FALSE;
+        if (ProcessorBlock->CacheDomain == Preferred->CacheDomain) {
+            Near = TRUE;
+        }
+
+        if ((Best == NULL) ||
+            (Count < BestCount) ||
+            ((Count == BestCount) && (Near != FALSE) && (BestNear == FALSE))) {
+
+            Best = ProcessorBlock;
+            BestCount = Count;
+            BestNear = Near;
+        }
+    }
+
+    //
+    // Affinities are validated against the active processors when they are
+    // set, so there should always be a candidate.
+    //
+
+    ASSERT(Best != NULL);
+
+    if (Best == NULL) {
+        Best = Preferred;
+    }
+
+    return Best;
+}
+
+BOOL
+KepEnqueueSchedulerEntry (
+    PSCHEDULER_ENTRY Entry,
+    BOOL LockHeld
+    )
+
+/*++
+
+Routine Description:
+
+    This routine adds the given thread entry to the active scheduler. This
+    routine assumes the current runlevel is at dispatch, or interrupts are
+    disabled.
+
+Arguments:
+
+    Entry - Supplies a pointer to the entry to add.
+
+    LockHeld - Supplies a boolean indicating whether or not the caller has the
+        scheduler lock already held.
+
+Return Value:
+
+    TRUE if this was the first thread scheduled on the top level group. This
+    may indicate to callers that the processor may be out and idle.
+
+    FALSE if this was not the first thread scheduled.
+
+--*/
+
+{
+
+    BOOL FirstThread;
+    PSCHEDULER_GROUP_ENTRY GroupEntry;
+    ULONG Index;
+    PSCHEDULER_GROUP_ENTRY ParentGroupEntry;
+    PSCHEDULER_DATA Scheduler;
+
+    ASSERT((KeGetRunLevel() == RunLevelDispatch) ||
+           (ArAreInterruptsEnabled() == FALSE));
+
+    ASSERT(Entry->Type == SchedulerEntryThread);
+
+    FirstThread = FALSE;
+    if (LockHeld != FALSE) {
+        GroupEntry = PARENT_STRUCTURE(Entry->Parent,
+                                      SCHEDULER_GROUP_ENTRY,
+                                      Entry);
+
+        Scheduler = GroupEntry->Scheduler;
+
+    } else {
+
+        //
+        // Chase the entity around as it bounces from group entry to group
+        // entry.
+        //
+
+        while (TRUE) {
+            GroupEntry = PARENT_STRUCTURE(Entry->Parent,
+                                          SCHEDULER_GROUP_ENTRY,
+                                          Entry);
+
+            Scheduler = GroupEntry->Scheduler;
+            KeAcquireSpinLock(&(Scheduler->Lock));
+            if (Entry->Parent == &(GroupEntry->Entry)) {
+                break;
+            }
+
+            KeReleaseSpinLock(&(Scheduler->Lock));
+        }
+    }
+
+    ASSERT(Entry->Queued == FALSE);
+
+    Entry->Queued = TRUE;
+
+    //
+    // Real-time threads go on the end of the processor's list for their
+    // priority, and only count towards the top level group.
+    //
+
+    if (SCHEDULER_ENTRY_IS_REAL_TIME(Entry)) {
+        Index = Entry->Parameters.RealTimePriority -
+                SCHEDULER_REAL_TIME_PRIORITY_MIN;
+
+        INSERT_BEFORE(&(Entry->ListEntry), &(Scheduler->RealTime[Index]));
+        Scheduler->RealTimeMask |= 1 << Index;
+        GroupEntry = &(Scheduler->Group);
+        GroupEntry->ReadyThreadCount += 1;
+        if (GroupEntry->ReadyThreadCount == 1) {
+            FirstThread = TRUE;
+        }
+
+        goto EnqueueSchedulerEntryEnd;
+    }
+
+    //
+    // Add the entry to the group's run queue.
+    //
+
+    KepPlaceSchedulerEntry(GroupEntry, Entry);
+    RtlRedBlackTreeInsert(&(GroupEntry->Children), &(Entry->TreeNode));
+
+    //
+    // Propagate the ready thread up through all levels. Groups that just got
+    // their first ready thread get queued in their parent.
+    //
+
+    while (TRUE) {
+        GroupEntry->ReadyThreadCount += 1;
+        if (GroupEntry->Entry.Parent == NULL) {
+
+            //
+            // Remember if this is the first thread to become ready on the top
+            // level group.
+            //
+
+            if (GroupEntry->ReadyThreadCount == 1) {
+                FirstThread = TRUE;
+            }
+
+            break;
+        }
+
+        ParentGroupEntry = PARENT_STRUCTURE(GroupEntry->Entry.Parent,
+                                            SCHEDULER_GROUP_ENTRY,
+                                            Entry);
+
+        if (GroupEntry->ReadyThreadCount == 1) {
+
+            ASSERT(GroupEntry->Entry.Queued == FALSE);
+
+            GroupEntry->Entry.Queued = TRUE;
+            KepPlaceSchedulerEntry(ParentGroupEntry, &(GroupEntry->Entry));
+            RtlRedBlackTreeInsert(&(ParentGroupEntry->Children),
+                                  &(GroupEntry->Entry.TreeNode));
+        }
+
+        GroupEntry = ParentGroupEntry;
+    }
+
+EnqueueSchedulerEntryEnd:
+    if (LockHeld == FALSE) {
+        KeReleaseSpinLock(&(Scheduler->Lock));
+    }
+
+    return FirstThread;
+}
+
+VOID
+KepDequeueSchedulerEntry (
+    PSCHEDULER_ENTRY Entry,
+    BOOL LockHeld
+    )
+
+/*++
+
+Routine Description:
+
+    This routine removes the given thread entry from the active scheduler.
+    This routine assumes the current runlevel is at dispatch, or interrupts are
+    disabled.
+
+Arguments:
+
+    Entry - Supplies a pointer to the entry to remove.
+
+    LockHeld - Supplies a boolean indicating whether or not the caller has the
+        scheduler lock already held.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PSCHEDULER_GROUP_ENTRY GroupEntry;
+    ULONG Index;
+    PSCHEDULER_GROUP_ENTRY ParentGroupEntry;
+    PSCHEDULER_DATA Scheduler;
+
+    ASSERT((KeGetRunLevel() == RunLevelDispatch) ||
+           (ArAreInterruptsEnabled() == FALSE));
+
+    ASSERT(Entry->Type == SchedulerEntryThread);
+
+    if (LockHeld != FALSE) {
+        GroupEntry = PARENT_STRUCTURE(Entry->Parent,
+                                      SCHEDULER_GROUP_ENTRY,
+                                      Entry);
+
+        Scheduler = GroupEntry->Scheduler;
+
+    } else {
+
+        //
+        // Chase the entity around as it bounces from group entry to group
+        // entry.
+        //
+
+        while (TRUE) {
+            GroupEntry = PARENT_STRUCTURE(Entry->Parent,
+                                          SCHEDULER_GROUP_ENTRY,
+                                          Entry);
+
+            Scheduler = GroupEntry->Scheduler;
+            KeAcquireSpinLock(&(Scheduler->Lock));
+            if (Entry->Parent == &(GroupEntry->Entry)) {
+                break;
+            }
+
+            KeReleaseSpinLock(&(Scheduler->Lock));
+        }
+    }
+
+    ASSERT(Entry->Queued != FALSE);
+
+    Entry->Queued = FALSE;
+
+    //
+    // Real-time threads come off the processor's list for their priority.
+    //
+
+    if (SCHEDULER_ENTRY_IS_REAL_TIME(Entry)) {
+        Index = Entry->Parameters.RealTimePriority -
+                SCHEDULER_REAL_TIME_PRIORITY_MIN;
+
+        LIST_REMOVE(&(Entry->ListEntry));
+        Entry->ListEntry.Next = NULL;
+        if (LIST_EMPTY(&(Scheduler->RealTime[Index])) != FALSE) {
+            Scheduler->RealTimeMask &= ~(1 << Index);
+        }
+
+        Scheduler->Group.ReadyThreadCount -= 1;
+        goto DequeueSchedulerEntryEnd;
+    }
+
+    //
+    // Remove the entry from the group's run queue.
+    //
+
+    RtlRedBlackTreeRemove(&(GroupEntry->Children), &(Entry->TreeNode));
+    KepUpdateMinimumVirtualRuntime(GroupEntry);
+
+    //
+    // Propagate the no-longer-ready thread up through all levels. Groups with
+    // nothing left to run come out of their parent's run queue.
+    //
+
+    while (TRUE) {
+        GroupEntry->ReadyThreadCount -= 1;
+        if (GroupEntry->Entry.Parent == NULL) {
+            break;
+        }
+
+        ParentGroupEntry = PARENT_STRUCTURE(GroupEntry->Entry.Parent,
+                                            SCHEDULER_GROUP_ENTRY,
+                                            Entry);
+
+        if (GroupEntry->ReadyThreadCount == 0) {
+
+            ASSERT(GroupEntry->Entry.Queued != FALSE);
+
+            GroupEntry->Entry.Queued = FALSE;
+            RtlRedBlackTreeRemove(&(ParentGroupEntry->Children),
+                                  &(GroupEntry->Entry.TreeNode));
+
+            KepUpdateMinimumVirtualRuntime(ParentGroupEntry);
+        }
+
+        GroupEntry = ParentGroupEntry;
+    }
+
+DequeueSchedulerEntryEnd:
+    if (LockHeld == FALSE) {
+        KeReleaseSpinLock(&(Scheduler->Lock));
+    }
+
+    return;
+}
+
+PKTHREAD
+KepGetNextThread (
+    PSCHEDULER_DATA Scheduler,
+    PPROCESSOR_BLOCK Destination,
+    ULONGLONG MigratedBefore
+    )
+
+/*++
+
+Routine Description:
+
+    This routine returns the next thread to run in the scheduler. Real-time
+    threads are chosen first, highest priority first. Otherwise the fair thread
+    with the lowest virtual runtime is chosen, descending through the groups
+    with the lowest virtual runtime. This routine assumes the scheduler lock is
+    already held.
+
+Arguments:
+
+    Scheduler - Supplies a pointer to the scheduler to work on.
+
+    Destination - Supplies an optional pointer to the processor the thread is
+        being stolen for. If supplied, threads that cannot be migrated to that
+        processor are skipped. Supply NULL to pick the next thread to run on
+        the scheduler's own processor.
+
+    MigratedBefore - Supplies a time counter value. If a destination is
+        supplied, threads that were last migrated after this time are skipped,
+        so that threads are not bounced between processors.
+
+Return Value:
+
+    Returns a pointer to the next thread to run.
+
+    NULL if no threads are ready to run.
+
+--*/
+
+{
+
+    PSCHEDULER_ENTRY Entry;
+    PSCHEDULER_GROUP_ENTRY GroupEntry;
+    ULONG Index;
+    PLIST_ENTRY ListEntry;
+    ULONG Mask;
+    PRED_BLACK_TREE_NODE Node;
+    PKTHREAD Thread;
+
+    GroupEntry = &(Scheduler->Group);
+    if (GroupEntry->ReadyThreadCount == 0) {
+        return NULL;
+    }
+
+    //
+    // Look through the real-time lists, from the highest priority down.
+    //
+
+    Mask = Scheduler->RealTimeMask;
+    while (Mask != 0) {
+        Index = (sizeof(ULONG) * BITS_PER_BYTE) - 1 -
+                RtlCountLeadingZeros32(Mask);
+
+        ListEntry = Scheduler->RealTime[Index].Next;
+        while (ListEntry != &(Scheduler->RealTime[Index])) {
+            Entry = LIST_VALUE(ListEntry, SCHEDULER_ENTRY, ListEntry);
+            Thread = PARENT_STRUCTURE(Entry, KTHREAD, SchedulerEntry);
+            if ((Destination == NULL) ||
+                (KepCanMigrateThread(Thread, Destination, MigratedBefore))) {
+
+                return Thread;
+            }
+
+            ListEntry = ListEntry->Next;
+        }
+
+        Mask &= ~(1 << Index);
+    }
+
+    //
+    // Walk the fair run queues in virtual runtime order. Only groups with
+    // ready threads are queued, so descending into a group usually finds a
+    // thread right away.
+    //
+
+    Node = RtlRedBlackTreeGetLowestNode(&(GroupEntry->Children));
+    while (TRUE) {
+
+        //
+        // If the end of this group was hit, pop back up to the parent and
+        // continue with the group's next sibling.
+        //
+
+        if (Node == NULL) {
+            if (GroupEntry->Entry.Parent == NULL) {
+                break;
+            }
+
+            Entry = &(GroupEntry->Entry);
+            GroupEntry = PARENT_STRUCTURE(Entry->Parent,
+                                          SCHEDULER_GROUP_ENTRY,
+                                          Entry);
+
+            Node = RtlRedBlackTreeGetNextNode(&(GroupEntry->Children),
+                                              FALSE,
+                                              &(Entry->TreeNode));
+
+            continue;
+        }
+
+        Entry = RED_BLACK_TREE_VALUE(Node, SCHEDULER_ENTRY, TreeNode);
+        if (Entry->Type == SchedulerEntryThread) {
+            Thread = PARENT_STRUCTURE(Entry, KTHREAD, SchedulerEntry);
+            if ((Destination == NULL) ||
+                (KepCanMigrateThread(Thread, Destination, MigratedBefore))) {
+
+                return Thread;
+            }
+
+            Node = RtlRedBlackTreeGetNextNode(&(GroupEntry->Children),
+                                              FALSE,
+                                              Node);
+
+            continue;
+        }
+
+        //
+        // The child is a group with ready threads somewhere down there.
+        // Descend into it.
+        //
+
+        ASSERT(Entry->Type == SchedulerEntryGroup);
+
+        GroupEntry = PARENT_STRUCTURE(Entry, SCHEDULER_GROUP_ENTRY, Entry);
+
+        ASSERT(GroupEntry->ReadyThreadCount != 0);
+
+        Node = RtlRedBlackTreeGetLowestNode(&(GroupEntry->Children));
+    }
+
+    //
+    // The end of the group was hit without finding a thread.
+    //
+
+    return NULL;
+}
+
+BOOL
+KepCanMigrateThread (
+    PKTHREAD Thread,
+    PPROCESSOR_BLOCK Destination,
+    ULONGLONG MigratedBefore
+    )
+
+/*++
+
+Routine Description:
+
+    This routine determines whether a ready thread may be stolen by another
+    processor. This routine assumes the scheduler lock of the thread's
+    current processor is held.
+
+Arguments:
+
+    Thread - Supplies a pointer to the thread being considered.
+
+    Destination - Supplies a pointer to the processor the thread would move to.
+
+    MigratedBefore - Supplies a time counter value. Threads that were last
+        migrated after this time cannot move again yet.
+
+Return Value:
+
+    TRUE if the thread can be moved to the destination.
+
+    FALSE if the thread is running, was migrated too recently, or is not
+    allowed to run on the destination.
+
+--*/
+
+{
+
+    PSCHEDULER_ENTRY Entry;
+
+    Entry = &(Thread->SchedulerEntry);
+    if ((Thread->State == ThreadStateRunning) ||
+        (Entry->LastMigration > MigratedBefore) ||
+        (!PROCESSOR_AFFINITY_CHECK(&(Entry->Affinity),
+                                   Destination->ProcessorNumber))) {
+
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+VOID
+KepChargeSchedulerEntry (
+    PSCHEDULER_ENTRY Entry,
+    ULONGLONG CurrentTime
+    )
+
+/*++
+
+Routine Description:
+
+    This routine charges the time a running fair thread has used since it was
+    last charged to its virtual runtime and that of each group above it,
+    keeping each run queue in order. Real-time threads are not charged. This
+    routine assumes the scheduler lock is already held.
+
+Arguments:
+
+    Entry - Supplies a pointer to the running thread's scheduler entry.
+
+    CurrentTime - Supplies the current processor counter value.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    ULONGLONG Delta;
+    PSCHEDULER_GROUP_ENTRY GroupEntry;
+    ULONGLONG WeightedDelta;
+
+    if (SCHEDULER_ENTRY_IS_REAL_TIME(Entry)) {
+        return;
+    }
+
+    Delta = CurrentTime - Entry->RunStart;
+    Entry->RunStart = CurrentTime;
+    if (Delta == 0) {
+        return;
+    }
+
+    while (Entry->Parent != NULL) {
+        GroupEntry = PARENT_STRUCTURE(Entry->Parent,
+                                      SCHEDULER_GROUP_ENTRY,
+                                      Entry);
+
+        WeightedDelta = Delta;
+        if (Entry->Weight != SCHEDULER_NICE_ZERO_WEIGHT) {
+            WeightedDelta = (Delta * SCHEDULER_NICE_ZERO_WEIGHT) /
+                            Entry->Weight;
+        }
+
+        //
+        // The tree is keyed on virtual runtime, so the entry has to come out
+        // while its key changes.
+        //
+
+        if (Entry->Queued != FALSE) {
+            RtlRedBlackTreeRemove(&(GroupEntry->Children), &(Entry->TreeNode));
+            Entry->VirtualRuntime += WeightedDelta;
+            RtlRedBlackTreeInsert(&(GroupEntry->Children), &(Entry->TreeNode));
+
+        } else {
+            Entry->VirtualRuntime += WeightedDelta;
         }
 
-        Number += 1;
+        KepUpdateMinimumVirtualRuntime(GroupEntry);
+        Entry = &(GroupEntry->Entry);
     }
 
-    KeLowerRunLevel(OldRunLevel);
     return;
 }
 
-BOOL
-KepEnqueueSchedulerEntry (
+VOID
+KepRequeueRunningEntry (
+    PSCHEDULER_DATA Scheduler,
     PSCHEDULER_ENTRY Entry,
-    BOOL LockHeld
+    SCHEDULER_REASON Reason,
+    ULONGLONG CurrentTime
     )
 
 /*++
 
 Routine Description:
 
-    This routine adds the given entry to the active scheduler. This routine
-    assumes the current runlevel is at dispatch, or interrupts are disabled.
+    This routine moves the thread that was just running to its new place in
+    line when it remains ready. This routine assumes the scheduler lock is
+    already held and that the entry has already been charged for its time.
 
 Arguments:
 
-    Entry - Supplies a pointer to the entry to add.
+    Scheduler - Supplies a pointer to the scheduler the thread is on.
 
-    LockHeld - Supplies a boolean indicating whether or not the caller has the
-        scheduler lock already held.
+    Entry - Supplies a pointer to the running thread's scheduler entry.
 
-Return Value:
+    Reason - Supplies the reason the scheduler was called.
 
-    TRUE if this was the first thread scheduled on the top level group. This
-    may indicate to callers that the processor may be out and idle.
+    CurrentTime - Supplies the current processor counter value.
+
+Return Value:
 
-    FALSE if this was not the first thread scheduled, or the entry being
-    scheduled was not a thread.
+    None.
 
 --*/
 
 {
 
-    BOOL FirstThread;
     PSCHEDULER_GROUP_ENTRY GroupEntry;
-    PSCHEDULER_DATA Scheduler;
-
-    ASSERT((KeGetRunLevel() == RunLevelDispatch) ||
-           (ArAreInterruptsEnabled() == FALSE));
-
-    FirstThread = FALSE;
-    if (LockHeld != FALSE) {
-        GroupEntry = PARENT_STRUCTURE(Entry->Parent,
-                                      SCHEDULER_GROUP_ENTRY,
-                                      Entry);
-
-        Scheduler = GroupEntry->Scheduler;
+    ULONG Index;
+    PSCHEDULER_ENTRY LastEntry;
+    PRED_BLACK_TREE_NODE Node;
 
-    } else {
+    ASSERT(Entry->Queued != FALSE);
 
-        //
-        // Chase the entity around as it bounces from group entry to group
-        // entry.
-        //
+    //
+    // Real-time threads keep their place at the head of their list unless
+    // they're yielding or they are round robin and their time is up, in which
+    // case they go to the back of the line for their priority.
+    //
 
-        while (TRUE) {
-            GroupEntry = PARENT_STRUCTURE(Entry->Parent,
-                                          SCHEDULER_GROUP_ENTRY,
-                                          Entry);
+    if (SCHEDULER_ENTRY_IS_REAL_TIME(Entry)) {
+        if ((Reason == SchedulerReasonThreadYielding) ||
+            ((Entry->Parameters.Policy == SchedulerPolicyRoundRobin) &&
+             (CurrentTime - Entry->RunStart >= Scheduler->Quantum))) {
 
-            Scheduler = GroupEntry->Scheduler;
-            KeAcquireSpinLock(&(Scheduler->Lock));
-            if (Entry->Parent == &(GroupEntry->Entry)) {
-                break;
-            }
+            Index = Entry->Parameters.RealTimePriority -
+                    SCHEDULER_REAL_TIME_PRIORITY_MIN;
 
-            KeReleaseSpinLock(&(Scheduler->Lock));
+            LIST_REMOVE(&(Entry->ListEntry));
+            INSERT_BEFORE(&(Entry->ListEntry), &(Scheduler->RealTime[Index]));
+            Entry->RunStart = CurrentTime;
         }
-    }
-
-    //
-    // Add the entry to the list.
-    //
 
-    ASSERT(Entry->ListEntry.Next == NULL);
-
-    INSERT_BEFORE(&(Entry->ListEntry), &(GroupEntry->Children));
+        return;
+    }
 
     //
-    // Propagate the ready thread up through all levels.
+    // Charging has already moved fair threads to their place. A yielding fair
+    // thread goes behind everything else in its group so that the others get
+    // a turn.
     //
 
-    if (Entry->Type == SchedulerEntryThread) {
-        while (TRUE) {
-            GroupEntry->ReadyThreadCount += 1;
-            if (GroupEntry->Entry.Parent == NULL) {
-
-                //
-                // Remember if this is the first thread to become ready on the
-                // top level group.
-                //
+    if (Reason == SchedulerReasonThreadYielding) {
+        GroupEntry = PARENT_STRUCTURE(Entry->Parent,
+                                      SCHEDULER_GROUP_ENTRY,
+                                      Entry);
 
-                if (GroupEntry->ReadyThreadCount == 1) {
-                    FirstThread = TRUE;
-                }
+        Node = RtlRedBlackTreeGetHighestNode(&(GroupEntry->Children));
+        LastEntry = RED_BLACK_TREE_VALUE(Node, SCHEDULER_ENTRY, TreeNode);
+        if (LastEntry != Entry) {
+            RtlRedBlackTreeRemove(&(GroupEntry->Children), &(Entry->TreeNode));
+            if (SCHEDULER_VIRTUAL_RUNTIME_BEFORE(Entry->VirtualRuntime,
+                                                 LastEntry->VirtualRuntime)) {
 
-                break;
+                Entry->VirtualRuntime = LastEntry->VirtualRuntime;
             }
 
-            GroupEntry = PARENT_STRUCTURE(GroupEntry->Entry.Parent,
-                                          SCHEDULER_GROUP_ENTRY,
-                                          Entry);
+            RtlRedBlackTreeInsert(&(GroupEntry->Children), &(Entry->TreeNode));
+            KepUpdateMinimumVirtualRuntime(GroupEntry);
         }
     }
 
-    if (LockHeld == FALSE) {
-        KeReleaseSpinLock(&(Scheduler->Lock));
-    }
-
-    return FirstThread;
+    return;
 }
 
 VOID
-KepDequeueSchedulerEntry (
-    PSCHEDULER_ENTRY Entry,
-    BOOL LockHeld
+KepPlaceSchedulerEntry (
+    PSCHEDULER_GROUP_ENTRY GroupEntry,
+    PSCHEDULER_ENTRY Entry
     )
 
 /*++
 
 Routine Description:
 
-    This routine removes the given entry to the active scheduler. This routine
-    assumes the current runlevel is at dispatch, or interrupts are disabled.
+    This routine sets the virtual runtime of an entry that is about to be
+    queued in a group's run queue. Entries that have been away are brought up
+    to near the group's floor so they neither starve the others with banked
+    time nor wait behind everything that ran while they slept. A little credit
+    is left so that threads waking up run soon.
 
 Arguments:
 
-    Entry - Supplies a pointer to the entry to remove.
+    GroupEntry - Supplies a pointer to the group entry the entry is about to be
+        queued in.
 
-    LockHeld - Supplies a boolean indicating whether or not the caller has the
-        scheduler lock already held.
+    Entry - Supplies a pointer to the entry being queued.
 
 Return Value:
 
@@ -1041,199 +2561,129 @@ Return Value:
 
 {
 
-    PSCHEDULER_GROUP_ENTRY GroupEntry;
-    PSCHEDULER_GROUP_ENTRY ParentGroupEntry;
-    PSCHEDULER_DATA Scheduler;
-
-    ASSERT((KeGetRunLevel() == RunLevelDispatch) ||
-           (ArAreInterruptsEnabled() == FALSE));
+    ULONGLONG Floor;
 
-    if (LockHeld != FALSE) {
-        GroupEntry = PARENT_STRUCTURE(Entry->Parent,
-                                      SCHEDULER_GROUP_ENTRY,
-                                      Entry);
+    Floor = GroupEntry->MinimumVirtualRuntime -
+            GroupEntry->Scheduler->WakeupCredit;
 
-        Scheduler = GroupEntry->Scheduler;
+    if (SCHEDULER_VIRTUAL_RUNTIME_BEFORE(Entry->VirtualRuntime, Floor)) {
+        Entry->VirtualRuntime = Floor;
+    }
 
-    } else {
+    return;
+}
 
-        //
-        // Chase the entity around as it bounces from group entry to group
-        // entry.
-        //
+VOID
+KepUpdateMinimumVirtualRuntime (
+    PSCHEDULER_GROUP_ENTRY GroupEntry
+    )
 
-        while (TRUE) {
-            GroupEntry = PARENT_STRUCTURE(Entry->Parent,
-                                          SCHEDULER_GROUP_ENTRY,
-                                          Entry);
+/*++
 
-            Scheduler = GroupEntry->Scheduler;
-            KeAcquireSpinLock(&(Scheduler->Lock));
-            if (Entry->Parent == &(GroupEntry->Entry)) {
-                break;
-            }
+Routine Description:
 
-            KeReleaseSpinLock(&(Scheduler->Lock));
-        }
-    }
+    This routine advances the virtual runtime floor of the given group to the
+    lowest virtual runtime in its run queue. The floor never moves backwards.
+    This routine assumes the scheduler lock is already held.
 
-    //
-    // Remove the entry from the list.
-    //
+Arguments:
 
-    ASSERT(Entry->ListEntry.Next != NULL);
+    GroupEntry - Supplies a pointer to the group entry to update.
 
-    LIST_REMOVE(&(Entry->ListEntry));
-    Entry->ListEntry.Next = NULL;
+Return Value:
 
-    //
-    // Propagate the no-longer-ready thread up through all levels.
-    //
+    None.
 
-    if (Entry->Type == SchedulerEntryThread) {
-        while (TRUE) {
-            GroupEntry->ReadyThreadCount -= 1;
-            if (GroupEntry->Entry.Parent == NULL) {
-                break;
-            }
+--*/
 
-            ParentGroupEntry = PARENT_STRUCTURE(GroupEntry->Entry.Parent,
-                                                SCHEDULER_GROUP_ENTRY,
-                                                Entry);
+{
 
-            //
-            // Rotate the groups so others at higher levels get a chance to run.
-            //
+    PSCHEDULER_ENTRY Entry;
+    PRED_BLACK_TREE_NODE Node;
 
-            LIST_REMOVE(&(GroupEntry->Entry.ListEntry));
-            INSERT_BEFORE(&(GroupEntry->Entry.ListEntry),
-                          &(ParentGroupEntry->Children));
+    Node = RtlRedBlackTreeGetLowestNode(&(GroupEntry->Children));
+    if (Node != NULL) {
+        Entry = RED_BLACK_TREE_VALUE(Node, SCHEDULER_ENTRY, TreeNode);
+        if (SCHEDULER_VIRTUAL_RUNTIME_BEFORE(GroupEntry->MinimumVirtualRuntime,
+                                             Entry->VirtualRuntime)) {
 
-            GroupEntry = ParentGroupEntry;
+            GroupEntry->MinimumVirtualRuntime = Entry->VirtualRuntime;
         }
-
-    } else {
-        GroupEntry = PARENT_STRUCTURE(Entry, SCHEDULER_GROUP_ENTRY, Entry);
-
-        ASSERT(GroupEntry->ReadyThreadCount == 0);
-    }
-
-    if (LockHeld == FALSE) {
-        KeReleaseSpinLock(&(Scheduler->Lock));
     }
 
     return;
 }
 
-PKTHREAD
-KepGetNextThread (
-    PSCHEDULER_DATA Scheduler,
-    BOOL SkipRunning
+BOOL
+KepShouldPreempt (
+    PKTHREAD RunningThread,
+    PKTHREAD Thread
     )
 
 /*++
 
 Routine Description:
 
-    This routine returns the next thread to run in the scheduler. This routine
-    assumes the scheduler lock is already held.
+    This routine determines whether a newly ready thread should preempt the
+    thread running on the current processor.
 
 Arguments:
 
-    Scheduler - Supplies a pointer to the scheduler to work on.
+    RunningThread - Supplies a pointer to the thread running on the current
+        processor.
 
-    SkipRunning - Supplies a boolean indicating whether to ignore the first
-        thread on the queue if it's marked as running. This is used when trying
-        to steal threads from another scheduler.
+    Thread - Supplies a pointer to the thread that just became ready.
 
 Return Value:
 
-    Returns a pointer to the next thread to run.
+    TRUE if the scheduler should run to consider switching to the new thread.
 
-    NULL if no threads are ready to run.
+    FALSE if the running thread should continue until the next clock tick.
 
 --*/
 
 {
 
-    PSCHEDULER_GROUP_ENTRY ChildGroupEntry;
-    PLIST_ENTRY CurrentEntry;
     PSCHEDULER_ENTRY Entry;
-    PSCHEDULER_GROUP_ENTRY GroupEntry;
-    PKTHREAD Thread;
+    PPROCESSOR_BLOCK Processor;
+    PSCHEDULER_ENTRY RunningEntry;
 
-    GroupEntry = &(Scheduler->Group);
-    if (GroupEntry->ReadyThreadCount == 0) {
-        return NULL;
+    Processor = KeGetCurrentProcessorBlock();
+    if (RunningThread == Processor->IdleThread) {
+        return TRUE;
     }
 
-    CurrentEntry = GroupEntry->Children.Next;
-    while (CurrentEntry != &(GroupEntry->Children)) {
-
-        //
-        // Get the next child of the group. If it's a thread, return it.
-        //
-
-        Entry = LIST_VALUE(CurrentEntry, SCHEDULER_ENTRY, ListEntry);
-        if (Entry->Type == SchedulerEntryThread) {
-            Thread = PARENT_STRUCTURE(Entry, KTHREAD, SchedulerEntry);
-            if ((SkipRunning == FALSE) ||
-                (Thread->State != ThreadStateRunning)) {
-
-                return Thread;
-            }
-
-            //
-            // This thread was not acceptable. Try to continue to the next
-            // entry in the list, or pop back up to the parent group.
-            //
-
-            while (TRUE) {
-                if (CurrentEntry->Next != &(GroupEntry->Children)) {
-                    CurrentEntry = CurrentEntry->Next;
-                    break;
-                }
-
-                if (GroupEntry->Entry.Parent == NULL) {
-                    CurrentEntry = CurrentEntry->Next;
-                    break;
-                }
-
-                CurrentEntry = &(GroupEntry->Entry.ListEntry);
-                GroupEntry = PARENT_STRUCTURE(GroupEntry->Entry.Parent,
-                                              SCHEDULER_GROUP_ENTRY,
-                                              Entry);
-            }
+    Entry = &(Thread->SchedulerEntry);
+    RunningEntry = &(RunningThread->SchedulerEntry);
+    if (SCHEDULER_ENTRY_IS_REAL_TIME(Entry)) {
+        if ((!SCHEDULER_ENTRY_IS_REAL_TIME(RunningEntry)) ||
+            (Entry->Parameters.RealTimePriority >
+             RunningEntry->Parameters.RealTimePriority)) {
 
-            continue;
+            return TRUE;
         }
 
-        //
-        // The child is a group. If it has no children, continue to the sibling.
-        //
-
-        ASSERT(Entry->Type == SchedulerEntryGroup);
-
-        ChildGroupEntry = PARENT_STRUCTURE(Entry, SCHEDULER_GROUP_ENTRY, Entry);
-        if (ChildGroupEntry->ReadyThreadCount == 0) {
-            CurrentEntry = CurrentEntry->Next;
-
-        //
-        // The child group has ready threads somewhere down there. Descend into
-        // it.
-        //
+        return FALSE;
+    }
 
-        } else {
-            GroupEntry = ChildGroupEntry;
-            CurrentEntry = GroupEntry->Children.Next;
-        }
+    if (SCHEDULER_ENTRY_IS_REAL_TIME(RunningEntry)) {
+        return FALSE;
     }
 
     //
-    // The end of the group was hit without finding a thread.
+    // Between fair threads in the same group, preempt if the new thread is
+    // far enough behind on virtual runtime. The running thread hasn't been
+    // charged for its current run yet, so this errs towards not preempting.
     //
 
-    return NULL;
+    if ((Entry->Parent == RunningEntry->Parent) &&
+        ((LONGLONG)(RunningEntry->VirtualRuntime - Entry->VirtualRuntime) >
+         (LONGLONG)(Processor->Scheduler.Granularity))) {
+
+        return TRUE;
+    }
+
+    return FALSE;
 }
 
 KSTATUS
@@ -1331,16 +2781,15 @@ Return Value:
             ParentGroupEntry = &(ParentGroup->Entries[Index]);
         }
 
+        //
+        // The group entry is queued in the parent group entry once it has
+        // ready threads.
+        //
+
         KepInitializeSchedulerGroupEntry(&(Group->Entries[Index]),
                                          &(KeProcessorBlocks[Index]->Scheduler),
                                          Group,
                                          ParentGroupEntry);
-
-        //
-        // Add the scheduler group entry to the parent scheduler group entry.
-        //
-
-        KepEnqueueSchedulerEntry(&(Group->Entries[Index].Entry), FALSE);
     }
 
     *NewGroup = Group;
@@ -1381,9 +2830,8 @@ Return Value:
         GroupEntry = &(Group->Entries[Index]);
 
         ASSERT((GroupEntry->ReadyThreadCount == 0) &&
-               (LIST_EMPTY(&(GroupEntry->Children)) != FALSE));
-
-        KepDequeueSchedulerEntry(&(GroupEntry->Entry), FALSE);
+               (GroupEntry->Entry.Queued == FALSE) &&
+               (RED_BLACK_TREE_EMPTY(&(GroupEntry->Children)) != FALSE));
     }
 
     OldRunLevel = KeRaiseRunLevel(RunLevelDispatch);
@@ -1431,15 +2879,137 @@ Return Value:
     GroupEntry->Entry.Type = SchedulerEntryGroup;
     if (ParentEntry == NULL) {
         GroupEntry->Entry.Parent = NULL;
+        GroupEntry->Entry.VirtualRuntime = 0;
 
     } else {
         GroupEntry->Entry.Parent = &(ParentEntry->Entry);
+        GroupEntry->Entry.VirtualRuntime = ParentEntry->MinimumVirtualRuntime;
     }
 
-    INITIALIZE_LIST_HEAD(&(GroupEntry->Children));
+    GroupEntry->Entry.ListEntry.Next = NULL;
+    GroupEntry->Entry.Parameters.Policy = SchedulerPolicyFair;
+    GroupEntry->Entry.Parameters.NiceValue = 0;
+    GroupEntry->Entry.Parameters.RealTimePriority = 0;
+    GroupEntry->Entry.Weight = SCHEDULER_NICE_ZERO_WEIGHT;
+    GroupEntry->Entry.Queued = FALSE;
+    GroupEntry->Entry.RunStart = 0;
+    RtlRedBlackTreeInitialize(&(GroupEntry->Children),
+                              0,
+                              KepCompareSchedulerEntries);
+
+    GroupEntry->MinimumVirtualRuntime = 0;
     GroupEntry->ReadyThreadCount = 0;
     GroupEntry->Group = Group;
     GroupEntry->Scheduler = Scheduler;
     return;
 }
 
+VOID
+KepInitializeSchedulerPeriods (
+    PSCHEDULER_DATA Scheduler
+    )
+
+/*++
+
+Routine Description:
+
+    This routine converts the scheduling periods into processor and time
+    counter ticks for the given scheduler. If the processor counter frequency
+    is not yet known, the periods are left at zero and this will be tried
+    again the next time the scheduler runs. This routine assumes the scheduler
+    lock is already held.
+
+Arguments:
+
+    Scheduler - Supplies a pointer to the scheduler to initialize.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    ULONGLONG Frequency;
+
+    Frequency = HlQueryProcessorCounterFrequency();
+    Scheduler->Granularity = (Frequency * SCHEDULER_GRANULARITY_MICROSECONDS) /
+                             MICROSECONDS_PER_SECOND;
+
+    Scheduler->WakeupCredit =
+                        (Frequency * SCHEDULER_WAKEUP_CREDIT_MICROSECONDS) /
+                        MICROSECONDS_PER_SECOND;
+
+    Scheduler->Quantum = (Frequency * SCHEDULER_QUANTUM_MICROSECONDS) /
+                         MICROSECONDS_PER_SECOND;
+
+    //
+    // The load balancing periods are compared against the time counter,
+    // since they are used across processors.
+    //
+
+    Frequency = HlQueryTimeCounterFrequency();
+    Scheduler->BalanceInterval =
+                    (Frequency * SCHEDULER_BALANCE_INTERVAL_MICROSECONDS) /
+                    MICROSECONDS_PER_SECOND;
+
+    Scheduler->MigrationCost =
+                      (Frequency * SCHEDULER_MIGRATION_COST_MICROSECONDS) /
+                      MICROSECONDS_PER_SECOND;
+
+    return;
+}
+
+COMPARISON_RESULT
+KepCompareSchedulerEntries (
+    PRED_BLACK_TREE Tree,
+    PRED_BLACK_TREE_NODE FirstNode,
+    PRED_BLACK_TREE_NODE SecondNode
+    )
+
+/*++
+
+Routine Description:
+
+    This routine compares two scheduler entries in a fair run queue by their
+    virtual runtime.
+
+Arguments:
+
+    Tree - Supplies a pointer to the tree being traversed.
+
+    FirstNode - Supplies a pointer to the left side of the comparison.
+
+    SecondNode - Supplies a pointer to the second side of the comparison.
+
+Return Value:
+
+    Same if the two nodes have the same value.
+
+    Ascending if the first node is less than the second node.
+
+    Descending if the second node is less than the first node.
+
+--*/
+
+{
+
+    PSCHEDULER_ENTRY FirstEntry;
+    PSCHEDULER_ENTRY SecondEntry;
+
+    FirstEntry = RED_BLACK_TREE_VALUE(FirstNode, SCHEDULER_ENTRY, TreeNode);
+    SecondEntry = RED_BLACK_TREE_VALUE(SecondNode, SCHEDULER_ENTRY, TreeNode);
+    if (SCHEDULER_VIRTUAL_RUNTIME_BEFORE(FirstEntry->VirtualRuntime,
+                                         SecondEntry->VirtualRuntime)) {
+
+        return ComparisonResultAscending;
+
+    } else if (SCHEDULER_VIRTUAL_RUNTIME_BEFORE(SecondEntry->VirtualRuntime,
+                                                FirstEntry->VirtualRuntime)) {
+
+        return ComparisonResultDescending;
+    }
+
+    return ComparisonResultSame;
+}
@@ -221,6 +221,27 @@ SYSTEM_CALL_TABLE_ENTRY KeSystemCallTable[SystemCallCount] = {
     {MmSysSetBreak,
         sizeof(SYSTEM_CALL_SET_BREAK),
         sizeof(SYSTEM_CALL_SET_BREAK)},
+    {PsSysSetSchedulingParameters,
+        sizeof(SYSTEM_CALL_SET_SCHEDULING_PARAMETERS),
+        sizeof(SYSTEM_CALL_SET_SCHEDULING_PARAMETERS)},
+    {PsSysSetThreadAffinity,
+        sizeof(SYSTEM_CALL_SET_THREAD_AFFINITY),
+        sizeof(SYSTEM_CALL_SET_THREAD_AFFINITY)},
+    {IoSysCreateEventQueue,
+        sizeof(SYSTEM_CALL_CREATE_EVENT_QUEUE),
+        sizeof(SYSTEM_CALL_CREATE_EVENT_QUEUE)},
+    {IoSysControlEventQueue, sizeof(SYSTEM_CALL_CONTROL_EVENT_QUEUE), 0},
+    {IoSysWaitForEventQueue, sizeof(SYSTEM_CALL_WAIT_FOR_EVENT_QUEUE), 0},
+    {MmSysAdviseMemory, sizeof(SYSTEM_CALL_ADVISE_MEMORY), 0},
+    {IoSysSplice, sizeof(SYSTEM_CALL_SPLICE), 0},
+    {IoSysCreateIoRing,
+        sizeof(SYSTEM_CALL_CREATE_IO_RING),
+        sizeof(SYSTEM_CALL_CREATE_IO_RING)},
+    {IoSysEnterIoRing, sizeof(SYSTEM_CALL_ENTER_IO_RING), 0},
+    {IoSysRegisterIoRing, sizeof(SYSTEM_CALL_REGISTER_IO_RING), 0},
+    {IoSysSocketPerformMessageIo,
+        sizeof(SYSTEM_CALL_SOCKET_PERFORM_MESSAGE_IO),
+        0},
 };
 
 //
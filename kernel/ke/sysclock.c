@@ -1022,11 +1022,21 @@ Return Value:
 
         //
         // The thread wasn't blocking, set it to ready to make it eligible
-        // for being run or stolen by another processor.
+        // for being run or stolen by another processor. If the scheduler
+        // pulled it out of the ready queue because its affinity no longer
+        // allows this processor, ready it on an allowed processor now that
+        // it is safely off this one.
         //
 
         case ThreadStateRunning:
-            PreviousThread->State = ThreadStateReady;
+            if (PreviousThread->SchedulerEntry.Queued == FALSE) {
+                PreviousThread->State = ThreadStateWaking;
+                KeSetThreadReady(PreviousThread);
+
+            } else {
+                PreviousThread->State = ThreadStateReady;
+            }
+
             break;
 
         //
@@ -1282,6 +1292,53 @@ Return Value:
     return STATUS_SUCCESS;
 }
 
+VOID
+KepPublishUserTimeCounter (
+    VOID
+    )
+
+/*++
+
+Routine Description:
+
+    This routine publishes whether user mode can read the time counter
+    directly from hardware, along with the offset it needs to do so, in the
+    shared user data page.
+
+Arguments:
+
+    None.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    BOOL Direct;
+    ULONGLONG Offset;
+    PUSER_SHARED_DATA UserSharedData;
+
+    Offset = 0;
+    Direct = HlGetUserModeTimeCounterOffset(&Offset);
+    UserSharedData = MmGetUserSharedData();
+
+    //
+    // Bump the sequence to odd, update the values, and then bump it back to
+    // even so readers can detect a torn read.
+    //
+
+    UserSharedData->TimeCounterSequence += 1;
+    RtlMemoryBarrier();
+    UserSharedData->TimeCounterDirect = Direct;
+    UserSharedData->TimeCounterDirectOffset = Offset;
+    RtlMemoryBarrier();
+    UserSharedData->TimeCounterSequence += 1;
+    return;
+}
+
 VOID
 KepInitializeClock (
     PPROCESSOR_BLOCK Processor
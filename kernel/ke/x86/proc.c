@@ -169,6 +169,7 @@ Return Value:
     return Block;
 }
 
+KERNEL_API
 ULONG
 KeGetCurrentProcessorNumber (
     VOID
@@ -3027,6 +3027,66 @@ Return Value:
     return;
 }
 
+BOOL
+MmpPromoteLargePage (
+    PVOID VirtualAddress
+    )
+
+/*++
+
+Routine Description:
+
+    This routine attempts to replace the page table covering the given region
+    of the current process with a single large page directory entry. Large
+    user mode pages are not supported on this architecture.
+
+Arguments:
+
+    VirtualAddress - Supplies the large page aligned user mode virtual address
+        of the region to promote.
+
+Return Value:
+
+    FALSE always.
+
+--*/
+
+{
+
+    return FALSE;
+}
+
+VOID
+MmpSplitLargePages (
+    PVOID VirtualAddress,
+    UINTN Size
+    )
+
+/*++
+
+Routine Description:
+
+    This routine splits any large pages in the given region of the current
+    process back into individual page mappings. Large user mode pages are not
+    supported on this architecture, so there is nothing to do.
+
+Arguments:
+
+    VirtualAddress - Supplies the user mode virtual address of the region.
+
+    Size - Supplies the size of the region, in bytes.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    return;
+}
+
 //
 // --------------------------------------------------------- Internal Functions
 //
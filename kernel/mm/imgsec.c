@@ -680,6 +680,126 @@ Return Value:
     return Status;
 }
 
+KSTATUS
+MmpChangeImageSectionRegionLargePages (
+    PVOID Address,
+    UINTN Size,
+    BOOL Allow
+    )
+
+/*++
+
+Routine Description:
+
+    This routine sets whether or not the anonymous memory in the given region
+    of the current process may be mapped with large pages. Opting a region out
+    breaks up any large pages already mapping it. Sections backed by files are
+    left alone.
+
+Arguments:
+
+    Address - Supplies the starting address of the region to change.
+
+    Size - Supplies the size of the region to change.
+
+    Allow - Supplies a boolean indicating whether to allow large pages (TRUE)
+        or prevent them (FALSE).
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    PADDRESS_SPACE AddressSpace;
+    PLIST_ENTRY CurrentEntry;
+    PVOID End;
+    ULONG NewFlags;
+    PIMAGE_SECTION Section;
+    PVOID SectionEnd;
+    KSTATUS Status;
+
+    ASSERT(IS_ALIGNED((UINTN)Address | Size, MmPageSize()));
+
+    NewFlags = 0;
+    if (Allow == FALSE) {
+        NewFlags = IMAGE_SECTION_NO_LARGE_PAGES;
+    }
+
+    AddressSpace = PsGetCurrentProcess()->AddressSpace;
+    MmAcquireAddressSpaceLock(AddressSpace);
+    Status = STATUS_SUCCESS;
+    End = Address + Size;
+    CurrentEntry = AddressSpace->SectionListHead.Next;
+    while (CurrentEntry != &(AddressSpace->SectionListHead)) {
+        Section = LIST_VALUE(CurrentEntry, IMAGE_SECTION, AddressListEntry);
+        if (Section->VirtualAddress >= End) {
+            break;
+        }
+
+        CurrentEntry = CurrentEntry->Next;
+        SectionEnd = Section->VirtualAddress + Section->Size;
+        if ((SectionEnd <= Address) ||
+            ((Section->Flags &
+              (IMAGE_SECTION_BACKED | IMAGE_SECTION_SHARED)) != 0) ||
+            ((Section->Flags & IMAGE_SECTION_NO_LARGE_PAGES) == NewFlags)) {
+
+            continue;
+        }
+
+        //
+        // Split off the portions of the section outside the region, in the
+        // same manner as changing access.
+        //
+
+        if (Section->VirtualAddress < Address) {
+            Status = MmpClipImageSection(&(AddressSpace->SectionListHead),
+                                         Address,
+                                         0,
+                                         Section);
+
+            if (!KSUCCESS(Status)) {
+                break;
+            }
+
+            CurrentEntry = Section->AddressListEntry.Next;
+            continue;
+        }
+
+        if (SectionEnd > End) {
+            Status = MmpClipImageSection(&(AddressSpace->SectionListHead),
+                                         End,
+                                         0,
+                                         Section);
+
+            if (!KSUCCESS(Status)) {
+                break;
+            }
+
+            CurrentEntry = Section->AddressListEntry.Next;
+        }
+
+        ASSERT((Section->VirtualAddress >= Address) &&
+               ((Section->VirtualAddress + Section->Size) <= End));
+
+        KeAcquireQueuedLock(Section->Lock);
+        if (Allow != FALSE) {
+            Section->Flags &= ~IMAGE_SECTION_NO_LARGE_PAGES;
+
+        } else {
+            Section->Flags |= IMAGE_SECTION_NO_LARGE_PAGES;
+            MmpSplitLargePages(Section->VirtualAddress, Section->Size);
+        }
+
+        KeReleaseQueuedLock(Section->Lock);
+    }
+
+    MmReleaseAddressSpaceLock(AddressSpace);
+    return Status;
+}
+
 PVOID
 MmGetObjectForAddress (
     PVOID Address,
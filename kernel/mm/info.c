@@ -151,10 +151,28 @@ Return Value:
 
 {
 
+    UINTN Size;
     KSTATUS Status;
+    ULONG Version;
+
+    //
+    // Callers built against an older OS pass a smaller structure, which
+    // matches the version they set.
+    //
+
+    Size = sizeof(MM_STATISTICS);
+    if (*DataSize >= sizeof(ULONG)) {
+        Version = ((PMM_STATISTICS)Data)->Version;
+        if (Version < MM_STATISTICS_PHYSICAL_BLOCKS_VERSION) {
+            Size = MM_STATISTICS_V1_SIZE;
+
+        } else if (Version < MM_STATISTICS_LARGE_PAGES_VERSION) {
+            Size = MM_STATISTICS_V2_SIZE;
+        }
+    }
 
-    if (*DataSize != sizeof(MM_STATISTICS)) {
-        *DataSize = sizeof(MM_STATISTICS);
+    if (*DataSize != Size) {
+        *DataSize = Size;
         return STATUS_DATA_LENGTH_MISMATCH;
     }
 
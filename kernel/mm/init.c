@@ -257,6 +257,34 @@ Return Value:
             //
 
             MmpInitializePagedPool();
+
+            //
+            // Now that pool is available, move the physical page allocator
+            // over to its buddy bitmaps.
+            //
+
+            Status = MmpInitializeBuddyAllocator();
+            if (!KSUCCESS(Status)) {
+                goto InitializeEnd;
+            }
+        }
+
+        //
+        // Set up this processor's cache of small pool allocations.
+        //
+
+        Status = MmpInitializePoolCache();
+        if (!KSUCCESS(Status)) {
+            goto InitializeEnd;
+        }
+
+        //
+        // Set up this processor's cache of free physical pages.
+        //
+
+        Status = MmpInitializePhysicalPageCache();
+        if (!KSUCCESS(Status)) {
+            goto InitializeEnd;
         }
 
     //
@@ -52,6 +52,32 @@ Module Name:
 
 #define KERNEL_STACK_CACHE_SIZE 10
 
+//
+// Define the tag under which the per-processor pool cache holds its objects in
+// the underlying heaps. Cached objects keep this tag in the heap for their
+// whole lifetime, which is how a free distinguishes them from allocations
+// that came straight from the heap.
+//
+
+#define MM_POOL_CACHE_ALLOCATION_TAG 0x63506D4D // 'cPmM'
+
+//
+// Define the parameters of the per-processor pool cache. Each processor keeps
+// a magazine of free objects for every size class of each pool. Magazines are
+// refilled from and drained to the heap a batch at a time, so the pool lock
+// is only taken once per batch.
+//
+
+#define POOL_CACHE_TYPE_COUNT (PoolTypeCount - PoolTypeNonPaged)
+#define POOL_CACHE_CLASS_COUNT 15
+#define POOL_CACHE_GRANULARITY 16
+#define POOL_CACHE_MAX_SIZE 1024
+#define POOL_CACHE_MAX_REQUEST \
+    (POOL_CACHE_MAX_SIZE - sizeof(POOL_CACHE_TRAILER))
+
+#define POOL_MAGAZINE_SIZE 32
+#define POOL_MAGAZINE_BATCH (POOL_MAGAZINE_SIZE / 2)
+
 //
 // Do not collect pool tag statistics on non-debug builds.
 //
@@ -76,6 +102,113 @@ Module Name:
 
 #endif
 
+//
+// ------------------------------------------------------ Data Type Definitions
+//
+
+/*++
+
+Structure Description:
+
+    This structure defines the bookkeeping stored at the end of every object
+    handed out by the pool cache.
+
+Members:
+
+    Tag - Stores the tag of the current owner of the object, or the pool cache
+        tag if the object is sitting free in a magazine.
+
+    Class - Stores the size class the object belongs to.
+
+--*/
+
+typedef struct _POOL_CACHE_TRAILER {
+    ULONG Tag;
+    ULONG Class;
+} POOL_CACHE_TRAILER, *PPOOL_CACHE_TRAILER;
+
+/*++
+
+Structure Description:
+
+    This structure defines a magazine of free objects of a single size class.
+
+Members:
+
+    Count - Stores the number of valid objects in the magazine.
+
+    Objects - Stores the array of free objects.
+
+--*/
+
+typedef struct _POOL_MAGAZINE {
+    ULONG Count;
+    PVOID Objects[POOL_MAGAZINE_SIZE];
+} POOL_MAGAZINE, *PPOOL_MAGAZINE;
+
+/*++
+
+Structure Description:
+
+    This structure defines the per-processor statistics for one size class.
+
+Members:
+
+    Allocations - Stores the number of allocations satisfied by the class.
+
+    Frees - Stores the number of frees returned to the class.
+
+    Refills - Stores the number of times the magazine was found empty and had
+        to be refilled from the heap.
+
+    Drains - Stores the number of times the magazine was found full and had to
+        be partially drained back to the heap.
+
+--*/
+
+typedef struct _POOL_CACHE_CLASS_STATISTICS {
+    UINTN Allocations;
+    UINTN Frees;
+    UINTN Refills;
+    UINTN Drains;
+} POOL_CACHE_CLASS_STATISTICS, *PPOOL_CACHE_CLASS_STATISTICS;
+
+/*++
+
+Structure Description:
+
+    This structure defines one processor's cache for one pool type.
+
+Members:
+
+    Magazines - Stores the magazine of free objects for each size class.
+
+    Statistics - Stores the statistics for each size class.
+
+--*/
+
+typedef struct _POOL_CACHE {
+    POOL_MAGAZINE Magazines[POOL_CACHE_CLASS_COUNT];
+    POOL_CACHE_CLASS_STATISTICS Statistics[POOL_CACHE_CLASS_COUNT];
+} POOL_CACHE, *PPOOL_CACHE;
+
+/*++
+
+Structure Description:
+
+    This structure defines the pool cache hanging off of each processor block.
+
+Members:
+
+    Pools - Stores the cache for each pool type, indexed by pool type minus
+        the non-paged pool type.
+
+--*/
+
+typedef struct _PROCESSOR_POOL_CACHE {
+    POOL_CACHE Pools[POOL_CACHE_TYPE_COUNT];
+} PROCESSOR_POOL_CACHE, *PPROCESSOR_POOL_CACHE;
+
 //
 // ----------------------------------------------- Internal Function Prototypes
 //
@@ -115,9 +248,64 @@ MmpHandlePoolCorruption (
     PVOID Parameter
     );
 
-//
-// ------------------------------------------------------ Data Type Definitions
-//
+PVOID
+MmpAllocateFromPoolCache (
+    POOL_TYPE PoolType,
+    UINTN Size,
+    ULONG Tag
+    );
+
+BOOL
+MmpFreeToPoolCache (
+    POOL_TYPE PoolType,
+    PVOID Allocation
+    );
+
+PVOID
+MmpReallocatePoolCacheAllocation (
+    POOL_TYPE PoolType,
+    PVOID Memory,
+    UINTN OldSize,
+    UINTN NewSize,
+    ULONG Tag
+    );
+
+UINTN
+MmpGetPoolAllocationSize (
+    POOL_TYPE PoolType,
+    PVOID Memory,
+    PBOOL Cached
+    );
+
+ULONG
+MmpRefillPoolCache (
+    POOL_TYPE PoolType,
+    ULONG Class,
+    PVOID *Objects
+    );
+
+VOID
+MmpDrainPoolCache (
+    POOL_TYPE PoolType,
+    PVOID *Objects,
+    ULONG Count
+    );
+
+PPOOL_CACHE
+MmpGetCurrentPoolCache (
+    POOL_TYPE PoolType
+    );
+
+PPOOL_CACHE
+MmpGetProcessorPoolCache (
+    ULONG ProcessorNumber,
+    POOL_TYPE PoolType
+    );
+
+VOID
+MmpDebugPrintPoolCacheStatistics (
+    POOL_TYPE PoolType
+    );
 
 //
 // -------------------------------------------------------------------- Globals
@@ -144,6 +332,27 @@ KSPIN_LOCK MmFreeKernelStackLock;
 LIST_ENTRY MmFreeKernelStackList;
 ULONG MmFreeKernelStackCount;
 
+//
+// Store the state of the per-processor pool cache. The cache is enabled once
+// the boot processor's cache is set up. Until then, and on processors that
+// have not yet set up their cache, allocations go straight to the heaps. It
+// stays off entirely when the heaps collect tag statistics.
+//
+
+BOOL MmPoolCacheEnabled = FALSE;
+
+//
+// Store the usable size of each size class, including the trailer, and a
+// table that rounds a size up to its class in units of the cache granularity.
+//
+
+const USHORT MmPoolCacheClassSizes[POOL_CACHE_CLASS_COUNT] = {
+    32, 48, 64, 80, 96, 128, 160, 192, 256, 320, 384, 512, 640, 768, 1024
+};
+
+UCHAR MmPoolCacheSizeToClass[
+                        (POOL_CACHE_MAX_SIZE / POOL_CACHE_GRANULARITY) + 1];
+
 //
 // ------------------------------------------------------------------ Functions
 //
@@ -193,6 +402,19 @@ Return Value:
     RUNLEVEL OldRunLevel;
 
     ASSERT((Size != 0) && (Tag != 0) && (Tag != 0xFFFFFFFF));
+    ASSERT(Tag != MM_POOL_CACHE_ALLOCATION_TAG);
+
+    //
+    // Small allocations are served from the per-processor cache, which only
+    // has to go to the heap (and its lock) once per batch.
+    //
+
+    if ((Size <= POOL_CACHE_MAX_REQUEST) && (MmPoolCacheEnabled != FALSE)) {
+        Allocation = MmpAllocateFromPoolCache(PoolType, Size, Tag);
+        if (Allocation != NULL) {
+            return Allocation;
+        }
+    }
 
     if (PoolType == PoolTypeNonPaged) {
         OldRunLevel = KeRaiseRunLevel(RunLevelDispatch);
@@ -264,7 +486,34 @@ Return Value:
 
 {
 
+    BOOL Cached;
     RUNLEVEL OldRunLevel;
+    UINTN OldSize;
+
+    //
+    // Objects owned by the pool cache cannot be resized by the heap, and
+    // small results should come out of the cache. Handle both of those here.
+    //
+
+    if ((MmPoolCacheEnabled != FALSE) &&
+        ((PoolType == PoolTypeNonPaged) || (PoolType == PoolTypePaged))) {
+
+        Cached = FALSE;
+        OldSize = 0;
+        if (Memory != NULL) {
+            OldSize = MmpGetPoolAllocationSize(PoolType, Memory, &Cached);
+        }
+
+        if ((Cached != FALSE) ||
+            ((NewSize != 0) && (NewSize <= POOL_CACHE_MAX_REQUEST))) {
+
+            return MmpReallocatePoolCacheAllocation(PoolType,
+                                                    Memory,
+                                                    OldSize,
+                                                    NewSize,
+                                                    AllocationTag);
+        }
+    }
 
     if (PoolType == PoolTypeNonPaged) {
         OldRunLevel = KeRaiseRunLevel(RunLevelDispatch);
@@ -336,6 +585,17 @@ Return Value:
 
     RUNLEVEL OldRunLevel;
 
+    //
+    // Objects that belong to the pool cache go back to a magazine rather than
+    // to the heap.
+    //
+
+    if ((MmPoolCacheEnabled != FALSE) && (Allocation != NULL)) {
+        if (MmpFreeToPoolCache(PoolType, Allocation) != FALSE) {
+            return;
+        }
+    }
+
     if (PoolType == PoolTypeNonPaged) {
         OldRunLevel = KeRaiseRunLevel(RunLevelDispatch);
         KeAcquireSpinLock(&MmNonPagedPoolLock);
@@ -615,6 +875,13 @@ Return Value:
         KeReleaseQueuedLock(MmPagedPoolLock);
     }
 
+    if (MmPoolCacheEnabled != FALSE) {
+        RtlDebugPrint("\nNon-Paged Pool Cache:\n");
+        MmpDebugPrintPoolCacheStatistics(PoolTypeNonPaged);
+        RtlDebugPrint("\nPaged Pool Cache:\n");
+        MmpDebugPrintPoolCacheStatistics(PoolTypePaged);
+    }
+
     return;
 }
 
@@ -636,7 +903,8 @@ Routine Description:
         success. The caller should zero this buffer beforehand and set the
         version member to MM_STATISTICS_VERSION. Failure to zero the structure
         beforehand may result in uninitialized data when a driver built for a
-        newer OS is run on an older OS.
+        newer OS is run on an older OS. Older versions are accepted, and only
+        the members that version defines are filled in.
 
 Return Value:
 
@@ -648,7 +916,7 @@ Return Value:
 
     RUNLEVEL OldRunLevel;
 
-    if (Statistics->Version < MM_STATISTICS_VERSION) {
+    if (Statistics->Version == 0) {
         return STATUS_VERSION_MISMATCH;
     }
 
@@ -671,6 +939,12 @@ Return Value:
 
     KeReleaseQueuedLock(MmPagedPoolLock);
     MmpGetPhysicalPageStatistics(Statistics);
+    if (Statistics->Version >= MM_STATISTICS_LARGE_PAGES_VERSION) {
+        Statistics->LargePageAllocations = MmLargePageAllocations;
+        Statistics->LargePagePromotions = MmLargePagePromotions;
+        Statistics->LargePageSplits = MmLargePageSplits;
+    }
+
     return STATUS_SUCCESS;
 }
 
@@ -1007,6 +1281,92 @@ Return Value:
     return;
 }
 
+KSTATUS
+MmpInitializePoolCache (
+    VOID
+    )
+
+/*++
+
+Routine Description:
+
+    This routine initializes the pool cache for the current processor. The
+    non-paged pool must already be initialized.
+
+Arguments:
+
+    None.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    UINTN Class;
+    PPROCESSOR_POOL_CACHE PoolCache;
+    PPROCESSOR_BLOCK ProcessorBlock;
+    UINTN SizeIndex;
+
+    ProcessorBlock = KeGetCurrentProcessorBlock();
+
+    ASSERT(ProcessorBlock->PoolCache == NULL);
+
+    //
+    // Objects in the magazines are heap allocations under the cache's own
+    // tag, so the per-tag heap statistics and the pool profiler would charge
+    // every small allocation to the cache. Go straight to the heaps whenever
+    // they track tags, so leaks can still be found by tag.
+    //
+
+    if (((MmNonPagedPool.Flags | MmPagedPool.Flags) &
+         MEMORY_HEAP_FLAG_COLLECT_TAG_STATISTICS) != 0) {
+
+        return STATUS_SUCCESS;
+    }
+
+    PoolCache = MmAllocateNonPagedPool(sizeof(PROCESSOR_POOL_CACHE),
+                                       MM_ALLOCATION_TAG);
+
+    if (PoolCache == NULL) {
+        return STATUS_INSUFFICIENT_RESOURCES;
+    }
+
+    RtlZeroMemory(PoolCache, sizeof(PROCESSOR_POOL_CACHE));
+
+    //
+    // The boot processor builds the size class lookup table and enables the
+    // cache.
+    //
+
+    if (MmPoolCacheEnabled == FALSE) {
+        Class = 0;
+        for (SizeIndex = 0;
+             SizeIndex < sizeof(MmPoolCacheSizeToClass);
+             SizeIndex += 1) {
+
+            while ((SizeIndex * POOL_CACHE_GRANULARITY) >
+                   MmPoolCacheClassSizes[Class]) {
+
+                Class += 1;
+            }
+
+            MmPoolCacheSizeToClass[SizeIndex] = Class;
+        }
+
+        ProcessorBlock->PoolCache = PoolCache;
+        RtlMemoryBarrier();
+        MmPoolCacheEnabled = TRUE;
+
+    } else {
+        ProcessorBlock->PoolCache = PoolCache;
+    }
+
+    return STATUS_SUCCESS;
+}
+
 //
 // --------------------------------------------------------- Internal Functions
 //
@@ -1384,3 +1744,664 @@ Return Value:
     return;
 }
 
+PVOID
+MmpAllocateFromPoolCache (
+    POOL_TYPE PoolType,
+    UINTN Size,
+    ULONG Tag
+    )
+
+/*++
+
+Routine Description:
+
+    This routine allocates a small object from the current processor's pool
+    cache, refilling the magazine from the heap if it is empty.
+
+Arguments:
+
+    PoolType - Supplies the type of pool to allocate from.
+
+    Size - Supplies the size of the allocation, in bytes. This must not be
+        larger than the largest size class.
+
+    Tag - Supplies the tag to associate with the allocation.
+
+Return Value:
+
+    Returns the allocated memory on success.
+
+    NULL if the processor has no cache yet or the heap could not supply a
+    batch of objects. The caller should fall back to the heap.
+
+--*/
+
+{
+
+    PVOID Allocation;
+    PPOOL_CACHE Cache;
+    ULONG Class;
+    ULONG Count;
+    PPOOL_MAGAZINE Magazine;
+    PVOID Objects[POOL_MAGAZINE_BATCH];
+    RUNLEVEL OldRunLevel;
+    ULONG Space;
+    PPOOL_CACHE_TRAILER Trailer;
+    UINTN UsableSize;
+
+    if ((PoolType != PoolTypeNonPaged) && (PoolType != PoolTypePaged)) {
+        return NULL;
+    }
+
+    Size += sizeof(POOL_CACHE_TRAILER);
+    Class = MmPoolCacheSizeToClass[
+                (Size + POOL_CACHE_GRANULARITY - 1) / POOL_CACHE_GRANULARITY];
+
+    ASSERT(Size <= MmPoolCacheClassSizes[Class]);
+
+    //
+    // Try to pop an object off the current processor's magazine. Raising to
+    // dispatch keeps the thread on this processor, and since the magazine only
+    // holds pointers, paged objects are not touched at dispatch.
+    //
+
+    Allocation = NULL;
+    Count = 0;
+    OldRunLevel = KeRaiseRunLevel(RunLevelDispatch);
+    Cache = MmpGetCurrentPoolCache(PoolType);
+    if (Cache == NULL) {
+        KeLowerRunLevel(OldRunLevel);
+        return NULL;
+    }
+
+    Magazine = &(Cache->Magazines[Class]);
+    if (Magazine->Count != 0) {
+        Magazine->Count -= 1;
+        Allocation = Magazine->Objects[Magazine->Count];
+
+    //
+    // The magazine is empty. Refill a batch from the heap at the original
+    // runlevel (the heap may need to expand), and then stock whatever
+    // processor the thread ends up on with the remainder.
+    //
+
+    } else {
+        KeLowerRunLevel(OldRunLevel);
+        Count = MmpRefillPoolCache(PoolType, Class, Objects);
+        if (Count == 0) {
+            return NULL;
+        }
+
+        Count -= 1;
+        Allocation = Objects[Count];
+        OldRunLevel = KeRaiseRunLevel(RunLevelDispatch);
+        Cache = MmpGetCurrentPoolCache(PoolType);
+        if (Cache != NULL) {
+            Cache->Statistics[Class].Refills += 1;
+            Magazine = &(Cache->Magazines[Class]);
+            Space = POOL_MAGAZINE_SIZE - Magazine->Count;
+            while ((Count != 0) && (Space != 0)) {
+                Count -= 1;
+                Space -= 1;
+                Magazine->Objects[Magazine->Count] = Objects[Count];
+                Magazine->Count += 1;
+            }
+        }
+    }
+
+    if (Cache != NULL) {
+        Cache->Statistics[Class].Allocations += 1;
+    }
+
+    KeLowerRunLevel(OldRunLevel);
+
+    //
+    // Anything that did not fit (because the processor's magazine filled up
+    // in the meantime) goes back to the heap.
+    //
+
+    if (Count != 0) {
+        MmpDrainPoolCache(PoolType, Objects, Count);
+    }
+
+    //
+    // Stamp the owner's tag in the trailer, now that the object can be
+    // touched safely.
+    //
+
+    UsableSize = MmpGetPoolAllocationSize(PoolType, Allocation, NULL);
+    Trailer = Allocation + UsableSize;
+
+    ASSERT((Trailer->Tag == MM_POOL_CACHE_ALLOCATION_TAG) &&
+           (Trailer->Class == Class));
+
+    Trailer->Tag = Tag;
+    return Allocation;
+}
+
+BOOL
+MmpFreeToPoolCache (
+    POOL_TYPE PoolType,
+    PVOID Allocation
+    )
+
+/*++
+
+Routine Description:
+
+    This routine returns an object to the current processor's pool cache if it
+    was allocated from the pool cache. If the magazine is full, half of it is
+    drained back to the heap.
+
+Arguments:
+
+    PoolType - Supplies the type of pool the memory was allocated from.
+
+    Allocation - Supplies a pointer to the allocation to free.
+
+Return Value:
+
+    TRUE if the object belonged to the pool cache and has been freed.
+
+    FALSE if the object came directly from the heap, in which case the caller
+    should free it to the heap.
+
+--*/
+
+{
+
+    PPOOL_CACHE Cache;
+    BOOL Cached;
+    ULONG Class;
+    ULONG Count;
+    PPOOL_MAGAZINE Magazine;
+    PVOID Objects[POOL_MAGAZINE_BATCH];
+    RUNLEVEL OldRunLevel;
+    ULONG Tag;
+    PPOOL_CACHE_TRAILER Trailer;
+    UINTN UsableSize;
+
+    if ((PoolType != PoolTypeNonPaged) && (PoolType != PoolTypePaged)) {
+        return FALSE;
+    }
+
+    UsableSize = MmpGetPoolAllocationSize(PoolType, Allocation, &Cached);
+    if (Cached == FALSE) {
+        return FALSE;
+    }
+
+    Trailer = Allocation + UsableSize;
+    Tag = Trailer->Tag;
+    Class = Trailer->Class;
+    if ((Tag == MM_POOL_CACHE_ALLOCATION_TAG) ||
+        (Class >= POOL_CACHE_CLASS_COUNT)) {
+
+        if (PoolType == PoolTypeNonPaged) {
+            MmpHandlePoolCorruption(&MmNonPagedPool,
+                                    HeapCorruptionDoubleFree,
+                                    Allocation);
+
+        } else {
+            MmpHandlePoolCorruption(&MmPagedPool,
+                                    HeapCorruptionDoubleFree,
+                                    Allocation);
+        }
+
+        return TRUE;
+    }
+
+    Trailer->Tag = MM_POOL_CACHE_ALLOCATION_TAG;
+
+    //
+    // Push the object onto this processor's magazine. If the magazine is
+    // full, pull a batch off of it to release to the heap once back at the
+    // original runlevel.
+    //
+
+    Count = 0;
+    OldRunLevel = KeRaiseRunLevel(RunLevelDispatch);
+    Cache = MmpGetCurrentPoolCache(PoolType);
+    if (Cache == NULL) {
+        Objects[0] = Allocation;
+        Count = 1;
+
+    } else {
+        Magazine = &(Cache->Magazines[Class]);
+        if (Magazine->Count == POOL_MAGAZINE_SIZE) {
+            Cache->Statistics[Class].Drains += 1;
+            while (Count < POOL_MAGAZINE_BATCH) {
+                Magazine->Count -= 1;
+                Objects[Count] = Magazine->Objects[Magazine->Count];
+                Count += 1;
+            }
+        }
+
+        Magazine->Objects[Magazine->Count] = Allocation;
+        Magazine->Count += 1;
+        Cache->Statistics[Class].Frees += 1;
+    }
+
+    KeLowerRunLevel(OldRunLevel);
+    if (Count != 0) {
+        MmpDrainPoolCache(PoolType, Objects, Count);
+    }
+
+    return TRUE;
+}
+
+PVOID
+MmpReallocatePoolCacheAllocation (
+    POOL_TYPE PoolType,
+    PVOID Memory,
+    UINTN OldSize,
+    UINTN NewSize,
+    ULONG Tag
+    )
+
+/*++
+
+Routine Description:
+
+    This routine resizes an allocation when either the original allocation
+    belongs to the pool cache or the new size is small enough to come from
+    the pool cache.
+
+Arguments:
+
+    PoolType - Supplies the type of pool the memory was allocated from.
+
+    Memory - Supplies the original allocation, which may be NULL.
+
+    OldSize - Supplies the usable size of the original allocation.
+
+    NewSize - Supplies the new required size of the allocation. If this is 0,
+        the original allocation is freed.
+
+    Tag - Supplies an identifier for the allocation.
+
+Return Value:
+
+    Returns a pointer to a buffer with the new size and original contents on
+    success.
+
+    NULL on failure or if the new size was zero.
+
+--*/
+
+{
+
+    PVOID NewMemory;
+
+    if (NewSize == 0) {
+        MmFreePool(PoolType, Memory);
+        return NULL;
+    }
+
+    //
+    // If the original allocation is already big enough, just hand it back.
+    //
+
+    if ((Memory != NULL) && (NewSize <= OldSize)) {
+        return Memory;
+    }
+
+    NewMemory = MmAllocatePool(PoolType, NewSize, Tag);
+    if ((NewMemory != NULL) && (Memory != NULL)) {
+        if (OldSize > NewSize) {
+            OldSize = NewSize;
+        }
+
+        RtlCopyMemory(NewMemory, Memory, OldSize);
+        MmFreePool(PoolType, Memory);
+    }
+
+    return NewMemory;
+}
+
+UINTN
+MmpGetPoolAllocationSize (
+    POOL_TYPE PoolType,
+    PVOID Memory,
+    PBOOL Cached
+    )
+
+/*++
+
+Routine Description:
+
+    This routine determines the usable size of a pool allocation, and whether
+    or not it belongs to the pool cache.
+
+Arguments:
+
+    PoolType - Supplies the type of pool the memory was allocated from.
+
+    Memory - Supplies the allocation.
+
+    Cached - Supplies an optional pointer where a boolean will be returned
+        indicating whether the allocation is owned by the pool cache.
+
+Return Value:
+
+    Returns the number of bytes usable by the caller. For pool cache objects
+    this excludes the trailer.
+
+--*/
+
+{
+
+    PMEMORY_HEAP Heap;
+    UINTN HeapTag;
+    UINTN Size;
+
+    Heap = &MmNonPagedPool;
+    if (PoolType == PoolTypePaged) {
+        Heap = &MmPagedPool;
+    }
+
+    Size = RtlHeapGetAllocationSize(Heap, Memory, &HeapTag);
+    if (HeapTag == MM_POOL_CACHE_ALLOCATION_TAG) {
+        Size -= sizeof(POOL_CACHE_TRAILER);
+        if (Cached != NULL) {
+            *Cached = TRUE;
+        }
+
+    } else if (Cached != NULL) {
+        *Cached = FALSE;
+    }
+
+    return Size;
+}
+
+ULONG
+MmpRefillPoolCache (
+    POOL_TYPE PoolType,
+    ULONG Class,
+    PVOID *Objects
+    )
+
+/*++
+
+Routine Description:
+
+    This routine allocates a batch of objects for a pool cache size class from
+    the heap, acquiring the pool lock only once.
+
+Arguments:
+
+    PoolType - Supplies the type of pool to allocate from.
+
+    Class - Supplies the size class to allocate objects for.
+
+    Objects - Supplies an array of POOL_MAGAZINE_BATCH pointers where the new
+        objects are returned.
+
+Return Value:
+
+    Returns the number of objects allocated, which may be less than a full
+    batch if the heap is running low.
+
+--*/
+
+{
+
+    ULONG Count;
+    PMEMORY_HEAP Heap;
+    RUNLEVEL OldRunLevel;
+    UINTN Size;
+    PPOOL_CACHE_TRAILER Trailer;
+    UINTN UsableSize;
+
+    Size = MmPoolCacheClassSizes[Class];
+    if (PoolType == PoolTypeNonPaged) {
+        Heap = &MmNonPagedPool;
+        OldRunLevel = KeRaiseRunLevel(RunLevelDispatch);
+        KeAcquireSpinLock(&MmNonPagedPoolLock);
+        MmNonPagedPoolOldRunLevel = OldRunLevel;
+
+    } else {
+
+        ASSERT(KeGetRunLevel() == RunLevelLow);
+
+        Heap = &MmPagedPool;
+        if (MmPagedPoolLock != NULL) {
+            KeAcquireQueuedLock(MmPagedPoolLock);
+        }
+    }
+
+    for (Count = 0; Count < POOL_MAGAZINE_BATCH; Count += 1) {
+        Objects[Count] = RtlHeapAllocate(Heap,
+                                         Size,
+                                         MM_POOL_CACHE_ALLOCATION_TAG);
+
+        if (Objects[Count] == NULL) {
+            break;
+        }
+
+        UsableSize = RtlHeapGetAllocationSize(Heap, Objects[Count], NULL);
+
+        ASSERT(UsableSize >= Size);
+
+        Trailer = Objects[Count] + UsableSize - sizeof(POOL_CACHE_TRAILER);
+        Trailer->Tag = MM_POOL_CACHE_ALLOCATION_TAG;
+        Trailer->Class = Class;
+    }
+
+    if (PoolType == PoolTypeNonPaged) {
+        KeReleaseSpinLock(&MmNonPagedPoolLock);
+        KeLowerRunLevel(OldRunLevel);
+
+    } else if (MmPagedPoolLock != NULL) {
+        KeReleaseQueuedLock(MmPagedPoolLock);
+    }
+
+    return Count;
+}
+
+VOID
+MmpDrainPoolCache (
+    POOL_TYPE PoolType,
+    PVOID *Objects,
+    ULONG Count
+    )
+
+/*++
+
+Routine Description:
+
+    This routine releases a batch of pool cache objects back to the heap,
+    acquiring the pool lock only once.
+
+Arguments:
+
+    PoolType - Supplies the type of pool the objects belong to.
+
+    Objects - Supplies the array of objects to free.
+
+    Count - Supplies the number of objects in the array.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PMEMORY_HEAP Heap;
+    ULONG Index;
+    RUNLEVEL OldRunLevel;
+
+    if (PoolType == PoolTypeNonPaged) {
+        Heap = &MmNonPagedPool;
+        OldRunLevel = KeRaiseRunLevel(RunLevelDispatch);
+        KeAcquireSpinLock(&MmNonPagedPoolLock);
+        MmNonPagedPoolOldRunLevel = OldRunLevel;
+
+    } else {
+
+        ASSERT(KeGetRunLevel() == RunLevelLow);
+
+        Heap = &MmPagedPool;
+        if (MmPagedPoolLock != NULL) {
+            KeAcquireQueuedLock(MmPagedPoolLock);
+        }
+    }
+
+    for (Index = 0; Index < Count; Index += 1) {
+        RtlHeapFree(Heap, Objects[Index]);
+    }
+
+    if (PoolType == PoolTypeNonPaged) {
+        KeReleaseSpinLock(&MmNonPagedPoolLock);
+        KeLowerRunLevel(OldRunLevel);
+
+    } else if (MmPagedPoolLock != NULL) {
+        KeReleaseQueuedLock(MmPagedPoolLock);
+    }
+
+    return;
+}
+
+PPOOL_CACHE
+MmpGetCurrentPoolCache (
+    POOL_TYPE PoolType
+    )
+
+/*++
+
+Routine Description:
+
+    This routine returns the current processor's cache for the given pool
+    type. This routine must be called at dispatch level.
+
+Arguments:
+
+    PoolType - Supplies the pool type.
+
+Return Value:
+
+    Returns a pointer to the cache, or NULL if the current processor has not
+    set up its pool cache yet.
+
+--*/
+
+{
+
+    PPROCESSOR_POOL_CACHE PoolCache;
+
+    ASSERT(KeGetRunLevel() >= RunLevelDispatch);
+
+    PoolCache = KeGetCurrentProcessorBlock()->PoolCache;
+    if (PoolCache == NULL) {
+        return NULL;
+    }
+
+    return &(PoolCache->Pools[PoolType - PoolTypeNonPaged]);
+}
+
+PPOOL_CACHE
+MmpGetProcessorPoolCache (
+    ULONG ProcessorNumber,
+    POOL_TYPE PoolType
+    )
+
+/*++
+
+Routine Description:
+
+    This routine returns the given processor's cache for the given pool type.
+    The cache may be changing underneath the caller, so this is only suitable
+    for gathering statistics.
+
+Arguments:
+
+    ProcessorNumber - Supplies the number of the processor to query.
+
+    PoolType - Supplies the pool type.
+
+Return Value:
+
+    Returns a pointer to the cache, or NULL if the processor has not set up its
+    pool cache yet.
+
+--*/
+
+{
+
+    PPROCESSOR_POOL_CACHE PoolCache;
+
+    PoolCache = KeGetProcessorBlock(ProcessorNumber)->PoolCache;
+    if (PoolCache == NULL) {
+        return NULL;
+    }
+
+    return &(PoolCache->Pools[PoolType - PoolTypeNonPaged]);
+}
+
+VOID
+MmpDebugPrintPoolCacheStatistics (
+    POOL_TYPE PoolType
+    )
+
+/*++
+
+Routine Description:
+
+    This routine prints the pool cache statistics for the given pool type,
+    summed across all processors.
+
+Arguments:
+
+    PoolType - Supplies the pool type to print.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    UINTN Allocations;
+    PPOOL_CACHE Cache;
+    UINTN CachedCount;
+    ULONG Class;
+    UINTN Drains;
+    UINTN Frees;
+    ULONG Processor;
+    ULONG ProcessorCount;
+    UINTN Refills;
+
+    ProcessorCount = KeGetActiveProcessorCount();
+    RtlDebugPrint("Class Size   Allocs    Frees  Refills   Drains  Cached\n");
+    for (Class = 0; Class < POOL_CACHE_CLASS_COUNT; Class += 1) {
+        Allocations = 0;
+        Frees = 0;
+        Refills = 0;
+        Drains = 0;
+        CachedCount = 0;
+        for (Processor = 0; Processor < ProcessorCount; Processor += 1) {
+            Cache = MmpGetProcessorPoolCache(Processor, PoolType);
+            if (Cache == NULL) {
+                continue;
+            }
+
+            Allocations += Cache->Statistics[Class].Allocations;
+            Frees += Cache->Statistics[Class].Frees;
+            Refills += Cache->Statistics[Class].Refills;
+            Drains += Cache->Statistics[Class].Drains;
+            CachedCount += Cache->Magazines[Class].Count;
+        }
+
+        RtlDebugPrint("%10d %8I64d %8I64d %8I64d %8I64d %7I64d\n",
+                      MmPoolCacheClassSizes[Class],
+                      (ULONGLONG)Allocations,
+                      (ULONGLONG)Frees,
+                      (ULONGLONG)Refills,
+                      (ULONGLONG)Drains,
+                      (ULONGLONG)CachedCount);
+    }
+
+    return;
+}
@@ -1109,6 +1109,217 @@ Return Value:
     return Status;
 }
 
+INTN
+MmSysAdviseMemory (
+    PVOID SystemCallParameter
+    )
+
+/*++
+
+Routine Description:
+
+    This routine responds to system calls from user mode passing a hint about
+    the expected access pattern of a region of memory. Hints for regions
+    mapped from files are passed along to the page cache.
+
+Arguments:
+
+    SystemCallParameter - Supplies a pointer to the parameters supplied with
+        the system call. This structure will be a stack-local copy of the
+        actual parameters passed from user-mode.
+
+Return Value:
+
+    STATUS_SUCCESS or positive integer on success.
+
+    Error status code on failure.
+
+--*/
+
+{
+
+    PVOID AdviseRegionEnd;
+    PVOID AdviseRegionStart;
+    PADDRESS_SPACE AddressSpace;
+    UINTN AlignedSize;
+    PLIST_ENTRY CurrentEntry;
+    PIMAGE_SECTION CurrentSection;
+    PIO_HANDLE Handle;
+    BOOL LockHeld;
+    IO_OFFSET Offset;
+    UINTN OverlapSize;
+    PVOID OverlapStart;
+    UINTN PageSize;
+    BOOL LargePageAdvice;
+    PSYSTEM_CALL_ADVISE_MEMORY Parameters;
+    PKPROCESS Process;
+    PIMAGE_SECTION ReleaseSection;
+    PVOID SectionEnd;
+    PVOID SectionStart;
+    KSTATUS Status;
+    UINTN TotalAdviseSize;
+
+    PageSize = MmPageSize();
+    Parameters = (PSYSTEM_CALL_ADVISE_MEMORY)SystemCallParameter;
+    ReleaseSection = NULL;
+    if ((Parameters->Address == NULL) ||
+        (IS_ALIGNED((UINTN)Parameters->Address, PageSize) == FALSE) ||
+        (Parameters->Advice >= IoAdviceCount)) {
+
+        Status = STATUS_INVALID_PARAMETER;
+        goto SysAdviseMemoryEnd;
+    }
+
+    if (Parameters->Size == 0) {
+        Status = STATUS_SUCCESS;
+        goto SysAdviseMemoryEnd;
+    }
+
+    AlignedSize = ALIGN_RANGE_UP(Parameters->Size, PageSize);
+    if ((Parameters->Address + AlignedSize > USER_VA_END) ||
+        (Parameters->Address + AlignedSize <= Parameters->Address)) {
+
+        Status = STATUS_INVALID_ADDRESS_RANGE;
+        goto SysAdviseMemoryEnd;
+    }
+
+    //
+    // Loop over the current process' image sections, passing the hint along
+    // for any that overlap and are backed by a file. Access pattern hints for
+    // anonymous memory have no effect. Large page hints are not for the file
+    // system, and are applied to the anonymous sections once the range has
+    // been validated.
+    //
+
+    LargePageAdvice = FALSE;
+    if ((Parameters->Advice == IoAdviceLargePages) ||
+        (Parameters->Advice == IoAdviceNoLargePages)) {
+
+        LargePageAdvice = TRUE;
+    }
+
+    Status = STATUS_SUCCESS;
+    TotalAdviseSize = 0;
+    Process = PsGetCurrentProcess();
+    AddressSpace = Process->AddressSpace;
+    AdviseRegionStart = Parameters->Address;
+    AdviseRegionEnd = AdviseRegionStart + AlignedSize;
+    MmAcquireAddressSpaceLock(AddressSpace);
+    LockHeld = TRUE;
+    CurrentEntry = AddressSpace->SectionListHead.Next;
+    while (CurrentEntry != &(AddressSpace->SectionListHead)) {
+        CurrentSection = LIST_VALUE(CurrentEntry,
+                                    IMAGE_SECTION,
+                                    AddressListEntry);
+
+        SectionStart = CurrentSection->VirtualAddress;
+        SectionEnd = SectionStart + CurrentSection->Size;
+        if ((SectionStart >= AdviseRegionEnd) ||
+            (SectionEnd <= AdviseRegionStart)) {
+
+            CurrentEntry = CurrentEntry->Next;
+            continue;
+        }
+
+        OverlapStart = SectionStart;
+        if (SectionStart < AdviseRegionStart) {
+            OverlapStart = AdviseRegionStart;
+        }
+
+        if (SectionEnd < AdviseRegionEnd) {
+            OverlapSize = SectionEnd - OverlapStart;
+
+        } else {
+            OverlapSize = AdviseRegionEnd - OverlapStart;
+        }
+
+        TotalAdviseSize += OverlapSize;
+        if ((LargePageAdvice != FALSE) ||
+            ((CurrentSection->Flags & IMAGE_SECTION_BACKED) == 0) ||
+            (CurrentSection->ImageBacking.DeviceHandle == INVALID_HANDLE)) {
+
+            CurrentEntry = CurrentEntry->Next;
+            continue;
+        }
+
+        //
+        // Release the lock and pass the hint on for the overlapping portion of
+        // the backing file.
+        //
+
+        MmpImageSectionAddReference(CurrentSection);
+        MmReleaseAddressSpaceLock(AddressSpace);
+        LockHeld = FALSE;
+        if (ReleaseSection != NULL) {
+            MmpImageSectionReleaseReference(ReleaseSection);
+        }
+
+        ReleaseSection = CurrentSection;
+        Handle = CurrentSection->ImageBacking.DeviceHandle;
+        Offset = CurrentSection->ImageBacking.Offset +
+                 (OverlapStart - SectionStart);
+
+        Status = IoAdvise(Handle, Offset, OverlapSize, Parameters->Advice);
+
+        //
+        // Handles that do not support hints, like shared memory objects,
+        // are not an error for memory advice.
+        //
+
+        if (Status == STATUS_NOT_SUPPORTED) {
+            Status = STATUS_SUCCESS;
+        }
+
+        if (!KSUCCESS(Status)) {
+            goto SysAdviseMemoryEnd;
+        }
+
+        //
+        // Reacquire the lock and try to continue forward in the image section
+        // list. If the current image section was removed, restart from the
+        // beginning.
+        //
+
+        MmAcquireAddressSpaceLock(AddressSpace);
+        LockHeld = TRUE;
+        if (CurrentSection->AddressListEntry.Next == NULL) {
+            CurrentEntry = AddressSpace->SectionListHead.Next;
+            TotalAdviseSize = 0;
+
+        } else {
+            CurrentEntry = CurrentEntry->Next;
+        }
+    }
+
+    if (LockHeld != FALSE) {
+        MmReleaseAddressSpaceLock(AddressSpace);
+        LockHeld = FALSE;
+    }
+
+    //
+    // If some of the range was not mapped, report it, as with flushing.
+    //
+
+    if (TotalAdviseSize != AlignedSize) {
+        Status = STATUS_INVALID_ADDRESS_RANGE;
+        goto SysAdviseMemoryEnd;
+    }
+
+    if (LargePageAdvice != FALSE) {
+        Status = MmpChangeImageSectionRegionLargePages(
+                               AdviseRegionStart,
+                               AlignedSize,
+                               (Parameters->Advice == IoAdviceLargePages));
+    }
+
+SysAdviseMemoryEnd:
+    if (ReleaseSection != NULL) {
+        MmpImageSectionReleaseReference(ReleaseSection);
+    }
+
+    return Status;
+}
+
 INTN
 MmSysSetBreak (
     PVOID SystemCallParameter
@@ -390,6 +390,17 @@ extern PKEVENT MmPagingFreePagesEvent;
 
 extern KSPIN_LOCK MmInvalidateIpiLock;
 
+//
+// Store the shift of the large page size used for user mode anonymous memory,
+// or zero if the architecture does not support it. Also store counters of
+// large page activity.
+//
+
+extern ULONG MmLargePageShift;
+extern volatile UINTN MmLargePageAllocations;
+extern volatile UINTN MmLargePagePromotions;
+extern volatile UINTN MmLargePageSplits;
+
 //
 // Define cache line sizes for the CPU L1 caches.
 //
@@ -440,6 +451,51 @@ Return Value:
 
 --*/
 
+KSTATUS
+MmpInitializeBuddyAllocator (
+    VOID
+    );
+
+/*++
+
+Routine Description:
+
+    This routine builds the buddy allocator's free block bitmaps from the
+    current state of the physical page database and switches the physical page
+    allocator over to them. The non-paged pool must already be initialized.
+
+Arguments:
+
+    None.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+KSTATUS
+MmpInitializePhysicalPageCache (
+    VOID
+    );
+
+/*++
+
+Routine Description:
+
+    This routine initializes the current processor's cache of free physical
+    pages. If the buddy allocator is not online, the processor goes without.
+
+Arguments:
+
+    None.
+
+Return Value:
+
+    Status code.
+
+--*/
+
 VOID
 MmpGetPhysicalPageStatistics (
     PMM_STATISTICS Statistics
@@ -515,6 +571,33 @@ Return Value:
 
 --*/
 
+PHYSICAL_ADDRESS
+MmpAllocatePhysicalLargePage (
+    UINTN PageCount
+    );
+
+/*++
+
+Routine Description:
+
+    This routine attempts to allocate a naturally aligned run of physical pages
+    to back a large page mapping. Unlike other physical allocations, this
+    routine never waits for pages to be freed, as the caller can always fall
+    back to mapping individual pages. All allocated pages start out as
+    non-paged and must be made pagable.
+
+Arguments:
+
+    PageCount - Supplies the number of pages in a large page. This must be a
+        power of two.
+
+Return Value:
+
+    Returns the physical address of the first page of allocated memory on
+    success, or INVALID_PHYSICAL_ADDRESS if no suitable run is free right now.
+
+--*/
+
 PHYSICAL_ADDRESS
 MmpAllocateIdentityMappablePhysicalPages (
     UINTN PageCount,
@@ -1197,6 +1280,59 @@ Return Value:
 
 --*/
 
+BOOL
+MmpPromoteLargePage (
+    PVOID VirtualAddress
+    );
+
+/*++
+
+Routine Description:
+
+    This routine attempts to replace the page table covering the given region
+    of the current process with a single large page directory entry. This only
+    succeeds if every page in the region is mapped, the pages are physically
+    contiguous and large page aligned, and they all share the same attributes.
+    The caller must hold the lock of the image section covering the region.
+
+Arguments:
+
+    VirtualAddress - Supplies the large page aligned user mode virtual address
+        of the region to promote.
+
+Return Value:
+
+    TRUE if the region is now mapped with a large page.
+
+    FALSE if the region cannot be promoted.
+
+--*/
+
+VOID
+MmpSplitLargePages (
+    PVOID VirtualAddress,
+    UINTN Size
+    );
+
+/*++
+
+Routine Description:
+
+    This routine splits any large pages in the given region of the current
+    process back into individual page mappings.
+
+Arguments:
+
+    VirtualAddress - Supplies the user mode virtual address of the region.
+
+    Size - Supplies the size of the region, in bytes.
+
+Return Value:
+
+    None.
+
+--*/
+
 KSTATUS
 MmpAddAccountingDescriptor (
     PMEMORY_ACCOUNTING Accountant,
@@ -1710,6 +1846,37 @@ Return Value:
 
 --*/
 
+KSTATUS
+MmpChangeImageSectionRegionLargePages (
+    PVOID Address,
+    UINTN Size,
+    BOOL Allow
+    );
+
+/*++
+
+Routine Description:
+
+    This routine sets whether or not the anonymous memory in the given region
+    of the current process may be mapped with large pages. Opting a region out
+    breaks up any large pages already mapping it. Sections backed by files are
+    left alone.
+
+Arguments:
+
+    Address - Supplies the starting address of the region to change.
+
+    Size - Supplies the size of the region to change.
+
+    Allow - Supplies a boolean indicating whether to allow large pages (TRUE)
+        or prevent them (FALSE).
+
+Return Value:
+
+    Status code.
+
+--*/
+
 KSTATUS
 MmpFlushImageSectionRegion (
     PIMAGE_SECTION Section,
@@ -2137,6 +2304,28 @@ Return Value:
 
 --*/
 
+KSTATUS
+MmpInitializePoolCache (
+    VOID
+    );
+
+/*++
+
+Routine Description:
+
+    This routine initializes the pool cache for the current processor. The
+    non-paged pool must already be initialized.
+
+Arguments:
+
+    None.
+
+Return Value:
+
+    Status code.
+
+--*/
+
 VOID
 MmpSendTlbInvalidateIpi (
     PADDRESS_SPACE AddressSpace,
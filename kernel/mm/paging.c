@@ -248,6 +248,19 @@ MmpPageInAnonymousSection (
     PIO_BUFFER LockedIoBuffer
     );
 
+KSTATUS
+MmpPageInAnonymousLargePage (
+    PIMAGE_SECTION ImageSection,
+    UINTN PageOffset
+    );
+
+BOOL
+MmpCanMapLargePage (
+    PIMAGE_SECTION ImageSection,
+    PVOID VirtualAddress,
+    PVOID *RegionStart
+    );
+
 KSTATUS
 MmpPageInSharedSection (
     PIMAGE_SECTION ImageSection,
@@ -380,6 +393,21 @@ volatile UINTN MmPagingFreeTarget;
 
 PBLOCK_ALLOCATOR MmPagingEntryBlockAllocator;
 
+//
+// Store the shift of the large page size used for user mode anonymous memory.
+// The architecture sets this if it supports large pages.
+//
+
+ULONG MmLargePageShift = 0;
+
+//
+// Store counters of large page activity.
+//
+
+volatile UINTN MmLargePageAllocations;
+volatile UINTN MmLargePagePromotions;
+volatile UINTN MmLargePageSplits;
+
 //
 // ------------------------------------------------------------------ Functions
 //
@@ -2722,6 +2750,7 @@ Return Value:
     PIMAGE_SECTION OwningSection;
     ULONG PageShift;
     ULONG PageSize;
+    PVOID RegionStart;
     PIMAGE_SECTION RootSection;
     KSTATUS Status;
     PVOID VirtualAddress;
@@ -2731,6 +2760,18 @@ Return Value:
     ASSERT((ImageSection->Flags & IMAGE_SECTION_SHARED) == 0);
     ASSERT(ImageSection->ImageBacking.DeviceHandle == INVALID_HANDLE);
 
+    //
+    // Try to fault in the whole large page region around the page at once.
+    // Anything short of complete success falls back to a single page.
+    //
+
+    if ((MmLargePageShift != 0) && (LockedIoBuffer == NULL)) {
+        Status = MmpPageInAnonymousLargePage(ImageSection, PageOffset);
+        if (KSUCCESS(Status)) {
+            return Status;
+        }
+    }
+
     RtlZeroMemory(&Context, sizeof(PAGE_IN_CONTEXT));
 
     ASSERT(Context.PhysicalAddress == INVALID_PHYSICAL_ADDRESS);
@@ -3027,6 +3068,18 @@ Return Value:
 
                 Context.PagingEntry = NULL;
                 Context.PhysicalAddress = INVALID_PHYSICAL_ADDRESS;
+
+                //
+                // This page may have completed a large page region.
+                //
+
+                if ((MmLargePageShift != 0) &&
+                    (MmpCanMapLargePage(ImageSection,
+                                        VirtualAddress,
+                                        &RegionStart) != FALSE)) {
+
+                    MmpPromoteLargePage(RegionStart);
+                }
             }
         }
     }
@@ -3051,6 +3104,271 @@ Return Value:
     return Status;
 }
 
+KSTATUS
+MmpPageInAnonymousLargePage (
+    PIMAGE_SECTION ImageSection,
+    UINTN PageOffset
+    )
+
+/*++
+
+Routine Description:
+
+    This routine attempts to fault in the entire large page region containing
+    the given page of an anonymous section, backing it with a single block of
+    physical memory and mapping it with a large page. This only happens if none
+    of the region has been touched yet. This routine must be called at low
+    level.
+
+Arguments:
+
+    ImageSection - Supplies a pointer to the image section within the process
+        to page in.
+
+    PageOffset - Supplies the offset, in pages, from the beginning of the
+        section.
+
+Return Value:
+
+    STATUS_SUCCESS if the whole region was paged in.
+
+    Other error codes if the caller should page in the single page instead.
+
+--*/
+
+{
+
+    UINTN BitmapIndex;
+    ULONG BitmapMask;
+    UINTN LargePageCount;
+    BOOL LockHeld;
+    BOOL Mapped;
+    UINTN PageIndex;
+    ULONG PageShift;
+    PPAGING_ENTRY *PagingEntries;
+    PHYSICAL_ADDRESS PhysicalAddress;
+    UINTN RegionOffset;
+    PVOID RegionStart;
+    KSTATUS Status;
+    PVOID VirtualAddress;
+
+    ASSERT(KeGetRunLevel() == RunLevelLow);
+
+    LargePageCount = 0;
+    LockHeld = FALSE;
+    Mapped = FALSE;
+    PagingEntries = NULL;
+    PageShift = MmPageShift();
+    PhysicalAddress = INVALID_PHYSICAL_ADDRESS;
+    VirtualAddress = ImageSection->VirtualAddress + (PageOffset << PageShift);
+    if (MmpCanMapLargePage(ImageSection, VirtualAddress, &RegionStart) ==
+        FALSE) {
+
+        Status = STATUS_NOT_SUPPORTED;
+        goto PageInAnonymousLargePageEnd;
+    }
+
+    LargePageCount = (UINTN)1 << (MmLargePageShift - PageShift);
+    RegionOffset = (RegionStart - ImageSection->VirtualAddress) >> PageShift;
+
+    //
+    // Don't bother if part of the region is already in use. This is checked
+    // again with the lock held.
+    //
+
+    for (PageIndex = 0; PageIndex < LargePageCount; PageIndex += 1) {
+        VirtualAddress = RegionStart + (PageIndex << PageShift);
+        if (MmpVirtualToPhysical(VirtualAddress, NULL) !=
+            INVALID_PHYSICAL_ADDRESS) {
+
+            Status = STATUS_RESOURCE_IN_USE;
+            goto PageInAnonymousLargePageEnd;
+        }
+    }
+
+    PhysicalAddress = MmpAllocatePhysicalLargePage(LargePageCount);
+    if (PhysicalAddress == INVALID_PHYSICAL_ADDRESS) {
+        Status = STATUS_NO_MEMORY;
+        goto PageInAnonymousLargePageEnd;
+    }
+
+    PagingEntries = MmAllocateNonPagedPool(
+                                      LargePageCount * sizeof(PPAGING_ENTRY),
+                                      MM_ALLOCATION_TAG);
+
+    if (PagingEntries == NULL) {
+        Status = STATUS_INSUFFICIENT_RESOURCES;
+        goto PageInAnonymousLargePageEnd;
+    }
+
+    RtlZeroMemory(PagingEntries, LargePageCount * sizeof(PPAGING_ENTRY));
+    for (PageIndex = 0; PageIndex < LargePageCount; PageIndex += 1) {
+        PagingEntries[PageIndex] = MmpCreatePagingEntry(NULL, 0);
+        if (PagingEntries[PageIndex] == NULL) {
+            Status = STATUS_INSUFFICIENT_RESOURCES;
+            goto PageInAnonymousLargePageEnd;
+        }
+
+        MmpZeroPage(PhysicalAddress + (PageIndex << PageShift));
+    }
+
+    //
+    // Acquire the section lock and make sure nothing changed while the memory
+    // was being prepared: the section must still cover the region, nothing in
+    // the region can be mapped, and nothing can be sitting in the page file.
+    //
+
+    KeAcquireQueuedLock(ImageSection->Lock);
+    LockHeld = TRUE;
+    if (MmpCanMapLargePage(ImageSection, RegionStart, &RegionStart) ==
+        FALSE) {
+
+        Status = STATUS_TRY_AGAIN;
+        goto PageInAnonymousLargePageEnd;
+    }
+
+    for (PageIndex = 0; PageIndex < LargePageCount; PageIndex += 1) {
+        if (ImageSection->DirtyPageBitmap != NULL) {
+            BitmapIndex = IMAGE_SECTION_BITMAP_INDEX(RegionOffset + PageIndex);
+            BitmapMask = IMAGE_SECTION_BITMAP_MASK(RegionOffset + PageIndex);
+            if ((ImageSection->DirtyPageBitmap[BitmapIndex] & BitmapMask) !=
+                0) {
+
+                Status = STATUS_RESOURCE_IN_USE;
+                goto PageInAnonymousLargePageEnd;
+            }
+        }
+
+        VirtualAddress = RegionStart + (PageIndex << PageShift);
+        if (MmpVirtualToPhysical(VirtualAddress, NULL) !=
+            INVALID_PHYSICAL_ADDRESS) {
+
+            Status = STATUS_RESOURCE_IN_USE;
+            goto PageInAnonymousLargePageEnd;
+        }
+    }
+
+    //
+    // Map every page individually, make them all pageable in one go, and then
+    // swap the page table out for a large page.
+    //
+
+    for (PageIndex = 0; PageIndex < LargePageCount; PageIndex += 1) {
+        MmpModifySectionMapping(ImageSection,
+                                RegionOffset + PageIndex,
+                                PhysicalAddress + (PageIndex << PageShift),
+                                TRUE,
+                                NULL,
+                                FALSE);
+
+        MmpInitializePagingEntry(PagingEntries[PageIndex],
+                                 ImageSection,
+                                 RegionOffset + PageIndex);
+    }
+
+    MmpEnablePagingOnPhysicalAddress(PhysicalAddress,
+                                     LargePageCount,
+                                     PagingEntries,
+                                     FALSE);
+
+    Mapped = TRUE;
+    RtlAtomicAdd(&MmLargePageAllocations, 1);
+    MmpPromoteLargePage(RegionStart);
+    Status = STATUS_SUCCESS;
+
+PageInAnonymousLargePageEnd:
+    if (LockHeld != FALSE) {
+        KeReleaseQueuedLock(ImageSection->Lock);
+    }
+
+    if (Mapped == FALSE) {
+        if (PhysicalAddress != INVALID_PHYSICAL_ADDRESS) {
+            MmFreePhysicalPages(PhysicalAddress, LargePageCount);
+        }
+
+        if (PagingEntries != NULL) {
+            for (PageIndex = 0; PageIndex < LargePageCount; PageIndex += 1) {
+                if (PagingEntries[PageIndex] != NULL) {
+                    MmpDestroyPagingEntry(PagingEntries[PageIndex]);
+                }
+            }
+        }
+    }
+
+    if (PagingEntries != NULL) {
+        MmFreeNonPagedPool(PagingEntries);
+    }
+
+    return Status;
+}
+
+BOOL
+MmpCanMapLargePage (
+    PIMAGE_SECTION ImageSection,
+    PVOID VirtualAddress,
+    PVOID *RegionStart
+    )
+
+/*++
+
+Routine Description:
+
+    This routine determines whether the large page region containing the given
+    address may be mapped with a large page. Only private anonymous user mode
+    memory in the current process that has not been shared with a forked
+    process is eligible, and the section must cover the entire region.
+
+Arguments:
+
+    ImageSection - Supplies a pointer to the anonymous image section.
+
+    VirtualAddress - Supplies a virtual address within the section.
+
+    RegionStart - Supplies a pointer where the start of the large page region
+        containing the address is returned.
+
+Return Value:
+
+    TRUE if the region can be mapped with a large page.
+
+    FALSE otherwise.
+
+--*/
+
+{
+
+    UINTN LargePageSize;
+    ULONG SectionFlags;
+
+    if (MmLargePageShift == 0) {
+        return FALSE;
+    }
+
+    LargePageSize = (UINTN)1 << MmLargePageShift;
+    *RegionStart = ALIGN_POINTER_DOWN(VirtualAddress, LargePageSize);
+    SectionFlags = IMAGE_SECTION_NON_PAGED | IMAGE_SECTION_SHARED |
+                   IMAGE_SECTION_BACKED | IMAGE_SECTION_DESTROYED |
+                   IMAGE_SECTION_NO_LARGE_PAGES;
+
+    if (((ImageSection->Flags & SectionFlags) != 0) ||
+        (ImageSection->AddressSpace != PsGetCurrentProcess()->AddressSpace) ||
+        (ImageSection->Parent != NULL) ||
+        (LIST_EMPTY(&(ImageSection->ChildList)) == FALSE)) {
+
+        return FALSE;
+    }
+
+    if ((*RegionStart < ImageSection->VirtualAddress) ||
+        (*RegionStart + LargePageSize >
+         ImageSection->VirtualAddress + ImageSection->Size) ||
+        (*RegionStart + LargePageSize > USER_VA_END)) {
+
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
 KSTATUS
 MmpPageInSharedSection (
     PIMAGE_SECTION ImageSection,
@@ -101,6 +101,27 @@ Module Name:
 
 #define PAGING_EVENT_SIGNAL_PAGE_COUNT 0x10
 
+//
+// Define the number of block orders the buddy allocator keeps. The largest
+// block is 2^(PHYSICAL_BUDDY_ORDER_COUNT - 1) pages.
+//
+
+#define PHYSICAL_BUDDY_ORDER_COUNT MM_PHYSICAL_BLOCK_ORDER_COUNT
+
+//
+// Define the number of bits in each word of a free area bitmap.
+//
+
+#define PHYSICAL_BUDDY_BITMAP_BITS (sizeof(ULONG) * BITS_PER_BYTE)
+
+//
+// Define the number of free pages each processor keeps on hand, and how many
+// pages move between a processor's cache and the buddy allocator at once.
+//
+
+#define PHYSICAL_PAGE_CACHE_SIZE 64
+#define PHYSICAL_PAGE_CACHE_BATCH 16
+
 //
 // --------------------------------------------------------------------- Macros
 //
@@ -120,6 +141,31 @@ Module Name:
      ((_Type) == MemoryTypeFirmwareTemporary) ||                \
      ((_Type) == MemoryTypeBootPageTables))
 
+//
+// These macros test, set, and clear the bit for a block in a free area's
+// bitmap, given the block's index within the area.
+//
+
+#define PHYSICAL_BUDDY_TEST(_Area, _Index)                      \
+    (((_Area)->Bitmap[(_Index) / PHYSICAL_BUDDY_BITMAP_BITS] &  \
+      (1 << ((_Index) % PHYSICAL_BUDDY_BITMAP_BITS))) != 0)
+
+#define PHYSICAL_BUDDY_SET(_Area, _Index)                       \
+    ((_Area)->Bitmap[(_Index) / PHYSICAL_BUDDY_BITMAP_BITS] |=  \
+     (1 << ((_Index) % PHYSICAL_BUDDY_BITMAP_BITS)))
+
+#define PHYSICAL_BUDDY_CLEAR(_Area, _Index)                     \
+    ((_Area)->Bitmap[(_Index) / PHYSICAL_BUDDY_BITMAP_BITS] &=  \
+     ~(1 << ((_Index) % PHYSICAL_BUDDY_BITMAP_BITS)))
+
+//
+// This macro returns the index of the block of the given order containing the
+// given page within a free area.
+//
+
+#define PHYSICAL_BUDDY_INDEX(_Area, _Page, _Order) \
+    (((_Page) >> (_Order)) - (_Area)->FirstIndex)
+
 //
 // ------------------------------------------------------ Data Type Definitions
 //
@@ -162,6 +208,103 @@ typedef struct _PHYSICAL_PAGE {
 
 /*++
 
+Structure Description:
+
+    This structure stores the free blocks of a single order within a physical
+    memory segment.
+
+Members:
+
+    Bitmap - Stores a bitmap with one bit for each naturally aligned block of
+        this order in the segment. A set bit means the block is free and is
+        not part of a larger free block.
+
+    WordCount - Stores the number of words in the bitmap.
+
+    FirstIndex - Stores the block number of the first bit in the bitmap, which
+        is the segment's first page number shifted right by the order.
+
+    Hint - Stores the index of the first bitmap word that might have a bit
+        set. Words before the hint are all zero.
+
+    FreeCount - Stores the number of free blocks of this order.
+
+--*/
+
+typedef struct _PHYSICAL_FREE_AREA {
+    PULONG Bitmap;
+    UINTN WordCount;
+    UINTN FirstIndex;
+    UINTN Hint;
+    UINTN FreeCount;
+} PHYSICAL_FREE_AREA, *PPHYSICAL_FREE_AREA;
+
+/*++
+
+Structure Description:
+
+    This structure stores the buddy allocator state for one physical memory
+    segment. Blocks are aligned to their size in physical page numbers, and
+    never extend beyond the segment.
+
+Members:
+
+    StartPage - Stores the page number of the first page in the segment.
+
+    EndPage - Stores the page number one beyond the last page in the segment.
+
+    Areas - Stores the free blocks of each order.
+
+--*/
+
+typedef struct _PHYSICAL_BUDDY {
+    UINTN StartPage;
+    UINTN EndPage;
+    PHYSICAL_FREE_AREA Areas[PHYSICAL_BUDDY_ORDER_COUNT];
+} PHYSICAL_BUDDY, *PPHYSICAL_BUDDY;
+
+/*++
+
+Structure Description:
+
+    This structure stores a processor's cache of free physical pages. The
+    pages are counted as allocated and non-paged while they sit here. The
+    cache is a ring with a hot end and a cold end: pages freed on this
+    processor go in at the hot end and are handed out first, since they are
+    likely still in the processor's data cache. When the cache overflows,
+    pages leave from the cold end back to the buddy allocator.
+
+Members:
+
+    Lock - Stores the spin lock protecting the cache. Only the owning
+        processor takes it, except when memory is low and every processor's
+        cache is drained.
+
+    Head - Stores the index of the coldest page in the ring.
+
+    Count - Stores the number of pages in the ring.
+
+    Allocations - Stores the number of single page allocations made on this
+        processor.
+
+    Hits - Stores the number of single page allocations satisfied from the
+        cache.
+
+    Pages - Stores the ring of free physical pages.
+
+--*/
+
+typedef struct _PHYSICAL_PAGE_CACHE {
+    KSPIN_LOCK Lock;
+    UINTN Head;
+    UINTN Count;
+    ULONGLONG Allocations;
+    ULONGLONG Hits;
+    PHYSICAL_ADDRESS Pages[PHYSICAL_PAGE_CACHE_SIZE];
+} PHYSICAL_PAGE_CACHE, *PPHYSICAL_PAGE_CACHE;
+
+/*++
+
 Structure Description:
 
     This structure stores information about a physical segment of memory.
@@ -177,6 +320,9 @@ Structure Description:
 
     FreePages - Stores the number of unallocated pages in the segment.
 
+    Buddy - Stores a pointer to the segment's buddy allocator state. This is
+        NULL until the non-paged pool is up.
+
 --*/
 
 typedef struct _PHYSICAL_MEMORY_SEGMENT {
@@ -184,6 +330,7 @@ typedef struct _PHYSICAL_MEMORY_SEGMENT {
     PHYSICAL_ADDRESS StartAddress;
     PHYSICAL_ADDRESS EndAddress;
     volatile UINTN FreePages;
+    PPHYSICAL_BUDDY Buddy;
 } PHYSICAL_MEMORY_SEGMENT, *PPHYSICAL_MEMORY_SEGMENT;
 
 /*++
@@ -255,6 +402,99 @@ MmpWaitForFreePhysicalPages (
     PULONGLONG Timeout
     );
 
+PPHYSICAL_MEMORY_SEGMENT
+MmpFindPhysicalSegment (
+    PHYSICAL_ADDRESS PhysicalAddress
+    );
+
+VOID
+MmpClaimPhysicalPages (
+    PPHYSICAL_MEMORY_SEGMENT Segment,
+    UINTN Offset,
+    UINTN PageCount
+    );
+
+VOID
+MmpReleasePhysicalPages (
+    PPHYSICAL_MEMORY_SEGMENT Segment,
+    UINTN Offset,
+    UINTN PageCount
+    );
+
+PHYSICAL_ADDRESS
+MmpAllocateCachedPhysicalPage (
+    VOID
+    );
+
+BOOL
+MmpFreeToPhysicalPageCache (
+    PHYSICAL_ADDRESS PhysicalAddress
+    );
+
+UINTN
+MmpDrainPhysicalPageCaches (
+    VOID
+    );
+
+UINTN
+MmpAllocatePhysicalPageBatch (
+    PPHYSICAL_ADDRESS Pages,
+    UINTN PageCount
+    );
+
+VOID
+MmpFreePhysicalPageBatch (
+    PPHYSICAL_ADDRESS Pages,
+    UINTN PageCount,
+    BOOL LockHeld
+    );
+
+PHYSICAL_ADDRESS
+MmpAllocatePhysicalBlock (
+    UINTN PageCount,
+    ULONG Order
+    );
+
+BOOL
+MmpBuddyAllocate (
+    ULONG Order,
+    PPHYSICAL_MEMORY_SEGMENT *Segment,
+    PUINTN Page
+    );
+
+BOOL
+MmpBuddyRemoveBlock (
+    PPHYSICAL_BUDDY Buddy,
+    ULONG Order,
+    PUINTN Page
+    );
+
+VOID
+MmpBuddyInsertBlock (
+    PPHYSICAL_BUDDY Buddy,
+    UINTN Page,
+    ULONG Order
+    );
+
+VOID
+MmpBuddyInsertRange (
+    PPHYSICAL_BUDDY Buddy,
+    UINTN StartPage,
+    UINTN EndPage
+    );
+
+VOID
+MmpBuddyClaimRange (
+    PPHYSICAL_BUDDY Buddy,
+    UINTN StartPage,
+    UINTN EndPage
+    );
+
+VOID
+MmpRecordBlockAllocation (
+    ULONGLONG StartCycles
+    );
+
 //
 // -------------------------------------------------------------------- Globals
 //
@@ -375,6 +615,25 @@ UINTN MmPhysicalMemoryFreeCount;
 
 BOOL MmPhysicalPageZeroAvailable = FALSE;
 
+//
+// Store the buddy allocator state. The free block bitmaps come from the
+// non-paged pool, so until it is up allocations search the physical page
+// array directly. Once enabled, every transition of a page to or from the
+// free state goes through the buddy allocator, under the buddy lock and with
+// the physical page lock held at least shared.
+//
+
+BOOL MmPhysicalBuddyEnabled = FALSE;
+KSPIN_LOCK MmPhysicalBuddyLock;
+
+//
+// Store block allocation statistics, protected by the buddy lock.
+//
+
+ULONGLONG MmPhysicalBlockAllocations;
+ULONGLONG MmPhysicalBlockAllocationCycles;
+ULONGLONG MmPhysicalMaxBlockAllocationCycles;
+
 //
 // ------------------------------------------------------------------ Functions
 //
@@ -524,7 +783,10 @@ Return Value:
     PPAGING_ENTRY PagingEntry;
     LIST_ENTRY PagingEntryList;
     PPHYSICAL_PAGE PhysicalPage;
+    BOOL Released;
     UINTN ReleasedCount;
+    UINTN RunCount;
+    UINTN RunStart;
     PPHYSICAL_MEMORY_SEGMENT Segment;
     BOOL SignalEvent;
 
@@ -535,6 +797,8 @@ Return Value:
     PagingEntry = NULL;
     INITIALIZE_LIST_HEAD(&PagingEntryList);
     ReleasedCount = 0;
+    RunCount = 0;
+    RunStart = 0;
     SignalEvent = FALSE;
     if (MmPhysicalPageLock != NULL) {
         KeAcquireSharedExclusiveLockShared(MmPhysicalPageLock);
@@ -566,21 +830,23 @@ Return Value:
                Segment->EndAddress);
 
         //
-        // Release each page in the contiguous run.
+        // Release each page in the contiguous run. Pages that can be freed
+        // right away are gathered into runs and handed back together.
         //
 
         for (Index = 0; Index < PageCount; Index += 1) {
 
             ASSERT(PhysicalPage->U.Free != PHYSICAL_PAGE_FREE);
 
+            Released = FALSE;
+
             //
             // Directly mark non-paged physical pages as free.
             //
 
             if ((PhysicalPage->U.Flags & PHYSICAL_PAGE_FLAG_NON_PAGED) != 0) {
-                PhysicalPage->U.Free = PHYSICAL_PAGE_FREE;
                 NonPagedCount += 1;
-                ReleasedCount += 1;
+                Released = TRUE;
 
             //
             // For physical pages that might be paged, check the paging entry
@@ -597,8 +863,7 @@ Return Value:
                      PAGING_ENTRY_FLAG_PAGING_OUT) == 0) {
 
                     if (PagingEntry->U.LockCount == 0) {
-                        PhysicalPage->U.Free = PHYSICAL_PAGE_FREE;
-                        ReleasedCount += 1;
+                        Released = TRUE;
                         INSERT_BEFORE(&(PagingEntry->U.ListEntry),
                                       &PagingEntryList);
 
@@ -608,9 +873,55 @@ Return Value:
                 }
             }
 
+            if (Released != FALSE) {
+                ReleasedCount += 1;
+                if ((RunCount != 0) &&
+                    ((RunStart + RunCount) == (Offset + Index))) {
+
+                    RunCount += 1;
+
+                } else {
+                    if (RunCount != 0) {
+                        MmpReleasePhysicalPages(Segment, RunStart, RunCount);
+                    }
+
+                    RunStart = Offset + Index;
+                    RunCount = 1;
+                }
+            }
+
             PhysicalPage += 1;
         }
 
+        //
+        // A lone page goes to this processor's page cache if it has one. It
+        // stays counted as allocated and non-paged while it sits there. The
+        // page is marked non-paged before it goes in, since it may be handed
+        // out again as soon as it is in the cache.
+        //
+
+        if ((PageCount == 1) && (RunCount == 1) &&
+            (MmPhysicalBuddyEnabled != FALSE)) {
+
+            PhysicalPage -= 1;
+            PhysicalPage->U.Flags = PHYSICAL_PAGE_FLAG_NON_PAGED;
+            if (MmpFreeToPhysicalPageCache(PhysicalAddress) != FALSE) {
+                if (NonPagedCount == 0) {
+                    RtlAtomicAdd(&MmNonPagedPhysicalPages, 1);
+
+                } else {
+                    NonPagedCount = 0;
+                }
+
+                ReleasedCount = 0;
+                RunCount = 0;
+            }
+        }
+
+        if (RunCount != 0) {
+            MmpReleasePhysicalPages(Segment, RunStart, RunCount);
+        }
+
         RtlAtomicAdd(&MmNonPagedPhysicalPages, -NonPagedCount);
 
         //
@@ -618,7 +929,6 @@ Return Value:
         //
 
         if (ReleasedCount != 0) {
-            RtlAtomicAdd(&(Segment->FreePages), ReleasedCount);
             SignalEvent = MmpUpdatePhysicalMemoryStatistics(ReleasedCount,
                                                             FALSE);
         }
@@ -931,14 +1241,69 @@ Return Value:
 
 {
 
+    PPHYSICAL_PAGE_CACHE Cache;
+    PLIST_ENTRY CurrentEntry;
+    ULONG Order;
+    ULONG Processor;
+    ULONG ProcessorCount;
+    PPHYSICAL_MEMORY_SEGMENT Segment;
+
     Statistics->PhysicalPages = MmTotalPhysicalPages;
     Statistics->AllocatedPhysicalPages = MmTotalAllocatedPhysicalPages;
     Statistics->NonPagedPhysicalPages = MmNonPagedPhysicalPages;
+    if (Statistics->Version < MM_STATISTICS_PHYSICAL_BLOCKS_VERSION) {
+        return;
+    }
+
+    Statistics->CachedPhysicalPages = 0;
+    Statistics->PageAllocations = 0;
+    Statistics->PageCacheHits = 0;
+    for (Order = 0; Order < MM_PHYSICAL_BLOCK_ORDER_COUNT; Order += 1) {
+        Statistics->FreePhysicalBlocks[Order] = 0;
+    }
+
+    Statistics->BlockAllocations = MmPhysicalBlockAllocations;
+    Statistics->BlockAllocationCycles = MmPhysicalBlockAllocationCycles;
+    Statistics->MaxBlockAllocationCycles = MmPhysicalMaxBlockAllocationCycles;
+    if (MmPhysicalBuddyEnabled == FALSE) {
+        return;
+    }
+
+    //
+    // The counts are gathered without any locks, so they are only a snapshot.
+    //
+
+    CurrentEntry = MmPhysicalSegmentListHead.Next;
+    while (CurrentEntry != &MmPhysicalSegmentListHead) {
+        Segment = LIST_VALUE(CurrentEntry, PHYSICAL_MEMORY_SEGMENT, ListEntry);
+        CurrentEntry = CurrentEntry->Next;
+        if (Segment->Buddy == NULL) {
+            continue;
+        }
+
+        for (Order = 0; Order < PHYSICAL_BUDDY_ORDER_COUNT; Order += 1) {
+            Statistics->FreePhysicalBlocks[Order] +=
+                                   Segment->Buddy->Areas[Order].FreeCount;
+        }
+    }
+
+    ProcessorCount = KeGetActiveProcessorCount();
+    for (Processor = 0; Processor < ProcessorCount; Processor += 1) {
+        Cache = KeGetProcessorBlock(Processor)->PhysicalPageCache;
+        if (Cache == NULL) {
+            continue;
+        }
+
+        Statistics->CachedPhysicalPages += Cache->Count;
+        Statistics->PageAllocations += Cache->Allocations;
+        Statistics->PageCacheHits += Cache->Hits;
+    }
+
     return;
 }
 
-PHYSICAL_ADDRESS
-MmpAllocatePhysicalPage (
+KSTATUS
+MmpInitializeBuddyAllocator (
     VOID
     )
 
@@ -946,8 +1311,9 @@ MmpAllocatePhysicalPage (
 
 Routine Description:
 
-    This routine allocates a single physical page of memory. All allocated
-    pages start out as non-paged and must be made pagable.
+    This routine builds the buddy allocator's free block bitmaps from the
+    physical page array and switches the physical page allocator over to
+    them. The non-paged pool must be available.
 
 Arguments:
 
@@ -955,77 +1321,293 @@ Routine Description:
 
 Return Value:
 
-    Returns the physical address of the first page of allocated memory on
-    success, or INVALID_PHYSICAL_ADDRESS on failure.
+    Status code.
 
 --*/
 
 {
 
-    PHYSICAL_ADDRESS Allocation;
-    BOOL FirstIteration;
-    PPHYSICAL_MEMORY_SEGMENT LastSegment;
-    UINTN LastSegmentOffset;
-    UINTN Offset;
-    UINTN PageShift;
+    UINTN AllocationSize;
+    PULONG Bitmap;
+    PPHYSICAL_BUDDY Buddy;
+    PLIST_ENTRY CurrentEntry;
+    UINTN EndPage;
+    UINTN FreeStart;
+    ULONG Order;
+    UINTN Page;
+    ULONG PageShift;
     PPHYSICAL_PAGE PhysicalPage;
-    UINTN Previous;
     PPHYSICAL_MEMORY_SEGMENT Segment;
-    UINTN SegmentPageCount;
-    BOOL SignalEvent;
-    ULONGLONG Timeout;
+    UINTN StartPage;
+    KSTATUS Status;
+    UINTN WordCount;
 
-    ASSERT(KeGetRunLevel() == RunLevelLow);
+    ASSERT(MmPhysicalBuddyEnabled == FALSE);
 
+    KeInitializeSpinLock(&MmPhysicalBuddyLock);
     PageShift = MmPageShift();
-    SignalEvent = FALSE;
 
     //
-    // Loop continuously looking for free pages.
+    // Allocate the state for every segment first. These allocations may take
+    // physical pages, which is fine as long as the bitmaps are not filled in
+    // yet.
     //
 
-    Timeout = 0;
-    while (TRUE) {
-        if (MmPhysicalPageLock != NULL) {
-            KeAcquireSharedExclusiveLockShared(MmPhysicalPageLock);
+    CurrentEntry = MmPhysicalSegmentListHead.Next;
+    while (CurrentEntry != &MmPhysicalSegmentListHead) {
+        Segment = LIST_VALUE(CurrentEntry, PHYSICAL_MEMORY_SEGMENT, ListEntry);
+        CurrentEntry = CurrentEntry->Next;
+        StartPage = Segment->StartAddress >> PageShift;
+        EndPage = Segment->EndAddress >> PageShift;
+        if (StartPage == EndPage) {
+            continue;
         }
 
-        //
-        // Look directly for a single free physical page.
-        //
+        AllocationSize = sizeof(PHYSICAL_BUDDY);
+        for (Order = 0; Order < PHYSICAL_BUDDY_ORDER_COUNT; Order += 1) {
+            WordCount = (((EndPage - 1) >> Order) - (StartPage >> Order)) /
+                        PHYSICAL_BUDDY_BITMAP_BITS;
 
-        LastSegment = MmLastAllocatedSegment;
-        LastSegmentOffset = MmLastAllocatedSegmentOffset;
-        Offset = LastSegmentOffset;
-        Segment = LastSegment;
-        SegmentPageCount = (Segment->EndAddress - Segment->StartAddress) >>
-                           PageShift;
+            AllocationSize += (WordCount + 1) * sizeof(ULONG);
+        }
 
-        FirstIteration = TRUE;
-        do {
+        Buddy = MmAllocateNonPagedPool(AllocationSize, MM_ALLOCATION_TAG);
+        if (Buddy == NULL) {
+            Status = STATUS_INSUFFICIENT_RESOURCES;
+            goto InitializeBuddyAllocatorEnd;
+        }
 
-            //
-            // Check to see if it's time to advance to the next segment, either
-            // due to walking off of this one or there not being enough space
-            // left.
-            //
+        RtlZeroMemory(Buddy, AllocationSize);
+        Buddy->StartPage = StartPage;
+        Buddy->EndPage = EndPage;
+        Bitmap = (PULONG)(Buddy + 1);
+        for (Order = 0; Order < PHYSICAL_BUDDY_ORDER_COUNT; Order += 1) {
+            WordCount = (((EndPage - 1) >> Order) - (StartPage >> Order)) /
+                        PHYSICAL_BUDDY_BITMAP_BITS;
+
+            WordCount += 1;
+            Buddy->Areas[Order].Bitmap = Bitmap;
+            Buddy->Areas[Order].WordCount = WordCount;
+            Buddy->Areas[Order].FirstIndex = StartPage >> Order;
+            Bitmap += WordCount;
+        }
 
-            if ((Offset >= SegmentPageCount) || (Segment->FreePages == 0)) {
+        Segment->Buddy = Buddy;
+    }
 
-                //
-                // If this is the first segment searched, and the loop has been
-                // here before, then stop looking.
-                //
+    //
+    // Now fill in the bitmaps from the free runs in the page array and flip
+    // the switch. Nothing can change the page array while the lock is held
+    // exclusively.
+    //
 
-                if ((Segment == LastSegment) && (FirstIteration == FALSE)) {
-                    break;
-                }
+    if (MmPhysicalPageLock != NULL) {
+        KeAcquireSharedExclusiveLockExclusive(MmPhysicalPageLock);
+    }
 
-                FirstIteration = FALSE;
-                if (Segment->ListEntry.Next == &MmPhysicalSegmentListHead) {
-                    Segment = LIST_VALUE(MmPhysicalSegmentListHead.Next,
-                                         PHYSICAL_MEMORY_SEGMENT,
-                                         ListEntry);
+    CurrentEntry = MmPhysicalSegmentListHead.Next;
+    while (CurrentEntry != &MmPhysicalSegmentListHead) {
+        Segment = LIST_VALUE(CurrentEntry, PHYSICAL_MEMORY_SEGMENT, ListEntry);
+        CurrentEntry = CurrentEntry->Next;
+        Buddy = Segment->Buddy;
+        if (Buddy == NULL) {
+            continue;
+        }
+
+        PhysicalPage = (PPHYSICAL_PAGE)(Segment + 1);
+        Page = Buddy->StartPage;
+        while (Page < Buddy->EndPage) {
+            if (PhysicalPage->U.Free != PHYSICAL_PAGE_FREE) {
+                Page += 1;
+                PhysicalPage += 1;
+                continue;
+            }
+
+            FreeStart = Page;
+            while ((Page < Buddy->EndPage) &&
+                   (PhysicalPage->U.Free == PHYSICAL_PAGE_FREE)) {
+
+                Page += 1;
+                PhysicalPage += 1;
+            }
+
+            MmpBuddyInsertRange(Buddy, FreeStart, Page);
+        }
+    }
+
+    MmPhysicalBuddyEnabled = TRUE;
+    if (MmPhysicalPageLock != NULL) {
+        KeReleaseSharedExclusiveLockExclusive(MmPhysicalPageLock);
+    }
+
+    Status = STATUS_SUCCESS;
+
+InitializeBuddyAllocatorEnd:
+    if (!KSUCCESS(Status)) {
+        CurrentEntry = MmPhysicalSegmentListHead.Next;
+        while (CurrentEntry != &MmPhysicalSegmentListHead) {
+            Segment = LIST_VALUE(CurrentEntry,
+                                 PHYSICAL_MEMORY_SEGMENT,
+                                 ListEntry);
+
+            CurrentEntry = CurrentEntry->Next;
+            if (Segment->Buddy != NULL) {
+                MmFreeNonPagedPool(Segment->Buddy);
+                Segment->Buddy = NULL;
+            }
+        }
+    }
+
+    return Status;
+}
+
+KSTATUS
+MmpInitializePhysicalPageCache (
+    VOID
+    )
+
+/*++
+
+Routine Description:
+
+    This routine sets up the current processor's cache of free physical
+    pages. The processor goes without one if the buddy allocator is not
+    enabled.
+
+Arguments:
+
+    None.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    PPHYSICAL_PAGE_CACHE Cache;
+    PPROCESSOR_BLOCK ProcessorBlock;
+
+    if (MmPhysicalBuddyEnabled == FALSE) {
+        return STATUS_SUCCESS;
+    }
+
+    ProcessorBlock = KeGetCurrentProcessorBlock();
+
+    ASSERT(ProcessorBlock->PhysicalPageCache == NULL);
+
+    Cache = MmAllocateNonPagedPool(sizeof(PHYSICAL_PAGE_CACHE),
+                                   MM_ALLOCATION_TAG);
+
+    if (Cache == NULL) {
+        return STATUS_INSUFFICIENT_RESOURCES;
+    }
+
+    RtlZeroMemory(Cache, sizeof(PHYSICAL_PAGE_CACHE));
+    KeInitializeSpinLock(&(Cache->Lock));
+    ProcessorBlock->PhysicalPageCache = Cache;
+    return STATUS_SUCCESS;
+}
+
+PHYSICAL_ADDRESS
+MmpAllocatePhysicalPage (
+    VOID
+    )
+
+/*++
+
+Routine Description:
+
+    This routine allocates a single physical page of memory. All allocated
+    pages start out as non-paged and must be made pagable.
+
+Arguments:
+
+    None.
+
+Return Value:
+
+    Returns the physical address of the first page of allocated memory on
+    success, or INVALID_PHYSICAL_ADDRESS on failure.
+
+--*/
+
+{
+
+    PHYSICAL_ADDRESS Allocation;
+    BOOL FirstIteration;
+    PPHYSICAL_MEMORY_SEGMENT LastSegment;
+    UINTN LastSegmentOffset;
+    UINTN Offset;
+    UINTN PageShift;
+    PPHYSICAL_PAGE PhysicalPage;
+    UINTN Previous;
+    PPHYSICAL_MEMORY_SEGMENT Segment;
+    UINTN SegmentPageCount;
+    BOOL SignalEvent;
+    ULONGLONG Timeout;
+
+    ASSERT(KeGetRunLevel() == RunLevelLow);
+
+    //
+    // Once the buddy allocator is up, single pages come from the processor's
+    // page cache.
+    //
+
+    if (MmPhysicalBuddyEnabled != FALSE) {
+        return MmpAllocateCachedPhysicalPage();
+    }
+
+    PageShift = MmPageShift();
+    SignalEvent = FALSE;
+
+    //
+    // Loop continuously looking for free pages.
+    //
+
+    Timeout = 0;
+    while (TRUE) {
+        if (MmPhysicalPageLock != NULL) {
+            KeAcquireSharedExclusiveLockShared(MmPhysicalPageLock);
+        }
+
+        //
+        // Look directly for a single free physical page.
+        //
+
+        LastSegment = MmLastAllocatedSegment;
+        LastSegmentOffset = MmLastAllocatedSegmentOffset;
+        Offset = LastSegmentOffset;
+        Segment = LastSegment;
+        SegmentPageCount = (Segment->EndAddress - Segment->StartAddress) >>
+                           PageShift;
+
+        FirstIteration = TRUE;
+        do {
+
+            //
+            // Check to see if it's time to advance to the next segment, either
+            // due to walking off of this one or there not being enough space
+            // left.
+            //
+
+            if ((Offset >= SegmentPageCount) || (Segment->FreePages == 0)) {
+
+                //
+                // If this is the first segment searched, and the loop has been
+                // here before, then stop looking.
+                //
+
+                if ((Segment == LastSegment) && (FirstIteration == FALSE)) {
+                    break;
+                }
+
+                FirstIteration = FALSE;
+                if (Segment->ListEntry.Next == &MmPhysicalSegmentListHead) {
+                    Segment = LIST_VALUE(MmPhysicalSegmentListHead.Next,
+                                         PHYSICAL_MEMORY_SEGMENT,
+                                         ListEntry);
 
                 } else {
                     Segment = LIST_VALUE(Segment->ListEntry.Next,
@@ -1138,10 +1720,10 @@ Return Value:
 
 {
 
+    UINTN BlockSize;
     BOOL LockHeld;
-    UINTN PageIndex;
+    ULONG Order;
     ULONG PageShift;
-    PPHYSICAL_PAGE PhysicalPage;
     PPHYSICAL_MEMORY_SEGMENT Segment;
     UINTN SegmentOffset;
     BOOL SignalEvent;
@@ -1159,16 +1741,53 @@ Return Value:
     LockHeld = FALSE;
     PageShift = MmPageShift();
     SignalEvent = FALSE;
+    Timeout = 0;
     WorkingAllocation = INVALID_PHYSICAL_ADDRESS;
     if (Alignment == 0) {
         Alignment = 1;
     }
 
+    //
+    // Requests that fit in the largest buddy block come straight from the
+    // buddy allocator. A block is naturally aligned to its size, so the
+    // block just has to be as big as the alignment. If the buddy allocator
+    // comes up empty, pull back the pages sitting in the processor caches,
+    // as they may complete a block. A block rounds the request up to a power
+    // of two, so failing that, fall back to scanning for a run of exactly the
+    // requested size before resorting to paging.
+    //
+
+    if (MmPhysicalBuddyEnabled != FALSE) {
+        BlockSize = PageCount;
+        if (BlockSize < Alignment) {
+            BlockSize = Alignment;
+        }
+
+        Order = 0;
+        while ((Order < PHYSICAL_BUDDY_ORDER_COUNT) &&
+               (((UINTN)1 << Order) < BlockSize)) {
+
+            Order += 1;
+        }
+
+        if (Order < PHYSICAL_BUDDY_ORDER_COUNT) {
+            WorkingAllocation = MmpAllocatePhysicalBlock(PageCount, Order);
+            if ((WorkingAllocation == INVALID_PHYSICAL_ADDRESS) &&
+                (MmpDrainPhysicalPageCaches() != 0)) {
+
+                WorkingAllocation = MmpAllocatePhysicalBlock(PageCount, Order);
+            }
+
+            if (WorkingAllocation != INVALID_PHYSICAL_ADDRESS) {
+                return WorkingAllocation;
+            }
+        }
+    }
+
     //
     // Loop continuously looking for free pages.
     //
 
-    Timeout = 0;
     while (TRUE) {
         if (MmPhysicalPageLock != NULL) {
             KeAcquireSharedExclusiveLockExclusive(MmPhysicalPageLock);
@@ -1193,17 +1812,7 @@ Return Value:
             WorkingAllocation = Segment->StartAddress +
                                 (SegmentOffset << PageShift);
 
-            PhysicalPage = (PPHYSICAL_PAGE)(Segment + 1);
-            PhysicalPage += SegmentOffset;
-            for (PageIndex = 0; PageIndex < PageCount; PageIndex += 1) {
-
-                ASSERT(PhysicalPage->U.Free == PHYSICAL_PAGE_FREE);
-
-                PhysicalPage->U.Flags = PHYSICAL_PAGE_FLAG_NON_PAGED;
-                PhysicalPage += 1;
-            }
-
-            RtlAtomicAdd(&(Segment->FreePages), -PageCount);
+            MmpClaimPhysicalPages(Segment, SegmentOffset, PageCount);
             SignalEvent = MmpUpdatePhysicalMemoryStatistics(PageCount, TRUE);
             goto AllocatePhysicalPagesEnd;
         }
@@ -1218,6 +1827,17 @@ Return Value:
             LockHeld = FALSE;
         }
 
+        //
+        // Pages parked in the processor caches are not free in the page
+        // array, so pull them back and scan again before waiting.
+        //
+
+        if ((MmPhysicalBuddyEnabled != FALSE) &&
+            (MmpDrainPhysicalPageCaches() != 0)) {
+
+            continue;
+        }
+
         MmpWaitForFreePhysicalPages(PageCount + Alignment, &Timeout);
     }
 
@@ -1246,6 +1866,68 @@ Return Value:
     return WorkingAllocation;
 }
 
+PHYSICAL_ADDRESS
+MmpAllocatePhysicalLargePage (
+    UINTN PageCount
+    )
+
+/*++
+
+Routine Description:
+
+    This routine attempts to allocate a naturally aligned run of physical pages
+    to back a large page mapping. Unlike other physical allocations, this
+    routine never waits for pages to be freed, as the caller can always fall
+    back to mapping individual pages. All allocated pages start out as
+    non-paged and must be made pagable.
+
+Arguments:
+
+    PageCount - Supplies the number of pages in a large page. This must be a
+        power of two.
+
+Return Value:
+
+    Returns the physical address of the first page of allocated memory on
+    success, or INVALID_PHYSICAL_ADDRESS if no suitable run is free right now.
+
+--*/
+
+{
+
+    PHYSICAL_ADDRESS Allocation;
+    ULONG Order;
+
+    ASSERT(KeGetRunLevel() == RunLevelLow);
+    ASSERT(POWER_OF_2(PageCount) != FALSE);
+
+    //
+    // Don't break up large blocks once memory is getting tight. The pages are
+    // better spent elsewhere.
+    //
+
+    if ((MmPhysicalBuddyEnabled == FALSE) ||
+        (MmPhysicalMemoryWarningLevel != MemoryWarningLevelNone)) {
+
+        return INVALID_PHYSICAL_ADDRESS;
+    }
+
+    Order = RtlCountTrailingZeros(PageCount);
+    if (Order >= PHYSICAL_BUDDY_ORDER_COUNT) {
+        return INVALID_PHYSICAL_ADDRESS;
+    }
+
+    //
+    // Don't drain the processor page caches on failure. This is called on
+    // every large page fault, and the caller falls back to small pages
+    // cheaply, whereas a drain takes every processor's cache lock and empties
+    // the caches the small page path is about to need.
+    //
+
+    Allocation = MmpAllocatePhysicalBlock(PageCount, Order);
+    return Allocation;
+}
+
 PHYSICAL_ADDRESS
 MmpAllocateIdentityMappablePhysicalPages (
     UINTN PageCount,
@@ -1277,9 +1959,7 @@ Return Value:
 
 {
 
-    UINTN PageIndex;
     ULONG PageShift;
-    PPHYSICAL_PAGE PhysicalPage;
     PPHYSICAL_MEMORY_SEGMENT Segment;
     UINTN SegmentOffset;
     PHYSICAL_ADDRESS WorkingAllocation;
@@ -1310,21 +1990,11 @@ Return Value:
     }
 
     if (WorkingAllocation != INVALID_PHYSICAL_ADDRESS) {
-        PhysicalPage = (PPHYSICAL_PAGE)(Segment + 1);
-        PhysicalPage += SegmentOffset;
-        for (PageIndex = 0; PageIndex < PageCount; PageIndex += 1) {
-
-            ASSERT(PhysicalPage->U.Free == PHYSICAL_PAGE_FREE);
-
-            RtlAtomicAdd(&(Segment->FreePages), -1);
-            RtlAtomicAdd(&MmTotalAllocatedPhysicalPages, 1);
-            RtlAtomicAdd(&MmNonPagedPhysicalPages, 1);
-
-            ASSERT(MmTotalAllocatedPhysicalPages <= MmTotalPhysicalPages);
+        MmpClaimPhysicalPages(Segment, SegmentOffset, PageCount);
+        RtlAtomicAdd(&MmTotalAllocatedPhysicalPages, PageCount);
+        RtlAtomicAdd(&MmNonPagedPhysicalPages, PageCount);
 
-            PhysicalPage->U.Flags = PHYSICAL_PAGE_FLAG_NON_PAGED;
-            PhysicalPage += 1;
-        }
+        ASSERT(MmTotalAllocatedPhysicalPages <= MmTotalPhysicalPages);
     }
 
     if (MmPhysicalPageLock != NULL) {
@@ -1468,13 +2138,10 @@ Return Value:
         PhysicalPage = (PPHYSICAL_PAGE)(Segment + 1);
         while ((Offset < EndOffset) && (Segment->FreePages != 0)) {
             if (PhysicalPage[Offset].U.Free == PHYSICAL_PAGE_FREE) {
-                PhysicalPage[Offset].U.Flags = PHYSICAL_PAGE_FLAG_NON_PAGED;
+                MmpClaimPhysicalPages(Segment, Offset, 1);
                 Pages[PageIndex] = Segment->StartAddress +
                                    (Offset << PageShift);
 
-                ASSERT(Segment->FreePages != 0);
-
-                RtlAtomicAdd(&(Segment->FreePages), -1);
                 PageIndex += 1;
                 if (PageIndex == PageCount) {
                     MmLastAllocatedSegment = Segment;
@@ -1958,7 +2625,7 @@ Return Value:
             if (PreviousLockCount == 1) {
                 RtlAtomicAdd(&MmNonPagedPhysicalPages, -1);
                 if ((PagingEntry->U.Flags & PAGING_ENTRY_FLAG_FREED) != 0) {
-                    PhysicalPage[PageIndex].U.Free = PHYSICAL_PAGE_FREE;
+                    MmpReleasePhysicalPages(Segment, Offset + PageIndex, 1);
                     ReleasedCount += 1;
                     INSERT_BEFORE(&(PagingEntry->U.ListEntry),
                                   &PagingEntryList);
@@ -1967,7 +2634,6 @@ Return Value:
         }
 
         if (ReleasedCount != 0) {
-            RtlAtomicAdd(&(Segment->FreePages), ReleasedCount);
             SignalEvent = MmpUpdatePhysicalMemoryStatistics(ReleasedCount,
                                                             FALSE);
         }
@@ -2978,6 +3644,7 @@ Return Value:
             CurrentSegment->StartAddress = BaseAddress;
             CurrentSegment->EndAddress = CurrentSegment->StartAddress;
             CurrentSegment->FreePages = 0;
+            CurrentSegment->Buddy = NULL;
             MemoryContext->CurrentSegment = CurrentSegment;
             MemoryContext->CurrentPage = (PPHYSICAL_PAGE)(CurrentSegment + 1);
         }
@@ -3291,3 +3958,1054 @@ Return Value:
     return;
 }
 
+
+PPHYSICAL_MEMORY_SEGMENT
+MmpFindPhysicalSegment (
+    PHYSICAL_ADDRESS PhysicalAddress
+    )
+
+/*++
+
+Routine Description:
+
+    This routine finds the physical memory segment containing the given
+    address. The segment list never changes after initialization, so no lock
+    is needed.
+
+Arguments:
+
+    PhysicalAddress - Supplies the physical address to look up.
+
+Return Value:
+
+    Returns a pointer to the segment containing the address, or NULL if the
+    address is not in any segment.
+
+--*/
+
+{
+
+    PLIST_ENTRY CurrentEntry;
+    PPHYSICAL_MEMORY_SEGMENT Segment;
+
+    CurrentEntry = MmPhysicalSegmentListHead.Next;
+    while (CurrentEntry != &MmPhysicalSegmentListHead) {
+        Segment = LIST_VALUE(CurrentEntry, PHYSICAL_MEMORY_SEGMENT, ListEntry);
+        if ((PhysicalAddress >= Segment->StartAddress) &&
+            (PhysicalAddress < Segment->EndAddress)) {
+
+            return Segment;
+        }
+
+        CurrentEntry = CurrentEntry->Next;
+    }
+
+    return NULL;
+}
+
+VOID
+MmpClaimPhysicalPages (
+    PPHYSICAL_MEMORY_SEGMENT Segment,
+    UINTN Offset,
+    UINTN PageCount
+    )
+
+/*++
+
+Routine Description:
+
+    This routine marks a run of free pages found by searching the physical
+    page array as allocated and non-paged, and takes them out of the buddy
+    allocator if it is enabled. The caller must hold the physical page lock
+    exclusively and is responsible for the allocation statistics.
+
+Arguments:
+
+    Segment - Supplies a pointer to the segment containing the pages.
+
+    Offset - Supplies the page offset of the run within the segment.
+
+    PageCount - Supplies the number of pages in the run.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    UINTN Index;
+    RUNLEVEL OldRunLevel;
+    PPHYSICAL_PAGE PhysicalPage;
+    UINTN StartPage;
+
+    PhysicalPage = (PPHYSICAL_PAGE)(Segment + 1);
+    PhysicalPage += Offset;
+    for (Index = 0; Index < PageCount; Index += 1) {
+
+        ASSERT(PhysicalPage->U.Free == PHYSICAL_PAGE_FREE);
+
+        PhysicalPage->U.Flags = PHYSICAL_PAGE_FLAG_NON_PAGED;
+        PhysicalPage += 1;
+    }
+
+    ASSERT(Segment->FreePages >= PageCount);
+
+    RtlAtomicAdd(&(Segment->FreePages), -PageCount);
+    if (MmPhysicalBuddyEnabled != FALSE) {
+        StartPage = Segment->Buddy->StartPage + Offset;
+        OldRunLevel = KeRaiseRunLevel(RunLevelDispatch);
+        KeAcquireSpinLock(&MmPhysicalBuddyLock);
+        MmpBuddyClaimRange(Segment->Buddy, StartPage, StartPage + PageCount);
+        KeReleaseSpinLock(&MmPhysicalBuddyLock);
+        KeLowerRunLevel(OldRunLevel);
+    }
+
+    return;
+}
+
+VOID
+MmpReleasePhysicalPages (
+    PPHYSICAL_MEMORY_SEGMENT Segment,
+    UINTN Offset,
+    UINTN PageCount
+    )
+
+/*++
+
+Routine Description:
+
+    This routine marks a run of allocated pages as free and hands them to the
+    buddy allocator if it is enabled. The caller must hold the physical page
+    lock at least shared and is responsible for the allocation statistics.
+
+Arguments:
+
+    Segment - Supplies a pointer to the segment containing the pages.
+
+    Offset - Supplies the page offset of the run within the segment.
+
+    PageCount - Supplies the number of pages in the run.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    UINTN Index;
+    RUNLEVEL OldRunLevel;
+    PPHYSICAL_PAGE PhysicalPage;
+    UINTN StartPage;
+
+    PhysicalPage = (PPHYSICAL_PAGE)(Segment + 1);
+    PhysicalPage += Offset;
+    for (Index = 0; Index < PageCount; Index += 1) {
+
+        ASSERT(PhysicalPage->U.Free != PHYSICAL_PAGE_FREE);
+
+        PhysicalPage->U.Free = PHYSICAL_PAGE_FREE;
+        PhysicalPage += 1;
+    }
+
+    RtlAtomicAdd(&(Segment->FreePages), PageCount);
+    if (MmPhysicalBuddyEnabled != FALSE) {
+        StartPage = Segment->Buddy->StartPage + Offset;
+        OldRunLevel = KeRaiseRunLevel(RunLevelDispatch);
+        KeAcquireSpinLock(&MmPhysicalBuddyLock);
+        MmpBuddyInsertRange(Segment->Buddy, StartPage, StartPage + PageCount);
+        KeReleaseSpinLock(&MmPhysicalBuddyLock);
+        KeLowerRunLevel(OldRunLevel);
+    }
+
+    return;
+}
+
+PHYSICAL_ADDRESS
+MmpAllocateCachedPhysicalPage (
+    VOID
+    )
+
+/*++
+
+Routine Description:
+
+    This routine allocates a single physical page from the current
+    processor's page cache, refilling the cache from the buddy allocator if it
+    is empty.
+
+Arguments:
+
+    None.
+
+Return Value:
+
+    Returns the physical address of the allocated page. This routine waits
+    for memory rather than failing.
+
+--*/
+
+{
+
+    PHYSICAL_ADDRESS Allocation;
+    PPHYSICAL_PAGE_CACHE Cache;
+    UINTN Count;
+    RUNLEVEL OldRunLevel;
+    PHYSICAL_ADDRESS Pages[PHYSICAL_PAGE_CACHE_BATCH];
+    ULONGLONG Timeout;
+
+    ASSERT(KeGetRunLevel() == RunLevelLow);
+
+    Allocation = INVALID_PHYSICAL_ADDRESS;
+    OldRunLevel = KeRaiseRunLevel(RunLevelDispatch);
+    Cache = KeGetCurrentProcessorBlock()->PhysicalPageCache;
+    if (Cache != NULL) {
+        KeAcquireSpinLock(&(Cache->Lock));
+        Cache->Allocations += 1;
+        if (Cache->Count != 0) {
+            Cache->Count -= 1;
+            Allocation = Cache->Pages[(Cache->Head + Cache->Count) %
+                                      PHYSICAL_PAGE_CACHE_SIZE];
+
+            Cache->Hits += 1;
+        }
+
+        KeReleaseSpinLock(&(Cache->Lock));
+    }
+
+    KeLowerRunLevel(OldRunLevel);
+    if (Allocation != INVALID_PHYSICAL_ADDRESS) {
+        return Allocation;
+    }
+
+    //
+    // The cache is empty, so grab a batch from the buddy allocator. If that
+    // comes up empty too, pull back the pages sitting in every processor's
+    // cache before waiting on paging.
+    //
+
+    Timeout = 0;
+    while (TRUE) {
+        Count = MmpAllocatePhysicalPageBatch(Pages, PHYSICAL_PAGE_CACHE_BATCH);
+        if (Count != 0) {
+            break;
+        }
+
+        if (MmpDrainPhysicalPageCaches() == 0) {
+            MmpWaitForFreePhysicalPages(1, &Timeout);
+        }
+    }
+
+    //
+    // Keep one page and stock the cache with the rest. The thread may have
+    // moved to a different processor; that's fine, the rest go to whichever
+    // processor it is on now.
+    //
+
+    Count -= 1;
+    Allocation = Pages[Count];
+    OldRunLevel = KeRaiseRunLevel(RunLevelDispatch);
+    Cache = KeGetCurrentProcessorBlock()->PhysicalPageCache;
+    if (Cache != NULL) {
+        KeAcquireSpinLock(&(Cache->Lock));
+        while ((Count != 0) && (Cache->Count < PHYSICAL_PAGE_CACHE_SIZE)) {
+            Count -= 1;
+            Cache->Pages[(Cache->Head + Cache->Count) %
+                         PHYSICAL_PAGE_CACHE_SIZE] = Pages[Count];
+
+            Cache->Count += 1;
+        }
+
+        KeReleaseSpinLock(&(Cache->Lock));
+    }
+
+    KeLowerRunLevel(OldRunLevel);
+    if (Count != 0) {
+        MmpFreePhysicalPageBatch(Pages, Count, FALSE);
+    }
+
+    return Allocation;
+}
+
+BOOL
+MmpFreeToPhysicalPageCache (
+    PHYSICAL_ADDRESS PhysicalAddress
+    )
+
+/*++
+
+Routine Description:
+
+    This routine puts a free page at the hot end of the current processor's
+    page cache. If the cache is full, a batch of the coldest pages goes back
+    to the buddy allocator. The caller must hold the physical page lock
+    shared if it exists, and must already have marked the page non-paged.
+
+Arguments:
+
+    PhysicalAddress - Supplies the physical address of the page to free.
+
+Return Value:
+
+    TRUE if the page went into the cache.
+
+    FALSE if the current processor has no page cache.
+
+--*/
+
+{
+
+    PPHYSICAL_PAGE_CACHE Cache;
+    UINTN Count;
+    RUNLEVEL OldRunLevel;
+    PHYSICAL_ADDRESS Pages[PHYSICAL_PAGE_CACHE_BATCH];
+
+    Count = 0;
+    OldRunLevel = KeRaiseRunLevel(RunLevelDispatch);
+    Cache = KeGetCurrentProcessorBlock()->PhysicalPageCache;
+    if (Cache == NULL) {
+        KeLowerRunLevel(OldRunLevel);
+        return FALSE;
+    }
+
+    KeAcquireSpinLock(&(Cache->Lock));
+    if (Cache->Count == PHYSICAL_PAGE_CACHE_SIZE) {
+        while (Count < PHYSICAL_PAGE_CACHE_BATCH) {
+            Pages[Count] = Cache->Pages[Cache->Head];
+            Cache->Head = (Cache->Head + 1) % PHYSICAL_PAGE_CACHE_SIZE;
+            Cache->Count -= 1;
+            Count += 1;
+        }
+    }
+
+    Cache->Pages[(Cache->Head + Cache->Count) % PHYSICAL_PAGE_CACHE_SIZE] =
+                                                               PhysicalAddress;
+
+    Cache->Count += 1;
+    KeReleaseSpinLock(&(Cache->Lock));
+    KeLowerRunLevel(OldRunLevel);
+    if (Count != 0) {
+        MmpFreePhysicalPageBatch(Pages, Count, TRUE);
+    }
+
+    return TRUE;
+}
+
+UINTN
+MmpDrainPhysicalPageCaches (
+    VOID
+    )
+
+/*++
+
+Routine Description:
+
+    This routine empties every processor's page cache back into the buddy
+    allocator. It is used when memory is short.
+
+Arguments:
+
+    None.
+
+Return Value:
+
+    Returns the number of pages that were returned to the buddy allocator.
+
+--*/
+
+{
+
+    PPHYSICAL_PAGE_CACHE Cache;
+    UINTN Count;
+    RUNLEVEL OldRunLevel;
+    PHYSICAL_ADDRESS Pages[PHYSICAL_PAGE_CACHE_SIZE];
+    ULONG Processor;
+    ULONG ProcessorCount;
+    UINTN Total;
+
+    ASSERT(KeGetRunLevel() == RunLevelLow);
+
+    Total = 0;
+    ProcessorCount = KeGetActiveProcessorCount();
+    for (Processor = 0; Processor < ProcessorCount; Processor += 1) {
+        Cache = KeGetProcessorBlock(Processor)->PhysicalPageCache;
+        if (Cache == NULL) {
+            continue;
+        }
+
+        Count = 0;
+        OldRunLevel = KeRaiseRunLevel(RunLevelDispatch);
+        KeAcquireSpinLock(&(Cache->Lock));
+        while (Cache->Count != 0) {
+            Pages[Count] = Cache->Pages[Cache->Head];
+            Cache->Head = (Cache->Head + 1) % PHYSICAL_PAGE_CACHE_SIZE;
+            Cache->Count -= 1;
+            Count += 1;
+        }
+
+        KeReleaseSpinLock(&(Cache->Lock));
+        KeLowerRunLevel(OldRunLevel);
+        if (Count != 0) {
+            MmpFreePhysicalPageBatch(Pages, Count, FALSE);
+            Total += Count;
+        }
+    }
+
+    return Total;
+}
+
+UINTN
+MmpAllocatePhysicalPageBatch (
+    PPHYSICAL_ADDRESS Pages,
+    UINTN PageCount
+    )
+
+/*++
+
+Routine Description:
+
+    This routine allocates up to the given number of single pages from the
+    buddy allocator under one acquire of the buddy lock.
+
+Arguments:
+
+    Pages - Supplies an array where the physical addresses of the allocated
+        pages are returned.
+
+    PageCount - Supplies the maximum number of pages to allocate.
+
+Return Value:
+
+    Returns the number of pages allocated, which may be zero.
+
+--*/
+
+{
+
+    UINTN Count;
+    RUNLEVEL OldRunLevel;
+    UINTN Page;
+    ULONG PageShift;
+    PPHYSICAL_PAGE PhysicalPage;
+    PPHYSICAL_MEMORY_SEGMENT Segment;
+    BOOL SignalEvent;
+    ULONGLONG StartCycles;
+
+    Count = 0;
+    PageShift = MmPageShift();
+    SignalEvent = FALSE;
+    if (MmPhysicalPageLock != NULL) {
+        KeAcquireSharedExclusiveLockShared(MmPhysicalPageLock);
+    }
+
+    OldRunLevel = KeRaiseRunLevel(RunLevelDispatch);
+    StartCycles = HlQueryProcessorCounter();
+    KeAcquireSpinLock(&MmPhysicalBuddyLock);
+    while (Count < PageCount) {
+        if (MmpBuddyAllocate(0, &Segment, &Page) == FALSE) {
+            break;
+        }
+
+        PhysicalPage = (PPHYSICAL_PAGE)(Segment + 1);
+        PhysicalPage += Page - Segment->Buddy->StartPage;
+
+        ASSERT(PhysicalPage->U.Free == PHYSICAL_PAGE_FREE);
+
+        PhysicalPage->U.Flags = PHYSICAL_PAGE_FLAG_NON_PAGED;
+        RtlAtomicAdd(&(Segment->FreePages), -1);
+        Pages[Count] = (PHYSICAL_ADDRESS)Page << PageShift;
+        Count += 1;
+    }
+
+    if (Count != 0) {
+        MmpRecordBlockAllocation(StartCycles);
+    }
+
+    KeReleaseSpinLock(&MmPhysicalBuddyLock);
+    KeLowerRunLevel(OldRunLevel);
+    if (Count != 0) {
+        SignalEvent = MmpUpdatePhysicalMemoryStatistics(Count, TRUE);
+    }
+
+    if (MmPhysicalPageLock != NULL) {
+        KeReleaseSharedExclusiveLockShared(MmPhysicalPageLock);
+    }
+
+    if (SignalEvent != FALSE) {
+
+        ASSERT(MmPhysicalMemoryWarningEvent != NULL);
+
+        KeSignalEvent(MmPhysicalMemoryWarningEvent, SignalOptionPulse);
+    }
+
+    return Count;
+}
+
+VOID
+MmpFreePhysicalPageBatch (
+    PPHYSICAL_ADDRESS Pages,
+    UINTN PageCount,
+    BOOL LockHeld
+    )
+
+/*++
+
+Routine Description:
+
+    This routine returns a set of non-paged single pages, such as those
+    leaving a processor's page cache, to the buddy allocator.
+
+Arguments:
+
+    Pages - Supplies an array of the physical addresses of the pages to free.
+
+    PageCount - Supplies the number of pages in the array.
+
+    LockHeld - Supplies a boolean indicating whether the caller already holds
+        the physical page lock shared.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    UINTN Index;
+    RUNLEVEL OldRunLevel;
+    UINTN Page;
+    ULONG PageShift;
+    PPHYSICAL_PAGE PhysicalPage;
+    PPHYSICAL_MEMORY_SEGMENT Segment;
+    BOOL SignalEvent;
+
+    PageShift = MmPageShift();
+    Segment = NULL;
+    if ((LockHeld == FALSE) && (MmPhysicalPageLock != NULL)) {
+        KeAcquireSharedExclusiveLockShared(MmPhysicalPageLock);
+    }
+
+    OldRunLevel = KeRaiseRunLevel(RunLevelDispatch);
+    KeAcquireSpinLock(&MmPhysicalBuddyLock);
+    for (Index = 0; Index < PageCount; Index += 1) {
+        if ((Segment == NULL) ||
+            (Pages[Index] < Segment->StartAddress) ||
+            (Pages[Index] >= Segment->EndAddress)) {
+
+            Segment = MmpFindPhysicalSegment(Pages[Index]);
+        }
+
+        ASSERT((Segment != NULL) && (Segment->Buddy != NULL));
+
+        Page = Pages[Index] >> PageShift;
+        PhysicalPage = (PPHYSICAL_PAGE)(Segment + 1);
+        PhysicalPage += Page - Segment->Buddy->StartPage;
+
+        ASSERT(PhysicalPage->U.Flags == PHYSICAL_PAGE_FLAG_NON_PAGED);
+
+        PhysicalPage->U.Free = PHYSICAL_PAGE_FREE;
+        RtlAtomicAdd(&(Segment->FreePages), 1);
+        MmpBuddyInsertBlock(Segment->Buddy, Page, 0);
+    }
+
+    KeReleaseSpinLock(&MmPhysicalBuddyLock);
+    KeLowerRunLevel(OldRunLevel);
+    RtlAtomicAdd(&MmNonPagedPhysicalPages, -PageCount);
+    SignalEvent = MmpUpdatePhysicalMemoryStatistics(PageCount, FALSE);
+    if ((LockHeld == FALSE) && (MmPhysicalPageLock != NULL)) {
+        KeReleaseSharedExclusiveLockShared(MmPhysicalPageLock);
+    }
+
+    if (SignalEvent != FALSE) {
+
+        ASSERT(MmPhysicalMemoryWarningEvent != NULL);
+
+        KeSignalEvent(MmPhysicalMemoryWarningEvent, SignalOptionPulse);
+    }
+
+    return;
+}
+
+PHYSICAL_ADDRESS
+MmpAllocatePhysicalBlock (
+    UINTN PageCount,
+    ULONG Order
+    )
+
+/*++
+
+Routine Description:
+
+    This routine allocates a run of contiguous pages from the buddy
+    allocator. The pages at the end of the block beyond the requested count go
+    straight back to the buddy allocator.
+
+Arguments:
+
+    PageCount - Supplies the number of pages to allocate.
+
+    Order - Supplies the order of the block to carve the pages from. The
+        block must hold at least the requested number of pages.
+
+Return Value:
+
+    Returns the physical address of the first page on success, or
+    INVALID_PHYSICAL_ADDRESS if no block of the given order is free.
+
+--*/
+
+{
+
+    PHYSICAL_ADDRESS Allocation;
+    UINTN Index;
+    RUNLEVEL OldRunLevel;
+    UINTN Page;
+    ULONG PageShift;
+    PPHYSICAL_PAGE PhysicalPage;
+    PPHYSICAL_MEMORY_SEGMENT Segment;
+    BOOL SignalEvent;
+    ULONGLONG StartCycles;
+
+    ASSERT(PageCount <= ((UINTN)1 << Order));
+
+    Allocation = INVALID_PHYSICAL_ADDRESS;
+    PageShift = MmPageShift();
+    SignalEvent = FALSE;
+    if (MmPhysicalPageLock != NULL) {
+        KeAcquireSharedExclusiveLockShared(MmPhysicalPageLock);
+    }
+
+    OldRunLevel = KeRaiseRunLevel(RunLevelDispatch);
+    StartCycles = HlQueryProcessorCounter();
+    KeAcquireSpinLock(&MmPhysicalBuddyLock);
+    if (MmpBuddyAllocate(Order, &Segment, &Page) != FALSE) {
+        PhysicalPage = (PPHYSICAL_PAGE)(Segment + 1);
+        PhysicalPage += Page - Segment->Buddy->StartPage;
+        for (Index = 0; Index < PageCount; Index += 1) {
+
+            ASSERT(PhysicalPage->U.Free == PHYSICAL_PAGE_FREE);
+
+            PhysicalPage->U.Flags = PHYSICAL_PAGE_FLAG_NON_PAGED;
+            PhysicalPage += 1;
+        }
+
+        if (PageCount < ((UINTN)1 << Order)) {
+            MmpBuddyInsertRange(Segment->Buddy,
+                                Page + PageCount,
+                                Page + ((UINTN)1 << Order));
+        }
+
+        RtlAtomicAdd(&(Segment->FreePages), -PageCount);
+        Allocation = (PHYSICAL_ADDRESS)Page << PageShift;
+        MmpRecordBlockAllocation(StartCycles);
+    }
+
+    KeReleaseSpinLock(&MmPhysicalBuddyLock);
+    KeLowerRunLevel(OldRunLevel);
+    if (Allocation != INVALID_PHYSICAL_ADDRESS) {
+        SignalEvent = MmpUpdatePhysicalMemoryStatistics(PageCount, TRUE);
+    }
+
+    if (MmPhysicalPageLock != NULL) {
+        KeReleaseSharedExclusiveLockShared(MmPhysicalPageLock);
+    }
+
+    if (SignalEvent != FALSE) {
+
+        ASSERT(MmPhysicalMemoryWarningEvent != NULL);
+
+        KeSignalEvent(MmPhysicalMemoryWarningEvent, SignalOptionPulse);
+    }
+
+    return Allocation;
+}
+
+BOOL
+MmpBuddyAllocate (
+    ULONG Order,
+    PPHYSICAL_MEMORY_SEGMENT *Segment,
+    PUINTN Page
+    )
+
+/*++
+
+Routine Description:
+
+    This routine removes a free block of the given order from the buddy
+    allocator, splitting a larger block if needed. Segments are searched from
+    the highest addresses down, leaving low memory for allocations that need
+    it. The caller must hold the buddy lock.
+
+Arguments:
+
+    Order - Supplies the order of the block to allocate.
+
+    Segment - Supplies a pointer where the segment holding the block is
+        returned.
+
+    Page - Supplies a pointer where the page number of the block is returned.
+
+Return Value:
+
+    TRUE if a block was allocated.
+
+    FALSE if no block of the given order or larger is free.
+
+--*/
+
+{
+
+    ULONG BlockOrder;
+    PPHYSICAL_BUDDY Buddy;
+    PLIST_ENTRY CurrentEntry;
+    PPHYSICAL_MEMORY_SEGMENT CurrentSegment;
+
+    for (BlockOrder = Order;
+         BlockOrder < PHYSICAL_BUDDY_ORDER_COUNT;
+         BlockOrder += 1) {
+
+        CurrentEntry = MmPhysicalSegmentListHead.Previous;
+        while (CurrentEntry != &MmPhysicalSegmentListHead) {
+            CurrentSegment = LIST_VALUE(CurrentEntry,
+                                        PHYSICAL_MEMORY_SEGMENT,
+                                        ListEntry);
+
+            CurrentEntry = CurrentEntry->Previous;
+            Buddy = CurrentSegment->Buddy;
+            if ((Buddy == NULL) || (Buddy->Areas[BlockOrder].FreeCount == 0)) {
+                continue;
+            }
+
+            if (MmpBuddyRemoveBlock(Buddy, BlockOrder, Page) == FALSE) {
+                continue;
+            }
+
+            //
+            // Split the block down to size, freeing the upper half each time.
+            //
+
+            while (BlockOrder > Order) {
+                BlockOrder -= 1;
+                MmpBuddyInsertBlock(Buddy,
+                                    *Page + ((UINTN)1 << BlockOrder),
+                                    BlockOrder);
+            }
+
+            *Segment = CurrentSegment;
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+BOOL
+MmpBuddyRemoveBlock (
+    PPHYSICAL_BUDDY Buddy,
+    ULONG Order,
+    PUINTN Page
+    )
+
+/*++
+
+Routine Description:
+
+    This routine removes the lowest free block of the given order from a
+    segment's free area. The caller must hold the buddy lock.
+
+Arguments:
+
+    Buddy - Supplies a pointer to the segment's buddy state.
+
+    Order - Supplies the order of the block to remove.
+
+    Page - Supplies a pointer where the page number of the block is returned.
+
+Return Value:
+
+    TRUE if a block was removed.
+
+    FALSE if the free area is empty.
+
+--*/
+
+{
+
+    PPHYSICAL_FREE_AREA Area;
+    ULONG Bit;
+    UINTN Index;
+    UINTN Word;
+
+    Area = &(Buddy->Areas[Order]);
+    for (Word = Area->Hint; Word < Area->WordCount; Word += 1) {
+        if (Area->Bitmap[Word] != 0) {
+            break;
+        }
+    }
+
+    Area->Hint = Word;
+    if (Word == Area->WordCount) {
+
+        ASSERT(Area->FreeCount == 0);
+
+        return FALSE;
+    }
+
+    Bit = RtlCountTrailingZeros32(Area->Bitmap[Word]);
+    Index = (Word * PHYSICAL_BUDDY_BITMAP_BITS) + Bit;
+    PHYSICAL_BUDDY_CLEAR(Area, Index);
+
+    ASSERT(Area->FreeCount != 0);
+
+    Area->FreeCount -= 1;
+    *Page = (Area->FirstIndex + Index) << Order;
+    return TRUE;
+}
+
+VOID
+MmpBuddyInsertBlock (
+    PPHYSICAL_BUDDY Buddy,
+    UINTN Page,
+    ULONG Order
+    )
+
+/*++
+
+Routine Description:
+
+    This routine adds a free block to a segment's buddy state, merging it with
+    its buddy for as long as the buddy is also free. The caller must hold the
+    buddy lock.
+
+Arguments:
+
+    Buddy - Supplies a pointer to the segment's buddy state.
+
+    Page - Supplies the page number of the block, which must be aligned to
+        the block size.
+
+    Order - Supplies the order of the block.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PPHYSICAL_FREE_AREA Area;
+    UINTN BuddyPage;
+    UINTN Index;
+
+    ASSERT((Page & (((UINTN)1 << Order) - 1)) == 0);
+
+    while (Order < PHYSICAL_BUDDY_ORDER_COUNT - 1) {
+        BuddyPage = Page ^ ((UINTN)1 << Order);
+        if ((BuddyPage < Buddy->StartPage) ||
+            (BuddyPage + ((UINTN)1 << Order) > Buddy->EndPage)) {
+
+            break;
+        }
+
+        Area = &(Buddy->Areas[Order]);
+        Index = PHYSICAL_BUDDY_INDEX(Area, BuddyPage, Order);
+        if (!PHYSICAL_BUDDY_TEST(Area, Index)) {
+            break;
+        }
+
+        PHYSICAL_BUDDY_CLEAR(Area, Index);
+        Area->FreeCount -= 1;
+        Page &= ~((UINTN)1 << Order);
+        Order += 1;
+    }
+
+    Area = &(Buddy->Areas[Order]);
+    Index = PHYSICAL_BUDDY_INDEX(Area, Page, Order);
+
+    ASSERT(!PHYSICAL_BUDDY_TEST(Area, Index));
+
+    PHYSICAL_BUDDY_SET(Area, Index);
+    Area->FreeCount += 1;
+    if ((Index / PHYSICAL_BUDDY_BITMAP_BITS) < Area->Hint) {
+        Area->Hint = Index / PHYSICAL_BUDDY_BITMAP_BITS;
+    }
+
+    return;
+}
+
+VOID
+MmpBuddyInsertRange (
+    PPHYSICAL_BUDDY Buddy,
+    UINTN StartPage,
+    UINTN EndPage
+    )
+
+/*++
+
+Routine Description:
+
+    This routine adds a run of free pages to a segment's buddy state by
+    breaking it into the largest aligned blocks that fit. The caller must hold
+    the buddy lock.
+
+Arguments:
+
+    Buddy - Supplies a pointer to the segment's buddy state.
+
+    StartPage - Supplies the first page number of the run.
+
+    EndPage - Supplies the page number one beyond the end of the run.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    ULONG Order;
+
+    while (StartPage < EndPage) {
+        Order = 0;
+        while ((Order < PHYSICAL_BUDDY_ORDER_COUNT - 1) &&
+               ((StartPage & ((UINTN)1 << Order)) == 0) &&
+               (StartPage + ((UINTN)2 << Order) <= EndPage)) {
+
+            Order += 1;
+        }
+
+        MmpBuddyInsertBlock(Buddy, StartPage, Order);
+        StartPage += (UINTN)1 << Order;
+    }
+
+    return;
+}
+
+VOID
+MmpBuddyClaimRange (
+    PPHYSICAL_BUDDY Buddy,
+    UINTN StartPage,
+    UINTN EndPage
+    )
+
+/*++
+
+Routine Description:
+
+    This routine takes a run of free pages out of a segment's buddy state,
+    giving back the parts of the containing free blocks outside the run. The
+    caller must hold the buddy lock.
+
+Arguments:
+
+    Buddy - Supplies a pointer to the segment's buddy state.
+
+    StartPage - Supplies the first page number of the run.
+
+    EndPage - Supplies the page number one beyond the end of the run.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PPHYSICAL_FREE_AREA Area;
+    UINTN BlockEnd;
+    UINTN BlockPage;
+    UINTN Index;
+    ULONG Order;
+
+    while (StartPage < EndPage) {
+
+        //
+        // Find the free block containing the first page of the run. Larger
+        // blocks contain smaller ones, so stop once the block no longer fits
+        // in the segment.
+        //
+
+        for (Order = 0; Order < PHYSICAL_BUDDY_ORDER_COUNT; Order += 1) {
+            BlockPage = StartPage & ~(((UINTN)1 << Order) - 1);
+            BlockEnd = BlockPage + ((UINTN)1 << Order);
+            if ((BlockPage < Buddy->StartPage) || (BlockEnd > Buddy->EndPage)) {
+                Order = PHYSICAL_BUDDY_ORDER_COUNT;
+                break;
+            }
+
+            Area = &(Buddy->Areas[Order]);
+            Index = PHYSICAL_BUDDY_INDEX(Area, BlockPage, Order);
+            if (PHYSICAL_BUDDY_TEST(Area, Index)) {
+                break;
+            }
+        }
+
+        if (Order == PHYSICAL_BUDDY_ORDER_COUNT) {
+
+            ASSERT(FALSE);
+
+            StartPage += 1;
+            continue;
+        }
+
+        PHYSICAL_BUDDY_CLEAR(Area, Index);
+        Area->FreeCount -= 1;
+        if (BlockPage < StartPage) {
+            MmpBuddyInsertRange(Buddy, BlockPage, StartPage);
+        }
+
+        if (BlockEnd > EndPage) {
+            MmpBuddyInsertRange(Buddy, EndPage, BlockEnd);
+            BlockEnd = EndPage;
+        }
+
+        StartPage = BlockEnd;
+    }
+
+    return;
+}
+
+VOID
+MmpRecordBlockAllocation (
+    ULONGLONG StartCycles
+    )
+
+/*++
+
+Routine Description:
+
+    This routine records the latency of a buddy allocation. The caller must
+    hold the buddy lock.
+
+Arguments:
+
+    StartCycles - Supplies the processor counter value read before the buddy
+        lock was acquired.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    ULONGLONG Cycles;
+
+    Cycles = HlQueryProcessorCounter() - StartCycles;
+    MmPhysicalBlockAllocations += 1;
+    MmPhysicalBlockAllocationCycles += Cycles;
+    if (Cycles > MmPhysicalMaxBlockAllocationCycles) {
+        MmPhysicalMaxBlockAllocationCycles = Cycles;
+    }
+
+    return;
+}
+
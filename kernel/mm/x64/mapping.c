@@ -145,10 +145,54 @@ MmpCreatePageTable (
     BOOL ZeroTable
     );
 
+BOOL
+MmpSplitLargePage (
+    PADDRESS_SPACE_X64 AddressSpace,
+    PVOID VirtualAddress,
+    volatile PTE *Pde
+    );
+
+COMPARISON_RESULT
+MmpCompareLargePageEntries (
+    PRED_BLACK_TREE Tree,
+    PRED_BLACK_TREE_NODE FirstNode,
+    PRED_BLACK_TREE_NODE SecondNode
+    );
+
 //
 // ------------------------------------------------------ Data Type Definitions
 //
 
+/*++
+
+Structure Description:
+
+    This structure defines a page table set aside while the region it covers
+    is mapped by a single large page directory entry. The page table still
+    holds valid entries for every page in the region, so splitting the large
+    page is just a matter of putting the page table back.
+
+Members:
+
+    TreeNode - Stores the node in the address space's large page tree.
+
+    ListEntry - Stores pointers to the next and previous spare entries when
+        this entry is not in use.
+
+    VirtualAddress - Stores the large page aligned virtual address of the
+        region.
+
+    PageTable - Stores the physical address of the page table.
+
+--*/
+
+typedef struct _LARGE_PAGE_ENTRY {
+    RED_BLACK_TREE_NODE TreeNode;
+    LIST_ENTRY ListEntry;
+    PVOID VirtualAddress;
+    PHYSICAL_ADDRESS PageTable;
+} LARGE_PAGE_ENTRY, *PLARGE_PAGE_ENTRY;
+
 //
 // -------------------------------------------------------------------- Globals
 //
@@ -465,13 +509,20 @@ Return Value:
             break;
         }
 
-        if ((*X64_PDE(Current) & X86_PTE_PRESENT) == 0) {
+        Table = X64_PDE(Current);
+        if ((*Table & X86_PTE_PRESENT) == 0) {
             break;
         }
 
-        Table = X64_PTE(Current);
-        if ((*Table & X86_PTE_PRESENT) == 0) {
-            break;
+        //
+        // A large page maps the whole region with the directory entry itself.
+        //
+
+        if ((*Table & X86_PTE_LARGE) == 0) {
+            Table = X64_PTE(Current);
+            if ((*Table & X86_PTE_PRESENT) == 0) {
+                break;
+            }
         }
 
         if ((Writable != NULL) && ((*Table & X86_PTE_WRITABLE) == 0)) {
@@ -530,7 +581,16 @@ Return Value:
            ((*X64_PDPE(Address) & X86_PTE_PRESENT) != 0) &&
            ((*X64_PDE(Address) & X86_PTE_PRESENT) != 0));
 
-    Pte = X64_PTE(Address);
+    //
+    // Change the large page directory entry directly rather than splitting it,
+    // which is not possible from the debugger.
+    //
+
+    Pte = X64_PDE(Address);
+    if ((*Pte & X86_PTE_LARGE) == 0) {
+        Pte = X64_PTE(Address);
+    }
+
     if ((*Pte & X86_PTE_WRITABLE) == 0) {
         *WasWritable = FALSE;
         if (Writable != FALSE) {
@@ -638,6 +698,7 @@ Return Value:
         ProcessorBlock = KeGetCurrentProcessorBlock();
         ProcessorBlock->SwapPage = Parameters->PageTableStage;
         KeInitializeSpinLock(&MmPageTableLock);
+        MmLargePageShift = X64_PDE_SHIFT;
         Status = STATUS_SUCCESS;
 
     //
@@ -853,6 +914,12 @@ Return Value:
     }
 
     RtlZeroMemory(Space, sizeof(ADDRESS_SPACE_X64));
+    KeInitializeSpinLock(&(Space->LargePageLock));
+    RtlRedBlackTreeInitialize(&(Space->LargePageTree),
+                              0,
+                              MmpCompareLargePageEntries);
+
+    INITIALIZE_LIST_HEAD(&(Space->FreeLargePageList));
     Status = MmpCreatePageDirectory(Space);
     if (!KSUCCESS(Status)) {
         goto ArchCreateAddressSpaceEnd;
@@ -895,9 +962,27 @@ Return Value:
 
 {
 
+    PLARGE_PAGE_ENTRY Entry;
     PADDRESS_SPACE_X64 Space;
 
     Space = (PADDRESS_SPACE_X64)AddressSpace;
+
+    //
+    // Tearing down the page tables split every large page, so all that is
+    // left are the spare entries.
+    //
+
+    ASSERT(RED_BLACK_TREE_EMPTY(&(Space->LargePageTree)) != FALSE);
+
+    while (LIST_EMPTY(&(Space->FreeLargePageList)) == FALSE) {
+        Entry = LIST_VALUE(Space->FreeLargePageList.Next,
+                           LARGE_PAGE_ENTRY,
+                           ListEntry);
+
+        LIST_REMOVE(&(Entry->ListEntry));
+        MmFreeNonPagedPool(Entry);
+    }
+
     MmpDestroyPageDirectory(Space);
     MmFreeNonPagedPool(Space);
     return;
@@ -1031,6 +1116,17 @@ Return Value:
         MmpEnsurePageTables(AddressSpace, VirtualAddress);
     }
 
+    //
+    // A large page covers the entire region, so the page should already be
+    // mapped. Split it anyway so the assert below catches the caller.
+    //
+
+    if ((*X64_PDE(VirtualAddress) & X86_PTE_LARGE) != 0) {
+        MmpSplitLargePage(AddressSpace,
+                          VirtualAddress,
+                          X64_PDE(VirtualAddress));
+    }
+
     Pte = X64_PTE(VirtualAddress);
 
     ASSERT(((*Pte & X86_PTE_PRESENT) == 0) && (X86_PTE_ENTRY(*Pte) == 0));
@@ -1203,6 +1299,17 @@ Return Value:
             continue;
         }
 
+        //
+        // Unmapping any part of a large page requires going back to the
+        // individual page mappings.
+        //
+
+        if ((*X64_PDE(CurrentVirtual) & X86_PTE_LARGE) != 0) {
+            MmpSplitLargePage(AddressSpace,
+                              CurrentVirtual,
+                              X64_PDE(CurrentVirtual));
+        }
+
         Pte = X64_PTE(CurrentVirtual);
 
         //
@@ -1366,6 +1473,7 @@ Return Value:
 
 {
 
+    UINTN OffsetMask;
     PHYSICAL_ADDRESS PhysicalAddress;
     PPTE Pml4;
     ULONG Pml4Index;
@@ -1396,7 +1504,17 @@ Return Value:
         return INVALID_PHYSICAL_ADDRESS;
     }
 
-    Pte = X64_PTE(VirtualAddress);
+    //
+    // A large page directory entry translates the address directly.
+    //
+
+    Pte = X64_PDE(VirtualAddress);
+    OffsetMask = X64_LARGE_PAGE_MASK;
+    if ((*Pte & X86_PTE_LARGE) == 0) {
+        Pte = X64_PTE(VirtualAddress);
+        OffsetMask = PAGE_MASK;
+    }
+
     PhysicalAddress = X86_PTE_ENTRY(*Pte);
     if (PhysicalAddress == 0) {
 
@@ -1405,7 +1523,7 @@ Return Value:
         return INVALID_PHYSICAL_ADDRESS;
     }
 
-    PhysicalAddress += (UINTN)VirtualAddress & PAGE_MASK;
+    PhysicalAddress += (UINTN)VirtualAddress & OffsetMask;
     if (Attributes != NULL) {
         if ((*Pte & X86_PTE_PRESENT) != 0) {
             *Attributes |= MAP_FLAG_PRESENT;
@@ -1771,6 +1889,7 @@ Return Value:
     PTE PteValue;
     BOOL SendInvalidateIpi;
 
+    ChangedSomething = FALSE;
     InvalidateTlb = TRUE;
     SendInvalidateIpi = TRUE;
     End = VirtualAddress + (PageCount << PAGE_SHIFT);
@@ -1854,6 +1973,18 @@ Return Value:
             continue;
         }
 
+        //
+        // The new attributes may only apply to part of a large page, so go
+        // back to individual page mappings.
+        //
+
+        if ((*Pte & X86_PTE_LARGE) != 0) {
+            MmpSplitLargePage(
+                        (PADDRESS_SPACE_X64)PsGetCurrentProcess()->AddressSpace,
+                        CurrentVirtual,
+                        Pte);
+        }
+
         Pte = X64_PTE(CurrentVirtual);
         if (X86_PTE_ENTRY(*Pte) == 0) {
 
@@ -2250,6 +2381,18 @@ Return Value:
                                   ((UINTN)PdpIndex << X64_PDPE_SHIFT) |
                                   ((UINTN)PdIndex << X64_PDE_SHIFT));
 
+                //
+                // The source pages are about to go read-only individually, so
+                // put the source's page table back if the region is mapped
+                // with a large page.
+                //
+
+                if ((Pd[PdIndex] & X86_PTE_LARGE) != 0) {
+                    MmpSplitLargePage((PADDRESS_SPACE_X64)Source,
+                                      PdStart,
+                                      &(Pd[PdIndex]));
+                }
+
                 PdEnd = PdStart + (1ULL << X64_PDE_SHIFT) - 1;
                 if (PdStart < VirtualAddress) {
                     PdStart = VirtualAddress;
@@ -2619,6 +2762,20 @@ Return Value:
                     continue;
                 }
 
+                //
+                // Put back the page table of a large page so it gets freed
+                // like any other.
+                //
+
+                if ((Pd[PdIndex] & X86_PTE_LARGE) != 0) {
+                    MmpSplitLargePage(
+                                Space,
+                                (PVOID)(((UINTN)Pml4Index << X64_PML4E_SHIFT) |
+                                        ((UINTN)PdpIndex << X64_PDPE_SHIFT) |
+                                        ((UINTN)PdIndex << X64_PDE_SHIFT)),
+                                &(Pd[PdIndex]));
+                }
+
                 //
                 // PTs may or may not be valid, but there's no need to dig into
                 // them since there are no lower level tables beyond it.
@@ -2676,6 +2833,205 @@ Return Value:
     return;
 }
 
+BOOL
+MmpPromoteLargePage (
+    PVOID VirtualAddress
+    )
+
+/*++
+
+Routine Description:
+
+    This routine attempts to replace the page table covering the given region
+    of the current process with a single large page directory entry. This only
+    succeeds if every page in the region is mapped, the pages are physically
+    contiguous and large page aligned, and they all share the same attributes.
+    The caller must hold the lock of the image section covering the region.
+
+Arguments:
+
+    VirtualAddress - Supplies the large page aligned user mode virtual address
+        of the region to promote.
+
+Return Value:
+
+    TRUE if the region is now mapped with a large page.
+
+    FALSE if the region cannot be promoted.
+
+--*/
+
+{
+
+    PTE AttributeMask;
+    PTE Attributes;
+    PHYSICAL_ADDRESS Base;
+    PTE Dirty;
+    PLARGE_PAGE_ENTRY Entry;
+    RUNLEVEL OldRunLevel;
+    PPTE Pde;
+    PPTE Pt;
+    ULONG PtIndex;
+    PADDRESS_SPACE_X64 Space;
+
+    ASSERT(KeGetRunLevel() == RunLevelLow);
+    ASSERT(IS_POINTER_ALIGNED(VirtualAddress, X64_LARGE_PAGE_SIZE));
+    ASSERT(VirtualAddress + X64_LARGE_PAGE_SIZE <= USER_VA_END);
+
+    Space = (PADDRESS_SPACE_X64)(PsGetCurrentProcess()->AddressSpace);
+    Pde = X64_PDE(VirtualAddress);
+    if (((*X64_PML4E(VirtualAddress) & X86_PTE_PRESENT) == 0) ||
+        ((*X64_PDPE(VirtualAddress) & X86_PTE_PRESENT) == 0) ||
+        ((*Pde & X86_PTE_PRESENT) == 0) ||
+        ((*Pde & X86_PTE_LARGE) != 0)) {
+
+        return FALSE;
+    }
+
+    //
+    // The first page decides the physical base and attributes. The large bit
+    // is the PAT bit in a page table entry, and that has to be clear too.
+    //
+
+    AttributeMask = X86_PTE_PRESENT | X86_PTE_WRITABLE | X86_PTE_USER_MODE |
+                    X86_PTE_WRITE_THROUGH | X86_PTE_CACHE_DISABLED |
+                    X86_PTE_LARGE | X86_PTE_GLOBAL | X86_PTE_NX;
+
+    Pt = X64_PT(VirtualAddress);
+    Base = X86_PTE_ENTRY(Pt[0]);
+    Attributes = Pt[0] & AttributeMask;
+    if (((Attributes & X86_PTE_PRESENT) == 0) ||
+        ((Attributes & X86_PTE_LARGE) != 0) ||
+        ((Base & X64_LARGE_PAGE_MASK) != 0)) {
+
+        return FALSE;
+    }
+
+    for (PtIndex = 1; PtIndex < X64_PTE_COUNT; PtIndex += 1) {
+        if ((X86_PTE_ENTRY(Pt[PtIndex]) != Base + (PtIndex << PAGE_SHIFT)) ||
+            ((Pt[PtIndex] & AttributeMask) != Attributes)) {
+
+            return FALSE;
+        }
+    }
+
+    //
+    // Grab a spare entry to hold the page table, or allocate a new one.
+    //
+
+    Entry = NULL;
+    OldRunLevel = KeRaiseRunLevel(RunLevelDispatch);
+    KeAcquireSpinLock(&(Space->LargePageLock));
+    if (LIST_EMPTY(&(Space->FreeLargePageList)) == FALSE) {
+        Entry = LIST_VALUE(Space->FreeLargePageList.Next,
+                           LARGE_PAGE_ENTRY,
+                           ListEntry);
+
+        LIST_REMOVE(&(Entry->ListEntry));
+    }
+
+    KeReleaseSpinLock(&(Space->LargePageLock));
+    KeLowerRunLevel(OldRunLevel);
+    if (Entry == NULL) {
+        Entry = MmAllocateNonPagedPool(sizeof(LARGE_PAGE_ENTRY),
+                                       MM_ADDRESS_SPACE_ALLOCATION_TAG);
+
+        if (Entry == NULL) {
+            return FALSE;
+        }
+    }
+
+    //
+    // The processor only tracks accessed and dirty for the large page as a
+    // whole. Mark every page accessed, and dirty if it can be written, so
+    // that nothing is lost when the page table comes back.
+    //
+
+    Dirty = 0;
+    if ((Attributes & X86_PTE_WRITABLE) != 0) {
+        Dirty = X86_PTE_DIRTY;
+    }
+
+    for (PtIndex = 0; PtIndex < X64_PTE_COUNT; PtIndex += 1) {
+        Pt[PtIndex] |= X86_PTE_ACCESSED | Dirty;
+    }
+
+    Entry->VirtualAddress = VirtualAddress;
+    OldRunLevel = KeRaiseRunLevel(RunLevelDispatch);
+    KeAcquireSpinLock(&(Space->LargePageLock));
+    Entry->PageTable = X86_PTE_ENTRY(*Pde);
+    *Pde = Base | Attributes | X86_PTE_LARGE | X86_PTE_ACCESSED | Dirty;
+    RtlRedBlackTreeInsert(&(Space->LargePageTree), &(Entry->TreeNode));
+    KeReleaseSpinLock(&(Space->LargePageLock));
+    KeLowerRunLevel(OldRunLevel);
+
+    //
+    // The translations have not changed, but flush the small page entries
+    // rather than let them linger alongside the large one.
+    //
+
+    MmpSendTlbInvalidateIpi(&(Space->Common),
+                            VirtualAddress,
+                            X64_PTE_COUNT);
+
+    RtlAtomicAdd(&MmLargePagePromotions, 1);
+    return TRUE;
+}
+
+VOID
+MmpSplitLargePages (
+    PVOID VirtualAddress,
+    UINTN Size
+    )
+
+/*++
+
+Routine Description:
+
+    This routine splits any large pages in the given region of the current
+    process back into individual page mappings.
+
+Arguments:
+
+    VirtualAddress - Supplies the user mode virtual address of the region.
+
+    Size - Supplies the size of the region, in bytes.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    PVOID Current;
+    PVOID End;
+    PADDRESS_SPACE_X64 Space;
+
+    ASSERT(VirtualAddress + Size <= USER_VA_END);
+
+    Space = (PADDRESS_SPACE_X64)(PsGetCurrentProcess()->AddressSpace);
+    if (RED_BLACK_TREE_EMPTY(&(Space->LargePageTree)) != FALSE) {
+        return;
+    }
+
+    Current = ALIGN_POINTER_DOWN(VirtualAddress, X64_LARGE_PAGE_SIZE);
+    End = VirtualAddress + Size;
+    while (Current < End) {
+        if (((*X64_PML4E(Current) & X86_PTE_PRESENT) != 0) &&
+            ((*X64_PDPE(Current) & X86_PTE_PRESENT) != 0) &&
+            ((*X64_PDE(Current) & X86_PTE_LARGE) != 0)) {
+
+            MmpSplitLargePage(Space, Current, X64_PDE(Current));
+        }
+
+        Current += X64_LARGE_PAGE_SIZE;
+    }
+
+    return;
+}
+
 //
 // --------------------------------------------------------- Internal Functions
 //
@@ -2863,6 +3219,16 @@ Return Value:
         Index = ((UINTN)VirtualAddress >> EntryShift) & X64_PT_MASK;
         EntryShift -= X64_PTE_BITS;
         Pte = (PPTE)SwapPage + Index;
+
+        //
+        // Callers want the page table entry, so put the page table back if
+        // the region is mapped with a large page.
+        //
+
+        if ((Level == X64_PAGE_LEVEL - 1) && ((*Pte & X86_PTE_LARGE) != 0)) {
+            MmpSplitLargePage(AddressSpace, VirtualAddress, Pte);
+        }
+
         NextTable = X86_PTE_ENTRY(*Pte);
         if (NextTable == 0) {
             if (Create == FALSE) {
@@ -3180,3 +3546,132 @@ Return Value:
     return STATUS_SUCCESS;
 }
 
+BOOL
+MmpSplitLargePage (
+    PADDRESS_SPACE_X64 AddressSpace,
+    PVOID VirtualAddress,
+    volatile PTE *Pde
+    )
+
+/*++
+
+Routine Description:
+
+    This routine puts back the page table for a region mapped with a large
+    page. The page table still maps every page in the region the same way, so
+    this never allocates and can be called at dispatch level.
+
+Arguments:
+
+    AddressSpace - Supplies a pointer to the address space owning the region.
+
+    VirtualAddress - Supplies a virtual address within the region.
+
+    Pde - Supplies a pointer to the page directory entry for the region, either
+        through the self map or through the processor's swap page.
+
+Return Value:
+
+    TRUE if a large page was split.
+
+    FALSE if the region was not mapped with a large page by the time the lock
+    was acquired.
+
+--*/
+
+{
+
+    PLARGE_PAGE_ENTRY Entry;
+    PRED_BLACK_TREE_NODE FoundNode;
+    RUNLEVEL OldRunLevel;
+    LARGE_PAGE_ENTRY SearchEntry;
+
+    ASSERT(VirtualAddress < USER_VA_END);
+
+    VirtualAddress = ALIGN_POINTER_DOWN(VirtualAddress, X64_LARGE_PAGE_SIZE);
+    SearchEntry.VirtualAddress = VirtualAddress;
+    OldRunLevel = KeRaiseRunLevel(RunLevelDispatch);
+    KeAcquireSpinLock(&(AddressSpace->LargePageLock));
+    if ((*Pde & X86_PTE_LARGE) == 0) {
+        KeReleaseSpinLock(&(AddressSpace->LargePageLock));
+        KeLowerRunLevel(OldRunLevel);
+        return FALSE;
+    }
+
+    FoundNode = RtlRedBlackTreeSearch(&(AddressSpace->LargePageTree),
+                                      &(SearchEntry.TreeNode));
+
+    ASSERT(FoundNode != NULL);
+
+    Entry = RED_BLACK_TREE_VALUE(FoundNode, LARGE_PAGE_ENTRY, TreeNode);
+    RtlRedBlackTreeRemove(&(AddressSpace->LargePageTree), FoundNode);
+    *Pde = Entry->PageTable | X86_PTE_PRESENT | X86_PTE_WRITABLE |
+           X86_PTE_USER_MODE;
+
+    INSERT_BEFORE(&(Entry->ListEntry), &(AddressSpace->FreeLargePageList));
+    KeReleaseSpinLock(&(AddressSpace->LargePageLock));
+    KeLowerRunLevel(OldRunLevel);
+
+    //
+    // Flush the large translation, and the self map translation for the page
+    // table, which may still point at the first page of the large page.
+    //
+
+    MmpSendTlbInvalidateIpi(&(AddressSpace->Common), VirtualAddress, 1);
+    MmpSendTlbInvalidateIpi(&(AddressSpace->Common),
+                            X64_PT(VirtualAddress),
+                            1);
+
+    RtlAtomicAdd(&MmLargePageSplits, 1);
+    return TRUE;
+}
+
+COMPARISON_RESULT
+MmpCompareLargePageEntries (
+    PRED_BLACK_TREE Tree,
+    PRED_BLACK_TREE_NODE FirstNode,
+    PRED_BLACK_TREE_NODE SecondNode
+    )
+
+/*++
+
+Routine Description:
+
+    This routine compares two large page entries by virtual address.
+
+Arguments:
+
+    Tree - Supplies a pointer to the containing tree.
+
+    FirstNode - Supplies a pointer to the left side of the comparison.
+
+    SecondNode - Supplies a pointer to the second side of the comparison.
+
+Return Value:
+
+    Same if the two nodes have the same value.
+
+    Ascending if the first node is less than the second node.
+
+    Descending if the second node is less than the first node.
+
+--*/
+
+{
+
+    PLARGE_PAGE_ENTRY First;
+    PLARGE_PAGE_ENTRY Second;
+
+    First = RED_BLACK_TREE_VALUE(FirstNode, LARGE_PAGE_ENTRY, TreeNode);
+    Second = RED_BLACK_TREE_VALUE(SecondNode, LARGE_PAGE_ENTRY, TreeNode);
+    if (First->VirtualAddress < Second->VirtualAddress) {
+        return ComparisonResultAscending;
+    }
+
+    if (First->VirtualAddress > Second->VirtualAddress) {
+        return ComparisonResultDescending;
+    }
+
+    return ComparisonResultSame;
+}
+
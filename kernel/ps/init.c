@@ -259,7 +259,10 @@ Return Value:
                               SystemDirectorySize);
             }
 
-            PspInitializeUserLocking();
+            Status = PspInitializeUserLocking();
+            if (!KSUCCESS(Status)) {
+                goto InitializeEnd;
+            }
 
         } else {
             KernelProcess = PsKernelProcess;
@@ -635,6 +638,12 @@ Return Value:
     CurrentThread->State = ThreadStateRunning;
     CurrentThread->SchedulerEntry.Type = SchedulerEntryThread;
     CurrentThread->SchedulerEntry.Parent = &(Processor->Scheduler.Group.Entry);
+    CurrentThread->SchedulerEntry.Parameters.Policy = SchedulerPolicyFair;
+    CurrentThread->SchedulerEntry.Weight = SCHEDULER_NICE_ZERO_WEIGHT;
+    RtlSetMemory(&(CurrentThread->SchedulerEntry.Affinity),
+                 0xFF,
+                 sizeof(PROCESSOR_AFFINITY));
+
     CurrentThread->ThreadPointer = PsInitialThreadPointer;
     CurrentThread->BuiltinWaitBlock = ObCreateWaitBlock(0);
     if (CurrentThread->BuiltinWaitBlock == NULL) {
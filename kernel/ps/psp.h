@@ -1385,7 +1385,7 @@ Return Value:
 
 --*/
 
-VOID
+KSTATUS
 PspInitializeUserLocking (
     VOID
     );
@@ -1402,7 +1402,7 @@ Routine Description:
 
 Return Value:
 
-    None.
+    Status code.
 
 --*/
 
@@ -114,6 +114,15 @@ PspGetThreadInformation (
     PULONG BufferSize
     );
 
+KSTATUS
+PspFindSchedulingTarget (
+    PROCESS_ID_TYPE Type,
+    PROCESS_ID Id,
+    PKPROCESS *Process,
+    PKTHREAD *Thread,
+    PBOOL PermissionNeeded
+    );
+
 //
 // ------------------------------------------------------ Data Type Definitions
 //
@@ -779,6 +788,239 @@ Return Value:
     return STATUS_SUCCESS;
 }
 
+INTN
+PsSysSetSchedulingParameters (
+    PVOID SystemCallParameter
+    )
+
+/*++
+
+Routine Description:
+
+    This routine implements the system call that gets or sets the scheduling
+    policy and priorities of a thread or process.
+
+Arguments:
+
+    SystemCallParameter - Supplies a pointer to the parameters supplied with
+        the system call. This structure will be a stack-local copy of the
+        actual parameters passed from user-mode.
+
+Return Value:
+
+    STATUS_SUCCESS or positive integer on success.
+
+    Error status code on failure.
+
+--*/
+
+{
+
+    PLIST_ENTRY CurrentEntry;
+    PKTHREAD CurrentThread;
+    SCHEDULER_PARAMETERS NewParameters;
+    SCHEDULER_PARAMETERS OldParameters;
+    PSYSTEM_CALL_SET_SCHEDULING_PARAMETERS Parameters;
+    BOOL PermissionNeeded;
+    PKPROCESS Process;
+    PKTHREAD ProcessThread;
+    KSTATUS Status;
+    PKTHREAD Thread;
+
+    CurrentThread = KeGetCurrentThread();
+    Parameters = SystemCallParameter;
+    RtlCopyMemory(&NewParameters,
+                  &(Parameters->Parameters),
+                  sizeof(SCHEDULER_PARAMETERS));
+
+    Status = PspFindSchedulingTarget(Parameters->Type,
+                                     Parameters->Id,
+                                     &Process,
+                                     &Thread,
+                                     &PermissionNeeded);
+
+    if (!KSUCCESS(Status)) {
+        return Status;
+    }
+
+    RtlCopyMemory(&OldParameters,
+                  &(Thread->SchedulerEntry.Parameters),
+                  sizeof(SCHEDULER_PARAMETERS));
+
+    RtlCopyMemory(&(Parameters->Parameters),
+                  &OldParameters,
+                  sizeof(SCHEDULER_PARAMETERS));
+
+    if (Parameters->Set == FALSE) {
+        Status = STATUS_SUCCESS;
+        goto SysSetSchedulingParametersEnd;
+    }
+
+    //
+    // Moving to a real-time policy or raising the real-time priority always
+    // requires the scheduling permission. Lowering the nice value requires it
+    // beyond what the nice resource limit allows.
+    //
+
+    if ((NewParameters.Policy == SchedulerPolicyFifo) ||
+        (NewParameters.Policy == SchedulerPolicyRoundRobin)) {
+
+        if ((OldParameters.Policy == SchedulerPolicyFair) ||
+            (NewParameters.RealTimePriority > OldParameters.RealTimePriority)) {
+
+            PermissionNeeded = TRUE;
+        }
+    }
+
+    if (NewParameters.NiceValue < OldParameters.NiceValue) {
+        if ((UINTN)(-SCHEDULER_NICE_MIN - NewParameters.NiceValue) >
+            CurrentThread->Limits[ResourceLimitNice].Current) {
+
+            PermissionNeeded = TRUE;
+        }
+    }
+
+    if (PermissionNeeded != FALSE) {
+        Status = PsCheckPermission(PERMISSION_SCHEDULING);
+        if (!KSUCCESS(Status)) {
+            goto SysSetSchedulingParametersEnd;
+        }
+    }
+
+    //
+    // Apply the new parameters to the thread, or every thread in the process.
+    // The parameters are validated before anything changes, so if the first
+    // thread succeeds the rest will too.
+    //
+
+    if (Process == NULL) {
+        Status = KeSetThreadSchedulingParameters(Thread, &NewParameters);
+
+    } else {
+        Status = STATUS_SUCCESS;
+        CurrentEntry = Process->ThreadListHead.Next;
+        while (CurrentEntry != &(Process->ThreadListHead)) {
+            ProcessThread = LIST_VALUE(CurrentEntry, KTHREAD, ProcessEntry);
+            CurrentEntry = CurrentEntry->Next;
+            Status = KeSetThreadSchedulingParameters(ProcessThread,
+                                                     &NewParameters);
+
+            if (!KSUCCESS(Status)) {
+                break;
+            }
+        }
+    }
+
+SysSetSchedulingParametersEnd:
+    ObReleaseReference(Thread);
+    if (Process != NULL) {
+        KeReleaseQueuedLock(Process->QueuedLock);
+        ObReleaseReference(Process);
+    }
+
+    return Status;
+}
+
+INTN
+PsSysSetThreadAffinity (
+    PVOID SystemCallParameter
+    )
+
+/*++
+
+Routine Description:
+
+    This routine implements the system call that gets or sets the set of
+    processors a thread or process is allowed to run on.
+
+Arguments:
+
+    SystemCallParameter - Supplies a pointer to the parameters supplied with
+        the system call. This structure will be a stack-local copy of the
+        actual parameters passed from user-mode.
+
+Return Value:
+
+    STATUS_SUCCESS or positive integer on success.
+
+    Error status code on failure.
+
+--*/
+
+{
+
+    PLIST_ENTRY CurrentEntry;
+    PROCESSOR_AFFINITY NewAffinity;
+    PSYSTEM_CALL_SET_THREAD_AFFINITY Parameters;
+    BOOL PermissionNeeded;
+    PKPROCESS Process;
+    PKTHREAD ProcessThread;
+    KSTATUS Status;
+    PKTHREAD Thread;
+
+    Parameters = SystemCallParameter;
+    RtlCopyMemory(&NewAffinity,
+                  &(Parameters->Affinity),
+                  sizeof(PROCESSOR_AFFINITY));
+
+    Status = PspFindSchedulingTarget(Parameters->Type,
+                                     Parameters->Id,
+                                     &Process,
+                                     &Thread,
+                                     &PermissionNeeded);
+
+    if (!KSUCCESS(Status)) {
+        return Status;
+    }
+
+    RtlCopyMemory(&(Parameters->Affinity),
+                  &(Thread->SchedulerEntry.Affinity),
+                  sizeof(PROCESSOR_AFFINITY));
+
+    if (Parameters->Set == FALSE) {
+        Status = STATUS_SUCCESS;
+        goto SysSetThreadAffinityEnd;
+    }
+
+    if (PermissionNeeded != FALSE) {
+        Status = PsCheckPermission(PERMISSION_SCHEDULING);
+        if (!KSUCCESS(Status)) {
+            goto SysSetThreadAffinityEnd;
+        }
+    }
+
+    //
+    // Apply the new affinity to the thread, or every thread in the process.
+    // The affinity is validated before anything changes, so if the first
+    // thread succeeds the rest will too.
+    //
+
+    if (Process == NULL) {
+        Status = KeSetThreadAffinity(Thread, &NewAffinity);
+
+    } else {
+        Status = STATUS_SUCCESS;
+        CurrentEntry = Process->ThreadListHead.Next;
+        while (CurrentEntry != &(Process->ThreadListHead)) {
+            ProcessThread = LIST_VALUE(CurrentEntry, KTHREAD, ProcessEntry);
+            CurrentEntry = CurrentEntry->Next;
+            Status = KeSetThreadAffinity(ProcessThread, &NewAffinity);
+            if (!KSUCCESS(Status)) {
+                break;
+            }
+        }
+    }
+
+SysSetThreadAffinityEnd:
+    ObReleaseReference(Thread);
+    if (Process != NULL) {
+        KeReleaseQueuedLock(Process->QueuedLock);
+        ObReleaseReference(Process);
+    }
+
+    return Status;
+}
+
 VOID
 PsQueueThreadCleanup (
     PKTHREAD Thread
@@ -1581,6 +1823,29 @@ Return Value:
     NewThread->SignalPending = ThreadNoSignalPending;
     NewThread->SchedulerEntry.Type = SchedulerEntryThread;
     NewThread->SchedulerEntry.Parent = CurrentThread->SchedulerEntry.Parent;
+    RtlCopyMemory(&(NewThread->SchedulerEntry.Parameters),
+                  &(CurrentThread->SchedulerEntry.Parameters),
+                  sizeof(SCHEDULER_PARAMETERS));
+
+    NewThread->SchedulerEntry.Weight = CurrentThread->SchedulerEntry.Weight;
+
+    //
+    // Threads inherit the processor affinity of their creator, except that
+    // kernel threads created on behalf of a user thread can run anywhere.
+    //
+
+    if ((OwningProcess != PsKernelProcess) ||
+        (CurrentThread->OwningProcess == PsKernelProcess)) {
+        RtlCopyMemory(&(NewThread->SchedulerEntry.Affinity),
+                      &(CurrentThread->SchedulerEntry.Affinity),
+                      sizeof(PROCESSOR_AFFINITY));
+
+    } else {
+        RtlSetMemory(&(NewThread->SchedulerEntry.Affinity),
+                     0xFF,
+                     sizeof(PROCESSOR_AFFINITY));
+    }
+
     NewThread->ThreadPointer = PsInitialThreadPointer;
 
     //
@@ -2150,3 +2415,154 @@ Return Value:
     return Status;
 }
 
+KSTATUS
+PspFindSchedulingTarget (
+    PROCESS_ID_TYPE Type,
+    PROCESS_ID Id,
+    PKPROCESS *Process,
+    PKTHREAD *Thread,
+    PBOOL PermissionNeeded
+    )
+
+/*++
+
+Routine Description:
+
+    This routine finds the thread or process targeted by a system call that
+    changes scheduling attributes.
+
+Arguments:
+
+    Type - Supplies the type of identifier. Valid values are ProcessIdProcess
+        and ProcessIdThread.
+
+    Id - Supplies the process or thread ID. Zero means the current process or
+        thread.
+
+    Process - Supplies a pointer where a pointer to the targeted process will
+        be returned with a reference added and its lock held, or NULL if a
+        single thread is targeted.
+
+    Thread - Supplies a pointer where a pointer to the targeted thread will be
+        returned with a reference added. For a process this is the current
+        thread if it's in the process, or else the process' first thread.
+
+    PermissionNeeded - Supplies a pointer where a boolean will be returned
+        indicating whether the target belongs to another user, in which case
+        changes require the scheduling permission.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    PKPROCESS CurrentProcess;
+    PKTHREAD CurrentThread;
+    THREAD_IDENTITY Identity;
+    BOOL LockHeld;
+    PKPROCESS TargetProcess;
+    PKTHREAD TargetThread;
+    KSTATUS Status;
+
+    CurrentThread = KeGetCurrentThread();
+    CurrentProcess = CurrentThread->OwningProcess;
+    LockHeld = FALSE;
+    TargetProcess = NULL;
+    TargetThread = NULL;
+    *PermissionNeeded = FALSE;
+    switch (Type) {
+    case ProcessIdProcess:
+        if ((Id == 0) || (Id == CurrentProcess->Identifiers.ProcessId)) {
+            TargetProcess = CurrentProcess;
+            ObAddReference(TargetProcess);
+
+        } else {
+            TargetProcess = PspGetProcessById(Id);
+            if (TargetProcess == NULL) {
+                Status = STATUS_NO_SUCH_PROCESS;
+                goto FindSchedulingTargetEnd;
+            }
+
+            //
+            // Changing another user's process requires the scheduling
+            // permission.
+            //
+
+            Status = PspGetProcessIdentity(TargetProcess, &Identity);
+            if (!KSUCCESS(Status)) {
+                goto FindSchedulingTargetEnd;
+            }
+
+            if ((CurrentThread->Identity.EffectiveUserId !=
+                 Identity.EffectiveUserId) &&
+                (CurrentThread->Identity.EffectiveUserId !=
+                 Identity.RealUserId)) {
+
+                *PermissionNeeded = TRUE;
+            }
+        }
+
+        //
+        // Hold the process lock so the thread list stays put.
+        //
+
+        KeAcquireQueuedLock(TargetProcess->QueuedLock);
+        LockHeld = TRUE;
+        if (TargetProcess == CurrentProcess) {
+            TargetThread = CurrentThread;
+
+        } else if (LIST_EMPTY(&(TargetProcess->ThreadListHead)) == FALSE) {
+            TargetThread = LIST_VALUE(TargetProcess->ThreadListHead.Next,
+                                      KTHREAD,
+                                      ProcessEntry);
+
+        } else {
+            Status = STATUS_NO_SUCH_PROCESS;
+            goto FindSchedulingTargetEnd;
+        }
+
+        ObAddReference(TargetThread);
+        break;
+
+    case ProcessIdThread:
+        if ((Id == 0) || (Id == CurrentThread->ThreadId)) {
+            TargetThread = CurrentThread;
+            ObAddReference(TargetThread);
+
+        } else {
+            TargetThread = PspGetThreadById(CurrentProcess, Id);
+            if (TargetThread == NULL) {
+                Status = STATUS_NO_SUCH_THREAD;
+                goto FindSchedulingTargetEnd;
+            }
+        }
+
+        break;
+
+    default:
+        Status = STATUS_NOT_SUPPORTED;
+        goto FindSchedulingTargetEnd;
+    }
+
+    Status = STATUS_SUCCESS;
+
+FindSchedulingTargetEnd:
+    if (!KSUCCESS(Status)) {
+        if (LockHeld != FALSE) {
+            KeReleaseQueuedLock(TargetProcess->QueuedLock);
+        }
+
+        if (TargetProcess != NULL) {
+            ObReleaseReference(TargetProcess);
+            TargetProcess = NULL;
+        }
+    }
+
+    *Process = TargetProcess;
+    *Thread = TargetThread;
+    return Status;
+}
+
@@ -36,6 +36,14 @@ Module Name:
 // ---------------------------------------------------------------- Definitions
 //
 
+//
+// Define the number of hash buckets user locks are spread across. Each bucket
+// has its own lock, so unrelated addresses rarely contend with each other.
+//
+
+#define USER_LOCK_HASH_SHIFT 8
+#define USER_LOCK_BUCKET_COUNT (1 << USER_LOCK_HASH_SHIFT)
+
 //
 // ------------------------------------------------------ Data Type Definitions
 //
@@ -49,6 +57,26 @@ typedef enum _USER_LOCK_TYPE {
 
 /*++
 
+Structure Description:
+
+    This structure defines a bucket of the user lock hash table.
+
+Members:
+
+    Lock - Stores a pointer to the lock protecting the bucket.
+
+    WaiterList - Stores the head of the list of user locks (waiters) whose
+        keys hash to this bucket, in the order they started waiting.
+
+--*/
+
+typedef struct _USER_LOCK_BUCKET {
+    PQUEUED_LOCK Lock;
+    LIST_ENTRY WaiterList;
+} USER_LOCK_BUCKET, *PUSER_LOCK_BUCKET;
+
+/*++
+
 Structure Description:
 
     This structure defines a user mode lock, which is basically just a wait
@@ -56,18 +84,25 @@ Structure Description:
 
 Members:
 
-    TreeNode - Stores the accounting structure for keeping the entry in a
-        Red-Black tree.
+    ListEntry - Stores pointers to the next and previous waiters in the hash
+        bucket.
+
+    Bucket - Stores a pointer to the hash bucket the lock is currently queued
+        in, or NULL if it is not queued. A requeue operation may move a waiter
+        to a different bucket, and a wake operation sets this to NULL once it
+        is completely done touching the lock.
 
-    Object - Stores a pointer to the object this lock is tied to. This is a
+    KeyObject - Stores a pointer to the object identifying the lock. This is a
         process for a process local lock, an image section for a lock in a
         private memory region, or a file object in a shared memory region.
 
-    Offset - Stores either 1) the offset into the file object, 2) the offset
-        into the image section, or 3) the user mode address in the process
-        address space, depending on the type of lock.
+    KeyOffset - Stores either 1) the offset into the file object, 2) the
+        offset into the image section, or 3) the user mode address in the
+        process address space, depending on the type of lock.
 
-    ReferenceCount - Stores the reference count of the object.
+    Object - Stores a pointer to the object a reference was taken on when the
+        lock was initialized. This matches the key object unless the waiter was
+        requeued.
 
     Type - Stores the object type, used when trying to release the lock.
 
@@ -76,9 +111,11 @@ Structure Description:
 --*/
 
 typedef struct _USER_LOCK {
-    RED_BLACK_TREE_NODE TreeNode;
+    LIST_ENTRY ListEntry;
+    PUSER_LOCK_BUCKET volatile Bucket;
+    PVOID KeyObject;
+    UINTN KeyOffset;
     PVOID Object;
-    UINTN Offset;
     USER_LOCK_TYPE Type;
     WAIT_QUEUE WaitQueue;
 } USER_LOCK, *PUSER_LOCK;
@@ -93,7 +130,7 @@ PspUserLockWait (
     );
 
 KSTATUS
-PspUserLockWake (
+PspUserLockRequeue (
     PSYSTEM_CALL_USER_LOCK Parameters
     );
 
@@ -109,19 +146,28 @@ PspReleaseUserLockObject (
     PUSER_LOCK Lock
     );
 
-COMPARISON_RESULT
-PspCompareUserLocks (
-    PRED_BLACK_TREE Tree,
-    PRED_BLACK_TREE_NODE FirstNode,
-    PRED_BLACK_TREE_NODE SecondNode
+PUSER_LOCK_BUCKET
+PspGetUserLockBucket (
+    PUSER_LOCK Lock
+    );
+
+VOID
+PspAcquireUserLockBuckets (
+    PUSER_LOCK_BUCKET First,
+    PUSER_LOCK_BUCKET Second
+    );
+
+VOID
+PspReleaseUserLockBuckets (
+    PUSER_LOCK_BUCKET First,
+    PUSER_LOCK_BUCKET Second
     );
 
 //
 // -------------------------------------------------------------------- Globals
 //
 
-PQUEUED_LOCK PsUserLockLock;
-RED_BLACK_TREE PsUserLockTree;
+USER_LOCK_BUCKET PsUserLockBuckets[USER_LOCK_BUCKET_COUNT];
 
 //
 // ------------------------------------------------------------------ Functions
@@ -169,6 +215,10 @@ Return Value:
         Status = PspUserLockWake(Parameters);
         break;
 
+    case UserLockRequeue:
+        Status = PspUserLockRequeue(Parameters);
+        break;
+
     default:
         Status = STATUS_INVALID_PARAMETER;
         break;
@@ -177,7 +227,7 @@ Return Value:
     return Status;
 }
 
-VOID
+KSTATUS
 PspInitializeUserLocking (
     VOID
     )
@@ -194,18 +244,26 @@ Routine Description:
 
 Return Value:
 
-    None.
+    Status code.
 
 --*/
 
 {
 
-    PsUserLockLock = KeCreateQueuedLock();
+    PUSER_LOCK_BUCKET Bucket;
+    ULONG Index;
 
-    ASSERT(PsUserLockLock != NULL);
+    for (Index = 0; Index < USER_LOCK_BUCKET_COUNT; Index += 1) {
+        Bucket = &(PsUserLockBuckets[Index]);
+        Bucket->Lock = KeCreateQueuedLock();
+        if (Bucket->Lock == NULL) {
+            return STATUS_INSUFFICIENT_RESOURCES;
+        }
 
-    RtlRedBlackTreeInitialize(&PsUserLockTree, 0, PspCompareUserLocks);
-    return;
+        INITIALIZE_LIST_HEAD(&(Bucket->WaiterList));
+    }
+
+    return STATUS_SUCCESS;
 }
 
 KSTATUS
@@ -231,8 +289,9 @@ Return Value:
 
 {
 
+    PUSER_LOCK_BUCKET Bucket;
+    PLIST_ENTRY CurrentEntry;
     PUSER_LOCK FoundLock;
-    PRED_BLACK_TREE_NODE FoundNode;
     USER_LOCK Lock;
     BOOL Private;
     ULONG ProcessesReleased;
@@ -249,40 +308,44 @@ Return Value:
     }
 
     //
-    // Release the specified number of processes.
+    // Release the specified number of processes, oldest waiters first.
     //
 
     ProcessesReleased = 0;
-    KeAcquireQueuedLock(PsUserLockLock);
-    while (Parameters->Value != 0) {
-        FoundNode = RtlRedBlackTreeSearch(&PsUserLockTree, &(Lock.TreeNode));
-        if (FoundNode == NULL) {
-            break;
+    Bucket = PspGetUserLockBucket(&Lock);
+    KeAcquireQueuedLock(Bucket->Lock);
+    CurrentEntry = Bucket->WaiterList.Next;
+    while ((Parameters->Value != 0) && (CurrentEntry != &(Bucket->WaiterList))) {
+        FoundLock = LIST_VALUE(CurrentEntry, USER_LOCK, ListEntry);
+        CurrentEntry = CurrentEntry->Next;
+        if ((FoundLock->KeyObject != Lock.KeyObject) ||
+            (FoundLock->KeyOffset != Lock.KeyOffset)) {
+
+            continue;
         }
 
         //
-        // Remove it from the tree first. The locks are stack allocated, so as
-        // soon as the thread is made ready the memory could go invalid.
+        // Remove it from the bucket first. The locks are stack allocated, so
+        // as soon as the thread is made ready the memory could go invalid.
         //
 
-        FoundLock = RED_BLACK_TREE_VALUE(FoundNode, USER_LOCK, TreeNode);
-        RtlRedBlackTreeRemove(&PsUserLockTree, FoundNode);
+        LIST_REMOVE(&(FoundLock->ListEntry));
         ObSignalQueue(&(FoundLock->WaitQueue), SignalOptionSignalAll);
 
         //
         // The object can go away as soon as it's known to be removed from the
-        // tree. Make sure this thread is done touching the object before
+        // bucket. Make sure this thread is done touching the object before
         // indicating to the woken thread that it can destroy this memory.
         //
 
-        FoundNode->Parent = NULL;
+        FoundLock->Bucket = NULL;
         ProcessesReleased += 1;
         if (Parameters->Value != MAX_ULONG) {
             Parameters->Value -= 1;
         }
     }
 
-    KeReleaseQueuedLock(PsUserLockLock);
+    KeReleaseQueuedLock(Bucket->Lock);
     PspReleaseUserLockObject(&Lock);
     Parameters->Value = ProcessesReleased;
     return STATUS_SUCCESS;
@@ -315,6 +378,7 @@ Return Value:
 
 {
 
+    PUSER_LOCK_BUCKET Bucket;
     ULONGLONG ElapsedTimeInMilliseconds;
     ULONGLONG EndTime;
     ULONGLONG Frequency;
@@ -335,7 +399,8 @@ Return Value:
     }
 
     ObInitializeWaitQueue(&(Lock.WaitQueue), NotSignaled);
-    KeAcquireQueuedLock(PsUserLockLock);
+    Bucket = PspGetUserLockBucket(&Lock);
+    KeAcquireQueuedLock(Bucket->Lock);
 
     //
     // If the read failed, then bail out.
@@ -360,11 +425,12 @@ Return Value:
 
         } else {
             Status = STATUS_SUCCESS;
-            RtlRedBlackTreeInsert(&PsUserLockTree, &(Lock.TreeNode));
+            INSERT_BEFORE(&(Lock.ListEntry), &(Bucket->WaiterList));
+            Lock.Bucket = Bucket;
         }
     }
 
-    KeReleaseQueuedLock(PsUserLockLock);
+    KeReleaseQueuedLock(Bucket->Lock);
     if (!KSUCCESS(Status)) {
         goto UserLockWaitEnd;
     }
@@ -410,18 +476,21 @@ Return Value:
     }
 
     //
-    // Remove the object from the tree, racing with the parent who may
-    // have already done it to save the extra lock acquire.
+    // Remove the object from its bucket, racing with the waker who may have
+    // already done it to save the extra lock acquire. A requeue may have moved
+    // the lock to a different bucket while this thread was acquiring the
+    // bucket lock, in which case try again with the new bucket.
     //
 
-    if (Lock.TreeNode.Parent != NULL) {
-        KeAcquireQueuedLock(PsUserLockLock);
-        if (Lock.TreeNode.Parent != NULL) {
-            RtlRedBlackTreeRemove(&PsUserLockTree, &(Lock.TreeNode));
-            Lock.TreeNode.Parent = NULL;
+    while (Lock.Bucket != NULL) {
+        Bucket = Lock.Bucket;
+        KeAcquireQueuedLock(Bucket->Lock);
+        if (Lock.Bucket == Bucket) {
+            LIST_REMOVE(&(Lock.ListEntry));
+            Lock.Bucket = NULL;
         }
 
-        KeReleaseQueuedLock(PsUserLockLock);
+        KeReleaseQueuedLock(Bucket->Lock);
     }
 
 UserLockWaitEnd:
@@ -429,6 +498,144 @@ Return Value:
     return Status;
 }
 
+KSTATUS
+PspUserLockRequeue (
+    PSYSTEM_CALL_USER_LOCK Parameters
+    )
+
+/*++
+
+Routine Description:
+
+    This routine wakes some of the threads blocked on the given user mode
+    address, and moves some or all of the rest to wait on a second address
+    without waking them. This allows a condition variable broadcast to wake a
+    single thread and hand the rest off to the mutex, rather than having them
+    all wake up only to fight over the mutex.
+
+Arguments:
+
+    Parameters - Supplies a pointer to the requeue parameters.
+
+Return Value:
+
+    STATUS_SUCCESS on success.
+
+    STATUS_OPERATION_WOULD_BLOCK if the value at the source address did not
+    match the compare value.
+
+    Other error codes on failure.
+
+--*/
+
+{
+
+    PLIST_ENTRY CurrentEntry;
+    PUSER_LOCK FoundLock;
+    BOOL Private;
+    ULONG Requeued;
+    PUSER_LOCK_BUCKET Source;
+    USER_LOCK SourceLock;
+    KSTATUS Status;
+    PUSER_LOCK_BUCKET Target;
+    USER_LOCK TargetLock;
+    ULONG UserValue;
+    ULONG Woken;
+
+    Private = FALSE;
+    if ((Parameters->Operation & USER_LOCK_PRIVATE) != 0) {
+        Private = TRUE;
+    }
+
+    Status = PspInitializeUserLock(Parameters->Address, Private, &SourceLock);
+    if (!KSUCCESS(Status)) {
+        return Status;
+    }
+
+    Status = PspInitializeUserLock(Parameters->RequeueAddress,
+                                   Private,
+                                   &TargetLock);
+
+    if (!KSUCCESS(Status)) {
+        PspReleaseUserLockObject(&SourceLock);
+        return Status;
+    }
+
+    Woken = 0;
+    Requeued = 0;
+    Source = PspGetUserLockBucket(&SourceLock);
+    Target = PspGetUserLockBucket(&TargetLock);
+    PspAcquireUserLockBuckets(Source, Target);
+
+    //
+    // Fail if the source value changed since the caller looked at it, as
+    // something else happened in the meantime that the caller needs to look
+    // at before handing off waiters.
+    //
+
+    if (MmUserRead32(Parameters->Address, &UserValue) == FALSE) {
+        Status = STATUS_ACCESS_VIOLATION;
+        goto UserLockRequeueEnd;
+    }
+
+    if (UserValue != Parameters->CompareValue) {
+        Status = STATUS_OPERATION_WOULD_BLOCK;
+        goto UserLockRequeueEnd;
+    }
+
+    CurrentEntry = Source->WaiterList.Next;
+    while (CurrentEntry != &(Source->WaiterList)) {
+        FoundLock = LIST_VALUE(CurrentEntry, USER_LOCK, ListEntry);
+        CurrentEntry = CurrentEntry->Next;
+        if ((FoundLock->KeyObject != SourceLock.KeyObject) ||
+            (FoundLock->KeyOffset != SourceLock.KeyOffset)) {
+
+            continue;
+        }
+
+        //
+        // Wake the first few waiters, being careful not to touch them after
+        // indicating they are free to go.
+        //
+
+        if (Woken < Parameters->Value) {
+            LIST_REMOVE(&(FoundLock->ListEntry));
+            ObSignalQueue(&(FoundLock->WaitQueue), SignalOptionSignalAll);
+            FoundLock->Bucket = NULL;
+            Woken += 1;
+
+        //
+        // Move the rest over to the target key. The waiter keeps the
+        // reference it took on its original object, so only the key changes.
+        // If the target object were to be destroyed and its key reused while
+        // the waiter is still queued, the worst outcome is a spurious wake,
+        // which user mode must tolerate anyway.
+        //
+
+        } else if (Requeued < Parameters->RequeueCount) {
+            LIST_REMOVE(&(FoundLock->ListEntry));
+            FoundLock->KeyObject = TargetLock.KeyObject;
+            FoundLock->KeyOffset = TargetLock.KeyOffset;
+            INSERT_BEFORE(&(FoundLock->ListEntry), &(Target->WaiterList));
+            FoundLock->Bucket = Target;
+            Requeued += 1;
+
+        } else {
+            break;
+        }
+    }
+
+    Status = STATUS_SUCCESS;
+
+UserLockRequeueEnd:
+    PspReleaseUserLockBuckets(Source, Target);
+    PspReleaseUserLockObject(&SourceLock);
+    PspReleaseUserLockObject(&TargetLock);
+    Parameters->Value = Woken;
+    Parameters->RequeueCount = Requeued;
+    return Status;
+}
+
 KSTATUS
 PspInitializeUserLock (
     PVOID Address,
@@ -463,13 +670,17 @@ Return Value:
 
     BOOL Shared;
 
+    Lock->Bucket = NULL;
     if (Private != FALSE) {
         Lock->Object = PsGetCurrentProcess();
-        Lock->Offset = (UINTN)Address;
+        Lock->KeyOffset = (UINTN)Address;
         Lock->Type = UserLockTypeProcess;
 
     } else {
-        Lock->Object = MmGetObjectForAddress(Address, &(Lock->Offset), &Shared);
+        Lock->Object = MmGetObjectForAddress(Address,
+                                             &(Lock->KeyOffset),
+                                             &Shared);
+
         if (Lock->Object == NULL) {
             return STATUS_ACCESS_VIOLATION;
         }
@@ -482,6 +693,7 @@ Return Value:
         }
     }
 
+    Lock->KeyObject = Lock->Object;
     return STATUS_SUCCESS;
 }
 
@@ -537,62 +749,116 @@ Return Value:
     return;
 }
 
-COMPARISON_RESULT
-PspCompareUserLocks (
-    PRED_BLACK_TREE Tree,
-    PRED_BLACK_TREE_NODE FirstNode,
-    PRED_BLACK_TREE_NODE SecondNode
+PUSER_LOCK_BUCKET
+PspGetUserLockBucket (
+    PUSER_LOCK Lock
     )
 
 /*++
 
 Routine Description:
 
-    This routine compares two Red-Black tree nodes that in this case are user
-    mode lock objects.
+    This routine returns the hash bucket for the given user lock key.
 
 Arguments:
 
-    Tree - Supplies a pointer to the Red-Black tree that owns both nodes.
+    Lock - Supplies a pointer to the initialized user lock.
+
+Return Value:
 
-    FirstNode - Supplies a pointer to the left side of the comparison.
+    Returns a pointer to the bucket.
 
-    SecondNode - Supplies a pointer to the second side of the comparison.
+--*/
 
-Return Value:
+{
+
+    ULONG Hash;
 
-    Same if the two nodes have the same value.
+    //
+    // Mix the object pointer and offset, then use the top bits of a
+    // multiplicative hash, which are the best distributed.
+    //
 
-    Ascending if the first node is less than the second node.
+    Hash = (ULONG)(((UINTN)(Lock->KeyObject) >> 4) ^ (Lock->KeyOffset >> 2));
+    Hash *= 0x9E3779B1;
+    return &(PsUserLockBuckets[Hash >> (32 - USER_LOCK_HASH_SHIFT)]);
+}
 
-    Descending if the second node is less than the first node.
+VOID
+PspAcquireUserLockBuckets (
+    PUSER_LOCK_BUCKET First,
+    PUSER_LOCK_BUCKET Second
+    )
+
+/*++
+
+Routine Description:
+
+    This routine acquires the locks for two buckets, in address order to avoid
+    deadlocking with another thread acquiring the same pair.
+
+Arguments:
+
+    First - Supplies a pointer to the first bucket.
+
+    Second - Supplies a pointer to the second bucket, which may be the same as
+        the first.
+
+Return Value:
+
+    None.
 
 --*/
 
 {
 
-    PUSER_LOCK FirstLock;
-    PUSER_LOCK SecondLock;
+    if (First == Second) {
+        KeAcquireQueuedLock(First->Lock);
 
-    //
-    // Compare raw pointers to the objects first.
-    //
+    } else if (First < Second) {
+        KeAcquireQueuedLock(First->Lock);
+        KeAcquireQueuedLock(Second->Lock);
 
-    FirstLock = RED_BLACK_TREE_VALUE(FirstNode, USER_LOCK, TreeNode);
-    SecondLock = RED_BLACK_TREE_VALUE(SecondNode, USER_LOCK, TreeNode);
-    if (FirstLock->Object < SecondLock->Object) {
-        return ComparisonResultAscending;
+    } else {
+        KeAcquireQueuedLock(Second->Lock);
+        KeAcquireQueuedLock(First->Lock);
+    }
 
-    } else if (FirstLock->Object > SecondLock->Object) {
-        return ComparisonResultDescending;
+    return;
+}
 
-    } else if (FirstLock->Offset > SecondLock->Offset) {
-        return ComparisonResultDescending;
+VOID
+PspReleaseUserLockBuckets (
+    PUSER_LOCK_BUCKET First,
+    PUSER_LOCK_BUCKET Second
+    )
+
+/*++
+
+Routine Description:
+
+    This routine releases the locks for two buckets acquired together.
+
+Arguments:
+
+    First - Supplies a pointer to the first bucket.
+
+    Second - Supplies a pointer to the second bucket, which may be the same as
+        the first.
 
-    } else if (FirstLock->Offset < SecondLock->Offset) {
-        return ComparisonResultAscending;
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    KeReleaseQueuedLock(First->Lock);
+    if (Second != First) {
+        KeReleaseQueuedLock(Second->Lock);
     }
 
-    return ComparisonResultSame;
+    return;
 }
 
@@ -1181,6 +1181,11 @@ Return Value:
 
 {
 
+    ULONG ApicId;
+    ULONG CacheEax;
+    ULONG CacheEbx;
+    ULONG CacheEcx;
+    ULONG CacheEdx;
     ULONG Eax;
     ULONG Ebx;
     ULONG Ecx;
@@ -1188,8 +1193,14 @@ Return Value:
     ULONG ExtendedFamily;
     ULONG ExtendedModel;
     ULONG Family;
+    ULONG HighestLevel;
     PPROCESSOR_IDENTIFICATION Identification;
+    ULONG Index;
+    ULONG Level;
+    ULONG MaxLeaf;
     ULONG Model;
+    ULONG Sharing;
+    ULONG Shift;
 
     Identification = &(ProcessorBlock->CpuVersion);
 
@@ -1200,7 +1211,8 @@ Return Value:
     Eax = X86_CPUID_IDENTIFICATION;
     ArCpuid(&Eax, &Ebx, &Ecx, &Edx);
     Identification->Vendor = Ebx;
-    if (Eax < X86_CPUID_BASIC_INFORMATION) {
+    MaxLeaf = Eax;
+    if (MaxLeaf < X86_CPUID_BASIC_INFORMATION) {
         return;
     }
 
@@ -1248,6 +1260,53 @@ Return Value:
         }
     }
 
+    //
+    // Figure out which processors share this one's last level cache so that
+    // the scheduler can prefer migrating threads between them. Processors
+    // sharing a cache have APIC IDs that differ only in the low bits, and
+    // the cache parameters leaf reports how many logical processors share
+    // each level. Fall back to the package if that leaf is not available.
+    //
+
+    ApicId = (Ebx & X86_CPUID_BASIC_EBX_APIC_ID_MASK) >>
+             X86_CPUID_BASIC_EBX_APIC_ID_SHIFT;
+
+    Sharing = 1;
+    if ((Edx & X86_CPUID_BASIC_EDX_HYPERTHREADING) != 0) {
+        Sharing = (Ebx & X86_CPUID_BASIC_EBX_LOGICAL_COUNT_MASK) >>
+                  X86_CPUID_BASIC_EBX_LOGICAL_COUNT_SHIFT;
+    }
+
+    if ((Identification->Vendor == X86_VENDOR_INTEL) &&
+        (MaxLeaf >= X86_CPUID_CACHE_PARAMETERS)) {
+
+        HighestLevel = 0;
+        for (Index = 0; Index < X86_CPUID_CACHE_MAX_INDEX; Index += 1) {
+            CacheEax = X86_CPUID_CACHE_PARAMETERS;
+            CacheEcx = Index;
+            ArCpuid(&CacheEax, &CacheEbx, &CacheEcx, &CacheEdx);
+            if ((CacheEax & X86_CPUID_CACHE_EAX_TYPE_MASK) == 0) {
+                break;
+            }
+
+            Level = (CacheEax & X86_CPUID_CACHE_EAX_LEVEL_MASK) >>
+                    X86_CPUID_CACHE_EAX_LEVEL_SHIFT;
+
+            if (Level >= HighestLevel) {
+                HighestLevel = Level;
+                Sharing = ((CacheEax & X86_CPUID_CACHE_EAX_SHARING_MASK) >>
+                           X86_CPUID_CACHE_EAX_SHARING_SHIFT) + 1;
+            }
+        }
+    }
+
+    Shift = 0;
+    while ((Shift < 8) && ((1UL << Shift) < Sharing)) {
+        Shift += 1;
+    }
+
+    ProcessorBlock->CacheDomain = ApicId >> Shift;
+
     return;
 }
 
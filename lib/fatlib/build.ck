@@ -37,6 +37,7 @@ function build() {
 
     sources = [
         "fat.c",
+        "fatalloc.c",
         "fatcache.c",
         "fatsup.c",
         "idtodir.c"
@@ -1082,6 +1082,16 @@ Return Value:
         goto MountEnd;
     }
 
+    //
+    // Build the map of free clusters so that allocations can find contiguous
+    // runs without walking the FAT.
+    //
+
+    Status = FatpCreateFreeClusterMap(FatVolume);
+    if (!KSUCCESS(Status)) {
+        goto MountEnd;
+    }
+
     //
     // Read in and validate the FS information block.
     //
@@ -1136,6 +1146,7 @@ Return Value:
 
     } else {
         if (FatVolume != NULL) {
+            FatpDestroyFreeClusterMap(FatVolume);
             if (FatVolume->Lock != NULL) {
                 FatDestroyLock(FatVolume->Lock);
             }
@@ -1181,6 +1192,7 @@ Return Value:
     PFAT_VOLUME FatVolume;
 
     FatVolume = (PFAT_VOLUME)Volume;
+    FatpDestroyFreeClusterMap(FatVolume);
     FatpDestroyFatCache(FatVolume);
     FatpDestroyFileMappingTree(FatVolume);
     FatDestroyLock(FatVolume->Lock);
@@ -3732,9 +3744,9 @@ FatAllocateFileClusters (
 Routine Description:
 
     This routine expands the file capacity of the given file ID by allocating
-    clusters for it. It does not zero out those clusters, so the usefulness of
-    this function is limited to scenarios where the security of uninitialized
-    disk contents is not a concern.
+    clusters for it, in contiguous runs where possible. It does not zero out
+    those clusters, so the usefulness of this function is limited to scenarios
+    where the security of uninitialized disk contents is not a concern.
 
 Arguments:
 
@@ -3755,8 +3767,10 @@ Return Value:
     ULONG Cluster;
     ULONG ClusterCount;
     ULONGLONG CurrentSize;
+    ULONG DesiredCount;
     BOOL Dirty;
     PFAT_VOLUME FatVolume;
+    ULONG NewCount;
     ULONG NextCluster;
     KSTATUS Status;
 
@@ -3776,7 +3790,16 @@ Return Value:
         }
 
         if (NextCluster >= ClusterCount) {
-            Status = FatpAllocateCluster(Volume, Cluster, &NextCluster, FALSE);
+            DesiredCount = FAT_CLUSTERS_FOR_BYTES(FatVolume,
+                                                  FileSize - CurrentSize);
+
+            Status = FatpAllocateClusterRun(FatVolume,
+                                            Cluster,
+                                            DesiredCount,
+                                            &NextCluster,
+                                            &NewCount,
+                                            FALSE);
+
             if (!KSUCCESS(Status)) {
                 return Status;
             }
@@ -3871,11 +3894,13 @@ Return Value:
     ULONG ClusterShift;
     ULONG ClusterSize;
     ULONG CurrentCluster;
+    ULONG DesiredCount;
     PFAT_FILE File;
     ULONGLONG FileByteOffset;
     KSTATUS FlushStatus;
     UINTN MaxContiguousBytes;
     ULONG NewCluster;
+    ULONG NewCount;
     BOOL NewTerritory;
     ULONG NextCluster;
     PFAT_IO_BUFFER ScratchIoBuffer;
@@ -4004,10 +4029,18 @@ Return Value:
             ASSERT((IoFlags & IO_FLAG_NO_ALLOCATE) == 0);
             ASSERT((File->OpenFlags & OPEN_FLAG_PAGE_FILE) == 0);
 
-            Status = FatpAllocateCluster(Volume,
-                                         FatSeekInformation->CurrentCluster,
-                                         &NewCluster,
-                                         FALSE);
+            //
+            // Ask for enough clusters to hold the rest of the write, so the
+            // file grows in contiguous runs rather than a cluster at a time.
+            //
+
+            DesiredCount = FAT_CLUSTERS_FOR_BYTES(Volume, SizeInBytes);
+            Status = FatpAllocateClusterRun(Volume,
+                                            FatSeekInformation->CurrentCluster,
+                                            DesiredCount,
+                                            &NewCluster,
+                                            &NewCount,
+                                            FALSE);
 
             if (!KSUCCESS(Status)) {
                 goto PerformFileIoEnd;
@@ -4099,10 +4132,16 @@ Return Value:
                     ASSERT((IoFlags & IO_FLAG_NO_ALLOCATE) == 0);
                     ASSERT((File->OpenFlags & OPEN_FLAG_PAGE_FILE) == 0);
 
-                    Status = FatpAllocateCluster(Volume,
-                                                 CurrentCluster,
-                                                 &NewCluster,
-                                                 FALSE);
+                    DesiredCount = FAT_CLUSTERS_FOR_BYTES(
+                                            Volume,
+                                            SizeInBytes - MaxContiguousBytes);
+
+                    Status = FatpAllocateClusterRun(Volume,
+                                                    CurrentCluster,
+                                                    DesiredCount,
+                                                    &NewCluster,
+                                                    &NewCount,
+                                                    FALSE);
 
                     if (!KSUCCESS(Status)) {
                         goto PerformFileIoEnd;
@@ -0,0 +1,533 @@
+/*++
+
+Copyright (c) 2026 Minoca Corp.
+
+    This file is licensed under the terms of the GNU General Public License
+    version 3. Alternative licensing terms are available. Contact
+    info@minocacorp.com for details. See the LICENSE file at the root of this
+    project for complete licensing information.
+
+Module Name:
+
+    fatalloc.c
+
+Abstract:
+
+    This module implements the in-memory map of free clusters, which is used
+    to find runs of contiguous clusters without walking the FAT.
+
+Author:
+
+    Minoca Corp. 18-Oct-2026
+
+Environment:
+
+    Kernel, Boot, Build
+
+--*/
+
+//
+// ------------------------------------------------------------------- Includes
+//
+
+#include <minoca/lib/fat/fatlib.h>
+#include <minoca/lib/fat/fat.h>
+#include "fatlibp.h"
+
+//
+// --------------------------------------------------------------------- Macros
+//
+
+//
+// ---------------------------------------------------------------- Definitions
+//
+
+#define FAT_FREE_MAP_BITS (sizeof(ULONG) * BITS_PER_BYTE)
+
+//
+// ------------------------------------------------------ Data Type Definitions
+//
+
+//
+// ----------------------------------------------- Internal Function Prototypes
+//
+
+ULONG
+FatpFindNextFreeCluster (
+    PULONG Map,
+    ULONG Cluster,
+    ULONG Limit
+    );
+
+ULONG
+FatpCountFreeClusters (
+    PULONG Map,
+    ULONG Cluster,
+    ULONG Limit
+    );
+
+//
+// -------------------------------------------------------------------- Globals
+//
+
+//
+// ------------------------------------------------------------------ Functions
+//
+
+KSTATUS
+FatpCreateFreeClusterMap (
+    PFAT_VOLUME Volume
+    )
+
+/*++
+
+Routine Description:
+
+    This routine builds the in-memory map of free clusters for the given
+    volume by reading the whole FAT. If there is not enough memory for the
+    map, the volume carries on without one.
+
+Arguments:
+
+    Volume - Supplies a pointer to the FAT volume structure. The FAT cache
+        must already be initialized.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    ULONG AllocationSize;
+    ULONG Cluster;
+    ULONG ClusterCount;
+    ULONG FreeCount;
+    PULONG Map;
+    ULONG MapClusters;
+    KSTATUS Status;
+    ULONG Value;
+
+    ASSERT(Volume->FreeClusterMap == NULL);
+
+    ClusterCount = Volume->ClusterCount;
+    MapClusters = ALIGN_RANGE_UP(ClusterCount, FAT_FREE_MAP_BITS);
+    AllocationSize = MapClusters / BITS_PER_BYTE;
+    Map = FatAllocateNonPagedMemory(Volume->Device.DeviceToken,
+                                    AllocationSize);
+
+    if (Map == NULL) {
+        Status = STATUS_SUCCESS;
+        goto CreateFreeClusterMapEnd;
+    }
+
+    //
+    // Clusters 0 and 1 do not exist, and neither do the bits past the end of
+    // the volume. Mark them as in use so they are never handed out.
+    //
+
+    RtlZeroMemory(Map, AllocationSize);
+    Map[0] |= FAT_FREE_MAP_MASK(0) | FAT_FREE_MAP_MASK(1);
+    for (Cluster = ClusterCount; Cluster < MapClusters; Cluster += 1) {
+        Map[FAT_FREE_MAP_INDEX(Cluster)] |= FAT_FREE_MAP_MASK(Cluster);
+    }
+
+    FreeCount = 0;
+    for (Cluster = FAT_CLUSTER_BEGIN; Cluster < ClusterCount; Cluster += 1) {
+        Status = FatpFatCacheReadClusterEntry(Volume, FALSE, Cluster, &Value);
+        if (!KSUCCESS(Status)) {
+            goto CreateFreeClusterMapEnd;
+        }
+
+        if (Value == FAT_CLUSTER_FREE) {
+            FreeCount += 1;
+
+        } else {
+            Map[FAT_FREE_MAP_INDEX(Cluster)] |= FAT_FREE_MAP_MASK(Cluster);
+        }
+    }
+
+    Volume->FreeClusterMap = Map;
+    Volume->FreeClusterCount = FreeCount;
+    Map = NULL;
+    Status = STATUS_SUCCESS;
+
+CreateFreeClusterMapEnd:
+    if (Map != NULL) {
+        FatFreeNonPagedMemory(Volume->Device.DeviceToken, Map);
+    }
+
+    return Status;
+}
+
+VOID
+FatpDestroyFreeClusterMap (
+    PFAT_VOLUME Volume
+    )
+
+/*++
+
+Routine Description:
+
+    This routine destroys the free cluster map for the given volume.
+
+Arguments:
+
+    Volume - Supplies a pointer to the FAT volume structure.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    if (Volume->FreeClusterMap != NULL) {
+        FatFreeNonPagedMemory(Volume->Device.DeviceToken,
+                              Volume->FreeClusterMap);
+
+        Volume->FreeClusterMap = NULL;
+    }
+
+    Volume->FreeClusterCount = 0;
+    return;
+}
+
+BOOL
+FatpFindFreeClusterRun (
+    PFAT_VOLUME Volume,
+    ULONG Goal,
+    ULONG DesiredCount,
+    PULONG RunStart,
+    PULONG RunLength
+    )
+
+/*++
+
+Routine Description:
+
+    This routine searches the free cluster map for a run of free clusters. If
+    the goal cluster is free, the run starting there is returned, however
+    short. Otherwise the first run at least as long as the desired count is
+    returned, searching from the volume's search start and wrapping around. If
+    no run is long enough, the longest one is returned. This routine assumes
+    the volume lock is held and the free cluster map is present.
+
+Arguments:
+
+    Volume - Supplies a pointer to the FAT volume structure.
+
+    Goal - Supplies the cluster the caller would most like to start at, or
+        zero for no preference.
+
+    DesiredCount - Supplies the desired length of the run, in clusters.
+
+    RunStart - Supplies a pointer where the first cluster of the run will be
+        returned.
+
+    RunLength - Supplies a pointer where the length of the run will be
+        returned. This will not exceed the desired count.
+
+Return Value:
+
+    TRUE if a run was found.
+
+    FALSE if there are no free clusters.
+
+--*/
+
+{
+
+    ULONG BestLength;
+    ULONG BestStart;
+    ULONG Cluster;
+    ULONG ClusterCount;
+    ULONG End;
+    ULONG Length;
+    ULONG Limit;
+    PULONG Map;
+    ULONG SearchStart;
+    BOOL Wrapped;
+
+    Map = Volume->FreeClusterMap;
+    ClusterCount = Volume->ClusterCount;
+
+    ASSERT((Map != NULL) && (DesiredCount != 0));
+
+    if (Volume->FreeClusterCount == 0) {
+        return FALSE;
+    }
+
+    if (DesiredCount > ClusterCount) {
+        DesiredCount = ClusterCount;
+    }
+
+    //
+    // Continuing right where the caller left off is always best, even if
+    // only a single cluster is free there.
+    //
+
+    if ((Goal >= FAT_CLUSTER_BEGIN) && (Goal < ClusterCount) &&
+        ((Map[FAT_FREE_MAP_INDEX(Goal)] & FAT_FREE_MAP_MASK(Goal)) == 0)) {
+
+        Limit = ClusterCount;
+        if (ClusterCount - Goal > DesiredCount) {
+            Limit = Goal + DesiredCount;
+        }
+
+        *RunStart = Goal;
+        *RunLength = FatpCountFreeClusters(Map, Goal, Limit);
+        return TRUE;
+    }
+
+    //
+    // Otherwise look for the first run that is long enough, remembering the
+    // longest run seen in case none is.
+    //
+
+    SearchStart = Volume->ClusterSearchStart;
+    if ((SearchStart < FAT_CLUSTER_BEGIN) || (SearchStart >= ClusterCount)) {
+        SearchStart = FAT_CLUSTER_BEGIN;
+    }
+
+    BestLength = 0;
+    BestStart = 0;
+    Cluster = SearchStart;
+    End = ClusterCount;
+    Wrapped = FALSE;
+    while (TRUE) {
+        Cluster = FatpFindNextFreeCluster(Map, Cluster, End);
+        if (Cluster >= End) {
+            if ((Wrapped != FALSE) || (SearchStart == FAT_CLUSTER_BEGIN)) {
+                break;
+            }
+
+            Wrapped = TRUE;
+            Cluster = FAT_CLUSTER_BEGIN;
+            End = SearchStart;
+            continue;
+        }
+
+        Limit = ClusterCount;
+        if (ClusterCount - Cluster > DesiredCount) {
+            Limit = Cluster + DesiredCount;
+        }
+
+        Length = FatpCountFreeClusters(Map, Cluster, Limit);
+
+        ASSERT(Length != 0);
+
+        if (Length > BestLength) {
+            BestStart = Cluster;
+            BestLength = Length;
+            if (Length == DesiredCount) {
+                break;
+            }
+        }
+
+        Cluster += Length;
+    }
+
+    if (BestLength == 0) {
+        return FALSE;
+    }
+
+    *RunStart = BestStart;
+    *RunLength = BestLength;
+    return TRUE;
+}
+
+VOID
+FatpSetClusterRunState (
+    PFAT_VOLUME Volume,
+    ULONG Cluster,
+    ULONG Count,
+    BOOL Allocated
+    )
+
+/*++
+
+Routine Description:
+
+    This routine marks a run of clusters as allocated or free in the free
+    cluster map, updating the free cluster count. This routine assumes the
+    volume lock is held. It does nothing if the map is not present.
+
+Arguments:
+
+    Volume - Supplies a pointer to the FAT volume structure.
+
+    Cluster - Supplies the first cluster of the run.
+
+    Count - Supplies the number of clusters in the run.
+
+    Allocated - Supplies a boolean indicating whether the clusters are now in
+        use (TRUE) or free (FALSE).
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    ULONG End;
+    PULONG Map;
+    ULONG Mask;
+
+    Map = Volume->FreeClusterMap;
+    if (Map == NULL) {
+        return;
+    }
+
+    ASSERT((Cluster >= FAT_CLUSTER_BEGIN) &&
+           (Cluster + Count <= Volume->ClusterCount));
+
+    //
+    // Only count clusters whose state actually changes, so that a corrupt
+    // chain freed twice does not throw off the free count.
+    //
+
+    End = Cluster + Count;
+    while (Cluster < End) {
+        Mask = FAT_FREE_MAP_MASK(Cluster);
+        if (Allocated != FALSE) {
+            if ((Map[FAT_FREE_MAP_INDEX(Cluster)] & Mask) == 0) {
+                Map[FAT_FREE_MAP_INDEX(Cluster)] |= Mask;
+
+                ASSERT(Volume->FreeClusterCount != 0);
+
+                Volume->FreeClusterCount -= 1;
+            }
+
+        } else {
+            if ((Map[FAT_FREE_MAP_INDEX(Cluster)] & Mask) != 0) {
+                Map[FAT_FREE_MAP_INDEX(Cluster)] &= ~Mask;
+                Volume->FreeClusterCount += 1;
+            }
+        }
+
+        Cluster += 1;
+    }
+
+    return;
+}
+
+//
+// --------------------------------------------------------- Internal Functions
+//
+
+ULONG
+FatpFindNextFreeCluster (
+    PULONG Map,
+    ULONG Cluster,
+    ULONG Limit
+    )
+
+/*++
+
+Routine Description:
+
+    This routine finds the next free cluster in the free cluster map, skipping
+    over fully allocated words at a time.
+
+Arguments:
+
+    Map - Supplies a pointer to the free cluster map.
+
+    Cluster - Supplies the cluster to start searching at, inclusive.
+
+    Limit - Supplies the cluster to stop searching at, exclusive.
+
+Return Value:
+
+    Returns the first free cluster at or after the given cluster, or the limit
+    if there are none before it.
+
+--*/
+
+{
+
+    ULONG Word;
+
+    while (Cluster < Limit) {
+        Word = Map[FAT_FREE_MAP_INDEX(Cluster)] |
+               (FAT_FREE_MAP_MASK(Cluster) - 1);
+
+        if (Word != MAX_ULONG) {
+            Cluster = ALIGN_RANGE_DOWN(Cluster, FAT_FREE_MAP_BITS) +
+                      RtlCountTrailingZeros32(~Word);
+
+            break;
+        }
+
+        Cluster = ALIGN_RANGE_DOWN(Cluster, FAT_FREE_MAP_BITS) +
+                  FAT_FREE_MAP_BITS;
+    }
+
+    if (Cluster > Limit) {
+        Cluster = Limit;
+    }
+
+    return Cluster;
+}
+
+ULONG
+FatpCountFreeClusters (
+    PULONG Map,
+    ULONG Cluster,
+    ULONG Limit
+    )
+
+/*++
+
+Routine Description:
+
+    This routine counts the free clusters in a row in the free cluster map.
+
+Arguments:
+
+    Map - Supplies a pointer to the free cluster map.
+
+    Cluster - Supplies the first cluster to count, which should be free.
+
+    Limit - Supplies the cluster to stop counting at, exclusive.
+
+Return Value:
+
+    Returns the number of contiguous free clusters starting at the given
+    cluster, up to the limit.
+
+--*/
+
+{
+
+    ULONG Start;
+    ULONG Word;
+
+    Start = Cluster;
+    while (Cluster < Limit) {
+        Word = Map[FAT_FREE_MAP_INDEX(Cluster)] &
+               ~(FAT_FREE_MAP_MASK(Cluster) - 1);
+
+        if (Word != 0) {
+            Cluster = ALIGN_RANGE_DOWN(Cluster, FAT_FREE_MAP_BITS) +
+                      RtlCountTrailingZeros32(Word);
+
+            break;
+        }
+
+        Cluster = ALIGN_RANGE_DOWN(Cluster, FAT_FREE_MAP_BITS) +
+                  FAT_FREE_MAP_BITS;
+    }
+
+    if (Cluster > Limit) {
+        Cluster = Limit;
+    }
+
+    return Cluster - Start;
+}
+
@@ -69,6 +69,15 @@ Module Name:
     (((_WindowIndex) << (_Volume)->FatCache.WindowShift) >>     \
      (_Volume)->ClusterWidthShift)
 
+//
+// This macro returns the number of clusters needed to hold the given number
+// of bytes.
+//
+
+#define FAT_CLUSTERS_FOR_BYTES(_Volume, _Bytes)                          \
+    ((ULONG)(ALIGN_RANGE_UP((ULONGLONG)(_Bytes), (_Volume)->ClusterSize) >> \
+             (_Volume)->ClusterShift))
+
 //
 // This macro gets the closest seek table entry for the given file offset.
 //
@@ -122,6 +131,23 @@ Module Name:
 
 #define FAT_VOLUME_FLAG_COMPATIBILITY_MODE 0x00000001
 
+//
+// Define the amount of space, in bytes, to leave free after a newly started
+// run of clusters. This lets a file keep growing contiguously while other
+// files are being written at the same time. The space is not reserved; it is
+// handed out once the rest of the volume fills up.
+//
+
+#define FAT_ALLOCATION_RESERVE_SIZE (4 * _1MB)
+
+//
+// This macro returns the index into the free cluster bitmap for the given
+// cluster, and the mask within that element.
+//
+
+#define FAT_FREE_MAP_INDEX(_Cluster) ((_Cluster) >> 5)
+#define FAT_FREE_MAP_MASK(_Cluster) ((ULONG)1 << ((_Cluster) & 0x1F))
+
 //
 // ------------------------------------------------------ Data Type Definitions
 //
@@ -265,6 +291,13 @@ Structure Description:
     FatCache - Stores the File Allocation Table cache. This is used for cluster
         allocation and next cluster lookup during seek, read, and write.
 
+    FreeClusterMap - Stores an optional pointer to a bitmap with one bit per
+        cluster, built when the volume is mounted. A set bit means the cluster
+        is in use. If this is NULL, allocations scan the FAT instead.
+
+    FreeClusterCount - Stores the number of free clusters on the volume. This
+        is only valid if the free cluster map is present.
+
 --*/
 
 typedef struct _FAT_VOLUME {
@@ -292,6 +325,8 @@ typedef struct _FAT_VOLUME {
     PVOID Lock;
     RED_BLACK_TREE FileMappingTree;
     FAT_CACHE FatCache;
+    PULONG FreeClusterMap;
+    ULONG FreeClusterCount;
 } FAT_VOLUME, *PFAT_VOLUME;
 
 /*++
@@ -665,6 +700,56 @@ Return Value:
 
 --*/
 
+KSTATUS
+FatpAllocateClusterRun (
+    PFAT_VOLUME Volume,
+    ULONG PreviousCluster,
+    ULONG DesiredCount,
+    PULONG NewCluster,
+    PULONG NewCount,
+    BOOL Flush
+    );
+
+/*++
+
+Routine Description:
+
+    This routine allocates a run of physically contiguous free clusters, chains
+    them together, and chains the run so that the specified previous cluster
+    points to it. It first tries to extend the previous cluster in place. The
+    run may be shorter than requested if the free space is fragmented.
+
+Arguments:
+
+    Volume - Supplies a pointer to the FAT volume.
+
+    PreviousCluster - Supplies the cluster that should point to the newly
+        allocated run. Specify FAT32_CLUSTER_END if no previous cluster
+        should be updated.
+
+    DesiredCount - Supplies the number of clusters the caller would like. This
+        must not be zero.
+
+    NewCluster - Supplies a pointer that will receive the first cluster of the
+        new run.
+
+    NewCount - Supplies a pointer that will receive the number of clusters
+        allocated, which is between one and the desired count.
+
+    Flush - Supplies a boolean indicating if the FAT cache should be flushed.
+
+Return Value:
+
+    STATUS_SUCCESS on success.
+
+    STATUS_INVALID_PARAMETER if an invalid cluster was supplied.
+
+    STATUS_VOLUME_FULL if no free clusters exist.
+
+    Other error codes on device I/O errors.
+
+--*/
+
 KSTATUS
 FatpFreeClusterChain (
     PFAT_VOLUME Volume,
@@ -1326,6 +1411,131 @@ Return Value:
 
 --*/
 
+//
+// Free cluster map support functions.
+//
+
+KSTATUS
+FatpCreateFreeClusterMap (
+    PFAT_VOLUME Volume
+    );
+
+/*++
+
+Routine Description:
+
+    This routine builds the in-memory map of free clusters for the given
+    volume by reading the whole FAT. If there is not enough memory for the
+    map, the volume carries on without one.
+
+Arguments:
+
+    Volume - Supplies a pointer to the FAT volume structure. The FAT cache
+        must already be initialized.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+VOID
+FatpDestroyFreeClusterMap (
+    PFAT_VOLUME Volume
+    );
+
+/*++
+
+Routine Description:
+
+    This routine destroys the free cluster map for the given volume.
+
+Arguments:
+
+    Volume - Supplies a pointer to the FAT volume structure.
+
+Return Value:
+
+    None.
+
+--*/
+
+BOOL
+FatpFindFreeClusterRun (
+    PFAT_VOLUME Volume,
+    ULONG Goal,
+    ULONG DesiredCount,
+    PULONG RunStart,
+    PULONG RunLength
+    );
+
+/*++
+
+Routine Description:
+
+    This routine searches the free cluster map for a run of free clusters. If
+    the goal cluster is free, the run starting there is returned, however
+    short. Otherwise the first run at least as long as the desired count is
+    returned, searching from the volume's search start and wrapping around. If
+    no run is long enough, the longest one is returned. This routine assumes
+    the volume lock is held and the free cluster map is present.
+
+Arguments:
+
+    Volume - Supplies a pointer to the FAT volume structure.
+
+    Goal - Supplies the cluster the caller would most like to start at, or
+        zero for no preference.
+
+    DesiredCount - Supplies the desired length of the run, in clusters.
+
+    RunStart - Supplies a pointer where the first cluster of the run will be
+        returned.
+
+    RunLength - Supplies a pointer where the length of the run will be
+        returned. This will not exceed the desired count.
+
+Return Value:
+
+    TRUE if a run was found.
+
+    FALSE if there are no free clusters.
+
+--*/
+
+VOID
+FatpSetClusterRunState (
+    PFAT_VOLUME Volume,
+    ULONG Cluster,
+    ULONG Count,
+    BOOL Allocated
+    );
+
+/*++
+
+Routine Description:
+
+    This routine marks a run of clusters as allocated or free in the free
+    cluster map, updating the free cluster count. This routine assumes the
+    volume lock is held. It does nothing if the map is not present.
+
+Arguments:
+
+    Volume - Supplies a pointer to the FAT volume structure.
+
+    Cluster - Supplies the first cluster of the run.
+
+    Count - Supplies the number of clusters in the run.
+
+    Allocated - Supplies a boolean indicating whether the clusters are now in
+        use (TRUE) or free (FALSE).
+
+Return Value:
+
+    None.
+
+--*/
+
 //
 // File Allocation Table cache support functions.
 //
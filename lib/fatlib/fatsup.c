@@ -74,6 +74,20 @@ FatpCreateDirectoryEntriesForFile (
     PULONG EntryCount
     );
 
+KSTATUS
+FatpScanFatForFreeCluster (
+    PFAT_VOLUME Volume,
+    PULONG Cluster
+    );
+
+KSTATUS
+FatpUpdateInformationSector (
+    PFAT_VOLUME Volume,
+    PVOID Irp,
+    ULONG LastCluster,
+    LONG FreeDelta
+    );
+
 //
 // -------------------------------------------------------------------- Globals
 //
@@ -1317,32 +1331,87 @@ Return Value:
 
 --*/
 
+{
+
+    ULONG NewCount;
+
+    return FatpAllocateClusterRun(Volume,
+                                  PreviousCluster,
+                                  1,
+                                  NewCluster,
+                                  &NewCount,
+                                  Flush);
+}
+
+KSTATUS
+FatpAllocateClusterRun (
+    PFAT_VOLUME Volume,
+    ULONG PreviousCluster,
+    ULONG DesiredCount,
+    PULONG NewCluster,
+    PULONG NewCount,
+    BOOL Flush
+    )
+
+/*++
+
+Routine Description:
+
+    This routine allocates a run of physically contiguous free clusters, chains
+    them together, and chains the run so that the specified previous cluster
+    points to it. It first tries to extend the previous cluster in place. The
+    run may be shorter than requested if the free space is fragmented.
+
+Arguments:
+
+    Volume - Supplies a pointer to the FAT volume.
+
+    PreviousCluster - Supplies the cluster that should point to the newly
+        allocated run. Specify FAT32_CLUSTER_END if no previous cluster
+        should be updated.
+
+    DesiredCount - Supplies the number of clusters the caller would like. This
+        must not be zero.
+
+    NewCluster - Supplies a pointer that will receive the first cluster of the
+        new run.
+
+    NewCount - Supplies a pointer that will receive the number of clusters
+        allocated, which is between one and the desired count.
+
+    Flush - Supplies a boolean indicating if the FAT cache should be flushed.
+
+Return Value:
+
+    STATUS_SUCCESS on success.
+
+    STATUS_INVALID_PARAMETER if an invalid cluster was supplied.
+
+    STATUS_VOLUME_FULL if no free clusters exist.
+
+    Other error codes on device I/O errors.
+
+--*/
+
 {
 
     ULONG AllocatedCluster;
-    ULONG BlockShift;
+    ULONG AllocatedCount;
+    ULONG Cluster;
     ULONG ClusterCount;
-    ULONG ClusterEnd;
-    ULONG CurrentCluster;
-    PFAT32_INFORMATION_SECTOR Information;
-    ULONGLONG InformationBlock;
-    PFAT_IO_BUFFER InformationIoBuffer;
-    ULONG IoFlags;
-    ULONG SearchStart;
+    ULONG Goal;
+    ULONG Index;
+    ULONG LastCluster;
+    ULONG Reserve;
     KSTATUS Status;
     ULONG Value;
-    PVOID Window;
-    PUSHORT Window16;
-    PULONG Window32;
-    ULONG WindowOffset;
-    ULONG WindowSize;
 
     AllocatedCluster = FAT_CLUSTER_FREE;
-    BlockShift = Volume->BlockShift;
+    AllocatedCount = 0;
     ClusterCount = Volume->ClusterCount;
-    InformationIoBuffer = NULL;
-    IoFlags = IO_FLAG_FS_DATA | IO_FLAG_FS_METADATA;
+    Goal = 0;
 
+    ASSERT(DesiredCount != 0);
     ASSERT((PreviousCluster >= Volume->ClusterBad) ||
            (PreviousCluster < ClusterCount));
 
@@ -1360,164 +1429,109 @@ Return Value:
     }
 
     //
-    // Search for a free block. Start just after the last allocated cluster.
+    // With the free cluster map, look for a run that continues on from the
+    // previous cluster, or failing that the first run that is long enough.
+    // Without it, fall back to finding a single cluster in the FAT.
     //
 
-    CurrentCluster = Volume->ClusterSearchStart;
-    ClusterEnd = ClusterCount;
-    SearchStart = CurrentCluster;
-    CurrentCluster += 1;
-    WindowSize = FAT_WINDOW_INDEX_TO_CLUSTER(Volume, 1);
-    WindowOffset = MAX_ULONG;
-    while (CurrentCluster != SearchStart) {
+    if (Volume->FreeClusterMap != NULL) {
+        if ((PreviousCluster >= FAT_CLUSTER_BEGIN) &&
+            (PreviousCluster < ClusterCount)) {
 
-        //
-        // If this is the end of the FAT, wrap around to the beginning.
-        //
-
-        if (CurrentCluster >= ClusterEnd) {
-            CurrentCluster = FAT_CLUSTER_BEGIN;
-            WindowOffset = MAX_ULONG;
-            ClusterEnd = SearchStart;
-        }
-
-        //
-        // Read the next window if needed.
-        //
-
-        if (WindowOffset >= WindowSize) {
-            Status = FatpFatCacheGetFatWindow(Volume,
-                                              TRUE,
-                                              CurrentCluster,
-                                              &Window,
-                                              &WindowOffset);
-
-            if (!KSUCCESS(Status)) {
-                goto AllocateClusterEnd;
-            }
+            Goal = PreviousCluster + 1;
         }
 
-        //
-        // Scan the whole window.
-        //
+        if (FatpFindFreeClusterRun(Volume,
+                                   Goal,
+                                   DesiredCount,
+                                   &AllocatedCluster,
+                                   &AllocatedCount) == FALSE) {
 
-        if (Volume->Format == Fat12Format) {
-            while (CurrentCluster < ClusterEnd) {
-                Value = FAT12_READ_CLUSTER(Window, CurrentCluster);
-                if (Value == FAT_CLUSTER_FREE) {
-                    break;
-                }
-
-                CurrentCluster += 1;
-            }
-
-        } else if (Volume->Format == Fat16Format) {
-            Window16 = Window;
-            while ((WindowOffset < WindowSize) &&
-                   (CurrentCluster < ClusterEnd) &&
-                   (Window16[WindowOffset] != FAT_CLUSTER_FREE)) {
-
-                WindowOffset += 1;
-                CurrentCluster += 1;
-            }
-
-        } else {
-            Window32 = Window;
-            while ((WindowOffset < WindowSize) &&
-                   (CurrentCluster < ClusterEnd) &&
-                   (Window32[WindowOffset] != FAT_CLUSTER_FREE)) {
-
-                WindowOffset += 1;
-                CurrentCluster += 1;
-            }
-        }
-
-        if ((WindowOffset >= WindowSize) || (CurrentCluster >= ClusterEnd)) {
-            continue;
+            AllocatedCluster = FAT_CLUSTER_FREE;
+            Status = STATUS_VOLUME_FULL;
+            goto AllocateClusterRunEnd;
         }
 
-        Status = FatpFatCacheWriteClusterEntry(Volume,
-                                               CurrentCluster,
-                                               Volume->ClusterEnd,
-                                               NULL);
-
+    } else {
+        Status = FatpScanFatForFreeCluster(Volume, &AllocatedCluster);
         if (!KSUCCESS(Status)) {
-            goto AllocateClusterEnd;
+            goto AllocateClusterRunEnd;
         }
 
-        //
-        // Mark a cluster as allocated now that it's been written in stone.
-        //
-
-        AllocatedCluster = CurrentCluster;
-        break;
+        AllocatedCount = 1;
     }
 
     //
-    // If nothing was found, sadly return.
+    // Chain the run together, terminating it with the end of file marker. If
+    // writing the FAT fails partway through, give back what was taken.
     //
 
-    if (AllocatedCluster == FAT_CLUSTER_FREE) {
-        Status = STATUS_VOLUME_FULL;
-        goto AllocateClusterEnd;
+    for (Index = 0; Index < AllocatedCount; Index += 1) {
+        Cluster = AllocatedCluster + Index;
+        Value = Cluster + 1;
+        if (Index == AllocatedCount - 1) {
+            Value = Volume->ClusterEnd;
+        }
+
+        Status = FatpFatCacheWriteClusterEntry(Volume, Cluster, Value, NULL);
+        if (!KSUCCESS(Status)) {
+            while (Index != 0) {
+                Index -= 1;
+                FatpFatCacheWriteClusterEntry(Volume,
+                                              AllocatedCluster + Index,
+                                              FAT_CLUSTER_FREE,
+                                              NULL);
+            }
+
+            AllocatedCluster = FAT_CLUSTER_FREE;
+            AllocatedCount = 0;
+            goto AllocateClusterRunEnd;
+        }
     }
 
+    FatpSetClusterRunState(Volume, AllocatedCluster, AllocatedCount, TRUE);
+    LastCluster = AllocatedCluster + AllocatedCount - 1;
+
     //
     // Update the FS information block saving the new free space and last block
     // allocated.
     //
 
-    if ((FatMaintainFreeClusterCount != FALSE) &&
-        (Volume->InformationByteOffset != 0)) {
+    Status = FatpUpdateInformationSector(Volume,
+                                         NULL,
+                                         LastCluster,
+                                         -(LONG)AllocatedCount);
 
-        InformationIoBuffer = FatAllocateIoBuffer(Volume->Device.DeviceToken,
-                                                  Volume->Device.BlockSize);
-
-        if (InformationIoBuffer == NULL) {
-            Status = STATUS_INSUFFICIENT_RESOURCES;
-            goto AllocateClusterEnd;
-        }
-
-        InformationBlock = Volume->InformationByteOffset >> BlockShift;
-        Status = FatReadDevice(Volume->Device.DeviceToken,
-                               InformationBlock,
-                               1,
-                               IoFlags,
-                               NULL,
-                               InformationIoBuffer);
-
-        if (!KSUCCESS(Status)) {
-            goto AllocateClusterEnd;
-        }
-
-        Information = FatMapIoBuffer(InformationIoBuffer);
-        if (Information == NULL) {
-            Status = STATUS_INSUFFICIENT_RESOURCES;
-            goto AllocateClusterEnd;
-        }
+    if (!KSUCCESS(Status)) {
+        goto AllocateClusterRunEnd;
+    }
 
-        Information->LastClusterAllocated = AllocatedCluster;
+    //
+    // Move the search start past the new run, unless this just extended an
+    // existing run that is still behind it. If a growing file had to start a
+    // new run, leave some room after it so that concurrent writers do not
+    // interleave their clusters.
+    //
 
-        ASSERT(Information->FreeClusters != 0);
+    if ((AllocatedCluster != Goal) ||
+        (LastCluster >= Volume->ClusterSearchStart)) {
 
-        if (Information->FreeClusters != 0) {
-            Information->FreeClusters -= 1;
-        }
+        Volume->ClusterSearchStart = LastCluster;
+        if (Goal != 0) {
+            Reserve = FAT_ALLOCATION_RESERVE_SIZE >> Volume->ClusterShift;
+            if (Reserve > (ClusterCount >> 4)) {
+                Reserve = ClusterCount >> 4;
+            }
 
-        Status = FatWriteDevice(Volume->Device.DeviceToken,
-                                InformationBlock,
-                                1,
-                                IoFlags,
-                                NULL,
-                                InformationIoBuffer);
+            if (ClusterCount - LastCluster > Reserve) {
+                Volume->ClusterSearchStart += Reserve;
 
-        if (!KSUCCESS(Status)) {
-            goto AllocateClusterEnd;
+            } else {
+                Volume->ClusterSearchStart = FAT_CLUSTER_BEGIN;
+            }
         }
     }
 
-    Volume->ClusterSearchStart = AllocatedCluster;
-
     //
     // Lookup the previous block and update it.
     //
@@ -1529,26 +1543,23 @@ Return Value:
                                                NULL);
 
         if (!KSUCCESS(Status)) {
-            goto AllocateClusterEnd;
+            goto AllocateClusterRunEnd;
         }
     }
 
     if (Flush != FALSE) {
         Status = FatpFatCacheFlush(Volume, 0);
         if (!KSUCCESS(Status)) {
-            goto AllocateClusterEnd;
+            goto AllocateClusterRunEnd;
         }
     }
 
     Status = STATUS_SUCCESS;
 
-AllocateClusterEnd:
+AllocateClusterRunEnd:
     FatReleaseLock(Volume->Lock);
-    if (InformationIoBuffer != NULL) {
-        FatFreeIoBuffer(InformationIoBuffer);
-    }
-
     *NewCluster = AllocatedCluster;
+    *NewCount = AllocatedCount;
     return Status;
 }
 
@@ -1584,16 +1595,10 @@ Return Value:
 
     ULONG Cluster;
     ULONG ClusterCount;
-    PFAT32_INFORMATION_SECTOR Information;
-    ULONGLONG InformationBlock;
-    PFAT_IO_BUFFER InformationIoBuffer;
-    ULONG IoFlags;
     ULONG NextCluster;
     KSTATUS Status;
     ULONG TotalClusters;
 
-    InformationIoBuffer = NULL;
-    IoFlags = IO_FLAG_FS_DATA | IO_FLAG_FS_METADATA;
     FatAcquireLock(Volume->Lock);
     TotalClusters = Volume->ClusterCount;
     if ((FirstCluster < FAT_CLUSTER_BEGIN) || (FirstCluster >= TotalClusters)) {
@@ -1641,6 +1646,7 @@ Return Value:
             goto FreeClusterChainEnd;
         }
 
+        FatpSetClusterRunState(Volume, Cluster, 1, FALSE);
         ClusterCount += 1;
         if (NextCluster >= TotalClusters) {
             break;
@@ -1658,59 +1664,10 @@ Return Value:
     // Update the FS information block saving the new free space.
     //
 
-    if ((FatMaintainFreeClusterCount != FALSE) &&
-        (Volume->InformationByteOffset != 0)) {
-
-        InformationIoBuffer = FatAllocateIoBuffer(Volume->Device.DeviceToken,
-                                                  Volume->Device.BlockSize);
-
-        if (InformationIoBuffer == NULL) {
-            Status = STATUS_INSUFFICIENT_RESOURCES;
-            goto FreeClusterChainEnd;
-        }
-
-        InformationBlock = Volume->InformationByteOffset >> Volume->BlockShift;
-        Status = FatReadDevice(Volume->Device.DeviceToken,
-                               InformationBlock,
-                               1,
-                               IoFlags,
-                               Irp,
-                               InformationIoBuffer);
-
-        if (!KSUCCESS(Status)) {
-            goto FreeClusterChainEnd;
-        }
-
-        Information = FatMapIoBuffer(InformationIoBuffer);
-        if (Information == NULL) {
-            Status = STATUS_INSUFFICIENT_RESOURCES;
-            goto FreeClusterChainEnd;
-        }
-
-        Information->LastClusterAllocated = Cluster;
-
-        ASSERT(Information->FreeClusters + ClusterCount >
-               Information->FreeClusters);
-
-        Information->FreeClusters += ClusterCount;
-        Status = FatWriteDevice(Volume->Device.DeviceToken,
-                                InformationBlock,
-                                1,
-                                IoFlags,
-                                Irp,
-                                InformationIoBuffer);
-
-        if (!KSUCCESS(Status)) {
-            goto FreeClusterChainEnd;
-        }
-    }
+    Status = FatpUpdateInformationSector(Volume, Irp, Cluster, ClusterCount);
 
 FreeClusterChainEnd:
     FatReleaseLock(Volume->Lock);
-    if (InformationIoBuffer != NULL) {
-        FatFreeIoBuffer(InformationIoBuffer);
-    }
-
     return Status;
 }
 
@@ -4059,3 +4016,241 @@ Return Value:
     return Status;
 }
 
+KSTATUS
+FatpScanFatForFreeCluster (
+    PFAT_VOLUME Volume,
+    PULONG Cluster
+    )
+
+/*++
+
+Routine Description:
+
+    This routine searches the FAT itself for a free cluster, starting just
+    after the volume's search start and wrapping around. It is used when the
+    volume has no free cluster map. This routine assumes the volume lock is
+    held.
+
+Arguments:
+
+    Volume - Supplies a pointer to the FAT volume.
+
+    Cluster - Supplies a pointer where the free cluster will be returned.
+
+Return Value:
+
+    STATUS_SUCCESS on success.
+
+    STATUS_VOLUME_FULL if no free clusters exist.
+
+    Other error codes on device I/O errors.
+
+--*/
+
+{
+
+    ULONG ClusterEnd;
+    ULONG CurrentCluster;
+    ULONG SearchStart;
+    KSTATUS Status;
+    ULONG Value;
+    PVOID Window;
+    PUSHORT Window16;
+    PULONG Window32;
+    ULONG WindowOffset;
+    ULONG WindowSize;
+
+    //
+    // Search for a free block. Start just after the last allocated cluster.
+    //
+
+    CurrentCluster = Volume->ClusterSearchStart;
+    ClusterEnd = Volume->ClusterCount;
+    SearchStart = CurrentCluster;
+    CurrentCluster += 1;
+    WindowSize = FAT_WINDOW_INDEX_TO_CLUSTER(Volume, 1);
+    WindowOffset = MAX_ULONG;
+    while (CurrentCluster != SearchStart) {
+
+        //
+        // If this is the end of the FAT, wrap around to the beginning.
+        //
+
+        if (CurrentCluster >= ClusterEnd) {
+            CurrentCluster = FAT_CLUSTER_BEGIN;
+            WindowOffset = MAX_ULONG;
+            ClusterEnd = SearchStart;
+        }
+
+        //
+        // Read the next window if needed.
+        //
+
+        if (WindowOffset >= WindowSize) {
+            Status = FatpFatCacheGetFatWindow(Volume,
+                                              TRUE,
+                                              CurrentCluster,
+                                              &Window,
+                                              &WindowOffset);
+
+            if (!KSUCCESS(Status)) {
+                return Status;
+            }
+        }
+
+        //
+        // Scan the whole window.
+        //
+
+        if (Volume->Format == Fat12Format) {
+            while (CurrentCluster < ClusterEnd) {
+                Value = FAT12_READ_CLUSTER(Window, CurrentCluster);
+                if (Value == FAT_CLUSTER_FREE) {
+                    break;
+                }
+
+                CurrentCluster += 1;
+            }
+
+        } else if (Volume->Format == Fat16Format) {
+            Window16 = Window;
+            while ((WindowOffset < WindowSize) &&
+                   (CurrentCluster < ClusterEnd) &&
+                   (Window16[WindowOffset] != FAT_CLUSTER_FREE)) {
+
+                WindowOffset += 1;
+                CurrentCluster += 1;
+            }
+
+        } else {
+            Window32 = Window;
+            while ((WindowOffset < WindowSize) &&
+                   (CurrentCluster < ClusterEnd) &&
+                   (Window32[WindowOffset] != FAT_CLUSTER_FREE)) {
+
+                WindowOffset += 1;
+                CurrentCluster += 1;
+            }
+        }
+
+        if ((WindowOffset >= WindowSize) || (CurrentCluster >= ClusterEnd)) {
+            continue;
+        }
+
+        *Cluster = CurrentCluster;
+        return STATUS_SUCCESS;
+    }
+
+    return STATUS_VOLUME_FULL;
+}
+
+KSTATUS
+FatpUpdateInformationSector (
+    PFAT_VOLUME Volume,
+    PVOID Irp,
+    ULONG LastCluster,
+    LONG FreeDelta
+    )
+
+/*++
+
+Routine Description:
+
+    This routine updates the free cluster count and last allocated cluster in
+    the FS information block, if the volume has one and maintaining it is
+    enabled. This routine assumes the volume lock is held.
+
+Arguments:
+
+    Volume - Supplies a pointer to the FAT volume.
+
+    Irp - Supplies an optional pointer to an IRP to use for disk operations.
+
+    LastCluster - Supplies the cluster to record as last allocated.
+
+    FreeDelta - Supplies the change in the number of free clusters. This is
+        only used if the volume does not have a free cluster map, as the map
+        keeps the exact count.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    PFAT32_INFORMATION_SECTOR Information;
+    ULONGLONG InformationBlock;
+    PFAT_IO_BUFFER InformationIoBuffer;
+    ULONG IoFlags;
+    KSTATUS Status;
+
+    if ((FatMaintainFreeClusterCount == FALSE) ||
+        (Volume->InformationByteOffset == 0)) {
+
+        return STATUS_SUCCESS;
+    }
+
+    IoFlags = IO_FLAG_FS_DATA | IO_FLAG_FS_METADATA;
+    InformationIoBuffer = FatAllocateIoBuffer(Volume->Device.DeviceToken,
+                                              Volume->Device.BlockSize);
+
+    if (InformationIoBuffer == NULL) {
+        Status = STATUS_INSUFFICIENT_RESOURCES;
+        goto UpdateInformationSectorEnd;
+    }
+
+    InformationBlock = Volume->InformationByteOffset >> Volume->BlockShift;
+    Status = FatReadDevice(Volume->Device.DeviceToken,
+                           InformationBlock,
+                           1,
+                           IoFlags,
+                           Irp,
+                           InformationIoBuffer);
+
+    if (!KSUCCESS(Status)) {
+        goto UpdateInformationSectorEnd;
+    }
+
+    Information = FatMapIoBuffer(InformationIoBuffer);
+    if (Information == NULL) {
+        Status = STATUS_INSUFFICIENT_RESOURCES;
+        goto UpdateInformationSectorEnd;
+    }
+
+    Information->LastClusterAllocated = LastCluster;
+    if (Volume->FreeClusterMap != NULL) {
+        Information->FreeClusters = Volume->FreeClusterCount;
+
+    } else if (FreeDelta < 0) {
+
+        ASSERT(Information->FreeClusters >= (ULONG)-FreeDelta);
+
+        if (Information->FreeClusters >= (ULONG)-FreeDelta) {
+            Information->FreeClusters += FreeDelta;
+        }
+
+    } else {
+
+        ASSERT(Information->FreeClusters + FreeDelta >=
+               Information->FreeClusters);
+
+        Information->FreeClusters += FreeDelta;
+    }
+
+    Status = FatWriteDevice(Volume->Device.DeviceToken,
+                            InformationBlock,
+                            1,
+                            IoFlags,
+                            Irp,
+                            InformationIoBuffer);
+
+UpdateInformationSectorEnd:
+    if (InformationIoBuffer != NULL) {
+        FatFreeIoBuffer(InformationIoBuffer);
+    }
+
+    return Status;
+}
+
@@ -50,6 +50,17 @@ Module Name:
 #define BLOCK_ITERATIONS 10000
 #define BLOCK_SIZE 4096
 
+//
+// Define the parameters of the write benchmark. Each writer writes a file of
+// the given size in chunks, taking turns with the other writers.
+//
+
+#define BENCHMARK_IMAGE "testbench.test"
+#define BENCHMARK_DISK_SIZE (128 * 1024 * 1024)
+#define BENCHMARK_FILE_SIZE (16 * 1024 * 1024)
+#define BENCHMARK_CHUNK_SIZE (64 * 1024)
+#define BENCHMARK_WRITER_COUNT 4
+
 #define USAGE_STRING    \
     "Testfat.exe will test the FAT file system implementation.\n\n" \
     "Usage: Testfat.exe [-v]\n\n" \
@@ -97,6 +108,21 @@ FormatDisk (
     PVOID *VolumeToken
     );
 
+KSTATUS
+CreateTestFile (
+    PVOID VolumeToken,
+    PFILE_PROPERTIES DirectoryProperties,
+    PSTR FileName,
+    ULONG FileNameSize,
+    PFILE_ID FileId,
+    PVOID *FileToken
+    );
+
+BOOL
+BenchmarkWriters (
+    ULONG WriterCount
+    );
+
 //
 // -------------------------------------------------------------------- Globals
 //
@@ -154,23 +180,19 @@ Return Value:
     ULONG BlockIndex;
     UINTN BytesRead;
     UINTN BytesWritten;
-    ULONG DesiredAccess;
     FILE_PROPERTIES DirectoryProperties;
-    ULONGLONG DirectorySize;
     ULONG DiskSize;
     FAT_SEEK_INFORMATION FatSeekInformation;
     PULONG FileBuffer;
+    FILE_ID FileId;
     PFAT_IO_BUFFER FileIoBuffer;
     PVOID FileToken;
     ULONG FillIndex;
     ULONG Iteration;
-    ULONGLONG NewDirectorySize;
-    ULONG OpenFlags;
     FILE *OutputFile;
     PULONG PageBuffer;
     PFAT_IO_BUFFER PageIoBuffer;
     ULONG PageValue;
-    FILE_PROPERTIES Properties;
     BOOL Result;
     KSTATUS Status;
     BOOL VerifyFailed;
@@ -244,56 +266,18 @@ Return Value:
     }
 
     //
-    // Create the test file.
+    // Create and open the test file.
     //
 
     VPRINT("Creating Test File\n");
-    RtlZeroMemory(&Properties, sizeof(FILE_PROPERTIES));
-    Properties.Type = IoObjectRegularFile;
-    Properties.Permissions = FILE_PERMISSION_USER_READ |
-                             FILE_PERMISSION_USER_WRITE;
-
-    Properties.HardLinkCount = 1;
-    Status = FatCreate(VolumeToken,
-                       DirectoryProperties.FileId,
-                       TEST_FILE_NAME,
-                       sizeof(TEST_FILE_NAME),
-                       &NewDirectorySize,
-                       &Properties);
-
-    if (!KSUCCESS(Status)) {
-        printf("Error: Unable to create file %s. Status %d.\n",
-               TEST_FILE_NAME,
-               Status);
-
-        goto MainEnd;
-    }
-
-    DirectorySize = DirectoryProperties.Size;
-    if (NewDirectorySize > DirectorySize) {
-        DirectoryProperties.Size = NewDirectorySize;
-        FatWriteFileProperties(VolumeToken, &DirectoryProperties, 0);
-    }
-
-    //
-    // Now open that created file.
-    //
-
-    DesiredAccess = IO_ACCESS_READ | IO_ACCESS_WRITE;
-    OpenFlags = OPEN_FLAG_CREATE;
-    Status = FatOpenFileId(VolumeToken,
-                           Properties.FileId,
-                           DesiredAccess,
-                           OpenFlags,
-                           &FileToken);
+    Status = CreateTestFile(VolumeToken,
+                            &DirectoryProperties,
+                            TEST_FILE_NAME,
+                            sizeof(TEST_FILE_NAME),
+                            &FileId,
+                            &FileToken);
 
     if (!KSUCCESS(Status)) {
-        printf("Error: Unable to open %s (ID %lld) in the output image."
-               "Status %d\n",
-               TEST_FILE_NAME,
-               Properties.FileId,
-               Status);
-
         goto MainEnd;
     }
 
@@ -475,6 +459,18 @@ Return Value:
     }
 
     FatCloseFile(FileToken);
+
+    //
+    // Measure how quickly and how contiguously files get written, first by a
+    // single writer and then by several writers taking turns.
+    //
+
+    if ((BenchmarkWriters(1) == FALSE) ||
+        (BenchmarkWriters(BENCHMARK_WRITER_COUNT) == FALSE)) {
+
+        goto MainEnd;
+    }
+
     Result = TRUE;
 
 MainEnd:
@@ -571,6 +567,318 @@ Return Value:
     return Status;
 }
 
+KSTATUS
+CreateTestFile (
+    PVOID VolumeToken,
+    PFILE_PROPERTIES DirectoryProperties,
+    PSTR FileName,
+    ULONG FileNameSize,
+    PFILE_ID FileId,
+    PVOID *FileToken
+    )
+
+/*++
+
+Routine Description:
+
+    This routine creates a new file in the given directory and opens it for
+    reading and writing.
+
+Arguments:
+
+    VolumeToken - Supplies the token identifying the mounted volume.
+
+    DirectoryProperties - Supplies a pointer to the properties of the
+        directory to create the file in. The size will be updated if the
+        directory grows.
+
+    FileName - Supplies a pointer to the name of the file to create.
+
+    FileNameSize - Supplies the size of the file name buffer in bytes,
+        including the null terminator.
+
+    FileId - Supplies a pointer where the ID of the new file will be returned.
+
+    FileToken - Supplies a pointer where the token for the open file will be
+        returned.
+
+Return Value:
+
+    Status code.
+
+--*/
+
+{
+
+    ULONG DesiredAccess;
+    ULONGLONG NewDirectorySize;
+    ULONG OpenFlags;
+    FILE_PROPERTIES Properties;
+    KSTATUS Status;
+
+    RtlZeroMemory(&Properties, sizeof(FILE_PROPERTIES));
+    Properties.Type = IoObjectRegularFile;
+    Properties.Permissions = FILE_PERMISSION_USER_READ |
+                             FILE_PERMISSION_USER_WRITE;
+
+    Properties.HardLinkCount = 1;
+    Status = FatCreate(VolumeToken,
+                       DirectoryProperties->FileId,
+                       FileName,
+                       FileNameSize,
+                       &NewDirectorySize,
+                       &Properties);
+
+    if (!KSUCCESS(Status)) {
+        printf("Error: Unable to create file %s. Status %d.\n",
+               FileName,
+               Status);
+
+        return Status;
+    }
+
+    if (NewDirectorySize > DirectoryProperties->Size) {
+        DirectoryProperties->Size = NewDirectorySize;
+        FatWriteFileProperties(VolumeToken, DirectoryProperties, 0);
+    }
+
+    //
+    // Now open that created file.
+    //
+
+    DesiredAccess = IO_ACCESS_READ | IO_ACCESS_WRITE;
+    OpenFlags = OPEN_FLAG_CREATE;
+    Status = FatOpenFileId(VolumeToken,
+                           Properties.FileId,
+                           DesiredAccess,
+                           OpenFlags,
+                           FileToken);
+
+    if (!KSUCCESS(Status)) {
+        printf("Error: Unable to open %s (ID %lld) in the output image."
+               "Status %d\n",
+               FileName,
+               Properties.FileId,
+               Status);
+
+        return Status;
+    }
+
+    *FileId = Properties.FileId;
+    return STATUS_SUCCESS;
+}
+
+BOOL
+BenchmarkWriters (
+    ULONG WriterCount
+    )
+
+/*++
+
+Routine Description:
+
+    This routine formats a fresh volume and has the given number of writers
+    each write a file to it, taking turns one chunk at a time. It prints how
+    long the writes took and how many separate extents the files ended up in.
+
+Arguments:
+
+    WriterCount - Supplies the number of files to write at once.
+
+Return Value:
+
+    TRUE on success.
+
+    FALSE on failure.
+
+--*/
+
+{
+
+    PFILE_BLOCK_ENTRY BlockEntry;
+    PFILE_BLOCK_INFORMATION BlockInformation;
+    UINTN BytesWritten;
+    PUCHAR ChunkBuffer;
+    PFAT_IO_BUFFER ChunkIoBuffer;
+    clock_t EndTime;
+    ULONG ExtentCount;
+    PFILE_ID FileIds;
+    CHAR FileName[32];
+    PVOID *FileTokens;
+    FILE *ImageFile;
+    ULONG Offset;
+    FILE_PROPERTIES RootProperties;
+    BOOL Result;
+    PFAT_SEEK_INFORMATION SeekInformation;
+    clock_t StartTime;
+    KSTATUS Status;
+    PVOID VolumeToken;
+    ULONG Writer;
+
+    ChunkIoBuffer = NULL;
+    ExtentCount = 0;
+    FileIds = NULL;
+    FileTokens = NULL;
+    Result = FALSE;
+    SeekInformation = NULL;
+    VolumeToken = NULL;
+    ImageFile = fopen(BENCHMARK_IMAGE, "wb+");
+    if (ImageFile == NULL) {
+        printf("Unable to open benchmark image \"%s\" for write.\n",
+               BENCHMARK_IMAGE);
+
+        goto BenchmarkWritersEnd;
+    }
+
+    Status = FormatDisk(ImageFile,
+                        SECTOR_SIZE,
+                        BENCHMARK_DISK_SIZE / SECTOR_SIZE,
+                        &VolumeToken);
+
+    if (!KSUCCESS(Status)) {
+        VolumeToken = NULL;
+        goto BenchmarkWritersEnd;
+    }
+
+    RtlZeroMemory(&RootProperties, sizeof(FILE_PROPERTIES));
+    Status = FatLookup(VolumeToken, TRUE, 0, NULL, 0, &RootProperties);
+    if (!KSUCCESS(Status)) {
+        printf("Error: Could not look up root directory. Status = %d.\n",
+               Status);
+
+        goto BenchmarkWritersEnd;
+    }
+
+    FileIds = calloc(WriterCount, sizeof(FILE_ID));
+    FileTokens = calloc(WriterCount, sizeof(PVOID));
+    SeekInformation = calloc(WriterCount, sizeof(FAT_SEEK_INFORMATION));
+    ChunkIoBuffer = FatAllocateIoBuffer(NULL, BENCHMARK_CHUNK_SIZE);
+    if ((FileIds == NULL) || (FileTokens == NULL) ||
+        (SeekInformation == NULL) || (ChunkIoBuffer == NULL)) {
+
+        printf("Error: Unable to allocate benchmark buffers.\n");
+        goto BenchmarkWritersEnd;
+    }
+
+    ChunkBuffer = FatMapIoBuffer(ChunkIoBuffer);
+    memset(ChunkBuffer, 0xA5, BENCHMARK_CHUNK_SIZE);
+    for (Writer = 0; Writer < WriterCount; Writer += 1) {
+        snprintf(FileName, sizeof(FileName), "bench%u.dat", Writer);
+        Status = CreateTestFile(VolumeToken,
+                                &RootProperties,
+                                FileName,
+                                strlen(FileName) + 1,
+                                &(FileIds[Writer]),
+                                &(FileTokens[Writer]));
+
+        if (!KSUCCESS(Status)) {
+            goto BenchmarkWritersEnd;
+        }
+    }
+
+    //
+    // Have each writer append a chunk in turn until all the files are full.
+    //
+
+    StartTime = clock();
+    for (Offset = 0;
+         Offset < BENCHMARK_FILE_SIZE;
+         Offset += BENCHMARK_CHUNK_SIZE) {
+
+        for (Writer = 0; Writer < WriterCount; Writer += 1) {
+            Status = FatWriteFile(FileTokens[Writer],
+                                  &(SeekInformation[Writer]),
+                                  ChunkIoBuffer,
+                                  BENCHMARK_CHUNK_SIZE,
+                                  0,
+                                  NULL,
+                                  &BytesWritten);
+
+            if ((!KSUCCESS(Status)) || (BytesWritten != BENCHMARK_CHUNK_SIZE)) {
+                printf("Error: Benchmark write at offset 0x%x wrote %lu "
+                       "bytes. Status = %d.\n",
+                       Offset,
+                       BytesWritten,
+                       Status);
+
+                goto BenchmarkWritersEnd;
+            }
+        }
+    }
+
+    EndTime = clock();
+
+    //
+    // Count the contiguous runs each file ended up in.
+    //
+
+    for (Writer = 0; Writer < WriterCount; Writer += 1) {
+        Status = FatGetFileBlockInformation(VolumeToken,
+                                            FileIds[Writer],
+                                            &BlockInformation);
+
+        if (!KSUCCESS(Status)) {
+            printf("Error: Failed to get block information. Status = %d.\n",
+                   Status);
+
+            goto BenchmarkWritersEnd;
+        }
+
+        while (LIST_EMPTY(&(BlockInformation->BlockList)) == FALSE) {
+            BlockEntry = LIST_VALUE(BlockInformation->BlockList.Next,
+                                    FILE_BLOCK_ENTRY,
+                                    ListEntry);
+
+            LIST_REMOVE(&(BlockEntry->ListEntry));
+            FatFreeNonPagedMemory(NULL, BlockEntry);
+            ExtentCount += 1;
+        }
+
+        FatFreeNonPagedMemory(NULL, BlockInformation);
+    }
+
+    printf("%u writer(s): %u MB in %.3f seconds, %u extents per file.\n",
+           WriterCount,
+           (WriterCount * BENCHMARK_FILE_SIZE) / (1024 * 1024),
+           (double)(EndTime - StartTime) / CLOCKS_PER_SEC,
+           ExtentCount / WriterCount);
+
+    Result = TRUE;
+
+BenchmarkWritersEnd:
+    if (FileTokens != NULL) {
+        for (Writer = 0; Writer < WriterCount; Writer += 1) {
+            if (FileTokens[Writer] != NULL) {
+                FatCloseFile(FileTokens[Writer]);
+            }
+        }
+
+        free(FileTokens);
+    }
+
+    if (FileIds != NULL) {
+        free(FileIds);
+    }
+
+    if (SeekInformation != NULL) {
+        free(SeekInformation);
+    }
+
+    if (ChunkIoBuffer != NULL) {
+        FatFreeIoBuffer(ChunkIoBuffer);
+    }
+
+    if (VolumeToken != NULL) {
+        FatUnmount(VolumeToken);
+    }
+
+    if (ImageFile != NULL) {
+        fclose(ImageFile);
+    }
+
+    return Result;
+}
+
 VOID
 KdPrintWithArgumentList (
     PCSTR Format,
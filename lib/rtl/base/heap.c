@@ -1825,6 +1825,54 @@ Return Value:
     return;
 }
 
+RTL_API
+UINTN
+RtlHeapGetAllocationSize (
+    PMEMORY_HEAP Heap,
+    PVOID Memory,
+    PUINTN Tag
+    )
+
+/*++
+
+Routine Description:
+
+    This routine returns the number of usable bytes in an active heap
+    allocation, which may be larger than the size originally requested. The
+    heap does not need to be locked, as the caller owns the allocation and the
+    chunk bookkeeping does not change while it is in use.
+
+Arguments:
+
+    Heap - Supplies the heap the memory was allocated from.
+
+    Memory - Supplies the allocation created by the heap allocation routine.
+
+    Tag - Supplies an optional pointer where the tag the allocation was made
+        with will be returned.
+
+Return Value:
+
+    Returns the usable size of the allocation in bytes.
+
+--*/
+
+{
+
+    PHEAP_CHUNK Chunk;
+
+    Chunk = HEAP_MEMORY_TO_CHUNK(Memory);
+
+    ASSERT(HEAP_CHUNK_IS_IN_USE(Chunk));
+    ASSERT(HEAP_DECODE_FOOTER_MAGIC(Heap, Chunk) == Heap);
+
+    if (Tag != NULL) {
+        *Tag = Chunk->Tag;
+    }
+
+    return HEAP_CHUNK_SIZE(Chunk) - HEAP_OVERHEAD_FOR(Chunk);
+}
+
 RTL_API
 VOID
 RtlValidateHeap (
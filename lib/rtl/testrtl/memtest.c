@@ -0,0 +1,616 @@
+/*++
+
+Copyright (c) 2026 Minoca Corp.
+
+    This file is licensed under the terms of the GNU General Public License
+    version 3. Alternative licensing terms are available. Contact
+    info@minocacorp.com for details. See the LICENSE file at the root of this
+    project for complete licensing information.
+
+Module Name:
+
+    memtest.c
+
+Abstract:
+
+    This module implements the tests for the runtime library memory copy, set,
+    and compare routines, along with a small throughput benchmark.
+
+Author:
+
+    Minoca Corp. 17-Oct-2026
+
+Environment:
+
+    Test
+
+--*/
+
+//
+// ------------------------------------------------------------------- Includes
+//
+
+#define RTL_API
+
+#include <minoca/lib/types.h>
+#include <minoca/lib/status.h>
+#include <minoca/lib/rtl.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+//
+// ---------------------------------------------------------------- Definitions
+//
+
+//
+// Every size up to this one is tested, along with the sizes in the large
+// size array.
+//
+
+#define TEST_MEMORY_SMALL_SIZE 300
+#define TEST_MEMORY_ALIGNMENTS 16
+
+//
+// Define the number of guard bytes on either side of the region under test.
+//
+
+#define TEST_MEMORY_GUARD 64
+#define TEST_MEMORY_GUARD_BYTE 0xA5
+
+#define TEST_MEMORY_MAX_SIZE ((32 * 1024 * 1024) + 4096)
+#define TEST_MEMORY_BUFFER_SIZE \
+    (TEST_MEMORY_MAX_SIZE + (2 * TEST_MEMORY_GUARD) + TEST_MEMORY_ALIGNMENTS)
+
+//
+// Define the number of bytes each benchmark case moves.
+//
+
+#define TEST_MEMORY_BENCHMARK_BYTES (64 * 1024 * 1024)
+
+//
+// ------------------------------------------------------ Data Type Definitions
+//
+
+typedef enum _TEST_MEMORY_OPERATION {
+    TestMemoryCopy,
+    TestMemorySet,
+    TestMemoryCompare,
+    TestMemoryOperationCount
+} TEST_MEMORY_OPERATION, *PTEST_MEMORY_OPERATION;
+
+//
+// ----------------------------------------------- Internal Function Prototypes
+//
+
+ULONG
+TestMemoryPass (
+    PUCHAR Source,
+    PUCHAR Destination,
+    PUCHAR Expected
+    );
+
+ULONG
+TestMemorySize (
+    PUCHAR Source,
+    PUCHAR Destination,
+    PUCHAR Expected,
+    UINTN Size,
+    UINTN Alignment
+    );
+
+VOID
+TestMemoryBenchmark (
+    PUCHAR Source,
+    PUCHAR Destination
+    );
+
+VOID
+TestMemoryFill (
+    PUCHAR Buffer,
+    UINTN Size,
+    ULONG Seed
+    );
+
+//
+// -------------------------------------------------------------------- Globals
+//
+
+UINTN TestMemoryLargeSizes[] = {
+    511,
+    512,
+    513,
+    1023,
+    2047,
+    2048,
+    2049,
+    4096 + 7,
+    65536 + 33,
+    (1024 * 1024) - 1,
+    1024 * 1024,
+    (1024 * 1024) + 65,
+    (32 * 1024 * 1024) - 1,
+    TEST_MEMORY_MAX_SIZE
+};
+
+UINTN TestMemoryBenchmarkSizes[] = {
+    8,
+    32,
+    64,
+    256,
+    1024,
+    4096,
+    65536,
+    1024 * 1024,
+    TEST_MEMORY_MAX_SIZE
+};
+
+UINTN TestMemoryBenchmarkAlignments[] = {
+    0,
+    1,
+    7
+};
+
+PSTR TestMemoryOperationNames[TestMemoryOperationCount] = {
+    "copy",
+    "set",
+    "compare"
+};
+
+//
+// ------------------------------------------------------------------ Functions
+//
+
+ULONG
+TestMemoryRoutines (
+    VOID
+    )
+
+/*++
+
+Routine Description:
+
+    This routine tests the memory copy, set, and compare routines, first with
+    the general purpose register implementations and then with whatever the
+    processor features allow.
+
+Arguments:
+
+    None.
+
+Return Value:
+
+    Returns the number of test failures.
+
+--*/
+
+{
+
+    PUCHAR Destination;
+    PUCHAR Expected;
+    ULONG Failures;
+    PUCHAR Source;
+
+    Failures = 0;
+    Destination = malloc(TEST_MEMORY_BUFFER_SIZE);
+    Expected = malloc(TEST_MEMORY_BUFFER_SIZE);
+    Source = malloc(TEST_MEMORY_BUFFER_SIZE);
+    if ((Destination == NULL) || (Expected == NULL) || (Source == NULL)) {
+        printf("Failed to allocate memory test buffers.\n");
+        Failures += 1;
+        goto TestMemoryRoutinesEnd;
+    }
+
+    Failures += TestMemoryPass(Source, Destination, Expected);
+    RtlInitializeMemoryRoutines();
+    Failures += TestMemoryPass(Source, Destination, Expected);
+    if (Failures == 0) {
+        TestMemoryBenchmark(Source, Destination);
+    }
+
+TestMemoryRoutinesEnd:
+    if (Destination != NULL) {
+        free(Destination);
+    }
+
+    if (Expected != NULL) {
+        free(Expected);
+    }
+
+    if (Source != NULL) {
+        free(Source);
+    }
+
+    if (Failures != 0) {
+        printf("%d memory test failures.\n", Failures);
+    }
+
+    return Failures;
+}
+
+//
+// --------------------------------------------------------- Internal Functions
+//
+
+ULONG
+TestMemoryPass (
+    PUCHAR Source,
+    PUCHAR Destination,
+    PUCHAR Expected
+    )
+
+/*++
+
+Routine Description:
+
+    This routine runs the memory tests across all sizes and alignments using
+    the currently selected implementations.
+
+Arguments:
+
+    Source - Supplies a pointer to a scratch buffer to use as the source.
+
+    Destination - Supplies a pointer to a scratch buffer to use as the
+        destination.
+
+    Expected - Supplies a pointer to a scratch buffer to build expected
+        results in.
+
+Return Value:
+
+    Returns the number of test failures.
+
+--*/
+
+{
+
+    UINTN Alignment;
+    ULONG Failures;
+    UINTN Index;
+    UINTN Size;
+
+    Failures = 0;
+    for (Size = 0; Size <= TEST_MEMORY_SMALL_SIZE; Size += 1) {
+        for (Alignment = 0;
+             Alignment < TEST_MEMORY_ALIGNMENTS;
+             Alignment += 1) {
+
+            Failures += TestMemorySize(Source,
+                                       Destination,
+                                       Expected,
+                                       Size,
+                                       Alignment);
+        }
+    }
+
+    for (Index = 0;
+         Index < sizeof(TestMemoryLargeSizes) / sizeof(TestMemoryLargeSizes[0]);
+         Index += 1) {
+
+        Size = TestMemoryLargeSizes[Index];
+        Failures += TestMemorySize(Source, Destination, Expected, Size, 0);
+        Failures += TestMemorySize(Source, Destination, Expected, Size, 3);
+        Failures += TestMemorySize(Source, Destination, Expected, Size, 12);
+    }
+
+    return Failures;
+}
+
+ULONG
+TestMemorySize (
+    PUCHAR Source,
+    PUCHAR Destination,
+    PUCHAR Expected,
+    UINTN Size,
+    UINTN Alignment
+    )
+
+/*++
+
+Routine Description:
+
+    This routine tests the memory routines at a particular size and
+    alignment. The source is deliberately given a different alignment than
+    the destination.
+
+Arguments:
+
+    Source - Supplies a pointer to a scratch buffer to use as the source.
+
+    Destination - Supplies a pointer to a scratch buffer to use as the
+        destination.
+
+    Expected - Supplies a pointer to a scratch buffer to build expected
+        results in.
+
+    Size - Supplies the number of bytes to operate on.
+
+    Alignment - Supplies the offset of the destination from the start of the
+        buffer.
+
+Return Value:
+
+    Returns the number of test failures.
+
+--*/
+
+{
+
+    BOOL Equal;
+    ULONG Failures;
+    UINTN Index;
+    PUCHAR Region;
+    UINTN RegionSize;
+    UINTN Shift;
+    UINTN SourceAlignment;
+    PUCHAR SourceRegion;
+
+    Failures = 0;
+    RegionSize = Size + (2 * TEST_MEMORY_GUARD);
+    SourceAlignment = (Alignment * 7 + 5) % TEST_MEMORY_ALIGNMENTS;
+    Region = Destination + Alignment;
+    SourceRegion = Source + SourceAlignment + TEST_MEMORY_GUARD;
+
+    //
+    // Test copy, and make sure the guard bytes on either side are unharmed.
+    //
+
+    TestMemoryFill(SourceRegion, Size, (ULONG)Size);
+    memset(Region, TEST_MEMORY_GUARD_BYTE, RegionSize);
+    memset(Expected, TEST_MEMORY_GUARD_BYTE, RegionSize);
+    memcpy(Expected + TEST_MEMORY_GUARD, SourceRegion, Size);
+    RtlCopyMemory(Region + TEST_MEMORY_GUARD, SourceRegion, Size);
+    if (memcmp(Region, Expected, RegionSize) != 0) {
+        printf("RtlCopyMemory failed: size %ld alignment %ld/%ld.\n",
+               (long)Size,
+               (long)Alignment,
+               (long)SourceAlignment);
+
+        Failures += 1;
+    }
+
+    //
+    // Test comparing the copy, which should be equal, and then flip a byte
+    // and make sure it's unequal. For small sizes, try every position.
+    //
+
+    Equal = RtlCompareMemory(Region + TEST_MEMORY_GUARD, SourceRegion, Size);
+    if (Equal == FALSE) {
+        printf("RtlCompareMemory failed: size %ld alignment %ld reported "
+               "equal buffers unequal.\n",
+               (long)Size,
+               (long)Alignment);
+
+        Failures += 1;
+    }
+
+    if (Size != 0) {
+        for (Index = 0; Index < Size; Index += 1) {
+            if ((Size > TEST_MEMORY_SMALL_SIZE) &&
+                (Index != 0) &&
+                (Index != Size - 1) &&
+                (Index != Size / 2)) {
+
+                continue;
+            }
+
+            Region[TEST_MEMORY_GUARD + Index] ^= 0x10;
+            Equal = RtlCompareMemory(Region + TEST_MEMORY_GUARD,
+                                     SourceRegion,
+                                     Size);
+
+            Region[TEST_MEMORY_GUARD + Index] ^= 0x10;
+            if (Equal != FALSE) {
+                printf("RtlCompareMemory failed: size %ld alignment %ld "
+                       "missed difference at %ld.\n",
+                       (long)Size,
+                       (long)Alignment,
+                       (long)Index);
+
+                Failures += 1;
+                break;
+            }
+        }
+    }
+
+    //
+    // Test set and zero.
+    //
+
+    memset(Region, TEST_MEMORY_GUARD_BYTE, RegionSize);
+    memset(Expected + TEST_MEMORY_GUARD, 0x3C, Size);
+    RtlSetMemory(Region + TEST_MEMORY_GUARD, 0x3C, Size);
+    if (memcmp(Region, Expected, RegionSize) != 0) {
+        printf("RtlSetMemory failed: size %ld alignment %ld.\n",
+               (long)Size,
+               (long)Alignment);
+
+        Failures += 1;
+    }
+
+    memset(Expected + TEST_MEMORY_GUARD, 0, Size);
+    RtlZeroMemory(Region + TEST_MEMORY_GUARD, Size);
+    if (memcmp(Region, Expected, RegionSize) != 0) {
+        printf("RtlZeroMemory failed: size %ld alignment %ld.\n",
+               (long)Size,
+               (long)Alignment);
+
+        Failures += 1;
+    }
+
+    //
+    // The C library's memmove relies on forward copies into a destination
+    // below the source working. Test a few shifts.
+    //
+
+    if ((Size <= TEST_MEMORY_SMALL_SIZE) || (Alignment == 3)) {
+        for (Shift = 1; Shift <= 65; Shift += 16) {
+            TestMemoryFill(Region, Size + Shift, (ULONG)Shift);
+            memcpy(Expected, Region, Size + Shift);
+            memmove(Expected, Expected + Shift, Size);
+            RtlCopyMemory(Region, Region + Shift, Size);
+            if (memcmp(Region, Expected, Size + Shift) != 0) {
+                printf("RtlCopyMemory failed: overlapping size %ld alignment "
+                       "%ld shift %ld.\n",
+                       (long)Size,
+                       (long)Alignment,
+                       (long)Shift);
+
+                Failures += 1;
+                break;
+            }
+        }
+    }
+
+    return Failures;
+}
+
+VOID
+TestMemoryBenchmark (
+    PUCHAR Source,
+    PUCHAR Destination
+    )
+
+/*++
+
+Routine Description:
+
+    This routine prints the throughput of the memory routines across a range
+    of sizes and alignments.
+
+Arguments:
+
+    Source - Supplies a pointer to a scratch buffer to use as the source.
+
+    Destination - Supplies a pointer to a scratch buffer to use as the
+        destination.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    UINTN Alignment;
+    UINTN AlignmentIndex;
+    clock_t End;
+    ULONG Equal;
+    UINTN Iteration;
+    UINTN Iterations;
+    double Megabytes;
+    TEST_MEMORY_OPERATION Operation;
+    double Seconds;
+    UINTN Size;
+    UINTN SizeIndex;
+    clock_t Start;
+
+    memset(Source, 0x11, TEST_MEMORY_BUFFER_SIZE);
+    memset(Destination, 0x11, TEST_MEMORY_BUFFER_SIZE);
+    printf("%-8s %9s %5s %10s\n", "Routine", "Size", "Align", "MB/s");
+    Equal = 0;
+    for (Operation = 0; Operation < TestMemoryOperationCount; Operation += 1) {
+        for (SizeIndex = 0;
+             SizeIndex < sizeof(TestMemoryBenchmarkSizes) /
+                         sizeof(TestMemoryBenchmarkSizes[0]);
+
+             SizeIndex += 1) {
+
+            Size = TestMemoryBenchmarkSizes[SizeIndex];
+            Iterations = TEST_MEMORY_BENCHMARK_BYTES / Size;
+            for (AlignmentIndex = 0;
+                 AlignmentIndex < sizeof(TestMemoryBenchmarkAlignments) /
+                                  sizeof(TestMemoryBenchmarkAlignments[0]);
+
+                 AlignmentIndex += 1) {
+
+                Alignment = TestMemoryBenchmarkAlignments[AlignmentIndex];
+                Start = clock();
+                for (Iteration = 0; Iteration < Iterations; Iteration += 1) {
+                    switch (Operation) {
+                    case TestMemoryCopy:
+                        RtlCopyMemory(Destination + Alignment, Source, Size);
+                        break;
+
+                    case TestMemorySet:
+                        RtlSetMemory(Destination + Alignment, 0x11, Size);
+                        break;
+
+                    case TestMemoryCompare:
+                    default:
+                        Equal += RtlCompareMemory(Destination + Alignment,
+                                                  Source,
+                                                  Size);
+
+                        break;
+                    }
+                }
+
+                End = clock();
+                Seconds = (double)(End - Start) / CLOCKS_PER_SEC;
+                Megabytes = (double)(Iterations * Size) / (1024.0 * 1024.0);
+                if (Seconds <= 0.0) {
+                    Seconds = 1.0 / CLOCKS_PER_SEC;
+                }
+
+                printf("%-8s %9ld %5ld %10.0f\n",
+                       TestMemoryOperationNames[Operation],
+                       (long)Size,
+                       (long)Alignment,
+                       Megabytes / Seconds);
+            }
+        }
+    }
+
+    if (Equal == 0) {
+        printf("Memory benchmark compares unexpectedly failed.\n");
+    }
+
+    return;
+}
+
+VOID
+TestMemoryFill (
+    PUCHAR Buffer,
+    UINTN Size,
+    ULONG Seed
+    )
+
+/*++
+
+Routine Description:
+
+    This routine fills a buffer with a pattern that differs at every byte
+    offset, so that misplaced bytes are caught.
+
+Arguments:
+
+    Buffer - Supplies a pointer to the buffer to fill.
+
+    Size - Supplies the number of bytes to fill.
+
+    Seed - Supplies a value that varies the pattern.
+
+Return Value:
+
+    None.
+
+--*/
+
+{
+
+    UINTN Index;
+    ULONG Value;
+
+    Value = Seed * 2654435761UL;
+    for (Index = 0; Index < Size; Index += 1) {
+        Value = (Value * 1103515245) + 12345;
+        Buffer[Index] = (UCHAR)(Value >> 16);
+    }
+
+    return;
+}
+
@@ -418,6 +418,11 @@ TestHeaps (
     BOOL Quiet
     );
 
+ULONG
+TestMemoryRoutines (
+    VOID
+    );
+
 ULONG
 TestSoftFloatSingle (
     VOID
@@ -599,6 +604,7 @@ Return Value:
     TestsFailed += TestSoftFloatDouble();
     TestsFailed += TestTime();
     TestsFailed += TestHeaps(TRUE);
+    TestsFailed += TestMemoryRoutines();
 
     //
     // Test basic unsigned division.